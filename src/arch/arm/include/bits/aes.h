@@ -0,0 +1,53 @@
+#ifndef _BITS_AES_H
+#define _BITS_AES_H
+
+/** @file
+ *
+ * ARM-specific AES API implementations
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+struct aes_context;
+
+/**
+ * Check for accelerated AES support
+ *
+ * @ret supported	Accelerated implementation is supported
+ */
+static inline int aes_accel_supported ( void ) {
+
+	/* No accelerated implementation exists */
+	return 0;
+}
+
+/**
+ * Encrypt a block using the accelerated implementation
+ *
+ * @v aes		AES context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ */
+static inline void aes_accel_encrypt ( struct aes_context *aes __unused,
+				       const void *src __unused,
+				       void *dst __unused ) {
+
+	/* Never called; no accelerated implementation exists */
+}
+
+/**
+ * Decrypt a block using the accelerated implementation
+ *
+ * @v aes		AES context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ */
+static inline void aes_accel_decrypt ( struct aes_context *aes __unused,
+				       const void *src __unused,
+				       void *dst __unused ) {
+
+	/* Never called; no accelerated implementation exists */
+}
+
+#endif /* _BITS_AES_H */
@@ -0,0 +1,35 @@
+#ifndef _BITS_SHA1_H
+#define _BITS_SHA1_H
+
+/** @file
+ *
+ * ARM-specific SHA-1 API implementations
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+struct sha1_context;
+
+/**
+ * Check for accelerated SHA-1 support
+ *
+ * @ret supported	Accelerated implementation is supported
+ */
+static inline int sha1_accel_supported ( void ) {
+
+	/* No accelerated implementation exists */
+	return 0;
+}
+
+/**
+ * Digest a block using the accelerated implementation
+ *
+ * @v context		SHA-1 context
+ */
+static inline void sha1_accel_digest ( struct sha1_context *context __unused ) {
+
+	/* Never called; no accelerated implementation exists */
+}
+
+#endif /* _BITS_SHA1_H */
@@ -0,0 +1,36 @@
+#ifndef _BITS_SHA256_H
+#define _BITS_SHA256_H
+
+/** @file
+ *
+ * ARM-specific SHA-256 API implementations
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+struct sha256_context;
+
+/**
+ * Check for accelerated SHA-256 support
+ *
+ * @ret supported	Accelerated implementation is supported
+ */
+static inline int sha256_accel_supported ( void ) {
+
+	/* No accelerated implementation exists */
+	return 0;
+}
+
+/**
+ * Digest a block using the accelerated implementation
+ *
+ * @v context		SHA-256 context
+ */
+static inline void
+sha256_accel_digest ( struct sha256_context *context __unused ) {
+
+	/* Never called; no accelerated implementation exists */
+}
+
+#endif /* _BITS_SHA256_H */
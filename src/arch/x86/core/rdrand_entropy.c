@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2021 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * RDRAND/RDSEED entropy source
+ *
+ * This source uses the on-chip digital random number generator,
+ * preferring the RDSEED instruction (which provides conditioned
+ * samples direct from the entropy source) and falling back to RDRAND
+ * (which provides output from a DRBG continuously reseeded from the
+ * same source).  Unlike the timer-based sources, obtaining a sample
+ * takes microseconds rather than milliseconds, so seeding our own
+ * DRBG no longer dominates the time taken for the first TLS
+ * connection.
+ *
+ * Samples are subjected to the SP 800-90B continuous health tests
+ * (the repetition count test and the adaptive proportion test), with
+ * cutoffs calculated for a false positive rate of 2^-20 at our
+ * claimed min-entropy of 4 bits per byte.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <ipxe/cpuid.h>
+#include <ipxe/entropy.h>
+
+/** Maximum number of times to retry RDRAND/RDSEED */
+#define RDRAND_MAX_RETRIES 16
+
+/** Repetition count test cutoff
+ *
+ * Calculated as 1 + ( 20 / H ) per SP 800-90B section 4.4.1, with
+ * H=4 bits of claimed min-entropy per sample.
+ */
+#define RDRAND_REPETITION_CUTOFF 6
+
+/** Adaptive proportion test window size */
+#define RDRAND_PROPORTION_WINDOW 512
+
+/** Adaptive proportion test cutoff
+ *
+ * For H=4 bits per sample, any individual sample value occurs with
+ * probability at most 2^-4, giving an expected count of 32 within a
+ * 512-sample window.  A count of 62 or more has probability below
+ * 2^-20 (SP 800-90B section 4.4.2).
+ */
+#define RDRAND_PROPORTION_CUTOFF 62
+
+/** Number of samples drawn by the start-up health test */
+#define RDRAND_STARTUP_SAMPLES 1024
+
+/** RDSEED instruction is available */
+static int rdrand_have_rdseed;
+
+/** Repetition count test: most recent sample value */
+static noise_sample_t rdrand_repeated;
+
+/** Repetition count test: current repetition count */
+static unsigned int rdrand_repetitions;
+
+/** Adaptive proportion test: reference sample value */
+static noise_sample_t rdrand_reference;
+
+/** Adaptive proportion test: occurrences of reference value */
+static unsigned int rdrand_occurrences;
+
+/** Adaptive proportion test: samples remaining in current window */
+static unsigned int rdrand_remaining;
+
+/**
+ * Draw raw value using RDSEED
+ *
+ * @v value		Value to fill in
+ * @ret rc		Return status code
+ */
+static int rdseed_raw ( uint32_t *value ) {
+	unsigned int retries;
+	uint8_t ok;
+
+	for ( retries = 0 ; retries < RDRAND_MAX_RETRIES ; retries++ ) {
+		__asm__ __volatile__ ( "rdseed %0\n\t"
+				       "setc %1\n\t"
+				       : "=r" ( *value ), "=qm" ( ok ) );
+		if ( ok )
+			return 0;
+		/* Allow the entropy source time to catch up */
+		__asm__ __volatile__ ( "pause" );
+	}
+
+	return -EBUSY;
+}
+
+/**
+ * Draw raw value using RDRAND
+ *
+ * @v value		Value to fill in
+ * @ret rc		Return status code
+ */
+static int rdrand_raw ( uint32_t *value ) {
+	unsigned int retries;
+	uint8_t ok;
+
+	/* Intel's DRNG guide recommends retrying, since transient
+	 * failures are possible when the DRBG is being reseeded.
+	 */
+	for ( retries = 0 ; retries < RDRAND_MAX_RETRIES ; retries++ ) {
+		__asm__ __volatile__ ( "rdrand %0\n\t"
+				       "setc %1\n\t"
+				       : "=r" ( *value ), "=qm" ( ok ) );
+		if ( ok )
+			return 0;
+	}
+
+	return -EBUSY;
+}
+
+/**
+ * Get noise sample
+ *
+ * @v noise		Noise sample to fill in
+ * @ret rc		Return status code
+ */
+int rdrand_sample ( noise_sample_t *noise ) {
+	uint32_t value;
+	noise_sample_t sample;
+	int rc;
+
+	/* Draw raw value, preferring RDSEED where available */
+	if ( rdrand_have_rdseed ) {
+		if ( ( rc = rdseed_raw ( &value ) ) != 0 )
+			return rc;
+	} else {
+		if ( ( rc = rdrand_raw ( &value ) ) != 0 )
+			return rc;
+	}
+	sample = value;
+
+	/* Perform repetition count test */
+	if ( sample == rdrand_repeated ) {
+		rdrand_repetitions++;
+		if ( rdrand_repetitions >= RDRAND_REPETITION_CUTOFF ) {
+			DBGC ( &rdrand_repeated, "RDRAND repetition count "
+			       "test failed\n" );
+			return -EIO;
+		}
+	} else {
+		rdrand_repeated = sample;
+		rdrand_repetitions = 1;
+	}
+
+	/* Perform adaptive proportion test */
+	if ( ! rdrand_remaining ) {
+		rdrand_reference = sample;
+		rdrand_occurrences = 0;
+		rdrand_remaining = RDRAND_PROPORTION_WINDOW;
+	}
+	rdrand_remaining--;
+	if ( sample == rdrand_reference ) {
+		rdrand_occurrences++;
+		if ( rdrand_occurrences >= RDRAND_PROPORTION_CUTOFF ) {
+			DBGC ( &rdrand_repeated, "RDRAND adaptive proportion "
+			       "test failed\n" );
+			return -EIO;
+		}
+	}
+
+	*noise = sample;
+	return 0;
+}
+
+/**
+ * Enable entropy gathering
+ *
+ * @ret rc		Return status code
+ */
+static int rdrand_entropy_enable ( void ) {
+	struct x86_features features;
+	uint32_t eax;
+	uint32_t ebx;
+	uint32_t ecx;
+	uint32_t edx;
+	noise_sample_t discard;
+	unsigned int i;
+	int rc;
+
+	/* Check that RDRAND is supported */
+	x86_features ( &features );
+	if ( ! ( features.intel.ecx & CPUID_FEATURES_INTEL_ECX_RDRAND ) ) {
+		DBGC ( &rdrand_repeated, "RDRAND not supported by CPU\n" );
+		return -ENOTSUP;
+	}
+
+	/* Check for RDSEED */
+	rdrand_have_rdseed = 0;
+	if ( cpuid_supported ( CPUID_SEF ) ) {
+		cpuid ( CPUID_SEF, 0, &eax, &ebx, &ecx, &edx );
+		if ( ebx & CPUID_SEF_EBX_RDSEED )
+			rdrand_have_rdseed = 1;
+	}
+	DBGC ( &rdrand_repeated, "RDRAND using %s\n",
+	       ( rdrand_have_rdseed ? "RDSEED" : "RDRAND" ) );
+
+	/* Reset health test state */
+	rdrand_repetitions = 0;
+	rdrand_remaining = 0;
+
+	/* Perform start-up health test, running the continuous tests
+	 * over an initial run of discarded samples (SP 800-90B
+	 * section 4.3).
+	 */
+	for ( i = 0 ; i < RDRAND_STARTUP_SAMPLES ; i++ ) {
+		if ( ( rc = rdrand_sample ( &discard ) ) != 0 ) {
+			DBGC ( &rdrand_repeated, "RDRAND start-up test "
+			       "failed: %s\n", strerror ( rc ) );
+			return rc;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Disable entropy gathering
+ *
+ */
+static void rdrand_entropy_disable ( void ) {
+
+	/* Nothing to do */
+}
+
+PROVIDE_ENTROPY_INLINE ( rdrand, min_entropy_per_sample );
+PROVIDE_ENTROPY ( rdrand, entropy_enable, rdrand_entropy_enable );
+PROVIDE_ENTROPY ( rdrand, entropy_disable, rdrand_entropy_disable );
+PROVIDE_ENTROPY_INLINE ( rdrand, get_noise );
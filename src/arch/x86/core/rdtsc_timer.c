@@ -111,6 +111,45 @@ static void rdtsc_udelay ( unsigned long usecs ) {
 	} while ( elapsed < threshold );
 }
 
+/**
+ * Get TSC frequency advertised via CPUID, if any
+ *
+ * @ret tsc_per_us	TSC increments per microsecond, or zero if unknown
+ */
+static unsigned long rdtsc_cpuid_tsc_per_us ( void ) {
+	uint32_t denominator;
+	uint32_t numerator;
+	uint32_t crystal;
+	uint32_t mhz;
+	uint32_t discard_b;
+	uint32_t discard_c;
+	uint32_t discard_d;
+
+	/* Use TSC/crystal clock ratio and crystal clock frequency, if
+	 * advertised.
+	 */
+	if ( cpuid_supported ( CPUID_TSC ) == 0 ) {
+		cpuid ( CPUID_TSC, 0, &denominator, &numerator, &crystal,
+			&discard_d );
+		if ( denominator && numerator && crystal ) {
+			return ( ( ( ( uint64_t ) crystal ) * numerator ) /
+				 ( ( ( uint64_t ) denominator ) * 1000000 ) );
+		}
+	}
+
+	/* Fall back to the processor base frequency, if advertised.
+	 * The invariant TSC increments at the base frequency.
+	 */
+	if ( cpuid_supported ( CPUID_FREQUENCY ) == 0 ) {
+		cpuid ( CPUID_FREQUENCY, 0, &mhz, &discard_b, &discard_c,
+			&discard_d );
+		if ( mhz )
+			return mhz;
+	}
+
+	return 0;
+}
+
 /**
  * Probe RDTSC timer
  *
@@ -139,12 +178,20 @@ static int rdtsc_probe ( void ) {
 		return -ENOTTY;
 	}
 
-	/* Calibrate udelay() timer via 8254 PIT */
-	before = rdtsc_raw();
-	pit8254_udelay ( TSC_CALIBRATE_US );
-	after = rdtsc_raw();
-	elapsed = ( after - before );
-	tsc_per_us = ( elapsed / TSC_CALIBRATE_US );
+	/* Use TSC frequency advertised via CPUID, if present,
+	 * avoiding the need for a calibration delay at startup;
+	 * otherwise calibrate against the 8254 PIT.
+	 */
+	tsc_per_us = rdtsc_cpuid_tsc_per_us();
+	if ( tsc_per_us ) {
+		DBGC ( colour, "RDTSC has CPUID-advertised frequency\n" );
+	} else {
+		before = rdtsc_raw();
+		pit8254_udelay ( TSC_CALIBRATE_US );
+		after = rdtsc_raw();
+		elapsed = ( after - before );
+		tsc_per_us = ( elapsed / TSC_CALIBRATE_US );
+	}
 	if ( ! tsc_per_us ) {
 		DBGC ( colour, "RDTSC has zero TSC per microsecond\n" );
 		return -EIO;
@@ -40,9 +40,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  * @v result0		Element 0 of big integer to hold result
  * @v size		Number of elements
  */
-void bigint_multiply_raw ( const uint32_t *multiplicand0,
-			   const uint32_t *multiplier0,
-			   uint32_t *result0, unsigned int size ) {
+void bigint_multiply_raw ( const bigint_element_t *multiplicand0,
+			   const bigint_element_t *multiplier0,
+			   bigint_element_t *result0, unsigned int size ) {
 	const bigint_t ( size ) __attribute__ (( may_alias )) *multiplicand =
 		( ( const void * ) multiplicand0 );
 	const bigint_t ( size ) __attribute__ (( may_alias )) *multiplier =
@@ -51,11 +51,11 @@ void bigint_multiply_raw ( const uint32_t *multiplicand0,
 		( ( void * ) result0 );
 	unsigned int i;
 	unsigned int j;
-	uint32_t multiplicand_element;
-	uint32_t multiplier_element;
-	uint32_t *result_elements;
-	uint32_t discard_a;
-	uint32_t discard_d;
+	bigint_element_t multiplicand_element;
+	bigint_element_t multiplier_element;
+	bigint_element_t *result_elements;
+	bigint_element_t discard_a;
+	bigint_element_t discard_d;
 	long index;
 
 	/* Zero result */
@@ -75,6 +75,23 @@ void bigint_multiply_raw ( const uint32_t *multiplicand0,
 			 *
 			 *     a < 2^{n}, b < 2^{n} => ab < 2^{2n}
 			 */
+#ifdef __x86_64__
+			__asm__ __volatile__ ( "mulq %4\n\t"
+					       "addq %%rax, (%5,%2,8)\n\t"
+					       "adcq %%rdx, 8(%5,%2,8)\n\t"
+					       "\n1:\n\t"
+					       "adcq $0, 16(%5,%2,8)\n\t"
+					       "inc %2\n\t"
+						       /* Does not affect CF */
+					       "jc 1b\n\t"
+					       : "=&a" ( discard_a ),
+						 "=&d" ( discard_d ),
+						 "=&r" ( index )
+					       : "0" ( multiplicand_element ),
+						 "g" ( multiplier_element ),
+						 "r" ( result_elements ),
+						 "2" ( 0 ) );
+#else
 			__asm__ __volatile__ ( "mull %4\n\t"
 					       "addl %%eax, (%5,%2,4)\n\t"
 					       "adcl %%edx, 4(%5,%2,4)\n\t"
@@ -90,6 +107,7 @@ void bigint_multiply_raw ( const uint32_t *multiplicand0,
 						 "g" ( multiplier_element ),
 						 "r" ( result_elements ),
 						 "2" ( 0 ) );
+#endif
 		}
 	}
 }
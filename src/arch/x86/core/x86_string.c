@@ -29,6 +29,7 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+#include <stdint.h>
 #include <string.h>
 
 /**
@@ -108,3 +109,35 @@ void * __memmove ( void *dest, const void *src, size_t len ) {
 		return __memcpy_reverse ( dest, src, len );
 	}
 }
+
+/**
+ * Fill memory region
+ *
+ * @v dest		Destination address
+ * @v fill		Fill pattern
+ * @v len		Length
+ * @ret dest		Destination address
+ */
+void * __attribute__ (( noinline )) __memset ( void *dest, int fill,
+					       size_t len ) {
+	void *edi = dest;
+	uint32_t eax = ( fill & 0xff );
+	int discard_ecx;
+
+	/* We often do large dword-aligned clears (e.g. zeroing the
+	 * BSS of a loaded ELF segment).  Expand the fill pattern to
+	 * 32 bits and use stosl rather than stosb for the bulk of the
+	 * transfer, as per __memcpy().
+	 */
+	eax |= ( eax << 8 );
+	eax |= ( eax << 16 );
+	__asm__ __volatile__ ( "rep stosl"
+			       : "=&D" ( edi ), "=&c" ( discard_ecx )
+			       : "0" ( edi ), "1" ( len >> 2 ), "a" ( eax )
+			       : "memory" );
+	__asm__ __volatile__ ( "rep stosb"
+			       : "=&D" ( edi ), "=&c" ( discard_ecx )
+			       : "0" ( edi ), "1" ( len & 3 ), "a" ( eax )
+			       : "memory" );
+	return dest;
+}
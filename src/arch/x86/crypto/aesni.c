@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2025 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * AES instruction set (AES-NI) accelerated AES implementation
+ *
+ * The AES-NI instructions operate on the SSE register file.  They may
+ * therefore be used only when the CPU supports them and the platform
+ * has enabled access to the SSE register file (as is guaranteed on
+ * UEFI platforms, for example).
+ *
+ * The round keys expanded by the software implementation in aes.c are
+ * used directly: the decryption schedule constructed there is the
+ * Equivalent Inverse Cipher schedule expected by the AESDEC
+ * instructions.
+ */
+
+#include <stdint.h>
+#include <ipxe/cpuid.h>
+#include <ipxe/sse.h>
+#include <ipxe/aes.h>
+#include <ipxe/aesni.h>
+
+/**
+ * Check for AES-NI support
+ *
+ * @ret supported	AES-NI is supported
+ */
+int aesni_supported ( void ) {
+	static int supported = -1;
+	uint32_t discard_a;
+	uint32_t discard_b;
+	uint32_t ecx;
+	uint32_t discard_d;
+
+	/* Use cached result, if available */
+	if ( supported >= 0 )
+		return supported;
+
+	/* Check that the CPU supports the AES instruction set, and
+	 * that the SSE register file is usable (without which the
+	 * instructions would fault).
+	 */
+	supported = 0;
+	if ( ( cpuid_supported ( CPUID_FEATURES ) == 0 ) &&
+	     sse_supported() ) {
+		cpuid ( CPUID_FEATURES, 0, &discard_a, &discard_b, &ecx,
+			&discard_d );
+		if ( ecx & CPUID_FEATURES_INTEL_ECX_AES )
+			supported = 1;
+	}
+
+	return supported;
+}
+
+/**
+ * Encrypt a block using AES-NI
+ *
+ * @v aes		AES context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ */
+void aesni_encrypt ( struct aes_context *aes, const void *src, void *dst ) {
+	const union aes_matrix *key = aes->encrypt.key;
+	unsigned int round = ( aes->rounds - 2 );
+
+	__asm__ __volatile__ ( /* Perform initial round (AddRoundKey) */
+			       "movups ( %[src] ), %%xmm0\n\t"
+			       "movups ( %[key] ), %%xmm1\n\t"
+			       "pxor %%xmm1, %%xmm0\n\t"
+			       /* Perform intermediate rounds */
+			       "\n1:\n\t"
+			       "add $" _S2 ( AES_BLOCKSIZE ) ", %[key]\n\t"
+			       "movups ( %[key] ), %%xmm1\n\t"
+			       "aesenc %%xmm1, %%xmm0\n\t"
+			       "dec %[round]\n\t"
+			       "jnz 1b\n\t"
+			       /* Perform final round */
+			       "add $" _S2 ( AES_BLOCKSIZE ) ", %[key]\n\t"
+			       "movups ( %[key] ), %%xmm1\n\t"
+			       "aesenclast %%xmm1, %%xmm0\n\t"
+			       "movups %%xmm0, ( %[dst] )\n\t"
+			       : [key] "+r" ( key ), [round] "+r" ( round )
+			       : [src] "r" ( src ), [dst] "r" ( dst )
+			       : "memory" );
+}
+
+/**
+ * Decrypt a block using AES-NI
+ *
+ * @v aes		AES context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ */
+void aesni_decrypt ( struct aes_context *aes, const void *src, void *dst ) {
+	const union aes_matrix *key = aes->decrypt.key;
+	unsigned int round = ( aes->rounds - 2 );
+
+	__asm__ __volatile__ ( /* Perform initial round (AddRoundKey) */
+			       "movups ( %[src] ), %%xmm0\n\t"
+			       "movups ( %[key] ), %%xmm1\n\t"
+			       "pxor %%xmm1, %%xmm0\n\t"
+			       /* Perform intermediate rounds */
+			       "\n1:\n\t"
+			       "add $" _S2 ( AES_BLOCKSIZE ) ", %[key]\n\t"
+			       "movups ( %[key] ), %%xmm1\n\t"
+			       "aesdec %%xmm1, %%xmm0\n\t"
+			       "dec %[round]\n\t"
+			       "jnz 1b\n\t"
+			       /* Perform final round */
+			       "add $" _S2 ( AES_BLOCKSIZE ) ", %[key]\n\t"
+			       "movups ( %[key] ), %%xmm1\n\t"
+			       "aesdeclast %%xmm1, %%xmm0\n\t"
+			       "movups %%xmm0, ( %[dst] )\n\t"
+			       : [key] "+r" ( key ), [round] "+r" ( round )
+			       : [src] "r" ( src ), [dst] "r" ( dst )
+			       : "memory" );
+}
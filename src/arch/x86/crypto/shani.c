@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2025 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * SHA instruction set (SHA-NI) accelerated SHA-1 and SHA-256
+ *
+ * The SHA instructions operate on the SSE register file, and may
+ * therefore be used only when the CPU supports them and the platform
+ * has enabled access to the SSE register file.  Only registers
+ * %xmm0-%xmm7 are used, so that the implementation is usable by both
+ * i386 and x86_64 builds.
+ *
+ * The digests held within the SHA-1 and SHA-256 contexts are stored
+ * in big-endian form between blocks, and are byte-reversed on load
+ * and store.
+ */
+
+#include <stdint.h>
+#include <byteswap.h>
+#include <ipxe/cpuid.h>
+#include <ipxe/sse.h>
+#include <ipxe/sha1.h>
+#include <ipxe/sha256.h>
+#include <ipxe/shani.h>
+
+/** A 128 bit value, aligned for use as an SSE memory operand */
+union shani_u128 {
+	/** Raw bytes */
+	uint8_t byte[16];
+	/** Raw dwords */
+	uint32_t dword[4];
+} __attribute__ (( aligned ( 16 ) ));
+
+/** Byte shuffle mask to reverse the bytes within each dword */
+static const union shani_u128 shani_bswap32 = {
+	.byte = { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 },
+};
+
+/** Byte shuffle mask to reverse all sixteen bytes */
+static const union shani_u128 shani_bswap128 = {
+	.byte = { 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 },
+};
+
+/** SHA-256 round constants */
+static const uint32_t shani_sha256_k[64] __attribute__ (( aligned ( 16 ) )) = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/**
+ * Check for SHA-NI support
+ *
+ * @ret supported	SHA-NI is supported
+ */
+int shani_supported ( void ) {
+	static int supported = -1;
+	uint32_t discard_a;
+	uint32_t ebx;
+	uint32_t discard_c;
+	uint32_t discard_d;
+
+	/* Use cached result, if available */
+	if ( supported >= 0 )
+		return supported;
+
+	/* Check that the CPU supports the SHA instruction set, and
+	 * that the SSE register file is usable (without which the
+	 * instructions would fault).
+	 */
+	supported = 0;
+	if ( ( cpuid_supported ( CPUID_SEF ) == 0 ) &&
+	     sse_supported() ) {
+		cpuid ( CPUID_SEF, 0, &discard_a, &ebx, &discard_c,
+			&discard_d );
+		if ( ebx & CPUID_SEF_EBX_SHA )
+			supported = 1;
+	}
+
+	return supported;
+}
+
+/**
+ * Digest a block using the SHA-1 instructions
+ *
+ * @v context		SHA-1 context
+ */
+void shani_sha1_digest ( struct sha1_context *context ) {
+	struct sha1_digest *digest = &context->ddd.dd.digest;
+	union sha1_block *data = &context->ddd.dd.data;
+	union shani_u128 save;
+	uint32_t e_in = be32_to_cpu ( digest->h[4] );
+	uint32_t e_out;
+
+	/* Register usage: %xmm0 holds the initial E value, %xmm1
+	 * holds the working A-D state (with A in the high dword),
+	 * %xmm2 and %xmm3 alternate as the E/working-E registers, and
+	 * %xmm4-%xmm7 hold the message schedule.
+	 */
+	__asm__ __volatile__ (
+		/* Define a four-round block: message register \\ma is
+		 * consumed, \\e is the incoming E register, \\f is
+		 * the round function selector, and \\m1, \\m2 and
+		 * \\px control the message scheduling steps.
+		 */
+		".macro s1round4 ma, mb, mc, md, ei, eo, f, m1, m2, px\n\t"
+		"sha1nexte \\ma, \\ei\n\t"
+		"movdqa %%xmm1, \\eo\n\t"
+		".if \\m2\n\t"
+		"sha1msg2 \\ma, \\mb\n\t"
+		".endif\n\t"
+		"sha1rnds4 $\\f, \\ei, %%xmm1\n\t"
+		".if \\m1\n\t"
+		"sha1msg1 \\ma, \\md\n\t"
+		".endif\n\t"
+		".if \\px\n\t"
+		"pxor \\ma, \\mc\n\t"
+		".endif\n\t"
+		".endm\n\t"
+
+		/* Load digest (stored big-endian) and initial E */
+		"movdqu ( %[digest] ), %%xmm1\n\t"
+		"pshufb %[bswap128], %%xmm1\n\t"
+		"movups %%xmm1, %[save]\n\t"
+		"pxor %%xmm0, %%xmm0\n\t"
+		"pinsrd $3, %[e_in], %%xmm0\n\t"
+		"movdqa %%xmm0, %%xmm2\n\t"
+
+		/* Load message schedule (stored big-endian) */
+		"movdqu 0x00( %[data] ), %%xmm4\n\t"
+		"pshufb %[bswap128], %%xmm4\n\t"
+		"movdqu 0x10( %[data] ), %%xmm5\n\t"
+		"pshufb %[bswap128], %%xmm5\n\t"
+		"movdqu 0x20( %[data] ), %%xmm6\n\t"
+		"pshufb %[bswap128], %%xmm6\n\t"
+		"movdqu 0x30( %[data] ), %%xmm7\n\t"
+		"pshufb %[bswap128], %%xmm7\n\t"
+
+		/* Rounds 0-3 */
+		"paddd %%xmm4, %%xmm2\n\t"
+		"movdqa %%xmm1, %%xmm3\n\t"
+		"sha1rnds4 $0, %%xmm2, %%xmm1\n\t"
+
+		/* Rounds 4-79 */
+		"s1round4 %%xmm5, %%xmm6, %%xmm7, %%xmm4, "
+			"%%xmm3, %%xmm2, 0, 1, 0, 0\n\t"
+		"s1round4 %%xmm6, %%xmm7, %%xmm4, %%xmm5, "
+			"%%xmm2, %%xmm3, 0, 1, 0, 1\n\t"
+		"s1round4 %%xmm7, %%xmm4, %%xmm5, %%xmm6, "
+			"%%xmm3, %%xmm2, 0, 1, 1, 1\n\t"
+		"s1round4 %%xmm4, %%xmm5, %%xmm6, %%xmm7, "
+			"%%xmm2, %%xmm3, 0, 1, 1, 1\n\t"
+		"s1round4 %%xmm5, %%xmm6, %%xmm7, %%xmm4, "
+			"%%xmm3, %%xmm2, 1, 1, 1, 1\n\t"
+		"s1round4 %%xmm6, %%xmm7, %%xmm4, %%xmm5, "
+			"%%xmm2, %%xmm3, 1, 1, 1, 1\n\t"
+		"s1round4 %%xmm7, %%xmm4, %%xmm5, %%xmm6, "
+			"%%xmm3, %%xmm2, 1, 1, 1, 1\n\t"
+		"s1round4 %%xmm4, %%xmm5, %%xmm6, %%xmm7, "
+			"%%xmm2, %%xmm3, 1, 1, 1, 1\n\t"
+		"s1round4 %%xmm5, %%xmm6, %%xmm7, %%xmm4, "
+			"%%xmm3, %%xmm2, 1, 1, 1, 1\n\t"
+		"s1round4 %%xmm6, %%xmm7, %%xmm4, %%xmm5, "
+			"%%xmm2, %%xmm3, 2, 1, 1, 1\n\t"
+		"s1round4 %%xmm7, %%xmm4, %%xmm5, %%xmm6, "
+			"%%xmm3, %%xmm2, 2, 1, 1, 1\n\t"
+		"s1round4 %%xmm4, %%xmm5, %%xmm6, %%xmm7, "
+			"%%xmm2, %%xmm3, 2, 1, 1, 1\n\t"
+		"s1round4 %%xmm5, %%xmm6, %%xmm7, %%xmm4, "
+			"%%xmm3, %%xmm2, 2, 1, 1, 1\n\t"
+		"s1round4 %%xmm6, %%xmm7, %%xmm4, %%xmm5, "
+			"%%xmm2, %%xmm3, 2, 1, 1, 1\n\t"
+		"s1round4 %%xmm7, %%xmm4, %%xmm5, %%xmm6, "
+			"%%xmm3, %%xmm2, 3, 1, 1, 1\n\t"
+		"s1round4 %%xmm4, %%xmm5, %%xmm6, %%xmm7, "
+			"%%xmm2, %%xmm3, 3, 1, 1, 1\n\t"
+		"s1round4 %%xmm5, %%xmm6, %%xmm7, %%xmm4, "
+			"%%xmm3, %%xmm2, 3, 0, 1, 1\n\t"
+		"s1round4 %%xmm6, %%xmm7, %%xmm4, %%xmm5, "
+			"%%xmm2, %%xmm3, 3, 0, 1, 0\n\t"
+		"s1round4 %%xmm7, %%xmm4, %%xmm5, %%xmm6, "
+			"%%xmm3, %%xmm2, 3, 0, 0, 0\n\t"
+		".purgem s1round4\n\t"
+
+		/* Add in saved initial state */
+		"sha1nexte %%xmm0, %%xmm2\n\t"
+		"movups %[save], %%xmm3\n\t"
+		"paddd %%xmm3, %%xmm1\n\t"
+
+		/* Store digest in big-endian form */
+		"pextrd $3, %%xmm2, %[e_out]\n\t"
+		"pshufb %[bswap128], %%xmm1\n\t"
+		"movdqu %%xmm1, ( %[digest] )\n\t"
+		: [save] "+m" ( save ), [e_out] "=&r" ( e_out )
+		: [digest] "r" ( digest ), [data] "r" ( data ),
+		  [e_in] "r" ( e_in ), [bswap128] "m" ( shani_bswap128 )
+		: "memory", "cc" );
+	digest->h[4] = cpu_to_be32 ( e_out );
+}
+
+/**
+ * Digest a block using the SHA-256 instructions
+ *
+ * @v context		SHA-256 context
+ */
+void shani_sha256_digest ( struct sha256_context *context ) {
+	struct sha256_digest *digest = &context->ddd.dd.digest;
+	union sha256_block *data = &context->ddd.dd.data;
+	union shani_u128 save[2];
+
+	/* Register usage: %xmm0 holds the message words consumed by
+	 * sha256rnds2 (which uses it as an implicit operand), %xmm1
+	 * and %xmm2 hold the working state (as ABEF and CDGH), and
+	 * %xmm3-%xmm6 hold the message schedule, with %xmm7 used as
+	 * scratch space.
+	 */
+	__asm__ __volatile__ (
+		/* Define a four-round block: message register \\cur
+		 * is consumed, \\koff is the round constant offset,
+		 * \\ld selects loading the message from the data
+		 * block, and \\m1 and \\m2 control the message
+		 * scheduling steps.
+		 */
+		".macro s256round4 cur, prev, next, koff, ld, m1, m2\n\t"
+		".if \\ld\n\t"
+		"movdqu \\koff( %[data] ), %%xmm0\n\t"
+		"pshufb %[bswap32], %%xmm0\n\t"
+		"movdqa %%xmm0, \\cur\n\t"
+		".else\n\t"
+		"movdqa \\cur, %%xmm0\n\t"
+		".endif\n\t"
+		"paddd \\koff( %[k] ), %%xmm0\n\t"
+		"sha256rnds2 %%xmm1, %%xmm2\n\t"
+		".if \\m2\n\t"
+		"movdqa \\cur, %%xmm7\n\t"
+		"palignr $4, \\prev, %%xmm7\n\t"
+		"paddd %%xmm7, \\next\n\t"
+		"sha256msg2 \\cur, \\next\n\t"
+		".endif\n\t"
+		"pshufd $0x0e, %%xmm0, %%xmm0\n\t"
+		"sha256rnds2 %%xmm2, %%xmm1\n\t"
+		".if \\m1\n\t"
+		"sha256msg1 \\cur, \\prev\n\t"
+		".endif\n\t"
+		".endm\n\t"
+
+		/* Load digest (stored big-endian) as ABEF and CDGH */
+		"movdqu 0( %[digest] ), %%xmm1\n\t"
+		"movdqu 16( %[digest] ), %%xmm2\n\t"
+		"pshufb %[bswap32], %%xmm1\n\t"
+		"pshufb %[bswap32], %%xmm2\n\t"
+		"pshufd $0xb1, %%xmm1, %%xmm1\n\t"	/* CDAB */
+		"pshufd $0x1b, %%xmm2, %%xmm2\n\t"	/* EFGH */
+		"movdqa %%xmm1, %%xmm7\n\t"
+		"palignr $8, %%xmm2, %%xmm1\n\t"	/* ABEF */
+		"pblendw $0xf0, %%xmm7, %%xmm2\n\t"	/* CDGH */
+		"movups %%xmm1, %[save0]\n\t"
+		"movups %%xmm2, %[save1]\n\t"
+
+		/* Rounds 0-63 */
+		"s256round4 %%xmm3, %%xmm6, %%xmm4, 0x00, 1, 0, 0\n\t"
+		"s256round4 %%xmm4, %%xmm3, %%xmm5, 0x10, 1, 1, 0\n\t"
+		"s256round4 %%xmm5, %%xmm4, %%xmm6, 0x20, 1, 1, 0\n\t"
+		"s256round4 %%xmm6, %%xmm5, %%xmm3, 0x30, 1, 1, 1\n\t"
+		"s256round4 %%xmm3, %%xmm6, %%xmm4, 0x40, 0, 1, 1\n\t"
+		"s256round4 %%xmm4, %%xmm3, %%xmm5, 0x50, 0, 1, 1\n\t"
+		"s256round4 %%xmm5, %%xmm4, %%xmm6, 0x60, 0, 1, 1\n\t"
+		"s256round4 %%xmm6, %%xmm5, %%xmm3, 0x70, 0, 1, 1\n\t"
+		"s256round4 %%xmm3, %%xmm6, %%xmm4, 0x80, 0, 1, 1\n\t"
+		"s256round4 %%xmm4, %%xmm3, %%xmm5, 0x90, 0, 1, 1\n\t"
+		"s256round4 %%xmm5, %%xmm4, %%xmm6, 0xa0, 0, 1, 1\n\t"
+		"s256round4 %%xmm6, %%xmm5, %%xmm3, 0xb0, 0, 1, 1\n\t"
+		"s256round4 %%xmm3, %%xmm6, %%xmm4, 0xc0, 0, 1, 1\n\t"
+		"s256round4 %%xmm4, %%xmm3, %%xmm5, 0xd0, 0, 0, 1\n\t"
+		"s256round4 %%xmm5, %%xmm4, %%xmm6, 0xe0, 0, 0, 1\n\t"
+		"s256round4 %%xmm6, %%xmm5, %%xmm3, 0xf0, 0, 0, 0\n\t"
+		".purgem s256round4\n\t"
+
+		/* Add in saved initial state */
+		"movups %[save0], %%xmm7\n\t"
+		"paddd %%xmm7, %%xmm1\n\t"
+		"movups %[save1], %%xmm7\n\t"
+		"paddd %%xmm7, %%xmm2\n\t"
+
+		/* Store digest in big-endian form */
+		"pshufd $0x1b, %%xmm1, %%xmm1\n\t"	/* FEBA */
+		"pshufd $0xb1, %%xmm2, %%xmm2\n\t"	/* DCHG */
+		"movdqa %%xmm1, %%xmm7\n\t"
+		"pblendw $0xf0, %%xmm2, %%xmm1\n\t"	/* DCBA */
+		"palignr $8, %%xmm7, %%xmm2\n\t"	/* HGFE */
+		"pshufb %[bswap32], %%xmm1\n\t"
+		"pshufb %[bswap32], %%xmm2\n\t"
+		"movdqu %%xmm1, 0( %[digest] )\n\t"
+		"movdqu %%xmm2, 16( %[digest] )\n\t"
+		: [save0] "+m" ( save[0] ), [save1] "+m" ( save[1] )
+		: [digest] "r" ( digest ), [data] "r" ( data ),
+		  [k] "r" ( shani_sha256_k ),
+		  [bswap32] "m" ( shani_bswap32 )
+		: "memory", "cc" );
+}
@@ -326,32 +326,6 @@ static void bzimage_set_cmdline ( struct image *image,
 	DBGC ( image, "bzImage %p command line \"%s\"\n", image, cmdline );
 }
 
-/**
- * Parse standalone image command line for cpio parameters
- *
- * @v image		bzImage file
- * @v cpio		CPIO header
- * @v cmdline		Command line
- */
-static void bzimage_parse_cpio_cmdline ( struct image *image,
-					 struct cpio_header *cpio,
-					 const char *cmdline ) {
-	char *arg;
-	char *end;
-	unsigned int mode;
-
-	/* Look for "mode=" */
-	if ( ( arg = strstr ( cmdline, "mode=" ) ) ) {
-		arg += 5;
-		mode = strtoul ( arg, &end, 8 /* Octal for file mode */ );
-		if ( *end && ( *end != ' ' ) ) {
-			DBGC ( image, "bzImage %p strange \"mode=\""
-			       "terminator '%c'\n", image, *end );
-		}
-		cpio_set_field ( cpio->c_mode, ( 0100000 | mode ) );
-	}
-}
-
 /**
  * Align initrd length
  *
@@ -374,8 +348,7 @@ static inline size_t bzimage_align ( size_t len ) {
 static size_t bzimage_load_initrd ( struct image *image,
 				    struct image *initrd,
 				    userptr_t address ) {
-	char *filename = initrd->cmdline;
-	char *cmdline;
+	const char *filename = cpio_name ( initrd );
 	struct cpio_header cpio;
 	size_t offset;
 	size_t name_len;
@@ -385,30 +358,23 @@ static size_t bzimage_load_initrd ( struct image *image,
 	if ( initrd == image )
 		return 0;
 
-	/* Create cpio header for non-prebuilt images */
-	if ( filename && filename[0] ) {
-		cmdline = strchr ( filename, ' ' );
-		name_len = ( ( cmdline ? ( ( size_t ) ( cmdline - filename ) )
-			       : strlen ( filename ) ) + 1 /* NUL */ );
-		memset ( &cpio, '0', sizeof ( cpio ) );
-		memcpy ( cpio.c_magic, CPIO_MAGIC, sizeof ( cpio.c_magic ) );
-		cpio_set_field ( cpio.c_mode, 0100644 );
-		cpio_set_field ( cpio.c_nlink, 1 );
-		cpio_set_field ( cpio.c_filesize, initrd->len );
-		cpio_set_field ( cpio.c_namesize, name_len );
-		if ( cmdline ) {
-			bzimage_parse_cpio_cmdline ( image, &cpio,
-						     ( cmdline + 1 /* ' ' */ ));
-		}
-		offset = ( ( sizeof ( cpio ) + name_len + 0x03 ) & ~0x03 );
-	} else {
-		offset = 0;
-		name_len = 0;
-	}
+	/* Construct cpio header for non-prebuilt images */
+	offset = cpio_header ( initrd, &cpio );
+	name_len = cpio_name_len ( initrd );
 
-	/* Copy in initrd image body (and cpio header if applicable) */
+	/* Copy in initrd image body (and cpio header if applicable).
+	 * Reshuffling reserves space for the cpio header and so will
+	 * normally have left the body at its final address already,
+	 * in which case only the (small) header remains to be
+	 * written; this avoids a second pass over the (potentially
+	 * multi-gigabyte) image data.
+	 */
 	if ( address ) {
-		memmove_user ( address, offset, initrd->data, 0, initrd->len );
+		if ( userptr_sub ( initrd->data,
+				   userptr_add ( address, offset ) ) != 0 ) {
+			memmove_user ( address, offset, initrd->data, 0,
+				       initrd->len );
+		}
 		if ( offset ) {
 			memset_user ( address, 0, 0, offset );
 			copy_to_user ( address, 0, &cpio, sizeof ( cpio ) );
@@ -471,9 +437,8 @@ static int bzimage_check_initrds ( struct image *image,
 	bottom = userptr_add ( bzimg->pm_kernel, bzimg->pm_sz );
 
 	/* Check that total length fits within space available for
-	 * reshuffling.  This is a conservative check, since CPIO
-	 * headers are not present during reshuffling, but this
-	 * doesn't hurt and keeps the code simple.
+	 * reshuffling.  Reshuffling reserves space for CPIO headers,
+	 * so this length matches the reshuffled layout exactly.
 	 */
 	if ( ( rc = initrd_reshuffle_check ( len, bottom ) ) != 0 ) {
 		DBGC ( image, "bzImage %p failed reshuffle check: %s\n",
@@ -522,8 +487,13 @@ static void bzimage_load_initrds ( struct image *image,
 	if ( ! highest )
 		return;
 
-	/* Find highest usable address */
-	top = userptr_add ( highest->data, bzimage_align ( highest->len ) );
+	/* Find highest usable address.  Reshuffling will have left
+	 * space for the highest image's cpio header (if any)
+	 * immediately below its body.
+	 */
+	len = cpio_header_len ( highest );
+	top = userptr_add ( highest->data,
+			    ( bzimage_align ( len + highest->len ) - len ) );
 	if ( user_to_phys ( top, -1 ) > bzimg->mem_limit ) {
 		top = phys_to_user ( ( bzimg->mem_limit + 1 ) &
 				     ~( INITRD_ALIGN - 1 ) );
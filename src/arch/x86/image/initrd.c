@@ -29,6 +29,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/uaccess.h>
 #include <ipxe/init.h>
 #include <ipxe/memblock.h>
+#include <ipxe/cpio.h>
 
 /** @file
  *
@@ -42,6 +43,22 @@ userptr_t initrd_top;
 /** Minimum address available for initrd */
 userptr_t initrd_bottom;
 
+/**
+ * Calculate total length of initrd (including cpio header and padding)
+ *
+ * @v initrd		initrd image
+ * @ret len		Length rounded up to INITRD_ALIGN
+ *
+ * Space for the cpio header (if any) is reserved immediately below
+ * the image body, so that final assembly of the initrd needs to write
+ * only the headers rather than recopying every image body.
+ */
+static size_t initrd_len ( struct image *initrd ) {
+	size_t len = ( cpio_header_len ( initrd ) + initrd->len );
+
+	return ( ( len + INITRD_ALIGN - 1 ) & ~( INITRD_ALIGN - 1 ) );
+}
+
 /**
  * Squash initrds as high as possible in memory
  *
@@ -50,9 +67,9 @@ userptr_t initrd_bottom;
  */
 static userptr_t initrd_squash_high ( userptr_t top ) {
 	userptr_t current = top;
+	userptr_t dest;
 	struct image *initrd;
 	struct image *highest;
-	size_t len;
 
 	/* Squash up any initrds already within or below the region */
 	while ( 1 ) {
@@ -70,35 +87,42 @@ static userptr_t initrd_squash_high ( userptr_t top ) {
 		if ( ! highest )
 			break;
 
-		/* Move this image to its final position */
-		len = ( ( highest->len + INITRD_ALIGN - 1 ) &
-			~( INITRD_ALIGN - 1 ) );
-		current = userptr_sub ( current, len );
-		DBGC ( &images, "INITRD squashing %s [%#08lx,%#08lx)->"
-		       "[%#08lx,%#08lx)\n", highest->name,
-		       user_to_phys ( highest->data, 0 ),
-		       user_to_phys ( highest->data, highest->len ),
-		       user_to_phys ( current, 0 ),
-		       user_to_phys ( current, highest->len ) );
-		memmove_user ( current, 0, highest->data, 0, highest->len );
-		highest->data = current;
+		/* Move this image to its final position (leaving
+		 * space for its cpio header, if any), unless it is
+		 * already there (in which case copying would be a
+		 * wasted pass over the entire image).
+		 */
+		current = userptr_sub ( current, initrd_len ( highest ) );
+		dest = userptr_add ( current, cpio_header_len ( highest ) );
+		if ( userptr_sub ( highest->data, dest ) != 0 ) {
+			DBGC ( &images, "INITRD squashing %s [%#08lx,%#08lx)->"
+			       "[%#08lx,%#08lx)\n", highest->name,
+			       user_to_phys ( highest->data, 0 ),
+			       user_to_phys ( highest->data, highest->len ),
+			       user_to_phys ( dest, 0 ),
+			       user_to_phys ( dest, highest->len ) );
+			memmove_user ( dest, 0, highest->data, 0,
+				       highest->len );
+			highest->data = dest;
+		}
 	}
 
 	/* Copy any remaining initrds (e.g. embedded images) to the region */
 	for_each_image ( initrd ) {
 		if ( userptr_sub ( initrd->data, top ) >= 0 ) {
-			len = ( ( initrd->len + INITRD_ALIGN - 1 ) &
-				~( INITRD_ALIGN - 1 ) );
-			current = userptr_sub ( current, len );
+			current = userptr_sub ( current,
+						initrd_len ( initrd ) );
+			dest = userptr_add ( current,
+					     cpio_header_len ( initrd ) );
 			DBGC ( &images, "INITRD copying %s [%#08lx,%#08lx)->"
 			       "[%#08lx,%#08lx)\n", initrd->name,
 			       user_to_phys ( initrd->data, 0 ),
 			       user_to_phys ( initrd->data, initrd->len ),
-			       user_to_phys ( current, 0 ),
-			       user_to_phys ( current, initrd->len ) );
-			memcpy_user ( current, 0, initrd->data, 0,
+			       user_to_phys ( dest, 0 ),
+			       user_to_phys ( dest, initrd->len ) );
+			memcpy_user ( dest, 0, initrd->data, 0,
 				      initrd->len );
-			initrd->data = current;
+			initrd->data = dest;
 		}
 	}
 
@@ -115,9 +139,12 @@ static userptr_t initrd_squash_high ( userptr_t top ) {
  */
 static void initrd_swap ( struct image *low, struct image *high,
 			  userptr_t free, size_t free_len ) {
+	size_t low_len = initrd_len ( low );
+	size_t high_len = initrd_len ( high );
+	userptr_t base = userptr_add ( low->data,
+				       -( cpio_header_len ( low ) ) );
 	size_t len = 0;
 	size_t frag_len;
-	size_t new_len;
 
 	DBGC ( &images, "INITRD swapping %s [%#08lx,%#08lx)<->[%#08lx,%#08lx) "
 	       "%s\n", low->name, user_to_phys ( low->data, 0 ),
@@ -129,26 +156,25 @@ static void initrd_swap ( struct image *low, struct image *high,
 	free_len &= ~( INITRD_ALIGN - 1 );
 	assert ( free_len > 0 );
 
-	/* Swap image data */
-	while ( len < high->len ) {
+	/* Swap regions (including reserved cpio header space) */
+	while ( len < high_len ) {
 
 		/* Calculate maximum fragment length */
-		frag_len = ( high->len - len );
+		frag_len = ( high_len - len );
 		if ( frag_len > free_len )
 			frag_len = free_len;
-		new_len = ( ( len + frag_len + INITRD_ALIGN - 1 ) &
-			    ~( INITRD_ALIGN - 1 ) );
 
 		/* Swap fragments */
-		memcpy_user ( free, 0, high->data, len, frag_len );
-		memmove_user ( low->data, new_len, low->data, len, low->len );
-		memcpy_user ( low->data, len, free, 0, frag_len );
-		len = new_len;
+		memcpy_user ( free, 0, base, ( low_len + len ), frag_len );
+		memmove_user ( base, ( len + frag_len ), base, len, low_len );
+		memcpy_user ( base, len, free, 0, frag_len );
+		len += frag_len;
 	}
 
 	/* Adjust data pointers */
-	high->data = low->data;
-	low->data = userptr_add ( low->data, len );
+	high->data = userptr_add ( base, cpio_header_len ( high ) );
+	low->data = userptr_add ( base, ( high_len +
+					  cpio_header_len ( low ) ) );
 }
 
 /**
@@ -161,22 +187,23 @@ static void initrd_swap ( struct image *low, struct image *high,
 static int initrd_swap_any ( userptr_t free, size_t free_len ) {
 	struct image *low;
 	struct image *high;
-	size_t padded_len;
 	userptr_t adjacent;
 
 	/* Find any pair of initrds that can be swapped */
 	for_each_image ( low ) {
 
-		/* Calculate location of adjacent image (if any) */
-		padded_len = ( ( low->len + INITRD_ALIGN - 1 ) &
-			       ~( INITRD_ALIGN - 1 ) );
-		adjacent = userptr_add ( low->data, padded_len );
+		/* Calculate location of adjacent image region (if any) */
+		adjacent = userptr_add ( low->data,
+					 ( initrd_len ( low ) -
+					   cpio_header_len ( low ) ) );
 
 		/* Search for adjacent image */
 		for_each_image ( high ) {
 
 			/* If we have found the adjacent image, swap and exit */
-			if ( high->data == adjacent ) {
+			if ( userptr_add ( high->data,
+					   -( cpio_header_len ( high ) ) )
+			     == adjacent ) {
 				initrd_swap ( low, high, free, free_len );
 				return 1;
 			}
@@ -136,5 +136,7 @@ static int sdi_probe ( struct image *image ) {
 struct image_type sdi_image_type __image_type ( PROBE_NORMAL ) = {
 	.name = "SDI",
 	.probe = sdi_probe,
+	.magic = "$SDI",
+	.magic_len = 4,
 	.exec = sdi_exec,
 };
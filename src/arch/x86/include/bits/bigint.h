@@ -4,6 +4,11 @@
 /** @file
  *
  * Big integer support
+ *
+ * Big integers use 64-bit elements in long mode (where each multiply
+ * instruction produces four times as many product bits as a 32-bit
+ * multiply, quartering the number of inner-loop iterations for the
+ * same overall width), and 32-bit elements otherwise.
  */
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
@@ -11,9 +16,18 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <string.h>
 
+#ifdef __x86_64__
+
+/** Element of a big integer */
+typedef uint64_t bigint_element_t;
+
+#else /* __x86_64__ */
+
 /** Element of a big integer */
 typedef uint32_t bigint_element_t;
 
+#endif /* __x86_64__ */
+
 /**
  * Initialise big integer
  *
@@ -23,7 +37,7 @@ typedef uint32_t bigint_element_t;
  * @v len		Length of raw data
  */
 static inline __attribute__ (( always_inline )) void
-bigint_init_raw ( uint32_t *value0, unsigned int size,
+bigint_init_raw ( bigint_element_t *value0, unsigned int size,
 		  const void *data, size_t len ) {
 	long pad_len = ( sizeof ( bigint_t ( size ) ) - len );
 	void *discard_D;
@@ -51,7 +65,7 @@ bigint_init_raw ( uint32_t *value0, unsigned int size,
  * @v size		Number of elements
  */
 static inline __attribute__ (( always_inline )) void
-bigint_add_raw ( const uint32_t *addend0, uint32_t *value0,
+bigint_add_raw ( const bigint_element_t *addend0, bigint_element_t *value0,
 		 unsigned int size ) {
 	long index;
 	void *discard_S;
@@ -59,8 +73,13 @@ bigint_add_raw ( const uint32_t *addend0, uint32_t *value0,
 
 	__asm__ __volatile__ ( "xor %0, %0\n\t" /* Zero %0 and clear CF */
 			       "\n1:\n\t"
+#ifdef __x86_64__
+			       "lodsq\n\t"
+			       "adcq %%rax, (%3,%0,8)\n\t"
+#else
 			       "lodsl\n\t"
 			       "adcl %%eax, (%3,%0,4)\n\t"
+#endif
 			       "inc %0\n\t" /* Does not affect CF */
 			       "loop 1b\n\t"
 			       : "=&r" ( index ), "=&S" ( discard_S ),
@@ -77,16 +96,21 @@ bigint_add_raw ( const uint32_t *addend0, uint32_t *value0,
  * @v size		Number of elements
  */
 static inline __attribute__ (( always_inline )) void
-bigint_subtract_raw ( const uint32_t *subtrahend0, uint32_t *value0,
-		      unsigned int size ) {
+bigint_subtract_raw ( const bigint_element_t *subtrahend0,
+		      bigint_element_t *value0, unsigned int size ) {
 	long index;
 	void *discard_S;
 	long discard_c;
 
 	__asm__ __volatile__ ( "xor %0, %0\n\t" /* Zero %0 and clear CF */
 			       "\n1:\n\t"
+#ifdef __x86_64__
+			       "lodsq\n\t"
+			       "sbbq %%rax, (%3,%0,8)\n\t"
+#else
 			       "lodsl\n\t"
 			       "sbbl %%eax, (%3,%0,4)\n\t"
+#endif
 			       "inc %0\n\t" /* Does not affect CF */
 			       "loop 1b\n\t"
 			       : "=&r" ( index ), "=&S" ( discard_S ),
@@ -103,13 +127,17 @@ bigint_subtract_raw ( const uint32_t *subtrahend0, uint32_t *value0,
  * @v size		Number of elements
  */
 static inline __attribute__ (( always_inline )) void
-bigint_rol_raw ( uint32_t *value0, unsigned int size ) {
+bigint_rol_raw ( bigint_element_t *value0, unsigned int size ) {
 	long index;
 	long discard_c;
 
 	__asm__ __volatile__ ( "xor %0, %0\n\t" /* Zero %0 and clear CF */
 			       "\n1:\n\t"
+#ifdef __x86_64__
+			       "rclq $1, (%2,%0,8)\n\t"
+#else
 			       "rcll $1, (%2,%0,4)\n\t"
+#endif
 			       "inc %0\n\t" /* Does not affect CF */
 			       "loop 1b\n\t"
 			       : "=&r" ( index ), "=&c" ( discard_c )
@@ -123,12 +151,16 @@ bigint_rol_raw ( uint32_t *value0, unsigned int size ) {
  * @v size		Number of elements
  */
 static inline __attribute__ (( always_inline )) void
-bigint_ror_raw ( uint32_t *value0, unsigned int size ) {
+bigint_ror_raw ( bigint_element_t *value0, unsigned int size ) {
 	long discard_c;
 
 	__asm__ __volatile__ ( "clc\n\t"
 			       "\n1:\n\t"
+#ifdef __x86_64__
+			       "rcrq $1, -8(%1,%0,8)\n\t"
+#else
 			       "rcrl $1, -4(%1,%0,4)\n\t"
+#endif
 			       "loop 1b\n\t"
 			       : "=&c" ( discard_c )
 			       : "r" ( value0 ), "0" ( size ) );
@@ -142,13 +174,17 @@ bigint_ror_raw ( uint32_t *value0, unsigned int size ) {
  * @ret is_zero		Big integer is equal to zero
  */
 static inline __attribute__ (( always_inline, pure )) int
-bigint_is_zero_raw ( const uint32_t *value0, unsigned int size ) {
+bigint_is_zero_raw ( const bigint_element_t *value0, unsigned int size ) {
 	void *discard_D;
 	long discard_c;
 	int result;
 
 	__asm__ __volatile__ ( "xor %0, %0\n\t" /* Set ZF */
+#ifdef __x86_64__
+			       "repe scasq\n\t"
+#else
 			       "repe scasl\n\t"
+#endif
 			       "sete %b0\n\t"
 			       : "=&a" ( result ), "=&D" ( discard_D ),
 				 "=&c" ( discard_c )
@@ -165,7 +201,8 @@ bigint_is_zero_raw ( const uint32_t *value0, unsigned int size ) {
  * @ret geq		Big integer is greater than or equal to the reference
  */
 static inline __attribute__ (( always_inline, pure )) int
-bigint_is_geq_raw ( const uint32_t *value0, const uint32_t *reference0,
+bigint_is_geq_raw ( const bigint_element_t *value0,
+		    const bigint_element_t *reference0,
 		    unsigned int size ) {
 	const bigint_t ( size ) __attribute__ (( may_alias )) *value =
 		( ( const void * ) value0 );
@@ -178,8 +215,13 @@ bigint_is_geq_raw ( const uint32_t *value0, const uint32_t *reference0,
 
 	__asm__ __volatile__ ( "std\n\t"
 			       "\n1:\n\t"
+#ifdef __x86_64__
+			       "lodsq\n\t"
+			       "scasq\n\t"
+#else
 			       "lodsl\n\t"
 			       "scasl\n\t"
+#endif
 			       "loope 1b\n\t"
 			       "setae %b0\n\t"
 			       "cld\n\t"
@@ -201,14 +243,15 @@ bigint_is_geq_raw ( const uint32_t *value0, const uint32_t *reference0,
  * @ret is_set		Bit is set
  */
 static inline __attribute__ (( always_inline )) int
-bigint_bit_is_set_raw ( const uint32_t *value0, unsigned int size,
+bigint_bit_is_set_raw ( const bigint_element_t *value0, unsigned int size,
 			unsigned int bit ) {
 	const bigint_t ( size ) __attribute__ (( may_alias )) *value =
 		( ( const void * ) value0 );
 	unsigned int index = ( bit / ( 8 * sizeof ( value->element[0] ) ) );
 	unsigned int subindex = ( bit % ( 8 * sizeof ( value->element[0] ) ) );
 
-	return ( value->element[index] & ( 1 << subindex ) );
+	return ( !! ( value->element[index] &
+		      ( ( bigint_element_t ) 1 << subindex ) ) );
 }
 
 /**
@@ -219,21 +262,30 @@ bigint_bit_is_set_raw ( const uint32_t *value0, unsigned int size,
  * @ret max_bit		Highest bit set + 1 (or 0 if no bits set)
  */
 static inline __attribute__ (( always_inline )) int
-bigint_max_set_bit_raw ( const uint32_t *value0, unsigned int size ) {
+bigint_max_set_bit_raw ( const bigint_element_t *value0, unsigned int size ) {
 	long discard_c;
-	int result;
+	long result;
 
 	__asm__ __volatile__ ( "\n1:\n\t"
-			       "bsrl -4(%2,%1,4), %0\n\t"
+#ifdef __x86_64__
+			       "bsrq -8(%2,%1,8), %0\n\t"
+			       "loopz 1b\n\t"
+			       "rol %1\n\t" /* Do not affect ZF */
+			       "rol %1\n\t"
+			       "rol %1\n\t"
+			       "leaq 1(%q0,%q1,8), %q0\n\t"
+#else
+			       "bsrl -4(%2,%1,4), %k0\n\t"
 			       "loopz 1b\n\t"
 			       "rol %1\n\t" /* Does not affect ZF */
 			       "rol %1\n\t"
 			       "leal 1(%k0,%k1,8), %k0\n\t"
+#endif
 			       "jnz 2f\n\t"
 			       "xor %0, %0\n\t"
 			       "\n2:\n\t"
 			       : "=&r" ( result ), "=&c" ( discard_c )
-			       : "r" ( value0 ), "1" ( size ) );
+			       : "r" ( value0 ), "1" ( ( long ) size ) );
 	return result;
 }
 
@@ -246,17 +298,26 @@ bigint_max_set_bit_raw ( const uint32_t *value0, unsigned int size ) {
  * @v dest_size		Number of elements in destination big integer
  */
 static inline __attribute__ (( always_inline )) void
-bigint_grow_raw ( const uint32_t *source0, unsigned int source_size,
-		  uint32_t *dest0, unsigned int dest_size ) {
+bigint_grow_raw ( const bigint_element_t *source0, unsigned int source_size,
+		  bigint_element_t *dest0, unsigned int dest_size ) {
 	long pad_size = ( dest_size - source_size );
 	void *discard_D;
 	void *discard_S;
 	long discard_c;
 
-	__asm__ __volatile__ ( "rep movsl\n\t"
+	__asm__ __volatile__ (
+#ifdef __x86_64__
+			       "rep movsq\n\t"
+#else
+			       "rep movsl\n\t"
+#endif
 			       "xorl %%eax, %%eax\n\t"
 			       "mov %3, %2\n\t"
+#ifdef __x86_64__
+			       "rep stosq\n\t"
+#else
 			       "rep stosl\n\t"
+#endif
 			       : "=&D" ( discard_D ), "=&S" ( discard_S ),
 				 "=&c" ( discard_c )
 			       : "g" ( pad_size ), "0" ( dest0 ),
@@ -273,13 +334,19 @@ bigint_grow_raw ( const uint32_t *source0, unsigned int source_size,
  * @v dest_size		Number of elements in destination big integer
  */
 static inline __attribute__ (( always_inline )) void
-bigint_shrink_raw ( const uint32_t *source0, unsigned int source_size __unused,
-		    uint32_t *dest0, unsigned int dest_size ) {
+bigint_shrink_raw ( const bigint_element_t *source0,
+		    unsigned int source_size __unused,
+		    bigint_element_t *dest0, unsigned int dest_size ) {
 	void *discard_D;
 	void *discard_S;
 	long discard_c;
 
-	__asm__ __volatile__ ( "rep movsl\n\t"
+	__asm__ __volatile__ (
+#ifdef __x86_64__
+			       "rep movsq\n\t"
+#else
+			       "rep movsl\n\t"
+#endif
 			       : "=&D" ( discard_D ), "=&S" ( discard_S ),
 				 "=&c" ( discard_c )
 			       : "0" ( dest0 ), "1" ( source0 ),
@@ -296,8 +363,8 @@ bigint_shrink_raw ( const uint32_t *source0, unsigned int source_size __unused,
  * @v len		Length of output buffer
  */
 static inline __attribute__ (( always_inline )) void
-bigint_done_raw ( const uint32_t *value0, unsigned int size __unused,
-		  void *out, size_t len ) {
+bigint_done_raw ( const bigint_element_t *value0,
+		  unsigned int size __unused, void *out, size_t len ) {
 	void *discard_D;
 	long discard_c;
 
@@ -311,8 +378,9 @@ bigint_done_raw ( const uint32_t *value0, unsigned int size __unused,
 			       : "eax" );
 }
 
-extern void bigint_multiply_raw ( const uint32_t *multiplicand0,
-				  const uint32_t *multiplier0,
-				  uint32_t *value0, unsigned int size );
+extern void bigint_multiply_raw ( const bigint_element_t *multiplicand0,
+				  const bigint_element_t *multiplier0,
+				  bigint_element_t *value0,
+				  unsigned int size );
 
 #endif /* _BITS_BIGINT_H */
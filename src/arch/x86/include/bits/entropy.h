@@ -9,6 +9,7 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+#include <ipxe/rdrand_entropy.h>
 #include <ipxe/rtc_entropy.h>
 
 #endif /* _BITS_ENTROPY_H */
@@ -0,0 +1,14 @@
+#ifndef _BITS_SHA1_H
+#define _BITS_SHA1_H
+
+/** @file
+ *
+ * x86-specific SHA-1 API implementations
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <ipxe/shani.h>
+
+#endif /* _BITS_SHA1_H */
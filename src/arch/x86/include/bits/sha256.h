@@ -0,0 +1,14 @@
+#ifndef _BITS_SHA256_H
+#define _BITS_SHA256_H
+
+/** @file
+ *
+ * x86-specific SHA-256 API implementations
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <ipxe/shani.h>
+
+#endif /* _BITS_SHA256_H */
@@ -196,25 +196,7 @@ memmove ( void *dest, const void *src, size_t len ) {
 	}
 }
 
-/**
- * Fill memory region
- *
- * @v dest		Destination address
- * @v fill		Fill pattern
- * @v len		Length
- * @ret dest		Destination address
- */
-static inline __attribute__ (( always_inline )) void *
-__memset ( void *dest, int fill, size_t len ) {
-	void *discard_D;
-	size_t discard_c;
-
-	__asm__ __volatile__ ( "rep stosb"
-			       : "=&D" ( discard_D ), "=&c" ( discard_c )
-			       : "0" ( dest ), "1" ( len ), "a" ( fill )
-			       : "memory" );
-	return dest;
-}
+extern void * __memset ( void *dest, int fill, size_t len );
 
 /**
  * Fill memory region with zero (where length is a compile-time constant)
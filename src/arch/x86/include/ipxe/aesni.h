@@ -0,0 +1,56 @@
+#ifndef _IPXE_AESNI_H
+#define _IPXE_AESNI_H
+
+/** @file
+ *
+ * AES instruction set (AES-NI) accelerated AES implementation
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+struct aes_context;
+
+extern int aesni_supported ( void );
+extern void aesni_encrypt ( struct aes_context *aes, const void *src,
+			    void *dst );
+extern void aesni_decrypt ( struct aes_context *aes, const void *src,
+			    void *dst );
+
+/**
+ * Check for accelerated AES support
+ *
+ * @ret supported	Accelerated implementation is supported
+ */
+static inline int aes_accel_supported ( void ) {
+
+	return aesni_supported();
+}
+
+/**
+ * Encrypt a block using the accelerated implementation
+ *
+ * @v aes		AES context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ */
+static inline void aes_accel_encrypt ( struct aes_context *aes,
+				       const void *src, void *dst ) {
+
+	aesni_encrypt ( aes, src, dst );
+}
+
+/**
+ * Decrypt a block using the accelerated implementation
+ *
+ * @v aes		AES context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ */
+static inline void aes_accel_decrypt ( struct aes_context *aes,
+				       const void *src, void *dst ) {
+
+	aesni_decrypt ( aes, src, dst );
+}
+
+#endif /* _IPXE_AESNI_H */
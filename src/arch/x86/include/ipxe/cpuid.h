@@ -39,9 +39,30 @@ struct x86_features {
 /** Get standard features */
 #define CPUID_FEATURES 0x00000001UL
 
+/** AES instruction set is present */
+#define CPUID_FEATURES_INTEL_ECX_AES 0x02000000UL
+
+/** RDRAND instruction is present */
+#define CPUID_FEATURES_INTEL_ECX_RDRAND 0x40000000UL
+
 /** Hypervisor is present */
 #define CPUID_FEATURES_INTEL_ECX_HYPERVISOR 0x80000000UL
 
+/** Get structured extended features */
+#define CPUID_SEF 0x00000007UL
+
+/** Get TSC/crystal clock ratio and crystal clock frequency */
+#define CPUID_TSC 0x00000015UL
+
+/** Get processor base frequency */
+#define CPUID_FREQUENCY 0x00000016UL
+
+/** RDSEED instruction is present */
+#define CPUID_SEF_EBX_RDSEED 0x00040000UL
+
+/** SHA extensions are present */
+#define CPUID_SEF_EBX_SHA 0x20000000UL
+
 /** Get largest extended function */
 #define CPUID_AMD_MAX_FN 0x80000000UL
 
@@ -0,0 +1,59 @@
+#ifndef _IPXE_RDRAND_ENTROPY_H
+#define _IPXE_RDRAND_ENTROPY_H
+
+/** @file
+ *
+ * RDRAND/RDSEED entropy source
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+
+#ifdef ENTROPY_RDRAND
+#define ENTROPY_PREFIX_rdrand
+#else
+#define ENTROPY_PREFIX_rdrand __rdrand_
+#endif
+
+/**
+ * min-entropy per sample
+ *
+ * @ret min_entropy	min-entropy of each sample
+ */
+static inline __always_inline min_entropy_t
+ENTROPY_INLINE ( rdrand, min_entropy_per_sample ) ( void ) {
+
+	/* Each sample is one byte drawn from the on-chip digital
+	 * random number generator.  RDSEED provides conditioned
+	 * samples direct from the entropy source, and RDRAND provides
+	 * output from a DRBG that is continuously reseeded from the
+	 * same source; both are designed to provide full-entropy
+	 * output.
+	 *
+	 * Since we cannot inspect the hardware noise source directly,
+	 * we deliberately claim only half of the stated entropy and
+	 * let the health tests in rdrand_sample() guard against gross
+	 * failure.  The cost of the extra samples is negligible given
+	 * the speed of the instruction.
+	 */
+	return MIN_ENTROPY ( 4.0 );
+}
+
+extern int rdrand_sample ( noise_sample_t *noise );
+
+/**
+ * Get noise sample
+ *
+ * @ret noise		Noise sample
+ * @ret rc		Return status code
+ */
+static inline __always_inline int
+ENTROPY_INLINE ( rdrand, get_noise ) ( noise_sample_t *noise ) {
+
+	/* Get sample */
+	return rdrand_sample ( noise );
+}
+
+#endif /* _IPXE_RDRAND_ENTROPY_H */
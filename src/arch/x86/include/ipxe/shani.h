@@ -0,0 +1,59 @@
+#ifndef _IPXE_SHANI_H
+#define _IPXE_SHANI_H
+
+/** @file
+ *
+ * SHA instruction set (SHA-NI) accelerated SHA-1 and SHA-256
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+struct sha1_context;
+struct sha256_context;
+
+extern int shani_supported ( void );
+extern void shani_sha1_digest ( struct sha1_context *context );
+extern void shani_sha256_digest ( struct sha256_context *context );
+
+/**
+ * Check for accelerated SHA-1 support
+ *
+ * @ret supported	Accelerated implementation is supported
+ */
+static inline int sha1_accel_supported ( void ) {
+
+	return shani_supported();
+}
+
+/**
+ * Digest a block using the accelerated implementation
+ *
+ * @v context		SHA-1 context
+ */
+static inline void sha1_accel_digest ( struct sha1_context *context ) {
+
+	shani_sha1_digest ( context );
+}
+
+/**
+ * Check for accelerated SHA-256 support
+ *
+ * @ret supported	Accelerated implementation is supported
+ */
+static inline int sha256_accel_supported ( void ) {
+
+	return shani_supported();
+}
+
+/**
+ * Digest a block using the accelerated implementation
+ *
+ * @v context		SHA-256 context
+ */
+static inline void sha256_accel_digest ( struct sha256_context *context ) {
+
+	shani_sha256_digest ( context );
+}
+
+#endif /* _IPXE_SHANI_H */
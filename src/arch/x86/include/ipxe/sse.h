@@ -0,0 +1,41 @@
+#ifndef _IPXE_SSE_H
+#define _IPXE_SSE_H
+
+/** @file
+ *
+ * SSE register file availability
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** CR4 OS support for FXSAVE and FXRSTOR (and hence SSE) */
+#define SSE_CR4_OSFXSR 0x00000200UL
+
+/**
+ * Check that the SSE register file is usable
+ *
+ * @ret supported	SSE registers may be used
+ */
+static inline __attribute__ (( always_inline )) int sse_supported ( void ) {
+	unsigned long cs;
+	unsigned long cr4;
+
+	/* The control registers can be read only at privilege level
+	 * zero.  If the platform runs us at a lesser privilege level
+	 * (e.g. as a Linux userspace process) then the operating
+	 * system is responsible for maintaining the SSE register
+	 * state, and the SSE registers may be used freely.
+	 */
+	__asm__ ( "mov %%cs, %0" : "=r" ( cs ) );
+	if ( cs & 0x3 )
+		return 1;
+
+	/* Check that the platform has enabled access to the SSE
+	 * register file (without which SSE instructions would fault).
+	 */
+	__asm__ ( "mov %%cr4, %0" : "=r" ( cr4 ) );
+	return ( ( cr4 & SSE_CR4_OSFXSR ) != 0 );
+}
+
+#endif /* _IPXE_SSE_H */
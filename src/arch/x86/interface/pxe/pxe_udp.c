@@ -40,6 +40,16 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+/** Maximum number of queued received packets
+ *
+ * The connection is promiscuous, so traffic for ports that the NBP
+ * never reads would otherwise accumulate without bound.  When the
+ * queue is full, the oldest packet is dropped.
+ */
+#ifndef PXE_UDP_NUM_RX
+#define PXE_UDP_NUM_RX 32
+#endif
+
 /** A PXE UDP pseudo-header */
 struct pxe_udp_pseudo_header {
 	/** Source IP address */
@@ -60,6 +70,8 @@ struct pxe_udp_connection {
 	struct sockaddr_in local;
 	/** List of received packets */
 	struct list_head list;
+	/** Number of received packets in list */
+	unsigned int count;
 };
 
 /**
@@ -102,8 +114,16 @@ static int pxe_udp_deliver ( struct pxe_udp_connection *pxe_udp,
 	pshdr->dest_ip = sin_dest->sin_addr.s_addr;
 	pshdr->d_port = sin_dest->sin_port;
 
-	/* Add to queue */
+	/* Add to queue, dropping the oldest packet if the queue is full */
 	list_add_tail ( &iobuf->list, &pxe_udp->list );
+	if ( ++pxe_udp->count > PXE_UDP_NUM_RX ) {
+		iobuf = list_first_entry ( &pxe_udp->list, struct io_buffer,
+					   list );
+		DBG ( "PXE UDP dropping oldest received packet\n" );
+		list_del ( &iobuf->list );
+		free_iob ( iobuf );
+		pxe_udp->count--;
+	}
 
 	return 0;
 
@@ -239,6 +259,7 @@ pxenv_udp_close ( struct s_PXENV_UDP_CLOSE *pxenv_udp_close ) {
 		list_del ( &iobuf->list );
 		free_iob ( iobuf );
 	}
+	pxe_udp.count = 0;
 
 	pxenv_udp_close->Status = PXENV_STATUS_SUCCESS;
 	return PXENV_EXIT_SUCCESS;
@@ -391,14 +412,18 @@ pxenv_udp_write ( struct s_PXENV_UDP_WRITE *pxenv_udp_write ) {
  * s_PXENV_UDP_READ::d_port, but Microsoft Windows' NTLDR program
  * expects us to do so, and will fail if we don't.
  *
+ * @note Packets not matching the requested destination address and
+ * port remain queued, since NBPs such as wdsnbp multiplex several
+ * ports over the single connection and a read for one port must not
+ * discard packets destined for another.
+ *
  */
 static PXENV_EXIT_t pxenv_udp_read ( struct s_PXENV_UDP_READ *pxenv_udp_read ) {
 	struct in_addr dest_ip_wanted = { .s_addr = pxenv_udp_read->dest_ip };
-	struct in_addr dest_ip;
 	struct io_buffer *iobuf;
+	struct io_buffer *found = NULL;
 	struct pxe_udp_pseudo_header *pshdr;
 	uint16_t d_port_wanted = pxenv_udp_read->d_port;
-	uint16_t d_port;
 	userptr_t buffer;
 	size_t len;
 
@@ -406,36 +431,32 @@ static PXENV_EXIT_t pxenv_udp_read ( struct s_PXENV_UDP_READ *pxenv_udp_read ) {
 	if ( list_empty ( &pxe_udp.list ) )
 		step();
 
-	/* Remove first packet from the queue */
-	iobuf = list_first_entry ( &pxe_udp.list, struct io_buffer, list );
-	if ( ! iobuf ) {
-		/* No packet received */
+	/* Find first queued packet matching the requested filter */
+	list_for_each_entry ( iobuf, &pxe_udp.list, list ) {
+		pshdr = iobuf->data;
+		if ( dest_ip_wanted.s_addr &&
+		     ( dest_ip_wanted.s_addr != pshdr->dest_ip ) )
+			continue;
+		if ( d_port_wanted && ( d_port_wanted != pshdr->d_port ) )
+			continue;
+		found = iobuf;
+		break;
+	}
+	if ( ! found ) {
+		/* No matching packet received */
 		DBG2 ( "PXENV_UDP_READ\n" );
 		goto no_packet;
 	}
+	iobuf = found;
 	list_del ( &iobuf->list );
+	pxe_udp.count--;
 
 	/* Strip pseudo-header */
 	assert ( iob_len ( iobuf ) >= sizeof ( *pshdr ) );
 	pshdr = iobuf->data;
 	iob_pull ( iobuf, sizeof ( *pshdr ) );
-	dest_ip.s_addr = pshdr->dest_ip;
-	d_port = pshdr->d_port;
 	DBG ( "PXENV_UDP_READ" );
 
-	/* Filter on destination address and/or port */
-	if ( dest_ip_wanted.s_addr &&
-	     ( dest_ip_wanted.s_addr != dest_ip.s_addr ) ) {
-		DBG ( " wrong IP %s", inet_ntoa ( dest_ip ) );
-		DBG ( " (wanted %s)\n", inet_ntoa ( dest_ip_wanted ) );
-		goto drop;
-	}
-	if ( d_port_wanted && ( d_port_wanted != d_port ) ) {
-		DBG ( " wrong port %d", htons ( d_port ) );
-		DBG ( " (wanted %d)\n", htons ( d_port_wanted ) );
-		goto drop;
-	}
-
 	/* Copy packet to buffer and record length */
 	buffer = real_to_user ( pxenv_udp_read->buffer.segment,
 				pxenv_udp_read->buffer.offset );
@@ -464,8 +485,6 @@ static PXENV_EXIT_t pxenv_udp_read ( struct s_PXENV_UDP_READ *pxenv_udp_read ) {
 	pxenv_udp_read->Status = PXENV_STATUS_SUCCESS;
 	return PXENV_EXIT_SUCCESS;
 
- drop:
-	free_iob ( iobuf );
  no_packet:
 	pxenv_udp_read->Status = PXENV_STATUS_FAILURE;
 	return PXENV_EXIT_FAILURE;
@@ -114,9 +114,15 @@ REQUIRE_OBJECT ( http );
 #ifdef DOWNLOAD_PROTO_HTTPS
 REQUIRE_OBJECT ( https );
 #endif
+#ifdef DOWNLOAD_PROTO_HTTP_MULTI
+REQUIRE_OBJECT ( httpmulti );
+#endif
 #ifdef DOWNLOAD_PROTO_FTP
 REQUIRE_OBJECT ( ftp );
 #endif
+#ifdef DOWNLOAD_PROTO_FTP_MULTI
+REQUIRE_OBJECT ( ftpmulti );
+#endif
 #ifdef DOWNLOAD_PROTO_NFS
 REQUIRE_OBJECT ( nfs_open );
 #endif
@@ -131,6 +137,9 @@ REQUIRE_OBJECT ( slam );
 #ifdef SANBOOT_PROTO_ISCSI
 REQUIRE_OBJECT ( iscsi );
 #endif
+#ifdef SANBOOT_PROTO_NVMETCP
+REQUIRE_OBJECT ( nvmetcp );
+#endif
 #ifdef SANBOOT_PROTO_HTTP
 REQUIRE_OBJECT ( httpblock );
 #endif
@@ -182,6 +191,9 @@ REQUIRE_OBJECT ( efi_image );
 #ifdef IMAGE_SDI
 REQUIRE_OBJECT ( sdi );
 #endif
+#ifdef IMAGE_ZSTD
+REQUIRE_OBJECT ( zstdimg );
+#endif
 
 /*
  * Drag in all requested commands
@@ -266,15 +278,33 @@ REQUIRE_OBJECT ( neighbour_cmd );
 #ifdef PING_CMD
 REQUIRE_OBJECT ( ping_cmd );
 #endif
+#ifdef NETBENCH_CMD
+REQUIRE_OBJECT ( netbench_cmd );
+#endif
+#ifdef PKTCAP_CMD
+REQUIRE_OBJECT ( pktcap_cmd );
+#endif
 #ifdef CONSOLE_CMD
 REQUIRE_OBJECT ( console_cmd );
 #endif
 #ifdef IPSTAT_CMD
 REQUIRE_OBJECT ( ipstat_cmd );
 #endif
+#ifdef TCPSTAT_CMD
+REQUIRE_OBJECT ( tcpstat_cmd );
+#endif
+#ifdef MEMSTAT_CMD
+REQUIRE_OBJECT ( memstat_cmd );
+#endif
+#ifdef LEAKSTAT_CMD
+REQUIRE_OBJECT ( leakstat_cmd );
+#endif
 #ifdef PROFSTAT_CMD
 REQUIRE_OBJECT ( profstat_cmd );
 #endif
+#ifdef BOOTTRACE_CMD
+REQUIRE_OBJECT ( boottrace_cmd );
+#endif
 #ifdef NTP_CMD
 REQUIRE_OBJECT ( ntp_cmd );
 #endif
@@ -286,6 +316,9 @@ REQUIRE_OBJECT ( cert_cmd );
  * Drag in miscellaneous objects
  *
  */
+#ifdef BOOTMETRICS
+REQUIRE_OBJECT ( bootmetrics );
+#endif
 #ifdef NULL_TRAP
 REQUIRE_OBJECT ( nulltrap );
 #endif
@@ -52,6 +52,19 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 //#define	CONSOLE_DIRECT_VGA	/* Direct access to VGA card */
 //#define	CONSOLE_PC_KBD		/* Direct access to PC keyboard */
 
+/*
+ * Headless operation
+ *
+ * Enable this to discard all console input and output at build time.
+ * Even when every console is disabled at runtime, each output
+ * character still iterates over the console driver table; builds for
+ * fully automated deployments which never attach a console can use
+ * this option to compile the per-character fan-out away entirely.
+ * Note that getchar() will never return in a headless build.
+ */
+
+//#define	CONSOLE_HEADLESS	/* Discard all console input and output */
+
 /* Keyboard map (available maps in hci/keymap/) */
 #define	KEYBOARD_MAP	us
 
@@ -26,6 +26,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define IMAGE_SCRIPT
 
 #define SANBOOT_PROTO_ISCSI
+#define SANBOOT_PROTO_NVMETCP
 #define SANBOOT_PROTO_AOE
 #define SANBOOT_PROTO_IB_SRP
 #define SANBOOT_PROTO_FCP
@@ -52,6 +52,14 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define DHCP_REQ_END_TIMEOUT_SEC	10
 //#define DHCP_REQ_END_TIMEOUT_SEC	4	/* as per PXE spec */
 
+/*
+ * An INIT-REBOOT request reusing a cached lease must fail fast, so
+ * that falling back to full discovery costs little when the network
+ * (or the lease) has changed since the lease was cached.
+ */
+#define DHCP_REBOOT_START_TIMEOUT_SEC	0
+#define DHCP_REBOOT_END_TIMEOUT_SEC	2
+
 /*
  * A ProxyDHCP offer without PXE options also goes through a request
  * phase using these same parameters, but note the early break below.
@@ -55,7 +55,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define	DOWNLOAD_PROTO_TFTP	/* Trivial File Transfer Protocol */
 #define	DOWNLOAD_PROTO_HTTP	/* Hypertext Transfer Protocol */
 #undef	DOWNLOAD_PROTO_HTTPS	/* Secure Hypertext Transfer Protocol */
+#undef	DOWNLOAD_PROTO_HTTP_MULTI /* Multi-connection HTTP(S) downloads */
 #undef	DOWNLOAD_PROTO_FTP	/* File Transfer Protocol */
+#undef	DOWNLOAD_PROTO_FTP_MULTI /* Multi-connection (striped) FTP */
 #undef	DOWNLOAD_PROTO_SLAM	/* Scalable Local Area Multicast */
 #undef	DOWNLOAD_PROTO_NFS	/* Network File System Protocol */
 //#undef DOWNLOAD_PROTO_FILE	/* Local filesystem access */
@@ -66,6 +68,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 
 //#undef	SANBOOT_PROTO_ISCSI	/* iSCSI protocol */
+//#undef	SANBOOT_PROTO_NVMETCP	/* NVMe over TCP protocol */
 //#undef	SANBOOT_PROTO_AOE	/* AoE protocol */
 //#undef	SANBOOT_PROTO_IB_SRP	/* Infiniband SCSI RDMA protocol */
 //#undef	SANBOOT_PROTO_FCP	/* Fibre Channel protocol */
@@ -114,6 +117,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 //#define	IMAGE_SDI		/* SDI image support */
 //#define	IMAGE_PNM		/* PNM image support */
 #define	IMAGE_PNG		/* PNG image support */
+#define	IMAGE_ZSTD		/* Zstandard compressed image support */
 #define	IMAGE_DER		/* DER image support */
 #define	IMAGE_PEM		/* PEM image support */
 
@@ -149,9 +153,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 //#define PARAM_CMD		/* Form parameter commands */
 //#define NEIGHBOUR_CMD		/* Neighbour management commands */
 //#define PING_CMD		/* Ping command */
+//#define NETBENCH_CMD		/* Network benchmark command */
+//#define PKTCAP_CMD		/* Packet capture commands */
 //#define CONSOLE_CMD		/* Console command */
 //#define IPSTAT_CMD		/* IP statistics commands */
-//#define PROFSTAT_CMD		/* Profiling commands */
+//#define TCPSTAT_CMD		/* TCP connection statistics commands */
+//#define MEMSTAT_CMD		/* Memory usage statistics commands */
+//#define LEAKSTAT_CMD		/* Allocation leak statistics commands */
+#define PROFSTAT_CMD		/* Profiling commands */
+//#define BOOTTRACE_CMD		/* Boot timeline tracing commands */
 //#define NTP_CMD		/* NTP commands */
 //#define CERT_CMD		/* Certificate management commands */
 
@@ -175,6 +185,12 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 #undef	ERRMSG_80211		/* All 802.11 error descriptions (~3.3kb) */
 
+/*
+ * Boot metrics collection
+ *
+ */
+//#define BOOTMETRICS		/* Report boot metrics to a remote collector */
+
 /*
  * Obscure configuration options
  *
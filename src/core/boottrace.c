@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <ipxe/vsprintf.h>
+#include <ipxe/timer.h>
+#include <ipxe/init.h>
+#include <ipxe/settings.h>
+#include <ipxe/bootmetrics.h>
+#include <ipxe/boottrace.h>
+
+/** @file
+ *
+ * Boot timeline tracing
+ *
+ * Phase markers recorded from around the boot path (driver probe,
+ * DHCP state transitions, download start and completion, image
+ * execution) are stored in a fixed ring, from which the timeline can
+ * be displayed on the console or fetched as the ${boottrace} setting
+ * (e.g. for appending to a booted kernel's command line).
+ */
+
+/** Boot timeline event ring */
+static struct boottrace_event boottrace_events[BOOTTRACE_EVENTS];
+
+/** Total number of events recorded */
+static unsigned int boottrace_count;
+
+/**
+ * Record boot timeline event
+ *
+ * @v fmt		Event name format string
+ * @v ...		Arguments
+ *
+ * Event names should be short and contain no whitespace, so that the
+ * exported timeline remains usable as a kernel command line value.
+ * If the ring is full then the oldest event is overwritten.
+ */
+void boottrace_mark ( const char *fmt, ... ) {
+	struct boottrace_event *event;
+	va_list args;
+
+	event = &boottrace_events[ boottrace_count % BOOTTRACE_EVENTS ];
+	event->ticks = currticks();
+	va_start ( args, fmt );
+	vsnprintf ( event->name, sizeof ( event->name ), fmt, args );
+	va_end ( args );
+	boottrace_count++;
+
+	/* Report completed phase, if applicable */
+	bootmetrics_mark ( event->name );
+}
+
+/**
+ * Report completion of a boot phase (when boot metrics collection is
+ * not present)
+ *
+ * @v phase		Completed phase name
+ */
+__weak void bootmetrics_mark ( const char *phase __unused ) {
+
+	/* Do nothing */
+}
+
+/**
+ * Get oldest retained event index
+ *
+ * @ret first		Index of oldest event still within the ring
+ */
+static unsigned int boottrace_first ( void ) {
+
+	if ( boottrace_count > BOOTTRACE_EVENTS )
+		return ( boottrace_count - BOOTTRACE_EVENTS );
+	return 0;
+}
+
+/**
+ * Calculate event time offset
+ *
+ * @v event		Boot timeline event
+ * @ret ms		Milliseconds since the oldest retained event
+ */
+static unsigned long boottrace_offset ( struct boottrace_event *event ) {
+	struct boottrace_event *first;
+
+	first = &boottrace_events[ boottrace_first() % BOOTTRACE_EVENTS ];
+	return ( ( event->ticks - first->ticks ) * 1000 / TICKS_PER_SEC );
+}
+
+/**
+ * Display boot timeline
+ */
+void boottrace_show ( void ) {
+	struct boottrace_event *event;
+	unsigned long ms;
+	unsigned int first = boottrace_first();
+	unsigned int i;
+
+	if ( first ) {
+		printf ( "(%d earlier events overwritten)\n", first );
+	}
+	for ( i = first ; i < boottrace_count ; i++ ) {
+		event = &boottrace_events[ i % BOOTTRACE_EVENTS ];
+		ms = boottrace_offset ( event );
+		printf ( "%4ld.%03lds %s\n", ( ms / 1000 ), ( ms % 1000 ),
+			 event->name );
+	}
+}
+
+/**
+ * Record startup as a boot timeline event
+ */
+static void boottrace_startup ( void ) {
+
+	boottrace_mark ( "startup" );
+}
+
+/** Boot timeline startup marker */
+struct startup_fn boottrace_startup_fn __startup_fn ( STARTUP_EARLY ) = {
+	.name = "boottrace",
+	.startup = boottrace_startup,
+};
+
+/**
+ * Fetch boot timeline setting
+ *
+ * @v data		Buffer to fill with setting data
+ * @v len		Length of buffer
+ * @ret len		Length of setting data, or negative error
+ */
+static int boottrace_fetch ( void *data, size_t len ) {
+	struct boottrace_event *event;
+	unsigned int first = boottrace_first();
+	unsigned int i;
+	size_t used = 0;
+
+	for ( i = first ; i < boottrace_count ; i++ ) {
+		event = &boottrace_events[ i % BOOTTRACE_EVENTS ];
+		used += ssnprintf ( ( data + used ), ( len - used ),
+				    "%s%s=%ld", ( ( i == first ) ? "" : "," ),
+				    event->name,
+				    boottrace_offset ( event ) );
+	}
+	return used;
+}
+
+/** Boot timeline setting */
+const struct setting boottrace_setting __setting ( SETTING_MISC, boottrace ) = {
+	.name = "boottrace",
+	.description = "Boot timeline",
+	.type = &setting_type_string,
+	.scope = &builtin_scope,
+};
+
+/** Boot timeline built-in setting */
+struct builtin_setting boottrace_builtin_setting __builtin_setting = {
+	.setting = &boottrace_setting,
+	.fetch = boottrace_fetch,
+};
@@ -1,7 +1,9 @@
 #include "stddef.h"
+#include <stdint.h>
 #include <ipxe/console.h>
 #include <ipxe/process.h>
 #include <ipxe/nap.h>
+#include <config/console.h>
 
 /** @file */
 
@@ -23,8 +25,18 @@ unsigned int console_height = CONSOLE_DEFAULT_HEIGHT;
  *
  * The character is written out to all enabled console devices, using
  * each device's console_driver::putchar() method.
+ *
+ * In a headless build (see CONSOLE_HEADLESS in config/console.h), all
+ * output is discarded without iterating over the console devices.
  */
 void putchar ( int character ) {
+#ifdef CONSOLE_HEADLESS
+
+	/* Discard all output */
+	( void ) character;
+
+#else
+
 	struct console_driver *console;
 
 	/* Automatic LF -> CR,LF translation */
@@ -37,6 +49,8 @@ void putchar ( int character ) {
 		     console->putchar )
 			console->putchar ( character );
 	}
+
+#endif
 }
 
 /**
@@ -49,6 +63,8 @@ void putchar ( int character ) {
  * console device that has available input will be returned, if any.
  */
 static struct console_driver * has_input ( void ) {
+#ifndef CONSOLE_HEADLESS
+
 	struct console_driver *console;
 
 	for_each_table_entry ( console, CONSOLES ) {
@@ -58,9 +74,49 @@ static struct console_driver * has_input ( void ) {
 				return console;
 		}
 	}
+
+#endif
 	return NULL;
 }
 
+/** Console input buffer size
+ *
+ * Must be a power of two.
+ */
+#define CONSOLE_KEYS 16
+
+/** Console input buffer */
+static uint8_t console_keys[CONSOLE_KEYS];
+
+/** Console input buffer producer counter */
+static unsigned int console_keys_prod;
+
+/** Console input buffer consumer counter */
+static unsigned int console_keys_cons;
+
+/**
+ * Buffer any available console input
+ *
+ * Characters are captured into the input buffer as part of normal
+ * background processing, so that keypresses made while a foreground
+ * task is busy (e.g. during a download) are retained until the task
+ * next polls for input, rather than relying on each console device's
+ * own type-ahead capabilities.
+ */
+static void console_key_step ( void ) {
+	struct console_driver *console;
+
+	while ( ( ( console_keys_prod - console_keys_cons ) <
+		  CONSOLE_KEYS ) &&
+		( ( console = has_input() ) != NULL ) && console->getchar ) {
+		console_keys[ console_keys_prod++ % CONSOLE_KEYS ] =
+			console->getchar ();
+	}
+}
+
+/** Console input buffering process */
+PERMANENT_PROCESS ( console_key, console_key_step );
+
 /**
  * Read a single character from any console
  *
@@ -84,6 +140,12 @@ int getchar ( void ) {
 	int character;
 
 	while ( 1 ) {
+		/* Use buffered input, if available */
+		if ( console_keys_cons != console_keys_prod ) {
+			character = console_keys[ console_keys_cons++ %
+						  CONSOLE_KEYS ];
+			break;
+		}
 		console = has_input();
 		if ( console && console->getchar ) {
 			character = console->getchar ();
@@ -125,7 +187,8 @@ int getchar ( void ) {
  * blocking.
  */
 int iskey ( void ) {
-	return has_input() ? 1 : 0;
+	return ( ( console_keys_cons != console_keys_prod ) ||
+		 has_input() ) ? 1 : 0;
 }
 
 /**
@@ -30,7 +30,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <ipxe/image.h>
 #include <ipxe/cpio.h>
 
 /**
@@ -45,3 +47,101 @@ void cpio_set_field ( char *field, unsigned long value ) {
 	snprintf ( buf, sizeof ( buf ), "%08lx", value );
 	memcpy ( field, buf, 8 );
 }
+
+/**
+ * Get CPIO image filename length
+ *
+ * @v image		Image
+ * @ret name_len	Filename length (including NUL), or zero for no filename
+ */
+size_t cpio_name_len ( struct image *image ) {
+	const char *name = cpio_name ( image );
+	char *sep;
+
+	/* Images with no filename are used as prebuilt CPIO archives */
+	if ( ! ( name && name[0] ) )
+		return 0;
+
+	/* Filename is terminated by a space (followed by CPIO
+	 * parameters) or by the end of the command line.
+	 */
+	sep = strchr ( name, ' ' );
+	return ( ( sep ? ( ( size_t ) ( sep - name ) ) : strlen ( name ) )
+		 + 1 /* NUL */ );
+}
+
+/**
+ * Get CPIO header length for image
+ *
+ * @v image		Image
+ * @ret len		CPIO header length (including filename and padding)
+ */
+size_t cpio_header_len ( struct image *image ) {
+	size_t name_len;
+
+	/* Images with no filename have no CPIO header */
+	name_len = cpio_name_len ( image );
+	if ( ! name_len )
+		return 0;
+
+	return ( ( sizeof ( struct cpio_header ) + name_len + CPIO_ALIGN - 1 )
+		 & ~( CPIO_ALIGN - 1 ) );
+}
+
+/**
+ * Parse CPIO image parameters
+ *
+ * @v image		Image
+ * @v cpio		CPIO header
+ * @v cmdline		Image command line parameters
+ */
+static void cpio_parse_cmdline ( struct image *image,
+				 struct cpio_header *cpio,
+				 const char *cmdline ) {
+	char *arg;
+	char *end;
+	unsigned int mode;
+
+	/* Look for "mode=" */
+	if ( ( arg = strstr ( cmdline, "mode=" ) ) ) {
+		arg += 5;
+		mode = strtoul ( arg, &end, 8 /* Octal for file mode */ );
+		if ( *end && ( *end != ' ' ) ) {
+			DBGC ( image, "CPIO %p strange \"mode=\" "
+			       "terminator '%c'\n", image, *end );
+		}
+		cpio_set_field ( cpio->c_mode, ( 0100000 | mode ) );
+	}
+}
+
+/**
+ * Construct CPIO header for image, if applicable
+ *
+ * @v image		Image
+ * @v cpio		CPIO header to fill in
+ * @ret len		CPIO header length (including filename and padding),
+ *			or zero for no header
+ */
+size_t cpio_header ( struct image *image, struct cpio_header *cpio ) {
+	const char *name = cpio_name ( image );
+	size_t name_len;
+
+	/* Images with no filename are used as prebuilt CPIO archives */
+	name_len = cpio_name_len ( image );
+	if ( ! name_len )
+		return 0;
+
+	/* Construct CPIO header */
+	memset ( cpio, '0', sizeof ( *cpio ) );
+	memcpy ( cpio->c_magic, CPIO_MAGIC, sizeof ( cpio->c_magic ) );
+	cpio_set_field ( cpio->c_mode, 0100644 );
+	cpio_set_field ( cpio->c_nlink, 1 );
+	cpio_set_field ( cpio->c_filesize, image->len );
+	cpio_set_field ( cpio->c_namesize, name_len );
+
+	/* Parse CPIO parameters, if present */
+	if ( name[ name_len - 1 /* NUL */ ] == ' ' )
+		cpio_parse_cmdline ( image, cpio, &name[name_len] );
+
+	return cpio_header_len ( image );
+}
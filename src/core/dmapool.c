@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/list.h>
+#include <ipxe/malloc.h>
+#include <ipxe/uaccess.h>
+#include <ipxe/dmapool.h>
+
+/** @file
+ *
+ * DMA block pool
+ *
+ * Network drivers allocate and free descriptor rings (and similar
+ * fixed-size, physically aligned blocks) on every device open and
+ * close.  Allocating these directly from the heap fragments it over
+ * repeated open/close cycles, which can eventually cause I/O buffer
+ * allocation failures.  The pool retains freed blocks and satisfies
+ * subsequent allocations of the same size and alignment from the
+ * retained list, so steady-state ring churn never touches the heap.
+ *
+ * Freed blocks hold their own bookkeeping, so the pool adds no memory
+ * overhead beyond the retained blocks themselves, which are released
+ * under memory pressure via the cache discarder mechanism.
+ */
+
+/** Maximum number of blocks retained in the pool */
+#ifndef DMA_POOL_MAX
+#define DMA_POOL_MAX 16
+#endif
+
+/** A pooled DMA block
+ *
+ * This structure is stored within the (freed) block itself.
+ */
+struct dma_pool_block {
+	/** List of pooled blocks */
+	struct list_head list;
+	/** Size of this block */
+	size_t size;
+};
+
+/** List of pooled blocks */
+static LIST_HEAD ( dma_pool );
+
+/** Number of blocks currently in the pool */
+static unsigned int dma_pool_count;
+
+/**
+ * Allocate memory from DMA block pool
+ *
+ * @v size		Requested size
+ * @v align		Physical alignment
+ * @ret ptr		Memory, or NULL
+ *
+ * Allocates physically aligned memory suitable for DMA, reusing a
+ * pooled block of the same size and alignment if one exists.  Memory
+ * allocated with dma_pool_alloc() must be freed with dma_pool_free().
+ *
+ * @c align must be a power of two.  @c size may not be zero.
+ */
+void * dma_pool_alloc ( size_t size, size_t align ) {
+	struct dma_pool_block *block;
+
+	/* Reuse a pooled block with matching size and alignment, if
+	 * available.
+	 */
+	list_for_each_entry ( block, &dma_pool, list ) {
+		if ( ( block->size == size ) &&
+		     ( ( virt_to_phys ( block ) & ( align - 1 ) ) == 0 ) ) {
+			list_del ( &block->list );
+			dma_pool_count--;
+			return block;
+		}
+	}
+
+	/* Fall back to a heap allocation */
+	return malloc_dma ( size, align );
+}
+
+/**
+ * Free memory to DMA block pool
+ *
+ * @v ptr		Memory allocated by dma_pool_alloc(), or NULL
+ * @v size		Size of memory, as passed to dma_pool_alloc()
+ *
+ * If @c ptr is NULL, no action is taken.
+ */
+void dma_pool_free ( void *ptr, size_t size ) {
+	struct dma_pool_block *block = ptr;
+
+	/* Allow dma_pool_free(NULL) to be valid */
+	if ( ! ptr )
+		return;
+
+	/* Retain block for reuse, if within the retention limit and
+	 * large enough to hold its own bookkeeping.
+	 */
+	if ( ( dma_pool_count < DMA_POOL_MAX ) &&
+	     ( size >= sizeof ( *block ) ) ) {
+		block->size = size;
+		list_add ( &block->list, &dma_pool );
+		dma_pool_count++;
+		return;
+	}
+
+	/* Return block to the heap */
+	free_dma ( ptr, size );
+}
+
+/**
+ * Discard a pooled DMA block
+ *
+ * @ret discarded	Number of blocks discarded
+ */
+static unsigned int dma_pool_discard ( void ) {
+	struct dma_pool_block *block;
+
+	/* Discard most recently pooled block, if any */
+	block = list_first_entry ( &dma_pool, struct dma_pool_block, list );
+	if ( ! block )
+		return 0;
+	list_del ( &block->list );
+	dma_pool_count--;
+	free_dma ( block, block->size );
+
+	return 1;
+}
+
+/** DMA block pool cache discarder */
+struct cache_discarder dma_pool_discarder __cache_discarder ( CACHE_CHEAP ) = {
+	.discard = dma_pool_discard,
+};
@@ -33,6 +33,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/uaccess.h>
 #include <ipxe/umalloc.h>
 #include <ipxe/image.h>
+#include <ipxe/boottrace.h>
 #include <ipxe/xferbuf.h>
 #include <ipxe/downloader.h>
 
@@ -83,9 +84,12 @@ static void downloader_finished ( struct downloader *downloader, int rc ) {
 	if ( rc == 0 ) {
 		syslog ( LOG_NOTICE, "Downloaded \"%s\"\n",
 			 downloader->image->name );
+		boottrace_mark ( "downloaded/%s", downloader->image->name );
 	} else {
 		syslog ( LOG_ERR, "Download of \"%s\" failed: %s\n",
 			 downloader->image->name, strerror ( rc ) );
+		boottrace_mark ( "download-fail/%s",
+				 downloader->image->name );
 	}
 
 	/* Update image length */
@@ -272,6 +276,7 @@ int create_downloader ( struct interface *job, struct image *image ) {
 	xferbuf_umalloc_init ( &downloader->buffer, &image->data );
 
 	/* Instantiate child objects and attach to our interfaces */
+	boottrace_mark ( "download/%s", image->name );
 	if ( ( rc = xfer_open_uri ( &downloader->xfer, image->uri ) ) != 0 )
 		goto err;
 
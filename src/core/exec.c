@@ -47,6 +47,92 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Shell stop state */
 static int stop_state;
 
+/** Sorted index of commands */
+static struct command **command_index;
+
+/** Number of commands within sorted index */
+static unsigned int command_index_count;
+
+/**
+ * Build sorted command index
+ *
+ * Commands are registered via a linker table, in arbitrary order.
+ * Sort them by name once, on first dispatch, so that command lookup
+ * (and prefix completion) can use a binary search rather than a
+ * linear scan of the table.
+ */
+static void build_command_index ( void ) {
+	struct command **index;
+	struct command *cmd;
+	unsigned int count = 0;
+	unsigned int i;
+
+	/* Allocate index */
+	for_each_table_entry ( cmd, COMMANDS )
+		count++;
+	index = malloc ( count * sizeof ( index[0] ) );
+	if ( ! index )
+		return;
+
+	/* Insertion-sort commands by name */
+	count = 0;
+	for_each_table_entry ( cmd, COMMANDS ) {
+		for ( i = count ; i > 0 ; i-- ) {
+			if ( strcmp ( index[ i - 1 ]->name, cmd->name ) <= 0 )
+				break;
+			index[i] = index[ i - 1 ];
+		}
+		index[i] = cmd;
+		count++;
+	}
+
+	command_index = index;
+	command_index_count = count;
+}
+
+/**
+ * Locate command by name
+ *
+ * @v name		Command name
+ * @ret cmd		Command, or NULL if not found
+ */
+struct command * find_command ( const char *name ) {
+	struct command *cmd;
+	unsigned int low;
+	unsigned int high;
+	unsigned int mid;
+	int cmp;
+
+	/* Build sorted index on first use */
+	if ( ! command_index )
+		build_command_index();
+
+	/* Fall back to a linear scan if the index could not be built */
+	if ( ! command_index ) {
+		for_each_table_entry ( cmd, COMMANDS ) {
+			if ( strcmp ( name, cmd->name ) == 0 )
+				return cmd;
+		}
+		return NULL;
+	}
+
+	/* Binary search within sorted index */
+	low = 0;
+	high = command_index_count;
+	while ( low < high ) {
+		mid = ( ( low + high ) / 2 );
+		cmp = strcmp ( name, command_index[mid]->name );
+		if ( cmp == 0 )
+			return command_index[mid];
+		if ( cmp < 0 ) {
+			high = mid;
+		} else {
+			low = ( mid + 1 );
+		}
+	}
+	return NULL;
+}
+
 /**
  * Execute command
  *
@@ -86,11 +172,10 @@ int execv ( const char *command, char * const argv[] ) {
 	reset_getopt();
 
 	/* Hand off to command implementation */
-	for_each_table_entry ( cmd, COMMANDS ) {
-		if ( strcmp ( command, cmd->name ) == 0 ) {
-			rc = cmd->exec ( argc, ( char ** ) argv );
-			goto done;
-		}
+	cmd = find_command ( command );
+	if ( cmd ) {
+		rc = cmd->exec ( argc, ( char ** ) argv );
+		goto done;
 	}
 
 	printf ( "%s: command not found\n", command );
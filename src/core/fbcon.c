@@ -157,14 +157,15 @@ static void fbcon_store ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
 static void fbcon_draw ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
 			 unsigned int xpos, unsigned int ypos ) {
 	uint8_t glyph[fbcon->font->height];
+	uint8_t rowdata[ FBCON_CHAR_WIDTH * sizeof ( uint32_t ) ];
 	size_t offset;
 	size_t pixel_len;
-	size_t skip_len;
 	unsigned int row;
 	unsigned int column;
 	uint8_t bitmask;
 	int transparent;
 	void *src;
+	void *dst;
 
 	/* Get font character */
 	fbcon->font->glyph ( cell->character, glyph );
@@ -174,29 +175,30 @@ static void fbcon_draw ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
 		   ( ypos * fbcon->character.stride ) +
 		   ( xpos * fbcon->character.len ) );
 	pixel_len = fbcon->pixel->len;
-	skip_len = ( fbcon->pixel->stride - fbcon->character.len );
 
 	/* Check for transparent background colour */
 	transparent = ( cell->background == FBCON_TRANSPARENT );
 
-	/* Draw character rows */
+	/* Draw character rows.  Each row is composed in a local
+	 * buffer and written out with a single whole-width copy,
+	 * since per-pixel writes to an uncached frame buffer are
+	 * slow.
+	 */
 	for ( row = 0 ; row < fbcon->font->height ; row++ ) {
 
-		/* Draw background picture, if applicable */
+		/* Fill in background */
 		if ( transparent ) {
 			if ( fbcon->picture.start ) {
-				memcpy_user ( fbcon->start, offset,
-					      fbcon->picture.start, offset,
-					      fbcon->character.len );
+				copy_from_user ( rowdata, fbcon->picture.start,
+						 offset, fbcon->character.len );
 			} else {
-				memset_user ( fbcon->start, offset, 0,
-					      fbcon->character.len );
+				memset ( rowdata, 0, fbcon->character.len );
 			}
 		}
 
-		/* Draw character row */
-		for ( column = FBCON_CHAR_WIDTH, bitmask = glyph[row] ;
-		      column ; column--, bitmask <<= 1, offset += pixel_len ) {
+		/* Fill in character row */
+		for ( column = 0, bitmask = glyph[row] ;
+		      column < FBCON_CHAR_WIDTH ; column++, bitmask <<= 1 ) {
 			if ( bitmask & 0x80 ) {
 				src = &cell->foreground;
 			} else if ( ! transparent ) {
@@ -204,12 +206,22 @@ static void fbcon_draw ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
 			} else {
 				continue;
 			}
-			copy_to_user ( fbcon->start, offset, src, pixel_len );
+			dst = &rowdata[ column * pixel_len ];
+			memcpy ( dst, src, pixel_len );
 		}
 
+		/* Write out character row */
+		copy_to_user ( fbcon->start, offset, rowdata,
+			       fbcon->character.len );
+
 		/* Move to next row */
-		offset += skip_len;
+		offset += fbcon->pixel->stride;
 	}
+
+	/* Record cell as drawn */
+	offset = ( ( ( ypos * fbcon->character.width ) + xpos ) *
+		   sizeof ( *cell ) );
+	copy_to_user ( fbcon->drawn.start, offset, cell, sizeof ( *cell ) );
 }
 
 /**
@@ -219,16 +231,22 @@ static void fbcon_draw ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
  */
 static void fbcon_redraw ( struct fbcon *fbcon ) {
 	struct fbcon_text_cell cell;
+	struct fbcon_text_cell drawn;
 	size_t offset = 0;
 	unsigned int xpos;
 	unsigned int ypos;
 
-	/* Redraw characters */
+	/* Redraw characters, skipping cells whose on-screen content
+	 * is already correct.
+	 */
 	for ( ypos = 0 ; ypos < fbcon->character.height ; ypos++ ) {
 		for ( xpos = 0 ; xpos < fbcon->character.width ; xpos++ ) {
 			copy_from_user ( &cell, fbcon->text.start, offset,
 					 sizeof ( cell ) );
-			fbcon_draw ( fbcon, &cell, xpos, ypos );
+			copy_from_user ( &drawn, fbcon->drawn.start, offset,
+					 sizeof ( drawn ) );
+			if ( memcmp ( &cell, &drawn, sizeof ( cell ) ) != 0 )
+				fbcon_draw ( fbcon, &cell, xpos, ypos );
 			offset += sizeof ( cell );
 		}
 	}
@@ -240,7 +258,11 @@ static void fbcon_redraw ( struct fbcon *fbcon ) {
  * @v fbcon		Frame buffer console
  */
 static void fbcon_scroll ( struct fbcon *fbcon ) {
+	struct fbcon_text_cell cell;
 	size_t row_len;
+	size_t offset;
+	unsigned int xpos;
+	unsigned int ypos;
 
 	/* Sanity check */
 	assert ( fbcon->ypos == fbcon->character.height );
@@ -254,8 +276,39 @@ static void fbcon_scroll ( struct fbcon *fbcon ) {
 	/* Update cursor position */
 	fbcon->ypos--;
 
-	/* Redraw all characters */
-	fbcon_redraw ( fbcon );
+	/* A background picture cannot be scrolled along with the
+	 * text, so fall back to redrawing all characters (skipping
+	 * any that are unchanged) if one is present.
+	 */
+	if ( fbcon->picture.start ) {
+		fbcon_redraw ( fbcon );
+		return;
+	}
+
+	/* Scroll up frame buffer contents by one character row.  The
+	 * moved rows span the full screen width; the pixels outside
+	 * the character area are uniformly black, so moving them is
+	 * harmless.
+	 */
+	offset = ( fbcon->margin.top * fbcon->pixel->stride );
+	memmove_user ( fbcon->start, offset, fbcon->start,
+		       ( offset + fbcon->character.stride ),
+		       ( fbcon->character.stride *
+			 ( fbcon->character.height - 1 ) ) );
+
+	/* Scroll up drawn character array to match */
+	memmove_user ( fbcon->drawn.start, 0, fbcon->drawn.start, row_len,
+		       ( row_len * ( fbcon->character.height - 1 ) ) );
+
+	/* Draw newly cleared bottom row */
+	ypos = ( fbcon->character.height - 1 );
+	offset = ( ypos * row_len );
+	for ( xpos = 0 ; xpos < fbcon->character.width ; xpos++ ) {
+		copy_from_user ( &cell, fbcon->text.start, offset,
+				 sizeof ( cell ) );
+		fbcon_draw ( fbcon, &cell, xpos, ypos );
+		offset += sizeof ( cell );
+	}
 }
 
 /**
@@ -678,6 +731,21 @@ int fbcon_init ( struct fbcon *fbcon, userptr_t start,
 	}
 	fbcon_clear ( fbcon, 0 );
 
+	/* Allocate drawn character array.  The blank screen below
+	 * matches what drawing the cleared character array would
+	 * produce, so the cleared cells are recorded as drawn.
+	 */
+	fbcon->drawn.start = umalloc ( fbcon->character.width *
+				       fbcon->character.height *
+				       sizeof ( struct fbcon_text_cell ) );
+	if ( ! fbcon->drawn.start ) {
+		rc = -ENOMEM;
+		goto err_drawn;
+	}
+	memcpy_user ( fbcon->drawn.start, 0, fbcon->text.start, 0,
+		      ( fbcon->character.width * fbcon->character.height *
+			sizeof ( struct fbcon_text_cell ) ) );
+
 	/* Set framebuffer to all black (including margins) */
 	memset_user ( fbcon->start, 0, 0, fbcon->len );
 
@@ -699,6 +767,8 @@ int fbcon_init ( struct fbcon *fbcon, userptr_t start,
 
 	ufree ( fbcon->picture.start );
  err_picture:
+	ufree ( fbcon->drawn.start );
+ err_drawn:
 	ufree ( fbcon->text.start );
  err_text:
  err_margin:
@@ -713,5 +783,6 @@ int fbcon_init ( struct fbcon *fbcon, userptr_t start,
 void fbcon_fini ( struct fbcon *fbcon ) {
 
 	ufree ( fbcon->text.start );
+	ufree ( fbcon->drawn.start );
 	ufree ( fbcon->picture.start );
 }
@@ -34,6 +34,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/list.h>
 #include <ipxe/umalloc.h>
 #include <ipxe/uri.h>
+#include <ipxe/boottrace.h>
+#include <ipxe/leakstat.h>
 #include <ipxe/image.h>
 
 /** @file
@@ -64,6 +66,9 @@ static int require_trusted_images = 0;
 /** Prevent changes to image trust requirement */
 static int require_trusted_images_permanent = 0;
 
+/** Image leak tracker */
+static struct leak_tracker image_leaks __leak_tracker = { .name = "image" };
+
 /**
  * Free executable image
  *
@@ -79,6 +84,7 @@ static void free_image ( struct refcnt *refcnt ) {
 	ufree ( image->data );
 	image_put ( image->replacement );
 	free ( image );
+	leak_free ( &image_leaks );
 }
 
 /**
@@ -95,6 +101,7 @@ struct image * alloc_image ( struct uri *uri ) {
 	image = zalloc ( sizeof ( *image ) );
 	if ( ! image )
 		goto err_alloc;
+	leak_alloc ( &image_leaks );
 
 	/* Initialise image */
 	ref_init ( &image->refcnt, free_image );
@@ -183,10 +190,42 @@ int image_set_cmdline ( struct image *image, const char *cmdline ) {
  */
 static int image_probe ( struct image *image ) {
 	struct image_type *type;
+	struct image_type *sniffed = NULL;
+	uint8_t first[IMAGE_MAGIC_MAX_LEN];
+	size_t first_len;
 	int rc;
 
+	/* Sniff the first bytes of the image to select a likely type
+	 * directly, since some probe methods read deep into the
+	 * payload and trying every type in turn is expensive for
+	 * large images.
+	 */
+	first_len = image->len;
+	if ( first_len > sizeof ( first ) )
+		first_len = sizeof ( first );
+	copy_from_user ( first, image->data, 0, first_len );
+	for_each_table_entry ( type, IMAGE_TYPES ) {
+		assert ( type->magic_len <= sizeof ( first ) );
+		if ( ( ! type->magic ) || ( type->magic_len > first_len ) ||
+		     ( memcmp ( first, type->magic, type->magic_len ) != 0 ) )
+			continue;
+		sniffed = type;
+		if ( ( rc = type->probe ( image ) ) == 0 ) {
+			image->type = type;
+			DBGC ( image, "IMAGE %s is %s\n",
+			       image->name, type->name );
+			return 0;
+		}
+		DBGC ( image, "IMAGE %s is not %s (despite matching "
+		       "signature): %s\n", image->name, type->name,
+		       strerror ( rc ) );
+		break;
+	}
+
 	/* Try each type in turn */
 	for_each_table_entry ( type, IMAGE_TYPES ) {
+		if ( type == sniffed )
+			continue;
 		if ( ( rc = type->probe ( image ) ) == 0 ) {
 			image->type = type;
 			DBGC ( image, "IMAGE %s is %s\n",
@@ -325,6 +364,7 @@ int image_exec ( struct image *image ) {
 
 	/* Record boot attempt */
 	syslog ( LOG_NOTICE, "Executing \"%s\"\n", image->name );
+	boottrace_mark ( "exec/%s", image->name );
 
 	/* Try executing the image */
 	if ( ( rc = image->type->exec ( image ) ) != 0 ) {
@@ -24,6 +24,7 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <string.h>
+#include <stdio.h>
 #include <ipxe/interface.h>
 
 /** @file
@@ -125,26 +126,6 @@ void intf_nullify ( struct interface *intf ) {
 	intf->desc = &null_intf_desc;
 }
 
-/**
- * Increment reference count on an object interface
- *
- * @v intf		Object interface
- * @ret intf		Object interface
- */
-struct interface * intf_get ( struct interface *intf ) {
-	ref_get ( intf->refcnt );
-	return intf;
-}
-
-/**
- * Decrement reference count on an object interface
- *
- * @v intf		Object interface
- */
-void intf_put ( struct interface *intf ) {
-	ref_put ( intf->refcnt );
-}
-
 /**
  * Get pointer to object containing object interface
  *
@@ -224,6 +205,33 @@ void * intf_get_dest_op_untyped ( struct interface *intf, void *type,
 	}
 }
 
+/** Maximum interface chain length printed by intf_dump_chain() */
+#define INTF_DUMP_MAX_DEPTH 16
+
+/**
+ * Print an object interface chain
+ *
+ * @v intf		Object interface
+ *
+ * Prints the chain of objects reachable from an interface, following
+ * each destination interface and any pass-through interfaces, as a
+ * diagnostic aid for identifying which object in a chain has stalled.
+ */
+void intf_dump_chain ( struct interface *intf ) {
+	unsigned int depth;
+
+	printf ( "INTF " INTF_FMT, INTF_DBG ( intf ) );
+	for ( depth = 0 ; depth < INTF_DUMP_MAX_DEPTH ; depth++ ) {
+		if ( intf->dest == &null_intf )
+			break;
+		intf = intf->dest;
+		printf ( "->" INTF_FMT, INTF_DBG ( intf ) );
+		if ( ! ( intf = intf_get_passthru ( intf ) ) )
+			break;
+	}
+	printf ( "\n" );
+}
+
 /*****************************************************************************
  *
  * Generic interface operations
@@ -24,9 +24,14 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
+#include <stddef.h>
 #include <strings.h>
 #include <errno.h>
 #include <ipxe/malloc.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/uaccess.h>
+#include <ipxe/profile.h>
+#include <ipxe/leakstat.h>
 #include <ipxe/iobuf.h>
 
 /** @file
@@ -35,6 +40,60 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/** Maximum number of I/O buffers retained for recycling */
+#ifndef IOB_RECYCLE_MAX
+#define IOB_RECYCLE_MAX 32
+#endif
+
+/** Recycled I/O buffer free list
+ *
+ * Buffers with detached descriptors (i.e. the size class used for
+ * receive buffers) are retained on this list when freed, and are
+ * reused by subsequent allocations of the same size and alignment.
+ * This bypasses the general heap on the steady-state receive path,
+ * where buffers of a single fixed size are continually freed and
+ * reallocated.
+ */
+static LIST_HEAD ( iob_recycled );
+
+/** Number of I/O buffers currently retained for recycling */
+static unsigned int iob_recycled_count;
+
+/** I/O buffer allocation profiler */
+static struct profiler alloc_iob_profiler __profiler_lite =
+	{ .name = "iob.alloc" };
+
+/** I/O buffer leak tracker */
+static struct leak_tracker iob_leaks __leak_tracker = { .name = "iobuf" };
+
+/** A shared I/O buffer payload
+ *
+ * Created when an I/O buffer is first cloned.  Records the underlying
+ * buffer allocation, which is freed only when the last I/O buffer
+ * referencing it is freed.
+ */
+struct iob_payload {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Start of the buffer allocation */
+	void *head;
+	/** Length of the buffer allocation */
+	size_t len;
+};
+
+/**
+ * Free a shared I/O buffer payload
+ *
+ * @v refcnt	Reference count
+ */
+static void iob_payload_free ( struct refcnt *refcnt ) {
+	struct iob_payload *payload =
+		container_of ( refcnt, struct iob_payload, refcnt );
+
+	free_dma ( payload->head, payload->len );
+	free ( payload );
+}
+
 /**
  * Allocate I/O buffer with specified alignment and offset
  *
@@ -96,6 +155,24 @@ struct io_buffer * alloc_iob_raw ( size_t len, size_t align, size_t offset ) {
 
 	} else {
 
+		/* Reuse a recycled buffer with matching size and
+		 * alignment, if available.
+		 */
+		list_for_each_entry ( iobuf, &iob_recycled, list ) {
+			if ( ( ( ( size_t ) ( iobuf->end - iobuf->head ) )
+			       == len ) &&
+			     ( ( virt_to_phys ( iobuf->head ) &
+				 ( align - 1 ) ) == offset ) ) {
+				list_del ( &iobuf->list );
+				iob_recycled_count--;
+				iobuf->data = iobuf->tail = iobuf->head;
+				iobuf->payload = NULL;
+				iobuf->flags = 0;
+				leak_alloc ( &iob_leaks );
+				return iobuf;
+			}
+		}
+
 		/* Allocate memory for buffer */
 		data = malloc_dma_offset ( len, align, offset );
 		if ( ! data )
@@ -112,6 +189,9 @@ struct io_buffer * alloc_iob_raw ( size_t len, size_t align, size_t offset ) {
 	/* Populate descriptor */
 	iobuf->head = iobuf->data = iobuf->tail = data;
 	iobuf->end = ( data + len );
+	iobuf->payload = NULL;
+	iobuf->flags = 0;
+	leak_alloc ( &iob_leaks );
 
 	return iobuf;
 }
@@ -126,6 +206,7 @@ struct io_buffer * alloc_iob_raw ( size_t len, size_t align, size_t offset ) {
  * up to the nearest power of two).
  */
 struct io_buffer * alloc_iob ( size_t len ) {
+	struct io_buffer *iobuf;
 
 	/* Pad to minimum length */
 	if ( len < IOB_ZLEN )
@@ -134,7 +215,41 @@ struct io_buffer * alloc_iob ( size_t len ) {
 	/* Align buffer on its own size to avoid potential problems
 	 * with boundary-crossing DMA.
 	 */
-	return alloc_iob_raw ( len, len, 0 );
+	profile_start_lite ( &alloc_iob_profiler );
+	iobuf = alloc_iob_raw ( len, len, 0 );
+	profile_stop_lite ( &alloc_iob_profiler );
+	return iobuf;
+}
+
+/**
+ * Allocate I/O buffer with reserved headroom
+ *
+ * @v len	Required length of buffer
+ * @v headroom	Headroom to reserve for protocol headers
+ * @ret iobuf	I/O buffer, or NULL if none available
+ *
+ * The I/O buffer is allocated with @c headroom bytes already
+ * reserved, into which link, network, and transport headers may
+ * subsequently be pushed, and with its payload start physically
+ * aligned on an IOB_PAYLOAD_ALIGN boundary.
+ */
+struct io_buffer * alloc_iob_headroom ( size_t len, size_t headroom ) {
+	struct io_buffer *iobuf;
+
+	/* Pad overall length to minimum length */
+	if ( ( headroom + len ) < IOB_ZLEN )
+		len = ( IOB_ZLEN - headroom );
+
+	/* Offset the buffer start so that the post-headroom payload
+	 * start lands on an alignment boundary.
+	 */
+	iobuf = alloc_iob_raw ( ( headroom + len ), IOB_PAYLOAD_ALIGN,
+				( -headroom & ( IOB_PAYLOAD_ALIGN - 1 ) ) );
+	if ( ! iobuf )
+		return NULL;
+	iob_reserve ( iobuf, headroom );
+
+	return iobuf;
 }
 
 /**
@@ -143,6 +258,7 @@ struct io_buffer * alloc_iob ( size_t len ) {
  * @v iobuf	I/O buffer
  */
 void free_iob ( struct io_buffer *iobuf ) {
+	struct iob_payload *payload;
 	size_t len;
 
 	/* Allow free_iob(NULL) to be valid */
@@ -153,6 +269,19 @@ void free_iob ( struct io_buffer *iobuf ) {
 	assert ( iobuf->head <= iobuf->data );
 	assert ( iobuf->data <= iobuf->tail );
 	assert ( iobuf->tail <= iobuf->end );
+	leak_free ( &iob_leaks );
+
+	/* Drop reference to shared payload, if applicable.  A
+	 * detached descriptor is freed immediately; an inline
+	 * descriptor lies within the shared allocation and is freed
+	 * along with it.
+	 */
+	if ( ( payload = iobuf->payload ) ) {
+		if ( iobuf->end != ( void * ) iobuf )
+			free ( iobuf );
+		ref_put ( &payload->refcnt );
+		return;
+	}
 
 	/* Free buffer */
 	len = ( iobuf->end - iobuf->head );
@@ -163,12 +292,48 @@ void free_iob ( struct io_buffer *iobuf ) {
 
 	} else {
 
+		/* Retain descriptor and buffer for recycling, if
+		 * within the retention limit.
+		 */
+		if ( iob_recycled_count < IOB_RECYCLE_MAX ) {
+			list_add ( &iobuf->list, &iob_recycled );
+			iob_recycled_count++;
+			return;
+		}
+
 		/* Descriptor is detached */
 		free_dma ( iobuf->head, len );
 		free ( iobuf );
 	}
 }
 
+/**
+ * Discard a recycled I/O buffer
+ *
+ * @ret discarded	Number of I/O buffers discarded
+ */
+static unsigned int iob_discard ( void ) {
+	struct io_buffer *iobuf;
+	size_t len;
+
+	/* Discard most recently recycled I/O buffer, if any */
+	iobuf = list_first_entry ( &iob_recycled, struct io_buffer, list );
+	if ( ! iobuf )
+		return 0;
+	list_del ( &iobuf->list );
+	iob_recycled_count--;
+	len = ( iobuf->end - iobuf->head );
+	free_dma ( iobuf->head, len );
+	free ( iobuf );
+
+	return 1;
+}
+
+/** I/O buffer cache discarder */
+struct cache_discarder iob_discarder __cache_discarder ( CACHE_CHEAP ) = {
+	.discard = iob_discard,
+};
+
 /**
  * Ensure I/O buffer has sufficient headroom
  *
@@ -230,6 +395,57 @@ struct io_buffer * iob_concatenate ( struct list_head *list ) {
 	return concatenated;
 }
 
+/**
+ * Clone I/O buffer
+ *
+ * @v iobuf		I/O buffer
+ * @ret clone		Cloned I/O buffer, or NULL on allocation failure
+ *
+ * Create a second view of the same payload, sharing the underlying
+ * buffer allocation rather than copying it.  Each view has its own
+ * data and tail pointers and may be pulled, trimmed, and freed
+ * independently; the underlying allocation is freed only when the
+ * last view referencing it is freed.
+ *
+ * The shared bytes must be treated as immutable: no view may modify
+ * the buffer contents (e.g. by pushing headers into shared headroom)
+ * while another view remains in use.
+ */
+struct io_buffer * iob_clone ( struct io_buffer *iobuf ) {
+	struct io_buffer *clone;
+	struct iob_payload *payload;
+
+	/* Create shared payload, if buffer is not already shared */
+	if ( ! ( payload = iobuf->payload ) ) {
+		payload = zalloc ( sizeof ( *payload ) );
+		if ( ! payload )
+			return NULL;
+		payload->head = iobuf->head;
+		payload->len = ( iobuf->end - iobuf->head );
+		if ( iobuf->end == ( void * ) iobuf ) {
+			/* Inline descriptor is part of the allocation */
+			payload->len += sizeof ( *iobuf );
+		}
+		ref_init ( &payload->refcnt, iob_payload_free );
+		iobuf->payload = payload;
+	}
+
+	/* Allocate new descriptor sharing the payload */
+	clone = malloc ( sizeof ( *clone ) );
+	if ( ! clone )
+		return NULL;
+	clone->head = iobuf->head;
+	clone->data = iobuf->data;
+	clone->tail = iobuf->tail;
+	clone->end = iobuf->end;
+	clone->flags = iobuf->flags;
+	ref_get ( &payload->refcnt );
+	clone->payload = payload;
+	leak_alloc ( &iob_leaks );
+
+	return clone;
+}
+
 /**
  * Split I/O buffer
  *
@@ -238,8 +454,9 @@ struct io_buffer * iob_concatenate ( struct list_head *list ) {
  * @ret split		New I/O buffer, or NULL on allocation failure
  *
  * Split the first @c len bytes of the existing I/O buffer into a
- * separate I/O buffer.  The resulting buffers are likely to have no
- * headroom or tailroom.
+ * separate I/O buffer.  The two buffers share the underlying payload,
+ * and so are subject to the immutability requirement described in
+ * iob_clone().
  *
  * If this call fails, then the original buffer will be unmodified.
  */
@@ -249,13 +466,13 @@ struct io_buffer * iob_split ( struct io_buffer *iobuf, size_t len ) {
 	/* Sanity checks */
 	assert ( len <= iob_len ( iobuf ) );
 
-	/* Allocate new I/O buffer */
-	split = alloc_iob ( len );
+	/* Clone I/O buffer, sharing the payload */
+	split = iob_clone ( iobuf );
 	if ( ! split )
 		return NULL;
 
-	/* Copy in data */
-	memcpy ( iob_put ( split, len ), iobuf->data, len );
+	/* Truncate clone to the split point, and pull the original */
+	iob_unput ( split, ( iob_len ( iobuf ) - len ) );
 	iob_pull ( iobuf, len );
 	return split;
 }
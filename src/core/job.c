@@ -25,6 +25,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <string.h>
 #include <errno.h>
+#include <ipxe/timer.h>
 #include <ipxe/job.h>
 
 /** @file
@@ -65,3 +66,95 @@ int job_progress ( struct interface *intf, struct job_progress *progress ) {
 	intf_put ( dest );
 	return ongoing_rc;
 }
+
+/**
+ * Record job progress rate sample
+ *
+ * @v rate		Rate estimator
+ * @v completed		Amount of operation completed so far
+ *
+ * Samples should be recorded at roughly regular intervals; the window
+ * covers the most recent @c JOB_RATE_SAMPLES samples.
+ */
+void job_rate_sample ( struct job_rate *rate, unsigned long completed ) {
+	unsigned int index;
+
+	/* Reset window if progress has gone backwards (e.g. because
+	 * the underlying operation has restarted).
+	 */
+	if ( rate->count ) {
+		index = ( ( rate->count - 1 ) % JOB_RATE_SAMPLES );
+		if ( completed < rate->sample[index].completed )
+			rate->count = 0;
+	}
+
+	/* Record sample */
+	index = ( rate->count % JOB_RATE_SAMPLES );
+	rate->sample[index].ticks = currticks();
+	rate->sample[index].completed = completed;
+	rate->count++;
+}
+
+/**
+ * Calculate windowed job progress rate
+ *
+ * @v rate		Rate estimator
+ * @ret per_sec		Progress units per second, or zero if not yet known
+ */
+unsigned long job_rate_per_sec ( struct job_rate *rate ) {
+	unsigned long delta;
+	unsigned long elapsed;
+	unsigned int oldest;
+	unsigned int newest;
+
+	/* Rate is unknown until at least two samples exist */
+	if ( rate->count < 2 )
+		return 0;
+
+	/* Identify oldest and newest samples within the window */
+	if ( rate->count > JOB_RATE_SAMPLES ) {
+		oldest = ( rate->count % JOB_RATE_SAMPLES );
+	} else {
+		oldest = 0;
+	}
+	newest = ( ( rate->count - 1 ) % JOB_RATE_SAMPLES );
+
+	/* Calculate rate over the window, avoiding overflow on large
+	 * progress deltas by dividing before scaling to seconds.
+	 */
+	delta = ( rate->sample[newest].completed -
+		  rate->sample[oldest].completed );
+	elapsed = ( rate->sample[newest].ticks - rate->sample[oldest].ticks );
+	if ( ! elapsed )
+		return 0;
+	return ( ( ( delta / elapsed ) * TICKS_PER_SEC ) +
+		 ( ( ( delta % elapsed ) * TICKS_PER_SEC ) / elapsed ) );
+}
+
+/**
+ * Estimate job time to completion
+ *
+ * @v rate		Rate estimator
+ * @v total		Total operation size (zero if unknown)
+ * @ret eta		Estimated seconds remaining, or zero if unknown
+ *
+ * The estimate is rounded up, and so remains non-zero until the
+ * operation actually completes.
+ */
+unsigned long job_rate_eta ( struct job_rate *rate, unsigned long total ) {
+	unsigned long per_sec;
+	unsigned long completed;
+	unsigned int newest;
+
+	/* ETA is unknown without a total size or a known rate */
+	per_sec = job_rate_per_sec ( rate );
+	if ( ( ! total ) || ( ! per_sec ) )
+		return 0;
+
+	/* Estimate time remaining at the current windowed rate */
+	newest = ( ( rate->count - 1 ) % JOB_RATE_SAMPLES );
+	completed = rate->sample[newest].completed;
+	if ( completed >= total )
+		return 0;
+	return ( ( ( total - completed ) + per_sec - 1 ) / per_sec );
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Allocation leak tracking
+ *
+ */
+
+#include <stdio.h>
+#include <ipxe/malloc.h>
+#include <ipxe/leakstat.h>
+
+/**
+ * Print allocation leak statistics
+ *
+ * Live counts that grow without bound while a session is quiescent
+ * indicate a leak in the corresponding object class.
+ */
+void leakstat ( void ) {
+	struct leak_tracker *tracker;
+
+	/* Print per-class counters */
+	for_each_table_entry ( tracker, LEAK_TRACKERS ) {
+		printf ( "LEAK %s: %ld live (%ld allocated, %ld freed)\n",
+			 tracker->name,
+			 ( tracker->allocated - tracker->freed ),
+			 tracker->allocated, tracker->freed );
+	}
+
+	/* Print heap summary */
+	printf ( "LEAK heap: %zd bytes used (%zd free, %zd peak used)\n",
+		 usedmem, freemem, maxusedmem );
+}
@@ -17,6 +17,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stddef.h>
 #include <stdio.h>
 #include <ipxe/init.h>
+#include <ipxe/boottrace.h>
 #include <ipxe/version.h>
 #include <usr/autoboot.h>
 
@@ -31,6 +32,13 @@ __asmcall int main ( void ) {
 	/* Perform one-time-only initialisation (e.g. heap) */
 	initialise();
 
+	/* Record arrival in the boot timeline.  The prefix (or, on
+	 * EFI, the platform's PE loader) has finished its work by
+	 * this point, so the gap before the first "startup" event
+	 * approximates time spent in early platform initialisation.
+	 */
+	boottrace_mark ( "main" );
+
 	/* Some devices take an unreasonably long time to initialise */
 	printf ( "%s initialising devices...", product_short_name );
 	startup();
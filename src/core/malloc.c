@@ -30,6 +30,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/io.h>
 #include <ipxe/list.h>
 #include <ipxe/init.h>
+#include <ipxe/process.h>
 #include <ipxe/refcnt.h>
 #include <ipxe/malloc.h>
 #include <valgrind/memcheck.h>
@@ -55,8 +56,10 @@ struct memory_block {
 	 */
 	char pad[ offsetof ( struct refcnt, count ) +
 		  sizeof ( ( ( struct refcnt * ) NULL )->count ) ];
-	/** List of free blocks */
+	/** List of free blocks, in ascending address order */
 	struct list_head list;
+	/** List of free blocks in the same size class bin */
+	struct list_head bin;
 };
 
 #define MIN_MEMBLOCK_SIZE \
@@ -87,9 +90,77 @@ struct autosized_block {
  */
 #define NOWHERE ( ( void * ) ~( ( intptr_t ) 0 ) )
 
-/** List of free memory blocks */
+/** List of free memory blocks, in ascending address order
+ *
+ * This list links every free block regardless of size, and is used
+ * for coalescing adjacent blocks on free.
+ */
 static LIST_HEAD ( free_blocks );
 
+/** Number of exact-fit size class bins
+ *
+ * Must be a power of two.  Each of these bins holds free blocks of
+ * exactly one multiple of @c MIN_MEMBLOCK_SIZE, so that the dominant
+ * small allocation sizes (reference-counted objects, I/O buffer
+ * metadata and the like) are satisfied by an exact fit without
+ * searching or splitting.
+ */
+#define HEAP_NUM_EXACT_BINS 8
+
+/** Total number of size class bins
+ *
+ * Bins beyond the exact-fit bins hold power-of-two size classes, with
+ * the final bin holding all larger blocks.
+ */
+#define HEAP_NUM_BINS 24
+
+/** Size class bins of free memory blocks
+ *
+ * Every free block is additionally linked into the bin corresponding
+ * to its size, allowing allocations to be satisfied without walking
+ * the (potentially long) address-ordered free list.
+ */
+static struct list_head free_bins[HEAP_NUM_BINS];
+
+/** A memory block awaiting deferred freeing
+ *
+ * This structure is stored within the (freed) block itself.
+ */
+struct deferred_free {
+	/** Next block in the pending list */
+	struct deferred_free *next;
+	/** Size of the memory block */
+	size_t size;
+};
+
+/** List of memory blocks awaiting deferred freeing */
+static struct deferred_free *deferred_frees;
+
+static void flush_deferred_frees ( void );
+
+/**
+ * Determine size class bin for a block size
+ *
+ * @v size		Size of block (a multiple of MIN_MEMBLOCK_SIZE)
+ * @ret bin		Bin index
+ */
+static unsigned int heap_bin ( size_t size ) {
+	unsigned int units = ( size / MIN_MEMBLOCK_SIZE );
+	unsigned int bin;
+
+	/* Exact-fit bins for small sizes */
+	assert ( units >= 1 );
+	if ( units <= HEAP_NUM_EXACT_BINS )
+		return ( units - 1 );
+
+	/* Power-of-two size class bins for larger sizes */
+	bin = ( HEAP_NUM_EXACT_BINS + fls ( units - 1 ) -
+		fls ( HEAP_NUM_EXACT_BINS ) );
+	if ( bin >= HEAP_NUM_BINS )
+		bin = ( HEAP_NUM_BINS - 1 );
+	return bin;
+}
+
 /** Total amount of free memory */
 size_t freemem;
 
@@ -205,6 +276,7 @@ static inline void valgrind_make_blocks_noaccess ( void ) {
 static inline void check_blocks ( void ) {
 	struct memory_block *block;
 	struct memory_block *prev = NULL;
+	unsigned int bin;
 
 	if ( ! ASSERTING )
 		return;
@@ -213,6 +285,7 @@ static inline void check_blocks ( void ) {
 
 		/* Check that list structure is intact */
 		list_check ( &block->list );
+		list_check ( &block->bin );
 
 		/* Check that block size is not too small */
 		assert ( block->size >= sizeof ( *block ) );
@@ -232,6 +305,16 @@ static inline void check_blocks ( void ) {
 		}
 		prev = block;
 	}
+
+	/* Check that each free block lies within its correct size
+	 * class bin.
+	 */
+	for ( bin = 0 ; bin < HEAP_NUM_BINS ; bin++ ) {
+		list_for_each_entry ( block, &free_bins[bin], bin ) {
+			list_check ( &block->bin );
+			assert ( heap_bin ( block->size ) == bin );
+		}
+	}
 }
 
 /**
@@ -282,9 +365,11 @@ void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
 	size_t actual_size;
 	size_t pre_size;
 	size_t post_size;
+	struct memory_block *found;
 	struct memory_block *pre;
 	struct memory_block *post;
 	unsigned int discarded;
+	unsigned int bin;
 	void *ptr;
 
 	/* Sanity checks */
@@ -313,20 +398,43 @@ void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
 	DBGC2 ( &heap, "Allocating %#zx (aligned %#zx+%zx)\n",
 		size, align, offset );
 	while ( 1 ) {
-		/* Search through blocks for the first one with enough space */
-		list_for_each_entry ( block, &free_blocks, list ) {
+		/* Search through blocks for the first one with enough
+		 * space, starting with the smallest size class that
+		 * could satisfy the request and proceeding to larger
+		 * classes.  Since any block in a larger class is
+		 * guaranteed to be big enough, the first block found
+		 * is almost always usable directly, and the search is
+		 * effectively O(1) for allocations with no alignment
+		 * requirement.
+		 */
+		found = NULL;
+		for ( bin = heap_bin ( actual_size ) ;
+		      ( ( ! found ) && ( bin < HEAP_NUM_BINS ) ) ; bin++ ) {
+			list_for_each_entry ( block, &free_bins[bin], bin ) {
+				pre_size = ( ( offset -
+					       virt_to_phys ( block ) )
+					     & align_mask );
+				if ( ( block->size < pre_size ) ||
+				     ( ( block->size - pre_size ) <
+				       actual_size ) )
+					continue;
+				found = block;
+				break;
+			}
+		}
+		if ( found ) {
+			block = found;
 			pre_size = ( ( offset - virt_to_phys ( block ) )
 				     & align_mask );
-			if ( ( block->size < pre_size ) ||
-			     ( ( block->size - pre_size ) < actual_size ) )
-				continue;
 			post_size = ( block->size - pre_size - actual_size );
 			/* Split block into pre-block, block, and
 			 * post-block.  After this split, the "pre"
 			 * block is the one currently linked into the
-			 * free list.
+			 * free list; remove it from its size class
+			 * bin, since its size is about to change.
 			 */
 			pre   = block;
+			list_del ( &pre->bin );
 			block = ( ( ( void * ) pre   ) + pre_size );
 			post  = ( ( ( void * ) block ) + actual_size );
 			DBGC2 ( &heap, "[%p,%p) -> [%p,%p) + [%p,%p)\n", pre,
@@ -342,6 +450,8 @@ void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
 							      sizeof ( *post ));
 				post->size = post_size;
 				list_add ( &post->list, &pre->list );
+				list_add ( &post->bin,
+					   &free_bins[ heap_bin ( post_size )]);
 			}
 			/* Shrink "pre" block, leaving the main block
 			 * isolated and no longer part of the free
@@ -351,12 +461,16 @@ void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
 			/* If there is no "pre" block, remove it from
 			 * the list.  Also remove it (i.e. leak it) if
 			 * it is too small, which can happen only at
-			 * the very start of the heap.
+			 * the very start of the heap.  Otherwise,
+			 * re-bin it to match its reduced size.
 			 */
 			if ( pre_size < MIN_MEMBLOCK_SIZE ) {
 				list_del ( &pre->list );
 				VALGRIND_MAKE_MEM_NOACCESS ( pre,
 							     sizeof ( *pre ) );
+			} else {
+				list_add ( &pre->bin,
+					   &free_bins[ heap_bin ( pre_size ) ]);
 			}
 			/* Update memory usage statistics */
 			freemem -= actual_size;
@@ -371,6 +485,18 @@ void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
 			goto done;
 		}
 
+		/* Perform any deferred frees, which may coalesce into
+		 * a usable block, before resorting to discarding
+		 * cached data.
+		 */
+		if ( deferred_frees ) {
+			valgrind_make_blocks_noaccess();
+			flush_deferred_frees();
+			valgrind_make_blocks_defined();
+			check_blocks();
+			continue;
+		}
+
 		/* Try discarding some cached data to free up memory */
 		DBGC ( &heap, "Attempting discard for %#zx (aligned %#zx+%zx), "
 		       "used %zdkB\n", size, align, offset, ( usedmem >> 10 ) );
@@ -399,9 +525,10 @@ void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
  * @v ptr		Memory allocated by alloc_memblock(), or NULL
  * @v size		Size of the memory
  *
- * If @c ptr is NULL, no action is taken.
+ * If @c ptr is NULL, no action is taken.  The block is inserted into
+ * the free list and coalesced with its neighbours immediately.
  */
-void free_memblock ( void *ptr, size_t size ) {
+static void free_memblock_now ( void *ptr, size_t size ) {
 	struct memory_block *freeing;
 	struct memory_block *block;
 	struct memory_block *tmp;
@@ -464,6 +591,7 @@ void free_memblock ( void *ptr, size_t size ) {
 				( ( ( void * ) freeing ) + freeing->size ) );
 			block->size += actual_size;
 			list_del ( &block->list );
+			list_del ( &block->bin );
 			VALGRIND_MAKE_MEM_NOACCESS ( freeing,
 						     sizeof ( *freeing ) );
 			freeing = block;
@@ -487,9 +615,15 @@ void free_memblock ( void *ptr, size_t size ) {
 			( ( ( void * ) block ) + block->size ) );
 		freeing->size += block->size;
 		list_del ( &block->list );
+		list_del ( &block->bin );
 		VALGRIND_MAKE_MEM_NOACCESS ( block, sizeof ( *block ) );
 	}
 
+	/* Insert into the size class bin matching the (possibly
+	 * merged) size.
+	 */
+	list_add ( &freeing->bin, &free_bins[ heap_bin ( freeing->size ) ] );
+
 	/* Update memory usage statistics */
 	freemem += actual_size;
 	usedmem -= actual_size;
@@ -498,6 +632,62 @@ void free_memblock ( void *ptr, size_t size ) {
 	valgrind_make_blocks_noaccess();
 }
 
+/**
+ * Free a memory block
+ *
+ * @v ptr		Memory allocated by alloc_memblock(), or NULL
+ * @v size		Size of the memory
+ *
+ * If @c ptr is NULL, no action is taken.
+ *
+ * The actual free list insertion and coalescing is deferred: frees
+ * are issued from the network poll loop (e.g. for I/O buffers), and
+ * walking the free list at that point causes latency spikes.  The
+ * block is pushed onto a pending list, which is drained in batch by
+ * the low-priority heap process or by an allocation that would
+ * otherwise fail.
+ */
+void free_memblock ( void *ptr, size_t size ) {
+	struct deferred_free *deferred = ptr;
+
+	/* Allow for ptr==NULL */
+	if ( ! ptr )
+		return;
+
+	/* Add to pending list.  The block is guaranteed to be able
+	 * to hold the bookkeeping, since alloc_memblock() will have
+	 * rounded its actual size up to at least MIN_MEMBLOCK_SIZE.
+	 */
+	deferred->next = deferred_frees;
+	deferred->size = size;
+	deferred_frees = deferred;
+}
+
+/**
+ * Perform all deferred frees
+ *
+ */
+static void flush_deferred_frees ( void ) {
+	struct deferred_free *deferred;
+
+	while ( ( deferred = deferred_frees ) ) {
+		deferred_frees = deferred->next;
+		free_memblock_now ( deferred, deferred->size );
+	}
+}
+
+/**
+ * Perform deferred frees in the background
+ *
+ * @v process		Heap process
+ */
+static void heap_step ( struct process *process __unused ) {
+	flush_deferred_frees();
+}
+
+/** Heap process */
+PERMANENT_PROCESS_SLOW ( heap_process, heap_step );
+
 /**
  * Reallocate memory
  *
@@ -647,23 +837,63 @@ void * zalloc ( size_t size ) {
  */
 void mpopulate ( void *start, size_t len ) {
 
-	/* Prevent free_memblock() from rounding up len beyond the end
-	 * of what we were actually given...
+	/* Prevent free_memblock_now() from rounding up len beyond the
+	 * end of what we were actually given...
 	 */
 	len &= ~( MIN_MEMBLOCK_SIZE - 1 );
 
-	/* Add to allocation pool */
-	free_memblock ( start, len );
+	/* Add to allocation pool immediately; this is initialisation
+	 * rather than a hot-path free.
+	 */
+	free_memblock_now ( start, len );
 
 	/* Fix up memory usage statistics */
 	usedmem += len;
 }
 
+/**
+ * Collect heap usage statistics
+ *
+ * @v stats		Statistics to fill in
+ *
+ * Provides a snapshot of overall heap usage, including the largest
+ * contiguous free block (which bounds the largest possible single
+ * allocation) and the number of free blocks (as a measure of
+ * fragmentation).
+ */
+void mstats ( struct memory_stats *stats ) {
+	struct memory_block *block;
+
+	/* Perform any deferred frees, so that the snapshot reflects
+	 * the fully coalesced state of the heap.
+	 */
+	flush_deferred_frees();
+
+	valgrind_make_blocks_defined();
+	check_blocks();
+
+	memset ( stats, 0, sizeof ( *stats ) );
+	stats->free = freemem;
+	stats->used = usedmem;
+	stats->max_used = maxusedmem;
+	list_for_each_entry ( block, &free_blocks, list ) {
+		if ( block->size > stats->largest_free )
+			stats->largest_free = block->size;
+		stats->fragments++;
+	}
+
+	valgrind_make_blocks_noaccess();
+}
+
 /**
  * Initialise the heap
  *
  */
 static void init_heap ( void ) {
+	unsigned int bin;
+
+	for ( bin = 0 ; bin < HEAP_NUM_BINS ; bin++ )
+		INIT_LIST_HEAD ( &free_bins[bin] );
 	VALGRIND_MAKE_MEM_NOACCESS ( heap, sizeof ( heap ) );
 	VALGRIND_MAKE_MEM_NOACCESS ( &free_blocks, sizeof ( free_blocks ) );
 	mpopulate ( heap, sizeof ( heap ) );
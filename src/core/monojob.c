@@ -25,8 +25,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
+#include <ipxe/list.h>
 #include <ipxe/process.h>
+#include <ipxe/vsprintf.h>
 #include <ipxe/console.h>
 #include <ipxe/keys.h>
 #include <ipxe/job.h>
@@ -39,6 +42,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/** Stall warning threshold
+ *
+ * A job making no progress for this long is reported as stalled, with
+ * a dump of its interface chain to identify the layer at fault.  This
+ * is deliberately shorter than typical retry-logic give-up times,
+ * which can leave a hung boot silent for minutes.
+ */
+#define MONOJOB_STALL_TIMEOUT ( 15 * TICKS_PER_SEC )
+
 static int monojob_rc;
 
 static void monojob_close ( struct interface *intf, int rc ) {
@@ -55,6 +67,219 @@ static struct interface_descriptor monojob_intf_desc =
 
 struct interface monojob = INTF_INIT ( monojob_intf_desc );
 
+/** A deferred foreground job
+ *
+ * While deferral is enabled (via monojob_defer()), jobs that would
+ * otherwise be waited for by monojob_wait() are instead transferred
+ * to a deferred job record and allowed to run concurrently, until
+ * collected by monojob_join().
+ */
+struct monojob_deferred {
+	/** List of deferred jobs */
+	struct list_head list;
+	/** Job control interface */
+	struct interface intf;
+	/** Most recent status */
+	int rc;
+	/** Timeout period, in ticks (0=indefinite) */
+	unsigned long timeout;
+	/** Start time */
+	unsigned long started;
+	/** Job description */
+	char name[0];
+};
+
+/** List of deferred jobs */
+static LIST_HEAD ( monojob_deferred_jobs );
+
+/** Jobs are currently being deferred rather than waited for */
+static int monojob_deferring;
+
+/**
+ * Handle deferred job completion
+ *
+ * @v deferred		Deferred job
+ * @v rc		Reason for close
+ */
+static void monojob_deferred_close ( struct monojob_deferred *deferred,
+				     int rc ) {
+
+	deferred->rc = rc;
+	intf_restart ( &deferred->intf, rc );
+}
+
+/** Deferred job interface operations */
+static struct interface_operation monojob_deferred_op[] = {
+	INTF_OP ( intf_close, struct monojob_deferred *,
+		  monojob_deferred_close ),
+};
+
+/** Deferred job interface descriptor */
+static struct interface_descriptor monojob_deferred_desc =
+	INTF_DESC ( struct monojob_deferred, intf, monojob_deferred_op );
+
+/**
+ * Begin deferring foreground jobs
+ *
+ * @ret rc		Return status code
+ *
+ * Until the next call to monojob_join(), monojob_wait() will return
+ * immediately (with a success status) and leave its job running in
+ * the background, allowing multiple jobs to progress concurrently.
+ */
+int monojob_defer ( void ) {
+
+	if ( monojob_deferring )
+		return -EALREADY;
+	monojob_deferring = 1;
+
+	return 0;
+}
+
+/**
+ * Defer the current foreground job
+ *
+ * @v string		Job description to display, or NULL to be silent
+ * @v timeout		Timeout period, in ticks (0=indefinite)
+ * @ret rc		Return status code
+ */
+static int monojob_wait_deferred ( const char *string,
+				   unsigned long timeout ) {
+	struct monojob_deferred *deferred;
+	size_t name_len = ( ( string ? strlen ( string ) : 0 ) + 1 /* NUL */ );
+
+	/* If the job has somehow already completed, report its status */
+	if ( monojob.dest == &null_intf )
+		return monojob_rc;
+
+	/* Allocate and initialise deferred job */
+	deferred = zalloc ( sizeof ( *deferred ) + name_len );
+	if ( ! deferred ) {
+		intf_restart ( &monojob, -ENOMEM );
+		return -ENOMEM;
+	}
+	intf_init ( &deferred->intf, &monojob_deferred_desc, NULL );
+	deferred->rc = -EINPROGRESS;
+	deferred->timeout = timeout;
+	deferred->started = currticks();
+	if ( string )
+		strcpy ( deferred->name, string );
+
+	/* Transfer job from the monojob interface */
+	intf_plug_plug ( &deferred->intf, monojob.dest );
+	intf_unplug ( &monojob );
+
+	/* Add to list of deferred jobs */
+	list_add_tail ( &deferred->list, &monojob_deferred_jobs );
+
+	if ( string )
+		printf ( "%s... deferred\n", string );
+
+	return 0;
+}
+
+/**
+ * Wait for all deferred jobs to complete
+ *
+ * @v string		Description to display, or NULL to be silent
+ * @ret rc		First non-zero job status code, if any
+ *
+ * Deferral of further jobs is disabled, all currently deferred jobs
+ * are waited for, and their first failure (if any) is reported.
+ */
+int monojob_join ( const char *string ) {
+	struct monojob_deferred *deferred;
+	struct monojob_deferred *tmp;
+	unsigned long last_check;
+	unsigned long now;
+	unsigned long elapsed;
+	int key;
+	int rc = 0;
+
+	/* Stop deferring further jobs */
+	monojob_deferring = 0;
+
+	if ( string )
+		printf ( "%s...", string );
+
+	last_check = currticks();
+	while ( ! list_empty ( &monojob_deferred_jobs ) ) {
+
+		/* Allow jobs to progress */
+		step();
+		now = currticks();
+
+		/* Continue until a timer tick occurs (to minimise
+		 * time wasted checking for completion and keypresses).
+		 */
+		elapsed = ( now - last_check );
+		if ( ! elapsed )
+			continue;
+		last_check = now;
+
+		/* Check for keypresses */
+		if ( iskey() ) {
+			key = getchar();
+			if ( key == CTRL_C ) {
+				rc = -ECANCELED;
+				break;
+			}
+		}
+
+		/* Apply timeouts and reap completed jobs */
+		list_for_each_entry_safe ( deferred, tmp,
+					   &monojob_deferred_jobs, list ) {
+
+			/* Apply timeout, if applicable.  Progress is
+			 * not monitored while a job is deferred, so
+			 * the timeout limits total execution time.
+			 */
+			if ( ( deferred->rc == -EINPROGRESS ) &&
+			     deferred->timeout &&
+			     ( ( now - deferred->started ) >=
+			       deferred->timeout ) ) {
+				intf_shutdown ( &deferred->intf, -ETIMEDOUT );
+				deferred->rc = -ETIMEDOUT;
+			}
+
+			/* Leave running jobs in place */
+			if ( deferred->rc == -EINPROGRESS )
+				continue;
+
+			/* Report and record first failure */
+			if ( deferred->rc != 0 ) {
+				printf ( "%s%s%s\n", deferred->name,
+					 ( deferred->name[0] ? ": " : "" ),
+					 strerror ( deferred->rc ) );
+				if ( rc == 0 )
+					rc = deferred->rc;
+			}
+
+			/* Discard completed job */
+			list_del ( &deferred->list );
+			free ( deferred );
+		}
+	}
+
+	/* Cancel any remaining jobs */
+	list_for_each_entry_safe ( deferred, tmp, &monojob_deferred_jobs,
+				   list ) {
+		intf_shutdown ( &deferred->intf, -ECANCELED );
+		list_del ( &deferred->list );
+		free ( deferred );
+	}
+
+	if ( string ) {
+		if ( rc ) {
+			printf ( " %s\n", strerror ( rc ) );
+		} else {
+			printf ( " ok\n" );
+		}
+	}
+
+	return rc;
+}
+
 /**
  * Clear previously displayed message
  *
@@ -80,6 +305,9 @@ static void monojob_clear ( size_t len ) {
  */
 int monojob_wait ( const char *string, unsigned long timeout ) {
 	struct job_progress progress;
+	struct job_rate rate;
+	unsigned long per_sec;
+	unsigned long eta;
 	unsigned long last_check;
 	unsigned long last_progress;
 	unsigned long last_display;
@@ -89,13 +317,41 @@ int monojob_wait ( const char *string, unsigned long timeout ) {
 	unsigned long scaled_completed;
 	unsigned long scaled_total;
 	unsigned int percentage;
+	char display[ 48 + sizeof ( progress.message ) ];
+	char displayed[ sizeof ( display ) ];
+	size_t len;
 	size_t clear_len = 0;
+	int stalled = 0;
 	int ongoing_rc;
 	int key;
 	int rc;
 
+	/* Defer the job instead of waiting, if applicable */
+	if ( monojob_deferring )
+		return monojob_wait_deferred ( string, timeout );
+
+	/* If the job has already completed (e.g. while the caller was
+	 * performing other work between starting the job and waiting
+	 * for it), report its recorded status rather than waiting for
+	 * a completion that will never arrive.
+	 */
+	if ( monojob.dest == &null_intf ) {
+		rc = monojob_rc;
+		if ( string ) {
+			printf ( "%s...", string );
+			if ( rc ) {
+				printf ( " %s\n", strerror ( rc ) );
+			} else {
+				printf ( " ok\n" );
+			}
+		}
+		return rc;
+	}
+
 	if ( string )
 		printf ( "%s...", string );
+	memset ( &rate, 0, sizeof ( rate ) );
+	displayed[0] = '\0';
 	monojob_rc = -EINPROGRESS;
 	last_check = last_progress = last_display = currticks();
 	while ( monojob_rc == -EINPROGRESS ) {
@@ -125,8 +381,10 @@ int monojob_wait ( const char *string, unsigned long timeout ) {
 		ongoing_rc = job_progress ( &monojob, &progress );
 
 		/* Reset timeout if progress has been made */
-		if ( completed != progress.completed )
+		if ( completed != progress.completed ) {
 			last_progress = now;
+			stalled = 0;
+		}
 		completed = progress.completed;
 
 		/* Check for timeout, if applicable */
@@ -136,24 +394,74 @@ int monojob_wait ( const char *string, unsigned long timeout ) {
 			break;
 		}
 
-		/* Display progress, if applicable */
+		/* Warn (once per stall) if no progress is being made,
+		 * and dump the interface chain to identify the layer
+		 * at fault.
+		 */
+		if ( ( elapsed >= MONOJOB_STALL_TIMEOUT ) && ! stalled ) {
+			stalled = 1;
+			monojob_clear ( clear_len );
+			clear_len = 0;
+			displayed[0] = '\0';
+			printf ( " stalled for %lds: ",
+				 ( elapsed / TICKS_PER_SEC ) );
+			intf_dump_chain ( &monojob );
+		}
+
+		/* Display progress, if applicable.  The report is
+		 * rendered to a buffer and emitted only when its
+		 * content has changed, since each console repaint may
+		 * cross into firmware output (e.g. BMC serial) that
+		 * costs milliseconds within the loop that is also
+		 * stepping the network.
+		 */
 		elapsed = ( now - last_display );
 		if ( string && ( elapsed >= TICKS_PER_SEC ) ) {
-			monojob_clear ( clear_len );
 			/* Normalise progress figures to avoid overflow */
 			scaled_completed = ( progress.completed / 128 );
 			scaled_total = ( progress.total / 128 );
+			job_rate_sample ( &rate, progress.completed );
+			per_sec = job_rate_per_sec ( &rate );
 			if ( scaled_total ) {
+				/* Render progress report */
 				percentage = ( ( 100 * scaled_completed ) /
 					       scaled_total );
-				clear_len = printf ( "%3d%%", percentage );
+				len = ssnprintf ( display, sizeof ( display ),
+						  "%3d%%", percentage );
+				if ( rate.count >= 2 ) {
+					len += ssnprintf ( ( display + len ),
+							   ( sizeof ( display )
+							     - len ),
+							   " %ldkB/s",
+							   ( per_sec / 1024 ) );
+				}
+				eta = job_rate_eta ( &rate, progress.total );
+				if ( eta ) {
+					len += ssnprintf ( ( display + len ),
+							   ( sizeof ( display )
+							     - len ),
+							   " %ld:%02ld",
+							   ( eta / 60 ),
+							   ( eta % 60 ) );
+				}
+				if ( progress.message[0] ) {
+					len += ssnprintf ( ( display + len ),
+							   ( sizeof ( display )
+							     - len ), " [%s]",
+							   progress.message );
+				}
+				/* Repaint only on change */
+				if ( strcmp ( display, displayed ) != 0 ) {
+					monojob_clear ( clear_len );
+					clear_len = printf ( "%s", display );
+					strcpy ( displayed, display );
+				}
 			} else {
-				printf ( "." );
+				/* Display an activity indicator */
+				monojob_clear ( clear_len );
 				clear_len = 0;
-			}
-			if ( progress.message[0] ) {
-				clear_len += printf ( " [%s]",
-						      progress.message );
+				printf ( "." );
+				displayed[0] = '\0';
 			}
 			last_display = now;
 		}
@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <byteswap.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/interface.h>
+#include <ipxe/job.h>
+#include <ipxe/xfer.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/open.h>
+#include <ipxe/socket.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/udp.h>
+#include <ipxe/process.h>
+#include <ipxe/retry.h>
+#include <ipxe/timer.h>
+#include <ipxe/netbench.h>
+
+/** @file
+ *
+ * Network throughput benchmark
+ *
+ * The benchmark either transmits fixed-size packets as fast as the
+ * data transfer window allows (sender mode, over UDP or TCP), or
+ * counts packets arriving on a local UDP port (receiver mode), for a
+ * fixed duration.  This allows raw network capability to be measured
+ * independently of any server's performance.
+ */
+
+/** Maximum number of packets to transmit per process step */
+#define NETBENCH_BURST 8
+
+/** A network benchmark */
+struct netbench {
+	/** Reference count */
+	struct refcnt refcnt;
+
+	/** Job control interface */
+	struct interface job;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Transmission process */
+	struct process process;
+	/** Duration timer */
+	struct retry_timer timer;
+
+	/** Payload length */
+	size_t len;
+	/** Test duration (in ticks) */
+	unsigned long duration;
+	/** Operate as receiver */
+	int rx;
+	/** Test period has started */
+	int running;
+	/** Start timestamp (in ticks) */
+	unsigned long started;
+	/** Number of packets transferred */
+	unsigned long packets;
+	/** Number of bytes transferred */
+	unsigned long long bytes;
+
+	/** Callback function
+	 *
+	 * @v packets		Number of packets transferred
+	 * @v bytes		Number of bytes transferred
+	 * @v ticks		Elapsed time (in ticks)
+	 */
+	void ( * callback ) ( unsigned long packets, unsigned long long bytes,
+			      unsigned long ticks );
+};
+
+/**
+ * Close benchmark
+ *
+ * @v netbench		Network benchmark
+ * @v rc		Reason for close
+ */
+static void netbench_close ( struct netbench *netbench, int rc ) {
+
+	/* Stop timer and transmission process */
+	stop_timer ( &netbench->timer );
+	process_del ( &netbench->process );
+
+	/* Shut down interfaces */
+	intf_shutdown ( &netbench->xfer, rc );
+	intf_shutdown ( &netbench->job, rc );
+}
+
+/**
+ * Start test period
+ *
+ * @v netbench		Network benchmark
+ */
+static void netbench_start ( struct netbench *netbench ) {
+
+	/* Do nothing if test period has already started */
+	if ( netbench->running )
+		return;
+
+	/* Record start time and schedule end of test */
+	netbench->running = 1;
+	netbench->started = currticks();
+	start_timer_fixed ( &netbench->timer, netbench->duration );
+}
+
+/**
+ * Handle test duration expiry
+ *
+ * @v timer		Duration timer
+ * @v over		Failure indicator
+ */
+static void netbench_expired ( struct retry_timer *timer,
+			       int over __unused ) {
+	struct netbench *netbench =
+		container_of ( timer, struct netbench, timer );
+	unsigned long ticks = ( currticks() - netbench->started );
+
+	/* Report results */
+	if ( netbench->callback ) {
+		netbench->callback ( netbench->packets, netbench->bytes,
+				     ticks );
+	}
+
+	/* Terminate */
+	netbench_close ( netbench, 0 );
+}
+
+/**
+ * Transmit packets
+ *
+ * @v netbench		Network benchmark
+ */
+static void netbench_step ( struct netbench *netbench ) {
+	struct io_buffer *iobuf;
+	unsigned int burst;
+	int rc;
+
+	/* Transmit up to a small burst of packets, to avoid starving
+	 * other processes (including the network stack itself).
+	 */
+	for ( burst = 0 ; burst < NETBENCH_BURST ; burst++ ) {
+
+		/* Wait for transmit window to reopen */
+		if ( xfer_window ( &netbench->xfer ) < netbench->len )
+			return;
+
+		/* Allocate and fill I/O buffer */
+		iobuf = xfer_alloc_iob ( &netbench->xfer, netbench->len );
+		if ( ! iobuf )
+			return;
+		memset ( iob_put ( iobuf, netbench->len ), 0xaa,
+			 netbench->len );
+
+		/* Transmit packet */
+		if ( ( rc = xfer_deliver_iob ( &netbench->xfer,
+					       iobuf ) ) != 0 ) {
+			DBGC ( netbench, "NETBENCH %p could not transmit: "
+			       "%s\n", netbench, strerror ( rc ) );
+			netbench_close ( netbench, rc );
+			return;
+		}
+		netbench->packets++;
+		netbench->bytes += netbench->len;
+	}
+}
+
+/**
+ * Handle data transfer window change
+ *
+ * @v netbench		Network benchmark
+ */
+static void netbench_window_changed ( struct netbench *netbench ) {
+
+	/* Start test period when transmit window first opens */
+	if ( ( ! netbench->rx ) && xfer_window ( &netbench->xfer ) ) {
+		netbench_start ( netbench );
+		if ( ! process_running ( &netbench->process ) )
+			process_add ( &netbench->process );
+	}
+}
+
+/**
+ * Handle received data
+ *
+ * @v netbench		Network benchmark
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int netbench_deliver ( struct netbench *netbench,
+			      struct io_buffer *iobuf,
+			      struct xfer_metadata *meta __unused ) {
+
+	/* Count received packets (in receiver mode only); the test
+	 * period starts when the first packet arrives.
+	 */
+	if ( netbench->rx ) {
+		netbench_start ( netbench );
+		netbench->packets++;
+		netbench->bytes += iob_len ( iobuf );
+	}
+
+	/* Discard I/O buffer */
+	free_iob ( iobuf );
+
+	return 0;
+}
+
+/**
+ * Report progress of benchmark
+ *
+ * @v netbench		Network benchmark
+ * @v progress		Progress report to fill in
+ * @ret ongoing_rc	Ongoing job status code (if known)
+ */
+static int netbench_progress ( struct netbench *netbench,
+			       struct job_progress *progress ) {
+
+	progress->completed = netbench->bytes;
+	snprintf ( progress->message, sizeof ( progress->message ),
+		   "%ld packets", netbench->packets );
+	return 0;
+}
+
+/** Network benchmark data transfer interface operations */
+static struct interface_operation netbench_xfer_op[] = {
+	INTF_OP ( xfer_deliver, struct netbench *, netbench_deliver ),
+	INTF_OP ( xfer_window_changed, struct netbench *,
+		  netbench_window_changed ),
+	INTF_OP ( intf_close, struct netbench *, netbench_close ),
+};
+
+/** Network benchmark data transfer interface descriptor */
+static struct interface_descriptor netbench_xfer_desc =
+	INTF_DESC ( struct netbench, xfer, netbench_xfer_op );
+
+/** Network benchmark job control interface operations */
+static struct interface_operation netbench_job_op[] = {
+	INTF_OP ( job_progress, struct netbench *, netbench_progress ),
+	INTF_OP ( intf_close, struct netbench *, netbench_close ),
+};
+
+/** Network benchmark job control interface descriptor */
+static struct interface_descriptor netbench_job_desc =
+	INTF_DESC ( struct netbench, job, netbench_job_op );
+
+/** Network benchmark process descriptor */
+static struct process_descriptor netbench_process_desc =
+	PROC_DESC ( struct netbench, process, netbench_step );
+
+/**
+ * Create network benchmark
+ *
+ * @v job		Job control interface
+ * @v semantics		Communication semantics (e.g. SOCK_DGRAM)
+ * @v hostname		Hostname to transmit to (ignored in receiver mode)
+ * @v port		Port number
+ * @v len		Payload length
+ * @v duration		Test duration (in ticks)
+ * @v rx		Operate as receiver (UDP only)
+ * @v callback		Callback function (or NULL)
+ * @ret rc		Return status code
+ */
+int create_netbench ( struct interface *job, int semantics,
+		      const char *hostname, unsigned int port,
+		      size_t len, unsigned long duration, int rx,
+		      void ( * callback ) ( unsigned long packets,
+					    unsigned long long bytes,
+					    unsigned long ticks ) ) {
+	struct netbench *netbench;
+	union {
+		struct sockaddr sa;
+		struct sockaddr_tcpip st;
+	} addr;
+	int rc;
+
+	/* Sanity checks */
+	if ( ( ! duration ) || ( ! len ) )
+		return -EINVAL;
+	if ( rx && ( semantics != SOCK_DGRAM ) )
+		return -ENOTSUP;
+
+	/* Allocate and initialise structure */
+	netbench = zalloc ( sizeof ( *netbench ) );
+	if ( ! netbench )
+		return -ENOMEM;
+	ref_init ( &netbench->refcnt, NULL );
+	intf_init ( &netbench->job, &netbench_job_desc, &netbench->refcnt );
+	intf_init ( &netbench->xfer, &netbench_xfer_desc, &netbench->refcnt );
+	process_init_stopped ( &netbench->process, &netbench_process_desc,
+			       &netbench->refcnt );
+	timer_init ( &netbench->timer, netbench_expired, &netbench->refcnt );
+	netbench->len = len;
+	netbench->duration = duration;
+	netbench->rx = rx;
+	netbench->callback = callback;
+
+	/* Open socket */
+	memset ( &addr, 0, sizeof ( addr ) );
+	addr.st.st_port = htons ( port );
+	if ( rx ) {
+		rc = udp_open ( &netbench->xfer, NULL, &addr.sa );
+	} else {
+		rc = xfer_open_named_socket ( &netbench->xfer, semantics,
+					      &addr.sa, hostname, NULL );
+	}
+	if ( rc != 0 ) {
+		DBGC ( netbench, "NETBENCH %p could not open socket: %s\n",
+		       netbench, strerror ( rc ) );
+		goto err;
+	}
+
+	/* Attach parent interface, mortalise self, and return */
+	intf_plug_plug ( &netbench->job, job );
+	ref_put ( &netbench->refcnt );
+	return 0;
+
+ err:
+	netbench_close ( netbench, rc );
+	ref_put ( &netbench->refcnt );
+	return rc;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/list.h>
+#include <ipxe/malloc.h>
+#include <ipxe/objpool.h>
+
+/** @file
+ *
+ * Object pools
+ *
+ * Protocol control blocks (TCP connections, DNS queries, and similar)
+ * are allocated and freed through the general heap on every
+ * connection, and must be zeroed on each allocation.  An object pool
+ * retains freed objects of a single type and hands them back to
+ * subsequent allocations of the same size, bypassing the heap on the
+ * connection churn path.  Objects are zeroed at the point of freeing,
+ * while their contents are still cache-warm, so a recycled object is
+ * returned pre-zeroed with almost no memory traffic.
+ *
+ * Pooled objects hold their own bookkeeping, so a pool adds no memory
+ * overhead beyond the retained objects themselves, which are released
+ * under memory pressure via the cache discarder mechanism.
+ */
+
+/** List of all object pools holding at least one object */
+static LIST_HEAD ( objpools );
+
+/** A pooled object
+ *
+ * This structure is stored within the (freed and zeroed) object
+ * itself.
+ */
+struct objpool_object {
+	/** List of pooled objects */
+	struct list_head list;
+	/** Length of object */
+	size_t len;
+};
+
+/**
+ * Allocate an object
+ *
+ * @v pool	Object pool
+ * @v len	Length of object
+ * @ret ptr	Object, or NULL if none available
+ *
+ * The returned object is zeroed, as with zalloc().
+ */
+void * objpool_alloc ( struct objpool *pool, size_t len ) {
+	struct objpool_object *object;
+
+	/* Reuse a pooled object with matching length, if available */
+	list_for_each_entry ( object, &pool->free, list ) {
+		if ( object->len == len ) {
+			list_del ( &object->list );
+			pool->count--;
+			if ( ! pool->count )
+				list_del ( &pool->list );
+			/* Object body was zeroed when freed; erase
+			 * only the pool bookkeeping.
+			 */
+			memset ( object, 0, sizeof ( *object ) );
+			return object;
+		}
+	}
+
+	/* Fall back to the heap */
+	return zalloc ( len );
+}
+
+/**
+ * Free an object
+ *
+ * @v pool	Object pool
+ * @v ptr	Object
+ * @v len	Length of object
+ */
+void objpool_free ( struct objpool *pool, void *ptr, size_t len ) {
+	struct objpool_object *object = ptr;
+
+	/* Allow objpool_free(NULL) to be valid */
+	if ( ! ptr )
+		return;
+
+	/* Free directly if the object cannot hold the bookkeeping, or
+	 * if the pool is already full.
+	 */
+	if ( ( len < sizeof ( *object ) ) || ( pool->count >= pool->max ) ) {
+		free ( ptr );
+		return;
+	}
+
+	/* Zero object now, while its contents are still cache-warm */
+	memset ( ptr, 0, len );
+
+	/* Add to pool */
+	object->len = len;
+	list_add ( &object->list, &pool->free );
+	if ( ! pool->count )
+		list_add ( &pool->list, &objpools );
+	pool->count++;
+}
+
+/**
+ * Discard a pooled object
+ *
+ * @ret discarded	Number of objects discarded
+ */
+static unsigned int objpool_discard ( void ) {
+	struct objpool *pool;
+	struct objpool_object *object;
+
+	/* Discard most recently pooled object from the first
+	 * non-empty pool, if any.
+	 */
+	list_for_each_entry ( pool, &objpools, list ) {
+		object = list_first_entry ( &pool->free,
+					    struct objpool_object, list );
+		if ( ! object )
+			continue;
+		list_del ( &object->list );
+		pool->count--;
+		if ( ! pool->count )
+			list_del ( &pool->list );
+		free ( object );
+		return 1;
+	}
+
+	return 0;
+}
+
+/** Object pool cache discarder */
+struct cache_discarder objpool_discarder __cache_discarder ( CACHE_CHEAP ) = {
+	.discard = objpool_discard,
+};
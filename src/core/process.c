@@ -38,6 +38,16 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Process run queue */
 static LIST_HEAD ( run_queue );
 
+/** Scheduling divisor for low-priority processes
+ *
+ * A low-priority (housekeeping) process runs on only one in this many
+ * of its scheduling opportunities; the remainder are yielded to
+ * data-path processes.  May be overridden at build time.
+ */
+#ifndef PROCESS_SLOW_DIVISOR
+#define PROCESS_SLOW_DIVISOR 8
+#endif
+
 /**
  * Get pointer to object containing process
  *
@@ -89,6 +99,18 @@ void process_del ( struct process *process ) {
 	}
 }
 
+/**
+ * Check if process is the only runnable process
+ *
+ * @v process		Process
+ * @ret sole		Process is the sole runnable process
+ */
+int process_sole ( struct process *process ) {
+
+	return ( ( run_queue.next == &process->list ) &&
+		 ( run_queue.prev == &process->list ) );
+}
+
 /**
  * Single-step a single process
  *
@@ -100,10 +122,27 @@ void step ( void ) {
 	struct process_descriptor *desc;
 	void *object;
 
-	if ( ( process = list_first_entry ( &run_queue, struct process,
-					    list ) ) ) {
-		ref_get ( process->refcnt ); /* Inhibit destruction mid-step */
+	while ( ( process = list_first_entry ( &run_queue, struct process,
+					       list ) ) ) {
 		desc = process->desc;
+
+		/* Defer low-priority processes in favour of data-path
+		 * processes: rotate them to the back of the run queue
+		 * unrun until one in every PROCESS_SLOW_DIVISOR
+		 * visits.  This is guaranteed to terminate, since
+		 * each deferral increments the deferred process's
+		 * visit counter.
+		 */
+		if ( ( desc->priority != PROC_PRIO_FAST ) &&
+		     ( ++process->skips < PROCESS_SLOW_DIVISOR ) &&
+		     ( ! process_sole ( process ) ) ) {
+			list_del ( &process->list );
+			list_add_tail ( &process->list, &run_queue );
+			continue;
+		}
+		process->skips = 0;
+
+		ref_get ( process->refcnt ); /* Inhibit destruction mid-step */
 		object = process_object ( process );
 		if ( desc->reschedule ) {
 			list_del ( &process->list );
@@ -113,10 +152,15 @@ void step ( void ) {
 		}
 		DBGC2 ( PROC_COL ( process ), "PROCESS " PROC_FMT
 			" executing\n", PROC_DBG ( process ) );
+		if ( desc->profiler )
+			profile_start ( desc->profiler );
 		desc->step ( object );
+		if ( desc->profiler )
+			profile_stop ( desc->profiler );
 		DBGC2 ( PROC_COL ( process ), "PROCESS " PROC_FMT
 			" finished executing\n", PROC_DBG ( process ) );
 		ref_put ( process->refcnt ); /* Allow destruction */
+		return;
 	}
 }
 
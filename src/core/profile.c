@@ -29,6 +29,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <limits.h>
 #include <assert.h>
 #include <ipxe/isqrt.h>
+#include <ipxe/vsprintf.h>
+#include <ipxe/settings.h>
 #include <ipxe/profile.h>
 
 /** @file
@@ -276,3 +278,53 @@ unsigned long profile_stddev ( struct profiler *profiler ) {
 
 	return isqrt ( profile_variance ( profiler ) );
 }
+
+/******************************************************************************
+ *
+ * Profiling statistics export
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Fetch profiling statistics setting
+ *
+ * @v data		Buffer to fill with setting data
+ * @v len		Length of buffer
+ * @ret len		Length of setting data, or negative error
+ *
+ * Each profiler with at least one sample is exported as
+ * "name=mean/stddev/count" (in timestamp ticks), with records
+ * separated by commas so that the value can be passed through to
+ * e.g. a booted kernel's command line for fleet telemetry.
+ */
+static int profstat_fetch ( void *data, size_t len ) {
+	struct profiler *profiler;
+	size_t used = 0;
+
+	for_each_table_entry ( profiler, PROFILERS ) {
+		if ( ! profiler->count )
+			continue;
+		used += ssnprintf ( ( data + used ), ( len - used ),
+				    "%s%s=%ld/%ld/%d",
+				    ( used ? "," : "" ), profiler->name,
+				    profile_mean ( profiler ),
+				    profile_stddev ( profiler ),
+				    profiler->count );
+	}
+	return used;
+}
+
+/** Profiling statistics setting */
+const struct setting profstat_setting __setting ( SETTING_MISC, profstat ) = {
+	.name = "profstat",
+	.description = "Profiling statistics",
+	.type = &setting_type_string,
+	.scope = &builtin_scope,
+};
+
+/** Profiling statistics built-in setting */
+struct builtin_setting profstat_builtin_setting __builtin_setting = {
+	.setting = &profstat_setting,
+	.fetch = profstat_fetch,
+};
@@ -27,9 +27,13 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <assert.h>
+#include <ipxe/iobuf.h>
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
 #include <ipxe/process.h>
+#include <ipxe/retry.h>
+#include <ipxe/timer.h>
 #include <ipxe/socket.h>
 #include <ipxe/resolv.h>
 
@@ -291,6 +295,191 @@ int resolv ( struct interface *resolv, const char *name,
 	return rc;	
 }
 
+/***************************************************************************
+ *
+ * Multiple name resolution
+ *
+ ***************************************************************************
+ */
+
+struct resolv_multi;
+
+/** A multiple name resolution child */
+struct resolv_multi_child {
+	/** Containing multiple name resolution */
+	struct resolv_multi *multi;
+	/** Name resolution interface */
+	struct interface resolv;
+};
+
+/** A multiple name resolution */
+struct resolv_multi {
+	/** Reference counter */
+	struct refcnt refcnt;
+	/** Parent name resolution interface */
+	struct interface parent;
+
+	/** Number of child resolutions */
+	unsigned int count;
+	/** Number of resolutions still in progress */
+	unsigned int remaining;
+	/** Number of successful resolutions */
+	unsigned int successes;
+	/** Most recent failure */
+	int rc;
+
+	/** Child resolutions
+	 *
+	 * Must be at end of structure
+	 */
+	struct resolv_multi_child child[0];
+};
+
+/**
+ * Close multiple name resolution
+ *
+ * @v multi		Multiple name resolution
+ * @v rc		Reason for close
+ */
+static void resmulti_close ( struct resolv_multi *multi, int rc ) {
+	unsigned int i;
+
+	/* Shut down all interfaces */
+	for ( i = 0 ; i < multi->count ; i++ )
+		intf_shutdown ( &multi->child[i].resolv, rc );
+	intf_shutdown ( &multi->parent, rc );
+}
+
+/**
+ * Child resolved name
+ *
+ * @v child		Multiple name resolution child
+ * @v sa		Completed socket address
+ */
+static void resmulti_child_resolv_done ( struct resolv_multi_child *child,
+					 struct sockaddr *sa ) {
+	struct resolv_multi *multi = child->multi;
+
+	/* Record success and pass resolved address to parent */
+	multi->successes++;
+	resolv_done ( &multi->parent, sa );
+}
+
+/**
+ * Child finished resolution
+ *
+ * @v child		Multiple name resolution child
+ * @v rc		Return status code
+ */
+static void resmulti_child_close ( struct resolv_multi_child *child, int rc ) {
+	struct resolv_multi *multi = child->multi;
+
+	/* Restart child interface */
+	intf_restart ( &child->resolv, rc );
+
+	/* Record most recent failure */
+	if ( rc != 0 )
+		multi->rc = rc;
+
+	/* Wait until all resolutions have completed */
+	assert ( multi->remaining > 0 );
+	if ( --multi->remaining )
+		return;
+
+	/* Close with success if any resolution succeeded */
+	resmulti_close ( multi, ( multi->successes ? 0 : multi->rc ) );
+}
+
+/** Multiple name resolution child interface operations */
+static struct interface_operation resmulti_child_op[] = {
+	INTF_OP ( resolv_done, struct resolv_multi_child *,
+		  resmulti_child_resolv_done ),
+	INTF_OP ( intf_close, struct resolv_multi_child *,
+		  resmulti_child_close ),
+};
+
+/** Multiple name resolution child interface descriptor */
+static struct interface_descriptor resmulti_child_desc =
+	INTF_DESC ( struct resolv_multi_child, resolv, resmulti_child_op );
+
+/** Multiple name resolution parent interface operations */
+static struct interface_operation resmulti_parent_op[] = {
+	INTF_OP ( intf_close, struct resolv_multi *, resmulti_close ),
+};
+
+/** Multiple name resolution parent interface descriptor */
+static struct interface_descriptor resmulti_parent_desc =
+	INTF_DESC ( struct resolv_multi, parent, resmulti_parent_op );
+
+/**
+ * Start multiple name resolutions
+ *
+ * @v parent		Name resolution interface
+ * @v names		Names to resolve
+ * @v count		Number of names
+ * @v sa		Socket address template to complete
+ * @ret rc		Return status code
+ *
+ * All resolutions proceed concurrently.  The parent interface
+ * receives one resolv_done() per successfully resolved name, in
+ * completion order, and is closed once all resolutions have
+ * completed, with a success status if any name was resolved.
+ */
+int resolv_multi ( struct interface *parent, const char **names,
+		   unsigned int count, struct sockaddr *sa ) {
+	struct resolv_multi *multi;
+	struct resolv_multi_child *child;
+	unsigned int i;
+	int rc;
+
+	/* Sanity check */
+	if ( ! count )
+		return -EINVAL;
+
+	/* Allocate and initialise structure */
+	multi = zalloc ( sizeof ( *multi ) +
+			 ( count * sizeof ( multi->child[0] ) ) );
+	if ( ! multi )
+		return -ENOMEM;
+	ref_init ( &multi->refcnt, NULL );
+	intf_init ( &multi->parent, &resmulti_parent_desc, &multi->refcnt );
+	multi->count = count;
+	multi->remaining = count;
+	for ( i = 0 ; i < count ; i++ ) {
+		child = &multi->child[i];
+		child->multi = multi;
+		intf_init ( &child->resolv, &resmulti_child_desc,
+			    &multi->refcnt );
+	}
+
+	DBGC ( multi, "RESOLV %p attempting %d concurrent resolutions\n",
+	       multi, count );
+
+	/* Start all resolutions.  Completions are never delivered
+	 * synchronously from within resolv(), so the in-progress
+	 * count cannot reach zero before the loop has finished.
+	 */
+	for ( i = 0 ; i < count ; i++ ) {
+		child = &multi->child[i];
+		if ( ( rc = resolv ( &child->resolv, names[i], sa ) ) != 0 ) {
+			multi->rc = rc;
+			multi->remaining--;
+		}
+	}
+	if ( ! multi->remaining )
+		goto err;
+
+	/* Attach parent interface, mortalise self, and return */
+	intf_plug_plug ( &multi->parent, parent );
+	ref_put ( &multi->refcnt );
+	return 0;
+
+ err:
+	rc = multi->rc;
+	ref_put ( &multi->refcnt );
+	return rc;
+}
+
 /***************************************************************************
  *
  * Named socket opening
@@ -298,6 +487,22 @@ int resolv ( struct interface *resolv, const char *name,
  ***************************************************************************
  */
 
+/** Delay before attempting a connection to the less-preferred address
+ * family (in ticks)
+ *
+ * Where a name resolves to both an IPv6 and an IPv4 address, probe
+ * connections to both are raced, with the IPv4 attempt handicapped by
+ * this delay so that a working IPv6 path wins (RFC 8305 "Connection
+ * Attempt Delay").  A broken IPv6 path costs at most this delay,
+ * rather than a full connection timeout.
+ */
+#ifndef NAMED_CONN_DELAY
+#define NAMED_CONN_DELAY ( TICKS_PER_SEC / 4 )
+#endif
+
+/** Maximum number of addresses raced for a named socket */
+#define NAMED_MAX_ADDRESSES 2
+
 /** A named socket */
 struct named_socket {
 	/** Reference counter */
@@ -312,6 +517,19 @@ struct named_socket {
 	struct sockaddr local;
 	/** Stored local socket address exists */
 	int have_local;
+
+	/** Resolved peer socket addresses, in order of preference */
+	struct sockaddr peers[NAMED_MAX_ADDRESSES];
+	/** Number of resolved peer socket addresses */
+	unsigned int count;
+	/** Probe connections (one per resolved address) */
+	struct interface probe[NAMED_MAX_ADDRESSES];
+	/** Number of probe connections started */
+	unsigned int started;
+	/** Number of probe connections that have failed */
+	unsigned int failed;
+	/** Probe connection stagger timer */
+	struct retry_timer timer;
 };
 
 /**
@@ -321,7 +539,14 @@ struct named_socket {
  * @v rc		Reason for termination
  */
 static void named_close ( struct named_socket *named, int rc ) {
+	unsigned int i;
+
+	/* Stop stagger timer */
+	stop_timer ( &named->timer );
+
 	/* Shut down interfaces */
+	for ( i = 0 ; i < NAMED_MAX_ADDRESSES ; i++ )
+		intf_shutdown ( &named->probe[i], rc );
 	intf_shutdown ( &named->resolv, rc );
 	intf_shutdown ( &named->xfer, rc );
 }
@@ -349,13 +574,13 @@ static struct interface_descriptor named_xfer_desc =
 			     resolv );
 
 /**
- * Name resolved
+ * Redirect consumer to a completed socket address
  *
  * @v named		Named socket
  * @v sa		Completed socket address
  */
-static void named_resolv_done ( struct named_socket *named,
-				struct sockaddr *sa ) {
+static void named_redirect ( struct named_socket *named,
+			     struct sockaddr *sa ) {
 	int rc;
 
 	/* Nullify data transfer interface */
@@ -379,9 +604,265 @@ static void named_resolv_done ( struct named_socket *named,
 	named_close ( named, rc );
 }
 
+/**
+ * Start the next probe connection
+ *
+ * @v named		Named socket
+ */
+static void named_probe_start ( struct named_socket *named );
+
+/**
+ * Record a probe connection failure
+ *
+ * @v named		Named socket
+ * @v rc		Reason for failure
+ */
+static void named_probe_failed ( struct named_socket *named, int rc ) {
+
+	/* Record failure */
+	named->failed++;
+
+	/* Give up if all probes have failed */
+	if ( named->failed == named->count ) {
+		named_close ( named, rc );
+		return;
+	}
+
+	/* Bring forward the next connection attempt, if any */
+	if ( named->started < named->count ) {
+		stop_timer ( &named->timer );
+		named_probe_start ( named );
+	}
+}
+
+/**
+ * Start the next probe connection
+ *
+ * @v named		Named socket
+ */
+static void named_probe_start ( struct named_socket *named ) {
+	unsigned int i = named->started;
+	int rc;
+
+	assert ( i < named->count );
+	named->started++;
+	DBGC ( named, "NAMED %p probing %s\n",
+	       named, sock_ntoa ( &named->peers[i] ) );
+	if ( ( rc = xfer_open_socket ( &named->probe[i], named->semantics,
+				       &named->peers[i],
+				       ( named->have_local ?
+					 &named->local : NULL ) ) ) != 0 ) {
+		DBGC ( named, "NAMED %p could not probe %s: %s\n", named,
+		       sock_ntoa ( &named->peers[i] ), strerror ( rc ) );
+		named_probe_failed ( named, rc );
+	}
+}
+
+/**
+ * Handle window change on a probe connection
+ *
+ * @v named		Named socket
+ * @v i			Probe connection index
+ */
+static void named_probe_ready ( struct named_socket *named,
+				unsigned int i ) {
+
+	/* Ignore anything other than readiness to transmit */
+	if ( ! xfer_window ( &named->probe[i] ) )
+		return;
+
+	/* This address won the race; redirect the consumer to it.
+	 * The consumer connects afresh (the probe connection itself
+	 * cannot be respliced to the consumer), costing one extra
+	 * handshake round trip on a path now known to work.
+	 */
+	DBGC ( named, "NAMED %p probe for %s won\n",
+	       named, sock_ntoa ( &named->peers[i] ) );
+	named_redirect ( named, &named->peers[i] );
+}
+
+/**
+ * Handle closure of a probe connection
+ *
+ * @v named		Named socket
+ * @v i			Probe connection index
+ * @v rc		Reason for close
+ */
+static void named_probe_closed ( struct named_socket *named,
+				 unsigned int i, int rc ) {
+
+	DBGC ( named, "NAMED %p probe for %s failed: %s\n", named,
+	       sock_ntoa ( &named->peers[i] ), strerror ( rc ) );
+
+	/* Shut down probe interface */
+	intf_shutdown ( &named->probe[i], rc );
+
+	/* Treat closure as a probe failure */
+	named_probe_failed ( named, ( rc ? rc : -ECONNRESET ) );
+}
+
+/**
+ * Discard data received on a probe connection
+ *
+ * @v named		Named socket
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ *
+ * A probe connection exists only to verify reachability; any data
+ * received (e.g. a server greeting banner) is discarded, and will be
+ * resent by the server on the consumer's own connection.
+ */
+static int named_probe_deliver ( struct named_socket *named __unused,
+				 struct io_buffer *iobuf,
+				 struct xfer_metadata *meta __unused ) {
+
+	free_iob ( iobuf );
+	return 0;
+}
+
+/**
+ * Handle window change on first probe connection
+ *
+ * @v named		Named socket
+ */
+static void named_probe0_ready ( struct named_socket *named ) {
+	named_probe_ready ( named, 0 );
+}
+
+/**
+ * Handle closure of first probe connection
+ *
+ * @v named		Named socket
+ * @v rc		Reason for close
+ */
+static void named_probe0_closed ( struct named_socket *named, int rc ) {
+	named_probe_closed ( named, 0, rc );
+}
+
+/**
+ * Handle window change on second probe connection
+ *
+ * @v named		Named socket
+ */
+static void named_probe1_ready ( struct named_socket *named ) {
+	named_probe_ready ( named, 1 );
+}
+
+/**
+ * Handle closure of second probe connection
+ *
+ * @v named		Named socket
+ * @v rc		Reason for close
+ */
+static void named_probe1_closed ( struct named_socket *named, int rc ) {
+	named_probe_closed ( named, 1, rc );
+}
+
+/** Named socket opener first probe connection interface operations */
+static struct interface_operation named_probe0_ops[] = {
+	INTF_OP ( xfer_window_changed, struct named_socket *,
+		  named_probe0_ready ),
+	INTF_OP ( xfer_deliver, struct named_socket *, named_probe_deliver ),
+	INTF_OP ( intf_close, struct named_socket *, named_probe0_closed ),
+};
+
+/** Named socket opener first probe connection interface descriptor */
+static struct interface_descriptor named_probe0_desc =
+	INTF_DESC ( struct named_socket, probe[0], named_probe0_ops );
+
+/** Named socket opener second probe connection interface operations */
+static struct interface_operation named_probe1_ops[] = {
+	INTF_OP ( xfer_window_changed, struct named_socket *,
+		  named_probe1_ready ),
+	INTF_OP ( xfer_deliver, struct named_socket *, named_probe_deliver ),
+	INTF_OP ( intf_close, struct named_socket *, named_probe1_closed ),
+};
+
+/** Named socket opener second probe connection interface descriptor */
+static struct interface_descriptor named_probe1_desc =
+	INTF_DESC ( struct named_socket, probe[1], named_probe1_ops );
+
+/**
+ * Handle stagger timer expiry
+ *
+ * @v timer		Stagger timer
+ * @v over		Failure indicator
+ */
+static void named_expired ( struct retry_timer *timer, int over __unused ) {
+	struct named_socket *named =
+		container_of ( timer, struct named_socket, timer );
+
+	/* Start the next staggered connection attempt */
+	if ( named->started < named->count )
+		named_probe_start ( named );
+}
+
+/**
+ * Name resolved
+ *
+ * @v named		Named socket
+ * @v sa		Completed socket address
+ */
+static void named_resolv_done ( struct named_socket *named,
+				struct sockaddr *sa ) {
+	unsigned int i;
+
+	/* Ignore duplicate address families */
+	for ( i = 0 ; i < named->count ; i++ ) {
+		if ( named->peers[i].sa_family == sa->sa_family )
+			return;
+	}
+
+	/* Ignore surplus addresses */
+	if ( named->count == NAMED_MAX_ADDRESSES )
+		return;
+
+	/* Record address in order of preference */
+	memcpy ( &named->peers[named->count], sa,
+		 sizeof ( named->peers[named->count] ) );
+	named->count++;
+}
+
+/**
+ * Name resolution completed
+ *
+ * @v named		Named socket
+ * @v rc		Reason for close
+ */
+static void named_resolv_close ( struct named_socket *named, int rc ) {
+
+	/* Shut down resolver interface */
+	intf_shutdown ( &named->resolv, rc );
+
+	/* Terminate if resolution failed */
+	if ( ( rc != 0 ) || ( named->count == 0 ) ) {
+		named_close ( named, ( rc ? rc : -ECONNABORTED ) );
+		return;
+	}
+
+	/* Redirect directly when there is only one address, or when a
+	 * probe connection would prove nothing (non-stream
+	 * semantics).
+	 */
+	if ( ( named->count == 1 ) ||
+	     ( named->semantics != SOCK_STREAM ) ) {
+		named_redirect ( named, &named->peers[0] );
+		return;
+	}
+
+	/* Race probe connections to each address, most preferred
+	 * first, staggering the less-preferred attempt.
+	 */
+	DBGC ( named, "NAMED %p racing %d addresses\n",
+	       named, named->count );
+	named_probe_start ( named );
+	start_timer_fixed ( &named->timer, NAMED_CONN_DELAY );
+}
+
 /** Named socket opener resolver interface operations */
 static struct interface_operation named_resolv_op[] = {
-	INTF_OP ( intf_close, struct named_socket *, named_close ),
+	INTF_OP ( intf_close, struct named_socket *, named_resolv_close ),
 	INTF_OP ( resolv_done, struct named_socket *, named_resolv_done ),
 };
 
@@ -412,6 +893,9 @@ int xfer_open_named_socket ( struct interface *xfer, int semantics,
 	ref_init ( &named->refcnt, NULL );
 	intf_init ( &named->xfer, &named_xfer_desc, &named->refcnt );
 	intf_init ( &named->resolv, &named_resolv_desc, &named->refcnt );
+	intf_init ( &named->probe[0], &named_probe0_desc, &named->refcnt );
+	intf_init ( &named->probe[1], &named_probe1_desc, &named->refcnt );
+	timer_init ( &named->timer, named_expired, &named->refcnt );
 	named->semantics = semantics;
 	if ( local ) {
 		memcpy ( &named->local, local, sizeof ( named->local ) );
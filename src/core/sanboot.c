@@ -42,6 +42,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/dhcp.h>
 #include <ipxe/settings.h>
 #include <ipxe/quiesce.h>
+#include <ipxe/umalloc.h>
 #include <ipxe/sanboot.h>
 
 /**
@@ -85,6 +86,28 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 #define SAN_REOPEN_DELAY_SECS 5
 
+/**
+ * Size of the read-ahead cache (in bytes)
+ *
+ * SAN-booted OS loaders typically issue large numbers of small,
+ * strictly sequential, synchronous reads, each of which would
+ * otherwise incur a full network round trip.  When a sequential
+ * access pattern is detected, we read this many bytes in a single
+ * command and serve subsequent reads from the cache.
+ */
+#ifndef SAN_READAHEAD_LEN
+#define SAN_READAHEAD_LEN ( 1024 * 1024 )
+#endif
+
+/**
+ * Path latency smoothing factor (expressed as a bit shift)
+ *
+ * Per-path command latencies are maintained as an exponentially
+ * smoothed average, with each new measurement contributing
+ * 1/2^SAN_LATENCY_SMOOTHING of its weight.
+ */
+#define SAN_LATENCY_SMOOTHING 3
+
 /** List of SAN devices */
 LIST_HEAD ( san_devices );
 
@@ -124,6 +147,7 @@ static void sandev_free ( struct refcnt *refcnt ) {
 		uri_put ( sandev->path[i].uri );
 		assert ( sandev->path[i].desc == NULL );
 	}
+	ufree ( sandev->cache );
 	free ( sandev );
 }
 
@@ -221,6 +245,9 @@ static int sanpath_open ( struct san_path *sanpath ) {
 	/* Record as in progress */
 	sanpath->path_rc = -EINPROGRESS;
 
+	/* Discard any stale latency score */
+	sanpath->latency = 0;
+
 	return 0;
 }
 
@@ -433,6 +460,49 @@ union san_command_params {
 	struct san_command_rw_params rw;
 };
 
+/**
+ * Select path to be used for the next read command
+ *
+ * @v sandev		SAN device
+ *
+ * Read commands are rotated round-robin across all currently open
+ * paths, so that e.g. both fabrics of a dual-fabric deployment carry
+ * a share of the OS loader's read workload rather than leaving the
+ * standby fabric idle.  Paths whose smoothed latency is more than
+ * double that of the fastest path are skipped; paths with no latency
+ * score yet are always eligible.
+ */
+static void sandev_rotate ( struct san_device *sandev ) {
+	struct san_path *sanpath;
+	unsigned long best = 0;
+
+	/* Do nothing unless we have more than one open path */
+	assert ( sandev->active != NULL );
+	if ( list_is_singular ( &sandev->opened ) )
+		return;
+
+	/* Identify the best latency score among all open paths */
+	list_for_each_entry ( sanpath, &sandev->opened, list ) {
+		if ( sanpath->latency &&
+		     ( ( best == 0 ) || ( sanpath->latency < best ) ) )
+			best = sanpath->latency;
+	}
+
+	/* Advance (cyclically) to the next eligible open path.  The
+	 * loop must terminate, since the path holding the best score
+	 * is itself eligible.
+	 */
+	sanpath = sandev->active;
+	do {
+		sanpath = list_next_entry ( sanpath, &sandev->opened, list );
+		if ( ! sanpath ) {
+			sanpath = list_first_entry ( &sandev->opened,
+						     struct san_path, list );
+		}
+	} while ( sanpath->latency > ( 2 * best ) );
+	sandev->active = sanpath;
+}
+
 /**
  * Initiate SAN device read/write command
  *
@@ -442,10 +512,15 @@ union san_command_params {
  */
 static int sandev_command_rw ( struct san_device *sandev,
 			       const union san_command_params *params ) {
-	struct san_path *sanpath = sandev->active;
+	struct san_path *sanpath;
 	size_t len = ( params->rw.count * sandev->capacity.blksize );
 	int rc;
 
+	/* Stripe read commands across all open paths */
+	if ( params->rw.block_rw == block_read )
+		sandev_rotate ( sandev );
+	sanpath = sandev->active;
+
 	/* Sanity check */
 	assert ( sanpath != NULL );
 
@@ -488,6 +563,39 @@ sandev_command_read_capacity ( struct san_device *sandev,
 	return 0;
 }
 
+/**
+ * Update path latency score
+ *
+ * @v sandev		SAN device
+ * @v ticks		Measured command duration (in ticks)
+ *
+ * Maintain an exponentially smoothed latency score for the path that
+ * carried the command, for use when selecting a path for subsequent
+ * read commands.
+ */
+static void sandev_latency ( struct san_device *sandev, unsigned long ticks ) {
+	struct san_path *sanpath = sandev->active;
+
+	/* Path may have been closed while the command completed */
+	if ( ! sanpath )
+		return;
+
+	/* Treat sub-tick commands as taking one tick, since a zero
+	 * latency score means "not yet measured".
+	 */
+	if ( ! ticks )
+		ticks = 1;
+
+	/* Update exponentially smoothed latency */
+	if ( sanpath->latency ) {
+		sanpath->latency += ( ( ( signed long )
+					( ticks - sanpath->latency ) )
+				      >> SAN_LATENCY_SMOOTHING );
+	} else {
+		sanpath->latency = ticks;
+	}
+}
+
 /**
  * Execute a single SAN device command and wait for completion
  *
@@ -502,6 +610,7 @@ sandev_command ( struct san_device *sandev,
 				     const union san_command_params *params ),
 		 const union san_command_params *params ) {
 	unsigned int retries = 0;
+	unsigned long started;
 	int rc;
 
 	/* Sanity check */
@@ -535,6 +644,7 @@ sandev_command ( struct san_device *sandev,
 
 		/* Start expiry timer */
 		start_timer_fixed ( &sandev->timer, SAN_COMMAND_TIMEOUT );
+		started = currticks();
 
 		/* Wait for command to complete */
 		while ( timer_running ( &sandev->timer ) )
@@ -546,6 +656,9 @@ sandev_command ( struct san_device *sandev,
 			continue;
 		}
 
+		/* Update path latency score */
+		sandev_latency ( sandev, ( currticks() - started ) );
+
 		return 0;
 
 	} while ( retries <= san_retries );
@@ -635,8 +748,49 @@ static int sandev_rw ( struct san_device *sandev, uint64_t lba,
  */
 int sandev_read ( struct san_device *sandev, uint64_t lba,
 		  unsigned int count, userptr_t buffer ) {
+	size_t blksize = sandev_blksize ( sandev );
+	uint64_t capacity = sandev_capacity ( sandev );
+	unsigned int ahead;
+	int sequential;
 	int rc;
 
+	/* Serve whole request from the read-ahead cache, if possible */
+	if ( sandev->cache_count && ( lba >= sandev->cache_lba ) &&
+	     ( ( lba + count ) <=
+	       ( sandev->cache_lba + sandev->cache_count ) ) ) {
+		memcpy_user ( buffer, 0, sandev->cache,
+			      ( ( lba - sandev->cache_lba ) * blksize ),
+			      ( count * blksize ) );
+		sandev->next_lba = ( lba + count );
+		return 0;
+	}
+
+	/* Detect sequential access pattern */
+	sequential = ( lba == sandev->next_lba );
+	sandev->next_lba = ( lba + count );
+
+	/* Read ahead for small sequential reads (clamped to the
+	 * device capacity), serving the current request from the
+	 * cache.  Fall back to an uncached read if the cache cannot
+	 * be allocated or the read-ahead fails.
+	 */
+	ahead = ( SAN_READAHEAD_LEN / blksize );
+	if ( ( lba < capacity ) && ( ahead > ( capacity - lba ) ) )
+		ahead = ( capacity - lba );
+	if ( sequential && ( count < ahead ) && ( lba < capacity ) ) {
+		if ( ! sandev->cache )
+			sandev->cache = umalloc ( SAN_READAHEAD_LEN );
+		if ( sandev->cache &&
+		     ( ( rc = sandev_rw ( sandev, lba, ahead, sandev->cache,
+					  block_read ) ) == 0 ) ) {
+			sandev->cache_lba = lba;
+			sandev->cache_count = ahead;
+			memcpy_user ( buffer, 0, sandev->cache, 0,
+				      ( count * blksize ) );
+			return 0;
+		}
+	}
+
 	/* Read from device */
 	if ( ( rc = sandev_rw ( sandev, lba, count, buffer, block_read ) ) != 0 )
 		return rc;
@@ -657,6 +811,13 @@ int sandev_write ( struct san_device *sandev, uint64_t lba,
 		   unsigned int count, userptr_t buffer ) {
 	int rc;
 
+	/* Invalidate read-ahead cache if the write overlaps it */
+	if ( sandev->cache_count &&
+	     ( lba < ( sandev->cache_lba + sandev->cache_count ) ) &&
+	     ( ( lba + count ) > sandev->cache_lba ) ) {
+		sandev->cache_count = 0;
+	}
+
 	/* Write to device */
 	if ( ( rc = sandev_rw ( sandev, lba, count, buffer, block_write ) ) != 0 )
 		return rc;
@@ -43,6 +43,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/base64.h>
 #include <ipxe/pci.h>
 #include <ipxe/init.h>
+#include <ipxe/malloc.h>
 #include <ipxe/version.h>
 #include <ipxe/settings.h>
 
@@ -1461,6 +1462,60 @@ int storen_setting ( struct settings *settings, const struct setting *setting,
  ******************************************************************************
  */
 
+/** Index of predefined settings, sorted by name
+ *
+ * The table of predefined settings is immutable after linking, but is
+ * searched on every settings expansion; templated scripts perform
+ * dozens of such expansions.  The index allows a binary search in
+ * place of a linear scan.  If the index could not be built then
+ * find_setting() falls back to scanning the table directly.
+ */
+static struct setting **setting_index;
+
+/** Number of predefined settings in index */
+static unsigned int setting_index_count;
+
+/**
+ * Build index of predefined settings
+ *
+ */
+static void setting_index_init ( void ) {
+	struct setting *setting;
+	struct setting *tmp;
+	unsigned int count = table_num_entries ( SETTINGS );
+	unsigned int i;
+	unsigned int j;
+
+	/* Allocate index */
+	setting_index = malloc ( count * sizeof ( setting_index[0] ) );
+	if ( ! setting_index )
+		return;
+
+	/* Populate index */
+	i = 0;
+	for_each_table_entry ( setting, SETTINGS )
+		setting_index[i++] = setting;
+
+	/* Sort index by name (insertion sort; the table is small and
+	 * this happens exactly once).  The sort is stable, so entries
+	 * sharing a name keep their table order.
+	 */
+	for ( i = 1 ; i < count ; i++ ) {
+		tmp = setting_index[i];
+		for ( j = i ; ( j > 0 && ( strcmp ( tmp->name,
+				setting_index[ j - 1 ]->name ) < 0 ) ) ; j-- ) {
+			setting_index[j] = setting_index[ j - 1 ];
+		}
+		setting_index[j] = tmp;
+	}
+	setting_index_count = count;
+}
+
+/** Settings index initialisation function */
+struct init_fn setting_index_init_fn __init_fn ( INIT_NORMAL ) = {
+	.initialise = setting_index_init,
+};
+
 /**
  * Find predefined setting
  *
@@ -1469,7 +1524,41 @@ int storen_setting ( struct settings *settings, const struct setting *setting,
  */
 struct setting * find_setting ( const char *name ) {
 	struct setting *setting;
+	unsigned int low;
+	unsigned int high;
+	unsigned int mid;
+	int cmp;
+
+	/* Search index, if built */
+	if ( setting_index_count ) {
+		low = 0;
+		high = setting_index_count;
+		while ( low < high ) {
+			mid = ( ( low + high ) / 2 );
+			cmp = strcmp ( name, setting_index[mid]->name );
+			if ( cmp == 0 ) {
+				/* Several settings may share a name;
+				 * return the first in table order, as
+				 * the linear scan would.
+				 */
+				while ( ( mid > 0 ) &&
+					( strcmp ( name,
+					    setting_index[ mid - 1 ]->name )
+					  == 0 ) ) {
+					mid--;
+				}
+				return setting_index[mid];
+			}
+			if ( cmp < 0 ) {
+				high = mid;
+			} else {
+				low = ( mid + 1 );
+			}
+		}
+		return NULL;
+	}
 
+	/* Fall back to linear scan */
 	for_each_table_entry ( setting, SETTINGS ) {
 		if ( strcmp ( name, setting->name ) == 0 )
 			return setting;
@@ -2276,6 +2365,34 @@ const struct setting_type setting_type_busdevfn __setting_type = {
  ******************************************************************************
  */
 
+/**
+ * Append fragment to expanded string
+ *
+ * @v expstr		Expanded string
+ * @v len		Current length of expanded string
+ * @v fragment		Fragment to append
+ * @v frag_len		Length of fragment
+ * @ret expstr		Updated expanded string, or NULL on failure
+ */
+static char * expand_settings_append ( char *expstr, size_t *len,
+				       const char *fragment, size_t frag_len ){
+	char *tmp;
+
+	/* Extend string */
+	tmp = realloc ( expstr, ( *len + frag_len + 1 /* NUL */ ) );
+	if ( ! tmp ) {
+		free ( expstr );
+		return NULL;
+	}
+
+	/* Append fragment */
+	memcpy ( ( tmp + *len ), fragment, frag_len );
+	*len += frag_len;
+	tmp[ *len ] = '\0';
+
+	return tmp;
+}
+
 /**
  * Expand variables within string
  *
@@ -2288,44 +2405,64 @@ const struct setting_type setting_type_busdevfn __setting_type = {
 char * expand_settings ( const char *string ) {
 	struct settings *settings;
 	struct setting setting;
-	char *expstr;
-	char *start;
-	char *end;
-	char *head;
+	const char *scan;
+	const char *start;
+	const char *end;
+	const char *tail;
 	char *name;
-	char *tail;
 	char *value;
-	char *tmp;
-	int new_len;
+	char *expvalue;
+	char *expstr;
+	size_t len;
 	int rc;
 
-	/* Obtain temporary modifiable copy of string */
-	expstr = strdup ( string );
+	/* Start with an empty expanded string */
+	expstr = strdup ( "" );
 	if ( ! expstr )
 		return NULL;
+	len = 0;
 
-	/* Expand while expansions remain */
+	/* Construct expanded string in a single pass, copying each
+	 * literal fragment and each expanded setting value exactly
+	 * once.
+	 */
+	tail = string;
 	while ( 1 ) {
 
-		head = expstr;
-
-		/* Locate setting to be expanded */
+		/* Locate next setting to be expanded */
 		start = NULL;
 		end = NULL;
-		for ( tmp = expstr ; *tmp ; tmp++ ) {
-			if ( ( tmp[0] == '$' ) && ( tmp[1] == '{' ) )
-				start = tmp;
-			if ( start && ( tmp[0] == '}' ) ) {
-				end = tmp;
+		for ( scan = tail ; *scan ; scan++ ) {
+			if ( ( scan[0] == '$' ) && ( scan[1] == '{' ) )
+				start = scan;
+			if ( start && ( scan[0] == '}' ) ) {
+				end = scan;
 				break;
 			}
 		}
-		if ( ! end )
-			break;
-		*start = '\0';
-		name = ( start + 2 );
-		*end = '\0';
-		tail = ( end + 1 );
+
+		/* If no expansions remain, append remaining literal
+		 * text and terminate.
+		 */
+		if ( ! end ) {
+			expstr = expand_settings_append ( expstr, &len, tail,
+							  strlen ( tail ) );
+			return expstr;
+		}
+
+		/* Append literal text preceding this expansion */
+		expstr = expand_settings_append ( expstr, &len, tail,
+						  ( start - tail ) );
+		if ( ! expstr )
+			return NULL;
+
+		/* Extract setting name */
+		name = strndup ( ( start + 2 /* "${" */ ),
+				 ( end - ( start + 2 ) ) );
+		if ( ! name ) {
+			free ( expstr );
+			return NULL;
+		}
 
 		/* Expand setting */
 		if ( ( rc = parse_setting_name ( name, find_child_settings,
@@ -2340,18 +2477,29 @@ char * expand_settings ( const char *string ) {
 			fetchf_setting_copy ( settings, &setting, NULL, NULL,
 					      &value );
 		}
+		free ( name );
+
+		/* Expand any references within the fetched value
+		 * itself, then append it.
+		 */
+		if ( value ) {
+			expvalue = expand_settings ( value );
+			free ( value );
+			if ( ! expvalue ) {
+				free ( expstr );
+				return NULL;
+			}
+			expstr = expand_settings_append ( expstr, &len,
+							  expvalue,
+							  strlen ( expvalue ));
+			free ( expvalue );
+			if ( ! expstr )
+				return NULL;
+		}
 
-		/* Construct expanded string and discard old string */
-		tmp = expstr;
-		new_len = asprintf ( &expstr, "%s%s%s",
-				     head, ( value ? value : "" ), tail );
-		free ( value );
-		free ( tmp );
-		if ( new_len < 0 )
-			return NULL;
+		/* Continue after this expansion */
+		tail = ( end + 1 );
 	}
-
-	return expstr;
 }
 
 /******************************************************************************
@@ -2608,6 +2756,72 @@ struct builtin_setting unixtime_builtin_setting __builtin_setting = {
 	.fetch = unixtime_fetch,
 };
 
+/**
+ * Fetch free heap memory setting
+ *
+ * @v data		Buffer to fill with setting data
+ * @v len		Length of buffer
+ * @ret len		Length of setting data, or negative error
+ */
+static int memfree_fetch ( void *data, size_t len ) {
+	uint32_t content;
+
+	/* Return total free heap memory */
+	content = htonl ( freemem );
+	if ( len > sizeof ( content ) )
+		len = sizeof ( content );
+	memcpy ( data, &content, len );
+	return sizeof ( content );
+}
+
+/** Free heap memory setting */
+const struct setting memfree_setting __setting ( SETTING_MISC, memfree ) = {
+	.name = "memfree",
+	.description = "Free heap memory",
+	.type = &setting_type_uint32,
+	.scope = &builtin_scope,
+};
+
+/** Free heap memory built-in setting */
+struct builtin_setting memfree_builtin_setting __builtin_setting = {
+	.setting = &memfree_setting,
+	.fetch = memfree_fetch,
+};
+
+/**
+ * Fetch largest free heap block setting
+ *
+ * @v data		Buffer to fill with setting data
+ * @v len		Length of buffer
+ * @ret len		Length of setting data, or negative error
+ */
+static int memblock_fetch ( void *data, size_t len ) {
+	struct memory_stats stats;
+	uint32_t content;
+
+	/* Return largest contiguous free heap block */
+	mstats ( &stats );
+	content = htonl ( stats.largest_free );
+	if ( len > sizeof ( content ) )
+		len = sizeof ( content );
+	memcpy ( data, &content, len );
+	return sizeof ( content );
+}
+
+/** Largest free heap block setting */
+const struct setting memblock_setting __setting ( SETTING_MISC, memblock ) = {
+	.name = "memblock",
+	.description = "Largest free heap block",
+	.type = &setting_type_uint32,
+	.scope = &builtin_scope,
+};
+
+/** Largest free heap block built-in setting */
+struct builtin_setting memblock_builtin_setting __builtin_setting = {
+	.setting = &memblock_setting,
+	.fetch = memblock_fetch,
+};
+
 /**
  * Fetch built-in setting
  *
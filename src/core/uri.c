@@ -188,6 +188,34 @@ static int uri_character_escaped ( char c, unsigned int field ) {
 		 strchr ( escaped[field], c ) );
 }
 
+/** Per-field bitmaps of characters requiring escaping */
+static uint8_t uri_escaped_map[URI_FIELDS][ 256 / 8 ];
+
+/** Escape bitmaps have been initialised */
+static int uri_escaped_map_initialised;
+
+/**
+ * Initialise escape bitmaps
+ *
+ * Precomputes uri_character_escaped() for every (character, field)
+ * combination, allowing the encoder to classify each byte with a
+ * single table lookup.
+ */
+static void uri_escaped_map_init ( void ) {
+	unsigned int field;
+	unsigned int c;
+
+	for ( field = 0 ; field < URI_FIELDS ; field++ ) {
+		for ( c = 0 ; c < 256 ; c++ ) {
+			if ( uri_character_escaped ( ( ( char ) c ), field ) ) {
+				uri_escaped_map[field][ c / 8 ] |=
+					( 1 << ( c % 8 ) );
+			}
+		}
+	}
+	uri_escaped_map_initialised = 1;
+}
+
 /**
  * Encode URI field
  *
@@ -200,28 +228,46 @@ static int uri_character_escaped ( char c, unsigned int field ) {
  */
 size_t uri_encode ( unsigned int field, const void *raw, size_t raw_len,
 		    char *buf, ssize_t len ) {
+	static const char hex[16] = "0123456789ABCDEF";
 	const uint8_t *raw_bytes = ( ( const uint8_t * ) raw );
-	ssize_t remaining = len;
-	size_t used;
-	char c;
+	size_t used = 0;
+	unsigned int c;
+	char enc[3];
+	size_t enc_len;
+	size_t i;
 
-	/* Ensure encoded string is NUL-terminated even if empty */
-	if ( len > 0 )
-		buf[0] = '\0';
+	/* Initialise escape bitmaps, if not already done */
+	if ( ! uri_escaped_map_initialised )
+		uri_escaped_map_init();
 
-	/* Copy string, escaping as necessary */
+	/* Copy string in a single pass, escaping as necessary */
 	while ( raw_len-- ) {
 		c = *(raw_bytes++);
-		if ( uri_character_escaped ( c, field ) ) {
-			used = ssnprintf ( buf, remaining, "%%%02X", c );
+		if ( uri_escaped_map[field][ c / 8 ] & ( 1 << ( c % 8 ) ) ) {
+			enc[0] = '%';
+			enc[1] = hex[ c >> 4 ];
+			enc[2] = hex[ c & 0xf ];
+			enc_len = 3;
 		} else {
-			used = ssnprintf ( buf, remaining, "%c", c );
+			enc[0] = c;
+			enc_len = 1;
+		}
+		for ( i = 0 ; i < enc_len ; i++, used++ ) {
+			if ( ( ( ssize_t ) used ) < ( len - 1 ) )
+				buf[used] = enc[i];
 		}
-		buf += used;
-		remaining -= used;
 	}
 
-	return ( len - remaining );
+	/* Ensure encoded string is NUL-terminated, even if truncated */
+	if ( len > 0 ) {
+		if ( ( ( ssize_t ) used ) < len ) {
+			buf[used] = '\0';
+		} else {
+			buf[ len - 1 ] = '\0';
+		}
+	}
+
+	return used;
 }
 
 /**
@@ -26,6 +26,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stddef.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <wchar.h>
 #include <ipxe/vsprintf.h>
@@ -132,20 +133,43 @@ static char * format_hex ( char *end, unsigned long long num, int width,
  */
 static char * format_decimal ( char *end, signed long num, int width,
 			       int flags ) {
+	static const char digits[ 100 * 2 + 1 /* NUL */ ] =
+		"00010203040506070809"
+		"10111213141516171819"
+		"20212223242526272829"
+		"30313233343536373839"
+		"40414243444546474849"
+		"50515253545556575859"
+		"60616263646566676869"
+		"70717273747576777879"
+		"80818283848586878889"
+		"90919293949596979899";
 	char *ptr = end;
 	int negative = 0;
 	int zpad = ( flags & ZPAD );
 	int pad = ( zpad | ' ' );
+	unsigned long unum;
+	const char *pair;
 
-	/* Generate the number */
+	/* Generate the number, two digits at a time */
 	if ( num < 0 ) {
 		negative = 1;
 		num = -num;
 	}
-	do {
-		*(--ptr) = '0' + ( num % 10 );
-		num /= 10;
-	} while ( num );
+	unum = num;
+	while ( unum >= 100 ) {
+		pair = &digits[ ( unum % 100 ) * 2 ];
+		unum /= 100;
+		*(--ptr) = pair[1];
+		*(--ptr) = pair[0];
+	}
+	if ( unum >= 10 ) {
+		pair = &digits[ unum * 2 ];
+		*(--ptr) = pair[1];
+		*(--ptr) = pair[0];
+	} else {
+		*(--ptr) = ( '0' + unum );
+	}
 
 	/* Add "-" if necessary */
 	if ( negative && ( ! zpad ) )
@@ -176,6 +200,28 @@ static inline void cputchar ( struct printf_context *ctx, unsigned char c ) {
 	++ctx->len;
 }
 
+/**
+ * Print run of characters via a printf context
+ *
+ * @v ctx		Context
+ * @v data		Characters
+ * @v len		Number of characters
+ *
+ * Uses the printf_context::bulk() method if one is provided, falling
+ * back to character-at-a-time emission otherwise.
+ */
+static void cputs ( struct printf_context *ctx, const char *data,
+		    size_t len ) {
+
+	if ( ctx->bulk ) {
+		ctx->bulk ( ctx, data, len );
+		ctx->len += len;
+	} else {
+		while ( len-- )
+			cputchar ( ctx, *(data++) );
+	}
+}
+
 /**
  * Write a formatted string to a printf context
  *
@@ -192,14 +238,18 @@ size_t vcprintf ( struct printf_context *ctx, const char *fmt, va_list args ) {
 	char tmp_buf[32]; /* 32 is enough for all numerical formats.
 			   * Insane width fields could overflow this buffer. */
 	wchar_t *wptr;
+	const char *literal;
 
 	/* Initialise context */
 	ctx->len = 0;
 
 	for ( ; *fmt ; fmt++ ) {
-		/* Pass through ordinary characters */
+		/* Pass through runs of ordinary characters */
 		if ( *fmt != '%' ) {
-			cputchar ( ctx, *fmt );
+			literal = fmt;
+			while ( fmt[1] && ( fmt[1] != '%' ) )
+				fmt++;
+			cputs ( ctx, literal, ( fmt + 1 - literal ) );
 			continue;
 		}
 		fmt++;
@@ -296,9 +346,7 @@ size_t vcprintf ( struct printf_context *ctx, const char *fmt, va_list args ) {
 		}
 		/* Write out conversion result */
 		if ( wptr == NULL ) {
-			for ( ; *ptr ; ptr++ ) {
-				cputchar ( ctx, *ptr );
-			}
+			cputs ( ctx, ptr, strlen ( ptr ) );
 		} else {
 			for ( ; *wptr ; wptr++ ) {
 				size_t len = wcrtomb ( tmp_buf, *wptr, NULL );
@@ -335,6 +383,27 @@ static void printf_sputc ( struct printf_context *ctx, unsigned int c ) {
 		sctx->buf[ctx->len] = c;
 }
 
+/**
+ * Write run of characters to buffer
+ *
+ * @v ctx		Context
+ * @v data		Characters
+ * @v len		Number of characters
+ */
+static void printf_sputs ( struct printf_context *ctx, const char *data,
+			   size_t len ) {
+	struct sputc_context * sctx =
+		container_of ( ctx, struct sputc_context, ctx );
+	size_t available;
+
+	if ( ctx->len < sctx->max_len ) {
+		available = ( sctx->max_len - ctx->len );
+		if ( len > available )
+			len = available;
+		memcpy ( ( sctx->buf + ctx->len ), data, len );
+	}
+}
+
 /**
  * Write a formatted string to a buffer
  *
@@ -355,6 +424,7 @@ int vsnprintf ( char *buf, size_t size, const char *fmt, va_list args ) {
 
 	/* Hand off to vcprintf */
 	sctx.ctx.handler = printf_sputc;
+	sctx.ctx.bulk = printf_sputs;
 	sctx.buf = buf;
 	sctx.max_len = size;
 	len = vcprintf ( &sctx.ctx, fmt, args );
@@ -450,8 +520,9 @@ int vprintf ( const char *fmt, va_list args ) {
 	struct printf_context ctx;
 
 	/* Hand off to vcprintf */
-	ctx.handler = printf_putchar;	
-	return vcprintf ( &ctx, fmt, args );	
+	ctx.handler = printf_putchar;
+	ctx.bulk = NULL;
+	return vcprintf ( &ctx, fmt, args );
 }
 
 /**
@@ -365,6 +365,41 @@ int xfer_seek ( struct interface *intf, off_t offset ) {
 	return xfer_deliver ( intf, iobuf, &meta );
 }
 
+/**
+ * Describe overall transfer
+ *
+ * @v intf		Data transfer interface
+ * @v flags		Additional flags (e.g. @c XFER_FL_RANGES)
+ * @v total		Total length of entity being transferred
+ * @ret rc		Return status code
+ *
+ * This conveys metadata about the entity being transferred (such as
+ * its total length) to the recipient, without delivering any data.
+ * Recipients which understand the metadata (including the generic
+ * data transfer buffer) will consume it without moving their data
+ * position.  Recipients which do not will observe a zero-length seek
+ * to the total length; callers should therefore seek back to the
+ * intended position afterwards, as with any other use of xfer_seek().
+ */
+int xfer_describe ( struct interface *intf, unsigned int flags, off_t total ) {
+	struct io_buffer *iobuf;
+	struct xfer_metadata meta = {
+		.flags = ( XFER_FL_TOTAL | XFER_FL_ABS_OFFSET | flags ),
+		.offset = total,
+	};
+
+	DBGC ( INTF_COL ( intf ), "INTF " INTF_FMT " describe total %ld%s\n",
+	       INTF_DBG ( intf ), total,
+	       ( ( flags & XFER_FL_RANGES ) ? " (ranged)" : "" ) );
+
+	/* Allocate and send a zero-length data buffer */
+	iobuf = xfer_alloc_iob ( intf, 0 );
+	if ( ! iobuf )
+		return -ENOMEM;
+
+	return xfer_deliver ( intf, iobuf, &meta );
+}
+
 /**
  * Check that data is delivered strictly in order
  *
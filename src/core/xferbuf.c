@@ -59,6 +59,7 @@ void xferbuf_free ( struct xfer_buffer *xferbuf ) {
 
 	xferbuf->op->realloc ( xferbuf, 0 );
 	xferbuf->len = 0;
+	xferbuf->allocated = 0;
 	xferbuf->pos = 0;
 }
 
@@ -70,17 +71,39 @@ void xferbuf_free ( struct xfer_buffer *xferbuf ) {
  * @ret rc		Return status code
  */
 static int xferbuf_ensure_size ( struct xfer_buffer *xferbuf, size_t len ) {
+	size_t new_allocated;
 	int rc;
 
-	/* If buffer is already large enough, do nothing */
+	/* If data length is already large enough, do nothing */
 	if ( len <= xferbuf->len )
 		return 0;
 
-	/* Extend buffer */
-	if ( ( rc = xferbuf->op->realloc ( xferbuf, len ) ) != 0 ) {
-		DBGC ( xferbuf, "XFERBUF %p could not extend buffer to "
-		       "%zd bytes: %s\n", xferbuf, len, strerror ( rc ) );
-		return rc;
+	/* Extend allocation if needed.  Grow the allocation
+	 * geometrically rather than to the exact required size:
+	 * reallocation may recopy the entire buffer contents, and
+	 * extending by exactly one packet's worth of data for every
+	 * delivered packet would recopy every downloaded byte many
+	 * times over.  Fall back to an exact-size allocation if the
+	 * larger allocation fails (e.g. for fixed-size buffers, or
+	 * when memory is low).
+	 */
+	if ( len > xferbuf->allocated ) {
+		new_allocated = ( xferbuf->allocated +
+				  ( xferbuf->allocated >> 2 ) );
+		if ( new_allocated < len )
+			new_allocated = len;
+		if ( ( rc = xferbuf->op->realloc ( xferbuf,
+						   new_allocated ) ) != 0 ) {
+			new_allocated = len;
+			if ( ( rc = xferbuf->op->realloc ( xferbuf,
+							   new_allocated ))!=0){
+				DBGC ( xferbuf, "XFERBUF %p could not extend "
+				       "buffer to %zd bytes: %s\n", xferbuf,
+				       len, strerror ( rc ) );
+				return rc;
+			}
+		}
+		xferbuf->allocated = new_allocated;
 	}
 	xferbuf->len = len;
 
@@ -155,6 +178,17 @@ int xferbuf_deliver ( struct xfer_buffer *xferbuf, struct io_buffer *iobuf,
 	size_t pos;
 	int rc;
 
+	/* Ignore overall transfer descriptions, which convey no data
+	 * and do not affect the current buffer position.  (The total
+	 * length may exceed the length of this buffer, e.g. when a
+	 * fixed-size block device buffer receives a partial range of
+	 * a larger entity.)
+	 */
+	if ( meta->flags & XFER_FL_TOTAL ) {
+		free_iob ( iobuf );
+		return 0;
+	}
+
 	/* Start profiling */
 	profile_start ( &xferbuf_deliver_profiler );
 
@@ -284,6 +318,121 @@ struct xfer_buffer_operations xferbuf_umalloc_operations = {
 	.read = xferbuf_umalloc_read,
 };
 
+/**
+ * Reallocate extent-based data buffer
+ *
+ * @v xferbuf		Data transfer buffer
+ * @v len		New length (or zero to free buffer)
+ * @ret rc		Return status code
+ *
+ * Only the table of extent pointers is ever reallocated; existing
+ * extents (and hence existing data) are never copied on growth.
+ */
+static int xferbuf_extent_realloc ( struct xfer_buffer *xferbuf, size_t len ) {
+	struct xfer_buffer_extents *extents = xferbuf->data;
+	userptr_t *new_extent;
+	unsigned int count;
+	unsigned int i;
+
+	/* Calculate required number of extents */
+	count = ( ( len + XFERBUF_EXTENT_LEN - 1 ) / XFERBUF_EXTENT_LEN );
+
+	/* Free any surplus extents */
+	for ( i = count ; i < extents->count ; i++ )
+		ufree ( extents->extent[i] );
+	if ( extents->count > count )
+		extents->count = count;
+
+	/* Free extent table, if applicable */
+	if ( ! count ) {
+		free ( extents->extent );
+		extents->extent = NULL;
+		return 0;
+	}
+
+	/* Extend extent table */
+	new_extent = realloc ( extents->extent,
+			       ( count * sizeof ( extents->extent[0] ) ) );
+	if ( ! new_extent )
+		return -ENOSPC;
+	extents->extent = new_extent;
+
+	/* Allocate any additional extents */
+	for ( i = extents->count ; i < count ; i++ ) {
+		extents->extent[i] = umalloc ( XFERBUF_EXTENT_LEN );
+		if ( ! extents->extent[i] )
+			return -ENOSPC;
+		extents->count++;
+	}
+
+	return 0;
+}
+
+/**
+ * Write data to extent-based data buffer
+ *
+ * @v xferbuf		Data transfer buffer
+ * @v offset		Starting offset
+ * @v data		Data to copy
+ * @v len		Length of data
+ */
+static void xferbuf_extent_write ( struct xfer_buffer *xferbuf, size_t offset,
+				   const void *data, size_t len ) {
+	struct xfer_buffer_extents *extents = xferbuf->data;
+	userptr_t extent;
+	size_t skip;
+	size_t frag_len;
+
+	/* Scatter data across extents */
+	while ( len ) {
+		extent = extents->extent[ offset / XFERBUF_EXTENT_LEN ];
+		skip = ( offset % XFERBUF_EXTENT_LEN );
+		frag_len = ( XFERBUF_EXTENT_LEN - skip );
+		if ( frag_len > len )
+			frag_len = len;
+		copy_to_user ( extent, skip, data, frag_len );
+		data += frag_len;
+		offset += frag_len;
+		len -= frag_len;
+	}
+}
+
+/**
+ * Read data from extent-based data buffer
+ *
+ * @v xferbuf		Data transfer buffer
+ * @v offset		Starting offset
+ * @v data		Data to read
+ * @v len		Length of data
+ */
+static void xferbuf_extent_read ( struct xfer_buffer *xferbuf, size_t offset,
+				  void *data, size_t len ) {
+	struct xfer_buffer_extents *extents = xferbuf->data;
+	userptr_t extent;
+	size_t skip;
+	size_t frag_len;
+
+	/* Gather data from extents */
+	while ( len ) {
+		extent = extents->extent[ offset / XFERBUF_EXTENT_LEN ];
+		skip = ( offset % XFERBUF_EXTENT_LEN );
+		frag_len = ( XFERBUF_EXTENT_LEN - skip );
+		if ( frag_len > len )
+			frag_len = len;
+		copy_from_user ( data, extent, skip, frag_len );
+		data += frag_len;
+		offset += frag_len;
+		len -= frag_len;
+	}
+}
+
+/** Extent-based data buffer operations */
+struct xfer_buffer_operations xferbuf_extent_operations = {
+	.realloc = xferbuf_extent_realloc,
+	.write = xferbuf_extent_write,
+	.read = xferbuf_extent_read,
+};
+
 /**
  * Get underlying data transfer buffer
  *
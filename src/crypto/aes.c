@@ -35,10 +35,12 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <assert.h>
 #include <byteswap.h>
 #include <ipxe/rotate.h>
+#include <ipxe/init.h>
 #include <ipxe/crypto.h>
 #include <ipxe/ecb.h>
 #include <ipxe/cbc.h>
 #include <ipxe/aes.h>
+#include <bits/aes.h>
 
 /** AES strides
  *
@@ -334,6 +336,78 @@ aes_decrypt_rounds ( union aes_matrix *in, union aes_matrix *out,
 	} while ( --rounds );
 }
 
+/**
+ * Perform encryption intermediate rounds on a pair of blocks
+ *
+ * @v in		AES input states (two blocks)
+ * @v out		AES output states (two blocks)
+ * @v key		Round keys
+ * @v rounds		Number of rounds (must be odd)
+ *
+ * The two blocks are processed in interleaved rounds.  The blocks are
+ * independent, so the two interleaved instruction streams have no
+ * data dependencies on each other and can be scheduled to execute in
+ * parallel on a superscalar CPU, hiding much of the lookup table load
+ * latency.
+ *
+ * As with aes_encrypt_rounds(), this function is deliberately marked
+ * as non-inlinable.
+ */
+static __attribute__ (( noinline )) void
+aes_encrypt_pair_rounds ( union aes_matrix *in, union aes_matrix *out,
+			  const union aes_matrix *key, unsigned int rounds ) {
+	union aes_matrix *tmp;
+
+	/* Perform intermediate rounds */
+	do {
+		/* Perform one interleaved intermediate round */
+		aes_round ( &aes_mixcolumns, AES_STRIDE_SHIFTROWS,
+			    &in[0], &out[0], key );
+		aes_round ( &aes_mixcolumns, AES_STRIDE_SHIFTROWS,
+			    &in[1], &out[1], key++ );
+
+		/* Swap input and output states for next round */
+		tmp = in;
+		in = out;
+		out = tmp;
+
+	} while ( --rounds );
+}
+
+/**
+ * Perform decryption intermediate rounds on a pair of blocks
+ *
+ * @v in		AES input states (two blocks)
+ * @v out		AES output states (two blocks)
+ * @v key		Round keys
+ * @v rounds		Number of rounds (must be odd)
+ *
+ * As with aes_encrypt_pair_rounds(), the two independent blocks are
+ * processed in interleaved rounds to exploit instruction-level
+ * parallelism, and the function is deliberately marked as
+ * non-inlinable.
+ */
+static __attribute__ (( noinline )) void
+aes_decrypt_pair_rounds ( union aes_matrix *in, union aes_matrix *out,
+			  const union aes_matrix *key, unsigned int rounds ) {
+	union aes_matrix *tmp;
+
+	/* Perform intermediate rounds */
+	do {
+		/* Perform one interleaved intermediate round */
+		aes_round ( &aes_invmixcolumns, AES_STRIDE_INVSHIFTROWS,
+			    &in[0], &out[0], key );
+		aes_round ( &aes_invmixcolumns, AES_STRIDE_INVSHIFTROWS,
+			    &in[1], &out[1], key++ );
+
+		/* Swap input and output states for next round */
+		tmp = in;
+		in = out;
+		out = tmp;
+
+	} while ( --rounds );
+}
+
 /**
  * Perform standalone AddRoundKey
  *
@@ -387,23 +461,19 @@ static void aes_final ( const struct aes_table *table, size_t stride,
 }
 
 /**
- * Encrypt data
+ * Encrypt single block
  *
- * @v ctx		Context
- * @v src		Data to encrypt
- * @v dst		Buffer for encrypted data
- * @v len		Length of data
+ * @v aes		AES context
+ * @v src		Block to encrypt
+ * @v dst		Buffer for encrypted block
  */
-static void aes_encrypt ( void *ctx, const void *src, void *dst, size_t len ) {
-	struct aes_context *aes = ctx;
+static void aes_encrypt_block ( struct aes_context *aes, const void *src,
+				void *dst ) {
 	union aes_matrix buffer[2];
 	union aes_matrix *in = &buffer[0];
 	union aes_matrix *out = &buffer[1];
 	unsigned int rounds = aes->rounds;
 
-	/* Sanity check */
-	assert ( len == sizeof ( *in ) );
-
 	/* Initialise input state */
 	memcpy ( in, src, sizeof ( *in ) );
 
@@ -423,22 +493,80 @@ static void aes_encrypt ( void *ctx, const void *src, void *dst, size_t len ) {
 }
 
 /**
- * Decrypt data
+ * Encrypt data
  *
  * @v ctx		Context
- * @v src		Data to decrypt
- * @v dst		Buffer for decrypted data
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
  * @v len		Length of data
  */
-static void aes_decrypt ( void *ctx, const void *src, void *dst, size_t len ) {
+static void aes_encrypt ( void *ctx, const void *src, void *dst, size_t len ) {
 	struct aes_context *aes = ctx;
-	union aes_matrix buffer[2];
+	union aes_matrix buffer[4];
 	union aes_matrix *in = &buffer[0];
-	union aes_matrix *out = &buffer[1];
+	union aes_matrix *out = &buffer[2];
 	unsigned int rounds = aes->rounds;
 
 	/* Sanity check */
-	assert ( len == sizeof ( *in ) );
+	assert ( ( len % sizeof ( *in ) ) == 0 );
+
+	/* Use accelerated implementation, if supported */
+	if ( aes->accel ) {
+		while ( len ) {
+			aes_accel_encrypt ( aes, src, dst );
+			src += sizeof ( *in );
+			dst += sizeof ( *in );
+			len -= sizeof ( *in );
+		}
+		return;
+	}
+
+	/* Encrypt pairs of blocks using interleaved rounds */
+	while ( len >= ( 2 * sizeof ( *in ) ) ) {
+
+		/* Initialise input states */
+		memcpy ( in, src, ( 2 * sizeof ( *in ) ) );
+
+		/* Perform initial round (AddRoundKey) */
+		aes_addroundkey ( &in[0], &aes->encrypt.key[0] );
+		aes_addroundkey ( &in[1], &aes->encrypt.key[0] );
+
+		/* Perform intermediate rounds (ShiftRows, SubBytes,
+		 * MixColumns, AddRoundKey).
+		 */
+		aes_encrypt_pair_rounds ( in, out, &aes->encrypt.key[1],
+					  ( rounds - 2 ) );
+
+		/* Perform final round (ShiftRows, SubBytes, AddRoundKey) */
+		aes_final ( &aes_mixcolumns, AES_STRIDE_SHIFTROWS, &out[0],
+			    dst, &aes->encrypt.key[ rounds - 1 ] );
+		aes_final ( &aes_mixcolumns, AES_STRIDE_SHIFTROWS, &out[1],
+			    ( dst + sizeof ( *in ) ),
+			    &aes->encrypt.key[ rounds - 1 ] );
+
+		src += ( 2 * sizeof ( *in ) );
+		dst += ( 2 * sizeof ( *in ) );
+		len -= ( 2 * sizeof ( *in ) );
+	}
+
+	/* Encrypt remaining block, if any */
+	if ( len )
+		aes_encrypt_block ( aes, src, dst );
+}
+
+/**
+ * Decrypt single block
+ *
+ * @v aes		AES context
+ * @v src		Block to decrypt
+ * @v dst		Buffer for decrypted block
+ */
+static void aes_decrypt_block ( struct aes_context *aes, const void *src,
+				void *dst ) {
+	union aes_matrix buffer[2];
+	union aes_matrix *in = &buffer[0];
+	union aes_matrix *out = &buffer[1];
+	unsigned int rounds = aes->rounds;
 
 	/* Initialise input state */
 	memcpy ( in, src, sizeof ( *in ) );
@@ -458,6 +586,70 @@ static void aes_decrypt ( void *ctx, const void *src, void *dst, size_t len ) {
 		    &aes->decrypt.key[ rounds - 1 ] );
 }
 
+/**
+ * Decrypt data
+ *
+ * @v ctx		Context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ * @v len		Length of data
+ */
+static void aes_decrypt ( void *ctx, const void *src, void *dst, size_t len ) {
+	struct aes_context *aes = ctx;
+	union aes_matrix buffer[4];
+	union aes_matrix *in = &buffer[0];
+	union aes_matrix *out = &buffer[2];
+	unsigned int rounds = aes->rounds;
+
+	/* Sanity check */
+	assert ( ( len % sizeof ( *in ) ) == 0 );
+
+	/* Use accelerated implementation, if supported */
+	if ( aes->accel ) {
+		while ( len ) {
+			aes_accel_decrypt ( aes, src, dst );
+			src += sizeof ( *in );
+			dst += sizeof ( *in );
+			len -= sizeof ( *in );
+		}
+		return;
+	}
+
+	/* Decrypt pairs of blocks using interleaved rounds */
+	while ( len >= ( 2 * sizeof ( *in ) ) ) {
+
+		/* Initialise input states */
+		memcpy ( in, src, ( 2 * sizeof ( *in ) ) );
+
+		/* Perform initial round (AddRoundKey) */
+		aes_addroundkey ( &in[0], &aes->decrypt.key[0] );
+		aes_addroundkey ( &in[1], &aes->decrypt.key[0] );
+
+		/* Perform intermediate rounds (InvShiftRows,
+		 * InvSubBytes, InvMixColumns, AddRoundKey).
+		 */
+		aes_decrypt_pair_rounds ( in, out, &aes->decrypt.key[1],
+					  ( rounds - 2 ) );
+
+		/* Perform final round (InvShiftRows, InvSubBytes,
+		 * AddRoundKey).
+		 */
+		aes_final ( &aes_invmixcolumns, AES_STRIDE_INVSHIFTROWS,
+			    &out[0], dst, &aes->decrypt.key[ rounds - 1 ] );
+		aes_final ( &aes_invmixcolumns, AES_STRIDE_INVSHIFTROWS,
+			    &out[1], ( dst + sizeof ( *in ) ),
+			    &aes->decrypt.key[ rounds - 1 ] );
+
+		src += ( 2 * sizeof ( *in ) );
+		dst += ( 2 * sizeof ( *in ) );
+		len -= ( 2 * sizeof ( *in ) );
+	}
+
+	/* Decrypt remaining block, if any */
+	if ( len )
+		aes_decrypt_block ( aes, src, dst );
+}
+
 /**
  * Multiply a polynomial by (x) modulo (x^8 + x^4 + x^3 + x^2 + 1) in GF(2^8)
  *
@@ -623,6 +815,11 @@ static void aes_generate ( void ) {
 	}
 }
 
+/** AES lookup table initialiser */
+struct init_fn aes_init_fn __init_fn ( INIT_NORMAL ) = {
+	.initialise = aes_generate,
+};
+
 /**
  * Rotate key column
  *
@@ -691,10 +888,6 @@ static int aes_setkey ( void *ctx, const void *key, size_t keylen ) {
 	uint32_t *end;
 	uint32_t tmp;
 
-	/* Generate lookup tables, if not already done */
-	if ( ! aes_mixcolumns.entry[0].byte[0] )
-		aes_generate();
-
 	/* Validate key length and calculate number of intermediate rounds */
 	switch ( keylen ) {
 	case ( 128 / 8 ) :
@@ -775,6 +968,9 @@ static int aes_setkey ( void *ctx, const void *key, size_t keylen ) {
 	DBGC2 ( aes, "AES %p inverted %zd-bit key:\n", aes, ( keylen * 8 ) );
 	DBGC2_HDA ( aes, 0, &aes->decrypt, ( rounds * sizeof ( *dec ) ) );
 
+	/* Use accelerated implementation, if supported */
+	aes->accel = aes_accel_supported();
+
 	return 0;
 }
 
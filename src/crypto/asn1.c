@@ -741,21 +741,31 @@ static size_t asn1_header ( struct asn1_builder_header *header,
  */
 int asn1_grow ( struct asn1_builder *builder, size_t extra ) {
 	size_t new_len;
+	size_t new_max_len;
 	void *new;
 
 	/* As with the ASN1 parsing functions, make errors permanent */
 	if ( builder->len && ! builder->data )
 		return -ENOMEM;
 
-	/* Reallocate data buffer */
+	/* Reallocate data buffer, if necessary.  Grow the allocation
+	 * beyond the immediate requirement so that an object built up
+	 * from multiple prepended components does not incur a
+	 * reallocation (and copy) for every component.
+	 */
 	new_len = ( builder->len + extra );
-	new = realloc ( builder->data, new_len );
-	if ( ! new ) {
-		free ( builder->data );
-		builder->data = NULL;
-		return -ENOMEM;
+	if ( new_len > builder->max_len ) {
+		new_max_len = ( new_len * 2 );
+		new = realloc ( builder->data, new_max_len );
+		if ( ! new ) {
+			free ( builder->data );
+			builder->data = NULL;
+			builder->max_len = 0;
+			return -ENOMEM;
+		}
+		builder->data = new;
+		builder->max_len = new_max_len;
 	}
-	builder->data = new;
 
 	/* Move existing data to end of buffer */
 	memmove ( ( builder->data + extra ), builder->data, builder->len );
@@ -50,6 +50,10 @@ static struct profiler bigint_mod_multiply_rescale_profiler __profiler =
 static struct profiler bigint_mod_multiply_subtract_profiler __profiler =
 	{ .name = "bigint_mod_multiply.subtract" };
 
+/** Montgomery multiplication profiler */
+static struct profiler bigint_montgomery_multiply_profiler __profiler =
+	{ .name = "bigint_montgomery_multiply" };
+
 /**
  * Perform modular multiplication of big integers
  *
@@ -119,6 +123,188 @@ void bigint_mod_multiply_raw ( const bigint_element_t *multiplicand0,
 	profile_stop ( &bigint_mod_multiply_profiler );
 }
 
+/**
+ * Perform Montgomery multiplication of big integers
+ *
+ * @v multiplicand0	Element 0 of big integer to be multiplied
+ * @v multiplier0	Element 0 of big integer to be multiplied
+ * @v modulus0		Element 0 of big integer odd modulus
+ * @v nprime0		Element 0 of big integer negated modulus inverse
+ * @v result0		Element 0 of big integer to hold result
+ * @v size		Number of elements in operands, modulus, and result
+ * @v tmp		Temporary working space
+ *
+ * Calculate
+ *
+ *   result = ( multiplicand * multiplier / R ) mod modulus
+ *
+ * where R is 2^(size*width).  The negated modulus inverse nprime must
+ * be ( -modulus^-1 ) mod R, and the multiplier must be less than the
+ * modulus (the multiplicand may be any value less than R).  The
+ * result is always less than the modulus.
+ *
+ * The reduction is carried out using whole-width multiplications (via
+ * the per-architecture multiplication code), rather than by
+ * interleaving reduction steps with the multiplication itself.
+ */
+static void bigint_montgomery_multiply_raw ( const bigint_element_t
+							*multiplicand0,
+					     const bigint_element_t
+							*multiplier0,
+					     const bigint_element_t *modulus0,
+					     const bigint_element_t *nprime0,
+					     bigint_element_t *result0,
+					     unsigned int size, void *tmp ) {
+	const bigint_t ( size ) __attribute__ (( may_alias )) *multiplicand =
+		( ( const void * ) multiplicand0 );
+	const bigint_t ( size ) __attribute__ (( may_alias )) *multiplier =
+		( ( const void * ) multiplier0 );
+	const bigint_t ( size ) __attribute__ (( may_alias )) *modulus =
+		( ( const void * ) modulus0 );
+	const bigint_t ( size ) __attribute__ (( may_alias )) *nprime =
+		( ( const void * ) nprime0 );
+	bigint_t ( size ) __attribute__ (( may_alias )) *result =
+		( ( void * ) result0 );
+	struct {
+		bigint_t ( size * 2 ) product;
+		bigint_t ( size ) low;
+		bigint_t ( size * 2 + 1 ) sum;
+		bigint_t ( size * 2 + 1 ) addend;
+		bigint_t ( size + 1 ) modulus;
+	} *temp = tmp;
+	bigint_t ( size ) __attribute__ (( may_alias )) *sum_low =
+		( ( void * ) temp->sum.element );
+	bigint_t ( size + 1 ) __attribute__ (( may_alias )) *sum_high =
+		( ( void * ) &temp->sum.element[size] );
+
+	/* Start profiling */
+	profile_start ( &bigint_montgomery_multiply_profiler );
+
+	/* Sanity check */
+	assert ( sizeof ( *temp ) == bigint_montgomery_tmp_len ( modulus ) );
+
+	/* Calculate sum = multiplicand * multiplier */
+	bigint_multiply ( multiplicand, multiplier, &temp->product );
+	bigint_grow ( &temp->product, &temp->sum );
+
+	/* Calculate low = ( ( sum mod R ) * nprime ) mod R */
+	memcpy ( &temp->low, &temp->product, sizeof ( temp->low ) );
+	bigint_multiply ( &temp->low, nprime, &temp->product );
+	memcpy ( &temp->low, &temp->product, sizeof ( temp->low ) );
+
+	/* Calculate sum += low * modulus, making sum divisible by R */
+	bigint_multiply ( &temp->low, modulus, &temp->product );
+	bigint_grow ( &temp->product, &temp->addend );
+	bigint_add ( &temp->addend, &temp->sum );
+	assert ( bigint_is_zero ( sum_low ) );
+
+	/* Calculate result = ( sum / R ) mod modulus
+	 *
+	 * The quotient is less than twice the modulus, so a single
+	 * conditional subtraction suffices.
+	 */
+	bigint_grow ( modulus, &temp->modulus );
+	if ( bigint_is_geq ( sum_high, &temp->modulus ) )
+		bigint_subtract ( &temp->modulus, sum_high );
+	bigint_shrink ( sum_high, result );
+
+	/* Sanity check */
+	assert ( bigint_is_geq ( modulus, result ) );
+
+	/* Stop profiling */
+	profile_stop ( &bigint_montgomery_multiply_profiler );
+}
+
+/**
+ * Calculate negated modulus inverse for Montgomery multiplication
+ *
+ * @v modulus0		Element 0 of big integer odd modulus
+ * @v nprime0		Element 0 of big integer to hold negated inverse
+ * @v size		Number of elements in modulus and negated inverse
+ * @v tmp		Temporary working space
+ *
+ * Calculate nprime = ( -modulus^-1 ) mod R using Newton-Raphson
+ * iteration, which doubles the number of correct low-order bits on
+ * each step.  The modulus is self-inverse modulo 8, which provides
+ * the three-bit initial approximation.
+ */
+static void bigint_montgomery_nprime_raw ( const bigint_element_t *modulus0,
+					   bigint_element_t *nprime0,
+					   unsigned int size, void *tmp ) {
+	const bigint_t ( size ) __attribute__ (( may_alias )) *modulus =
+		( ( const void * ) modulus0 );
+	bigint_t ( size ) __attribute__ (( may_alias )) *nprime =
+		( ( void * ) nprime0 );
+	struct {
+		bigint_t ( size ) inverse;
+		bigint_t ( size ) delta;
+		bigint_t ( size * 2 ) product;
+	} *temp = tmp;
+	bigint_t ( size ) __attribute__ (( may_alias )) *product_low =
+		( ( void * ) temp->product.element );
+	static const uint8_t two[1] = { 0x02 };
+	unsigned int width = ( 8 * sizeof ( bigint_element_t ) );
+	unsigned int bits;
+
+	/* Sanity check */
+	assert ( bigint_bit_is_set ( modulus, 0 ) );
+
+	/* Newton-Raphson iteration: inverse *= ( 2 - modulus * inverse ) */
+	memcpy ( &temp->inverse, modulus, sizeof ( temp->inverse ) );
+	for ( bits = 3 ; bits < ( size * width ) ; bits *= 2 ) {
+		bigint_multiply ( modulus, &temp->inverse, &temp->product );
+		bigint_init ( &temp->delta, two, sizeof ( two ) );
+		bigint_subtract ( product_low, &temp->delta );
+		bigint_multiply ( &temp->inverse, &temp->delta,
+				  &temp->product );
+		memcpy ( &temp->inverse, &temp->product,
+			 sizeof ( temp->inverse ) );
+	}
+
+	/* Negate inverse */
+	memset ( nprime, 0, sizeof ( *nprime ) );
+	bigint_subtract ( &temp->inverse, nprime );
+}
+
+/**
+ * Calculate Montgomery conversion factor
+ *
+ * @v modulus0		Element 0 of big integer odd modulus
+ * @v r20		Element 0 of big integer to hold R^2 mod modulus
+ * @v size		Number of elements in modulus and conversion factor
+ * @v tmp		Temporary working space
+ *
+ * Calculate R^2 mod modulus (where R is 2^(size*width)) by repeated
+ * modular doubling, starting from one.  Multiplying by this factor
+ * (via Montgomery multiplication) converts a value into Montgomery
+ * form.
+ */
+static void bigint_montgomery_r2_raw ( const bigint_element_t *modulus0,
+				       bigint_element_t *r20,
+				       unsigned int size, void *tmp ) {
+	const bigint_t ( size ) __attribute__ (( may_alias )) *modulus =
+		( ( const void * ) modulus0 );
+	bigint_t ( size ) __attribute__ (( may_alias )) *r2 =
+		( ( void * ) r20 );
+	struct {
+		bigint_t ( size + 1 ) residue;
+		bigint_t ( size + 1 ) modulus;
+	} *temp = tmp;
+	static const uint8_t one[1] = { 0x01 };
+	unsigned int width = ( 8 * sizeof ( bigint_element_t ) );
+	unsigned int shift;
+
+	/* Calculate ( 2^(2*size*width) ) mod modulus */
+	bigint_grow ( modulus, &temp->modulus );
+	bigint_init ( &temp->residue, one, sizeof ( one ) );
+	for ( shift = ( 2 * size * width ) ; shift ; shift-- ) {
+		bigint_rol ( &temp->residue );
+		if ( bigint_is_geq ( &temp->residue, &temp->modulus ) )
+			bigint_subtract ( &temp->modulus, &temp->residue );
+	}
+	bigint_shrink ( &temp->residue, r2 );
+}
+
 /**
  * Perform modular exponentiation of big integers
  *
@@ -129,6 +315,12 @@ void bigint_mod_multiply_raw ( const bigint_element_t *multiplicand0,
  * @v size		Number of elements in base, modulus, and result
  * @v exponent_size	Number of elements in exponent
  * @v tmp		Temporary working space
+ *
+ * Odd moduli (as used by RSA and by all standardised Diffie-Hellman
+ * groups) are handled using Montgomery multiplication with a sliding
+ * window over the exponent, which avoids the expensive shift-and-
+ * subtract reduction after each multiplication.  Even moduli fall
+ * back to conditional multiplication over each exponent bit.
  */
 void bigint_mod_exp_raw ( const bigint_element_t *base0,
 			  const bigint_element_t *modulus0,
@@ -145,24 +337,145 @@ void bigint_mod_exp_raw ( const bigint_element_t *base0,
 	bigint_t ( size ) __attribute__ (( may_alias )) *result =
 		( ( void * ) result0 );
 	size_t mod_multiply_len = bigint_mod_multiply_tmp_len ( modulus );
+	size_t montgomery_len = bigint_montgomery_tmp_len ( modulus );
 	struct {
 		bigint_t ( size ) base;
 		bigint_t ( exponent_size ) exponent;
-		uint8_t mod_multiply[mod_multiply_len];
+		bigint_t ( size ) residue;
+		bigint_t ( size )
+			power[ 1 << ( BIGINT_MOD_EXP_WINDOW - 1 ) ];
+		union {
+			uint8_t mod_multiply[mod_multiply_len];
+			uint8_t montgomery[montgomery_len];
+		} sub;
 	} *temp = tmp;
 	static const uint8_t start[1] = { 0x01 };
+	unsigned int bit;
+	unsigned int window;
+	unsigned int index;
+	unsigned int i;
+	int first;
+
+	/* Sanity check */
+	assert ( sizeof ( *temp ) ==
+		 bigint_mod_exp_tmp_len ( modulus, exponent ) );
 
-	memcpy ( &temp->base, base, sizeof ( temp->base ) );
-	memcpy ( &temp->exponent, exponent, sizeof ( temp->exponent ) );
-	bigint_init ( result, start, sizeof ( start ) );
+	/* Fall back to conditional multiplication over each exponent
+	 * bit for even moduli, for which no Montgomery inverse
+	 * exists.
+	 */
+	if ( ! bigint_bit_is_set ( modulus, 0 ) ) {
+		memcpy ( &temp->base, base, sizeof ( temp->base ) );
+		memcpy ( &temp->exponent, exponent,
+			 sizeof ( temp->exponent ) );
+		bigint_init ( result, start, sizeof ( start ) );
+		while ( ! bigint_is_zero ( &temp->exponent ) ) {
+			if ( bigint_bit_is_set ( &temp->exponent, 0 ) ) {
+				bigint_mod_multiply ( result, &temp->base,
+						      modulus, result,
+						      temp->sub.mod_multiply );
+			}
+			bigint_ror ( &temp->exponent );
+			bigint_mod_multiply ( &temp->base, &temp->base,
+					      modulus, &temp->base,
+					      temp->sub.mod_multiply );
+		}
+		return;
+	}
+
+	/* Handle degenerate case of a zero exponent */
+	bit = bigint_max_set_bit ( exponent );
+	if ( ! bit ) {
+		bigint_init ( result, start, sizeof ( start ) );
+		return;
+	}
+
+	/* Calculate Montgomery parameters (using temp->base to hold
+	 * the negated modulus inverse, and temp->residue to hold the
+	 * conversion factor R^2 mod modulus).  Both helpers use
+	 * strictly less temporary space than Montgomery
+	 * multiplication itself.
+	 */
+	bigint_montgomery_nprime_raw ( modulus0, temp->base.element, size,
+				       temp->sub.montgomery );
+	bigint_montgomery_r2_raw ( modulus0, temp->residue.element, size,
+				   temp->sub.montgomery );
 
-	while ( ! bigint_is_zero ( &temp->exponent ) ) {
-		if ( bigint_bit_is_set ( &temp->exponent, 0 ) ) {
-			bigint_mod_multiply ( result, &temp->base, modulus,
-					      result, temp->mod_multiply );
+	/* Convert base into Montgomery form, and precompute the odd
+	 * powers base^1, base^3, ... base^(2^window-1), reusing
+	 * temp->residue to hold the Montgomery form of base^2.
+	 */
+	bigint_montgomery_multiply_raw ( base0, temp->residue.element,
+					 modulus0, temp->base.element,
+					 temp->power[0].element, size,
+					 temp->sub.montgomery );
+	bigint_montgomery_multiply_raw ( temp->power[0].element,
+					 temp->power[0].element, modulus0,
+					 temp->base.element,
+					 temp->residue.element, size,
+					 temp->sub.montgomery );
+	for ( i = 1 ; i < ( 1 << ( BIGINT_MOD_EXP_WINDOW - 1 ) ) ; i++ ) {
+		bigint_montgomery_multiply_raw ( temp->power[ i - 1 ].element,
+						 temp->residue.element,
+						 modulus0,
+						 temp->base.element,
+						 temp->power[i].element, size,
+						 temp->sub.montgomery );
+	}
+
+	/* Scan exponent from the most significant bit downwards,
+	 * squaring for each bit consumed and multiplying by a
+	 * precomputed odd power for each window of set bits.
+	 */
+	first = 1;
+	while ( bit ) {
+		if ( ! bigint_bit_is_set ( exponent, ( bit - 1 ) ) ) {
+			if ( ! first ) {
+				bigint_montgomery_multiply_raw (
+					result0, result0, modulus0,
+					temp->base.element, result0, size,
+					temp->sub.montgomery );
+			}
+			bit--;
+			continue;
+		}
+		/* Shrink window until its least significant bit is set */
+		window = BIGINT_MOD_EXP_WINDOW;
+		if ( window > bit )
+			window = bit;
+		while ( ! bigint_bit_is_set ( exponent, ( bit - window ) ) )
+			window--;
+		/* Square for each bit within the window */
+		index = 0;
+		for ( i = 0 ; i < window ; i++ ) {
+			index <<= 1;
+			if ( bigint_bit_is_set ( exponent, ( bit - 1 - i ) ) )
+				index |= 1;
+			if ( ! first ) {
+				bigint_montgomery_multiply_raw (
+					result0, result0, modulus0,
+					temp->base.element, result0, size,
+					temp->sub.montgomery );
+			}
 		}
-		bigint_ror ( &temp->exponent );
-		bigint_mod_multiply ( &temp->base, &temp->base, modulus,
-				      &temp->base, temp->mod_multiply );
+		/* Multiply by the relevant precomputed odd power */
+		if ( first ) {
+			memcpy ( result, &temp->power[ index >> 1 ],
+				 sizeof ( *result ) );
+			first = 0;
+		} else {
+			bigint_montgomery_multiply_raw (
+				result0, temp->power[ index >> 1 ].element,
+				modulus0, temp->base.element, result0, size,
+				temp->sub.montgomery );
+		}
+		bit -= window;
 	}
+
+	/* Convert result out of Montgomery form */
+	bigint_init ( &temp->residue, start, sizeof ( start ) );
+	bigint_montgomery_multiply_raw ( result0, temp->residue.element,
+					 modulus0, temp->base.element,
+					 result0, size,
+					 temp->sub.montgomery );
 }
@@ -92,10 +92,34 @@ void cbc_encrypt ( void *ctx, const void *src, void *dst, size_t len,
 void cbc_decrypt ( void *ctx, const void *src, void *dst, size_t len,
 		   struct cipher_algorithm *raw_cipher, void *cbc_ctx ) {
 	size_t blocksize = raw_cipher->blocksize;
-	uint8_t next_cbc_ctx[blocksize];
+	uint8_t next_cbc_ctx[ 2 * blocksize ];
 
 	assert ( ( len % blocksize ) == 0 );
 
+	/* Unlike encryption, CBC decryption of each block is
+	 * independent of all other blocks (requiring only the
+	 * ciphertext of the preceding block), so pairs of blocks may
+	 * be passed to the underlying cipher in a single call.  This
+	 * allows the cipher to process independent blocks in
+	 * parallel, which roughly doubles throughput for the software
+	 * AES implementation.
+	 *
+	 * The ciphertext pair is copied before decryption so that the
+	 * chaining XOR works even when decrypting in place.
+	 */
+	while ( len >= ( 2 * blocksize ) ) {
+		memcpy ( next_cbc_ctx, src, ( 2 * blocksize ) );
+		cipher_decrypt ( raw_cipher, ctx, src, dst,
+				 ( 2 * blocksize ) );
+		cbc_xor ( cbc_ctx, dst, blocksize );
+		cbc_xor ( next_cbc_ctx, ( dst + blocksize ), blocksize );
+		memcpy ( cbc_ctx, &next_cbc_ctx[blocksize], blocksize );
+		dst += ( 2 * blocksize );
+		src += ( 2 * blocksize );
+		len -= ( 2 * blocksize );
+	}
+
+	/* Decrypt remaining block, if any */
 	while ( len ) {
 		memcpy ( next_cbc_ctx, src, blocksize );
 		cipher_decrypt ( raw_cipher, ctx, src, dst, blocksize );
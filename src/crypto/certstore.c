@@ -30,6 +30,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/settings.h>
 #include <ipxe/malloc.h>
 #include <ipxe/crypto.h>
+#include <ipxe/crc32.h>
 #include <ipxe/asn1.h>
 #include <ipxe/x509.h>
 #include <ipxe/certstore.h>
@@ -101,9 +102,17 @@ certstore_found ( struct x509_certificate *cert ) {
  */
 struct x509_certificate * certstore_find ( struct asn1_cursor *raw ) {
 	struct x509_certificate *cert;
+	uint32_t crc;
 
-	/* Search for certificate within store */
+	/* Generate CRC32 for comparison against stored certificates */
+	crc = crc32_le ( 0xffffffffUL, raw->data, raw->len );
+
+	/* Search for certificate within store, comparing the full raw
+	 * data only when the CRC32 matches.
+	 */
 	list_for_each_entry ( cert, &certstore.links, store.list ) {
+		if ( cert->store_crc != crc )
+			continue;
 		if ( asn1_compare ( raw, &cert->raw ) == 0 )
 			return certstore_found ( cert );
 	}
@@ -139,6 +148,8 @@ void certstore_add ( struct x509_certificate *cert ) {
 
 	/* Add certificate to store */
 	cert->store.cert = cert;
+	cert->store_crc = crc32_le ( 0xffffffffUL, cert->raw.data,
+				     cert->raw.len );
 	x509_get ( cert );
 	list_add ( &cert->store.list, &certstore.links );
 	DBGC ( &certstore, "CERTSTORE added certificate %s\n",
@@ -472,6 +472,7 @@ static void cms_free ( struct refcnt *refcnt ) {
 		list_del ( &info->list );
 		x509_chain_put ( info->chain );
 		free ( info->signature );
+		free ( info->digest_ctx );
 		free ( info );
 	}
 	x509_chain_put ( sig->certificates );
@@ -566,6 +567,109 @@ static void cms_digest ( struct cms_signature *sig,
 	DBGC_HDA ( sig, 0, out, digest->digestsize );
 }
 
+/**
+ * Initialise incremental digests of CMS-signed data
+ *
+ * @v sig		CMS signature
+ * @ret rc		Return status code
+ *
+ * Allocates a digest context for each signer information block, so
+ * that the (potentially very large) signed data can be digested
+ * piecewise via cms_digest_update() while other work (such as
+ * certificate chain validation) is in progress.  The caller must
+ * digest the complete signed data before calling cms_verify().
+ */
+int cms_digest_init ( struct cms_signature *sig ) {
+	struct cms_signer_info *info;
+
+	list_for_each_entry ( info, &sig->info, list ) {
+
+		/* Discard any previous digest context */
+		free ( info->digest_ctx );
+
+		/* Allocate and initialise digest context */
+		info->digest_ctx = malloc ( info->digest->ctxsize );
+		if ( ! info->digest_ctx )
+			return -ENOMEM;
+		digest_init ( info->digest, info->digest_ctx );
+	}
+
+	return 0;
+}
+
+/**
+ * Digest portion of CMS-signed data
+ *
+ * @v sig		CMS signature
+ * @v data		Signed data
+ * @v offset		Offset within signed data
+ * @v len		Length to digest
+ *
+ * Portions must be digested sequentially and contiguously, starting
+ * at offset zero.
+ */
+void cms_digest_update ( struct cms_signature *sig, userptr_t data,
+			 size_t offset, size_t len ) {
+	struct cms_signer_info *info;
+	size_t frag_len;
+
+	list_for_each_entry ( info, &sig->info, list ) {
+		struct digest_algorithm *digest = info->digest;
+		uint8_t block[ digest->blocksize ];
+		size_t frag_offset = offset;
+		size_t remaining = len;
+
+		assert ( info->digest_ctx != NULL );
+
+		/* Process data one block at a time */
+		while ( remaining ) {
+			frag_len = remaining;
+			if ( frag_len > sizeof ( block ) )
+				frag_len = sizeof ( block );
+			copy_from_user ( block, data, frag_offset, frag_len );
+			digest_update ( digest, info->digest_ctx, block,
+					frag_len );
+			frag_offset += frag_len;
+			remaining -= frag_len;
+		}
+	}
+}
+
+/**
+ * Resume incremental digests from a precomputed context
+ *
+ * @v sig		CMS signature
+ * @v digest		Digest algorithm used for precomputation
+ * @v ctx		Precomputed digest context
+ * @ret rc		Return status code
+ *
+ * The caller may have opportunistically digested the signed data
+ * before the signature itself was available (e.g. while the signature
+ * was being downloaded), using a guessed digest algorithm.  If every
+ * signer uses the guessed algorithm then the precomputed context is
+ * adopted and no further calls to cms_digest_update() are required;
+ * otherwise the digests are left untouched and the signed data must
+ * be digested as usual.
+ */
+int cms_digest_resume ( struct cms_signature *sig,
+			struct digest_algorithm *digest, const void *ctx ) {
+	struct cms_signer_info *info;
+
+	/* Refuse unless every signer uses the precomputed algorithm */
+	list_for_each_entry ( info, &sig->info, list ) {
+		if ( info->digest != digest )
+			return -ENOTSUP;
+	}
+
+	/* Adopt precomputed context */
+	list_for_each_entry ( info, &sig->info, list ) {
+		assert ( info->digest_ctx != NULL );
+		memcpy ( info->digest_ctx, ctx, digest->ctxsize );
+	}
+
+	return 0;
+}
+
 /**
  * Verify digest of CMS-signed data
  *
@@ -587,8 +691,18 @@ static int cms_verify_digest ( struct cms_signature *sig,
 	uint8_t ctx[ pubkey->ctxsize ];
 	int rc;
 
-	/* Generate digest */
-	cms_digest ( sig, info, data, len, digest_out );
+	/* Use incrementally-computed digest if available, otherwise
+	 * digest the complete signed data now.
+	 */
+	if ( info->digest_ctx ) {
+		digest_final ( digest, info->digest_ctx, digest_out );
+		free ( info->digest_ctx );
+		info->digest_ctx = NULL;
+		DBGC ( sig, "CMS %p/%p digest value:\n", sig, info );
+		DBGC_HDA ( sig, 0, digest_out, digest->digestsize );
+	} else {
+		cms_digest ( sig, info, data, len, digest_out );
+	}
 
 	/* Initialise public-key algorithm */
 	if ( ( rc = pubkey_init ( pubkey, ctx, public_key->raw.data,
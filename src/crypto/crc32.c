@@ -21,10 +21,58 @@
 
 FILE_LICENCE ( GPL2_OR_LATER );
 
+#include <byteswap.h>
+#include <ipxe/init.h>
 #include <ipxe/crc32.h>
 
 #define CRCPOLY		0xedb88320
 
+/** Number of slicing-by-N slices */
+#define CRCSLICES 8
+
+/** Slicing-by-N lookup tables
+ *
+ * Generated during initialisation, to avoid adding 8kB of static
+ * data to the image.  Table N gives the effect on the CRC of a byte
+ * processed N bytes before the end of an aligned group.
+ */
+static u32 crc32_table[CRCSLICES][256];
+
+/**
+ * Generate CRC32 lookup tables
+ *
+ */
+static void crc32_init ( void ) {
+	u32 crc;
+	u32 mult;
+	unsigned int i;
+	unsigned int j;
+
+	/* Generate bytewise table */
+	for ( i = 0 ; i < 256 ; i++ ) {
+		crc = i;
+		for ( j = 0 ; j < 8 ; j++ ) {
+			mult = ( crc & 1 ) ? CRCPOLY : 0;
+			crc = ( crc >> 1 ) ^ mult;
+		}
+		crc32_table[0][i] = crc;
+	}
+
+	/* Generate remaining slice tables */
+	for ( i = 0 ; i < 256 ; i++ ) {
+		crc = crc32_table[0][i];
+		for ( j = 1 ; j < CRCSLICES ; j++ ) {
+			crc = crc32_table[0][ crc & 0xff ] ^ ( crc >> 8 );
+			crc32_table[j][i] = crc;
+		}
+	}
+}
+
+/** CRC32 lookup table initialiser */
+struct init_fn crc32_init_fn __init_fn ( INIT_NORMAL ) = {
+	.initialise = crc32_init,
+};
+
 /**
  * Calculate 32-bit little-endian CRC checksum
  *
@@ -40,15 +88,38 @@ u32 crc32_le ( u32 seed, const void *data, size_t len )
 {
 	u32 crc = seed;
 	const u8 *src = data;
-	u32 mult;
-	int i;
+	const u32 *word;
+	u32 lo;
+	u32 hi;
 
+	/* Process individual bytes until source is word-aligned */
+	while ( len && ( ( ( intptr_t ) src ) & ( sizeof ( *word ) - 1 ) ) ) {
+		crc = crc32_table[0][ ( crc ^ *(src++) ) & 0xff ] ^
+			( crc >> 8 );
+		len--;
+	}
+
+	/* Process two whole words (one slice group) at a time */
+	word = ( ( const u32 * ) src );
+	while ( len >= ( 2 * sizeof ( *word ) ) ) {
+		lo = ( le32_to_cpu ( *(word++) ) ^ crc );
+		hi = le32_to_cpu ( *(word++) );
+		crc = ( crc32_table[7][ ( lo >>  0 ) & 0xff ] ^
+			crc32_table[6][ ( lo >>  8 ) & 0xff ] ^
+			crc32_table[5][ ( lo >> 16 ) & 0xff ] ^
+			crc32_table[4][ ( lo >> 24 ) & 0xff ] ^
+			crc32_table[3][ ( hi >>  0 ) & 0xff ] ^
+			crc32_table[2][ ( hi >>  8 ) & 0xff ] ^
+			crc32_table[1][ ( hi >> 16 ) & 0xff ] ^
+			crc32_table[0][ ( hi >> 24 ) & 0xff ] );
+		len -= ( 2 * sizeof ( *word ) );
+	}
+	src = ( ( const u8 * ) word );
+
+	/* Process remaining bytes */
 	while ( len-- ) {
-		crc ^= *src++;
-		for ( i = 0; i < 8; i++ ) {
-			mult = ( crc & 1 ) ? CRCPOLY : 0;
-			crc = ( crc >> 1 ) ^ mult;
-		}
+		crc = crc32_table[0][ ( crc ^ *(src++) ) & 0xff ] ^
+			( crc >> 8 );
 	}
 
 	return crc;
@@ -220,6 +220,9 @@ static int deflate_alphabet ( struct deflate *deflate,
 	unsigned int raw;
 	unsigned int adjustment;
 	unsigned int prefix;
+	unsigned int fill;
+	unsigned int entry;
+	unsigned int i;
 	int complete;
 
 	/* Clear symbol table */
@@ -283,6 +286,27 @@ static int deflate_alphabet ( struct deflate *deflate,
 		}
 	}
 
+	/* Populate quick lookup direct symbol table.  Each symbol no
+	 * longer than the quick lookup prefix appears in every entry
+	 * matching its Huffman-coded value; longer symbols leave
+	 * entries as zero and are decoded via the per-length symbol
+	 * sets.
+	 */
+	memset ( alphabet->direct, 0, sizeof ( alphabet->direct ) );
+	for ( bits = 1 ; bits <= DEFLATE_HUFFMAN_QL_BITS ; bits++ ) {
+		huf_sym = &alphabet->huf[ bits - 1 ];
+		fill = ( 1 << ( DEFLATE_HUFFMAN_QL_BITS - bits ) );
+		for ( i = 0 ; i < huf_sym->freq ; i++ ) {
+			huf = ( ( huf_sym->start >> huf_sym->shift ) + i );
+			entry = ( ( bits << DEFLATE_HUFFMAN_QL_DIRECT_SHIFT ) |
+				  huf_sym->raw[huf] );
+			for ( prefix = ( huf * fill ) ;
+			      prefix < ( ( huf + 1 ) * fill ) ; prefix++ ) {
+				alphabet->direct[prefix] = entry;
+			}
+		}
+	}
+
 	/* Dump alphabet (for debugging) */
 	deflate_dump_alphabet ( deflate, alphabet );
 
@@ -307,23 +331,34 @@ static int deflate_alphabet ( struct deflate *deflate,
 static int deflate_accumulate ( struct deflate *deflate,
 				struct deflate_chunk *in,
 				unsigned int target ) {
+	uint8_t data[ sizeof ( deflate->accumulator ) ];
 	uint8_t byte;
+	size_t len;
+	unsigned int i;
 
-	while ( deflate->bits < target ) {
-
-		/* Check for end of input */
-		if ( in->offset >= in->len )
-			break;
+	if ( deflate->bits < target ) {
 
-		/* Acquire byte from input */
-		copy_from_user ( &byte, in->data, in->offset++,
-				 sizeof ( byte ) );
-		deflate->accumulator = ( deflate->accumulator |
-					 ( byte << deflate->bits ) );
-		deflate->rotalumucca = ( deflate->rotalumucca |
-					 ( deflate_reverse[byte] <<
-					   ( 24 - deflate->bits ) ) );
-		deflate->bits += 8;
+		/* Refill accumulator with as many whole bytes as will
+		 * fit, using a single multi-byte read.  The
+		 * accumulator is large enough to hold any maximum
+		 * required number of bits, so a single refill always
+		 * suffices (if sufficient input is available).
+		 */
+		len = ( ( ( 8 * sizeof ( deflate->accumulator ) ) -
+			  deflate->bits ) / 8 );
+		if ( len > ( in->len - in->offset ) )
+			len = ( in->len - in->offset );
+		copy_from_user ( data, in->data, in->offset, len );
+		in->offset += len;
+		for ( i = 0 ; i < len ; i++ ) {
+			byte = data[i];
+			deflate->accumulator |=
+				( ( ( uint64_t ) byte ) << deflate->bits );
+			deflate->rotalumucca |=
+				( ( ( uint64_t ) deflate_reverse[byte] ) <<
+				  ( 56 - deflate->bits ) );
+			deflate->bits += 8;
+		}
 
 		/* Sanity check */
 		assert ( deflate->bits <=
@@ -399,6 +434,8 @@ static int deflate_decode ( struct deflate *deflate,
 	struct deflate_huf_symbols *huf_sym;
 	uint16_t huf;
 	unsigned int lookup_index;
+	unsigned int direct;
+	unsigned int bits;
 	int excess;
 	unsigned int raw;
 
@@ -410,10 +447,34 @@ static int deflate_decode ( struct deflate *deflate,
 	deflate_accumulate ( deflate, in, DEFLATE_HUFFMAN_BITS );
 
 	/* Normalise the bit-reversed accumulated value to 16 bits */
-	huf = ( deflate->rotalumucca >> 16 );
+	huf = ( deflate->rotalumucca >> 48 );
 
-	/* Find symbol set for this length */
+	/* Look up short symbols directly, if possible */
 	lookup_index = ( huf >> DEFLATE_HUFFMAN_QL_SHIFT );
+	direct = alphabet->direct[ lookup_index ];
+	if ( direct ) {
+
+		/* Calculate number of excess bits, and return if
+		 * not yet complete.
+		 */
+		bits = ( direct >> DEFLATE_HUFFMAN_QL_DIRECT_SHIFT );
+		excess = ( deflate->bits - bits );
+		if ( excess < 0 )
+			return excess;
+
+		/* Consume bits */
+		deflate_consume ( deflate, bits );
+
+		/* Extract raw symbol */
+		raw = ( direct &
+			( ( 1 << DEFLATE_HUFFMAN_QL_DIRECT_SHIFT ) - 1 ) );
+		DBGCP ( deflate, "DEFLATE %p decoded %s = %#x = %d\n", deflate,
+			deflate_bin ( ( huf >> ( 16 - bits ) ), bits ),
+			raw, raw );
+		return raw;
+	}
+
+	/* Find symbol set for longer symbols */
 	huf_sym = &alphabet->huf[ alphabet->lookup[ lookup_index ] ];
 	while ( huf < huf_sym->start )
 		huf_sym--;
@@ -457,15 +518,31 @@ static void deflate_copy ( struct deflate_chunk *out,
 			   userptr_t start, size_t offset, size_t len ) {
 	size_t out_offset = out->offset;
 	size_t copy_len;
+	size_t frag_len;
 
-	/* Copy data one byte at a time, to allow for overlap */
+	/* Copy data in the largest possible non-overlapping
+	 * fragments.  When duplicating earlier output at a short
+	 * distance, the result is periodic in the distance, and so
+	 * each copied fragment may be recopied in full: the fragment
+	 * length therefore doubles on each iteration.
+	 */
 	if ( out_offset < out->len ) {
 		copy_len = ( out->len - out_offset );
 		if ( copy_len > len )
 			copy_len = len;
-		while ( copy_len-- ) {
-			memcpy_user ( out->data, out_offset++,
-				      start, offset++, 1 );
+		while ( copy_len ) {
+			frag_len = copy_len;
+			if ( ( start == out->data ) &&
+			     ( offset < out_offset ) &&
+			     ( frag_len > ( out_offset - offset ) ) ) {
+				frag_len = ( out_offset - offset );
+			}
+			memcpy_user ( out->data, out_offset, start, offset,
+				      frag_len );
+			out_offset += frag_len;
+			if ( start != out->data )
+				offset += frag_len;
+			copy_len -= frag_len;
 		}
 	}
 	out->offset += len;
@@ -607,8 +684,24 @@ int deflate_inflate ( struct deflate *deflate,
 	}
 
  literal_data: {
+		uint8_t drain[ sizeof ( deflate->accumulator ) ];
 		size_t in_remaining;
 		size_t len;
+		unsigned int i;
+
+		/* Copy any whole bytes already held within the
+		 * accumulator to the output buffer.
+		 */
+		assert ( ( deflate->bits & 7 ) == 0 );
+		len = ( deflate->bits / 8 );
+		if ( len > deflate->remaining )
+			len = deflate->remaining;
+		if ( len ) {
+			for ( i = 0 ; i < len ; i++ )
+				drain[i] = deflate_consume ( deflate, 8 );
+			deflate_copy ( out, virt_to_user ( drain ), 0, len );
+			deflate->remaining -= len;
+		}
 
 		/* Calculate available amount of literal data */
 		in_remaining = ( in->len - in->offset );
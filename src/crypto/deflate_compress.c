@@ -0,0 +1,493 @@
+/*
+ * Copyright (C) 2021 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <ipxe/deflate.h>
+
+/** @file
+ *
+ * DEFLATE compression algorithm
+ *
+ * This file implements a streaming compressor producing output in
+ * the format specified in RFC 1951 (DEFLATE) or RFC 1950 (ZLIB).  It
+ * uses only the static Huffman alphabet, with a greedy single-probe
+ * string matcher, trading some compression ratio for speed and code
+ * size.
+ *
+ * The entire stream is emitted as a single static Huffman block.
+ * Matches are found only within the compressor's staging window
+ * rather than the full 32kB history permitted by the specification;
+ * this bounds the size of the compressor state structure.
+ */
+
+/** ADLER32 modulus */
+#define DEFLATE_ADLER32_MODULUS 65521
+
+/** Maximum number of bytes that can be accumulated before the
+ * ADLER32 sums must be reduced modulo the modulus.
+ */
+#define DEFLATE_ADLER32_MAX_LEN 5552
+
+/** Minimum match length */
+#define DEFLATE_MIN_MATCH 3
+
+/** Maximum match length */
+#define DEFLATE_MAX_MATCH 258
+
+/** Length codes
+ *
+ * These are the base lengths and extra bit counts for the
+ * literal/length codes 257-285, as defined in RFC 1951 section
+ * 3.2.5.
+ */
+static const uint16_t deflate_compress_len_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43,
+	51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+/** Length code extra bit counts */
+static const uint8_t deflate_compress_len_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3,
+	3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+/** Distance codes
+ *
+ * These are the base distances and extra bit counts for the distance
+ * codes 0-29, as defined in RFC 1951 section 3.2.5.
+ */
+static const uint16_t deflate_compress_dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193,
+	12289, 16385, 24577
+};
+
+/** Distance code extra bit counts */
+static const uint8_t deflate_compress_dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/**
+ * Update ADLER32 checksum
+ *
+ * @v defcom		Compressor
+ * @v data		Data
+ * @v len		Length of data
+ */
+static void deflate_compress_adler32 ( struct deflate_compress *defcom,
+				       const uint8_t *data, size_t len ) {
+	uint32_t s1 = ( defcom->checksum & 0xffff );
+	uint32_t s2 = ( defcom->checksum >> 16 );
+	size_t frag_len;
+	unsigned int i;
+
+	/* Reduce the sums modulo the modulus only as often as
+	 * required to avoid overflow.
+	 */
+	while ( len ) {
+		frag_len = len;
+		if ( frag_len > DEFLATE_ADLER32_MAX_LEN )
+			frag_len = DEFLATE_ADLER32_MAX_LEN;
+		for ( i = 0 ; i < frag_len ; i++ ) {
+			s1 += *(data++);
+			s2 += s1;
+		}
+		s1 %= DEFLATE_ADLER32_MODULUS;
+		s2 %= DEFLATE_ADLER32_MODULUS;
+		len -= frag_len;
+	}
+
+	defcom->checksum = ( ( s2 << 16 ) | s1 );
+}
+
+/**
+ * Append bits to output stream
+ *
+ * @v defcom		Compressor
+ * @v out		Compressed output data
+ * @v data		Bits to append (in transmission order from LSB)
+ * @v count		Number of bits to append
+ * @ret rc		Return status code
+ */
+static int deflate_compress_bits ( struct deflate_compress *defcom,
+				   struct deflate_chunk *out,
+				   uint32_t data, unsigned int count ) {
+	uint8_t byte;
+
+	/* Sanity check: accumulator must never overflow */
+	assert ( ( defcom->bits + count ) <=
+		 ( 8 * sizeof ( defcom->accumulator ) ) );
+
+	/* Append bits to accumulator */
+	defcom->accumulator |= ( data << defcom->bits );
+	defcom->bits += count;
+
+	/* Write out any whole bytes */
+	while ( defcom->bits >= 8 ) {
+		if ( out->offset >= out->len )
+			return -ENOBUFS;
+		byte = ( defcom->accumulator & 0xff );
+		copy_to_user ( out->data, out->offset, &byte,
+			       sizeof ( byte ) );
+		out->offset++;
+		defcom->accumulator >>= 8;
+		defcom->bits -= 8;
+	}
+
+	return 0;
+}
+
+/**
+ * Append Huffman-coded symbol to output stream
+ *
+ * @v defcom		Compressor
+ * @v out		Compressed output data
+ * @v code		Huffman code (in natural order from MSB)
+ * @v count		Length of Huffman code
+ * @ret rc		Return status code
+ *
+ * Huffman codes are packed starting with the most significant bit,
+ * whereas all other fields are packed starting with the least
+ * significant bit (RFC 1951 section 3.1.1), so the code must be
+ * bit-reversed before transmission.
+ */
+static int deflate_compress_huf ( struct deflate_compress *defcom,
+				  struct deflate_chunk *out,
+				  unsigned int code, unsigned int count ) {
+	uint32_t reversed = 0;
+	unsigned int i;
+
+	for ( i = 0 ; i < count ; i++ ) {
+		reversed <<= 1;
+		reversed |= ( ( code >> i ) & 1 );
+	}
+
+	return deflate_compress_bits ( defcom, out, reversed, count );
+}
+
+/**
+ * Append literal/length symbol to output stream
+ *
+ * @v defcom		Compressor
+ * @v out		Compressed output data
+ * @v sym		Literal/length symbol
+ * @ret rc		Return status code
+ *
+ * The code assignments are those of the static Huffman alphabet
+ * defined in RFC 1951 section 3.2.6.
+ */
+static int deflate_compress_litlen ( struct deflate_compress *defcom,
+				     struct deflate_chunk *out,
+				     unsigned int sym ) {
+
+	if ( sym < 144 ) {
+		return deflate_compress_huf ( defcom, out, ( 0x30 + sym ), 8 );
+	} else if ( sym < 256 ) {
+		return deflate_compress_huf ( defcom, out,
+					      ( 0x190 + sym - 144 ), 9 );
+	} else if ( sym < 280 ) {
+		return deflate_compress_huf ( defcom, out, ( sym - 256 ), 7 );
+	} else {
+		return deflate_compress_huf ( defcom, out,
+					      ( 0xc0 + sym - 280 ), 8 );
+	}
+}
+
+/**
+ * Append length/distance pair to output stream
+ *
+ * @v defcom		Compressor
+ * @v out		Compressed output data
+ * @v len		Match length
+ * @v dist		Match distance
+ * @ret rc		Return status code
+ */
+static int deflate_compress_match ( struct deflate_compress *defcom,
+				    struct deflate_chunk *out,
+				    size_t len, size_t dist ) {
+	unsigned int code;
+	int rc;
+
+	/* Sanity checks */
+	assert ( ( len >= DEFLATE_MIN_MATCH ) &&
+		 ( len <= DEFLATE_MAX_MATCH ) );
+	assert ( ( dist >= 1 ) && ( dist < DEFLATE_COMPRESS_WINDOW ) );
+
+	/* Append length code and extra bits */
+	for ( code = ( ( sizeof ( deflate_compress_len_base ) /
+			 sizeof ( deflate_compress_len_base[0] ) ) - 1 ) ;
+	      deflate_compress_len_base[code] > len ; code-- ) {}
+	if ( ( rc = deflate_compress_litlen ( defcom, out,
+					      ( 257 + code ) ) ) != 0 )
+		return rc;
+	if ( ( rc = deflate_compress_bits ( defcom, out,
+			( len - deflate_compress_len_base[code] ),
+			deflate_compress_len_extra[code] ) ) != 0 )
+		return rc;
+
+	/* Append distance code (a fixed five-bit code) and extra bits */
+	for ( code = ( ( sizeof ( deflate_compress_dist_base ) /
+			 sizeof ( deflate_compress_dist_base[0] ) ) - 1 ) ;
+	      deflate_compress_dist_base[code] > dist ; code-- ) {}
+	if ( ( rc = deflate_compress_huf ( defcom, out, code, 5 ) ) != 0 )
+		return rc;
+	if ( ( rc = deflate_compress_bits ( defcom, out,
+			( dist - deflate_compress_dist_base[code] ),
+			deflate_compress_dist_extra[code] ) ) != 0 )
+		return rc;
+
+	return 0;
+}
+
+/**
+ * Append stream and block headers, if not already written
+ *
+ * @v defcom		Compressor
+ * @v out		Compressed output data
+ * @ret rc		Return status code
+ */
+static int deflate_compress_start ( struct deflate_compress *defcom,
+				    struct deflate_chunk *out ) {
+	unsigned int header;
+	int rc;
+
+	/* Do nothing if headers have already been written */
+	if ( defcom->started )
+		return 0;
+
+	/* Append ZLIB header, if applicable.  0x78 indicates the
+	 * DEFLATE compression method with a 32kB window, and 0x01
+	 * makes the header a multiple of 31 with no preset
+	 * dictionary.
+	 */
+	if ( defcom->format == DEFLATE_ZLIB ) {
+		if ( ( rc = deflate_compress_bits ( defcom, out,
+						    0x78, 8 ) ) != 0 )
+			return rc;
+		if ( ( rc = deflate_compress_bits ( defcom, out,
+						    0x01, 8 ) ) != 0 )
+			return rc;
+	}
+
+	/* Append block header for a single final static Huffman block */
+	header = ( ( 1 << DEFLATE_HEADER_BFINAL_BIT ) |
+		   ( DEFLATE_HEADER_BTYPE_STATIC <<
+		     DEFLATE_HEADER_BTYPE_LSB ) );
+	if ( ( rc = deflate_compress_bits ( defcom, out, header,
+					    DEFLATE_HEADER_BITS ) ) != 0 )
+		return rc;
+
+	defcom->started = 1;
+	return 0;
+}
+
+/**
+ * Compress one staging window of data
+ *
+ * @v defcom		Compressor
+ * @v len		Length of data within staging window
+ * @v out		Compressed output data
+ * @ret rc		Return status code
+ */
+static int deflate_compress_window ( struct deflate_compress *defcom,
+				     size_t len, struct deflate_chunk *out ) {
+	const uint8_t *window = defcom->window;
+	const uint8_t *match;
+	size_t offset = 0;
+	size_t match_len;
+	size_t limit;
+	uint32_t seq;
+	unsigned int hash;
+	unsigned int pos;
+	int rc;
+
+	/* Reset hash table, since stored positions refer to the
+	 * previous window contents.
+	 */
+	memset ( defcom->hash, 0, sizeof ( defcom->hash ) );
+
+	while ( offset < len ) {
+
+		/* Look for a match, if enough input remains */
+		if ( ( offset + DEFLATE_MIN_MATCH ) <= len ) {
+
+			/* Hash the next three bytes, and update the
+			 * hash table.  Positions are stored
+			 * one-based, so that zero means "empty".
+			 */
+			seq = ( ( window[ offset + 0 ] << 16 ) |
+				( window[ offset + 1 ] << 8 ) |
+				( window[ offset + 2 ] << 0 ) );
+			hash = ( ( ( uint32_t ) ( seq * 0x9e3779b1 ) ) >>
+				 ( 32 - DEFLATE_COMPRESS_HASH_BITS ) );
+			pos = defcom->hash[hash];
+			defcom->hash[hash] = ( offset + 1 );
+
+			/* Check the single match candidate */
+			if ( pos ) {
+				match = &window[ pos - 1 ];
+				limit = ( len - offset );
+				if ( limit > DEFLATE_MAX_MATCH )
+					limit = DEFLATE_MAX_MATCH;
+				for ( match_len = 0 ; match_len < limit ;
+				      match_len++ ) {
+					if ( match[match_len] !=
+					     window[ offset + match_len ] )
+						break;
+				}
+				if ( match_len >= DEFLATE_MIN_MATCH ) {
+					if ( ( rc = deflate_compress_match (
+						defcom, out, match_len,
+						( offset - ( pos - 1 ) ) ) )
+					     != 0 )
+						return rc;
+					offset += match_len;
+					continue;
+				}
+			}
+		}
+
+		/* No usable match: append a literal */
+		if ( ( rc = deflate_compress_litlen ( defcom, out,
+						      window[offset] ) ) != 0 )
+			return rc;
+		offset++;
+	}
+
+	return 0;
+}
+
+/**
+ * Initialise compressor
+ *
+ * @v defcom		Compressor
+ * @v format		Compression format
+ */
+void deflate_compress_init ( struct deflate_compress *defcom,
+			     enum deflate_format format ) {
+
+	memset ( defcom, 0, sizeof ( *defcom ) );
+	defcom->format = format;
+	defcom->checksum = 1;
+}
+
+/**
+ * Compress data
+ *
+ * @v defcom		Compressor
+ * @v in		Uncompressed input data
+ * @v out		Compressed output data
+ * @ret rc		Return status code
+ *
+ * The compressor does not support suspending and resuming on output
+ * buffer exhaustion: the output chunk must have sufficient space
+ * remaining for the compressed input, as given by
+ * deflate_compress_bound().  May be called repeatedly to compress a
+ * stream of data incrementally.
+ */
+int deflate_compress ( struct deflate_compress *defcom,
+		       struct deflate_chunk *in, struct deflate_chunk *out ) {
+	size_t frag_len;
+	int rc;
+
+	/* Write stream and block headers, if applicable */
+	if ( ( rc = deflate_compress_start ( defcom, out ) ) != 0 )
+		return rc;
+
+	/* Process input one staging window at a time */
+	while ( in->offset < in->len ) {
+
+		/* Copy data into staging window */
+		frag_len = ( in->len - in->offset );
+		if ( frag_len > sizeof ( defcom->window ) )
+			frag_len = sizeof ( defcom->window );
+		copy_from_user ( defcom->window, in->data, in->offset,
+				 frag_len );
+		in->offset += frag_len;
+
+		/* Update checksum, if applicable */
+		if ( defcom->format == DEFLATE_ZLIB )
+			deflate_compress_adler32 ( defcom, defcom->window,
+						   frag_len );
+
+		/* Compress this window of data */
+		if ( ( rc = deflate_compress_window ( defcom, frag_len,
+						      out ) ) != 0 )
+			return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Finish compressing data
+ *
+ * @v defcom		Compressor
+ * @v out		Compressed output data
+ * @ret rc		Return status code
+ *
+ * Terminates the compressed stream and appends the stream footer, if
+ * applicable.  The compressor must be reinitialised before reuse.
+ */
+int deflate_compress_finish ( struct deflate_compress *defcom,
+			      struct deflate_chunk *out ) {
+	uint32_t checksum;
+	unsigned int i;
+	int rc;
+
+	/* Write stream and block headers, if no data was compressed */
+	if ( ( rc = deflate_compress_start ( defcom, out ) ) != 0 )
+		return rc;
+
+	/* Append end of block */
+	if ( ( rc = deflate_compress_litlen ( defcom, out,
+					      DEFLATE_LITLEN_END ) ) != 0 )
+		return rc;
+
+	/* Pad to a byte boundary */
+	if ( defcom->bits ) {
+		if ( ( rc = deflate_compress_bits ( defcom, out, 0,
+					( 8 - defcom->bits ) ) ) != 0 )
+			return rc;
+	}
+	assert ( defcom->bits == 0 );
+
+	/* Append ADLER32 checksum (in network byte order), if applicable */
+	if ( defcom->format == DEFLATE_ZLIB ) {
+		checksum = defcom->checksum;
+		for ( i = 0 ; i < 4 ; i++ ) {
+			if ( ( rc = deflate_compress_bits ( defcom, out,
+					( ( checksum >> 24 ) & 0xff ),
+					8 ) ) != 0 )
+				return rc;
+			checksum <<= 8;
+		}
+	}
+
+	return 0;
+}
@@ -37,6 +37,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/crypto.h>
 #include <ipxe/asn1.h>
 #include <ipxe/sha1.h>
+#include <bits/sha1.h>
 
 /** SHA-1 variables */
 struct sha1_variables {
@@ -120,6 +121,7 @@ static void sha1_init ( void *ctx ) {
 	context->ddd.dd.digest.h[3] = cpu_to_be32 ( 0x10325476 );
 	context->ddd.dd.digest.h[4] = cpu_to_be32 ( 0xc3d2e1f0 );
 	context->len = 0;
+	context->accel = sha1_accel_supported();
 }
 
 /**
@@ -159,6 +161,15 @@ static void sha1_digest ( struct sha1_context *context ) {
 	DBGC_HDA ( context, context->len, &context->ddd.dd.data,
 		   sizeof ( context->ddd.dd.data ) );
 
+	/* Use accelerated implementation, if supported */
+	if ( context->accel ) {
+		sha1_accel_digest ( context );
+		DBGC ( context, "SHA1 digested:\n" );
+		DBGC_HDA ( context, 0, &context->ddd.dd.digest,
+			   sizeof ( context->ddd.dd.digest ) );
+		return;
+	}
+
 	/* Convert h[0..4] to host-endian, and initialise a, b, c, d,
 	 * e, and w[0..15]
 	 */
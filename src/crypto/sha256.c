@@ -37,6 +37,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/crypto.h>
 #include <ipxe/asn1.h>
 #include <ipxe/sha256.h>
+#include <bits/sha256.h>
 
 /** SHA-256 variables */
 struct sha256_variables {
@@ -96,6 +97,7 @@ void sha256_family_init ( struct sha256_context *context,
 
 	context->len = 0;
 	context->digestsize = digestsize;
+	context->accel = sha256_accel_supported();
 	memcpy ( &context->ddd.dd.digest, init,
 		 sizeof ( context->ddd.dd.digest ) );
 }
@@ -157,6 +159,15 @@ static void sha256_digest ( struct sha256_context *context ) {
 	DBGC_HDA ( context, context->len, &context->ddd.dd.data,
 		   sizeof ( context->ddd.dd.data ) );
 
+	/* Use accelerated implementation, if supported */
+	if ( context->accel ) {
+		sha256_accel_digest ( context );
+		DBGC ( context, "SHA256 digested:\n" );
+		DBGC_HDA ( context, 0, &context->ddd.dd.digest,
+			   sizeof ( context->ddd.dd.digest ) );
+		return;
+	}
+
 	/* Convert h[0..7] to host-endian, and initialise a, b, c, d,
 	 * e, f, g, h, and w[0..15]
 	 */
@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2016 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * X25519 key exchange
+ *
+ * The field arithmetic and Montgomery ladder are derived from the
+ * public domain TweetNaCl implementation, using sixteen 64-bit limbs
+ * each holding sixteen bits of the 255-bit field element.  All
+ * operations take constant time, with no secret-dependent branches or
+ * memory accesses.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/x25519.h>
+
+/** An X25519 field element */
+typedef int64_t x25519_t[16];
+
+/** Constant (A-2)/4 = 121665, used by the Montgomery ladder */
+static const x25519_t x25519_121665 = { 0xdb41, 1 };
+
+/**
+ * Propagate carries within field element
+ *
+ * @v value		Field element
+ */
+static void x25519_carry ( x25519_t value ) {
+	int64_t carry;
+	unsigned int i;
+
+	for ( i = 0 ; i < 16 ; i++ ) {
+		value[i] += ( ( ( int64_t ) 1 ) << 16 );
+		carry = ( value[i] >> 16 );
+		value[ ( i + 1 ) * ( i < 15 ) ] +=
+			( carry - 1 + ( 37 * ( carry - 1 ) * ( i == 15 ) ) );
+		value[i] -= ( carry << 16 );
+	}
+}
+
+/**
+ * Conditionally swap field elements, in constant time
+ *
+ * @v first		First field element
+ * @v second		Second field element
+ * @v swap		Swap (must be 0 or 1)
+ */
+static void x25519_cswap ( x25519_t first, x25519_t second, int swap ) {
+	int64_t mask = ~( ( ( int64_t ) swap ) - 1 );
+	int64_t xor;
+	unsigned int i;
+
+	for ( i = 0 ; i < 16 ; i++ ) {
+		xor = ( mask & ( first[i] ^ second[i] ) );
+		first[i] ^= xor;
+		second[i] ^= xor;
+	}
+}
+
+/**
+ * Convert field element to canonical little-endian form
+ *
+ * @v out		Output value
+ * @v value		Field element
+ */
+static void x25519_pack ( uint8_t *out, const x25519_t value ) {
+	x25519_t temp;
+	x25519_t minus_p;
+	int borrow;
+	unsigned int i;
+	unsigned int j;
+
+	memcpy ( temp, value, sizeof ( temp ) );
+	x25519_carry ( temp );
+	x25519_carry ( temp );
+	x25519_carry ( temp );
+	for ( j = 0 ; j < 2 ; j++ ) {
+		minus_p[0] = ( temp[0] - 0xffed );
+		for ( i = 1 ; i < 15 ; i++ ) {
+			minus_p[i] = ( temp[i] - 0xffff -
+				       ( ( minus_p[ i - 1 ] >> 16 ) & 1 ) );
+			minus_p[ i - 1 ] &= 0xffff;
+		}
+		minus_p[15] = ( temp[15] - 0x7fff -
+				( ( minus_p[14] >> 16 ) & 1 ) );
+		borrow = ( ( minus_p[15] >> 16 ) & 1 );
+		minus_p[14] &= 0xffff;
+		x25519_cswap ( temp, minus_p, ( 1 - borrow ) );
+	}
+	for ( i = 0 ; i < 16 ; i++ ) {
+		out[ 2 * i ] = ( temp[i] & 0xff );
+		out[ 2 * i + 1 ] = ( temp[i] >> 8 );
+	}
+}
+
+/**
+ * Convert little-endian value to field element
+ *
+ * @v value		Field element to fill in
+ * @v in		Input value
+ */
+static void x25519_unpack ( x25519_t value, const uint8_t *in ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < 16 ; i++ ) {
+		value[i] = ( in[ 2 * i ] +
+			     ( ( ( int64_t ) in[ 2 * i + 1 ] ) << 8 ) );
+	}
+	value[15] &= 0x7fff;
+}
+
+/**
+ * Add field elements
+ *
+ * @v result		Result
+ * @v augend		Augend
+ * @v addend		Addend
+ */
+static void x25519_add ( x25519_t result, const x25519_t augend,
+			 const x25519_t addend ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < 16 ; i++ )
+		result[i] = ( augend[i] + addend[i] );
+}
+
+/**
+ * Subtract field elements
+ *
+ * @v result		Result
+ * @v minuend		Minuend
+ * @v subtrahend	Subtrahend
+ */
+static void x25519_subtract ( x25519_t result, const x25519_t minuend,
+			      const x25519_t subtrahend ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < 16 ; i++ )
+		result[i] = ( minuend[i] - subtrahend[i] );
+}
+
+/**
+ * Multiply field elements
+ *
+ * @v result		Result
+ * @v multiplicand	Multiplicand
+ * @v multiplier	Multiplier
+ */
+static void x25519_multiply ( x25519_t result, const x25519_t multiplicand,
+			      const x25519_t multiplier ) {
+	int64_t product[31];
+	unsigned int i;
+	unsigned int j;
+
+	memset ( product, 0, sizeof ( product ) );
+	for ( i = 0 ; i < 16 ; i++ ) {
+		for ( j = 0 ; j < 16 ; j++ )
+			product[ i + j ] += ( multiplicand[i] * multiplier[j] );
+	}
+	for ( i = 0 ; i < 15 ; i++ )
+		product[i] += ( 38 * product[ i + 16 ] );
+	memcpy ( result, product, sizeof ( x25519_t ) );
+	x25519_carry ( result );
+	x25519_carry ( result );
+}
+
+/**
+ * Square field element
+ *
+ * @v result		Result
+ * @v value		Value to square
+ */
+static void x25519_square ( x25519_t result, const x25519_t value ) {
+	x25519_multiply ( result, value, value );
+}
+
+/**
+ * Invert field element
+ *
+ * @v result		Result
+ * @v value		Value to invert
+ */
+static void x25519_invert ( x25519_t result, const x25519_t value ) {
+	x25519_t running;
+	int i;
+
+	/* Raise to the power of (p-2), per Fermat's little theorem */
+	memcpy ( running, value, sizeof ( running ) );
+	for ( i = 253 ; i >= 0 ; i-- ) {
+		x25519_square ( running, running );
+		if ( ( i != 2 ) && ( i != 4 ) )
+			x25519_multiply ( running, running, value );
+	}
+	memcpy ( result, running, sizeof ( x25519_t ) );
+}
+
+/**
+ * Multiply scalar by curve point
+ *
+ * @v result		Result point to fill in
+ * @v scalar		Scalar multiple
+ * @v point		Curve point
+ */
+static void x25519_ladder ( uint8_t *result, const uint8_t *scalar,
+			    const uint8_t *point ) {
+	uint8_t clamped[X25519_KEY_SIZE];
+	x25519_t x;
+	x25519_t a;
+	x25519_t b;
+	x25519_t c;
+	x25519_t d;
+	x25519_t e;
+	x25519_t f;
+	unsigned int i;
+	int bit;
+
+	/* Clamp scalar as specified by RFC 7748 */
+	memcpy ( clamped, scalar, sizeof ( clamped ) );
+	clamped[0] &= 0xf8;
+	clamped[31] &= 0x7f;
+	clamped[31] |= 0x40;
+
+	/* Perform Montgomery ladder */
+	x25519_unpack ( x, point );
+	memset ( a, 0, sizeof ( a ) );
+	memset ( c, 0, sizeof ( c ) );
+	memset ( d, 0, sizeof ( d ) );
+	memcpy ( b, x, sizeof ( b ) );
+	a[0] = 1;
+	d[0] = 1;
+	for ( i = 255 ; i-- ; ) {
+		bit = ( ( clamped[ i >> 3 ] >> ( i & 7 ) ) & 1 );
+		x25519_cswap ( a, b, bit );
+		x25519_cswap ( c, d, bit );
+		x25519_add ( e, a, c );
+		x25519_subtract ( a, a, c );
+		x25519_add ( c, b, d );
+		x25519_subtract ( b, b, d );
+		x25519_square ( d, e );
+		x25519_square ( f, a );
+		x25519_multiply ( a, c, a );
+		x25519_multiply ( c, b, e );
+		x25519_add ( e, a, c );
+		x25519_subtract ( a, a, c );
+		x25519_square ( b, a );
+		x25519_subtract ( c, d, f );
+		x25519_multiply ( a, c, x25519_121665 );
+		x25519_add ( a, a, d );
+		x25519_multiply ( c, c, a );
+		x25519_multiply ( a, d, f );
+		x25519_multiply ( d, b, x );
+		x25519_square ( b, e );
+		x25519_cswap ( a, b, bit );
+		x25519_cswap ( c, d, bit );
+	}
+
+	/* Convert from projective coordinates */
+	x25519_invert ( c, c );
+	x25519_multiply ( a, a, c );
+	x25519_pack ( result, a );
+}
+
+/**
+ * Multiply scalar by curve point
+ *
+ * @v base		Base point (or NULL to use generator)
+ * @v scalar		Scalar multiple
+ * @v result		Result point to fill in
+ * @ret rc		Return status code
+ */
+static int x25519_curve_multiply ( const void *base, const void *scalar,
+				   void *result ) {
+	static const uint8_t generator[X25519_KEY_SIZE] = { 9 };
+	static const uint8_t zeroes[X25519_KEY_SIZE];
+
+	/* Multiply scalar by point */
+	x25519_ladder ( result, scalar, ( base ? base : generator ) );
+
+	/* Fail if result is all zeros (indicating a small-order
+	 * input point), as specified by RFC 7748.
+	 */
+	if ( memcmp ( result, zeroes, sizeof ( zeroes ) ) == 0 )
+		return -EPERM;
+
+	return 0;
+}
+
+/** X25519 elliptic curve */
+struct elliptic_curve x25519_curve = {
+	.name = "x25519",
+	.keysize = X25519_KEY_SIZE,
+	.multiply = x25519_curve_multiply,
+};
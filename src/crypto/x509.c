@@ -1307,8 +1307,8 @@ int x509_check_time ( struct x509_certificate *cert, time_t time ) {
  * The issuing certificate must have already been validated.
  *
  * Validation results are cached: if a certificate has already been
- * successfully validated then @c issuer, @c time, and @c root will be
- * ignored.
+ * successfully validated (and remains within its validity period at
+ * the specified time) then @c issuer and @c root will be ignored.
  */
 int x509_validate ( struct x509_certificate *cert,
 		    struct x509_certificate *issuer,
@@ -1320,9 +1320,16 @@ int x509_validate ( struct x509_certificate *cert,
 	if ( ! root )
 		root = &root_certificates;
 
-	/* Return success if certificate has already been validated */
-	if ( x509_is_valid ( cert ) )
-		return 0;
+	/* Return success if certificate has already been validated
+	 * and has not since left its validity period.  Expiry of a
+	 * previously validated certificate invalidates the cached
+	 * result and forces a full revalidation.
+	 */
+	if ( x509_is_valid ( cert ) ) {
+		if ( x509_check_time ( cert, time ) == 0 )
+			return 0;
+		cert->flags &= ~X509_FL_VALIDATED;
+	}
 
 	/* Fail if certificate is invalid at specified time */
 	if ( ( rc = x509_check_time ( cert, time ) ) != 0 )
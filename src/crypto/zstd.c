@@ -0,0 +1,1328 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <assert.h>
+#include <ipxe/zstd.h>
+
+/** @file
+ *
+ * Zstandard decompression (RFC 8878)
+ *
+ * This is a self-contained decoder for the Zstandard compressed data
+ * format.  Dictionaries are not supported, and content checksums are
+ * skipped rather than verified (we have no other use for XXH64, and
+ * downloaded images are integrity-protected at a higher level where
+ * it matters).
+ */
+
+/** Maximum accuracy log for literal lengths table */
+#define ZSTD_LL_MAX_LOG 9
+
+/** Maximum accuracy log for offsets table */
+#define ZSTD_OF_MAX_LOG 8
+
+/** Maximum accuracy log for match lengths table */
+#define ZSTD_ML_MAX_LOG 9
+
+/** Maximum accuracy log for Huffman weights table */
+#define ZSTD_WT_MAX_LOG 6
+
+/** Maximum literal length symbol */
+#define ZSTD_LL_MAX_SYMBOL 35
+
+/** Maximum offset symbol */
+#define ZSTD_OF_MAX_SYMBOL 31
+
+/** Maximum match length symbol */
+#define ZSTD_ML_MAX_SYMBOL 52
+
+/** A baseline and supplementary bit count */
+struct zstd_baseline {
+	/** Baseline value */
+	uint32_t base;
+	/** Number of supplementary bits */
+	uint8_t bits;
+};
+
+/** Literal length code baselines and bit counts */
+static const struct zstd_baseline zstd_ll_codes[ZSTD_LL_MAX_SYMBOL + 1] = {
+	{ 0, 0 }, { 1, 0 }, { 2, 0 }, { 3, 0 },
+	{ 4, 0 }, { 5, 0 }, { 6, 0 }, { 7, 0 },
+	{ 8, 0 }, { 9, 0 }, { 10, 0 }, { 11, 0 },
+	{ 12, 0 }, { 13, 0 }, { 14, 0 }, { 15, 0 },
+	{ 16, 1 }, { 18, 1 }, { 20, 1 }, { 22, 1 },
+	{ 24, 2 }, { 28, 2 }, { 32, 3 }, { 40, 3 },
+	{ 48, 4 }, { 64, 6 }, { 128, 7 }, { 256, 8 },
+	{ 512, 9 }, { 1024, 10 }, { 2048, 11 }, { 4096, 12 },
+	{ 8192, 13 }, { 16384, 14 }, { 32768, 15 }, { 65536, 16 },
+};
+
+/** Match length code baselines and bit counts */
+static const struct zstd_baseline zstd_ml_codes[ZSTD_ML_MAX_SYMBOL + 1] = {
+	{ 3, 0 }, { 4, 0 }, { 5, 0 }, { 6, 0 },
+	{ 7, 0 }, { 8, 0 }, { 9, 0 }, { 10, 0 },
+	{ 11, 0 }, { 12, 0 }, { 13, 0 }, { 14, 0 },
+	{ 15, 0 }, { 16, 0 }, { 17, 0 }, { 18, 0 },
+	{ 19, 0 }, { 20, 0 }, { 21, 0 }, { 22, 0 },
+	{ 23, 0 }, { 24, 0 }, { 25, 0 }, { 26, 0 },
+	{ 27, 0 }, { 28, 0 }, { 29, 0 }, { 30, 0 },
+	{ 31, 0 }, { 32, 0 }, { 33, 0 }, { 34, 0 },
+	{ 35, 1 }, { 37, 1 }, { 39, 1 }, { 41, 1 },
+	{ 43, 2 }, { 47, 2 }, { 51, 3 }, { 59, 3 },
+	{ 67, 4 }, { 83, 4 }, { 99, 5 }, { 131, 7 },
+	{ 259, 8 }, { 515, 9 }, { 1027, 10 }, { 2051, 11 },
+	{ 4099, 12 }, { 8195, 13 }, { 16387, 14 }, { 32771, 15 },
+	{ 65539, 16 },
+};
+
+/** Predefined literal lengths distribution (accuracy log 6) */
+static const int16_t zstd_ll_default[ZSTD_LL_MAX_SYMBOL + 1] = {
+	4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+	-1, -1, -1, -1,
+};
+
+/** Predefined match lengths distribution (accuracy log 6) */
+static const int16_t zstd_ml_default[ZSTD_ML_MAX_SYMBOL + 1] = {
+	1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+	-1, -1, -1, -1, -1,
+};
+
+/** Predefined offsets distribution (accuracy log 5) */
+static const int16_t zstd_of_default[29] = {
+	1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1,
+};
+
+/** An output buffer */
+struct zstd_output {
+	/** Output data */
+	uint8_t *data;
+	/** Maximum length */
+	size_t max;
+	/** Current length */
+	size_t len;
+	/** Offset of start of current frame */
+	size_t frame;
+};
+
+/** A reversed (read-backwards) bitstream */
+struct zstd_rbits {
+	/** Data */
+	const uint8_t *data;
+	/** Current bit position (number of unread bits) */
+	long pos;
+};
+
+/** A forward (read-forwards) bitstream */
+struct zstd_fbits {
+	/** Data */
+	const uint8_t *data;
+	/** Total number of bits */
+	size_t len;
+	/** Current bit position */
+	size_t pos;
+};
+
+/**
+ * Find highest set bit
+ *
+ * @v value		Value (must be non-zero)
+ * @ret msb		Highest set bit (0-based)
+ */
+static inline unsigned int zstd_highbit ( unsigned long value ) {
+	return ( fls ( value ) - 1 );
+}
+
+/**
+ * Read little-endian value from byte stream
+ *
+ * @v data		Data
+ * @v len		Number of bytes (up to 8)
+ * @ret value		Value
+ */
+static uint64_t zstd_le ( const uint8_t *data, unsigned int len ) {
+	uint64_t value = 0;
+	unsigned int i;
+
+	for ( i = 0 ; i < len ; i++ )
+		value |= ( ( ( uint64_t ) data[i] ) << ( i * 8 ) );
+	return value;
+}
+
+/**
+ * Initialise reversed bitstream
+ *
+ * @v bits		Reversed bitstream
+ * @v data		Data
+ * @v len		Length of data
+ * @ret rc		Return status code
+ *
+ * The last byte of the stream must contain a set sentinel bit marking
+ * the end of the meaningful bits.
+ */
+static int zstd_rbits_init ( struct zstd_rbits *bits, const uint8_t *data,
+			     size_t len ) {
+	uint8_t last;
+
+	if ( ! len )
+		return -EINVAL;
+	last = data[ len - 1 ];
+	if ( ! last )
+		return -EINVAL;
+	bits->data = data;
+	bits->pos = ( ( ( len - 1 ) * 8 ) + zstd_highbit ( last ) );
+	return 0;
+}
+
+/**
+ * Read bits from reversed bitstream
+ *
+ * @v bits		Reversed bitstream
+ * @v count		Number of bits to read
+ * @ret value		Value
+ *
+ * Reading beyond the start of the stream pads with zero bits, as
+ * required for the final Huffman decode states.  Corrupt streams
+ * which overread are caught by the output length checks.
+ */
+static unsigned long zstd_rbits_pull ( struct zstd_rbits *bits,
+				       unsigned int count ) {
+	uint64_t raw;
+	const uint8_t *byte;
+	unsigned int shift;
+	unsigned int need;
+	unsigned int pad = 0;
+	long pos;
+
+	if ( ! count )
+		return 0;
+	pos = ( bits->pos - ( ( long ) count ) );
+	if ( pos < 0 ) {
+		pad = -pos;
+		count -= pad;
+		pos = 0;
+	}
+	bits->pos = pos;
+	byte = &bits->data[ pos >> 3 ];
+	shift = ( pos & 7 );
+	need = ( shift + count );
+	raw = zstd_le ( byte, ( ( need + 7 ) / 8 ) );
+	return ( ( ( raw >> shift ) & ( ( 1ULL << count ) - 1 ) ) << pad );
+}
+
+/**
+ * Peek bits from reversed bitstream without consuming them
+ *
+ * @v bits		Reversed bitstream
+ * @v count		Number of bits to peek
+ * @ret value		Value
+ */
+static unsigned long zstd_rbits_peek ( struct zstd_rbits *bits,
+				       unsigned int count ) {
+	struct zstd_rbits tmp;
+
+	memcpy ( &tmp, bits, sizeof ( tmp ) );
+	return zstd_rbits_pull ( &tmp, count );
+}
+
+/**
+ * Read bits from forward bitstream
+ *
+ * @v bits		Forward bitstream
+ * @v count		Number of bits to read
+ * @v value		Value to fill in
+ * @ret rc		Return status code
+ */
+static int zstd_fbits_pull ( struct zstd_fbits *bits, unsigned int count,
+			     unsigned int *value ) {
+	uint64_t raw;
+	const uint8_t *byte;
+	unsigned int shift;
+	unsigned int need;
+
+	if ( ( bits->pos + count ) > bits->len )
+		return -EINVAL;
+	byte = &bits->data[ bits->pos >> 3 ];
+	shift = ( bits->pos & 7 );
+	need = ( shift + count );
+	raw = zstd_le ( byte, ( ( need + 7 ) / 8 ) );
+	*value = ( ( raw >> shift ) & ( ( 1ULL << count ) - 1 ) );
+	bits->pos += count;
+	return 0;
+}
+
+/**
+ * Read FSE normalised counts and construct decoding table
+ *
+ * @v fse		FSE decoding table to fill in
+ * @v norm		Normalised counts
+ * @v max_symbol	Maximum symbol value (inclusive)
+ * @v log		Accuracy log
+ * @ret rc		Return status code
+ */
+static int zstd_fse_table ( struct zstd_fse *fse, const int16_t *norm,
+			    unsigned int max_symbol, unsigned int log ) {
+	struct zstd_fse_entry *entry;
+	uint16_t next[ZSTD_ML_MAX_SYMBOL + 1];
+	unsigned int size = ( 1 << log );
+	unsigned int high = ( size - 1 );
+	unsigned int step = ( ( size >> 1 ) + ( size >> 3 ) + 3 );
+	unsigned int mask = ( size - 1 );
+	unsigned int pos = 0;
+	unsigned int state;
+	unsigned int symbol;
+	int count;
+	int i;
+
+	/* Sanity checks */
+	if ( ( log > ZSTD_FSE_MAX_LOG ) ||
+	     ( max_symbol >= ( sizeof ( next ) / sizeof ( next[0] ) ) ) )
+		return -EINVAL;
+
+	/* Place "less than one" probability symbols at the table end */
+	for ( symbol = 0 ; symbol <= max_symbol ; symbol++ ) {
+		count = norm[symbol];
+		if ( count == -1 ) {
+			fse->entry[high--].symbol = symbol;
+			next[symbol] = 1;
+		} else {
+			next[symbol] = count;
+		}
+	}
+
+	/* Spread remaining symbols across the table */
+	for ( symbol = 0 ; symbol <= max_symbol ; symbol++ ) {
+		for ( i = 0 ; i < norm[symbol] ; i++ ) {
+			fse->entry[pos].symbol = symbol;
+			do {
+				pos = ( ( pos + step ) & mask );
+			} while ( pos > high );
+		}
+	}
+	if ( pos != 0 )
+		return -EINVAL;
+
+	/* Calculate state transitions */
+	for ( state = 0 ; state < size ; state++ ) {
+		entry = &fse->entry[state];
+		symbol = entry->symbol;
+		entry->bits = ( log - zstd_highbit ( next[symbol] ) );
+		entry->base = ( ( next[symbol] << entry->bits ) - size );
+		next[symbol]++;
+	}
+	fse->log = log;
+	fse->valid = 1;
+
+	return 0;
+}
+
+/**
+ * Construct single-symbol (RLE) FSE decoding table
+ *
+ * @v fse		FSE decoding table to fill in
+ * @v symbol		Symbol
+ */
+static void zstd_fse_rle ( struct zstd_fse *fse, unsigned int symbol ) {
+
+	fse->entry[0].symbol = symbol;
+	fse->entry[0].base = 0;
+	fse->entry[0].bits = 0;
+	fse->log = 0;
+	fse->valid = 1;
+}
+
+/**
+ * Read FSE table description and construct decoding table
+ *
+ * @v fse		FSE decoding table to fill in
+ * @v bits		Forward bitstream positioned at the description
+ * @v max_symbol	Maximum symbol value (inclusive)
+ * @v max_log		Maximum permitted accuracy log
+ * @ret rc		Return status code
+ */
+static int zstd_fse_read ( struct zstd_fse *fse, struct zstd_fbits *bits,
+			   unsigned int max_symbol, unsigned int max_log ) {
+	int16_t norm[ZSTD_ML_MAX_SYMBOL + 1];
+	unsigned int log;
+	unsigned int symbol = 0;
+	unsigned int value;
+	unsigned int nbits;
+	unsigned int lower_mask;
+	unsigned int threshold;
+	unsigned int repeat;
+	unsigned int i;
+	int remaining;
+	int proba;
+	int rc;
+
+	/* Sanity check */
+	if ( max_symbol >= ( sizeof ( norm ) / sizeof ( norm[0] ) ) )
+		return -EINVAL;
+
+	/* Read accuracy log */
+	if ( ( rc = zstd_fbits_pull ( bits, 4, &value ) ) != 0 )
+		return rc;
+	log = ( value + 5 );
+	if ( log > max_log )
+		return -EINVAL;
+
+	/* Read normalised counts */
+	memset ( norm, 0, sizeof ( norm ) );
+	remaining = ( 1 << log );
+	while ( ( remaining > 0 ) && ( symbol <= max_symbol ) ) {
+		nbits = ( zstd_highbit ( remaining + 1 ) + 1 );
+		if ( ( rc = zstd_fbits_pull ( bits, nbits, &value ) ) != 0 )
+			return rc;
+		lower_mask = ( ( 1 << ( nbits - 1 ) ) - 1 );
+		threshold = ( ( 1 << nbits ) - 1 - ( remaining + 1 ) );
+		if ( ( value & lower_mask ) < threshold ) {
+			bits->pos--;
+			value &= lower_mask;
+		} else if ( value > lower_mask ) {
+			value -= threshold;
+		}
+		proba = ( ( ( int ) value ) - 1 );
+		norm[symbol++] = proba;
+		remaining -= ( ( proba < 0 ) ? -proba : proba );
+
+		/* A zero probability is followed by 2-bit repeat counts */
+		if ( proba == 0 ) {
+			do {
+				if ( ( rc = zstd_fbits_pull ( bits, 2,
+							      &repeat ) ) != 0 )
+					return rc;
+				for ( i = 0 ; ( ( i < repeat ) &&
+						( symbol <= max_symbol ) );
+				      i++ ) {
+					norm[symbol++] = 0;
+				}
+			} while ( repeat == 3 );
+		}
+	}
+	if ( remaining != 0 )
+		return -EINVAL;
+
+	/* Table descriptions are byte-aligned at the end */
+	bits->pos = ( ( bits->pos + 7 ) & ~7UL );
+
+	return zstd_fse_table ( fse, norm, max_symbol, log );
+}
+
+/**
+ * Construct Huffman decoding table from weights
+ *
+ * @v huf		Huffman decoding table to fill in
+ * @v weights		Weights (with space for one additional implied weight)
+ * @v num		Number of explicit weights
+ * @ret rc		Return status code
+ */
+static int zstd_huf_table ( struct zstd_huf *huf, uint8_t *weights,
+			    unsigned int num ) {
+	unsigned int total = 0;
+	unsigned int log;
+	unsigned int rest;
+	unsigned int weight;
+	unsigned int max_weight;
+	unsigned int cells;
+	unsigned int pos = 0;
+	unsigned int symbol;
+	unsigned int i;
+
+	/* Calculate table log from the sum of weights */
+	for ( symbol = 0 ; symbol < num ; symbol++ ) {
+		weight = weights[symbol];
+		if ( weight > ZSTD_HUF_MAX_LOG )
+			return -EINVAL;
+		if ( weight )
+			total += ( 1 << ( weight - 1 ) );
+	}
+	if ( ! total )
+		return -EINVAL;
+	log = ( zstd_highbit ( total ) + 1 );
+	if ( log > ZSTD_HUF_MAX_LOG )
+		return -EINVAL;
+
+	/* The last symbol's weight is implied: it completes the table
+	 * to an exact power of two.
+	 */
+	rest = ( ( 1 << log ) - total );
+	if ( ( ! rest ) || ( rest & ( rest - 1 ) ) )
+		return -EINVAL;
+	weights[num++] = ( zstd_highbit ( rest ) + 1 );
+
+	/* Fill table in ascending weight order, with symbols in
+	 * natural order within each weight (the canonical Huffman
+	 * code assignment).
+	 */
+	max_weight = log;
+	for ( weight = 1 ; weight <= max_weight ; weight++ ) {
+		for ( symbol = 0 ; symbol < num ; symbol++ ) {
+			if ( weights[symbol] != weight )
+				continue;
+			cells = ( 1 << ( weight - 1 ) );
+			for ( i = 0 ; i < cells ; i++ ) {
+				huf->entry[pos].symbol = symbol;
+				huf->entry[pos].bits = ( log + 1 - weight );
+				pos++;
+			}
+		}
+	}
+	if ( pos != ( 1U << log ) )
+		return -EINVAL;
+	huf->log = log;
+
+	return 0;
+}
+
+/**
+ * Read Huffman tree description and construct decoding table
+ *
+ * @v zstd		Decompressor workspace
+ * @v data		Tree description
+ * @v len		Maximum length of tree description
+ * @v used		Length of tree description to fill in
+ * @ret rc		Return status code
+ */
+static int zstd_huf_read ( struct zstd *zstd, const uint8_t *data, size_t len,
+			   size_t *used ) {
+	uint8_t weights[256];
+	struct zstd_rbits rbits;
+	struct zstd_fbits fbits;
+	struct zstd_fse_entry *entry;
+	unsigned int header;
+	unsigned int num;
+	unsigned int csize;
+	unsigned int state1;
+	unsigned int state2;
+	unsigned int tmp;
+	unsigned int i;
+	size_t fse_len;
+	int rc;
+
+	/* Parse header byte */
+	if ( ! len )
+		return -EINVAL;
+	header = data[0];
+	data++;
+	len--;
+
+	if ( header >= 128 ) {
+
+		/* Direct representation: 4 bits per weight */
+		num = ( header - 127 );
+		if ( ( ( num + 1 ) / 2 ) > len )
+			return -EINVAL;
+		for ( i = 0 ; i < num ; i++ ) {
+			weights[i] = ( ( i & 1 ) ? ( data[ i / 2 ] & 0x0f ) :
+				       ( data[ i / 2 ] >> 4 ) );
+		}
+		*used = ( 1 + ( ( num + 1 ) / 2 ) );
+
+	} else {
+
+		/* FSE-compressed weights */
+		csize = header;
+		if ( csize > len )
+			return -EINVAL;
+
+		/* Read the weights FSE table description */
+		fbits.data = data;
+		fbits.len = ( csize * 8 );
+		fbits.pos = 0;
+		if ( ( rc = zstd_fse_read ( &zstd->wt, &fbits, 15,
+					    ZSTD_WT_MAX_LOG ) ) != 0 )
+			return rc;
+		fse_len = ( fbits.pos / 8 );
+
+		/* Decode weights using two interleaved FSE states */
+		if ( ( rc = zstd_rbits_init ( &rbits, ( data + fse_len ),
+					      ( csize - fse_len ) ) ) != 0 )
+			return rc;
+		state1 = zstd_rbits_pull ( &rbits, zstd->wt.log );
+		state2 = zstd_rbits_pull ( &rbits, zstd->wt.log );
+		num = 0;
+		while ( 1 ) {
+			entry = &zstd->wt.entry[state1];
+			if ( num >= ( sizeof ( weights ) - 1 ) )
+				return -EINVAL;
+			weights[num++] = entry->symbol;
+			if ( rbits.pos < entry->bits ) {
+				/* Bitstream exhausted: the final
+				 * weight comes from the other state.
+				 */
+				if ( num >= ( sizeof ( weights ) - 1 ) )
+					return -EINVAL;
+				weights[num++] =
+					zstd->wt.entry[state2].symbol;
+				break;
+			}
+			state1 = ( entry->base +
+				   zstd_rbits_pull ( &rbits, entry->bits ) );
+			tmp = state1;
+			state1 = state2;
+			state2 = tmp;
+		}
+		*used = ( 1 + csize );
+	}
+
+	return zstd_huf_table ( &zstd->huf, weights, num );
+}
+
+/**
+ * Decode one Huffman-compressed literals stream
+ *
+ * @v zstd		Decompressor workspace
+ * @v out		Output buffer
+ * @v out_len		Number of literals to decode
+ * @v data		Compressed stream
+ * @v len		Length of compressed stream
+ * @ret rc		Return status code
+ */
+static int zstd_huf_stream ( struct zstd *zstd, uint8_t *out, size_t out_len,
+			     const uint8_t *data, size_t len ) {
+	struct zstd_huf_entry *entry;
+	struct zstd_rbits bits;
+	size_t i;
+	int rc;
+
+	if ( ( rc = zstd_rbits_init ( &bits, data, len ) ) != 0 )
+		return rc;
+	for ( i = 0 ; i < out_len ; i++ ) {
+		entry = &zstd->huf.entry[ zstd_rbits_peek ( &bits,
+							    zstd->huf.log ) ];
+		out[i] = entry->symbol;
+		zstd_rbits_pull ( &bits, entry->bits );
+	}
+	return 0;
+}
+
+/**
+ * Decode literals section of a compressed block
+ *
+ * @v zstd		Decompressor workspace
+ * @v data		Literals section
+ * @v len		Maximum length of literals section
+ * @v lit_len		Number of regenerated literals to fill in
+ * @v used		Length of literals section to fill in
+ * @ret rc		Return status code
+ */
+static int zstd_literals ( struct zstd *zstd, const uint8_t *data, size_t len,
+			   size_t *lit_len, size_t *used ) {
+	uint64_t header;
+	unsigned int type;
+	unsigned int format;
+	unsigned int streams;
+	size_t hdr_len;
+	size_t regen;
+	size_t comp;
+	size_t tree_len = 0;
+	size_t stream_len[4];
+	size_t stream_regen;
+	size_t last_regen;
+	unsigned int i;
+	int rc;
+
+	/* Parse section header */
+	if ( ! len )
+		return -EINVAL;
+	header = zstd_le ( data, ( ( len < 5 ) ? len : 5 ) );
+	type = ( header & 0x3 );
+	format = ( ( header >> 2 ) & 0x3 );
+	if ( type <= 1 ) {
+
+		/* Raw or RLE literals */
+		switch ( format ) {
+		case 0:
+		case 2:
+			hdr_len = 1;
+			regen = ( ( header >> 3 ) & 0x1f );
+			break;
+		case 1:
+			hdr_len = 2;
+			regen = ( ( header >> 4 ) & 0xfff );
+			break;
+		default:
+			hdr_len = 3;
+			regen = ( ( header >> 4 ) & 0xfffff );
+			break;
+		}
+		if ( regen > ZSTD_MAX_LITERALS )
+			return -EINVAL;
+		if ( type == 0 ) {
+			/* Raw literals */
+			if ( ( hdr_len + regen ) > len )
+				return -EINVAL;
+			memcpy ( zstd->literals, ( data + hdr_len ), regen );
+			*used = ( hdr_len + regen );
+		} else {
+			/* RLE literals */
+			if ( ( hdr_len + 1 ) > len )
+				return -EINVAL;
+			memset ( zstd->literals, data[hdr_len], regen );
+			*used = ( hdr_len + 1 );
+		}
+		*lit_len = regen;
+		return 0;
+	}
+
+	/* Huffman-compressed literals (with new or repeated tree) */
+	switch ( format ) {
+	case 0:
+		hdr_len = 3;
+		streams = 1;
+		regen = ( ( header >> 4 ) & 0x3ff );
+		comp = ( ( header >> 14 ) & 0x3ff );
+		break;
+	case 1:
+		hdr_len = 3;
+		streams = 4;
+		regen = ( ( header >> 4 ) & 0x3ff );
+		comp = ( ( header >> 14 ) & 0x3ff );
+		break;
+	case 2:
+		hdr_len = 4;
+		streams = 4;
+		regen = ( ( header >> 4 ) & 0x3fff );
+		comp = ( ( header >> 18 ) & 0x3fff );
+		break;
+	default:
+		hdr_len = 5;
+		streams = 4;
+		regen = ( ( header >> 4 ) & 0x3ffff );
+		comp = ( ( header >> 22 ) & 0x3ffff );
+		break;
+	}
+	if ( ( regen > ZSTD_MAX_LITERALS ) || ( ( hdr_len + comp ) > len ) )
+		return -EINVAL;
+	data += hdr_len;
+
+	/* Read Huffman tree description, if present */
+	if ( type == 2 ) {
+		if ( ( rc = zstd_huf_read ( zstd, data, comp,
+					    &tree_len ) ) != 0 )
+			return rc;
+		data += tree_len;
+		comp -= tree_len;
+	} else if ( ! zstd->huf.log ) {
+		/* Treeless literals with no previous tree */
+		return -EINVAL;
+	}
+
+	/* Decode streams */
+	if ( streams == 1 ) {
+		if ( ( rc = zstd_huf_stream ( zstd, zstd->literals, regen,
+					      data, comp ) ) != 0 )
+			return rc;
+	} else {
+		/* Four streams, preceded by a jump table of three
+		 * little-endian 16-bit stream lengths.
+		 */
+		if ( comp < 6 )
+			return -EINVAL;
+		stream_len[0] = zstd_le ( ( data + 0 ), 2 );
+		stream_len[1] = zstd_le ( ( data + 2 ), 2 );
+		stream_len[2] = zstd_le ( ( data + 4 ), 2 );
+		if ( ( 6 + stream_len[0] + stream_len[1] + stream_len[2] )
+		     > comp )
+			return -EINVAL;
+		stream_len[3] = ( comp - 6 - stream_len[0] - stream_len[1] -
+				  stream_len[2] );
+		data += 6;
+		stream_regen = ( ( regen + 3 ) / 4 );
+		if ( ( 3 * stream_regen ) > regen )
+			return -EINVAL;
+		last_regen = ( regen - ( 3 * stream_regen ) );
+		for ( i = 0 ; i < 4 ; i++ ) {
+			if ( ( rc = zstd_huf_stream ( zstd,
+					( zstd->literals +
+					  ( i * stream_regen ) ),
+					( ( i == 3 ) ? last_regen :
+					  stream_regen ),
+					data, stream_len[i] ) ) != 0 )
+				return rc;
+			data += stream_len[i];
+		}
+	}
+
+	*lit_len = regen;
+	*used = ( hdr_len + tree_len + comp );
+	return 0;
+}
+
+/**
+ * Prepare one sequence decoding table according to its compression mode
+ *
+ * @v fse		FSE decoding table
+ * @v mode		Compression mode
+ * @v norm_default	Predefined distribution
+ * @v max_default	Maximum symbol in predefined distribution (inclusive)
+ * @v log_default	Predefined accuracy log
+ * @v max_symbol	Maximum symbol value (inclusive)
+ * @v max_log		Maximum permitted accuracy log
+ * @v data		Remaining input data
+ * @v len		Length of remaining input data
+ * @v used		Consumed length to fill in
+ * @ret rc		Return status code
+ */
+static int zstd_seq_table ( struct zstd_fse *fse, unsigned int mode,
+			    const int16_t *norm_default,
+			    unsigned int max_default,
+			    unsigned int log_default,
+			    unsigned int max_symbol, unsigned int max_log,
+			    const uint8_t *data, size_t len, size_t *used ) {
+	struct zstd_fbits fbits;
+	int rc;
+
+	*used = 0;
+	switch ( mode ) {
+	case 0:
+		/* Predefined distribution */
+		return zstd_fse_table ( fse, norm_default, max_default,
+					log_default );
+	case 1:
+		/* RLE: a single one-byte symbol */
+		if ( ! len )
+			return -EINVAL;
+		if ( data[0] > max_symbol )
+			return -EINVAL;
+		zstd_fse_rle ( fse, data[0] );
+		*used = 1;
+		return 0;
+	case 2:
+		/* FSE-compressed distribution */
+		fbits.data = data;
+		fbits.len = ( len * 8 );
+		fbits.pos = 0;
+		if ( ( rc = zstd_fse_read ( fse, &fbits, max_symbol,
+					    max_log ) ) != 0 )
+			return rc;
+		*used = ( fbits.pos / 8 );
+		return 0;
+	default:
+		/* Repeat: reuse table from the previous block */
+		if ( ! fse->valid )
+			return -EINVAL;
+		return 0;
+	}
+}
+
+/**
+ * Copy a match (possibly overlapping its own output)
+ *
+ * @v dst		Destination
+ * @v src		Source
+ * @v len		Length
+ */
+static void zstd_overlap_copy ( uint8_t *dst, const uint8_t *src,
+				size_t len ) {
+
+	if ( ( size_t ) ( dst - src ) >= len ) {
+		memcpy ( dst, src, len );
+	} else {
+		while ( len-- )
+			*(dst++) = *(src++);
+	}
+}
+
+/**
+ * Decode a compressed block
+ *
+ * @v zstd		Decompressor workspace
+ * @v out		Output buffer
+ * @v data		Block content
+ * @v len		Length of block content
+ * @ret rc		Return status code
+ */
+static int zstd_block ( struct zstd *zstd, struct zstd_output *out,
+			const uint8_t *data, size_t len ) {
+	struct zstd_rbits bits;
+	struct zstd_fse_entry *entry;
+	unsigned int nbseq;
+	unsigned int modes;
+	unsigned int state_ll;
+	unsigned int state_of;
+	unsigned int state_ml;
+	unsigned int code;
+	unsigned int idx;
+	unsigned long offset_value;
+	unsigned long offset;
+	size_t lit_len;
+	size_t lit_pos = 0;
+	size_t used;
+	size_t seq_ll;
+	size_t seq_ml;
+	size_t window;
+	int rc;
+
+	/* Decode literals section */
+	if ( ( rc = zstd_literals ( zstd, data, len, &lit_len,
+				    &used ) ) != 0 )
+		return rc;
+	data += used;
+	len -= used;
+
+	/* Parse number of sequences */
+	if ( ! len )
+		return -EINVAL;
+	if ( data[0] < 128 ) {
+		nbseq = data[0];
+		used = 1;
+	} else if ( data[0] < 255 ) {
+		if ( len < 2 )
+			return -EINVAL;
+		nbseq = ( ( ( data[0] - 128 ) << 8 ) + data[1] );
+		used = 2;
+	} else {
+		if ( len < 3 )
+			return -EINVAL;
+		nbseq = ( data[1] + ( data[2] << 8 ) + 0x7f00 );
+		used = 3;
+	}
+	data += used;
+	len -= used;
+
+	/* A block with no sequences contains only literals */
+	if ( ! nbseq ) {
+		if ( ( out->len + lit_len ) > out->max )
+			return -ERANGE;
+		memcpy ( ( out->data + out->len ), zstd->literals, lit_len );
+		out->len += lit_len;
+		return 0;
+	}
+
+	/* Parse compression modes and prepare decoding tables (in
+	 * the order in which their descriptions appear: literal
+	 * lengths, offsets, match lengths).
+	 */
+	if ( ! len )
+		return -EINVAL;
+	modes = data[0];
+	if ( modes & 0x03 )
+		return -EINVAL;
+	data++;
+	len--;
+	if ( ( rc = zstd_seq_table ( &zstd->ll, ( ( modes >> 6 ) & 0x3 ),
+				     zstd_ll_default, ZSTD_LL_MAX_SYMBOL, 6,
+				     ZSTD_LL_MAX_SYMBOL, ZSTD_LL_MAX_LOG,
+				     data, len, &used ) ) != 0 )
+		return rc;
+	data += used;
+	len -= used;
+	if ( ( rc = zstd_seq_table ( &zstd->of, ( ( modes >> 4 ) & 0x3 ),
+				     zstd_of_default,
+				     ( ( sizeof ( zstd_of_default ) /
+					 sizeof ( zstd_of_default[0] ) ) - 1 ),
+				     5, ZSTD_OF_MAX_SYMBOL, ZSTD_OF_MAX_LOG,
+				     data, len, &used ) ) != 0 )
+		return rc;
+	data += used;
+	len -= used;
+	if ( ( rc = zstd_seq_table ( &zstd->ml, ( ( modes >> 2 ) & 0x3 ),
+				     zstd_ml_default, ZSTD_ML_MAX_SYMBOL, 6,
+				     ZSTD_ML_MAX_SYMBOL, ZSTD_ML_MAX_LOG,
+				     data, len, &used ) ) != 0 )
+		return rc;
+	data += used;
+	len -= used;
+
+	/* Initialise the sequence bitstream and decoding states */
+	if ( ( rc = zstd_rbits_init ( &bits, data, len ) ) != 0 )
+		return rc;
+	state_ll = zstd_rbits_pull ( &bits, zstd->ll.log );
+	state_of = zstd_rbits_pull ( &bits, zstd->of.log );
+	state_ml = zstd_rbits_pull ( &bits, zstd->ml.log );
+
+	/* Decode and execute sequences */
+	while ( nbseq-- ) {
+
+		/* Decode offset */
+		code = zstd->of.entry[state_of].symbol;
+		if ( code > ZSTD_OF_MAX_SYMBOL )
+			return -EINVAL;
+		offset_value = ( ( 1UL << code ) +
+				 zstd_rbits_pull ( &bits, code ) );
+
+		/* Decode match length */
+		code = zstd->ml.entry[state_ml].symbol;
+		if ( code > ZSTD_ML_MAX_SYMBOL )
+			return -EINVAL;
+		seq_ml = ( zstd_ml_codes[code].base +
+			   zstd_rbits_pull ( &bits, zstd_ml_codes[code].bits ));
+
+		/* Decode literal length */
+		code = zstd->ll.entry[state_ll].symbol;
+		if ( code > ZSTD_LL_MAX_SYMBOL )
+			return -EINVAL;
+		seq_ll = ( zstd_ll_codes[code].base +
+			   zstd_rbits_pull ( &bits, zstd_ll_codes[code].bits ));
+
+		/* Resolve offset against repeat offset history */
+		if ( offset_value > 3 ) {
+			offset = ( offset_value - 3 );
+			zstd->rep[2] = zstd->rep[1];
+			zstd->rep[1] = zstd->rep[0];
+			zstd->rep[0] = offset;
+		} else {
+			idx = ( offset_value - 1 );
+			if ( seq_ll == 0 )
+				idx++;
+			if ( idx == 0 ) {
+				offset = zstd->rep[0];
+			} else {
+				offset = ( ( idx < 3 ) ? zstd->rep[idx] :
+					   ( zstd->rep[0] - 1 ) );
+				if ( idx >= 2 )
+					zstd->rep[2] = zstd->rep[1];
+				zstd->rep[1] = zstd->rep[0];
+				zstd->rep[0] = offset;
+			}
+		}
+		if ( ! offset )
+			return -EINVAL;
+
+		/* Update states for the next sequence (in the order
+		 * literal lengths, match lengths, offsets), except
+		 * after the final sequence.
+		 */
+		if ( nbseq ) {
+			entry = &zstd->ll.entry[state_ll];
+			state_ll = ( entry->base +
+				     zstd_rbits_pull ( &bits, entry->bits ) );
+			entry = &zstd->ml.entry[state_ml];
+			state_ml = ( entry->base +
+				     zstd_rbits_pull ( &bits, entry->bits ) );
+			entry = &zstd->of.entry[state_of];
+			state_of = ( entry->base +
+				     zstd_rbits_pull ( &bits, entry->bits ) );
+		}
+
+		/* Copy literals */
+		if ( ( lit_pos + seq_ll ) > lit_len )
+			return -EINVAL;
+		if ( ( out->len + seq_ll + seq_ml ) > out->max )
+			return -ERANGE;
+		memcpy ( ( out->data + out->len ),
+			 ( zstd->literals + lit_pos ), seq_ll );
+		out->len += seq_ll;
+		lit_pos += seq_ll;
+
+		/* Copy match */
+		window = ( out->len - out->frame );
+		if ( offset > window )
+			return -EINVAL;
+		zstd_overlap_copy ( ( out->data + out->len ),
+				    ( out->data + out->len - offset ),
+				    seq_ml );
+		out->len += seq_ml;
+	}
+
+	/* Copy any remaining literals */
+	lit_len -= lit_pos;
+	if ( ( out->len + lit_len ) > out->max )
+		return -ERANGE;
+	memcpy ( ( out->data + out->len ), ( zstd->literals + lit_pos ),
+		 lit_len );
+	out->len += lit_len;
+
+	return 0;
+}
+
+/**
+ * Parse a frame header
+ *
+ * @v data		Frame data (starting at the magic number)
+ * @v len		Length of remaining input
+ * @v hdr_len		Total header length to fill in
+ * @v content_len	Frame content size to fill in (if present)
+ * @v has_content_len	Content size presence flag to fill in
+ * @v has_checksum	Content checksum presence flag to fill in
+ * @ret rc		Return status code
+ */
+static int zstd_frame_header ( const uint8_t *data, size_t len,
+			       size_t *hdr_len, uint64_t *content_len,
+			       int *has_content_len, int *has_checksum ) {
+	unsigned int desc;
+	unsigned int single;
+	unsigned int dict;
+	unsigned int fcs_len;
+	size_t pos = 5;
+
+	if ( len < 5 )
+		return -EINVAL;
+	desc = data[4];
+	single = ( ( desc >> 5 ) & 0x1 );
+	dict = ( desc & 0x3 );
+	*has_checksum = ( ( desc >> 2 ) & 0x1 );
+	if ( desc & 0x08 )
+		return -EINVAL;
+	if ( dict )
+		return -ENOTSUP;
+
+	/* Window descriptor (absent in single segment frames) */
+	if ( ! single )
+		pos++;
+
+	/* Frame content size */
+	switch ( desc >> 6 ) {
+	case 0:
+		fcs_len = ( single ? 1 : 0 );
+		break;
+	case 1:
+		fcs_len = 2;
+		break;
+	case 2:
+		fcs_len = 4;
+		break;
+	default:
+		fcs_len = 8;
+		break;
+	}
+	if ( ( pos + fcs_len ) > len )
+		return -EINVAL;
+	if ( fcs_len ) {
+		*content_len = zstd_le ( ( data + pos ), fcs_len );
+		if ( fcs_len == 2 )
+			*content_len += 256;
+		*has_content_len = 1;
+	} else {
+		*content_len = 0;
+		*has_content_len = 0;
+	}
+	pos += fcs_len;
+
+	*hdr_len = pos;
+	return 0;
+}
+
+/**
+ * Decompress (or walk) a single frame
+ *
+ * @v zstd		Decompressor workspace (or NULL to walk blocks only)
+ * @v out		Output buffer (or NULL to walk blocks only)
+ * @v data		Frame data (starting at the magic number)
+ * @v len		Length of remaining input
+ * @v used		Consumed length to fill in
+ * @v content_len	Declared frame content size to fill in
+ * @ret rc		Return status code
+ */
+static int zstd_frame ( struct zstd *zstd, struct zstd_output *out,
+			const uint8_t *data, size_t len, size_t *used,
+			uint64_t *content_len ) {
+	unsigned long magic;
+	uint64_t declared;
+	size_t hdr_len;
+	size_t pos;
+	size_t block_len;
+	unsigned int header;
+	unsigned int last;
+	unsigned int type;
+	int has_content_len;
+	int has_checksum;
+	int rc;
+
+	/* Check magic number, handling skippable frames */
+	if ( len < 4 )
+		return -EINVAL;
+	magic = zstd_le ( data, 4 );
+	*content_len = 0;
+	if ( ( magic & ZSTD_MAGIC_SKIP_MASK ) == ZSTD_MAGIC_SKIP ) {
+		if ( len < 8 )
+			return -EINVAL;
+		block_len = zstd_le ( ( data + 4 ), 4 );
+		if ( ( 8 + block_len ) > len )
+			return -EINVAL;
+		*used = ( 8 + block_len );
+		return 0;
+	}
+	if ( magic != ZSTD_MAGIC )
+		return -EINVAL;
+
+	/* Parse frame header */
+	if ( ( rc = zstd_frame_header ( data, len, &hdr_len, &declared,
+					&has_content_len,
+					&has_checksum ) ) != 0 )
+		return rc;
+	if ( has_content_len )
+		*content_len = declared;
+	else if ( ! zstd )
+		return -ENOTSUP;
+	pos = hdr_len;
+
+	/* Reset per-frame decoder state */
+	if ( zstd ) {
+		zstd->rep[0] = 1;
+		zstd->rep[1] = 4;
+		zstd->rep[2] = 8;
+		zstd->huf.log = 0;
+		zstd->ll.valid = 0;
+		zstd->of.valid = 0;
+		zstd->ml.valid = 0;
+		out->frame = out->len;
+	}
+
+	/* Process blocks */
+	do {
+		if ( ( pos + 3 ) > len )
+			return -EINVAL;
+		header = zstd_le ( ( data + pos ), 3 );
+		last = ( header & 0x1 );
+		type = ( ( header >> 1 ) & 0x3 );
+		block_len = ( header >> 3 );
+		pos += 3;
+		switch ( type ) {
+		case 0:
+			/* Raw block */
+			if ( ( pos + block_len ) > len )
+				return -EINVAL;
+			if ( zstd ) {
+				if ( ( out->len + block_len ) > out->max )
+					return -ERANGE;
+				memcpy ( ( out->data + out->len ),
+					 ( data + pos ), block_len );
+				out->len += block_len;
+			}
+			pos += block_len;
+			break;
+		case 1:
+			/* RLE block */
+			if ( ( pos + 1 ) > len )
+				return -EINVAL;
+			if ( zstd ) {
+				if ( ( out->len + block_len ) > out->max )
+					return -ERANGE;
+				memset ( ( out->data + out->len ),
+					 data[pos], block_len );
+				out->len += block_len;
+			}
+			pos += 1;
+			break;
+		case 2:
+			/* Compressed block */
+			if ( ( pos + block_len ) > len )
+				return -EINVAL;
+			if ( zstd ) {
+				if ( ( rc = zstd_block ( zstd, out,
+							 ( data + pos ),
+							 block_len ) ) != 0 )
+					return rc;
+			}
+			pos += block_len;
+			break;
+		default:
+			/* Reserved block type */
+			return -ENOTSUP;
+		}
+	} while ( ! last );
+
+	/* Skip content checksum, if present (we do not verify it) */
+	if ( has_checksum ) {
+		if ( ( pos + 4 ) > len )
+			return -EINVAL;
+		pos += 4;
+	}
+
+	/* Check decompressed length against declared length */
+	if ( zstd && has_content_len &&
+	     ( ( out->len - out->frame ) != declared ) )
+		return -EINVAL;
+
+	*used = pos;
+	return 0;
+}
+
+/**
+ * Calculate total decompressed length
+ *
+ * @v data		Compressed data
+ * @v len		Length of compressed data
+ * @v out_len		Decompressed length to fill in
+ * @ret rc		Return status code
+ *
+ * Walks the frame and block structure without decoding any data.
+ * All (non-skippable) frames must declare their content size in the
+ * frame header; frames without a declared size are not supported.
+ */
+int zstd_decompressed_len ( const void *data, size_t len, size_t *out_len ) {
+	const uint8_t *bytes = data;
+	uint64_t content_len;
+	size_t total = 0;
+	size_t used;
+	int rc;
+
+	while ( len ) {
+		if ( ( rc = zstd_frame ( NULL, NULL, bytes, len, &used,
+					 &content_len ) ) != 0 )
+			return rc;
+		total += content_len;
+		bytes += used;
+		len -= used;
+	}
+	*out_len = total;
+	return 0;
+}
+
+/**
+ * Decompress Zstandard-compressed data
+ *
+ * @v zstd		Decompressor workspace
+ * @v data		Compressed data
+ * @v len		Length of compressed data
+ * @v out		Output data buffer
+ * @v out_max		Length of output data buffer
+ * @v out_len		Decompressed length to fill in
+ * @ret rc		Return status code
+ *
+ * Decompresses a series of concatenated frames.
+ */
+int zstd_decompress ( struct zstd *zstd, const void *data, size_t len,
+		      void *out, size_t out_max, size_t *out_len ) {
+	struct zstd_output output;
+	const uint8_t *bytes = data;
+	uint64_t content_len;
+	size_t used;
+	int rc;
+
+	output.data = out;
+	output.max = out_max;
+	output.len = 0;
+	output.frame = 0;
+
+	while ( len ) {
+		if ( ( rc = zstd_frame ( zstd, &output, bytes, len, &used,
+					 &content_len ) ) != 0 )
+			return rc;
+		bytes += used;
+		len -= used;
+	}
+	*out_len = output.len;
+	return 0;
+}
@@ -827,8 +827,15 @@ static int scsidev_test_unit_ready ( struct scsi_device *scsidev,
  */
 static size_t scsidev_window ( struct scsi_device *scsidev ) {
 
-	/* Refuse commands until unit is confirmed ready */
-	if ( ! ( scsidev->flags & SCSIDEV_UNIT_READY ) )
+	/* Refuse commands until the initial TEST UNIT READY has been
+	 * issued.  Commands need not wait for the ready check to
+	 * complete: each command carries its own tag, so subsequent
+	 * commands simply queue up behind the ready check rather than
+	 * paying its round trip latency on every command burst.  If
+	 * the unit never becomes ready then the device will be closed
+	 * and any queued commands will be failed.
+	 */
+	if ( ! ( scsidev->flags & SCSIDEV_UNIT_TESTED ) )
 		return 0;
 
 	return xfer_window ( &scsidev->scsi );
@@ -952,6 +959,9 @@ static void scsidev_step ( struct scsi_device *scsidev ) {
 		scsidev_close ( scsidev, rc );
 		return;
 	}
+
+	/* Allow commands to be issued behind the ready check */
+	xfer_window_changed ( &scsidev->block );
 }
 
 /** SCSI device SCSI interface operations */
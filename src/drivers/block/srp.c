@@ -54,6 +54,16 @@ FEATURE ( FEATURE_PROTOCOL, "SRP", DHCP_EB_FEATURE_SRP, 1 );
  */
 #define SRP_MAX_I_T_IU_LEN 80
 
+/** Maximum number of outstanding SRP commands
+ *
+ * This is a policy decision.  The underlying queue pair must have
+ * sufficient work queue entries to cover this many concurrent
+ * commands.
+ */
+#ifndef SRP_MAX_QUEUE_DEPTH
+#define SRP_MAX_QUEUE_DEPTH 8
+#endif
+
 /* Error numbers generated by SRP login rejection */
 #define EINFO_SRP_LOGIN_REJ( reason, desc )				      \
 	__einfo_uniqify ( EINFO_EPERM, ( (reason) & 0x0f ), desc )
@@ -113,6 +123,8 @@ struct srp_device {
 	/** Login completed successfully */
 	int logged_in;
 
+	/** Number of outstanding commands */
+	unsigned int outstanding;
 	/** List of active commands */
 	struct list_head commands;
 };
@@ -209,11 +221,16 @@ static void srpcmd_close ( struct srp_command *srpcmd, int rc ) {
 	if ( ! list_empty ( &srpcmd->list ) ) {
 		list_del ( &srpcmd->list );
 		INIT_LIST_HEAD ( &srpcmd->list );
+		assert ( srpdev->outstanding > 0 );
+		srpdev->outstanding--;
 		srpcmd_put ( srpcmd );
 	}
 
 	/* Shut down interfaces */
 	intf_shutdown ( &srpcmd->scsi, rc );
+
+	/* Notify of window change; a queue slot has become free */
+	xfer_window_changed ( &srpdev->scsi );
 }
 
 /**
@@ -576,6 +593,12 @@ static int srpdev_scsi_command ( struct srp_device *srpdev,
 	int tag;
 	int rc;
 
+	/* Refuse commands beyond the maximum queue depth */
+	if ( srpdev->outstanding >= SRP_MAX_QUEUE_DEPTH ) {
+		rc = -EBUSY;
+		goto err_depth;
+	}
+
 	/* Allocate command tag */
 	tag = srp_new_tag ( srpdev );
 	if ( tag < 0 ) {
@@ -593,6 +616,7 @@ static int srpdev_scsi_command ( struct srp_device *srpdev,
 	intf_init ( &srpcmd->scsi, &srpcmd_scsi_desc, &srpcmd->refcnt );
 	srpcmd->srpdev = srpdev_get ( srpdev );
 	list_add ( &srpcmd->list, &srpdev->commands );
+	srpdev->outstanding++;
 	srpcmd->tag = tag;
 
 	/* Send command IU */
@@ -609,6 +633,7 @@ static int srpdev_scsi_command ( struct srp_device *srpdev,
 	srpcmd_close ( srpcmd, rc );
  err_zalloc:
  err_tag:
+ err_depth:
 	return rc;
 }
 
@@ -674,7 +699,15 @@ static int srpdev_deliver ( struct srp_device *srpdev,
  * @ret len		Length of window
  */
 static size_t srpdev_window ( struct srp_device *srpdev ) {
-	return ( srpdev->logged_in ? ~( ( size_t ) 0 ) : 0 );
+
+	/* Window is closed until login completes, and while the
+	 * maximum queue depth is reached.
+	 */
+	if ( ! srpdev->logged_in )
+		return 0;
+	if ( srpdev->outstanding >= SRP_MAX_QUEUE_DEPTH )
+		return 0;
+	return ~( ( size_t ) 0 );
 }
 
 /** SRP device socket interface operations */
@@ -95,23 +95,56 @@ void vring_add_buf(struct vring_virtqueue *vq,
 
    prev = 0;
    head = vq->free_head;
-   for (i = head; out; i = vr->desc[i].next, out--) {
 
-           vr->desc[i].flags = VRING_DESC_F_NEXT;
-           vr->desc[i].addr = (u64)virt_to_phys(list->addr);
-           vr->desc[i].len = list->length;
-           prev = i;
-           list++;
-   }
-   for ( ; in; i = vr->desc[i].next, in--) {
+   if (vq->use_indirect && (out + in) > 1 &&
+       (out + in) <= MAX_INDIRECT_NUM) {
+
+           /* Describe the whole chain in the preallocated indirect
+            * table for this ring entry, consuming only a single
+            * ring descriptor.
+            */
+           struct vring_desc *desc = vq->indirect[head];
+           unsigned int n = out + in;
+           unsigned int j;
+
+           for (j = 0; j < n; j++) {
+
+                   desc[j].flags = VRING_DESC_F_NEXT;
+                   if (j >= out)
+                           desc[j].flags |= VRING_DESC_F_WRITE;
+                   desc[j].addr = (u64)virt_to_phys(list->addr);
+                   desc[j].len = list->length;
+                   desc[j].next = j + 1;
+                   list++;
+           }
+           desc[n - 1].flags &= ~VRING_DESC_F_NEXT;
+
+           vr->desc[head].flags = VRING_DESC_F_INDIRECT;
+           vr->desc[head].addr = (u64)virt_to_phys(desc);
+           vr->desc[head].len = n * sizeof(*desc);
+
+           i = vr->desc[head].next;
+
+   } else {
 
-           vr->desc[i].flags = VRING_DESC_F_NEXT|VRING_DESC_F_WRITE;
-           vr->desc[i].addr = (u64)virt_to_phys(list->addr);
-           vr->desc[i].len = list->length;
-           prev = i;
-           list++;
+           for (i = head; out; i = vr->desc[i].next, out--) {
+
+                   vr->desc[i].flags = VRING_DESC_F_NEXT;
+                   vr->desc[i].addr = (u64)virt_to_phys(list->addr);
+                   vr->desc[i].len = list->length;
+                   prev = i;
+                   list++;
+           }
+           for ( ; in; i = vr->desc[i].next, in--) {
+
+                   vr->desc[i].flags = VRING_DESC_F_NEXT|VRING_DESC_F_WRITE;
+                   vr->desc[i].addr = (u64)virt_to_phys(list->addr);
+                   vr->desc[i].len = list->length;
+                   prev = i;
+                   list++;
+           }
+           vr->desc[prev].flags &= ~VRING_DESC_F_NEXT;
    }
-   vr->desc[prev].flags &= ~VRING_DESC_F_NEXT;
 
    vq->free_head = i;
 
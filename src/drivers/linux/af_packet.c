@@ -116,6 +116,9 @@ static int af_packet_nic_open ( struct net_device * netdev )
 		return ret;
 	}
 
+	/* Wake any nap when a frame arrives */
+	linux_watch_fd(nic->fd);
+
 	return 0;
 }
 
@@ -123,6 +126,7 @@ static int af_packet_nic_open ( struct net_device * netdev )
 static void af_packet_nic_close ( struct net_device *netdev )
 {
 	struct af_packet_nic * nic = netdev->priv;
+	linux_unwatch_fd(nic->fd);
 	linux_close(nic->fd);
 }
 
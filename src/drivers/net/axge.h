@@ -154,9 +154,15 @@ struct axge_device {
 
 /** Bulk IN maximum fill level
  *
- * This is a policy decision.
+ * This is a policy decision.  The device is configured not to
+ * coalesce packets (see axge_bicr), so each transfer carries a single
+ * Ethernet frame and enough transfers must be kept in flight to cover
+ * the USB completion-to-refill latency at full frame rate.  May be
+ * overridden at build time.
  */
-#define AXGE_IN_MAX_FILL 8
+#ifndef AXGE_IN_MAX_FILL
+#define AXGE_IN_MAX_FILL 16
+#endif
 
 /** Bulk IN buffer size
  *
@@ -73,9 +73,14 @@ struct ecm_device {
 
 /** Bulk IN maximum fill level
  *
- * This is a policy decision.
+ * This is a policy decision.  Each CDC-ECM transfer carries a single
+ * Ethernet frame, so enough transfers must be kept in flight to cover
+ * the USB completion-to-refill latency at full frame rate.  May be
+ * overridden at build time.
  */
-#define ECM_IN_MAX_FILL 8
+#ifndef ECM_IN_MAX_FILL
+#define ECM_IN_MAX_FILL 16
+#endif
 
 /** Bulk IN buffer size
  *
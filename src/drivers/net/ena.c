@@ -33,6 +33,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/if_ether.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/malloc.h>
+#include <ipxe/dmapool.h>
 #include <ipxe/pci.h>
 #include "ena.h"
 
@@ -164,7 +165,7 @@ static int ena_create_admin ( struct ena_nic *ena ) {
 	int rc;
 
 	/* Allocate admin completion queue */
-	ena->acq.rsp = malloc_dma ( acq_len, acq_len );
+	ena->acq.rsp = dma_pool_alloc ( acq_len, acq_len );
 	if ( ! ena->acq.rsp ) {
 		rc = -ENOMEM;
 		goto err_alloc_acq;
@@ -172,7 +173,7 @@ static int ena_create_admin ( struct ena_nic *ena ) {
 	memset ( ena->acq.rsp, 0, acq_len );
 
 	/* Allocate admin queue */
-	ena->aq.req = malloc_dma ( aq_len, aq_len );
+	ena->aq.req = dma_pool_alloc ( aq_len, aq_len );
 	if ( ! ena->aq.req ) {
 		rc = -ENOMEM;
 		goto err_alloc_aq;
@@ -196,9 +197,9 @@ static int ena_create_admin ( struct ena_nic *ena ) {
 
 	ena_clear_caps ( ena, ENA_AQ_CAPS );
 	ena_clear_caps ( ena, ENA_ACQ_CAPS );
-	free_dma ( ena->aq.req, aq_len );
+	dma_pool_free ( ena->aq.req, aq_len );
  err_alloc_aq:
-	free_dma ( ena->acq.rsp, acq_len );
+	dma_pool_free ( ena->acq.rsp, acq_len );
  err_alloc_acq:
 	return rc;
 }
@@ -218,8 +219,8 @@ static void ena_destroy_admin ( struct ena_nic *ena ) {
 	wmb();
 
 	/* Free queues */
-	free_dma ( ena->aq.req, aq_len );
-	free_dma ( ena->acq.rsp, acq_len );
+	dma_pool_free ( ena->aq.req, aq_len );
+	dma_pool_free ( ena->acq.rsp, acq_len );
 	DBGC ( ena, "ENA %p AQ and ACQ destroyed\n", ena );
 }
 
@@ -338,7 +339,7 @@ static int ena_create_sq ( struct ena_nic *ena, struct ena_sq *sq,
 	int rc;
 
 	/* Allocate submission queue entries */
-	sq->sqe.raw = malloc_dma ( sq->len, ENA_ALIGN );
+	sq->sqe.raw = dma_pool_alloc ( sq->len, ENA_ALIGN );
 	if ( ! sq->sqe.raw ) {
 		rc = -ENOMEM;
 		goto err_alloc;
@@ -363,8 +364,9 @@ static int ena_create_sq ( struct ena_nic *ena, struct ena_sq *sq,
 	sq->id = le16_to_cpu ( rsp->create_sq.id );
 	sq->doorbell = le32_to_cpu ( rsp->create_sq.doorbell );
 
-	/* Reset producer counter and phase */
+	/* Reset producer counter, doorbell record, and phase */
 	sq->prod = 0;
+	sq->rung = 0;
 	sq->phase = ENA_SQE_PHASE;
 
 	DBGC ( ena, "ENA %p %s SQ%d at [%08lx,%08lx) db +%04x CQ%d\n",
@@ -375,7 +377,7 @@ static int ena_create_sq ( struct ena_nic *ena, struct ena_sq *sq,
 	return 0;
 
  err_admin:
-	free_dma ( sq->sqe.raw, sq->len );
+	dma_pool_free ( sq->sqe.raw, sq->len );
  err_alloc:
 	return rc;
 }
@@ -403,7 +405,7 @@ static int ena_destroy_sq ( struct ena_nic *ena, struct ena_sq *sq ) {
 		return rc;
 
 	/* Free submission queue entries */
-	free_dma ( sq->sqe.raw, sq->len );
+	dma_pool_free ( sq->sqe.raw, sq->len );
 
 	DBGC ( ena, "ENA %p %s SQ%d destroyed\n",
 	       ena, ena_direction ( sq->direction ), sq->id );
@@ -423,7 +425,7 @@ static int ena_create_cq ( struct ena_nic *ena, struct ena_cq *cq ) {
 	int rc;
 
 	/* Allocate completion queue entries */
-	cq->cqe.raw = malloc_dma ( cq->len, ENA_ALIGN );
+	cq->cqe.raw = dma_pool_alloc ( cq->len, ENA_ALIGN );
 	if ( ! cq->cqe.raw ) {
 		rc = -ENOMEM;
 		goto err_alloc;
@@ -461,7 +463,7 @@ static int ena_create_cq ( struct ena_nic *ena, struct ena_cq *cq ) {
 	return 0;
 
  err_admin:
-	free_dma ( cq->cqe.raw, cq->len );
+	dma_pool_free ( cq->cqe.raw, cq->len );
  err_alloc:
 	return rc;
 }
@@ -488,7 +490,7 @@ static int ena_destroy_cq ( struct ena_nic *ena, struct ena_cq *cq ) {
 		return rc;
 
 	/* Free completion queue entries */
-	free_dma ( cq->cqe.raw, cq->len );
+	dma_pool_free ( cq->cqe.raw, cq->len );
 
 	DBGC ( ena, "ENA %p CQ%d destroyed\n", ena, cq->id );
 	return 0;
@@ -777,14 +779,14 @@ static int ena_transmit ( struct net_device *netdev, struct io_buffer *iobuf ) {
 		       ena->tx.sq.phase );
 	wmb();
 
-	/* Increment producer counter */
+	/* Increment producer counter.  The doorbell is rung from
+	 * ena_poll(), so that a burst of transmissions incurs only a
+	 * single doorbell write.
+	 */
 	ena->tx.sq.prod++;
 	if ( ( ena->tx.sq.prod % ENA_TX_COUNT ) == 0 )
 		ena->tx.sq.phase ^= ENA_SQE_PHASE;
 
-	/* Ring doorbell */
-	writel ( ena->tx.sq.prod, ( ena->regs + ena->tx.sq.doorbell ) );
-
 	DBGC2 ( ena, "ENA %p TX %d at [%08llx,%08llx)\n", ena, sqe->id,
 		( ( unsigned long long ) address ),
 		( ( unsigned long long ) address + len ) );
@@ -871,6 +873,16 @@ static void ena_poll_rx ( struct net_device *netdev ) {
  * @v netdev		Network device
  */
 static void ena_poll ( struct net_device *netdev ) {
+	struct ena_nic *ena = netdev->priv;
+
+	/* Ring transmit doorbell, if any packets were enqueued since
+	 * the last poll.
+	 */
+	if ( ena->tx.sq.prod != ena->tx.sq.rung ) {
+		wmb();
+		writel ( ena->tx.sq.prod, ( ena->regs + ena->tx.sq.doorbell ) );
+		ena->tx.sq.rung = ena->tx.sq.prod;
+	}
 
 	/* Poll for transmit completions */
 	ena_poll_tx ( netdev );
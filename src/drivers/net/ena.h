@@ -24,11 +24,24 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Number of admin completion queue entries */
 #define ENA_ACQ_COUNT 2
 
-/** Number of transmit queue entries */
-#define ENA_TX_COUNT 16
+/** Number of transmit queue entries
+ *
+ * May be overridden at build time.
+ */
+#ifndef ENA_TX_COUNT
+#define ENA_TX_COUNT 32
+#endif
 
-/** Number of receive queue entries */
-#define ENA_RX_COUNT 16
+/** Number of receive queue entries
+ *
+ * Sized to absorb receive bursts without drops while keeping the
+ * memory committed to receive buffers modest, since the device keeps
+ * every posted descriptor backed by an I/O buffer.  May be overridden
+ * at build time.
+ */
+#ifndef ENA_RX_COUNT
+#define ENA_RX_COUNT 32
+#endif
 
 /** Base address low register offset */
 #define ENA_BASE_LO 0x0
@@ -488,6 +501,8 @@ struct ena_sq {
 	size_t len;
 	/** Producer counter */
 	unsigned int prod;
+	/** Producer counter as at last doorbell ring */
+	unsigned int rung;
 	/** Phase */
 	unsigned int phase;
 	/** Submission queue identifier */
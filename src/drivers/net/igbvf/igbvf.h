@@ -278,7 +278,12 @@ struct igbvf_adapter {
         u32 max_hw_frame_size;
 
 #define NUM_TX_DESC     8
-#define NUM_RX_DESC     8
+/* Receive ring size may be overridden at build time; the ring length
+ * must remain a multiple of 128 bytes, i.e. 8 descriptors.
+ */
+#ifndef NUM_RX_DESC
+#define NUM_RX_DESC     32
+#endif
 
         struct io_buffer *tx_iobuf[NUM_TX_DESC];
         struct io_buffer *rx_iobuf[NUM_RX_DESC];
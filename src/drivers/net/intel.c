@@ -33,6 +33,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/if_ether.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/malloc.h>
+#include <ipxe/dmapool.h>
 #include <ipxe/pci.h>
 #include <ipxe/profile.h>
 #include "intel.h"
@@ -88,13 +89,17 @@ static int intel_read_eeprom ( struct nvs_device *nvs, unsigned int address,
 	writel ( ( INTEL_EERD_START | ( address << intel->eerd_addr_shift ) ),
 		 intel->regs + INTEL_EERD );
 
-	/* Wait for read to complete */
-	for ( i = 0 ; i < INTEL_EEPROM_MAX_WAIT_MS ; i++ ) {
+	/* Wait for read to complete.  Reads typically complete within
+	 * a few microseconds, so poll at microsecond granularity
+	 * rather than quantising each word-by-word read to a whole
+	 * millisecond.
+	 */
+	for ( i = 0 ; i < ( INTEL_EEPROM_MAX_WAIT_MS * 100 ) ; i++ ) {
 
-		/* If read is not complete, delay 1ms and retry */
+		/* If read is not complete, delay 10us and retry */
 		value = readl ( intel->regs + INTEL_EERD );
 		if ( ! ( value & intel->eerd_done ) ) {
-			mdelay ( 1 );
+			udelay ( 10 );
 			continue;
 		}
 
@@ -144,10 +149,16 @@ static int intel_init_eeprom ( struct intel_nic *intel ) {
 	 * The EEPROM size may be larger than the minimum size, but
 	 * this doesn't matter to us since we access only the first
 	 * few words.
+	 *
+	 * Since each word read costs a separate EERD transaction,
+	 * cache words as they are read so that repeated accesses do
+	 * not have to wait for the device again.
 	 */
 	intel->eeprom.word_len_log2 = INTEL_EEPROM_WORD_LEN_LOG2;
 	intel->eeprom.size = INTEL_EEPROM_MIN_SIZE_WORDS;
 	intel->eeprom.block_size = 1;
+	intel->eeprom.cache = intel->eeprom_cache;
+	intel->eeprom.cache_size = INTEL_EEPROM_MIN_SIZE_WORDS;
 	intel->eeprom.read = intel_read_eeprom;
 	intel->eeprom.write = intel_write_eeprom;
 
@@ -157,7 +168,7 @@ static int intel_init_eeprom ( struct intel_nic *intel ) {
 	 * which type of register we have.
 	 */
 	writel ( INTEL_EERD_START, intel->regs + INTEL_EERD );
-	for ( i = 0 ; i < INTEL_EEPROM_MAX_WAIT_MS ; i++ ) {
+	for ( i = 0 ; i < ( INTEL_EEPROM_MAX_WAIT_MS * 100 ) ; i++ ) {
 		value = readl ( intel->regs + INTEL_EERD );
 		if ( value & INTEL_EERD_DONE_LARGE ) {
 			DBGC ( intel, "INTEL %p has large-format EERD\n",
@@ -173,7 +184,7 @@ static int intel_init_eeprom ( struct intel_nic *intel ) {
 			intel->eerd_addr_shift = INTEL_EERD_ADDR_SHIFT_SMALL;
 			return 0;
 		}
-		mdelay ( 1 );
+		udelay ( 10 );
 	}
 
 	DBGC ( intel, "INTEL %p timed out waiting for initial EEPROM read "
@@ -351,6 +362,7 @@ static int intel_reset ( struct intel_nic *intel ) {
  * @v netdev		Network device
  */
 static void intel_check_link ( struct net_device *netdev ) {
+	static const unsigned int speeds[4] = { 10, 100, 1000, 1000 };
 	struct intel_nic *intel = netdev->priv;
 	uint32_t status;
 
@@ -360,8 +372,10 @@ static void intel_check_link ( struct net_device *netdev ) {
 
 	/* Update network device */
 	if ( status & INTEL_STATUS_LU ) {
+		netdev->link_speed = speeds[ INTEL_STATUS_SPEED ( status ) ];
 		netdev_link_up ( netdev );
 	} else {
+		netdev->link_speed = 0;
 		netdev_link_down ( netdev );
 	}
 }
@@ -387,8 +401,8 @@ void intel_describe_tx ( struct intel_descriptor *tx, physaddr_t addr,
 	tx->address = cpu_to_le64 ( addr );
 	tx->length = cpu_to_le16 ( len );
 	tx->flags = 0;
-	tx->command = ( INTEL_DESC_CMD_RS | INTEL_DESC_CMD_IFCS |
-			INTEL_DESC_CMD_EOP );
+	tx->command = ( INTEL_DESC_CMD_IDE | INTEL_DESC_CMD_RS |
+			INTEL_DESC_CMD_IFCS | INTEL_DESC_CMD_EOP );
 	tx->status = 0;
 }
 
@@ -504,7 +518,7 @@ int intel_create_ring ( struct intel_nic *intel, struct intel_ring *ring ) {
 	 * prevent any possible page-crossing errors due to hardware
 	 * errata.
 	 */
-	ring->desc = malloc_dma ( ring->len, ring->len );
+	ring->desc = dma_pool_alloc ( ring->len, ring->len );
 	if ( ! ring->desc )
 		return -ENOMEM;
 
@@ -553,7 +567,7 @@ void intel_destroy_ring ( struct intel_nic *intel, struct intel_ring *ring ) {
 	intel_reset_ring ( intel, ring->reg );
 
 	/* Free descriptor ring */
-	free_dma ( ring->desc, ring->len );
+	dma_pool_free ( ring->desc, ring->len );
 	ring->desc = NULL;
 	ring->prod = 0;
 	ring->cons = 0;
@@ -676,11 +690,19 @@ static int intel_open ( struct net_device *netdev ) {
 
 	/* Enable receiver */
 	rctl = readl ( intel->regs + INTEL_RCTL );
-	rctl &= ~( INTEL_RCTL_BSIZE_BSEX_MASK );
+	rctl &= ~( INTEL_RCTL_BSIZE_BSEX_MASK | INTEL_RCTL_LPE );
 	rctl |= ( INTEL_RCTL_EN | INTEL_RCTL_UPE | INTEL_RCTL_MPE |
-		  INTEL_RCTL_BAM | INTEL_RCTL_BSIZE_2048 | INTEL_RCTL_SECRC );
+		  INTEL_RCTL_BAM | INTEL_RCTL_BSIZE ( INTEL_RX_MAX_LEN ) |
+		  INTEL_RCTL_SECRC );
+	if ( INTEL_RX_MAX_LEN > 2048 )
+		rctl |= INTEL_RCTL_LPE;
 	writel ( rctl, intel->regs + INTEL_RCTL );
 
+	/* Delay transmit completion interrupts, so that completions
+	 * from a burst of packets are harvested in a single pass.
+	 */
+	writel ( INTEL_TX_COAL_DELAY, intel->regs + INTEL_TIDV );
+
 	/* Fill receive ring */
 	intel_refill_rx ( intel );
 
@@ -812,6 +834,7 @@ void intel_poll_rx ( struct net_device *netdev ) {
 	struct intel_descriptor *rx;
 	struct io_buffer *iobuf;
 	unsigned int rx_idx;
+	uint32_t status;
 	size_t len;
 
 	/* Check for received packets */
@@ -840,6 +863,20 @@ void intel_poll_rx ( struct net_device *netdev ) {
 		} else {
 			DBGC2 ( intel, "INTEL %p RX %d complete (length %zd)\n",
 				intel, rx_idx, len );
+			/* Use the hardware checksum verdict if both
+			 * the IP and TCP/UDP checksums were checked
+			 * and neither was in error.
+			 */
+			status = le32_to_cpu ( rx->status );
+			if ( ( status & ( INTEL_DESC_STATUS_IXSM |
+					  INTEL_DESC_STATUS_TCPCS |
+					  INTEL_DESC_STATUS_IPCS |
+					  INTEL_DESC_STATUS_TCPE |
+					  INTEL_DESC_STATUS_IPE ) ) ==
+			     ( INTEL_DESC_STATUS_TCPCS |
+			       INTEL_DESC_STATUS_IPCS ) ) {
+				iobuf->flags |= IOB_FL_HW_CSUM;
+			}
 			netdev_rx ( netdev, iobuf );
 		}
 		intel->rx.cons++;
@@ -854,6 +891,7 @@ void intel_poll_rx ( struct net_device *netdev ) {
 static void intel_poll ( struct net_device *netdev ) {
 	struct intel_nic *intel = netdev->priv;
 	uint32_t icr;
+	uint32_t mpc;
 
 	/* Check for and acknowledge interrupts */
 	profile_start ( &intel_vm_poll_profiler );
@@ -861,6 +899,14 @@ static void intel_poll ( struct net_device *netdev ) {
 	profile_stop ( &intel_vm_poll_profiler );
 	profile_exclude ( &intel_vm_poll_profiler );
 	icr |= intel->force_icr;
+
+	/* Harvest TX completions without waiting for the delayed
+	 * transmit interrupt if the ring has passed the reap
+	 * threshold, to keep ring space available under load.
+	 */
+	if ( ( intel->tx.prod - intel->tx.cons ) >= INTEL_TX_REAP )
+		icr |= INTEL_IRQ_TXDW;
+
 	if ( ! icr )
 		return;
 
@@ -872,9 +918,17 @@ static void intel_poll ( struct net_device *netdev ) {
 	if ( icr & ( INTEL_IRQ_RXT0 | INTEL_IRQ_RXO ) )
 		intel_poll_rx ( netdev );
 
-	/* Report receive overruns */
-	if ( icr & INTEL_IRQ_RXO )
-		netdev_rx_err ( netdev, NULL, -ENOBUFS );
+	/* Report receive overruns, counting each missed packet as a
+	 * drop in the network device statistics.  The missed packets
+	 * count register clears on read.
+	 */
+	if ( icr & INTEL_IRQ_RXO ) {
+		mpc = readl ( intel->regs + INTEL_MPC );
+		if ( mpc < 1 )
+			mpc = 1;
+		while ( mpc-- )
+			netdev_rx_err ( netdev, NULL, -ENOBUFS );
+	}
 
 	/* Check link state, if applicable */
 	if ( icr & INTEL_IRQ_LSC )
@@ -910,6 +964,47 @@ static void intel_irq ( struct net_device *netdev, int enable ) {
 	}
 }
 
+/**
+ * Update multicast receive filter
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+static int intel_mcast ( struct net_device *netdev ) {
+	struct intel_nic *intel = netdev->priv;
+	struct net_device_mcast *mcast;
+	uint32_t mta[INTEL_MTA_COUNT];
+	uint32_t rctl;
+	unsigned int vector;
+	unsigned int i;
+
+	/* Construct multicast table array, using the default filter
+	 * vector of the top twelve bits of the destination address.
+	 */
+	memset ( mta, 0, sizeof ( mta ) );
+	list_for_each_entry ( mcast, &netdev->mcast, list ) {
+		vector = ( ( mcast->ll_addr[5] << 4 ) |
+			   ( mcast->ll_addr[4] >> 4 ) );
+		mta[ vector / 32 ] |= ( 1 << ( vector % 32 ) );
+	}
+	for ( i = 0 ; i < INTEL_MTA_COUNT ; i++ )
+		writel ( mta[i], intel->regs + INTEL_MTA + ( i * 4 ) );
+
+	/* Fall back to multicast promiscuity while no groups are
+	 * joined, since consumers predating the multicast filter may
+	 * rely on receiving all multicast packets.
+	 */
+	rctl = readl ( intel->regs + INTEL_RCTL );
+	if ( list_empty ( &netdev->mcast ) ) {
+		rctl |= INTEL_RCTL_MPE;
+	} else {
+		rctl &= ~INTEL_RCTL_MPE;
+	}
+	writel ( rctl, intel->regs + INTEL_RCTL );
+
+	return 0;
+}
+
 /** Intel network device operations */
 static struct net_device_operations intel_operations = {
 	.open		= intel_open,
@@ -917,6 +1012,7 @@ static struct net_device_operations intel_operations = {
 	.transmit	= intel_transmit,
 	.poll		= intel_poll,
 	.irq		= intel_irq,
+	.mcast		= intel_mcast,
 };
 
 /******************************************************************************
@@ -955,6 +1051,14 @@ static int intel_probe ( struct pci_device *pci ) {
 	intel_init_ring ( &intel->rx, INTEL_NUM_RX_DESC, INTEL_RD,
 			  intel_describe_rx );
 
+	/* Allow the MTU to be raised to the limit of the receive
+	 * buffers, if built with buffers large enough for jumbo
+	 * frames.  Long packet reception is enabled to match in
+	 * intel_open().
+	 */
+	if ( INTEL_RX_MAX_LEN > 2048 )
+		netdev->max_pkt_len = INTEL_RX_MAX_LEN;
+
 	/* Fix up PCI device */
 	adjust_pci_device ( pci );
 
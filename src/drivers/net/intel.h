@@ -34,6 +34,9 @@ struct intel_descriptor {
 #define INTEL_DESC_FL_DTYP( dtyp ) ( (dtyp) << 4 )
 #define INTEL_DESC_FL_DTYP_DATA INTEL_DESC_FL_DTYP ( 0x03 )
 
+/** Interrupt delay enable */
+#define INTEL_DESC_CMD_IDE 0x80
+
 /** Descriptor extension */
 #define INTEL_DESC_CMD_DEXT 0x20
 
@@ -49,9 +52,24 @@ struct intel_descriptor {
 /** Descriptor done */
 #define INTEL_DESC_STATUS_DD 0x00000001UL
 
+/** Ignore checksum indication */
+#define INTEL_DESC_STATUS_IXSM 0x00000004UL
+
+/** TCP/UDP checksum calculated */
+#define INTEL_DESC_STATUS_TCPCS 0x00000020UL
+
+/** IP checksum calculated */
+#define INTEL_DESC_STATUS_IPCS 0x00000040UL
+
 /** Receive error */
 #define INTEL_DESC_STATUS_RXE 0x00000100UL
 
+/** TCP/UDP checksum error */
+#define INTEL_DESC_STATUS_TCPE 0x00002000UL
+
+/** IP checksum error */
+#define INTEL_DESC_STATUS_IPE 0x00004000UL
+
 /** Payload length */
 #define INTEL_DESC_STATUS_PAYLEN( len ) ( (len) << 14 )
 
@@ -71,6 +89,8 @@ struct intel_descriptor {
 /** Device Status Register */
 #define INTEL_STATUS 0x00008UL
 #define INTEL_STATUS_LU		0x00000002UL	/**< Link up */
+#define INTEL_STATUS_SPEED(status) \
+	( ( (status) >> 6 ) & 0x3 )		/**< Link speed setting */
 
 /** EEPROM Read Register */
 #define INTEL_EERD 0x00014UL
@@ -117,9 +137,20 @@ struct intel_descriptor {
 #define INTEL_RCTL_BSIZE_BSEX(bsex,bsize) \
 	( ( (bsize) << 16 ) | ( (bsex) << 25 ) ) /**< Buffer size */
 #define INTEL_RCTL_BSIZE_2048	INTEL_RCTL_BSIZE_BSEX ( 0, 0 )
+#define INTEL_RCTL_BSIZE_4096	INTEL_RCTL_BSIZE_BSEX ( 1, 3 )
+#define INTEL_RCTL_BSIZE_8192	INTEL_RCTL_BSIZE_BSEX ( 1, 2 )
+#define INTEL_RCTL_BSIZE_16384	INTEL_RCTL_BSIZE_BSEX ( 1, 1 )
 #define INTEL_RCTL_BSIZE_BSEX_MASK INTEL_RCTL_BSIZE_BSEX ( 1, 3 )
+#define INTEL_RCTL_LPE		0x00000020UL	/**< Long packet enable */
 #define INTEL_RCTL_SECRC	0x04000000UL	/**< Strip CRC */
 
+/** Receive buffer size selection for a given buffer length */
+#define INTEL_RCTL_BSIZE( len )						\
+	( ( (len) > 8192 ) ? INTEL_RCTL_BSIZE_16384 :			\
+	  ( (len) > 4096 ) ? INTEL_RCTL_BSIZE_8192 :			\
+	  ( (len) > 2048 ) ? INTEL_RCTL_BSIZE_4096 :			\
+	  INTEL_RCTL_BSIZE_2048 )
+
 /** Transmit Control Register */
 #define INTEL_TCTL 0x00400UL
 #define INTEL_TCTL_EN		0x00000002UL	/**< Transmit enable */
@@ -143,19 +174,59 @@ struct intel_descriptor {
 /** Number of receive descriptors
  *
  * Minimum value is 8, since the descriptor ring length must be a
- * multiple of 128.
+ * multiple of 128.  The ring is sized to absorb line-rate bursts
+ * between polls; it may be overridden at build time.
  */
-#define INTEL_NUM_RX_DESC 16
+#ifndef INTEL_NUM_RX_DESC
+#define INTEL_NUM_RX_DESC 256
+#endif
 
-/** Receive descriptor ring fill level */
-#define INTEL_RX_FILL 8
+/** Receive descriptor ring fill level
+ *
+ * Determines the number of receive I/O buffers allocated at any one
+ * time, and must be strictly smaller than the number of receive
+ * descriptors.  It may be overridden at build time.
+ */
+#ifndef INTEL_RX_FILL
+#define INTEL_RX_FILL 32
+#endif
 
-/** Receive buffer length */
+/** Receive buffer length
+ *
+ * Each received packet must fit within a single receive buffer.  May
+ * be overridden at build time (e.g. to 9216) to enable the use of
+ * jumbo frames; the hardware buffer size and maximum packet length are
+ * derived from this value.
+ */
+#ifndef INTEL_RX_MAX_LEN
 #define INTEL_RX_MAX_LEN 2048
+#endif
 
 /** Transmit Descriptor register block */
 #define INTEL_TD 0x03800UL
 
+/** Transmit Interrupt Delay Value Register */
+#define INTEL_TIDV 0x03820UL
+
+/** Transmit interrupt delay (in 1.024us units)
+ *
+ * Delays the transmit completion interrupt so that completions from a
+ * burst of packets are harvested in a single pass rather than one at
+ * a time.  May be overridden at build time; zero disables delaying.
+ */
+#ifndef INTEL_TX_COAL_DELAY
+#define INTEL_TX_COAL_DELAY 64
+#endif
+
+/** Transmit completion reap threshold
+ *
+ * When at least this many transmit descriptors are in flight,
+ * completions are harvested on every poll without waiting for the
+ * delayed transmit interrupt, to keep ring space available under
+ * load.
+ */
+#define INTEL_TX_REAP ( INTEL_NUM_TX_DESC / 2 )
+
 /** Number of transmit descriptors
  *
  * Descriptor ring length must be a multiple of 16.  ICH8/9/10
@@ -188,6 +259,15 @@ struct intel_descriptor {
 /** Maximum time to wait for queue disable, in milliseconds */
 #define INTEL_DISABLE_MAX_WAIT_MS 100
 
+/** Missed Packets Count */
+#define INTEL_MPC 0x04010UL
+
+/** Multicast Table Array */
+#define INTEL_MTA 0x05200UL
+
+/** Number of multicast table array registers */
+#define INTEL_MTA_COUNT 128
+
 /** Receive Address Low */
 #define INTEL_RAL0 0x05400UL
 
@@ -286,6 +366,8 @@ struct intel_nic {
 
 	/** EEPROM */
 	struct nvs_device eeprom;
+	/** EEPROM read-through cache */
+	uint16_t eeprom_cache[INTEL_EEPROM_MIN_SIZE_WORDS];
 	/** EEPROM done flag */
 	uint32_t eerd_done;
 	/** EEPROM address shift */
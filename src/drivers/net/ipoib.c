@@ -65,13 +65,24 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 			  "Missing REMAC for IPv4 packet (ARP sent)" )
 
 /** Number of IPoIB send work queue entries */
-#define IPOIB_NUM_SEND_WQES 8
+#ifndef IPOIB_NUM_SEND_WQES
+#define IPOIB_NUM_SEND_WQES 16
+#endif
 
-/** Number of IPoIB receive work queue entries */
-#define IPOIB_NUM_RECV_WQES 4
+/** Number of IPoIB receive work queue entries
+ *
+ * This must be deep enough to absorb a burst of back-to-back TCP
+ * segments between successive polls; high-rate fabrics overrun a
+ * shallower ring long before the TCP window becomes the bottleneck.
+ */
+#ifndef IPOIB_NUM_RECV_WQES
+#define IPOIB_NUM_RECV_WQES 16
+#endif
 
 /** Number of IPoIB completion entries */
-#define IPOIB_NUM_CQES 16
+#ifndef IPOIB_NUM_CQES
+#define IPOIB_NUM_CQES 32
+#endif
 
 /** An IPoIB broadcast address */
 struct ipoib_broadcast {
@@ -290,6 +290,20 @@ netfront_send_event ( struct netfront_nic *netfront ) {
 	return 0;
 }
 
+/**
+ * Send any pending event
+ *
+ * @v netfront		Netfront device
+ */
+static void netfront_notify ( struct netfront_nic *netfront ) {
+
+	/* Send event if applicable */
+	if ( netfront->notify ) {
+		netfront->notify = 0;
+		netfront_send_event ( netfront );
+	}
+}
+
 /**
  * Destroy event channel
  *
@@ -544,12 +558,12 @@ static void netfront_refill_rx ( struct net_device *netdev ) {
 
 	}
 
-	/* Push new descriptors and notify backend if applicable */
+	/* Push new descriptors and record pending notification */
 	if ( refilled ) {
 		RING_PUSH_REQUESTS_AND_CHECK_NOTIFY ( &netfront->rx_fring,
 						      notify );
 		if ( notify )
-			netfront_send_event ( netfront );
+			netfront->notify = 1;
 	}
 }
 
@@ -618,7 +632,9 @@ static int netfront_open ( struct net_device *netdev ) {
 	}
 
 	/* Refill receive descriptor ring */
+	netfront->notify = 0;
 	netfront_refill_rx ( netdev );
+	netfront_notify ( netfront );
 
 	/* Set link up */
 	netdev_link_up ( netdev );
@@ -730,10 +746,13 @@ static int netfront_transmit ( struct net_device *netdev,
 	/* Consume descriptor */
 	netfront->tx_fring.req_prod_pvt++;
 
-	/* Push new descriptor and notify backend if applicable */
+	/* Push new descriptor and record pending notification.  The
+	 * event itself is sent from netfront_poll(), so that a burst
+	 * of transmissions costs a single hypercall.
+	 */
 	RING_PUSH_REQUESTS_AND_CHECK_NOTIFY ( &netfront->tx_fring, notify );
 	if ( notify )
-		netfront_send_event ( netfront );
+		netfront->notify = 1;
 
 	return 0;
 }
@@ -823,6 +842,7 @@ static void netfront_poll_rx ( struct net_device *netdev ) {
  * @v netdev		Network device
  */
 static void netfront_poll ( struct net_device *netdev ) {
+	struct netfront_nic *netfront = netdev->priv;
 
 	/* Poll for TX completions */
 	netfront_poll_tx ( netdev );
@@ -832,6 +852,11 @@ static void netfront_poll ( struct net_device *netdev ) {
 
 	/* Refill RX descriptor ring */
 	netfront_refill_rx ( netdev );
+
+	/* Send (at most) one event covering this batch of
+	 * transmissions and refills
+	 */
+	netfront_notify ( netfront );
 }
 
 /** Network device operations */
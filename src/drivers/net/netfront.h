@@ -167,6 +167,14 @@ struct netfront_nic {
 
 	/** Event channel */
 	struct evtchn_send event;
+	/** Event channel notification is pending
+	 *
+	 * Notifications for transmitted packets and receive ring
+	 * refills are coalesced into (at most) a single event per poll
+	 * batch, since sending an event is a hypercall-priced
+	 * operation and both rings share one event channel.
+	 */
+	int notify;
 };
 
 /** Transmit shared ring field */
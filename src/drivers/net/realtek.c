@@ -35,6 +35,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/if_ether.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/malloc.h>
+#include <ipxe/dmapool.h>
 #include <ipxe/pci.h>
 #include <ipxe/nvs.h>
 #include <ipxe/threewire.h>
@@ -514,7 +515,7 @@ static int realtek_create_buffer ( struct realtek_nic *rtl ) {
 		return 0;
 
 	/* Allocate buffer */
-	rtl->rx_buffer = malloc_dma ( len, RTL_RXBUF_ALIGN );
+	rtl->rx_buffer = dma_pool_alloc ( len, RTL_RXBUF_ALIGN );
 	if ( ! rtl->rx_buffer ) {
 		rc = -ENOMEM;
 		goto err_alloc;
@@ -539,7 +540,7 @@ static int realtek_create_buffer ( struct realtek_nic *rtl ) {
 	return 0;
 
  err_64bit:
-	free_dma ( rtl->rx_buffer, len );
+	dma_pool_free ( rtl->rx_buffer, len );
 	rtl->rx_buffer = NULL;
  err_alloc:
 	return rc;
@@ -561,7 +562,7 @@ static void realtek_destroy_buffer ( struct realtek_nic *rtl ) {
 	writel ( 0, rtl->regs + RTL_RBSTART );
 
 	/* Free buffer */
-	free_dma ( rtl->rx_buffer, len );
+	dma_pool_free ( rtl->rx_buffer, len );
 	rtl->rx_buffer = NULL;
 	rtl->rx_offset = 0;
 }
@@ -582,7 +583,7 @@ static int realtek_create_ring ( struct realtek_nic *rtl,
 		return 0;
 
 	/* Allocate descriptor ring */
-	ring->desc = malloc_dma ( ring->len, RTL_RING_ALIGN );
+	ring->desc = dma_pool_alloc ( ring->len, RTL_RING_ALIGN );
 	if ( ! ring->desc )
 		return -ENOMEM;
 
@@ -623,7 +624,7 @@ static void realtek_destroy_ring ( struct realtek_nic *rtl,
 	writel ( 0, rtl->regs + ring->reg + 4 );
 
 	/* Free descriptor ring */
-	free_dma ( ring->desc, ring->len );
+	dma_pool_free ( ring->desc, ring->len );
 	ring->desc = NULL;
 }
 
@@ -635,7 +636,9 @@ static void realtek_destroy_ring ( struct realtek_nic *rtl,
 static void realtek_refill_rx ( struct realtek_nic *rtl ) {
 	struct realtek_descriptor *rx;
 	struct io_buffer *iobuf;
+	unsigned int refilled = 0;
 	unsigned int rx_idx;
+	unsigned int prod;
 	physaddr_t address;
 	int is_last;
 
@@ -643,37 +646,55 @@ static void realtek_refill_rx ( struct realtek_nic *rtl ) {
 	if ( rtl->legacy )
 		return;
 
+	/* Populate any empty descriptors, deferring the transfer of
+	 * ownership to the hardware.
+	 */
 	while ( ( rtl->rx.prod - rtl->rx.cons ) < RTL_NUM_RX_DESC ) {
 
 		/* Allocate I/O buffer */
 		iobuf = alloc_iob ( RTL_RX_MAX_LEN );
 		if ( ! iobuf ) {
 			/* Wait for next refill */
-			return;
+			break;
 		}
 
 		/* Get next receive descriptor */
 		rx_idx = ( rtl->rx.prod++ % RTL_NUM_RX_DESC );
-		is_last = ( rx_idx == ( RTL_NUM_RX_DESC - 1 ) );
 		rx = &rtl->rx.desc[rx_idx];
 
 		/* Populate receive descriptor */
 		address = virt_to_bus ( iobuf->data );
 		rx->address = cpu_to_le64 ( address );
 		rx->length = cpu_to_le16 ( RTL_RX_MAX_LEN );
-		wmb();
-		rx->flags = ( cpu_to_le16 ( RTL_DESC_OWN ) |
-			      ( is_last ? cpu_to_le16 ( RTL_DESC_EOR ) : 0 ) );
-		wmb();
 
 		/* Record I/O buffer */
 		assert ( rtl->rx_iobuf[rx_idx] == NULL );
 		rtl->rx_iobuf[rx_idx] = iobuf;
+		refilled++;
 
 		DBGC2 ( rtl, "REALTEK %p RX %d is [%llx,%llx)\n", rtl, rx_idx,
 			( ( unsigned long long ) address ),
 			( ( unsigned long long ) address + RTL_RX_MAX_LEN ) );
 	}
+
+	/* Do nothing more unless we refilled at least one descriptor */
+	if ( ! refilled )
+		return;
+
+	/* Transfer ownership of the whole batch to the hardware,
+	 * using a single barrier to order the descriptor writes
+	 * before the ownership bits.
+	 */
+	wmb();
+	for ( prod = ( rtl->rx.prod - refilled ) ; prod != rtl->rx.prod ;
+	      prod++ ) {
+		rx_idx = ( prod % RTL_NUM_RX_DESC );
+		is_last = ( rx_idx == ( RTL_NUM_RX_DESC - 1 ) );
+		rtl->rx.desc[rx_idx].flags =
+			( cpu_to_le16 ( RTL_DESC_OWN ) |
+			  ( is_last ? cpu_to_le16 ( RTL_DESC_EOR ) : 0 ) );
+	}
+	wmb();
 }
 
 /**
@@ -688,6 +709,14 @@ static int realtek_open ( struct net_device *netdev ) {
 	uint32_t rcr;
 	int rc;
 
+	/* Reset PHY and restart autonegotiation.  This is deferred
+	 * from probe time so that device registration remains fast,
+	 * and so that autonegotiation on multi-port systems proceeds
+	 * in parallel once the devices are opened.
+	 */
+	if ( ( rc = realtek_phy_reset ( rtl ) ) != 0 )
+		goto err_phy_reset;
+
 	/* Create transmit descriptor ring */
 	if ( ( rc = realtek_create_ring ( rtl, &rtl->tx ) ) != 0 )
 		goto err_create_tx;
@@ -738,6 +767,7 @@ static int realtek_open ( struct net_device *netdev ) {
  err_create_rx:
 	realtek_destroy_ring ( rtl, &rtl->tx );
  err_create_tx:
+ err_phy_reset:
 	return rc;
 }
 
@@ -1141,6 +1171,17 @@ static int realtek_probe ( struct pci_device *pci ) {
 	/* Detect device type */
 	realtek_detect ( rtl );
 
+	/* Allow the MTU to be raised to the limit of the receive
+	 * buffers, if built with buffers large enough for jumbo
+	 * frames.  The RX Packet Maximum Size register will already
+	 * have been programmed accordingly by realtek_detect(); on
+	 * devices lacking this register the standard limit applies.
+	 */
+	if ( rtl->have_phy_regs &&
+	     ( RTL_RX_MAX_LEN > ( ETH_FRAME_LEN + 4 /* VLAN */ + 4 /* CRC */ +
+				  4 /* extra space */ ) ) )
+		netdev->max_pkt_len = ( RTL_RX_MAX_LEN - 4 /* CRC */ );
+
 	/* Initialise EEPROM */
 	if ( rtl->eeprom.bus &&
 	     ( ( rc = realtek_init_eeprom ( netdev ) ) == 0 ) ) {
@@ -1163,11 +1204,12 @@ static int realtek_probe ( struct pci_device *pci ) {
 			netdev->hw_addr[i] = readb ( rtl->regs + RTL_IDR0 + i );
 	}
 
-	/* Initialise and reset MII interface */
+	/* Initialise MII interface.  The PHY itself is reset (and
+	 * autonegotiation restarted) when the device is opened, to
+	 * keep the probe path fast.
+	 */
 	mdio_init ( &rtl->mdio, &realtek_mii_operations );
 	mii_init ( &rtl->mii, &rtl->mdio, 0 );
-	if ( ( rc = realtek_phy_reset ( rtl ) ) != 0 )
-		goto err_phy_reset;
 
 	/* Register network device */
 	if ( ( rc = register_netdev ( netdev ) ) != 0 )
@@ -1188,7 +1230,6 @@ static int realtek_probe ( struct pci_device *pci ) {
  err_register_nvo:
 	unregister_netdev ( netdev );
  err_register_netdev:
- err_phy_reset:
  err_nvs_read:
 	realtek_reset ( rtl );
  err_reset:
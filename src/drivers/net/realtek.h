@@ -239,9 +239,17 @@ enum realtek_legacy_status {
 /** Number of receive descriptors */
 #define RTL_NUM_RX_DESC 4
 
-/** Receive buffer length */
+/** Receive buffer length
+ *
+ * Each received packet must fit within a single receive buffer.  May
+ * be overridden at build time (e.g. to 9216) to enable the use of
+ * jumbo frames on devices providing the RX Packet Maximum Size
+ * register (i.e. the 8169).
+ */
+#ifndef RTL_RX_MAX_LEN
 #define RTL_RX_MAX_LEN \
 	( ETH_FRAME_LEN + 4 /* VLAN */ + 4 /* CRC */ + 4 /* extra space */ )
+#endif
 
 /** A Realtek descriptor ring */
 struct realtek_ring {
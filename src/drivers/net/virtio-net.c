@@ -87,6 +87,9 @@ struct virtnet_nic {
 	/** 0 for legacy, 1 for virtio 1.0 */
 	int virtio_version;
 
+	/** Non-zero if VIRTIO_NET_F_MRG_RXBUF was negotiated */
+	int mrg_rxbuf;
+
 	/** Virtio 1.0 device data */
 	struct virtio_pci_modern_device vdev;
 
@@ -103,23 +106,38 @@ struct virtnet_nic {
 	struct virtio_net_hdr_modern empty_header[QUEUE_NB];
 };
 
+/** Virtio net header length
+ *
+ * @v virtnet		Virtio-net device
+ * @ret len		Length of the virtio net header
+ *
+ * The header includes the num_buffers field whenever mergeable receive
+ * buffers are negotiated (in both directions), and always for virtio
+ * 1.0 devices.
+ */
+static size_t virtnet_hdr_len ( struct virtnet_nic *virtnet ) {
+	if ( virtnet->mrg_rxbuf || virtnet->virtio_version )
+		return sizeof ( struct virtio_net_hdr_modern );
+	return sizeof ( struct virtio_net_hdr );
+}
+
 /** Add an iobuf to a virtqueue
  *
  * @v netdev		Network device
  * @v vq_idx		Virtqueue index (RX_INDEX or TX_INDEX)
  * @v iobuf		I/O buffer
+ * @v num_added		Number of buffers added since the last kick
  *
- * The virtqueue is kicked after the iobuf has been added.
+ * The caller is responsible for kicking the virtqueue, which allows a
+ * batch of buffers to be added with a single device notification.
  */
-static void virtnet_enqueue_iob ( struct net_device *netdev,
-				  int vq_idx, struct io_buffer *iobuf ) {
+static void virtnet_enqueue_iob ( struct net_device *netdev, int vq_idx,
+				  struct io_buffer *iobuf, int num_added ) {
 	struct virtnet_nic *virtnet = netdev->priv;
 	struct vring_virtqueue *vq = &virtnet->virtqueue[vq_idx];
 	struct virtio_net_hdr_modern *header = &virtnet->empty_header[vq_idx];
 	unsigned int out = ( vq_idx == TX_INDEX ) ? 2 : 0;
 	unsigned int in = ( vq_idx == TX_INDEX ) ? 0 : 2;
-	size_t header_len = ( virtnet->virtio_version ?
-			      sizeof ( *header ) : sizeof ( header->legacy ) );
 	struct vring_list list[] = {
 		{
 			/* Share a single zeroed virtio net header between all
@@ -133,7 +151,7 @@ static void virtnet_enqueue_iob ( struct net_device *netdev,
 			 * this by using separate RX and TX headers.
 			 */
 			.addr = ( char* ) header,
-			.length = header_len,
+			.length = virtnet_hdr_len ( virtnet ),
 		},
 		{
 			.addr = ( char* ) iobuf->data,
@@ -144,9 +162,16 @@ static void virtnet_enqueue_iob ( struct net_device *netdev,
 	DBGC2 ( virtnet, "VIRTIO-NET %p enqueuing iobuf %p on vq %d\n",
 		virtnet, iobuf, vq_idx );
 
-	vring_add_buf ( vq, list, out, in, iobuf, 0 );
-	vring_kick ( virtnet->virtio_version ? &virtnet->vdev : NULL,
-		     virtnet->ioaddr, vq, 1 );
+	if ( ( vq_idx == RX_INDEX ) && virtnet->mrg_rxbuf ) {
+		/* With mergeable receive buffers the device writes the
+		 * header inline at the start of the buffer, so each
+		 * buffer is a single descriptor.
+		 */
+		list[0] = list[1];
+		in = 1;
+	}
+
+	vring_add_buf ( vq, list, out, in, iobuf, num_added );
 }
 
 /** Try to keep rx virtqueue filled with iobufs
@@ -156,6 +181,11 @@ static void virtnet_enqueue_iob ( struct net_device *netdev,
 static void virtnet_refill_rx_virtqueue ( struct net_device *netdev ) {
 	struct virtnet_nic *virtnet = netdev->priv;
 	size_t len = ( netdev->max_pkt_len + 4 /* VLAN */ );
+	int added = 0;
+
+	/* Leave room for the inline header when using mergeable buffers */
+	if ( virtnet->mrg_rxbuf )
+		len += virtnet_hdr_len ( virtnet );
 
 	while ( virtnet->rx_num_iobufs < NUM_RX_BUF ) {
 		struct io_buffer *iobuf;
@@ -171,9 +201,16 @@ static void virtnet_refill_rx_virtqueue ( struct net_device *netdev ) {
 		/* Mark packet length until we know the actual size */
 		iob_put ( iobuf, len );
 
-		virtnet_enqueue_iob ( netdev, RX_INDEX, iobuf );
+		virtnet_enqueue_iob ( netdev, RX_INDEX, iobuf, added++ );
 		virtnet->rx_num_iobufs++;
 	}
+
+	/* Notify the device once for the whole batch */
+	if ( added ) {
+		vring_kick ( virtnet->virtio_version ? &virtnet->vdev : NULL,
+			     virtnet->ioaddr, &virtnet->virtqueue[RX_INDEX],
+			     added );
+	}
 }
 
 /** Helper to free all virtqueue memory
@@ -213,6 +250,19 @@ static int virtnet_open_legacy ( struct net_device *netdev ) {
 	if ( ! virtnet->virtqueue )
 		return -ENOMEM;
 
+	/* Negotiate features before posting any receive buffers, since
+	 * the negotiated feature set determines the receive buffer
+	 * layout.
+	 */
+	features = vp_get_features ( ioaddr );
+	vp_set_features ( ioaddr, features &
+			  ( ( 1 << VIRTIO_NET_F_MAC ) |
+			    ( 1 << VIRTIO_NET_F_MTU ) |
+			    ( 1 << VIRTIO_NET_F_MRG_RXBUF ) |
+			    ( 1 << VIRTIO_RING_F_INDIRECT_DESC ) ) );
+	virtnet->mrg_rxbuf = ( ( features &
+				 ( 1 << VIRTIO_NET_F_MRG_RXBUF ) ) != 0 );
+
 	/* Initialize rx/tx virtqueues */
 	for ( i = 0; i < QUEUE_NB; i++ ) {
 		if ( vp_find_vq ( ioaddr, i, &virtnet->virtqueue[i] ) == -1 ) {
@@ -221,6 +271,9 @@ static int virtnet_open_legacy ( struct net_device *netdev ) {
 			virtnet_free_virtqueues ( netdev );
 			return -ENOENT;
 		}
+		virtnet->virtqueue[i].use_indirect =
+			( ( features &
+			    ( 1 << VIRTIO_RING_F_INDIRECT_DESC ) ) != 0 );
 	}
 
 	/* Initialize rx packets */
@@ -232,9 +285,6 @@ static int virtnet_open_legacy ( struct net_device *netdev ) {
 	netdev_irq ( netdev, 0 );
 
 	/* Driver is ready */
-	features = vp_get_features ( ioaddr );
-	vp_set_features ( ioaddr, features & ( ( 1 << VIRTIO_NET_F_MAC ) |
-					       ( 1 << VIRTIO_NET_F_MTU ) ) );
 	vp_set_status ( ioaddr, VIRTIO_CONFIG_S_DRIVER | VIRTIO_CONFIG_S_DRIVER_OK );
 	return 0;
 }
@@ -248,6 +298,7 @@ static int virtnet_open_modern ( struct net_device *netdev ) {
 	struct virtnet_nic *virtnet = netdev->priv;
 	u64 features;
 	u8 status;
+	int i;
 
 	/* Negotiate features */
 	features = vpm_get_features ( &virtnet->vdev );
@@ -258,9 +309,13 @@ static int virtnet_open_modern ( struct net_device *netdev ) {
 	vpm_set_features ( &virtnet->vdev, features & (
 		( 1ULL << VIRTIO_NET_F_MAC ) |
 		( 1ULL << VIRTIO_NET_F_MTU ) |
+		( 1ULL << VIRTIO_NET_F_MRG_RXBUF ) |
 		( 1ULL << VIRTIO_F_VERSION_1 ) |
 		( 1ULL << VIRTIO_F_ANY_LAYOUT ) |
-		( 1ULL << VIRTIO_F_IOMMU_PLATFORM ) ) );
+		( 1ULL << VIRTIO_F_IOMMU_PLATFORM ) |
+		( 1ULL << VIRTIO_RING_F_INDIRECT_DESC ) ) );
+	virtnet->mrg_rxbuf = ( ( features &
+				 ( 1ULL << VIRTIO_NET_F_MRG_RXBUF ) ) != 0 );
 	vpm_add_status ( &virtnet->vdev, VIRTIO_CONFIG_S_FEATURES_OK );
 
 	status = vpm_get_status ( &virtnet->vdev );
@@ -287,6 +342,11 @@ static int virtnet_open_modern ( struct net_device *netdev ) {
 		vpm_add_status ( &virtnet->vdev, VIRTIO_CONFIG_S_FAILED );
 		return -ENOENT;
 	}
+	for ( i = 0; i < QUEUE_NB; i++ ) {
+		virtnet->virtqueue[i].use_indirect =
+			( ( features &
+			    ( 1ULL << VIRTIO_RING_F_INDIRECT_DESC ) ) != 0 );
+	}
 
 	/* Disable interrupts before starting */
 	netdev_irq ( netdev, 0 );
@@ -349,7 +409,11 @@ static void virtnet_close ( struct net_device *netdev ) {
  */
 static int virtnet_transmit ( struct net_device *netdev,
 			      struct io_buffer *iobuf ) {
-	virtnet_enqueue_iob ( netdev, TX_INDEX, iobuf );
+	struct virtnet_nic *virtnet = netdev->priv;
+
+	virtnet_enqueue_iob ( netdev, TX_INDEX, iobuf, 0 );
+	vring_kick ( virtnet->virtio_version ? &virtnet->vdev : NULL,
+		     virtnet->ioaddr, &virtnet->virtqueue[TX_INDEX], 1 );
 	return 0;
 }
 
@@ -382,6 +446,7 @@ static void virtnet_process_rx_packets ( struct net_device *netdev ) {
 	while ( vring_more_used ( rx_vq ) ) {
 		unsigned int len;
 		struct io_buffer *iobuf = vring_get_buf ( rx_vq, &len );
+		unsigned int drop = 0;
 
 		/* Release ownership of iobuf */
 		list_del ( &iobuf->list );
@@ -389,7 +454,38 @@ static void virtnet_process_rx_packets ( struct net_device *netdev ) {
 
 		/* Update iobuf length */
 		iob_unput ( iobuf, iob_len ( iobuf ) );
-		iob_put ( iobuf, len - sizeof ( struct virtio_net_hdr ) );
+		if ( virtnet->mrg_rxbuf ) {
+			struct virtio_net_hdr_modern *header = iobuf->data;
+
+			/* Header was written inline at the start of the
+			 * buffer; strip it off.
+			 */
+			iob_put ( iobuf, len );
+			if ( header->num_buffers > 1 )
+				drop = ( header->num_buffers - 1 );
+			iob_pull ( iobuf, sizeof ( *header ) );
+		} else {
+			/* Header was returned via its own descriptor */
+			iob_put ( iobuf, len - virtnet_hdr_len ( virtnet ) );
+		}
+
+		/* Every posted buffer is large enough to hold a
+		 * maximum-sized packet, so the device should never need
+		 * to merge buffers.  Drop the packet and any
+		 * continuation buffers if it does so anyway.
+		 */
+		if ( drop ) {
+			DBGC ( virtnet, "VIRTIO-NET %p dropping %d-buffer "
+			       "packet\n", virtnet, ( drop + 1 ) );
+			netdev_rx_err ( netdev, iobuf, -ENOTSUP );
+			while ( drop-- && vring_more_used ( rx_vq ) ) {
+				iobuf = vring_get_buf ( rx_vq, &len );
+				list_del ( &iobuf->list );
+				virtnet->rx_num_iobufs--;
+				netdev_rx_err ( netdev, iobuf, -ENOTSUP );
+			}
+			continue;
+		}
 
 		DBGC2 ( virtnet, "VIRTIO-NET %p rx complete iobuf %p len %zd\n",
 			virtnet, iobuf, iob_len ( iobuf ) );
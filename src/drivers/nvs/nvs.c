@@ -64,7 +64,7 @@ static size_t nvs_frag_len ( struct nvs_device *nvs, unsigned int address,
 }
 
 /**
- * Read from non-volatile storage device
+ * Read from non-volatile storage device, bypassing the cache
  *
  * @v nvs		NVS device
  * @v address		Address from which to read
@@ -72,16 +72,11 @@ static size_t nvs_frag_len ( struct nvs_device *nvs, unsigned int address,
  * @v len		Length of data buffer
  * @ret rc		Return status code
  */
-int nvs_read ( struct nvs_device *nvs, unsigned int address,
-	       void *data, size_t len ) {
+static int nvs_read_uncached ( struct nvs_device *nvs, unsigned int address,
+			       void *data, size_t len ) {
 	size_t frag_len;
 	int rc;
 
-	/* We don't even attempt to handle buffer lengths that aren't
-	 * an integral number of words.
-	 */
-	assert ( ( len & ( ( 1 << nvs->word_len_log2 ) - 1 ) ) == 0 );
-
 	while ( len ) {
 
 		/* Calculate length to read, stopping at block boundaries */
@@ -100,6 +95,56 @@ int nvs_read ( struct nvs_device *nvs, unsigned int address,
 	return 0;
 }
 
+/**
+ * Read from non-volatile storage device
+ *
+ * @v nvs		NVS device
+ * @v address		Address from which to read
+ * @v data		Data buffer
+ * @v len		Length of data buffer
+ * @ret rc		Return status code
+ */
+int nvs_read ( struct nvs_device *nvs, unsigned int address,
+	       void *data, size_t len ) {
+	unsigned int end;
+	int rc;
+
+	/* We don't even attempt to handle buffer lengths that aren't
+	 * an integral number of words.
+	 */
+	assert ( ( len & ( ( 1 << nvs->word_len_log2 ) - 1 ) ) == 0 );
+
+	/* Read directly from the device if the cache does not cover
+	 * the requested range.
+	 */
+	end = ( address + ( len >> nvs->word_len_log2 ) );
+	if ( ( ! nvs->cache ) || ( end > nvs->cache_size ) )
+		return nvs_read_uncached ( nvs, address, data, len );
+
+	/* Populate cache up to the end of the requested range.  The
+	 * cache always covers a contiguous range of words starting at
+	 * address zero, matching the access pattern of probe routines
+	 * reading MAC addresses and configuration words from the
+	 * start of an EEPROM.
+	 */
+	if ( end > nvs->cached ) {
+		if ( ( rc = nvs_read_uncached ( nvs, nvs->cached,
+						( nvs->cache +
+						  ( nvs->cached <<
+						    nvs->word_len_log2 ) ),
+						( ( end - nvs->cached ) <<
+						  nvs->word_len_log2 ) ) ) != 0 )
+			return rc;
+		nvs->cached = end;
+	}
+
+	/* Copy data from cache */
+	memcpy ( data, ( nvs->cache + ( address << nvs->word_len_log2 ) ),
+		 len );
+
+	return 0;
+}
+
 /**
  * Verify content of non-volatile storage device
  *
@@ -147,6 +192,10 @@ int nvs_write ( struct nvs_device *nvs, unsigned int address,
 	 */
 	assert ( ( len & ( ( 1 << nvs->word_len_log2 ) - 1 ) ) == 0 );
 
+	/* Discard any cached words that the write will make stale */
+	if ( nvs->cache && ( address < nvs->cached ) )
+		nvs->cached = address;
+
 	while ( len ) {
 
 		/* Calculate length to write, stopping at block boundaries */
@@ -188,7 +188,16 @@ static struct ifcommon_command_descriptor ifstat_cmd =
  * @ret rc		Return status code
  */
 static int ifstat_exec ( int argc, char **argv ) {
-	return ifcommon_exec ( argc, argv, &ifstat_cmd );
+	int rc;
+
+	/* Show per-device statistics */
+	if ( ( rc = ifcommon_exec ( argc, argv, &ifstat_cmd ) ) != 0 )
+		return rc;
+
+	/* Show global TCP statistics */
+	ifstat_tcp();
+
+	return 0;
 }
 
 /** "ifconf" options */
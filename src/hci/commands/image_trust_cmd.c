@@ -138,13 +138,10 @@ static int imgverify_exec ( int argc, char **argv ) {
 	if ( ( rc = imgacquire ( image_name_uri, opts.timeout, &image ) ) != 0 )
 		goto err_acquire_image;
 
-	/* Acquire the signature image */
-	if ( ( rc = imgacquire ( signature_name_uri, opts.timeout,
-				 &signature ) ) != 0 )
-		goto err_acquire_signature;
-
-	/* Verify image */
-	if ( ( rc = imgverify ( image, signature, opts.signer ) ) != 0 ) {
+	/* Verify image, downloading the signature as required */
+	if ( ( rc = imgverify_download ( image, signature_name_uri,
+					 opts.timeout, opts.signer,
+					 &signature ) ) != 0 ) {
 		printf ( "Could not verify: %s\n", strerror ( rc ) );
 		goto err_verify;
 	}
@@ -154,9 +151,8 @@ static int imgverify_exec ( int argc, char **argv ) {
 
  err_verify:
 	/* Discard signature unless --keep was specified */
-	if ( ! opts.keep )
+	if ( signature && ( ! opts.keep ) )
 		unregister_image ( signature );
- err_acquire_signature:
  err_acquire_image:
 	return rc;
 }
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <getopt.h>
+#include <ipxe/command.h>
+#include <ipxe/parseopt.h>
+#include <usr/pktcapmgmt.h>
+
+/** @file
+ *
+ * Packet capture command
+ *
+ */
+
+/** "pktcap" options */
+struct pktcap_options {};
+
+/** "pktcap" option list */
+static struct option_descriptor pktcap_opts[] = {};
+
+/** "pktcap" command descriptor */
+static struct command_descriptor pktcap_cmd =
+	COMMAND_DESC ( struct pktcap_options, pktcap_opts, 1, 1, "<uri>" );
+
+/**
+ * The "pktcap" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int pktcap_exec ( int argc, char **argv ) {
+	struct pktcap_options opts;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &pktcap_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Upload capture */
+	if ( ( rc = pktcap ( argv[optind] ) ) != 0 )
+		return rc;
+
+	return 0;
+}
+
+/** Packet capture command */
+struct command pktcap_command __command = {
+	.name = "pktcap",
+	.exec = pktcap_exec,
+};
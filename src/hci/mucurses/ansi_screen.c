@@ -1,8 +1,27 @@
+#include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <curses.h>
 #include <ipxe/ansicol.h>
 #include <ipxe/console.h>
 
+/** @file
+ *
+ * ANSI terminal screen driver
+ *
+ * Rendering is composed into an off-screen cell buffer and flushed to
+ * the terminal only when the application next waits for input (or
+ * exits).  The flush emits only the cells which differ from what is
+ * already displayed, coalescing changed cells into runs and avoiding
+ * cursor movement sequences where re-emitting a short unchanged run
+ * is cheaper.  This dramatically reduces the escape sequence volume
+ * for typical interactive UIs (e.g. menu redraws over serial-over-LAN
+ * consoles, where every output byte adds latency).
+ *
+ * If the cell buffers cannot be allocated, the driver falls back to
+ * direct per-character rendering.
+ */
+
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 static void ansiscr_reset(struct _curses_screen *scr) __nonnull;
@@ -12,6 +31,34 @@ static void ansiscr_putc(struct _curses_screen *scr, chtype c) __nonnull;
 
 static unsigned int saved_usage;
 
+/** Composed (desired) screen contents, or NULL for direct rendering */
+static chtype *ansiscr_video;
+
+/** Screen contents as currently displayed on the terminal */
+static chtype *ansiscr_shown;
+
+/** Cell buffer dimensions */
+static unsigned int ansiscr_rows, ansiscr_cols;
+
+/** Dirty row range [top,bottom) (empty if top >= bottom) */
+static unsigned int ansiscr_dirty_top, ansiscr_dirty_bottom;
+
+/** Hardware cursor position
+ *
+ * An X position equal to the number of columns indicates that the
+ * hardware cursor position is unknown (e.g. due to terminal-specific
+ * autowrap behaviour after writing to the last column).
+ */
+static unsigned int ansiscr_hw_x, ansiscr_hw_y;
+
+/** Approximate cost (in output bytes) of a cursor movement sequence
+ *
+ * When the gap between the hardware cursor and the next changed cell
+ * is shorter than this, it is cheaper to re-emit the intervening
+ * unchanged cells than to emit a movement sequence.
+ */
+#define ANSISCR_MOVE_COST 8
+
 static void ansiscr_attrs ( struct _curses_screen *scr, attr_t attrs ) {
 	int bold = ( attrs & A_BOLD );
 	attr_t cpair = PAIR_NUMBER ( attrs );
@@ -25,6 +72,100 @@ static void ansiscr_attrs ( struct _curses_screen *scr, attr_t attrs ) {
 	}
 }
 
+/**
+ * Fill both cell buffers (with no cells dirty)
+ *
+ * @v cell	Character rendition with which to fill
+ */
+static void ansiscr_fill ( chtype cell ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < ( ansiscr_rows * ansiscr_cols ) ; i++ ) {
+		ansiscr_video[i] = cell;
+		ansiscr_shown[i] = cell;
+	}
+	ansiscr_dirty_top = ansiscr_rows;
+	ansiscr_dirty_bottom = 0;
+}
+
+/**
+ * Emit a single cell at the hardware cursor position
+ *
+ * @v scr	screen on which to operate
+ * @v c		character rendition to emit
+ */
+static void ansiscr_emit ( struct _curses_screen *scr, chtype c ) {
+
+	ansiscr_attrs ( scr, ( c & ( A_ATTRIBUTES | A_COLOR ) ) );
+	putchar ( c & A_CHARTEXT );
+
+	/* Advance hardware cursor.  Autowrap behaviour after writing
+	 * to the last column varies between terminals; leave the
+	 * position marked as unknown.
+	 */
+	if ( ansiscr_hw_x < ansiscr_cols )
+		ansiscr_hw_x++;
+}
+
+/**
+ * Flush off-screen composition buffer to the terminal
+ *
+ * @v scr	screen on which to operate
+ *
+ * Emits only the cells which differ from what is currently displayed,
+ * and leaves the hardware cursor at the expected cursor position.
+ */
+static void ansiscr_flush ( struct _curses_screen *scr ) {
+	chtype *video;
+	chtype *shown;
+	unsigned int y;
+	unsigned int x;
+
+	/* Do nothing if rendering directly */
+	if ( ! ansiscr_video )
+		return;
+
+	for ( y = ansiscr_dirty_top ; y < ansiscr_dirty_bottom ; y++ ) {
+		video = &ansiscr_video[ y * ansiscr_cols ];
+		shown = &ansiscr_shown[ y * ansiscr_cols ];
+		if ( memcmp ( video, shown,
+			      ( ansiscr_cols * sizeof ( *video ) ) ) == 0 )
+			continue;
+		for ( x = 0 ; x < ansiscr_cols ; x++ ) {
+			if ( video[x] == shown[x] )
+				continue;
+			/* Position the hardware cursor, re-emitting a
+			 * short unchanged run in preference to a
+			 * movement sequence where cheaper.
+			 */
+			if ( ( ansiscr_hw_y == y ) && ( ansiscr_hw_x <= x ) &&
+			     ( ( x - ansiscr_hw_x ) < ANSISCR_MOVE_COST ) ) {
+				while ( ansiscr_hw_x < x )
+					ansiscr_emit ( scr,
+						       shown[ansiscr_hw_x] );
+			} else if ( ( ansiscr_hw_y != y ) ||
+				    ( ansiscr_hw_x != x ) ) {
+				printf ( "\033[%d;%dH", ( y + 1 ), ( x + 1 ) );
+				ansiscr_hw_y = y;
+				ansiscr_hw_x = x;
+			}
+			shown[x] = video[x];
+			ansiscr_emit ( scr, video[x] );
+		}
+	}
+	ansiscr_dirty_top = ansiscr_rows;
+	ansiscr_dirty_bottom = 0;
+
+	/* Leave the hardware cursor at the expected position */
+	if ( ( ansiscr_hw_x != scr->curs_x ) ||
+	     ( ansiscr_hw_y != scr->curs_y ) ) {
+		printf ( "\033[%d;%dH", ( scr->curs_y + 1 ),
+			 ( scr->curs_x + 1 ) );
+		ansiscr_hw_y = scr->curs_y;
+		ansiscr_hw_x = scr->curs_x;
+	}
+}
+
 static void ansiscr_reset ( struct _curses_screen *scr ) {
 	/* Reset terminal attributes and clear screen */
 	scr->attrs = 0;
@@ -33,14 +174,42 @@ static void ansiscr_reset ( struct _curses_screen *scr ) {
 	printf ( "\0330m" );
 	ansicol_set_pair ( CPAIR_DEFAULT );
 	printf ( "\033[2J" );
+	if ( ansiscr_video ) {
+		ansiscr_fill ( ' ' );
+		ansiscr_hw_x = 0;
+		ansiscr_hw_y = 0;
+	}
 }
 
 static void ansiscr_init ( struct _curses_screen *scr ) {
 	saved_usage = console_set_usage ( CONSOLE_USAGE_TUI );
+
+	/* Allocate composition buffers, falling back to direct
+	 * rendering on failure
+	 */
+	ansiscr_rows = LINES;
+	ansiscr_cols = COLS;
+	ansiscr_video = malloc ( ansiscr_rows * ansiscr_cols *
+				 sizeof ( *ansiscr_video ) );
+	ansiscr_shown = malloc ( ansiscr_rows * ansiscr_cols *
+				 sizeof ( *ansiscr_shown ) );
+	if ( ( ! ansiscr_video ) || ( ! ansiscr_shown ) ) {
+		free ( ansiscr_video );
+		free ( ansiscr_shown );
+		ansiscr_video = NULL;
+		ansiscr_shown = NULL;
+	}
+
 	ansiscr_reset ( scr );
 }
 
 static void ansiscr_exit ( struct _curses_screen *scr ) {
+	/* Free composition buffers (reverting to direct rendering) */
+	free ( ansiscr_video );
+	free ( ansiscr_shown );
+	ansiscr_video = NULL;
+	ansiscr_shown = NULL;
+
 	ansiscr_reset ( scr );
 	console_set_usage ( saved_usage );
 }
@@ -48,11 +217,19 @@ static void ansiscr_exit ( struct _curses_screen *scr ) {
 static void ansiscr_erase ( struct _curses_screen *scr, attr_t attrs ) {
 	ansiscr_attrs ( scr, attrs );
 	printf ( "\033[2J" );
+	if ( ansiscr_video )
+		ansiscr_fill ( ' ' | attrs );
 }
 
 static void ansiscr_movetoyx ( struct _curses_screen *scr,
 			       unsigned int y, unsigned int x ) {
-	if ( ( x != scr->curs_x ) || ( y != scr->curs_y ) ) {
+	if ( ansiscr_video ) {
+		/* Record expected position; the hardware cursor is
+		 * repositioned only when flushing
+		 */
+		scr->curs_x = x;
+		scr->curs_y = y;
+	} else if ( ( x != scr->curs_x ) || ( y != scr->curs_y ) ) {
 		/* ANSI escape sequence to update cursor position */
 		printf ( "\033[%d;%dH", ( y + 1 ), ( x + 1 ) );
 		scr->curs_x = x;
@@ -63,12 +240,37 @@ static void ansiscr_movetoyx ( struct _curses_screen *scr,
 static void ansiscr_putc ( struct _curses_screen *scr, chtype c ) {
 	unsigned int character = ( c & A_CHARTEXT );
 	attr_t attrs = ( c & ( A_ATTRIBUTES | A_COLOR ) );
+	chtype *cell;
 
-	/* Update attributes if changed */
-	ansiscr_attrs ( scr, attrs );
+	if ( ansiscr_video ) {
 
-	/* Print the actual character */
-	putchar ( character );
+		/* Compose into the off-screen buffer, marking the row
+		 * as dirty only if the cell actually changed
+		 */
+		if ( ( scr->curs_y < ansiscr_rows ) &&
+		     ( scr->curs_x < ansiscr_cols ) ) {
+			cell = &ansiscr_video[ ( scr->curs_y * ansiscr_cols ) +
+					       scr->curs_x ];
+			if ( *cell != c ) {
+				*cell = c;
+				if ( scr->curs_y < ansiscr_dirty_top )
+					ansiscr_dirty_top = scr->curs_y;
+				if ( ( scr->curs_y + 1 ) >
+				     ansiscr_dirty_bottom ) {
+					ansiscr_dirty_bottom =
+						( scr->curs_y + 1 );
+				}
+			}
+		}
+
+	} else {
+
+		/* Update attributes if changed */
+		ansiscr_attrs ( scr, attrs );
+
+		/* Print the actual character */
+		putchar ( character );
+	}
 
 	/* Update expected cursor position */
 	if ( ++(scr->curs_x) == COLS ) {
@@ -77,11 +279,13 @@ static void ansiscr_putc ( struct _curses_screen *scr, chtype c ) {
 	}
 }
 
-static int ansiscr_getc ( struct _curses_screen *scr __unused ) {
+static int ansiscr_getc ( struct _curses_screen *scr ) {
+	ansiscr_flush ( scr );
 	return getchar();
 }
 
-static bool ansiscr_peek ( struct _curses_screen *scr __unused ) {
+static bool ansiscr_peek ( struct _curses_screen *scr ) {
+	ansiscr_flush ( scr );
 	return iskey();
 }
 
@@ -63,6 +63,7 @@ int vw_printw ( WINDOW *win, const char *fmt, va_list varglist ) {
 
 	wctx.win = win;
 	wctx.ctx.handler = _printw_handler;
+	wctx.ctx.bulk = NULL;
 	vcprintf ( &(wctx.ctx), fmt, varglist );
 	return OK;
 }
@@ -30,6 +30,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/console.h>
 #include <ipxe/keys.h>
 #include <ipxe/editstring.h>
+#include <ipxe/command.h>
 #include <readline/readline.h>
 
 /** @file
@@ -78,6 +79,76 @@ static void sync_console ( struct edit_string *string ) {
 	}
 }
 
+/**
+ * Attempt command name completion
+ *
+ * @v prompt		Prompt string
+ * @v string		Editable string
+ * @ret sync		Console requires resynchronisation
+ *
+ * Completes the initial (command name) word of the edited line
+ * against the command table.  A unique match is completed in full; an
+ * ambiguous match is extended to the longest common prefix, with the
+ * candidate commands listed if no extension is possible.
+ */
+static int readline_complete ( const char *prompt,
+			       struct edit_string *string ) {
+	struct command *cmd;
+	struct command *match = NULL;
+	const char *buf = string->buf;
+	size_t len = strlen ( buf );
+	size_t common = 0;
+	unsigned int matches = 0;
+	size_t i;
+
+	/* Complete only a command name with the cursor at its end */
+	if ( ( len == 0 ) || ( string->cursor != len ) ||
+	     memchr ( buf, ' ', len ) )
+		return 0;
+
+	/* Identify matching commands and their longest common prefix */
+	for_each_table_entry ( cmd, COMMANDS ) {
+		if ( strncmp ( cmd->name, buf, len ) != 0 )
+			continue;
+		if ( matches == 0 ) {
+			common = strlen ( cmd->name );
+			match = cmd;
+		} else {
+			for ( i = len ; i < common ; i++ ) {
+				if ( cmd->name[i] != match->name[i] )
+					break;
+			}
+			common = i;
+		}
+		matches++;
+	}
+	if ( matches == 0 )
+		return 0;
+
+	/* Extend to longest common prefix (plus a trailing space for
+	 * a unique match), if possible.
+	 */
+	if ( ( common > len ) || ( matches == 1 ) ) {
+		char completed[ common + 1 /* space */ + 1 /* NUL */ ];
+
+		memcpy ( completed, match->name, common );
+		if ( matches == 1 )
+			completed[ common++ ] = ' ';
+		completed[common] = '\0';
+		replace_string ( string, completed );
+		return 1;
+	}
+
+	/* List candidate commands and redisplay the edited line */
+	putchar ( '\n' );
+	for_each_table_entry ( cmd, COMMANDS ) {
+		if ( strncmp ( cmd->name, buf, len ) == 0 )
+			printf ( "%s  ", cmd->name );
+	}
+	printf ( "\n%s%s", ( prompt ? prompt : "" ), buf );
+	return 0;
+}
+
 /**
  * Locate history entry
  *
@@ -304,6 +375,10 @@ int readline_history ( const char *prompt, const char *prefill,
 		case KEY_DOWN:
 			move_by = -1;
 			break;
+		case TAB:
+			if ( readline_complete ( prompt, &string ) )
+				sync_console ( &string );
+			break;
 		default:
 			/* Do nothing */
 			break;
@@ -174,17 +174,17 @@ static void draw_menu_items ( struct menu_ui *ui ) {
 static int menu_loop ( struct menu_ui *ui, struct menu_item **selected ) {
 	struct menu_item *item;
 	unsigned long timeout;
-	unsigned int previous;
+	unsigned int drawn;
 	int key;
 	int i;
 	int move;
 	int chosen = 0;
 	int rc = 0;
 
-	do {
-		/* Record current selection */
-		previous = ui->scroll.current;
+	/* Record currently-highlighted item (drawn by show_menu()) */
+	drawn = ui->scroll.current;
 
+	do {
 		/* Calculate timeout as remainder of current second */
 		timeout = ( ui->timeout % TICKS_PER_SEC );
 		if ( ( timeout == 0 ) && ( ui->timeout != 0 ) )
@@ -243,12 +243,21 @@ static int menu_loop ( struct menu_ui *ui, struct menu_item **selected ) {
 				break;
 		}
 
+		/* Coalesce type-ahead: if further keystrokes are
+		 * already waiting, process them before repainting, so
+		 * that rapid navigation (e.g. over a slow serial
+		 * console) skips the intermediate redraws.
+		 */
+		if ( ( rc == 0 ) && ( ! chosen ) && ( key >= 0 ) && iskey() )
+			continue;
+
 		/* Redraw selection if necessary */
-		if ( ( ui->scroll.current != previous ) || ( timeout != 0 ) ) {
-			draw_menu_item ( ui, previous );
+		if ( ( ui->scroll.current != drawn ) || ( timeout != 0 ) ) {
+			draw_menu_item ( ui, drawn );
 			if ( jump_scroll ( &ui->scroll ) )
 				draw_menu_items ( ui );
 			draw_menu_item ( ui, ui->scroll.current );
+			drawn = ui->scroll.current;
 		}
 
 		/* Record selection */
@@ -325,5 +325,7 @@ static int efi_image_probe ( struct image *image ) {
 struct image_type efi_image_type __image_type ( PROBE_NORMAL ) = {
 	.name = "EFI",
 	.probe = efi_image_probe,
+	.magic = "MZ",
+	.magic_len = 2,
 	.exec = efi_image_exec,
 };
@@ -238,5 +238,7 @@ static int pem_image_asn1 ( struct image *image, size_t offset,
 struct image_type pem_image_type __image_type ( PROBE_NORMAL ) = {
 	.name = "PEM",
 	.probe = pem_image_probe,
+	.magic = "-----BEGIN ",
+	.magic_len = 11,
 	.asn1 = pem_image_asn1,
 };
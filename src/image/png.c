@@ -31,6 +31,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/umalloc.h>
 #include <ipxe/pixbuf.h>
 #include <ipxe/deflate.h>
+#include <ipxe/profile.h>
 #include <ipxe/png.h>
 
 /** @file
@@ -86,6 +87,14 @@ struct png_interlace {
 /** PNG file signature */
 static struct png_signature png_signature = PNG_SIGNATURE;
 
+/** Unfiltering profiler */
+static struct profiler png_unfilter_profiler __profiler =
+	{ .name = "png.unfilter" };
+
+/** Pixel conversion profiler */
+static struct profiler png_pixels_profiler __profiler =
+	{ .name = "png.pixels" };
+
 /** Number of interlacing passes */
 static uint8_t png_interlace_passes[] = {
 	[PNG_INTERLACE_NONE] = 1,
@@ -352,71 +361,89 @@ static int png_image_data ( struct image *image, struct png_context *png,
 }
 
 /**
- * Unfilter byte using the "None" filter
+ * Unfilter scanline using the "None" filter
  *
- * @v current		Filtered current byte
- * @v left		Unfiltered left byte
- * @v above		Unfiltered above byte
- * @v above_left	Unfiltered above-left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered scanline (excluding filter type byte)
+ * @v above		Unfiltered previous scanline
+ * @v len		Length of scanline
+ * @v pixel_len		Length of a single pixel
  */
-static unsigned int png_unfilter_none ( unsigned int current,
-					unsigned int left __unused,
-					unsigned int above __unused,
-					unsigned int above_left __unused ) {
+static void png_unfilter_none ( uint8_t *current __unused,
+				const uint8_t *above __unused,
+				size_t len __unused,
+				size_t pixel_len __unused ) {
 
-	return current;
+	/* Nothing to do */
 }
 
 /**
- * Unfilter byte using the "Sub" filter
+ * Unfilter scanline using the "Sub" filter
  *
- * @v current		Filtered current byte
- * @v left		Unfiltered left byte
- * @v above		Unfiltered above byte
- * @v above_left	Unfiltered above-left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered scanline (excluding filter type byte)
+ * @v above		Unfiltered previous scanline
+ * @v len		Length of scanline
+ * @v pixel_len		Length of a single pixel
  */
-static unsigned int png_unfilter_sub ( unsigned int current,
-				       unsigned int left,
-				       unsigned int above __unused,
-				       unsigned int above_left __unused ) {
-
-	return ( current + left );
+static void png_unfilter_sub ( uint8_t *current,
+			       const uint8_t *above __unused,
+			       size_t len, size_t pixel_len ) {
+	size_t i;
+
+	/* Left bytes are taken to be zero for the first pixel */
+	for ( i = pixel_len ; i < len ; i++ )
+		current[i] += current[ i - pixel_len ];
 }
 
 /**
- * Unfilter byte using the "Up" filter
+ * Unfilter scanline using the "Up" filter
  *
- * @v current		Filtered current byte
- * @v left		Unfiltered left byte
- * @v above		Unfiltered above byte
- * @v above_left	Unfiltered above-left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered scanline (excluding filter type byte)
+ * @v above		Unfiltered previous scanline
+ * @v len		Length of scanline
+ * @v pixel_len		Length of a single pixel
  */
-static unsigned int png_unfilter_up ( unsigned int current,
-				      unsigned int left __unused,
-				      unsigned int above,
-				      unsigned int above_left __unused ) {
+static void png_unfilter_up ( uint8_t *current, const uint8_t *above,
+			      size_t len, size_t pixel_len __unused ) {
+	unsigned long *cword = ( ( unsigned long * ) current );
+	const unsigned long *aword = ( ( const unsigned long * ) above );
+	unsigned long mask = ( ( ~0UL / 0xff ) * 0x7f );
+	unsigned long c;
+	unsigned long a;
+	size_t i;
+
+	/* Byte lanes are independent, so add a word at a time with
+	 * the carry out of the top bit of each lane masked off.
+	 */
+	for ( i = 0 ; i < ( len / sizeof ( *cword ) ) ; i++ ) {
+		c = cword[i];
+		a = aword[i];
+		cword[i] = ( ( ( c & mask ) + ( a & mask ) ) ^
+			     ( ( c ^ a ) & ~mask ) );
+	}
 
-	return ( current + above );
+	/* Add any trailing bytes individually */
+	for ( i *= sizeof ( *cword ) ; i < len ; i++ )
+		current[i] += above[i];
 }
 
 /**
- * Unfilter byte using the "Average" filter
+ * Unfilter scanline using the "Average" filter
  *
- * @v current		Filtered current byte
- * @v left		Unfiltered left byte
- * @v above		Unfiltered above byte
- * @v above_left	Unfiltered above-left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered scanline (excluding filter type byte)
+ * @v above		Unfiltered previous scanline
+ * @v len		Length of scanline
+ * @v pixel_len		Length of a single pixel
  */
-static unsigned int png_unfilter_average ( unsigned int current,
-					   unsigned int left,
-					   unsigned int above,
-					   unsigned int above_left __unused ) {
-
-	return ( current + ( ( above + left ) >> 1 ) );
+static void png_unfilter_average ( uint8_t *current, const uint8_t *above,
+				   size_t len, size_t pixel_len ) {
+	size_t i;
+
+	/* Left bytes are taken to be zero for the first pixel */
+	for ( i = 0 ; i < pixel_len ; i++ )
+		current[i] += ( above[i] >> 1 );
+	for ( ; i < len ; i++ ) {
+		current[i] += ( ( current[ i - pixel_len ] + above[i] ) >> 1 );
+	}
 }
 
 /**
@@ -449,37 +476,42 @@ static unsigned int png_paeth_predictor ( unsigned int a, unsigned int b,
 }
 
 /**
- * Unfilter byte using the "Paeth" filter
+ * Unfilter scanline using the "Paeth" filter
  *
- * @v current		Filtered current byte
- * @v above_left	Unfiltered above-left byte
- * @v above		Unfiltered above byte
- * @v left		Unfiltered left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered scanline (excluding filter type byte)
+ * @v above		Unfiltered previous scanline
+ * @v len		Length of scanline
+ * @v pixel_len		Length of a single pixel
  */
-static unsigned int png_unfilter_paeth ( unsigned int current,
-					 unsigned int left,
-					 unsigned int above,
-					 unsigned int above_left ) {
+static void png_unfilter_paeth ( uint8_t *current, const uint8_t *above,
+				 size_t len, size_t pixel_len ) {
+	size_t i;
 
-	return ( current + png_paeth_predictor ( left, above, above_left ) );
+	/* Left and above-left bytes are taken to be zero for the
+	 * first pixel, for which the predictor therefore degenerates
+	 * to the above byte.
+	 */
+	for ( i = 0 ; i < pixel_len ; i++ )
+		current[i] += above[i];
+	for ( ; i < len ; i++ ) {
+		current[i] += png_paeth_predictor ( current[ i - pixel_len ],
+						    above[i],
+						    above[ i - pixel_len ] );
+	}
 }
 
 /** A PNG filter */
 struct png_filter {
 	/**
-	 * Unfilter byte
+	 * Unfilter scanline
 	 *
-	 * @v current		Filtered current byte
-	 * @v left		Unfiltered left byte
-	 * @v above		Unfiltered above byte
-	 * @v above_left	Unfiltered above-left byte
-	 * @ret current		Unfiltered current byte
+	 * @v current		Filtered scanline (excluding filter type byte)
+	 * @v above		Unfiltered previous scanline
+	 * @v len		Length of scanline
+	 * @v pixel_len		Length of a single pixel
 	 */
-	unsigned int ( * unfilter ) ( unsigned int current,
-				      unsigned int left,
-				      unsigned int above,
-				      unsigned int above_left );
+	void ( * unfilter ) ( uint8_t *current, const uint8_t *above,
+			      size_t len, size_t pixel_len );
 };
 
 /** PNG filter types */
@@ -507,19 +539,34 @@ static int png_unfilter_pass ( struct image *image, struct png_context *png,
 	size_t offset = png->raw.offset;
 	size_t pixel_len = png_pixel_len ( png );
 	size_t scanline_len = png_scanline_len ( png, interlace );
+	size_t len = ( scanline_len - 1 /* filter type byte */ );
 	struct png_filter *filter;
 	unsigned int scanline;
-	unsigned int byte;
 	uint8_t filter_type;
-	uint8_t left;
-	uint8_t above;
-	uint8_t above_left;
-	uint8_t current;
+	uint8_t *lines;
+	uint8_t *current;
+	uint8_t *above;
+	uint8_t *tmp;
+	int rc;
+
+	/* Allocate scanline buffers.  Operating on buffered scanlines
+	 * (rather than on individual bytes within the raw data
+	 * buffer) requires only a single copy in each direction per
+	 * scanline, and allows the filters themselves to work on
+	 * directly addressable memory.
+	 */
+	lines = malloc ( 2 * len );
+	if ( ! lines ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	current = lines;
+	above = ( lines + len );
 
 	/* On the first scanline of a pass, above bytes are assumed to
 	 * be zero.
 	 */
-	above = 0;
+	memset ( above, 0, len );
 
 	/* Iterate over each scanline in turn */
 	for ( scanline = 0 ; scanline < interlace->height ; scanline++ ) {
@@ -531,54 +578,36 @@ static int png_unfilter_pass ( struct image *image, struct png_context *png,
 				      sizeof ( png_filters[0] ) ) ) {
 			DBGC ( image, "PNG %s unknown filter type %d\n",
 			       image->name, filter_type );
-			return -ENOTSUP;
+			rc = -ENOTSUP;
+			goto err_filter_type;
 		}
 		filter = &png_filters[filter_type];
 		assert ( filter->unfilter != NULL );
 		DBGC2 ( image, "PNG %s pass %d scanline %d filter type %d\n",
 			image->name, interlace->pass, scanline, filter_type );
 
-		/* At the start of a line, both above-left and left
-		 * bytes are taken to be zero.
-		 */
-		left = 0;
-		above_left = 0;
-
-		/* Iterate over each byte (not pixel) in turn */
-		for ( byte = 0 ; byte < ( scanline_len - 1 ) ; byte++ ) {
-
-			/* Extract predictor bytes, if applicable */
-			if ( byte >= pixel_len ) {
-				copy_from_user ( &left, png->raw.data,
-						 ( offset - pixel_len ),
-						 sizeof ( left ) );
-			}
-			if ( scanline > 0 ) {
-				copy_from_user ( &above, png->raw.data,
-						 ( offset - scanline_len ),
-						 sizeof ( above ) );
-			}
-			if ( ( scanline > 0 ) && ( byte >= pixel_len ) ) {
-				copy_from_user ( &above_left, png->raw.data,
-						 ( offset - scanline_len -
-						   pixel_len ),
-						 sizeof ( above_left ) );
-			}
+		/* Unfilter scanline */
+		copy_from_user ( current, png->raw.data, offset, len );
+		filter->unfilter ( current, above, len, pixel_len );
+		copy_to_user ( png->raw.data, offset, current, len );
+		offset += len;
 
-			/* Unfilter current byte */
-			copy_from_user ( &current, png->raw.data,
-					 offset, sizeof ( current ) );
-			current = filter->unfilter ( current, left, above,
-						     above_left );
-			copy_to_user ( png->raw.data, offset++,
-				       &current, sizeof ( current ) );
-		}
+		/* Current scanline becomes the next scanline's above */
+		tmp = current;
+		current = above;
+		above = tmp;
 	}
 
 	/* Update offset */
 	png->raw.offset = offset;
 
-	return 0;
+	/* Success */
+	rc = 0;
+
+ err_filter_type:
+	free ( lines );
+ err_alloc:
+	return rc;
 }
 
 /**
@@ -656,6 +685,7 @@ static void png_pixels_pass ( struct image *image,
 	int is_indexed = ( png->colour_type & PNG_COLOUR_TYPE_PALETTE );
 	int is_rgb = ( png->colour_type & PNG_COLOUR_TYPE_RGB );
 	int has_alpha = ( png->colour_type & PNG_COLOUR_TYPE_ALPHA );
+	uint32_t *row;
 	size_t pixbuf_y_offset;
 	size_t pixbuf_offset;
 	size_t pixbuf_x_stride;
@@ -693,6 +723,16 @@ static void png_pixels_pass ( struct image *image,
 		interlace->height, interlace->x_indent, interlace->y_indent,
 		interlace->x_stride, interlace->y_stride );
 
+	/* Allocate a row buffer if output pixels are horizontally
+	 * contiguous (as they always are for non-interlaced images),
+	 * allowing each completed row to be written to the pixel
+	 * buffer in a single operation.  Fall back to storing pixels
+	 * individually if allocation fails, since this routine is not
+	 * permitted to fail.
+	 */
+	row = ( ( interlace->x_stride == 1 ) ?
+		malloc ( interlace->width * sizeof ( row[0] ) ) : NULL );
+
 	/* Iterate over each scanline in turn */
 	for ( y = 0 ; y < interlace->height ; y++ ) {
 
@@ -746,15 +786,28 @@ static void png_pixels_pass ( struct image *image,
 			}
 
 			/* Store pixel */
-			copy_to_user ( png->pixbuf->data, pixbuf_offset,
-				       &pixel, sizeof ( pixel ) );
-			pixbuf_offset += pixbuf_x_stride;
+			if ( row ) {
+				row[x] = pixel;
+			} else {
+				copy_to_user ( png->pixbuf->data,
+					       pixbuf_offset, &pixel,
+					       sizeof ( pixel ) );
+				pixbuf_offset += pixbuf_x_stride;
+			}
+		}
+
+		/* Write out completed row, if applicable */
+		if ( row ) {
+			copy_to_user ( png->pixbuf->data, pixbuf_y_offset, row,
+				       ( interlace->width * sizeof ( row[0] )));
 		}
 
 		/* Move to next output row */
 		pixbuf_y_offset += pixbuf_y_stride;
 	}
 
+	free ( row );
+
 	/* Update offset */
 	png->raw.offset = raw_offset;
 }
@@ -826,11 +879,15 @@ static int png_image_end ( struct image *image, struct png_context *png,
 	}
 
 	/* Unfilter raw data */
+	profile_start ( &png_unfilter_profiler );
 	if ( ( rc = png_unfilter ( image, png ) ) != 0 )
 		return rc;
+	profile_stop ( &png_unfilter_profiler );
 
 	/* Fill pixel buffer */
+	profile_start ( &png_pixels_profiler );
 	png_pixels ( image, png );
+	profile_stop ( &png_pixels_profiler );
 
 	return 0;
 }
@@ -1007,5 +1064,7 @@ static int png_probe ( struct image *image ) {
 struct image_type png_image_type __image_type ( PROBE_NORMAL ) = {
 	.name = "PNG",
 	.probe = png_probe,
+	.magic = &png_signature,
+	.magic_len = sizeof ( png_signature ),
 	.pixbuf = png_pixbuf,
 };
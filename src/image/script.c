@@ -39,86 +39,141 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/command.h>
 #include <ipxe/parseopt.h>
 #include <ipxe/image.h>
+#include <ipxe/monojob.h>
 #include <ipxe/shell.h>
 #include <usr/prompt.h>
 #include <ipxe/script.h>
 
-/** Offset within current script
+/** A parsed script line */
+struct script_line {
+	/** Label (if any), or NULL */
+	const char *label;
+	/** Command */
+	const char *command;
+	/** Offset of line within parsed script */
+	size_t offset;
+};
+
+/** A parsed script
+ *
+ * A script is parsed in a single pass when execution begins: lines
+ * are split (handling CR and backslash continuations) and labels are
+ * identified up front, so that executing each line and processing
+ * "goto" both become simple array operations.  Setting expansion is
+ * still performed by system() as each line is executed.
+ */
+struct script {
+	/** Copy of script contents, split into NUL-terminated lines */
+	char *data;
+	/** Parsed lines */
+	struct script_line *lines;
+	/** Number of lines */
+	unsigned int count;
+};
+
+/** Currently-executing script
+ *
+ * This is a global in order to allow goto_exec() to locate labels
+ * within the current script.
+ */
+static struct script *script_current;
+
+/** Index of next line to execute within current script
  *
  * This is a global in order to allow goto_exec() to update the
- * offset.
+ * position.
+ */
+static unsigned int script_next;
+
+/** Currently executing a "par" block
+ *
+ * This is a global in order to allow par_exec() and endpar_exec() to
+ * share state with the currently-executing script.
  */
-static size_t script_offset;
+static int script_par;
 
 /**
- * Process script lines
+ * Parse script
  *
  * @v image		Script
- * @v process_line	Line processor
- * @v terminate		Termination check
+ * @v script		Parsed script to fill in
  * @ret rc		Return status code
  */
-static int process_script ( struct image *image,
-			    int ( * process_line ) ( struct image *image,
-						     size_t offset,
-						     const char *label,
-						     const char *command ),
-			    int ( * terminate ) ( int rc ) ) {
-	size_t len = 0;
-	char *line = NULL;
-	size_t line_offset;
-	char *label;
+static int script_parse ( struct image *image, struct script *script ) {
+	struct script_line *line;
+	unsigned int count;
+	size_t len;
+	char *data;
+	char *in;
+	char *out;
+	char *start;
 	char *command;
-	off_t eol;
-	size_t frag_len;
-	char *tmp;
+	char *label;
 	int rc;
 
-	/* Initialise script and line offsets */
-	script_offset = 0;
-	line_offset = 0;
-
-	do {
-
-		/* Find length of next line, excluding any terminating '\n' */
-		eol = memchr_user ( image->data, script_offset, '\n',
-				    ( image->len - script_offset ) );
-		if ( eol < 0 )
-			eol = image->len;
-		frag_len = ( eol - script_offset );
+	/* Allocate copy of script contents (with space for a
+	 * terminating newline, if not already present).
+	 */
+	data = malloc ( image->len + 1 /* possible terminating '\n' */ );
+	if ( ! data ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	copy_from_user ( data, image->data, 0, image->len );
+	len = image->len;
+	if ( ( len == 0 ) || ( data[ len - 1 ] != '\n' ) )
+		data[len++] = '\n';
 
-		/* Allocate buffer for line */
-		tmp = realloc ( line, ( len + frag_len + 1 /* NUL */ ) );
-		if ( ! tmp ) {
-			rc = -ENOMEM;
-			goto err_alloc;
+	/* Split into NUL-terminated lines, stripping trailing CRs
+	 * and joining backslash continuations, and count lines.
+	 */
+	out = data;
+	start = out;
+	count = 0;
+	for ( in = data ; in < ( data + len ) ; in++ ) {
+
+		/* Accumulate bytes until end of line */
+		if ( *in != '\n' ) {
+			*out++ = *in;
+			continue;
 		}
-		line = tmp;
-
-		/* Copy line */
-		copy_from_user ( ( line + len ), image->data, script_offset,
-				 frag_len );
-		len += frag_len;
-
-		/* Move to next line in script */
-		script_offset += ( frag_len + 1 );
 
 		/* Strip trailing CR, if present */
-		if ( len && ( line[ len - 1 ] == '\r' ) )
-			len--;
+		if ( ( out > start ) && ( out[ -1 ] == '\r' ) )
+			out--;
 
 		/* Handle backslash continuations */
-		if ( len && ( line[ len - 1 ] == '\\' ) ) {
-			len--;
-			rc = -EINVAL;
+		if ( ( out > start ) && ( out[ -1 ] == '\\' ) ) {
+			out--;
 			continue;
 		}
 
 		/* Terminate line */
-		line[len] = '\0';
+		*out++ = '\0';
+		count++;
+		start = out;
+	}
 
-		/* Split line into (optional) label and command */
-		command = line;
+	/* Fail if script ends with a backslash continuation */
+	if ( out != start ) {
+		rc = -EINVAL;
+		goto err_continuation;
+	}
+
+	/* Allocate parsed lines */
+	script->lines = malloc ( count * sizeof ( script->lines[0] ) );
+	if ( ! script->lines ) {
+		rc = -ENOMEM;
+		goto err_alloc_lines;
+	}
+	script->data = data;
+	script->count = count;
+
+	/* Split each line into (optional) label and command */
+	start = data;
+	for ( line = script->lines ; line < &script->lines[count] ; line++ ) {
+		line->offset = ( start - data );
+		command = start;
 		while ( isspace ( *command ) )
 			command++;
 		if ( *command == ':' ) {
@@ -130,61 +185,29 @@ static int process_script ( struct image *image,
 		} else {
 			label = NULL;
 		}
+		line->label = label;
+		line->command = command;
+		start += ( strlen ( start ) + 1 /* NUL */ );
+	}
 
-		/* Process line */
-		rc = process_line ( image, line_offset, label, command );
-		if ( terminate ( rc ) )
-			goto err_process;
-
-		/* Free line */
-		free ( line );
-		line = NULL;
-		len = 0;
-
-		/* Update line offset */
-		line_offset = script_offset;
-
-	} while ( script_offset < image->len );
+	return 0;
 
- err_process:
+ err_alloc_lines:
+ err_continuation:
+	free ( data );
  err_alloc:
-	free ( line );
 	return rc;
 }
 
 /**
- * Terminate script processing on shell exit or command failure
- *
- * @v rc		Line processing status
- * @ret terminate	Terminate script processing
- */
-static int terminate_on_exit_or_failure ( int rc ) {
-
-	return ( shell_stopped ( SHELL_STOP_COMMAND_SEQUENCE ) ||
-		 ( rc != 0 ) );
-}
-
-/**
- * Execute script line
+ * Free parsed script
  *
- * @v image		Script
- * @v offset		Offset within script
- * @v label		Label, or NULL
- * @v command		Command
- * @ret rc		Return status code
+ * @v script		Parsed script
  */
-static int script_exec_line ( struct image *image, size_t offset,
-			      const char *label __unused,
-			      const char *command ) {
-	int rc;
-
-	DBGC ( image, "[%04zx] $ %s\n", offset, command );
+static void script_free ( struct script *script ) {
 
-	/* Execute command */
-	if ( ( rc = system ( command ) ) != 0 )
-		return rc;
-
-	return 0;
+	free ( script->lines );
+	free ( script->data );
 }
 
 /**
@@ -194,28 +217,61 @@ static int script_exec_line ( struct image *image, size_t offset,
  * @ret rc		Return status code
  */
 static int script_exec ( struct image *image ) {
-	size_t saved_offset;
+	struct script script;
+	struct script *saved_script;
+	struct script_line *line;
+	unsigned int saved_next;
+	int saved_par;
 	int rc;
 
+	/* Parse script */
+	if ( ( rc = script_parse ( image, &script ) ) != 0 )
+		goto err_parse;
+
 	/* Temporarily de-register image, so that a "boot" command
 	 * doesn't throw us into an execution loop.
 	 */
 	unregister_image ( image );
 
 	/* Preserve state of any currently-running script */
-	saved_offset = script_offset;
+	saved_script = script_current;
+	saved_next = script_next;
+	saved_par = script_par;
+	script_current = &script;
+	script_next = 0;
+	script_par = 0;
+
+	/* Execute each line in turn */
+	while ( script_next < script.count ) {
+
+		/* Execute line */
+		line = &script.lines[ script_next++ ];
+		DBGC ( image, "[%04zx] $ %s\n", line->offset, line->command );
+		rc = system ( line->command );
+
+		/* Terminate on shell exit or command failure */
+		if ( shell_stopped ( SHELL_STOP_COMMAND_SEQUENCE ) ||
+		     ( rc != 0 ) )
+			break;
+	}
 
-	/* Process script */
-	rc = process_script ( image, script_exec_line,
-			      terminate_on_exit_or_failure );
+	/* Join any unterminated "par" block, so that deferred jobs
+	 * cannot outlive the script that started them.
+	 */
+	if ( script_par )
+		monojob_join ( NULL );
 
 	/* Restore saved state */
-	script_offset = saved_offset;
+	script_current = saved_script;
+	script_next = saved_next;
+	script_par = saved_par;
 
 	/* Re-register image (unless we have been replaced) */
 	if ( ! image->replacement )
 		register_image ( image );
 
+	script_free ( &script );
+ err_parse:
 	return rc;
 }
 
@@ -255,6 +311,8 @@ static int script_probe ( struct image *image ) {
 struct image_type script_image_type __image_type ( PROBE_NORMAL ) = {
 	.name = "script",
 	.probe = script_probe,
+	.magic = "#!ipxe",
+	.magic_len = 6,
 	.exec = script_exec,
 };
 
@@ -269,95 +327,156 @@ static struct command_descriptor goto_cmd =
 	COMMAND_DESC ( struct goto_options, goto_opts, 1, 1, "<label>" );
 
 /**
- * Current "goto" label
- *
- * Valid only during goto_exec().  Consider this part of a closure.
- */
-static const char *goto_label;
-
-/**
- * Check for presence of label
+ * "goto" command
  *
- * @v image		Script
- * @v offset		Offset within script
- * @v label		Label
- * @v command		Command
+ * @v argc		Argument count
+ * @v argv		Argument list
  * @ret rc		Return status code
  */
-static int goto_find_label ( struct image *image, size_t offset,
-			     const char *label, const char *command __unused ) {
+static int goto_exec ( int argc, char **argv ) {
+	struct goto_options opts;
+	struct script_line *line;
+	const char *label;
+	unsigned int i;
+	int rc;
 
-	/* Check label exists */
-	if ( ! label )
-		return -ENOENT;
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &goto_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Sanity check */
+	if ( ! script_current ) {
+		rc = -ENOTTY;
+		printf ( "Not in a script: %s\n", strerror ( rc ) );
+		return rc;
+	}
 
-	/* Check label matches */
-	if ( strcmp ( goto_label, label ) != 0 )
-		return -ENOENT;
+	/* Parse label */
+	label = argv[optind];
 
-	/* Update script offset */
-	script_offset = offset;
-	DBGC ( image, "[%04zx] Gone to :%s\n", offset, label );
+	/* Find label within parsed script */
+	for ( i = 0 ; i < script_current->count ; i++ ) {
+		line = &script_current->lines[i];
+		if ( line->label && ( strcmp ( line->label, label ) == 0 ) ) {
 
-	return 0;
-}
+			/* Resume execution from the labelled line */
+			script_next = i;
+			DBGC ( current_image, "[%04zx] Gone to :%s\n",
+			       line->offset, label );
 
-/**
- * Terminate script processing when label is found
- *
- * @v rc		Line processing status
- * @ret terminate	Terminate script processing
- */
-static int terminate_on_label_found ( int rc ) {
-	return ( rc == 0 );
+			/* Terminate processing of current command */
+			shell_stop ( SHELL_STOP_COMMAND );
+
+			return 0;
+		}
+	}
+
+	DBGC ( current_image, "No such label :%s\n", label );
+	return -ENOENT;
 }
 
+/** "goto" command */
+struct command goto_command __command = {
+	.name = "goto",
+	.exec = goto_exec,
+};
+
+/** "par" options */
+struct par_options {};
+
+/** "par" option list */
+static struct option_descriptor par_opts[] = {};
+
+/** "par" command descriptor */
+static struct command_descriptor par_cmd =
+	COMMAND_DESC ( struct par_options, par_opts, 0, 0, NULL );
+
 /**
- * "goto" command
+ * "par" command
  *
  * @v argc		Argument count
  * @v argv		Argument list
  * @ret rc		Return status code
+ *
+ * Commands between "par" and "endpar" have their foreground jobs
+ * deferred and allowed to run concurrently, so that independent
+ * network waits (e.g. DHCP on a second interface, an NTP sync and the
+ * main download) overlap instead of executing back to back.  The
+ * block is joined, and any job failure reported, at "endpar".
  */
-static int goto_exec ( int argc, char **argv ) {
-	struct goto_options opts;
-	size_t saved_offset;
+static int par_exec ( int argc, char **argv ) {
+	struct par_options opts;
 	int rc;
 
 	/* Parse options */
-	if ( ( rc = parse_options ( argc, argv, &goto_cmd, &opts ) ) != 0 )
+	if ( ( rc = parse_options ( argc, argv, &par_cmd, &opts ) ) != 0 )
 		return rc;
 
 	/* Sanity check */
-	if ( ! current_image ) {
+	if ( ! script_current ) {
 		rc = -ENOTTY;
 		printf ( "Not in a script: %s\n", strerror ( rc ) );
 		return rc;
 	}
 
-	/* Parse label */
-	goto_label = argv[optind];
-
-	/* Find label */
-	saved_offset = script_offset;
-	if ( ( rc = process_script ( current_image, goto_find_label,
-				     terminate_on_label_found ) ) != 0 ) {
-		script_offset = saved_offset;
-		DBGC ( current_image, "[%04zx] No such label :%s\n",
-		       script_offset, goto_label );
+	/* Begin deferring foreground jobs */
+	if ( ( rc = monojob_defer() ) != 0 ) {
+		printf ( "Could not begin \"par\" block: %s\n",
+			 strerror ( rc ) );
 		return rc;
 	}
-
-	/* Terminate processing of current command */
-	shell_stop ( SHELL_STOP_COMMAND );
+	script_par = 1;
 
 	return 0;
 }
 
-/** "goto" command */
-struct command goto_command __command = {
-	.name = "goto",
-	.exec = goto_exec,
+/** "par" command */
+struct command par_command __command = {
+	.name = "par",
+	.exec = par_exec,
+};
+
+/** "endpar" options */
+struct endpar_options {};
+
+/** "endpar" option list */
+static struct option_descriptor endpar_opts[] = {};
+
+/** "endpar" command descriptor */
+static struct command_descriptor endpar_cmd =
+	COMMAND_DESC ( struct endpar_options, endpar_opts, 0, 0, NULL );
+
+/**
+ * "endpar" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int endpar_exec ( int argc, char **argv ) {
+	struct endpar_options opts;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &endpar_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Sanity check */
+	if ( ! script_par ) {
+		rc = -ENOTTY;
+		printf ( "Not in a \"par\" block: %s\n", strerror ( rc ) );
+		return rc;
+	}
+
+	/* Wait for all deferred jobs to complete */
+	script_par = 0;
+	return monojob_join ( "Waiting" );
+}
+
+/** "endpar" command */
+struct command endpar_command __command = {
+	.name = "endpar",
+	.exec = endpar_exec,
 };
 
 /** "prompt" options */
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/**
+ * @file
+ *
+ * Zstandard compressed images
+ *
+ * Executing a Zstandard compressed image decompresses it into a new
+ * image which inherits the original's name, command line and flags.
+ * If the decompressed image is itself executable (e.g. a compressed
+ * kernel or script), execution tail-recurses into it via the standard
+ * replacement mechanism, so "chain image.zst" behaves as expected.
+ * Non-executable payloads (e.g. compressed initrds) simply replace
+ * the original image under the same name, ready to be consumed by a
+ * subsequent boot.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <byteswap.h>
+#include <ipxe/image.h>
+#include <ipxe/uaccess.h>
+#include <ipxe/umalloc.h>
+#include <ipxe/zstd.h>
+
+/**
+ * Execute (i.e. decompress) Zstandard image
+ *
+ * @v image		Zstandard image
+ * @ret rc		Return status code
+ */
+static int zstdimg_exec ( struct image *image ) {
+	struct image *zimage;
+	userptr_t workspace;
+	userptr_t data;
+	size_t len;
+	size_t out_len;
+	int rc;
+
+	/* Determine decompressed length */
+	if ( ( rc = zstd_decompressed_len ( user_to_virt ( image->data, 0 ),
+					    image->len, &len ) ) != 0 ) {
+		printf ( "Could not parse compressed image: %s\n",
+			 strerror ( rc ) );
+		goto err_len;
+	}
+	if ( ! len ) {
+		rc = -EINVAL;
+		goto err_len;
+	}
+
+	/* Allocate decompression buffer and workspace */
+	data = umalloc ( len );
+	if ( ! data ) {
+		rc = -ENOMEM;
+		goto err_data;
+	}
+	workspace = umalloc ( sizeof ( struct zstd ) );
+	if ( ! workspace ) {
+		rc = -ENOMEM;
+		goto err_workspace;
+	}
+
+	/* Decompress image */
+	if ( ( rc = zstd_decompress ( user_to_virt ( workspace, 0 ),
+				      user_to_virt ( image->data, 0 ),
+				      image->len, user_to_virt ( data, 0 ),
+				      len, &out_len ) ) != 0 ) {
+		printf ( "Could not decompress image: %s\n", strerror ( rc ) );
+		goto err_decompress;
+	}
+	ufree ( workspace );
+
+	/* Construct replacement image */
+	zimage = alloc_image ( image->uri );
+	if ( ! zimage ) {
+		rc = -ENOMEM;
+		goto err_alloc_image;
+	}
+	zimage->data = data;
+	zimage->len = out_len;
+	zimage->flags |= ( image->flags &
+			   ( IMAGE_TRUSTED | IMAGE_AUTO_UNREGISTER ) );
+	if ( image->cmdline &&
+	     ( ( rc = image_set_cmdline ( zimage, image->cmdline ) ) != 0 ) )
+		goto err_copy;
+
+	/* Unregister the compressed image first, so that the
+	 * decompressed image can take over its name.
+	 */
+	unregister_image ( image );
+	if ( ( rc = image_set_name ( zimage, image->name ) ) != 0 )
+		goto err_copy;
+	if ( ( rc = register_image ( zimage ) ) != 0 )
+		goto err_copy;
+
+	/* Tail-recurse into the decompressed image, if executable */
+	if ( zimage->type && zimage->type->exec )
+		image->replacement = zimage;
+
+	image_put ( zimage );
+	return 0;
+
+ err_copy:
+	/* Decompressed data is freed along with the replacement image */
+	image_put ( zimage );
+	return rc;
+ err_alloc_image:
+	ufree ( data );
+	return rc;
+ err_decompress:
+	ufree ( workspace );
+ err_workspace:
+	ufree ( data );
+ err_data:
+ err_len:
+	return rc;
+}
+
+/**
+ * Probe Zstandard image
+ *
+ * @v image		Zstandard image
+ * @ret rc		Return status code
+ */
+static int zstdimg_probe ( struct image *image ) {
+	uint32_t magic;
+
+	/* Check magic number */
+	if ( image->len < sizeof ( magic ) )
+		return -ENOEXEC;
+	copy_from_user ( &magic, image->data, 0, sizeof ( magic ) );
+	if ( le32_to_cpu ( magic ) != ZSTD_MAGIC )
+		return -ENOEXEC;
+
+	return 0;
+}
+
+/** Zstandard image type */
+struct image_type zstdimg_image_type __image_type ( PROBE_NORMAL ) = {
+	.name = "zstd",
+	.probe = zstdimg_probe,
+	.magic = "\x28\xb5\x2f\xfd",
+	.magic_len = 4,
+	.exec = zstdimg_exec,
+};
@@ -34,6 +34,13 @@ struct asn1_builder {
 	void *data;
 	/** Length of data */
 	size_t len;
+	/** Length of allocated buffer
+	 *
+	 * The buffer is grown in amortised chunks so that building an
+	 * object from multiple prepended components does not require
+	 * a reallocation (and copy) per component.
+	 */
+	size_t max_len;
 };
 
 /** Maximum (viable) length of ASN.1 length
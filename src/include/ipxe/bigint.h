@@ -221,6 +221,25 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 		bigint_t ( size * 2 ) temp_modulus;			\
 	} ); } )
 
+/**
+ * Calculate temporary working space required for Montgomery multiplication
+ *
+ * @v modulus		Big integer modulus
+ * @ret len		Length of temporary working space
+ */
+#define bigint_montgomery_tmp_len( modulus ) ( {			\
+	unsigned int size = bigint_size (modulus);			\
+	sizeof ( struct {						\
+		bigint_t ( size * 2 ) temp_product;			\
+		bigint_t ( size ) temp_low;				\
+		bigint_t ( size * 2 + 1 ) temp_sum;			\
+		bigint_t ( size * 2 + 1 ) temp_addend;			\
+		bigint_t ( size + 1 ) temp_modulus;			\
+	} ); } )
+
+/** Modular exponentiation sliding window size, in bits */
+#define BIGINT_MOD_EXP_WINDOW 4
+
 /**
  * Perform modular exponentiation of big integers
  *
@@ -250,10 +269,17 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 	unsigned int exponent_size = bigint_size (exponent);		\
 	size_t mod_multiply_len =					\
 		bigint_mod_multiply_tmp_len (modulus);			\
+	size_t montgomery_len = bigint_montgomery_tmp_len (modulus);	\
 	sizeof ( struct {						\
 		bigint_t ( size ) temp_base;				\
 		bigint_t ( exponent_size ) temp_exponent;		\
-		uint8_t mod_multiply[mod_multiply_len];			\
+		bigint_t ( size ) temp_residue;				\
+		bigint_t ( size )					\
+			temp_power[ 1 << ( BIGINT_MOD_EXP_WINDOW - 1 ) ];\
+		union {							\
+			uint8_t mod_multiply[mod_multiply_len];		\
+			uint8_t montgomery[montgomery_len];		\
+		} temp_sub;						\
 	} ); } )
 
 #include <bits/bigint.h>
@@ -0,0 +1,14 @@
+#ifndef _IPXE_BOOTMETRICS_H
+#define _IPXE_BOOTMETRICS_H
+
+/** @file
+ *
+ * Boot metrics collection
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+extern void bootmetrics_mark ( const char *phase );
+
+#endif /* _IPXE_BOOTMETRICS_H */
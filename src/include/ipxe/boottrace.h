@@ -0,0 +1,33 @@
+#ifndef _IPXE_BOOTTRACE_H
+#define _IPXE_BOOTTRACE_H
+
+/** @file
+ *
+ * Boot timeline tracing
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+struct setting;
+
+/** Number of events in the boot timeline ring */
+#define BOOTTRACE_EVENTS 32
+
+/** Maximum length of a boot timeline event name (including NUL) */
+#define BOOTTRACE_NAME_LEN 24
+
+/** A boot timeline event */
+struct boottrace_event {
+	/** Timestamp (in ticks) */
+	unsigned long ticks;
+	/** Event name */
+	char name[BOOTTRACE_NAME_LEN];
+};
+
+extern void boottrace_mark ( const char *fmt, ... )
+	__attribute__ (( format ( printf, 1, 2 ) ));
+extern void boottrace_show ( void );
+extern const struct setting boottrace_setting;
+
+#endif /* _IPXE_BOOTTRACE_H */
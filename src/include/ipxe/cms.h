@@ -33,6 +33,14 @@ struct cms_signer_info {
 	void *signature;
 	/** Length of signature */
 	size_t signature_len;
+
+	/** Incremental digest context (if any)
+	 *
+	 * Allocated by cms_digest_init() to allow the signed data to
+	 * be digested in advance of (or in parallel with)
+	 * verification.
+	 */
+	void *digest_ctx;
 };
 
 /** A CMS signature */
@@ -69,6 +77,12 @@ cms_put ( struct cms_signature *sig ) {
 
 extern int cms_signature ( const void *data, size_t len,
 			   struct cms_signature **sig );
+extern int cms_digest_init ( struct cms_signature *sig );
+extern int cms_digest_resume ( struct cms_signature *sig,
+			       struct digest_algorithm *digest,
+			       const void *ctx );
+extern void cms_digest_update ( struct cms_signature *sig, userptr_t data,
+				size_t offset, size_t len );
 extern int cms_verify ( struct cms_signature *sig, userptr_t data, size_t len,
 			const char *name, time_t time, struct x509_chain *store,
 			struct x509_root *root );
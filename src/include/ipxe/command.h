@@ -23,6 +23,7 @@ struct command {
 
 #define __command __table_entry ( COMMANDS, 01 )
 
+extern struct command * find_command ( const char *name );
 extern char * concat_args ( char **args );
 
 #endif /* _IPXE_COMMAND_H */
@@ -3,7 +3,7 @@
 
 /** @file
  *
- * DEFLATE decompression algorithm
+ * DEFLATE compression and decompression algorithms
  *
  */
 
@@ -81,6 +81,9 @@ enum deflate_format {
 /** Quick lookup shift */
 #define DEFLATE_HUFFMAN_QL_SHIFT ( 16 - DEFLATE_HUFFMAN_QL_BITS )
 
+/** Quick lookup direct symbol length shift */
+#define DEFLATE_HUFFMAN_QL_DIRECT_SHIFT 12
+
 /** Literal/length end of block code */
 #define DEFLATE_LITLEN_END 256
 
@@ -136,6 +139,13 @@ struct deflate_alphabet {
 	struct deflate_huf_symbols huf[DEFLATE_HUFFMAN_BITS];
 	/** Quick lookup table */
 	uint8_t lookup[ 1 << DEFLATE_HUFFMAN_QL_BITS ];
+	/** Quick lookup direct symbol table
+	 *
+	 * Each entry maps a bit-reversed prefix to a raw symbol and
+	 * its Huffman-coded symbol length, or is zero if the symbol
+	 * is longer than the prefix.
+	 */
+	uint16_t direct[ 1 << DEFLATE_HUFFMAN_QL_BITS ];
 	/** Raw symbols
 	 *
 	 * Ordered by Huffman-coded symbol length, then by symbol
@@ -164,12 +174,12 @@ struct deflate {
 	enum deflate_format format;
 
 	/** Accumulator */
-	uint32_t accumulator;
+	uint64_t accumulator;
 	/** Bit-reversed accumulator
 	 *
 	 * Don't ask.
 	 */
-	uint32_t rotalumucca;
+	uint64_t rotalumucca;
 	/** Number of bits within the accumulator */
 	unsigned int bits;
 
@@ -280,4 +290,61 @@ extern int deflate_inflate ( struct deflate *deflate,
 			     struct deflate_chunk *in,
 			     struct deflate_chunk *out );
 
+/** Compressor match window length
+ *
+ * This is a policy decision.  A larger window improves the
+ * compression ratio at the cost of a larger compressor state
+ * structure.
+ */
+#define DEFLATE_COMPRESS_WINDOW 4096
+
+/** Compressor hash table length (in bits)
+ *
+ * This is a policy decision.
+ */
+#define DEFLATE_COMPRESS_HASH_BITS 10
+
+/** Compressor hash table length */
+#define DEFLATE_COMPRESS_HASH_SIZE ( 1 << DEFLATE_COMPRESS_HASH_BITS )
+
+/** Compressor */
+struct deflate_compress {
+	/** Format */
+	enum deflate_format format;
+	/** Stream and block headers have been written */
+	int started;
+	/** Accumulator */
+	uint32_t accumulator;
+	/** Number of bits within the accumulator */
+	unsigned int bits;
+	/** ADLER32 checksum state */
+	uint32_t checksum;
+	/** Match window */
+	uint8_t window[DEFLATE_COMPRESS_WINDOW];
+	/** Hash table of most recent sequence positions within window */
+	uint16_t hash[DEFLATE_COMPRESS_HASH_SIZE];
+};
+
+/**
+ * Calculate worst-case compressed length
+ *
+ * @v len		Uncompressed length
+ * @ret bound		Maximum possible compressed length
+ *
+ * Incompressible data expands to at most nine bits per input byte,
+ * plus a fixed overhead for the stream header, end of block marker,
+ * and checksum.
+ */
+static inline size_t deflate_compress_bound ( size_t len ) {
+	return ( len + ( len / 8 ) + 18 );
+}
+
+extern void deflate_compress_init ( struct deflate_compress *defcom,
+				    enum deflate_format format );
+extern int deflate_compress ( struct deflate_compress *defcom,
+			      struct deflate_chunk *in,
+			      struct deflate_chunk *out );
+extern int deflate_compress_finish ( struct deflate_compress *defcom,
+				     struct deflate_chunk *out );
+
 #endif /* _IPXE_DEFLATE_H */
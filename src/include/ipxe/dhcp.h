@@ -501,6 +501,14 @@ struct dhcp_netdev_desc {
  */
 #define DHCP_EB_GID DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xc3 )
 
+/** Boot metrics collector
+ *
+ * This is the URL to which compact boot metrics records will be
+ * POSTed as each boot phase completes, if boot metrics collection is
+ * enabled at build time.
+ */
+#define DHCP_EB_METRICS DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xc4 )
+
 /** iPXE version number */
 #define DHCP_EB_VERSION DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xeb )
 
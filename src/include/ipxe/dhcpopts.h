@@ -26,6 +26,17 @@ struct dhcp_options {
 	 * @ret rc		Return status code
 	 */
 	int ( * realloc ) ( struct dhcp_options *options, size_t len );
+	/** Option offset index is valid */
+	int indexed;
+	/** Option offset index
+	 *
+	 * Offset (plus one) of the first instance of each top-level
+	 * option, indexed by tag.  A zero entry indicates an absent
+	 * option.  The index is built lazily on first lookup and
+	 * invalidated by any modification of the option block,
+	 * avoiding a linear walk of the block for every fetch.
+	 */
+	uint16_t offsets[256];
 };
 
 extern int dhcpopt_applies ( unsigned int tag );
@@ -0,0 +1,17 @@
+#ifndef _IPXE_DMAPOOL_H
+#define _IPXE_DMAPOOL_H
+
+/** @file
+ *
+ * DMA block pool
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+
+extern void * __malloc dma_pool_alloc ( size_t size, size_t align );
+extern void dma_pool_free ( void *ptr, size_t size );
+
+#endif /* _IPXE_DMAPOOL_H */
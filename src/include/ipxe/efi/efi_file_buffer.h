@@ -0,0 +1,34 @@
+#ifndef _IPXE_FILE_BUFFER_H
+#define _IPXE_FILE_BUFFER_H
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * iPXE file buffer information
+ *
+ * Images exposed via iPXE's EFI_SIMPLE_FILE_SYSTEM_PROTOCOL instance
+ * already exist in memory as single contiguous buffers.  A consumer
+ * may retrieve this structure via EFI_FILE_PROTOCOL.GetInfo() (using
+ * IPXE_FILE_BUFFER_GUID as the information type) and use the file's
+ * data in place, rather than copying it out via Read().
+ *
+ * The buffer remains valid until the file system protocol instance is
+ * uninstalled (i.e. until the loaded image returns or iPXE shuts
+ * down).
+ */
+
+/** iPXE file buffer information GUID */
+#define IPXE_FILE_BUFFER_GUID \
+	{ 0x59ca8892, 0x8a1c, 0x4f85, \
+	  { 0xb1, 0x77, 0x96, 0xd0, 0xd5, 0x6e, 0x2f, 0x31 } }
+
+/** iPXE file buffer information */
+typedef struct {
+	/** Physical address of the file data */
+	UINT64 Buffer;
+	/** Length of the file data, in bytes */
+	UINT64 Length;
+} IPXE_FILE_BUFFER;
+
+#endif /* _IPXE_FILE_BUFFER_H */
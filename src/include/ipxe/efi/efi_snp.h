@@ -23,6 +23,16 @@ FILE_LICENCE ( GPL2_OR_LATER );
 /** SNP transmit completion ring size */
 #define EFI_SNP_NUM_TX 32
 
+/** SNP receive queue maximum length
+ *
+ * Polling harvests all frames available from the driver in one batch,
+ * so that a consumer calling Receive() repeatedly can drain the queue
+ * without re-entering the driver for each frame.  The queue is capped
+ * to bound memory consumption under a slow consumer; the oldest
+ * frames are dropped first.
+ */
+#define EFI_SNP_NUM_RX 32
+
 /** An SNP device */
 struct efi_snp_device {
 	/** List of SNP devices */
@@ -49,6 +59,8 @@ struct efi_snp_device {
 	unsigned int tx_cons;
 	/** Receive queue */
 	struct list_head rx;
+	/** Receive queue length */
+	unsigned int rx_count;
 	/** The network interface identifier */
 	EFI_NETWORK_INTERFACE_IDENTIFIER_PROTOCOL nii;
 	/** Component name protocol */
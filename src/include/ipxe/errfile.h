@@ -284,6 +284,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define ERRFILE_xsigo			( ERRFILE_NET | 0x00480000 )
 #define ERRFILE_ntp			( ERRFILE_NET | 0x00490000 )
 #define ERRFILE_httpntlm		( ERRFILE_NET | 0x004a0000 )
+#define ERRFILE_httpmulti		( ERRFILE_NET | 0x004b0000 )
+#define ERRFILE_ftpmulti		( ERRFILE_NET | 0x004c0000 )
+#define ERRFILE_nvmetcp			( ERRFILE_NET | 0x004d0000 )
 
 #define ERRFILE_image		      ( ERRFILE_IMAGE | 0x00000000 )
 #define ERRFILE_elf		      ( ERRFILE_IMAGE | 0x00010000 )
@@ -379,6 +382,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define ERRFILE_acpi_settings	      ( ERRFILE_OTHER | 0x00500000 )
 #define ERRFILE_ntlm		      ( ERRFILE_OTHER | 0x00510000 )
 #define ERRFILE_efi_blacklist	      ( ERRFILE_OTHER | 0x00520000 )
+#define ERRFILE_deflate_compress      ( ERRFILE_OTHER | 0x00530000 )
 
 /** @} */
 
@@ -140,6 +140,13 @@ struct fbcon {
 	struct ansiesc_context ctx;
 	/** Text array */
 	struct fbcon_text text;
+	/** Drawn text array
+	 *
+	 * Records the cell most recently drawn at each position, so
+	 * that full-screen redraws can skip cells whose on-screen
+	 * content is already correct.
+	 */
+	struct fbcon_text drawn;
 	/** Background picture */
 	struct fbcon_picture picture;
 	/** Display cursor */
@@ -248,6 +248,14 @@ struct fc_responder {
  ******************************************************************************
  */
 
+/** Number of hash buckets for active exchanges
+ *
+ * Must be a power of two.  Each received frame requires an exchange
+ * lookup, so bucket chains are kept short to avoid walking every
+ * active exchange per frame at high queue depths.
+ */
+#define FC_XCHG_BUCKETS 16
+
 /** A Fibre Channel port */
 struct fc_port {
 	/** Reference count */
@@ -282,8 +290,8 @@ struct fc_port {
 	/** Name server PLOGI interface */
 	struct interface ns_plogi;
 
-	/** List of active exchanges */
-	struct list_head xchgs;
+	/** Hash table of active exchanges, indexed by local exchange ID */
+	struct list_head xchgs[FC_XCHG_BUCKETS];
 };
 
 /** Fibre Channel port flags */
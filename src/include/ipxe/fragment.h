@@ -17,14 +17,39 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Fragment reassembly timeout */
 #define FRAGMENT_TIMEOUT ( TICKS_PER_SEC / 2 )
 
+/** Number of fragment reassembly hash buckets
+ *
+ * Must be a power of two.  Each received fragment requires a
+ * reassembly buffer lookup, so lookups are kept to a short bucket
+ * chain even when many datagrams are in flight.
+ */
+#define FRAGMENT_BUCKETS 8
+
+/** Maximum total memory consumed by reassembly buffers
+ *
+ * When exceeded, the least recently active reassembly buffer is
+ * discarded, so that a fragment storm cannot exhaust the heap.
+ */
+#define FRAGMENT_MAX_MEM 65536
+
+/** Maximum memory consumed by reassembly buffers for a single source */
+#define FRAGMENT_MAX_SOURCE_MEM ( FRAGMENT_MAX_MEM / 4 )
+
+/** Maximum number of concurrent reassembly buffers for a single source */
+#define FRAGMENT_MAX_PER_SOURCE 4
+
 /** A fragment reassembly buffer */
 struct fragment {
-	/* List of fragment reassembly buffers */
+	/* Hash bucket of fragment reassembly buffers */
 	struct list_head list;
+	/** Least recently active list of fragment reassembly buffers */
+	struct list_head lru;
 	/** Reassembled packet */
 	struct io_buffer *iobuf;
 	/** Length of non-fragmentable portion of reassembled packet */
 	size_t hdrlen;
+	/** Accounted memory consumption */
+	size_t used;
 	/** Reassembly timer */
 	struct retry_timer timer;
 	/** Fragment reassembler */
@@ -33,8 +58,15 @@ struct fragment {
 
 /** A fragment reassembler */
 struct fragment_reassembler {
-	/** List of fragment reassembly buffers */
-	struct list_head list;
+	/** Hash buckets of fragment reassembly buffers
+	 *
+	 * Initialised on first use.
+	 */
+	struct list_head buckets[FRAGMENT_BUCKETS];
+	/** Least recently active list of fragment reassembly buffers */
+	struct list_head lru;
+	/** Total accounted memory consumption */
+	size_t used;
 	/**
 	 * Check if fragment matches fragment reassembly buffer
 	 *
@@ -45,6 +77,25 @@ struct fragment_reassembler {
 	 */
 	int ( * is_fragment ) ( struct fragment *fragment,
 				struct io_buffer *iobuf, size_t hdrlen );
+	/**
+	 * Check if fragment comes from the same source
+	 *
+	 * @v fragment		Fragment reassembly buffer
+	 * @v iobuf		I/O buffer
+	 * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+	 * @ret is_same		Fragment comes from the same source
+	 */
+	int ( * is_same_source ) ( struct fragment *fragment,
+				   struct io_buffer *iobuf, size_t hdrlen );
+	/**
+	 * Calculate fragment hash
+	 *
+	 * @v iobuf		I/O buffer
+	 * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+	 * @ret hash		Hash value (not reduced to a bucket index)
+	 */
+	unsigned int ( * fragment_hash ) ( struct io_buffer *iobuf,
+					   size_t hdrlen );
 	/**
 	 * Get fragment offset
 	 *
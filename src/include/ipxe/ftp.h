@@ -9,7 +9,23 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+#include <stddef.h>
+#include <ipxe/interface.h>
+#include <ipxe/uri.h>
+
 /** FTP default port */
 #define FTP_PORT 21
 
+/** An FTP request content range */
+struct ftp_request_range {
+	/** Start offset */
+	size_t start;
+	/** Length (or zero to transfer to end of file) */
+	size_t len;
+};
+
+extern int ftp_open ( struct interface *xfer, struct uri *uri,
+		      struct ftp_request_range *range );
+extern int ftp_size ( struct interface *xfer, struct uri *uri );
+
 #endif /* _IPXE_FTP_H */
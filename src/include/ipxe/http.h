@@ -114,18 +114,31 @@ extern struct http_method http_post;
  ******************************************************************************
  */
 
-/** HTTP Digest authentication client nonce count
+/** HTTP Digest authentication initial nonce count
  *
  * We choose to generate a new client nonce each time.
  */
 #define HTTP_DIGEST_NC "00000001"
 
+/** HTTP Digest authentication nonce count length
+ *
+ * The nonce count is a 32-bit hex value.
+ */
+#define HTTP_DIGEST_NC_LEN 8
+
 /** HTTP Digest authentication client nonce length
  *
  * We choose to use a 32-bit hex client nonce.
  */
 #define HTTP_DIGEST_CNONCE_LEN 8
 
+/** HTTP Digest authentication cached session parameter length
+ *
+ * Sized to accommodate the realm, nonce, and other parameters copied
+ * from a cached authentication session.
+ */
+#define HTTP_DIGEST_SESSION_LEN 512
+
 /** HTTP Digest authentication response length
  *
  * The Digest authentication response is a Base16-encoded 16-byte MD5
@@ -167,10 +180,21 @@ struct http_request_auth_digest {
 	const char *qop;
 	/** Algorithm */
 	const char *algorithm;
+	/** Authentication was preempted from a cached session */
+	int preempted;
+	/** Nonce count */
+	char nc[ HTTP_DIGEST_NC_LEN + 1 /* NUL */ ];
 	/** Client nonce */
 	char cnonce[ HTTP_DIGEST_CNONCE_LEN + 1 /* NUL */ ];
 	/** Response */
 	char response[ HTTP_DIGEST_RESPONSE_LEN + 1 /* NUL */ ];
+	/** Copied session parameters for preemptive authentication
+	 *
+	 * Holds NUL-separated copies of the cached realm, nonce, and
+	 * other parameters, so that the transaction does not retain
+	 * pointers into the (mutable) session cache.
+	 */
+	char session[HTTP_DIGEST_SESSION_LEN];
 };
 
 /** HTTP request NTLM authentication descriptor */
@@ -216,6 +240,10 @@ struct http_request {
 	const char *uri;
 	/** Server host name */
 	const char *host;
+	/** Entity tag to validate against, for a conditional request
+	 * (if any)
+	 */
+	const char *etag;
 	/** Range descriptor */
 	struct http_request_range range;
 	/** Content descriptor */
@@ -263,6 +291,13 @@ struct http_response_transfer {
 struct http_response_content {
 	/** Content length (may be zero) */
 	size_t len;
+	/** Total entity length (if known)
+	 *
+	 * This is the complete length of the entity as reported via a
+	 * "Content-Range" header, and may exceed the content length
+	 * of this individual (partial) response.
+	 */
+	size_t total;
 	/** Content encoding */
 	struct http_content_encoding *encoding;
 };
@@ -340,6 +375,8 @@ struct http_response {
 	int rc;
 	/** Redirection location */
 	const char *location;
+	/** Entity tag (if any) */
+	const char *etag;
 	/** Transfer descriptor */
 	struct http_response_transfer transfer;
 	/** Content descriptor */
@@ -360,6 +397,10 @@ enum http_response_flags {
 	HTTP_RESPONSE_CONTENT_LEN = 0x0002,
 	/** Transaction may be retried on failure */
 	HTTP_RESPONSE_RETRY = 0x0004,
+	/** Content has not been modified since last retrieved */
+	HTTP_RESPONSE_NOT_MODIFIED = 0x0008,
+	/** Content range (and hence total entity length) specified */
+	HTTP_RESPONSE_CONTENT_RANGE = 0x0010,
 };
 
 /** An HTTP response header */
@@ -540,6 +581,16 @@ struct http_authentication {
 	 */
 	int ( * format ) ( struct http_transaction *http, char *buf,
 			   size_t len );
+	/** Preempt authentication for a new request (optional)
+	 *
+	 * @v http		HTTP transaction
+	 * @ret rc		Return status code
+	 *
+	 * Allows a scheme to authenticate the request from a cached
+	 * session before the initial transmission, avoiding the
+	 * unauthorised-response round trip.
+	 */
+	int ( * preempt ) ( struct http_transaction *http );
 };
 
 /** HTTP authentication scheme table */
@@ -560,6 +611,7 @@ extern char * http_token ( char **line, char **value );
 extern int http_connect ( struct interface *xfer, struct uri *uri );
 extern int http_open ( struct interface *xfer, struct http_method *method,
 		       struct uri *uri, struct http_request_range *range,
+		       const char *etag,
 		       struct http_request_content *content );
 extern int http_open_uri ( struct interface *xfer, struct uri *uri );
 
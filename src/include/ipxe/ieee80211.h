@@ -221,6 +221,13 @@ FILE_LICENCE(GPL2_OR_LATER);
 /** Subtype value for data frames containing no data */
 #define  IEEE80211_STYPE_NODATA       0x0040
 
+/** Subtype value for QoS data frames
+ *
+ * These carry a two-byte QoS Control field immediately after the
+ * ordinary data frame header.
+ */
+#define  IEEE80211_STYPE_QOS_DATA     0x0080
+
 
 /** 802.11 Frame Control field: To Data System flag
  *
@@ -959,7 +966,31 @@ struct ieee80211_ie_vendor {
 /** Information element ID for Vendor Specific information element */
 #define IEEE80211_IE_VENDOR	221
 
+/** HT Capabilities information element
+ *
+ * This is sent in association requests to advertise 802.11n High
+ * Throughput support, so that the Access Point may use HT rates and
+ * frame aggregation when talking to us.
+ */
+struct ieee80211_ie_ht_capab {
+	u8 id;			/**< HT Capabilities ID: 45 */
+	u8 len;			/**< HT Capabilities length: 26 */
+	u16 capab_info;		/**< HT Capabilities Info field */
+	u8 ampdu_params;	/**< A-MPDU Parameters field */
+	u8 mcs_set[16];		/**< Supported MCS Set field */
+	u16 ext_capab;		/**< HT Extended Capabilities field */
+	u32 txbf_capab;		/**< Transmit Beamforming Capabilities */
+	u8 asel_capab;		/**< ASEL Capabilities field */
+} __attribute__ ((packed));
+
+/** Information element ID for HT Capabilities information element */
+#define IEEE80211_IE_HT_CAPAB	45
 
+/** HT Capabilities Info: support for 20/40MHz operation */
+#define IEEE80211_HT_CAPAB_40MHZ	0x0002
+
+/** HT Capabilities Info: support for short guard interval at 20MHz */
+#define IEEE80211_HT_CAPAB_SGI_20MHZ	0x0020
 
 
 /** Any 802.11 information element
@@ -1001,6 +1032,9 @@ union ieee80211_ie
 
 	/** Vendor-specific */
 	struct ieee80211_ie_vendor vendor;
+
+	/** HT Capabilities */
+	struct ieee80211_ie_ht_capab ht_capab;
 };
 
 /** Check that 802.11 information element is bounded by buffer
@@ -1156,6 +1190,109 @@ struct ieee80211_auth
 /** Shared Key authentication algorithm */
 #define IEEE80211_AUTH_SHARED_KEY   1
 
+/** Action frame data */
+struct ieee80211_action
+{
+	/** Action frame category */
+	u8 category;
+
+	/** Action code within the category */
+	u8 action;
+
+	/** Category- and action-specific data */
+	u8 data[0];
+} __attribute__((packed));
+
+/** Block ACK action frame category */
+#define IEEE80211_ACTION_CATEG_BLOCK_ACK  3
+
+/** Action code for ADDBA (block ACK session setup) requests */
+#define IEEE80211_ACTION_ADDBA_REQ	0
+
+/** Action code for ADDBA (block ACK session setup) responses */
+#define IEEE80211_ACTION_ADDBA_RESP	1
+
+/** Action code for DELBA (block ACK session teardown) frames */
+#define IEEE80211_ACTION_DELBA		2
+
+/** ADDBA request frame data */
+struct ieee80211_addba_req
+{
+	/** Action frame category: Block ACK */
+	u8 category;
+
+	/** Action code: ADDBA request */
+	u8 action;
+
+	/** Dialog token, echoed in the response */
+	u8 dialog_token;
+
+	/** Block ACK parameter set */
+	u16 params;
+
+	/** Session timeout in TUs, or 0 for no timeout */
+	u16 timeout;
+
+	/** Block ACK starting sequence control */
+	u16 start_seq;
+} __attribute__((packed));
+
+/** ADDBA response frame data */
+struct ieee80211_addba_resp
+{
+	/** Action frame category: Block ACK */
+	u8 category;
+
+	/** Action code: ADDBA response */
+	u8 action;
+
+	/** Dialog token copied from the request */
+	u8 dialog_token;
+
+	/** Status code */
+	u16 status;
+
+	/** Block ACK parameter set */
+	u16 params;
+
+	/** Session timeout in TUs, or 0 for no timeout */
+	u16 timeout;
+} __attribute__((packed));
+
+/** DELBA frame data */
+struct ieee80211_delba
+{
+	/** Action frame category: Block ACK */
+	u8 category;
+
+	/** Action code: DELBA */
+	u8 action;
+
+	/** DELBA parameter set */
+	u16 params;
+
+	/** Reason code */
+	u16 reason;
+} __attribute__((packed));
+
+/** Block ACK parameter set: A-MSDUs permitted within A-MPDUs */
+#define IEEE80211_BA_PARAM_AMSDU	0x0001
+
+/** Block ACK parameter set: immediate (not delayed) block ACK policy */
+#define IEEE80211_BA_PARAM_IMMED	0x0002
+
+/** Block ACK parameter set: traffic identifier mask */
+#define IEEE80211_BA_PARAM_TID_MASK	0x003C
+
+/** Block ACK parameter set: traffic identifier shift */
+#define IEEE80211_BA_PARAM_TID_SHIFT	2
+
+/** Block ACK parameter set: buffer size mask */
+#define IEEE80211_BA_PARAM_BUFSZ_MASK	0xFFC0
+
+/** Block ACK parameter set: buffer size shift */
+#define IEEE80211_BA_PARAM_BUFSZ_SHIFT	6
+
 /** @} */
 
 #endif
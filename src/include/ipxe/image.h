@@ -85,6 +85,16 @@ struct image_type {
 	 * Return success if the image is of this image type.
 	 */
 	int ( * probe ) ( struct image *image );
+	/** Magic signature at the start of the image (optional)
+	 *
+	 * If present, this type will be probed first for images
+	 * beginning with the signature, avoiding a sequential trial
+	 * of every other probe method.  The probe method remains
+	 * authoritative: a failed probe falls back to the full walk.
+	 */
+	const void *magic;
+	/** Length of magic signature */
+	size_t magic_len;
 	/**
 	 * Execute image
 	 *
@@ -136,6 +146,9 @@ struct image_type {
  */
 #define PROBE_PXE 03
 
+/** Maximum length of an image type magic signature */
+#define IMAGE_MAGIC_MAX_LEN 16
+
 /** Executable image type table */
 #define IMAGE_TYPES __table ( struct image_type, "image_types" )
 
@@ -234,4 +247,19 @@ static inline void image_untrust ( struct image *image ) {
 	image->flags &= ~IMAGE_TRUSTED;
 }
 
+/**
+ * Get physical address of image data
+ *
+ * @v image		Image
+ * @ret phys		Physical address
+ *
+ * An image's data occupies a single contiguous block of external
+ * memory, and so may be advertised by physical address to consumers
+ * that are able to access the data in place rather than copying it
+ * out.
+ */
+static inline physaddr_t image_phys ( struct image *image ) {
+	return user_to_phys ( image->data, 0 );
+}
+
 #endif /* _IPXE_IMAGE_H */
@@ -135,8 +135,30 @@ extern void intf_plug ( struct interface *intf, struct interface *dest );
 extern void intf_plug_plug ( struct interface *a, struct interface *b );
 extern void intf_unplug ( struct interface *intf );
 extern void intf_nullify ( struct interface *intf );
-extern struct interface * intf_get ( struct interface *intf );
-extern void intf_put ( struct interface *intf );
+
+/**
+ * Increment reference count on an object interface
+ *
+ * @v intf		Object interface
+ * @ret intf		Object interface
+ *
+ * Inlined since a reference is taken and dropped around every
+ * interface operation, which is once per packet (or more) on the
+ * data path.
+ */
+static inline struct interface * intf_get ( struct interface *intf ) {
+	ref_get ( intf->refcnt );
+	return intf;
+}
+
+/**
+ * Decrement reference count on an object interface
+ *
+ * @v intf		Object interface
+ */
+static inline void intf_put ( struct interface *intf ) {
+	ref_put ( intf->refcnt );
+}
 extern void * __attribute__ (( pure )) intf_object ( struct interface *intf );
 extern void * intf_get_dest_op_no_passthru_untyped ( struct interface *intf,
 						     void *type,
@@ -155,6 +177,8 @@ extern void intf_restart ( struct interface *intf, int rc );
 extern void intfs_vrestart ( va_list intfs, int rc );
 extern void intfs_restart ( int rc, ... ) __attribute__ (( sentinel ));
 
+extern void intf_dump_chain ( struct interface *intf );
+
 extern void intf_poke ( struct interface *intf,
 			void ( type ) ( struct interface *intf ) );
 #define intf_poke_TYPE( object_type ) \
@@ -22,6 +22,20 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 #define IOB_ZLEN 128
 
+/**
+ * I/O buffer payload alignment
+ *
+ * Payload starts of buffers allocated via alloc_iob_headroom() are
+ * physically aligned on this boundary (sized to a typical cache
+ * line), so that header and payload accesses do not straddle cache
+ * lines on architectures where misaligned accesses are expensive.
+ */
+#ifndef IOB_PAYLOAD_ALIGN
+#define IOB_PAYLOAD_ALIGN 64
+#endif
+
+struct iob_payload;
+
 /**
  * A persistent I/O buffer
  *
@@ -46,8 +60,28 @@ struct io_buffer {
 	void *tail;
 	/** End of the buffer */
         void *end;
+
+	/** Shared payload, or NULL if the buffer is exclusively owned
+	 *
+	 * Assigned by iob_clone() when the underlying buffer
+	 * allocation becomes shared between multiple views.
+	 */
+	struct iob_payload *payload;
+
+	/** Flags */
+	unsigned int flags;
 };
 
+/** I/O buffer transport-layer checksum has been verified by hardware
+ *
+ * Set by drivers for network devices providing receive checksum
+ * offload, on packets for which the hardware has verified the
+ * transport-layer (and, where applicable, network-layer) checksum.
+ * The protocol stack will then skip its software checksum
+ * verification.
+ */
+#define IOB_FL_HW_CSUM 0x0001
+
 /**
  * Reserve space at start of I/O buffer
  *
@@ -213,10 +247,13 @@ static inline void iob_populate ( struct io_buffer *iobuf,
 extern struct io_buffer * __malloc alloc_iob_raw ( size_t len, size_t align,
 						   size_t offset );
 extern struct io_buffer * __malloc alloc_iob ( size_t len );
+extern struct io_buffer * __malloc alloc_iob_headroom ( size_t len,
+							size_t headroom );
 extern void free_iob ( struct io_buffer *iobuf );
 extern void iob_pad ( struct io_buffer *iobuf, size_t min_len );
 extern int iob_ensure_headroom ( struct io_buffer *iobuf, size_t len );
 extern struct io_buffer * iob_concatenate ( struct list_head *list );
+extern struct io_buffer * iob_clone ( struct io_buffer *iobuf );
 extern struct io_buffer * iob_split ( struct io_buffer *iobuf, size_t len );
 
 #endif /* _IPXE_IOBUF_H */
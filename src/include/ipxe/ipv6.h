@@ -204,6 +204,8 @@ enum ipv6_miniroute_flags {
 	IPV6_HAS_ADDRESS = 0x0001,
 	/** Routing table entry router address is valid */
 	IPV6_HAS_ROUTER = 0x0002,
+	/** Solicited-node multicast group has been joined */
+	IPV6_HAS_GROUP = 0x0004,
 };
 
 /**
@@ -254,6 +256,16 @@ static inline void ipv6_solicited_node ( struct in6_addr *addr,
 	memcpy ( &addr->s6_addr[13], &unicast->s6_addr[13], 3 );
 }
 
+/**
+ * Construct all-nodes multicast address
+ *
+ * @v addr		Zeroed address to construct
+ */
+static inline void ipv6_all_nodes ( struct in6_addr *addr ) {
+	addr->s6_addr16[0] = htons ( 0xff02 );
+	addr->s6_addr[15] = 1;
+}
+
 /**
  * Construct all-routers multicast address
  *
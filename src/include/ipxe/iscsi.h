@@ -10,6 +10,7 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
+#include <ipxe/list.h>
 #include <ipxe/socket.h>
 #include <ipxe/scsi.h>
 #include <ipxe/chap.h>
@@ -121,8 +122,10 @@ struct iscsi_bhs_common_response {
 	uint32_t statsn;
 	/** Expected command sequence number */
 	uint32_t expcmdsn;
+	/** Maximum command sequence number */
+	uint32_t maxcmdsn;
 	/** Fields specific to the PDU type */
-	uint8_t other_d[16];
+	uint8_t other_d[12];
 };
 
 /**
@@ -538,8 +541,6 @@ struct iscsi_session {
 
 	/** SCSI command-issuing interface */
 	struct interface control;
-	/** SCSI command interface */
-	struct interface data;
 	/** Transport-layer socket */
 	struct interface socket;
 
@@ -585,36 +586,28 @@ struct iscsi_session {
 	uint16_t isid_iana_qual;
 	/** Initiator task tag
 	 *
-	 * This is the tag of the current command.  It is incremented
-	 * whenever a new command is started.
+	 * This is the tag used for the login phase.  Each SCSI task
+	 * has its own tag.
 	 */
 	uint32_t itt;
-	/** Target transfer tag
-	 *
-	 * This is the tag attached to a sequence of data-out PDUs in
-	 * response to an R2T.
-	 */
-	uint32_t ttt;
-	/** Transfer offset
-	 *
-	 * This is the offset for an in-progress sequence of data-out
-	 * PDUs in response to an R2T.
-	 */
-	uint32_t transfer_offset;
-	/** Transfer length
-	 *
-	 * This is the length for an in-progress sequence of data-out
-	 * PDUs in response to an R2T.
-	 */
-	uint32_t transfer_len;
 	/** Command sequence number
 	 *
-	 * This is the sequence number of the current command, used to
-	 * fill out the CmdSN field in iSCSI request PDUs.  It is
-	 * updated with the value of the ExpCmdSN field whenever we
-	 * receive an iSCSI response PDU containing such a field.
+	 * This is the sequence number to be used for the next command
+	 * PDU, used to fill out the CmdSN field in iSCSI request
+	 * PDUs.  It is incremented whenever we send a (non-immediate)
+	 * command PDU, and advanced (using serial number arithmetic)
+	 * to the value of the ExpCmdSN field whenever we receive an
+	 * iSCSI response PDU containing such a field.
 	 */
 	uint32_t cmdsn;
+	/** Maximum command sequence number
+	 *
+	 * This is the highest CmdSN that the target is currently
+	 * willing to accept, taken from the MaxCmdSN field of
+	 * received iSCSI response PDUs.  We defer sending command
+	 * PDUs while CmdSN lies outside the target's command window.
+	 */
+	uint32_t maxcmdsn;
 	/** Status sequence number
 	 *
 	 * This is the most recent status sequence number present in
@@ -623,7 +616,28 @@ struct iscsi_session {
 	 * the ExpStatSN field with this value plus one.
 	 */
 	uint32_t statsn;
-	
+	/** First burst length
+	 *
+	 * This is the negotiated maximum amount of unsolicited data
+	 * (immediate data plus unsolicited data-out PDUs) that we may
+	 * send for a single SCSI command.
+	 */
+	size_t first_burst_len;
+	/** Maximum burst length
+	 *
+	 * This is the negotiated maximum length of a single data-out
+	 * sequence.  The target enforces this limit via the length of
+	 * its R2Ts, so we record it for information only.
+	 */
+	size_t max_burst_len;
+	/** Maximum transmitted data segment length
+	 *
+	 * This is the MaxRecvDataSegmentLength declared by the
+	 * target, which limits the data segment length of each
+	 * individual PDU that we transmit.
+	 */
+	size_t max_tx_len;
+
 	/** Basic header segment for current TX PDU */
 	union iscsi_bhs tx_bhs;
 	/** State of the TX engine */
@@ -642,8 +656,8 @@ struct iscsi_session {
 	/** Buffer for received data (not always used) */
 	void *rx_buffer;
 
-	/** Current SCSI command, if any */
-	struct scsi_cmd *command;
+	/** List of outstanding SCSI tasks */
+	struct list_head tasks;
 
 	/** Target socket address (for boot firmware table) */
 	struct sockaddr target_sockaddr;
@@ -698,6 +712,34 @@ struct iscsi_session {
 /** Target authenticated itself correctly */
 #define ISCSI_STATUS_AUTH_REVERSE_OK 0x00040000
 
+/** Target requires an R2T before accepting any data-out PDUs */
+#define ISCSI_STATUS_INITIAL_R2T 0x00080000
+
+/** Target declined immediate data */
+#define ISCSI_STATUS_NO_IMMEDIATE_DATA 0x00100000
+
+/** Default maximum transmitted data segment length
+ *
+ * This is the RFC 3720 default value for MaxRecvDataSegmentLength,
+ * assumed until the target declares its own value.
+ */
+#define ISCSI_DEFAULT_MAX_TX_LEN 8192
+
+/** First burst length that we offer
+ *
+ * This is the RFC 3720 default value; there is little to be gained
+ * from sending more than this much data before the target starts
+ * issuing R2Ts.
+ */
+#define ISCSI_FIRST_BURST_LEN 65536
+
+/** Maximum burst length that we offer
+ *
+ * We can handle data-out sequences of any length, so we offer the
+ * protocol maximum and accept whatever the target selects.
+ */
+#define ISCSI_MAX_BURST_LEN 16777215
+
 /** Default initiator IQN prefix */
 #define ISCSI_DEFAULT_IQN_PREFIX "iqn.2010-04.org.ipxe"
 
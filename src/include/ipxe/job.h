@@ -32,9 +32,36 @@ struct job_progress {
 	char message[32];
 };
 
+/** Number of samples in a job progress rate window */
+#define JOB_RATE_SAMPLES 8
+
+/** A job progress rate estimator
+ *
+ * Holds a small ring of timestamped progress samples, from which a
+ * windowed transfer rate (and hence an estimated time to completion)
+ * can be derived.  A rate of zero with a fully populated window
+ * indicates a stalled (rather than merely slow) operation.
+ */
+struct job_rate {
+	/** Progress samples */
+	struct {
+		/** Timestamp (in ticks) */
+		unsigned long ticks;
+		/** Amount of operation completed */
+		unsigned long completed;
+	} sample[JOB_RATE_SAMPLES];
+	/** Number of samples recorded */
+	unsigned int count;
+};
+
 extern int job_progress ( struct interface *intf,
 			  struct job_progress *progress );
 #define job_progress_TYPE( object_type ) \
 	typeof ( int ( object_type, struct job_progress *progress ) )
 
+extern void job_rate_sample ( struct job_rate *rate, unsigned long completed );
+extern unsigned long job_rate_per_sec ( struct job_rate *rate );
+extern unsigned long job_rate_eta ( struct job_rate *rate,
+				    unsigned long total );
+
 #endif /* _IPXE_JOB_H */
@@ -0,0 +1,75 @@
+#ifndef _IPXE_LEAKSTAT_H
+#define _IPXE_LEAKSTAT_H
+
+/** @file
+ *
+ * Allocation leak tracking
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <ipxe/tables.h>
+
+#ifndef LEAKSTAT
+#ifdef NDEBUG
+#define LEAKSTAT 0
+#else
+#define LEAKSTAT 1
+#endif
+#endif
+
+/** An allocation leak tracker
+ *
+ * Leak trackers count allocations and frees for a class of
+ * heap-allocated objects, allowing slow leaks to be diagnosed in-band
+ * on systems where post-hoc core analysis is not possible.  The cost
+ * per tracked allocation is two counter increments, which is cheap
+ * enough to leave enabled on staging builds.
+ */
+struct leak_tracker {
+	/** Name (usually the object class being tracked) */
+	const char *name;
+	/** Number of allocations */
+	unsigned long allocated;
+	/** Number of frees */
+	unsigned long freed;
+};
+
+/** Leak tracker table */
+#define LEAK_TRACKERS __table ( struct leak_tracker, "leak_trackers" )
+
+/** Declare a leak tracker */
+#if LEAKSTAT
+#define __leak_tracker __table_entry ( LEAK_TRACKERS, 01 )
+#else
+#define __leak_tracker
+#endif
+
+/**
+ * Record an allocation
+ *
+ * @v tracker		Leak tracker
+ */
+static inline __attribute__ (( always_inline )) void
+leak_alloc ( struct leak_tracker *tracker ) {
+
+	if ( LEAKSTAT )
+		tracker->allocated++;
+}
+
+/**
+ * Record a free
+ *
+ * @v tracker		Leak tracker
+ */
+static inline __attribute__ (( always_inline )) void
+leak_free ( struct leak_tracker *tracker ) {
+
+	if ( LEAKSTAT )
+		tracker->freed++;
+}
+
+extern void leakstat ( void );
+
+#endif /* _IPXE_LEAKSTAT_H */
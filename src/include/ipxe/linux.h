@@ -148,5 +148,22 @@ struct linux_setting *linux_find_setting(char *name, struct list_head *settings)
  */
 extern void linux_apply_settings(struct list_head *new_settings, struct settings *settings_block);
 
+/**
+ * Watch a file descriptor for wakeup events while napping
+ *
+ * @v fd	File descriptor
+ *
+ * Device and console backends register their file descriptors so that
+ * cpu_nap() can block awaiting I/O instead of busy-spinning, letting
+ * an idle instance consume (almost) no host CPU.
+ */
+extern void linux_watch_fd(int fd);
+
+/**
+ * Stop watching a file descriptor
+ *
+ * @v fd	File descriptor
+ */
+extern void linux_unwatch_fd(int fd);
 
 #endif /* _IPXE_LINUX_H */
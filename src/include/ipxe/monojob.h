@@ -14,5 +14,7 @@ struct interface;
 extern struct interface monojob;
 
 extern int monojob_wait ( const char *string, unsigned long timeout );
+extern int monojob_defer ( void );
+extern int monojob_join ( const char *string );
 
 #endif /* _IPXE_MONOJOB_H */
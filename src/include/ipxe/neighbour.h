@@ -39,6 +39,8 @@ struct neighbour {
 	struct refcnt refcnt;
 	/** List of neighbour cache entries */
 	struct list_head list;
+	/** Hash bucket membership */
+	struct list_head hash;
 
 	/** Network device */
 	struct net_device *netdev;
@@ -53,8 +55,15 @@ struct neighbour {
 	struct neighbour_discovery *discovery;
 	/** Network-layer source address (if any) */
 	uint8_t net_source[MAX_NET_ADDR_LEN];
-	/** Retransmission timer */
+	/** Retransmission and refresh timer */
 	struct retry_timer timer;
+	/** Link-layer destination address is valid
+	 *
+	 * Validity is independent of the timer state, since the timer
+	 * is also used for background refreshes during which the
+	 * cached address remains usable.
+	 */
+	int valid;
 
 	/** Pending I/O buffers */
 	struct list_head tx_queue;
@@ -68,7 +77,7 @@ struct neighbour {
  */
 static inline __attribute__ (( always_inline )) int
 neighbour_has_ll_dest ( struct neighbour *neighbour ) {
-	return ( ! timer_running ( &neighbour->timer ) );
+	return ( neighbour->valid );
 }
 
 extern struct list_head neighbours;
@@ -84,5 +93,13 @@ extern int neighbour_update ( struct net_device *netdev,
 extern int neighbour_define ( struct net_device *netdev,
 			      struct net_protocol *net_protocol,
 			      const void *net_dest, const void *ll_dest );
+extern int neighbour_snoop ( struct net_device *netdev,
+			     struct net_protocol *net_protocol,
+			     const void *net_dest, const void *ll_dest );
+extern int neighbour_probe ( struct net_device *netdev,
+			     struct net_protocol *net_protocol,
+			     const void *net_dest,
+			     struct neighbour_discovery *discovery,
+			     const void *net_source );
 
 #endif /* _IPXE_NEIGHBOUR_H */
@@ -6,6 +6,7 @@
 #include <ipxe/iobuf.h>
 #include <ipxe/netdevice.h>
 #include <ipxe/rc80211.h>
+#include <ipxe/timer.h>
 
 /** @file
  *
@@ -283,6 +284,17 @@ enum net80211_crypto_alg {
  */
 #define NET80211_NR_CONCURRENT_FRAGS 3
 
+/** Number of frames in the block ACK reorder window
+ *
+ * This is the buffer size we advertise in ADDBA responses, and must
+ * be a power of two so that a frame's reorder buffer slot can be
+ * derived from the low bits of its sequence number.
+ */
+#define NET80211_BLOCK_ACK_WINDOW 16
+
+/** Ticks we'll wait for a missing frame before releasing those behind it */
+#define NET80211_BLOCK_ACK_TIMEOUT ( TICKS_PER_SEC / 10 )
+
 /** Maximum TX power to allow (dBm), if we don't get a regulatory hint */
 #define NET80211_REG_TXPOWER	20
 
@@ -466,6 +478,15 @@ struct net80211_hw_info
 
 		/** Hardware doesn't support 802.11g short slot operation */
 		NET80211_HW_NO_SHORT_SLOT = (1 << 3),
+
+		/** Hardware can receive 802.11n HT-rate frames
+		 *
+		 * Setting this flag causes an HT Capabilities
+		 * information element to be included in association
+		 * requests, allowing the Access Point to use HT rates
+		 * and frame aggregation when transmitting to us.
+		 */
+		NET80211_HW_RX_HT = (1 << 4),
 	} flags;
 
 	/** Signal strength information that can be provided by the device
@@ -545,6 +566,38 @@ struct net80211_frag_cache
 	struct io_buffer *iob[16];
 };
 
+/** Structure tracking a block ACK session's receive reordering state
+ *
+ * When the Access Point sets up a block ACK session (via an ADDBA
+ * request, which we accept), it may transmit bursts of QoS data
+ * frames that are acknowledged as a block, and frames lost from the
+ * middle of a burst are retransmitted out of order.  We buffer frames
+ * received ahead of the next expected sequence number and release
+ * them to the network stack in order.  A frame missing for longer
+ * than @c NET80211_BLOCK_ACK_TIMEOUT is given up on, to avoid
+ * stalling the frames queued behind it indefinitely.
+ */
+struct net80211_block_ack
+{
+	/** Whether a block ACK session is active */
+	u8 in_use;
+
+	/** Traffic identifier for this session */
+	u8 tid;
+
+	/** Next expected sequence number (start of the reorder window) */
+	u16 start;
+
+	/** Number of frames currently held in the reorder buffer */
+	u8 buffered;
+
+	/** Timestamp from point at which a frame was first buffered */
+	u32 hole_ticks;
+
+	/** Reorder buffer, indexed by low bits of sequence number */
+	struct io_buffer *iob[NET80211_BLOCK_ACK_WINDOW];
+};
+
 
 /** Interface to an 802.11 security handshaking protocol
  *
@@ -993,6 +1046,9 @@ struct net80211_device
 	/** Fragment reassembly state */
 	struct net80211_frag_cache frags[NET80211_NR_CONCURRENT_FRAGS];
 
+	/** Block ACK session receive reordering state */
+	struct net80211_block_ack block_ack;
+
 	/** The sequence number of the last packet we sent */
 	u16 last_tx_seqnr;
 
@@ -0,0 +1,22 @@
+#ifndef _IPXE_NETBENCH_H
+#define _IPXE_NETBENCH_H
+
+/** @file
+ *
+ * Network throughput benchmark
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/interface.h>
+
+extern int create_netbench ( struct interface *job, int semantics,
+			     const char *hostname, unsigned int port,
+			     size_t len, unsigned long duration, int rx,
+			     void ( * callback ) ( unsigned long packets,
+						   unsigned long long bytes,
+						   unsigned long ticks ) );
+
+#endif /* _IPXE_NETBENCH_H */
@@ -57,6 +57,16 @@ struct device;
 /** Maximum combined length of a link-layer and network-layer header */
 #define MAX_LL_NET_HEADER_LEN ( MAX_LL_HEADER_LEN + MAX_NET_HEADER_LEN )
 
+/** Number of entries in the RX packet ring
+ *
+ * Must be a power of two, and at least as large as the largest
+ * hardware receive ring, so that a single device poll cannot overrun
+ * it.  May be overridden at build time.
+ */
+#ifndef NETDEV_RX_RING_COUNT
+#define NETDEV_RX_RING_COUNT 256
+#endif
+
 /**
  * A network-layer protocol
  *
@@ -270,6 +280,30 @@ struct net_device_operations {
 	 * supported.
 	 */
 	void ( * irq ) ( struct net_device *netdev, int enable );
+	/** Update multicast receive filter
+	 *
+	 * @v netdev	Network device
+	 * @ret rc	Return status code
+	 *
+	 * This method should program the hardware receive filter to
+	 * accept the link-layer multicast addresses currently listed
+	 * in net_device::mcast.  This method may be NULL to indicate
+	 * that the device receives all multicast packets.
+	 *
+	 * This method is guaranteed to be called only when the device
+	 * is open.
+	 */
+	int ( * mcast ) ( struct net_device *netdev );
+};
+
+/** A network device multicast membership */
+struct net_device_mcast {
+	/** List of multicast memberships */
+	struct list_head list;
+	/** Number of joins for this address */
+	unsigned int count;
+	/** Link-layer multicast address */
+	uint8_t ll_addr[MAX_LL_ADDR_LEN];
 };
 
 /** Network device error */
@@ -293,6 +327,20 @@ struct net_device_stats {
 	struct net_device_error errors[NETDEV_MAX_UNIQUE_ERRORS];
 };
 
+/** Network-layer receive demultiplex buckets */
+enum net_device_demux {
+	/** Address Resolution Protocol */
+	NETDEV_DEMUX_ARP = 0,
+	/** IPv4 */
+	NETDEV_DEMUX_IPV4,
+	/** IPv6 */
+	NETDEV_DEMUX_IPV6,
+	/** Any other network-layer protocol */
+	NETDEV_DEMUX_OTHER,
+	/** Number of demultiplex buckets */
+	NETDEV_DEMUX_COUNT
+};
+
 /** A network device configuration */
 struct net_device_configuration {
 	/** Network device */
@@ -381,6 +429,8 @@ struct net_device {
 	uint8_t ll_addr[MAX_LL_ADDR_LEN];
 	/** Link-layer broadcast address */
 	const uint8_t *ll_broadcast;
+	/** Link-layer multicast memberships */
+	struct list_head mcast;
 
 	/** Current device state
 	 *
@@ -393,6 +443,13 @@ struct net_device {
 	 * indicates the error preventing link-up.
 	 */
 	int link_rc;
+	/** Link speed (in Mbps)
+	 *
+	 * This is the negotiated link speed as reported by the
+	 * driver, or zero if unknown.  It is valid only while the
+	 * link is up.
+	 */
+	unsigned int link_speed;
 	/** Link block timer */
 	struct retry_timer link_block;
 	/** Maximum packet length
@@ -411,12 +468,54 @@ struct net_device {
 	struct list_head tx_queue;
 	/** Deferred TX packet queue */
 	struct list_head tx_deferred;
-	/** RX packet queue */
-	struct list_head rx_queue;
+	/** Expedited deferred TX packet queue
+	 *
+	 * Small (and therefore probably latency-critical) frames such
+	 * as pure acknowledgements are queued here when the transmit
+	 * descriptor ring is full, and are retransmitted ahead of any
+	 * deferred bulk data frames.
+	 */
+	struct list_head tx_expedited;
+	/** RX packet ring
+	 *
+	 * Fixed-size single-producer single-consumer ring: the driver
+	 * poll enqueues received packets (producer), and net_step()
+	 * or a raw-packet interface dequeues them (consumer).  Each
+	 * index is written only by its own side, so enqueueing
+	 * remains safe when a poll re-enters via external callbacks
+	 * (e.g. the EFI SNP interface), and neither side chases list
+	 * pointers per packet.
+	 */
+	struct {
+		/** Received packets */
+		struct io_buffer *iob[NETDEV_RX_RING_COUNT];
+		/** Producer counter */
+		unsigned int prod;
+		/** Consumer counter */
+		unsigned int cons;
+		/** Highest fill level observed */
+		unsigned int max;
+		/** Count of packets dropped due to a full ring */
+		unsigned int overruns;
+	} rx_ring;
 	/** TX statistics */
 	struct net_device_stats tx_stats;
 	/** RX statistics */
 	struct net_device_stats rx_stats;
+	/** RX demultiplex counters */
+	unsigned int demux[NETDEV_DEMUX_COUNT];
+
+	/** Poll backoff (in polls skipped between device polls)
+	 *
+	 * Devices that repeatedly yield no packets are polled at a
+	 * progressively reduced rate, so that quiet devices do not
+	 * steal poll cycles (and the associated register reads) from
+	 * a busy device.  Reset to zero as soon as a poll yields
+	 * packets, or when any interrupt wakes the CPU.
+	 */
+	unsigned int poll_backoff;
+	/** Number of polls remaining to be skipped */
+	unsigned int poll_skip;
 
 	/** Configuration settings applicable to this device */
 	struct generic_settings settings;
@@ -694,6 +793,7 @@ extern void netdev_link_down ( struct net_device *netdev );
 extern void netdev_link_block ( struct net_device *netdev,
 				unsigned long timeout );
 extern void netdev_link_unblock ( struct net_device *netdev );
+extern unsigned int netdev_max_link_speed ( void );
 extern int netdev_tx ( struct net_device *netdev, struct io_buffer *iobuf );
 extern void netdev_tx_defer ( struct net_device *netdev,
 			      struct io_buffer *iobuf );
@@ -713,6 +813,10 @@ extern int netdev_open ( struct net_device *netdev );
 extern void netdev_close ( struct net_device *netdev );
 extern void unregister_netdev ( struct net_device *netdev );
 extern void netdev_irq ( struct net_device *netdev, int enable );
+extern int netdev_mcast_join ( struct net_device *netdev,
+			       const void *ll_addr );
+extern void netdev_mcast_leave ( struct net_device *netdev,
+				 const void *ll_addr );
 extern struct net_device * find_netdev ( const char *name );
 extern struct net_device * find_netdev_by_index ( unsigned int index );
 extern struct net_device * find_netdev_by_location ( unsigned int bus_type,
@@ -0,0 +1,380 @@
+#ifndef _IPXE_NVMETCP_H
+#define _IPXE_NVMETCP_H
+
+/** @file
+ *
+ * NVMe over TCP protocol
+ *
+ * Wire formats are defined by the NVMe over Fabrics and NVMe/TCP
+ * transport specifications.  All multi-byte fields are little-endian.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+
+/** Default NVMe/TCP port */
+#define NVMETCP_PORT 4420
+
+/** NVMe/TCP PDU common header */
+struct nvmetcp_pdu_header {
+	/** PDU type */
+	uint8_t type;
+	/** Flags */
+	uint8_t flags;
+	/** PDU header length */
+	uint8_t hlen;
+	/** PDU data offset (from start of PDU), if data is present */
+	uint8_t pdo;
+	/** Total PDU length (header, padding, data and digests) */
+	uint32_t plen;
+} __attribute__ (( packed ));
+
+/** Initialize Connection Request PDU type */
+#define NVMETCP_ICREQ 0x00
+
+/** Initialize Connection Response PDU type */
+#define NVMETCP_ICRESP 0x01
+
+/** Host to Controller Terminate Connection Request PDU type */
+#define NVMETCP_H2C_TERM 0x02
+
+/** Controller to Host Terminate Connection Request PDU type */
+#define NVMETCP_C2H_TERM 0x03
+
+/** Command Capsule PDU type */
+#define NVMETCP_CMD 0x04
+
+/** Response Capsule PDU type */
+#define NVMETCP_RESP 0x05
+
+/** Host to Controller Data PDU type */
+#define NVMETCP_H2C_DATA 0x06
+
+/** Controller to Host Data PDU type */
+#define NVMETCP_C2H_DATA 0x07
+
+/** Ready to Transfer PDU type */
+#define NVMETCP_R2T 0x09
+
+/** PDU header digest present */
+#define NVMETCP_FLAG_HDGST 0x01
+
+/** PDU data digest present */
+#define NVMETCP_FLAG_DDGST 0x02
+
+/** PDU is last data PDU for this data transfer */
+#define NVMETCP_FLAG_LAST_PDU 0x04
+
+/** Command completed successfully; no response capsule will follow */
+#define NVMETCP_FLAG_SUCCESS 0x08
+
+/** Initialize Connection Request PDU */
+struct nvmetcp_icreq {
+	/** Common header */
+	struct nvmetcp_pdu_header hdr;
+	/** PDU format version */
+	uint16_t pfv;
+	/** Host PDU data alignment (as a power of two, minus two) */
+	uint8_t hpda;
+	/** Digest enable flags */
+	uint8_t digest;
+	/** Maximum number of outstanding R2Ts per command, minus one */
+	uint32_t maxr2t;
+	/** Reserved */
+	uint8_t reserved[112];
+} __attribute__ (( packed ));
+
+/** Initialize Connection Response PDU */
+struct nvmetcp_icresp {
+	/** Common header */
+	struct nvmetcp_pdu_header hdr;
+	/** PDU format version */
+	uint16_t pfv;
+	/** Controller PDU data alignment (as a power of two, minus two) */
+	uint8_t cpda;
+	/** Digest enable flags */
+	uint8_t digest;
+	/** Maximum permitted data per H2CData PDU */
+	uint32_t maxh2cdata;
+	/** Reserved */
+	uint8_t reserved[112];
+} __attribute__ (( packed ));
+
+/** Host to Controller Data PDU header */
+struct nvmetcp_h2c_data {
+	/** Common header */
+	struct nvmetcp_pdu_header hdr;
+	/** Command capsule CID */
+	uint16_t cccid;
+	/** Transfer tag (from the soliciting R2T) */
+	uint16_t ttag;
+	/** Data offset within the command's data buffer */
+	uint32_t datao;
+	/** Data length within this PDU */
+	uint32_t datal;
+	/** Reserved */
+	uint32_t reserved;
+} __attribute__ (( packed ));
+
+/** Controller to Host Data PDU header */
+struct nvmetcp_c2h_data {
+	/** Common header */
+	struct nvmetcp_pdu_header hdr;
+	/** Command capsule CID */
+	uint16_t cccid;
+	/** Reserved */
+	uint16_t reserved_a;
+	/** Data offset within the command's data buffer */
+	uint32_t datao;
+	/** Data length within this PDU */
+	uint32_t datal;
+	/** Reserved */
+	uint32_t reserved_b;
+} __attribute__ (( packed ));
+
+/** Ready to Transfer PDU */
+struct nvmetcp_r2t {
+	/** Common header */
+	struct nvmetcp_pdu_header hdr;
+	/** Command capsule CID */
+	uint16_t cccid;
+	/** Transfer tag */
+	uint16_t ttag;
+	/** Requested data offset */
+	uint32_t r2to;
+	/** Requested data length */
+	uint32_t r2tl;
+	/** Reserved */
+	uint32_t reserved;
+} __attribute__ (( packed ));
+
+/** An NVMe SGL descriptor */
+struct nvme_sgl {
+	/** Address (unused for transport data blocks) */
+	uint64_t address;
+	/** Length */
+	uint32_t length;
+	/** Reserved */
+	uint8_t reserved[3];
+	/** Descriptor type and subtype */
+	uint8_t type;
+} __attribute__ (( packed ));
+
+/** Transport SGL data block descriptor (data transferred by the transport) */
+#define NVME_SGL_TRANSPORT_DATA_BLOCK 0x5a
+
+/** An NVMe submission queue entry */
+struct nvme_sqe {
+	/** Opcode */
+	uint8_t opcode;
+	/** Flags (FUSE and PSDT) */
+	uint8_t flags;
+	/** Command identifier */
+	uint16_t cid;
+	/** Namespace ID */
+	uint32_t nsid;
+	/** Command dwords 2-3 (or fabrics command type specific) */
+	uint32_t cdw2;
+	/** Command dword 3 */
+	uint32_t cdw3;
+	/** Metadata pointer */
+	uint64_t mptr;
+	/** Data pointer (SGL descriptor 1 for fabrics commands) */
+	struct nvme_sgl sgl;
+	/** Command dword 10 */
+	uint32_t cdw10;
+	/** Command dword 11 */
+	uint32_t cdw11;
+	/** Command dword 12 */
+	uint32_t cdw12;
+	/** Command dword 13 */
+	uint32_t cdw13;
+	/** Command dword 14 */
+	uint32_t cdw14;
+	/** Command dword 15 */
+	uint32_t cdw15;
+} __attribute__ (( packed ));
+
+/** Use SGLs for data transfer (PSDT field within SQE flags) */
+#define NVME_SQE_FLAG_SGL 0x40
+
+/** An NVMe completion queue entry */
+struct nvme_cqe {
+	/** Command-specific result (dword 0) */
+	uint32_t dw0;
+	/** Command-specific result (dword 1) */
+	uint32_t dw1;
+	/** Submission queue head pointer */
+	uint16_t sqhd;
+	/** Submission queue ID */
+	uint16_t sqid;
+	/** Command identifier */
+	uint16_t cid;
+	/** Phase tag and status */
+	uint16_t status;
+} __attribute__ (( packed ));
+
+/** Extract status code field from CQE status */
+#define NVME_CQE_STATUS( status ) ( ( (status) >> 1 ) & 0x7fff )
+
+/** NVMe fabrics command opcode */
+#define NVME_OPCODE_FABRICS 0x7f
+
+/** NVMe fabrics Property Set command type */
+#define NVME_FCTYPE_PROPERTY_SET 0x00
+
+/** NVMe fabrics Connect command type */
+#define NVME_FCTYPE_CONNECT 0x01
+
+/** NVMe fabrics Property Get command type */
+#define NVME_FCTYPE_PROPERTY_GET 0x04
+
+/** An NVMe fabrics Connect command */
+struct nvme_connect_sqe {
+	/** Opcode */
+	uint8_t opcode;
+	/** Flags */
+	uint8_t flags;
+	/** Command identifier */
+	uint16_t cid;
+	/** Fabrics command type */
+	uint8_t fctype;
+	/** Reserved */
+	uint8_t reserved_a[19];
+	/** SGL descriptor for the connect data */
+	struct nvme_sgl sgl;
+	/** Record format */
+	uint16_t recfmt;
+	/** Queue ID */
+	uint16_t qid;
+	/** Submission queue size, minus one */
+	uint16_t sqsize;
+	/** Connect attributes */
+	uint8_t cattr;
+	/** Reserved */
+	uint8_t reserved_b;
+	/** Keep-alive timeout (in milliseconds) */
+	uint32_t kato;
+	/** Reserved */
+	uint8_t reserved_c[12];
+} __attribute__ (( packed ));
+
+/** NVMe fabrics Connect command data */
+struct nvme_connect_data {
+	/** Host identifier */
+	uint8_t hostid[16];
+	/** Controller ID (0xffff to allow the target to choose) */
+	uint16_t cntlid;
+	/** Reserved */
+	uint8_t reserved_a[238];
+	/** Subsystem NQN */
+	char subnqn[256];
+	/** Host NQN */
+	char hostnqn[256];
+	/** Reserved */
+	uint8_t reserved_b[256];
+} __attribute__ (( packed ));
+
+/** Controller ID allowing the target to choose a controller */
+#define NVME_CNTLID_ANY 0xffff
+
+/** An NVMe fabrics Property Get/Set command */
+struct nvme_property_sqe {
+	/** Opcode */
+	uint8_t opcode;
+	/** Flags */
+	uint8_t flags;
+	/** Command identifier */
+	uint16_t cid;
+	/** Fabrics command type */
+	uint8_t fctype;
+	/** Reserved */
+	uint8_t reserved_a[35];
+	/** Attributes (property size) */
+	uint8_t attrib;
+	/** Reserved */
+	uint8_t reserved_b[3];
+	/** Property offset */
+	uint32_t ofst;
+	/** Value (for Property Set only) */
+	uint64_t value;
+	/** Reserved */
+	uint8_t reserved_c[8];
+} __attribute__ (( packed ));
+
+/** Property is 4 bytes long */
+#define NVME_PROPERTY_4_BYTES 0
+
+/** Property is 8 bytes long */
+#define NVME_PROPERTY_8_BYTES 1
+
+/** Controller Capabilities property offset */
+#define NVME_PROPERTY_CAP 0x00
+
+/** Controller Configuration property offset */
+#define NVME_PROPERTY_CC 0x14
+
+/** Controller Status property offset */
+#define NVME_PROPERTY_CSTS 0x1c
+
+/** Controller Configuration value enabling the controller
+ *
+ * Comprises EN=1, CSS=0 (NVM command set), MPS=0 (4kB pages),
+ * IOSQES=6 (64-byte submission queue entries) and IOCQES=4 (16-byte
+ * completion queue entries).
+ */
+#define NVME_CC_ENABLE 0x00460001UL
+
+/** Controller Status ready flag */
+#define NVME_CSTS_RDY 0x00000001UL
+
+/** NVMe Identify admin command opcode */
+#define NVME_OPCODE_IDENTIFY 0x06
+
+/** NVMe Set Features admin command opcode */
+#define NVME_OPCODE_SET_FEATURES 0x09
+
+/** Identify Namespace CNS value */
+#define NVME_IDENTIFY_NS 0x00
+
+/** Number of Queues feature identifier */
+#define NVME_FEATURE_NUM_QUEUES 0x07
+
+/** NVMe Identify Namespace data (fields of interest only) */
+struct nvme_identify_ns {
+	/** Namespace size (in logical blocks) */
+	uint64_t nsze;
+	/** Namespace capacity (in logical blocks) */
+	uint64_t ncap;
+	/** Namespace utilisation (in logical blocks) */
+	uint64_t nuse;
+	/** Namespace features */
+	uint8_t nsfeat;
+	/** Number of LBA formats, minus one */
+	uint8_t nlbaf;
+	/** Formatted LBA size (current format index in low nibble) */
+	uint8_t flbas;
+	/** Reserved / uninteresting fields */
+	uint8_t reserved[101];
+	/** LBA format descriptors */
+	struct {
+		/** Metadata size */
+		uint16_t ms;
+		/** LBA data size (as a power of two) */
+		uint8_t lbads;
+		/** Relative performance */
+		uint8_t rp;
+	} __attribute__ (( packed )) lbaf[16];
+} __attribute__ (( packed ));
+
+/** Length of Identify data structures */
+#define NVME_IDENTIFY_LEN 4096
+
+/** NVMe Write I/O command opcode */
+#define NVME_OPCODE_WRITE 0x01
+
+/** NVMe Read I/O command opcode */
+#define NVME_OPCODE_READ 0x02
+
+#endif /* _IPXE_NVMETCP_H */
@@ -34,6 +34,19 @@ struct nvs_device {
 	 * writes.
 	 */
 	unsigned int block_size;
+	/** Read-through cache, if enabled
+	 *
+	 * This is an optional buffer caching the contents of the
+	 * first cache_size words of the device.  Repeated reads of
+	 * the same words (e.g. during driver probe) will then hit the
+	 * device only once, which matters for devices that can be
+	 * read only one slow word at a time.
+	 */
+	void *cache;
+	/** Size of read-through cache (in words) */
+	unsigned int cache_size;
+	/** Number of leading words currently held in the cache */
+	unsigned int cached;
 	/** Read data from device
 	 *
 	 * @v nvs		NVS device
@@ -0,0 +1,45 @@
+#ifndef _IPXE_OBJPOOL_H
+#define _IPXE_OBJPOOL_H
+
+/** @file
+ *
+ * Object pools
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/list.h>
+
+/** An object pool
+ *
+ * A per-type cache of freed control structures, which are retained
+ * and reused by subsequent allocations of the same size.
+ */
+struct objpool {
+	/** List of pooled objects */
+	struct list_head free;
+	/** List of all object pools holding at least one object */
+	struct list_head list;
+	/** Number of objects currently pooled */
+	unsigned int count;
+	/** Maximum number of objects to retain */
+	unsigned int max;
+};
+
+/**
+ * Initialise a static object pool
+ *
+ * @v _pool		Object pool
+ * @v _max		Maximum number of objects to retain
+ */
+#define OBJPOOL_INIT( _pool, _max ) {				\
+		.free = LIST_HEAD_INIT ( (_pool).free ),	\
+		.max = (_max),					\
+	}
+
+extern void * __malloc objpool_alloc ( struct objpool *pool, size_t len );
+extern void objpool_free ( struct objpool *pool, void *ptr, size_t len );
+
+#endif /* _IPXE_OBJPOOL_H */
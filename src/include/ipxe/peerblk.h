@@ -77,6 +77,8 @@ struct peerdist_block {
 	struct cipher_algorithm *cipher;
 	/** Cipher context (dynamically allocated as needed) */
 	void *cipherctx;
+	/** Decryption chunk buffer (dynamically allocated as needed) */
+	void *cipherbuf;
 
 	/** Segment index */
 	unsigned int segment;
@@ -54,11 +54,12 @@ struct peerdisc_segment {
 	const char *uuid;
 	/** List of discovered peers
 	 *
-	 * The list of peers may be appended to during the lifetime of
-	 * the discovery segment.  Discovered peers will not be
-	 * removed from the list until the last discovery has been
-	 * closed; this allows users to safely maintain a pointer to a
-	 * current position within the list.
+	 * The list of peers may be appended to (and reordered as
+	 * ranking information is gathered) during the lifetime of the
+	 * discovery segment.  Discovered peers will not be removed
+	 * from the list until the last discovery has been closed;
+	 * this allows users to safely maintain a pointer to a current
+	 * position within the list.
 	 */
 	struct list_head peers;
 	/** List of active clients */
@@ -71,6 +72,10 @@ struct peerdisc_segment {
 struct peerdisc_peer {
 	/** List of peers */
 	struct list_head list;
+	/** Smoothed observed throughput (in bytes per tick, zero if
+	 * unmeasured)
+	 */
+	unsigned long rate;
 	/** Peer location */
 	char location[0];
 };
@@ -115,6 +120,11 @@ extern void peerdisc_stat ( struct interface *intf, struct peerdisc_peer *peer,
 	typeof ( void ( object_type, struct peerdisc_peer *peer,	\
 			struct list_head *peers ) )
 
+extern void peerdisc_rank ( struct peerdisc_segment *segment,
+			    struct peerdisc_peer *peer, size_t len,
+			    unsigned long ticks );
+extern void peerdisc_demote ( struct peerdisc_segment *segment,
+			      struct peerdisc_peer *peer );
 extern int peerdisc_open ( struct peerdisc_client *peerdisc, const void *id,
 			   size_t len );
 extern void peerdisc_close ( struct peerdisc_client *peerdisc );
@@ -0,0 +1,47 @@
+#ifndef _IPXE_PKTCAP_H
+#define _IPXE_PKTCAP_H
+
+/** @file
+ *
+ * Packet capture
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+
+struct interface;
+struct io_buffer;
+struct net_device;
+struct uri;
+
+/** Number of bytes captured from the start of each packet
+ *
+ * This is sufficient to cover the link-layer, network-layer, and
+ * transport-layer headers of interest when diagnosing retransmission
+ * storms, while keeping the per-packet copy cost negligible.
+ */
+#define PKTCAP_SNAP_LEN 64
+
+/** Number of packets retained in the capture ring */
+#define PKTCAP_NUM_PACKETS 256
+
+/** A captured packet */
+struct pktcap_packet {
+	/** Capture timestamp (in ticks since startup) */
+	unsigned long ticks;
+	/** Length of packet on the wire */
+	uint16_t len;
+	/** Number of bytes captured */
+	uint16_t caplen;
+	/** Captured data */
+	uint8_t data[PKTCAP_SNAP_LEN];
+};
+
+extern void pktcap_record ( struct net_device *netdev,
+			    struct io_buffer *iobuf );
+extern unsigned int pktcap_packets ( void );
+extern int create_pktcap_upload ( struct interface *job, struct uri *uri );
+
+#endif /* _IPXE_PKTCAP_H */
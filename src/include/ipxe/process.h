@@ -11,6 +11,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <ipxe/list.h>
 #include <ipxe/refcnt.h>
+#include <ipxe/profile.h>
 #include <ipxe/tables.h>
 
 /** A process */
@@ -25,6 +26,20 @@ struct process {
 	 * this field may be NULL.
 	 */
 	struct refcnt *refcnt;
+	/** Number of consecutive scheduling deferrals
+	 *
+	 * Used to limit how long a low-priority process may be
+	 * deferred in favour of data-path processes.
+	 */
+	unsigned int skips;
+};
+
+/** Process scheduling priorities */
+enum process_priority {
+	/** Data-path process: runs on every scheduling pass */
+	PROC_PRIO_FAST = 0,
+	/** Housekeeping process: runs on a fraction of scheduling passes */
+	PROC_PRIO_SLOW,
 };
 
 /** A process descriptor */
@@ -43,6 +58,10 @@ struct process_descriptor {
 	void ( * step ) ( void *object );
 	/** Automatically reschedule the process */
 	int reschedule;
+	/** Scheduling priority */
+	enum process_priority priority;
+	/** Elapsed-tick profiler, or NULL */
+	struct profiler *profiler;
 };
 
 /**
@@ -84,6 +103,7 @@ struct process_descriptor {
 		.offset = process_offset ( object_type, process ),	      \
 		.step = PROC_STEP ( object_type, _step ),		      \
 		.reschedule = 1,					      \
+		.priority = PROC_PRIO_FAST,				      \
 	}
 
 /**
@@ -99,6 +119,7 @@ struct process_descriptor {
 		.offset = process_offset ( object_type, process ),	      \
 		.step = PROC_STEP ( object_type, _step ),		      \
 		.reschedule = 0,					      \
+		.priority = PROC_PRIO_FAST,				      \
 	}
 
 /**
@@ -114,12 +135,31 @@ struct process_descriptor {
 		.offset = 0,						      \
 		.step = PROC_STEP ( struct process, _step ),		      \
 		.reschedule = 1,					      \
+		.priority = PROC_PRIO_FAST,				      \
+	}
+
+/**
+ * Define a process descriptor for a profiled pure process
+ *
+ * @v step		Process' step() method
+ * @v _priority		Scheduling priority
+ * @v _profiler		Elapsed-tick profiler
+ * @ret desc		Object interface descriptor
+ */
+#define PROC_DESC_PURE_PROFILED( _step, _priority, _profiler ) {	      \
+		.name = #_step,						      \
+		.offset = 0,						      \
+		.step = PROC_STEP ( struct process, _step ),		      \
+		.reschedule = 1,					      \
+		.priority = (_priority),				      \
+		.profiler = (_profiler),				      \
 	}
 
 extern void * __attribute__ (( pure ))
 process_object ( struct process *process );
 extern void process_add ( struct process *process );
 extern void process_del ( struct process *process );
+extern int process_sole ( struct process *process );
 extern void step ( void );
 
 /**
@@ -148,6 +188,7 @@ process_init_stopped ( struct process *process,
 	INIT_LIST_HEAD ( &process->list );
 	process->desc = desc;
 	process->refcnt = refcnt;
+	process->skips = 0;
 }
 
 /**
@@ -187,12 +228,31 @@ process_running ( struct process *process ) {
  */
 #define __permanent_process __table_entry ( PERMANENT_PROCESSES, 01 )
 
+/** Define a permanent process
+ *
+ * Permanent processes are given an elapsed-tick profiler, so that
+ * profiling builds can attribute scheduling time to each process.
+ */
+#define PERMANENT_PROCESS_PRIO( _name, _step, _priority )		      \
+static struct profiler _name ## _profiler __profiler = { .name = #_step };    \
+static struct process_descriptor _name ## _desc =			      \
+	PROC_DESC_PURE_PROFILED ( _step, _priority, & _name ## _profiler );   \
+struct process _name __permanent_process =				      \
+	PROC_INIT ( _name, & _name ## _desc );
+
 /** Define a permanent process
  *
  */
 #define PERMANENT_PROCESS( name, step )					      \
-static struct process_descriptor name ## _desc = PROC_DESC_PURE ( step );     \
-struct process name __permanent_process = PROC_INIT ( name, & name ## _desc );
+	PERMANENT_PROCESS_PRIO ( name, step, PROC_PRIO_FAST )
+
+/** Define a permanent housekeeping process
+ *
+ * Housekeeping processes run on only a fraction of scheduling passes,
+ * so that they do not steal cycles from the data path.
+ */
+#define PERMANENT_PROCESS_SLOW( name, step )				      \
+	PERMANENT_PROCESS_PRIO ( name, step, PROC_PRIO_SLOW )
 
 /**
  * Find debugging colourisation for a process
@@ -60,6 +60,25 @@ struct profiler {
 #define __profiler
 #endif
 
+/** Lightweight profiling enablement
+ *
+ * Lightweight profilers cover a small curated set of hot spots and
+ * are compiled into all builds (including release builds with NDEBUG
+ * defined) unless explicitly disabled, so that profiling statistics
+ * can be collected from production images without requiring a
+ * special debug build.
+ */
+#ifndef PROFILING_LITE
+#define PROFILING_LITE 1
+#endif
+
+/** Declare a lightweight profiler */
+#if ( PROFILING || PROFILING_LITE )
+#define __profiler_lite __table_entry ( PROFILERS, 01 )
+#else
+#define __profiler_lite
+#endif
+
 extern unsigned long profile_excluded;
 
 extern void profile_update ( struct profiler *profiler, unsigned long sample );
@@ -175,6 +194,46 @@ profile_stop ( struct profiler *profiler ) {
 		profile_stop_at ( profiler, profile_timestamp() );
 }
 
+/**
+ * Start lightweight profiling
+ *
+ * @v profiler		Profiler
+ *
+ * Lightweight profilers do not participate in the excluded-time
+ * accounting used by profile_exclude(), since that accounting is
+ * active only in full profiling builds.
+ */
+static inline __attribute__ (( always_inline )) void
+profile_start_lite ( struct profiler *profiler ) {
+
+	/* Record start timestamp if any form of profiling is active */
+	if ( PROFILING ) {
+		profile_start ( profiler );
+	} else if ( PROFILING_LITE ) {
+		profiler->started = profile_timestamp();
+	}
+}
+
+/**
+ * Stop lightweight profiling
+ *
+ * @v profiler		Profiler
+ */
+static inline __attribute__ (( always_inline )) void
+profile_stop_lite ( struct profiler *profiler ) {
+
+	/* Record end timestamp and update statistics if any form of
+	 * profiling is active.
+	 */
+	if ( PROFILING ) {
+		profile_stop ( profiler );
+	} else if ( PROFILING_LITE ) {
+		profiler->stopped = profile_timestamp();
+		profile_update ( profiler, ( profiler->stopped -
+					     profiler->started ) );
+	}
+}
+
 /**
  * Exclude time from other ongoing profiling results
  *
@@ -81,6 +81,45 @@ ref_init ( struct refcnt *refcnt,
 extern void ref_increment ( struct refcnt *refcnt );
 extern void ref_decrement ( struct refcnt *refcnt );
 
+#ifdef NDEBUG
+
+/**
+ * Get additional reference to object
+ *
+ * @v refcnt		Reference counter, or NULL
+ * @ret refcnt		Reference counter
+ *
+ * If @c refcnt is NULL, no action is taken.
+ *
+ * In non-debug builds, the reference count is adjusted inline; this
+ * shows up measurably in instruction profiles of the packet hot
+ * paths, where references are taken and dropped several times per
+ * packet.
+ */
+#define ref_get( refcnt_ptr ) ( {					\
+	struct refcnt *get_refcnt = (refcnt_ptr);			\
+	if ( get_refcnt )						\
+		get_refcnt->count++;					\
+	get_refcnt; } )
+
+/**
+ * Drop reference to object
+ *
+ * @v refcnt		Reference counter, or NULL
+ *
+ * If @c refcnt is NULL, no action is taken.
+ */
+#define ref_put( refcnt_ptr ) do {					\
+	struct refcnt *put_refcnt = (refcnt_ptr);			\
+	if ( put_refcnt && ( --(put_refcnt->count) < 0 ) ) {		\
+		/* Undo decrement; ref_decrement() redoes it */		\
+		put_refcnt->count++;					\
+		ref_decrement ( put_refcnt );				\
+	}								\
+	} while ( 0 )
+
+#else /* NDEBUG */
+
 /**
  * Get additional reference to object
  *
@@ -109,6 +148,8 @@ extern void ref_decrement ( struct refcnt *refcnt );
 	ref_decrement ( refcnt );					\
 	} while ( 0 )
 
+#endif /* NDEBUG */
+
 extern void ref_no_free ( struct refcnt *refcnt );
 
 #endif /* _IPXE_REFCNT_H */
@@ -47,5 +47,7 @@ extern void resolv_done ( struct interface *intf, struct sockaddr *sa );
 
 extern int resolv ( struct interface *resolv, const char *name,
 		    struct sockaddr *sa );
+extern int resolv_multi ( struct interface *resolv, const char **names,
+			  unsigned int count, struct sockaddr *sa );
 
 #endif /* _IPXE_RESOLV_H */
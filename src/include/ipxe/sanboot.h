@@ -38,6 +38,8 @@ struct san_path {
 	struct process process;
 	/** Path status */
 	int path_rc;
+	/** Smoothed command latency (in ticks, zero if unmeasured) */
+	unsigned long latency;
 
 	/** ACPI descriptor (if applicable) */
 	struct acpi_descriptor *desc;
@@ -74,6 +76,15 @@ struct san_device {
 	/** Drive is a CD-ROM */
 	int is_cdrom;
 
+	/** Read-ahead cache (if allocated) */
+	userptr_t cache;
+	/** Starting LBA of cached data */
+	uint64_t cache_lba;
+	/** Number of cached blocks (zero if cache is invalid) */
+	unsigned int cache_count;
+	/** LBA expected by the next sequential read */
+	uint64_t next_lba;
+
 	/** Driver private data */
 	void *priv;
 
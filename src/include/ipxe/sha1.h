@@ -58,6 +58,12 @@ union sha1_digest_data_dwords {
 struct sha1_context {
 	/** Amount of accumulated data */
 	size_t len;
+	/** Accelerated implementation is in use
+	 *
+	 * Probed once at initialisation to keep the per-block
+	 * processing path free of capability checks.
+	 */
+	int accel;
 	/** Digest and accumulated data */
 	union sha1_digest_data_dwords ddd;
 } __attribute__ (( packed ));
@@ -63,6 +63,12 @@ struct sha256_context {
 	size_t len;
 	/** Digest size */
 	size_t digestsize;
+	/** Accelerated implementation is in use
+	 *
+	 * Probed once at initialisation to keep the per-block
+	 * processing path free of capability checks.
+	 */
+	int accel;
 	/** Digest and accumulated data */
 	union sha256_digest_data_dwords ddd;
 } __attribute__ (( packed ));
@@ -70,12 +70,18 @@ struct tcp_window_scale_padded_option {
 /** Code for the TCP window scale option */
 #define TCP_OPTION_WS 3
 
-/** Advertised TCP window scale
+/** Maximum advertised TCP window scale
  *
  * Using a scale factor of 2**9 provides for a maximum window of 32MB,
  * which is sufficient to allow Gigabit-speed transfers with a 200ms
  * RTT.  The minimum advertised window is 512 bytes, which is still
  * less than a single packet.
+ *
+ * This is an upper bound: the scale actually advertised for a
+ * connection is the smallest that can represent the largest window we
+ * could ever offer (which is limited by free memory), so that
+ * machines with little memory retain fine-grained window
+ * advertisements.
  */
 #define TCP_RX_WINDOW_SCALE 9
 
@@ -351,10 +357,35 @@ struct tcp_options {
  * bandwidth), since in the event of a lost packet the window size
  * represents the maximum amount that will need to be retransmitted.
  *
- * We therefore choose a maximum window size of 256kB.
+ * We therefore choose a base maximum window size of 256kB.  This
+ * limit applies only when heap memory is scarce; when sufficient free
+ * memory is available to buffer a worst-case retransmission, the
+ * advertised window is permitted to grow beyond this size (up to the
+ * limit representable using our window scale) so that high
+ * bandwidth-delay-product paths are not artificially throttled.
  */
 #define TCP_MAX_WINDOW_SIZE	( 256 * 1024 )
 
+/** TCP receive window fraction of free memory
+ *
+ * When expanding the receive window beyond TCP_MAX_WINDOW_SIZE, we
+ * permit at most this fraction (expressed as a right shift) of free
+ * heap memory to be consumed by a single connection's window, since
+ * out-of-order segments within the window must be buffered in full.
+ */
+#define TCP_RX_WINDOW_MEM_SHIFT 2
+
+/** TCP receive window link speed multiplier
+ *
+ * The bandwidth-delay product of the path bounds the useful receive
+ * window.  Where the negotiated link speed is known, the product of
+ * the speed (in Mbps) and this multiplier gives the window size (in
+ * bytes) corresponding to a worst-case round-trip time of 200ms (the
+ * same assumption used to choose TCP_RX_WINDOW_SCALE); there is no
+ * benefit in advertising a window beyond this size.
+ */
+#define TCP_RX_WINDOW_SPEED_FACTOR 25000
+
 /**
  * Path MTU
  *
@@ -372,12 +403,35 @@ struct tcp_options {
 #define TCP_PATH_MTU							\
 	( 1280 - 40 /* IPv6 */ - 20 /* TCP */ - 12 /* TCP timestamp */ )
 
+/** TCP maximum amount of in-flight data
+ *
+ * This bounds both the memory consumed by unacknowledged data
+ * (which must be retained for possible retransmission) and the
+ * size of a worst-case go-back-N retransmission.
+ */
+#define TCP_MAX_FLIGHT ( 8 * TCP_PATH_MTU )
+
 /** TCP maximum segment lifetime
  *
  * Currently set to 2 minutes, as per RFC 793.
  */
 #define TCP_MSL ( 2 * 60 * TICKS_PER_SEC )
 
+/**
+ * TCP delayed acknowledgement period
+ *
+ * Pure acknowledgements for in-order data are coalesced: we send an
+ * ACK after every TCP_ACK_COALESCE_COUNT received segments, or after
+ * this delay has elapsed, whichever comes first.  The value is well
+ * below the RFC 1122 limit of 500ms and small enough not to trigger
+ * retransmission timeouts or interact badly with the peer's
+ * congestion control.
+ */
+#define TCP_DELACK_DELAY ( TICKS_PER_SEC / 25 )
+
+/** Number of received segments that will be acknowledged at once */
+#define TCP_ACK_COALESCE_COUNT 2
+
 /**
  * TCP keepalive period
  *
@@ -433,6 +487,16 @@ static inline int tcp_in_window ( uint32_t seq, uint32_t start,
  */
 #define TCP_FINISH_TIMEOUT ( 1 * TICKS_PER_SEC )
 
+/** TCP activity statistics */
+struct tcp_stats {
+	/** Number of retransmissions */
+	unsigned int retransmits;
+	/** Number of selective acknowledgement blocks transmitted */
+	unsigned int sacks;
+};
+
 extern struct tcpip_protocol tcp_protocol __tcpip_protocol;
+extern struct tcp_stats tcp_stats;
+extern void tcpstat ( void );
 
 #endif /* _IPXE_TCP_H */
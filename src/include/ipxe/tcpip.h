@@ -200,6 +200,8 @@ extern struct tcpip_net_protocol * tcpip_net_protocol ( sa_family_t sa_family );
 extern struct net_device * tcpip_netdev ( struct sockaddr_tcpip *st_dest );
 extern size_t tcpip_mtu ( struct sockaddr_tcpip *st_dest );
 extern uint16_t tcpip_chksum ( const void *data, size_t len );
+extern uint16_t tcpip_chksum_update ( uint16_t chksum, uint16_t old,
+				      uint16_t new );
 extern int tcpip_bind ( struct sockaddr_tcpip *st_local,
 			int ( * available ) ( int port ) );
 
@@ -9,14 +9,19 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+#include <stddef.h>
 #include <ipxe/tables.h>
 
+struct profiler;
+
 /** A self-test set */
 struct self_test {
 	/** Test set name */
 	const char *name;
 	/** Run self-tests */
 	void ( * exec ) ( void );
+	/** Run benchmarks (optional) */
+	void ( * bench ) ( void );
 	/** Number of tests run */
 	unsigned int total;
 	/** Number of test failures */
@@ -33,6 +38,8 @@ struct self_test {
 
 extern void test_ok ( int success, const char *file, unsigned int line,
 		      const char *test );
+extern void test_bench ( const char *name, size_t len,
+			 struct profiler *profiler );
 
 /**
  * Report test result
@@ -18,14 +18,22 @@
 /* Virtio feature flags used to negotiate device and driver features. */
 /* Can the device handle any descriptor layout? */
 #define VIRTIO_F_ANY_LAYOUT             27
+/* Driver can use indirect descriptor tables. */
+#define VIRTIO_RING_F_INDIRECT_DESC     28
 /* v1.0 compliant. */
 #define VIRTIO_F_VERSION_1              32
 #define VIRTIO_F_IOMMU_PLATFORM         33
 
 #define MAX_QUEUE_NUM      (256)
 
-#define VRING_DESC_F_NEXT  1
-#define VRING_DESC_F_WRITE 2
+#define VRING_DESC_F_NEXT     1
+#define VRING_DESC_F_WRITE    2
+#define VRING_DESC_F_INDIRECT 4
+
+/* Maximum number of descriptors per indirect table.  Sized for the
+ * header+data chains used by the virtio-net driver.
+ */
+#define MAX_INDIRECT_NUM   (2)
 
 #define VRING_AVAIL_F_NO_INTERRUPT 1
 
@@ -78,6 +86,12 @@ struct vring_virtqueue {
    u16 free_head;
    u16 last_used_idx;
    void **vdata;
+   /* non-zero if VIRTIO_RING_F_INDIRECT_DESC was negotiated */
+   int use_indirect;
+   /* one indirect descriptor table per ring entry, identified by the
+    * head descriptor index of the chain it replaces
+    */
+   struct vring_desc indirect[MAX_QUEUE_NUM][MAX_INDIRECT_NUM];
    /* PCI */
    int queue_index;
    struct virtio_pci_region notification;
@@ -55,6 +55,20 @@ struct printf_context {
 	 * formatted string.
 	 */
 	void ( * handler ) ( struct printf_context *ctx, unsigned int c );
+	/**
+	 * Bulk character handler (optional)
+	 *
+	 * @v ctx	Context
+	 * @v data	Characters
+	 * @v len	Number of characters
+	 *
+	 * If non-NULL, this method is called in preference to
+	 * handler() for runs of characters (such as literal portions
+	 * of the format string), allowing the characters to be
+	 * handled in a single operation.
+	 */
+	void ( * bulk ) ( struct printf_context *ctx, const char *data,
+			  size_t len );
 	/** Length of formatted string
 	 *
 	 * When handler() is called, @len will be set to the number of
@@ -0,0 +1,20 @@
+#ifndef _IPXE_X25519_H
+#define _IPXE_X25519_H
+
+/** @file
+ *
+ * X25519 key exchange
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/crypto.h>
+
+/** X25519 key size */
+#define X25519_KEY_SIZE 32
+
+extern struct elliptic_curve x25519_curve;
+
+#endif /* _IPXE_X25519_H */
@@ -188,6 +188,12 @@ struct x509_certificate {
 
 	/** Link in certificate store */
 	struct x509_link store;
+	/** CRC32 of raw certificate data
+	 *
+	 * Used by the certificate store to avoid comparing the full
+	 * raw data against every stored certificate on lookup.
+	 */
+	uint32_t store_crc;
 
 	/** Flags */
 	unsigned int flags;
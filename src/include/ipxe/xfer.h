@@ -62,6 +62,21 @@ struct xfer_metadata {
 /** Data content is a response */
 #define XFER_FL_RESPONSE 0x0010
 
+/** Metadata describes the overall transfer
+ *
+ * The offset field indicates the total length of the entity being
+ * transferred, which may exceed the length of the data delivered via
+ * this interface (e.g. when only a partial content range has been
+ * requested).
+ */
+#define XFER_FL_TOTAL 0x0020
+
+/** Sender can supply arbitrary partial ranges of the entity
+ *
+ * Valid only in conjunction with @c XFER_FL_TOTAL.
+ */
+#define XFER_FL_RANGES 0x0040
+
 /* Data transfer interface operations */
 
 extern int xfer_vredirect ( struct interface *intf, int type,
@@ -103,6 +118,8 @@ extern int xfer_vprintf ( struct interface *intf,
 extern int __attribute__ (( format ( printf, 2, 3 ) ))
 xfer_printf ( struct interface *intf, const char *format, ... );
 extern int xfer_seek ( struct interface *intf, off_t offset );
+extern int xfer_describe ( struct interface *intf, unsigned int flags,
+			   off_t total );
 extern int xfer_check_order ( struct xfer_metadata *meta, size_t *pos,
 			      size_t len );
 
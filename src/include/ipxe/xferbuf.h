@@ -21,6 +21,13 @@ struct xfer_buffer {
 	void *data;
 	/** Size of data */
 	size_t len;
+	/** Size of allocation
+	 *
+	 * This may exceed the size of the data, since the allocation
+	 * is grown geometrically to avoid recopying the entire buffer
+	 * contents for every delivered packet.
+	 */
+	size_t allocated;
 	/** Current offset within data */
 	size_t pos;
 	/** Data transfer buffer operations */
@@ -64,8 +71,33 @@ struct xfer_buffer_operations {
 			  void *data, size_t len );
 };
 
+/** Length of each extent in an extent-based data transfer buffer
+ *
+ * This is a policy decision.
+ */
+#ifndef XFERBUF_EXTENT_LEN
+#define XFERBUF_EXTENT_LEN ( 1024 * 1024 )
+#endif
+
+/** An extent table for an extent-based data transfer buffer
+ *
+ * An extent-based buffer is stored as a series of fixed-size extents
+ * allocated on demand, rather than as a single contiguous allocation.
+ * Growing the buffer extends only the table of extent pointers and so
+ * never recopies existing data; the buffer contents are accessible
+ * only via xferbuf_read() and xferbuf_write(), which scatter and
+ * gather across extent boundaries.
+ */
+struct xfer_buffer_extents {
+	/** Extents */
+	userptr_t *extent;
+	/** Number of allocated extents */
+	unsigned int count;
+};
+
 extern struct xfer_buffer_operations xferbuf_malloc_operations;
 extern struct xfer_buffer_operations xferbuf_umalloc_operations;
+extern struct xfer_buffer_operations xferbuf_extent_operations;
 
 /**
  * Initialise malloc()-based data transfer buffer
@@ -89,6 +121,19 @@ xferbuf_umalloc_init ( struct xfer_buffer *xferbuf, userptr_t *data ) {
 	xferbuf->op = &xferbuf_umalloc_operations;
 }
 
+/**
+ * Initialise extent-based data transfer buffer
+ *
+ * @v xferbuf		Data transfer buffer
+ * @v extents		Extent table
+ */
+static inline __attribute__ (( always_inline )) void
+xferbuf_extent_init ( struct xfer_buffer *xferbuf,
+		      struct xfer_buffer_extents *extents ) {
+	xferbuf->data = extents;
+	xferbuf->op = &xferbuf_extent_operations;
+}
+
 extern void xferbuf_free ( struct xfer_buffer *xferbuf );
 extern int xferbuf_write ( struct xfer_buffer *xferbuf, size_t offset,
 			   const void *data, size_t len );
@@ -0,0 +1,97 @@
+#ifndef _IPXE_ZSTD_H
+#define _IPXE_ZSTD_H
+
+/** @file
+ *
+ * Zstandard decompression (RFC 8878)
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** Magic number for a Zstandard frame */
+#define ZSTD_MAGIC 0xfd2fb528UL
+
+/** Magic number for a skippable frame (low nibble is arbitrary) */
+#define ZSTD_MAGIC_SKIP 0x184d2a50UL
+
+/** Mask for skippable frame magic numbers */
+#define ZSTD_MAGIC_SKIP_MASK 0xfffffff0UL
+
+/** Maximum regenerated literals per block (128kB) */
+#define ZSTD_MAX_LITERALS 0x20000
+
+/** Maximum Huffman table log */
+#define ZSTD_HUF_MAX_LOG 11
+
+/** Maximum FSE table log (literal and match length tables) */
+#define ZSTD_FSE_MAX_LOG 9
+
+/** An FSE decoding table entry */
+struct zstd_fse_entry {
+	/** Next state baseline */
+	uint16_t base;
+	/** Decoded symbol */
+	uint8_t symbol;
+	/** Number of bits consumed by state transition */
+	uint8_t bits;
+};
+
+/** An FSE decoding table */
+struct zstd_fse {
+	/** Table log (may legitimately be zero, for RLE tables) */
+	unsigned int log;
+	/** Table contains valid data */
+	int valid;
+	/** Table entries */
+	struct zstd_fse_entry entry[ 1 << ZSTD_FSE_MAX_LOG ];
+};
+
+/** A Huffman decoding table entry */
+struct zstd_huf_entry {
+	/** Decoded symbol */
+	uint8_t symbol;
+	/** Number of bits consumed */
+	uint8_t bits;
+};
+
+/** A Huffman decoding table */
+struct zstd_huf {
+	/** Table log (zero if table is not yet valid) */
+	unsigned int log;
+	/** Table entries */
+	struct zstd_huf_entry entry[ 1 << ZSTD_HUF_MAX_LOG ];
+};
+
+/** A Zstandard decompressor workspace
+ *
+ * This is too large (approximately 150kB, dominated by the literals
+ * buffer) to live on the stack or to be reliably available from the
+ * internal heap: callers should allocate it via umalloc().
+ */
+struct zstd {
+	/** Huffman literals table (persists between blocks) */
+	struct zstd_huf huf;
+	/** Literal lengths FSE table (persists between blocks) */
+	struct zstd_fse ll;
+	/** Offsets FSE table (persists between blocks) */
+	struct zstd_fse of;
+	/** Match lengths FSE table (persists between blocks) */
+	struct zstd_fse ml;
+	/** Huffman weights FSE table (scratch) */
+	struct zstd_fse wt;
+	/** Repeat offset history */
+	unsigned long rep[3];
+	/** Decoded literals for current block */
+	uint8_t literals[ZSTD_MAX_LITERALS];
+};
+
+extern int zstd_decompressed_len ( const void *data, size_t len,
+				   size_t *out_len );
+extern int zstd_decompress ( struct zstd *zstd, const void *data, size_t len,
+			     void *out, size_t out_max, size_t *out_len );
+
+#endif /* _IPXE_ZSTD_H */
@@ -9,14 +9,21 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+#include <ipxe/timer.h>
+
 struct net_device;
 struct net_device_configurator;
 
+/** Default time to wait for link-up */
+#define LINK_WAIT_TIMEOUT ( 15 * TICKS_PER_SEC )
+
 extern int ifopen ( struct net_device *netdev );
 extern int ifconf ( struct net_device *netdev,
 		    struct net_device_configurator *configurator );
 extern void ifclose ( struct net_device *netdev );
 extern void ifstat ( struct net_device *netdev );
+extern void ifstat_tcp ( void );
 extern int iflinkwait ( struct net_device *netdev, unsigned long timeout );
+extern int iflinkwait_any ( unsigned long timeout );
 
 #endif /* _USR_IFMGMT_H */
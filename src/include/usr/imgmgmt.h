@@ -15,6 +15,12 @@ extern int imgdownload ( struct uri *uri, unsigned long timeout,
 			 struct image **image );
 extern int imgdownload_string ( const char *uri_string, unsigned long timeout,
 				struct image **image );
+extern int imgdownload_async ( struct uri *uri, struct image **image );
+extern int imgdownload_string_async ( const char *uri_string,
+				      struct image **image );
+extern void imgjobs ( void );
+extern int imgwait ( void );
+extern int imgwait_image ( struct image *image );
 extern int imgacquire ( const char *name, unsigned long timeout,
 			struct image **image );
 extern void imgstat ( struct image *image );
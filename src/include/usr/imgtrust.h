@@ -13,5 +13,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 extern int imgverify ( struct image *image, struct image *signature,
 		       const char *name );
+extern int imgverify_download ( struct image *image, const char *name_uri,
+				unsigned long timeout, const char *name,
+				struct image **signature );
 
 #endif /* _USR_IMGTRUST_H */
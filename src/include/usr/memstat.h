@@ -0,0 +1,14 @@
+#ifndef _USR_MEMSTAT_H
+#define _USR_MEMSTAT_H
+
+/** @file
+ *
+ * Memory usage statistics
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+extern void memstat ( void );
+
+#endif /* _USR_MEMSTAT_H */
@@ -0,0 +1,17 @@
+#ifndef _USR_NBMGMT_H
+#define _USR_NBMGMT_H
+
+/** @file
+ *
+ * Network benchmark management
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+
+extern int netbench ( const char *hostname, unsigned int port, int semantics,
+		      int rx, size_t len, unsigned long duration );
+
+#endif /* _USR_NBMGMT_H */
@@ -0,0 +1,14 @@
+#ifndef _USR_PKTCAPMGMT_H
+#define _USR_PKTCAPMGMT_H
+
+/** @file
+ *
+ * Packet capture management
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+extern int pktcap ( const char *uri_string );
+
+#endif /* _USR_PKTCAPMGMT_H */
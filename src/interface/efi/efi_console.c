@@ -197,21 +197,65 @@ static struct ansiesc_context efi_ansiesc_ctx = {
 	.handlers = efi_ansiesc_handlers,
 };
 
+/** Size of console output buffer (in characters)
+ *
+ * OutputString() can take milliseconds per call on consoles redirected
+ * over serial-over-LAN by a BMC, so runs of plain text are buffered
+ * and emitted in a single call rather than character by character.
+ */
+#define EFI_CONSOLE_BUFSIZE 256
+
+/** Console output buffer */
+static wchar_t efi_wbuf[ EFI_CONSOLE_BUFSIZE + 1 /* wNUL */ ];
+
+/** Console output buffer fill level */
+static size_t efi_wbuf_used;
+
+/**
+ * Flush console output buffer
+ *
+ */
+static void efi_console_flush ( void ) {
+	EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *conout = efi_systab->ConOut;
+
+	/* Do nothing if buffer is empty */
+	if ( ! efi_wbuf_used )
+		return;
+
+	/* Output buffered text */
+	efi_wbuf[efi_wbuf_used] = L'\0';
+	efi_wbuf_used = 0;
+	conout->OutputString ( conout, efi_wbuf );
+}
+
 /**
  * Print a character to EFI console
  *
  * @v character		Character to be printed
  */
 static void efi_putchar ( int character ) {
-	EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *conout = efi_systab->ConOut;
-	wchar_t wstr[] = { character, 0 };
+
+	/* Flush buffered text before an escape sequence is processed,
+	 * so that cursor movements, attribute changes, and screen
+	 * clearing take effect in the correct order.
+	 */
+	if ( character == ESC )
+		efi_console_flush();
 
 	/* Intercept ANSI escape sequences */
 	character = ansiesc_process ( &efi_ansiesc_ctx, character );
 	if ( character < 0 )
 		return;
 
-	conout->OutputString ( conout, wstr );
+	/* Buffer character, flushing on newline or a full buffer.
+	 * Text not ending in a newline (e.g. a prompt) is flushed
+	 * when the console is next polled for input.
+	 */
+	efi_wbuf[efi_wbuf_used++] = character;
+	if ( ( character == '\n' ) ||
+	     ( efi_wbuf_used == EFI_CONSOLE_BUFSIZE ) ) {
+		efi_console_flush();
+	}
 }
 
 /**
@@ -283,6 +327,9 @@ static int efi_getchar ( void ) {
 	EFI_STATUS efirc;
 	int rc;
 
+	/* Flush any buffered output */
+	efi_console_flush();
+
 	/* If we are mid-sequence, pass out the next byte */
 	if ( *ansi_input )
 		return *(ansi_input++);
@@ -321,6 +368,12 @@ static int efi_iskey ( void ) {
 	EFI_SIMPLE_TEXT_INPUT_PROTOCOL *conin = efi_systab->ConIn;
 	EFI_STATUS efirc;
 
+	/* Flush any buffered output.  Anything that waits for user
+	 * input will poll for a key, so this guarantees that prompts
+	 * are displayed before the wait.
+	 */
+	efi_console_flush();
+
 	/* If we are mid-sequence, we are always ready */
 	if ( *ansi_input )
 		return 1;
@@ -179,6 +179,17 @@ efi_download_abort ( IPXE_DOWNLOAD_PROTOCOL *This __unused,
 	return EFI_SUCCESS;
 }
 
+/** Number of scheduler steps executed per Poll invocation
+ *
+ * A single step runs only one process, which may not be the network
+ * process at all; a consumer that interleaves Poll with long
+ * per-extent work (e.g. disk writes) would then drive the download at
+ * one process step per extent.  Running a small batch of steps per
+ * call guarantees the network stack makes progress on every Poll,
+ * delivering all extents received in the meantime.
+ */
+#define EFI_DOWNLOAD_POLL_STEPS 8
+
 /**
  * Poll for more data from iPXE. This function will invoke the registered
  * callbacks if data is available or if downloads complete.
@@ -188,7 +199,10 @@ efi_download_abort ( IPXE_DOWNLOAD_PROTOCOL *This __unused,
  */
 static EFI_STATUS EFIAPI
 efi_download_poll ( IPXE_DOWNLOAD_PROTOCOL *This __unused ) {
-	step();
+	unsigned int i;
+
+	for ( i = 0 ; i < EFI_DOWNLOAD_POLL_STEPS ; i++ )
+		step();
 	return EFI_SUCCESS;
 }
 
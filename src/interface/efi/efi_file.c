@@ -46,10 +46,14 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/efi/Guid/FileSystemInfo.h>
 #include <ipxe/efi/efi_strings.h>
 #include <ipxe/efi/efi_file.h>
+#include <ipxe/efi/efi_file_buffer.h>
 
 /** EFI media ID */
 #define EFI_MEDIA_ID_MAGIC 0x69505845
 
+/** iPXE file buffer information GUID */
+static EFI_GUID efi_file_buffer_id = IPXE_FILE_BUFFER_GUID;
+
 /** An image exposed as an EFI file */
 struct efi_file {
 	/** EFI file protocol */
@@ -400,6 +404,7 @@ static EFI_STATUS EFIAPI efi_file_get_info ( EFI_FILE_PROTOCOL *this,
 					     UINTN *len, VOID *data ) {
 	struct efi_file *file = container_of ( this, struct efi_file, file );
 	EFI_FILE_SYSTEM_INFO fsinfo;
+	IPXE_FILE_BUFFER buffer;
 	struct image *image;
 
 	/* Determine information to return */
@@ -423,6 +428,30 @@ static EFI_STATUS EFIAPI efi_file_get_info ( EFI_FILE_PROTOCOL *this,
 		return efi_file_varlen ( &fsinfo.Size,
 					 SIZE_OF_EFI_FILE_SYSTEM_INFO, "iPXE",
 					 len, data );
+
+	} else if ( memcmp ( type, &efi_file_buffer_id,
+			     sizeof ( *type ) ) == 0 ) {
+
+		/* Get in-place file buffer information, allowing
+		 * consumers to use the image data directly rather
+		 * than copying it out via Read().
+		 */
+		if ( ! file->image ) {
+			DBGC ( file, "EFIFILE root directory has no buffer\n" );
+			return EFI_UNSUPPORTED;
+		}
+		DBGC ( file, "EFIFILE %s get file buffer information\n",
+		       efi_file_name ( file ) );
+		if ( *len < sizeof ( buffer ) ) {
+			*len = sizeof ( buffer );
+			return EFI_BUFFER_TOO_SMALL;
+		}
+		buffer.Buffer = image_phys ( file->image );
+		buffer.Length = file->image->len;
+		*len = sizeof ( buffer );
+		memcpy ( data, &buffer, sizeof ( buffer ) );
+		return 0;
+
 	} else {
 
 		DBGC ( file, "EFIFILE %s cannot get information of type %s\n",
@@ -61,18 +61,31 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  ******************************************************************************
  */
 
+/** Cached PCI root bridge
+ *
+ * Root bridge handles persist for the lifetime of boot services, so
+ * the looked-up protocol may be cached rather than re-enumerating the
+ * firmware handle database on every configuration space access.
+ */
+static struct {
+	/** Root bridge I/O protocol (NULL if cache is empty) */
+	EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *root;
+	/** Segment number */
+	unsigned int segment;
+} efipci_root_cache;
+
 /**
  * Locate EFI PCI root bridge I/O protocol
  *
  * @v pci		PCI device
- * @ret handle		EFI PCI root bridge handle
  * @ret root		EFI PCI root bridge I/O protocol, or NULL if not found
  * @ret rc		Return status code
  */
-static int efipci_root ( struct pci_device *pci, EFI_HANDLE *handle,
+static int efipci_root ( struct pci_device *pci,
 			 EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL **root ) {
 	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
 	EFI_HANDLE *handles;
+	EFI_HANDLE handle;
 	UINTN num_handles;
 	union {
 		void *interface;
@@ -82,6 +95,13 @@ static int efipci_root ( struct pci_device *pci, EFI_HANDLE *handle,
 	UINTN i;
 	int rc;
 
+	/* Use cached root bridge, if applicable */
+	if ( efipci_root_cache.root &&
+	     ( efipci_root_cache.segment == PCI_SEG ( pci->busdevfn ) ) ) {
+		*root = efipci_root_cache.root;
+		return 0;
+	}
+
 	/* Enumerate all handles */
 	if ( ( efirc = bs->LocateHandleBuffer ( ByProtocol,
 			&efi_pci_root_bridge_io_protocol_guid,
@@ -94,25 +114,30 @@ static int efipci_root ( struct pci_device *pci, EFI_HANDLE *handle,
 
 	/* Look for matching root bridge I/O protocol */
 	for ( i = 0 ; i < num_handles ; i++ ) {
-		*handle = handles[i];
-		if ( ( efirc = bs->OpenProtocol ( *handle,
+		handle = handles[i];
+		if ( ( efirc = bs->OpenProtocol ( handle,
 				&efi_pci_root_bridge_io_protocol_guid,
-				&u.interface, efi_image_handle, *handle,
+				&u.interface, efi_image_handle, handle,
 				EFI_OPEN_PROTOCOL_GET_PROTOCOL ) ) != 0 ) {
 			rc = -EEFI ( efirc );
 			DBGC ( pci, "EFIPCI " PCI_FMT " cannot open %s: %s\n",
-			       PCI_ARGS ( pci ), efi_handle_name ( *handle ),
+			       PCI_ARGS ( pci ), efi_handle_name ( handle ),
 			       strerror ( rc ) );
 			continue;
 		}
 		if ( u.root->SegmentNumber == PCI_SEG ( pci->busdevfn ) ) {
+			/* Cache this root bridge (leaving the
+			 * protocol open) for subsequent accesses.
+			 */
+			efipci_root_cache.root = u.root;
+			efipci_root_cache.segment = PCI_SEG ( pci->busdevfn );
 			*root = u.root;
 			bs->FreePool ( handles );
 			return 0;
 		}
-		bs->CloseProtocol ( *handle,
+		bs->CloseProtocol ( handle,
 				    &efi_pci_root_bridge_io_protocol_guid,
-				    efi_image_handle, *handle );
+				    efi_image_handle, handle );
 	}
 	DBGC ( pci, "EFIPCI " PCI_FMT " found no root bridge\n",
 	       PCI_ARGS ( pci ) );
@@ -149,14 +174,12 @@ static unsigned long efipci_address ( struct pci_device *pci,
  */
 int efipci_read ( struct pci_device *pci, unsigned long location,
 		  void *value ) {
-	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
 	EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *root;
-	EFI_HANDLE handle;
 	EFI_STATUS efirc;
 	int rc;
 
 	/* Identify root bridge */
-	if ( ( rc = efipci_root ( pci, &handle, &root ) ) != 0 )
+	if ( ( rc = efipci_root ( pci, &root ) ) != 0 )
 		goto err_root;
 
 	/* Read from configuration space */
@@ -171,8 +194,6 @@ int efipci_read ( struct pci_device *pci, unsigned long location,
 	}
 
  err_read:
-	bs->CloseProtocol ( handle, &efi_pci_root_bridge_io_protocol_guid,
-			    efi_image_handle, handle );
  err_root:
 	return rc;
 }
@@ -187,14 +208,12 @@ int efipci_read ( struct pci_device *pci, unsigned long location,
  */
 int efipci_write ( struct pci_device *pci, unsigned long location,
 		   unsigned long value ) {
-	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
 	EFI_PCI_ROOT_BRIDGE_IO_PROTOCOL *root;
-	EFI_HANDLE handle;
 	EFI_STATUS efirc;
 	int rc;
 
 	/* Identify root bridge */
-	if ( ( rc = efipci_root ( pci, &handle, &root ) ) != 0 )
+	if ( ( rc = efipci_root ( pci, &root ) ) != 0 )
 		goto err_root;
 
 	/* Read from configuration space */
@@ -209,8 +228,6 @@ int efipci_write ( struct pci_device *pci, unsigned long location,
 	}
 
  err_write:
-	bs->CloseProtocol ( handle, &efi_pci_root_bridge_io_protocol_guid,
-			    efi_image_handle, handle );
  err_root:
 	return rc;
 }
@@ -155,6 +155,7 @@ static void efi_snp_flush ( struct efi_snp_device *snpdev ) {
 		list_del ( &iobuf->list );
 		free_iob ( iobuf );
 	}
+	snpdev->rx_count = 0;
 }
 
 /**
@@ -165,13 +166,31 @@ static void efi_snp_flush ( struct efi_snp_device *snpdev ) {
 static void efi_snp_poll ( struct efi_snp_device *snpdev ) {
 	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
 	struct io_buffer *iobuf;
+	unsigned int received = 0;
 
 	/* Poll network device */
 	netdev_poll ( snpdev->netdev );
 
-	/* Retrieve any received packets */
+	/* Retrieve all received packets in one batch */
 	while ( ( iobuf = netdev_rx_dequeue ( snpdev->netdev ) ) ) {
 		list_add_tail ( &iobuf->list, &snpdev->rx );
+		snpdev->rx_count++;
+		received++;
+
+		/* Discard oldest frame if the queue is overfull */
+		if ( snpdev->rx_count > EFI_SNP_NUM_RX ) {
+			iobuf = list_first_entry ( &snpdev->rx,
+						   struct io_buffer, list );
+			DBGC ( snpdev, "SNPDEV %p RX queue full; dropping "
+			       "%zd bytes\n", snpdev, iob_len ( iobuf ) );
+			list_del ( &iobuf->list );
+			free_iob ( iobuf );
+			snpdev->rx_count--;
+		}
+	}
+
+	/* Signal the receive event (once per batch, not per frame) */
+	if ( received ) {
 		snpdev->interrupts |= EFI_SIMPLE_NETWORK_RECEIVE_INTERRUPT;
 		bs->SignalEvent ( &snpdev->snp.WaitForPacket );
 	}
@@ -782,8 +801,14 @@ efi_snp_receive ( EFI_SIMPLE_NETWORK_PROTOCOL *snp,
 	/* Raise TPL */
 	saved_tpl = bs->RaiseTPL ( TPL_CALLBACK );
 
-	/* Poll the network device */
-	efi_snp_poll ( snpdev );
+	/* Poll the network device only if no previously harvested
+	 * frames remain queued.  Each poll is a round trip into the
+	 * driver; harvesting in batches allows a consumer that polls
+	 * via GetStatus()/Receive() to drain one poll's worth of
+	 * frames paying that cost only once.
+	 */
+	if ( list_empty ( &snpdev->rx ) )
+		efi_snp_poll ( snpdev );
 
 	/* Check for an available packet */
 	iobuf = list_first_entry ( &snpdev->rx, struct io_buffer, list );
@@ -796,6 +821,7 @@ efi_snp_receive ( EFI_SIMPLE_NETWORK_PROTOCOL *snp,
 
 	/* Dequeue packet */
 	list_del ( &iobuf->list );
+	snpdev->rx_count--;
 
 	/* Return packet to caller, truncating to buffer length */
 	copy_len = iob_len ( iobuf );
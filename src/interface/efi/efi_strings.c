@@ -77,6 +77,7 @@ int efi_vsnprintf ( wchar_t *wbuf, size_t wsize, const char *fmt,
 
 	/* Hand off to vcprintf */
 	sctx.ctx.handler = efi_printf_sputc;
+	sctx.ctx.bulk = NULL;
 	sctx.buf = wbuf;
 	sctx.max_wlen = wsize;
 	wlen = vcprintf ( &sctx.ctx, fmt, args );
@@ -38,6 +38,18 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Equivalent of NOWHERE for user pointers */
 #define UNOWHERE ( ~UNULL )
 
+/** An external memory allocation header
+ *
+ * This header occupies the first allocated page; the data region
+ * begins at the following page boundary.
+ */
+struct efi_umalloc_header {
+	/** Size of data region, as requested by the caller */
+	size_t size;
+	/** Total number of allocated pages (including header page) */
+	unsigned int pages;
+};
+
 /**
  * Reallocate external memory
  *
@@ -51,12 +63,35 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 static userptr_t efi_urealloc ( userptr_t old_ptr, size_t new_size ) {
 	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
 	EFI_PHYSICAL_ADDRESS phys_addr;
-	unsigned int new_pages, old_pages;
+	struct efi_umalloc_header new_header;
+	struct efi_umalloc_header header;
+	unsigned int new_pages;
 	userptr_t new_ptr = UNOWHERE;
-	size_t old_size;
 	EFI_STATUS efirc;
 	int rc;
 
+	/* Read existing allocation header (if any) */
+	memset ( &header, 0, sizeof ( header ) );
+	if ( old_ptr && ( old_ptr != UNOWHERE ) ) {
+		copy_from_user ( &header, old_ptr, -EFI_PAGE_SIZE,
+				 sizeof ( header ) );
+	}
+
+	/* Reuse the existing allocation in place if the new size fits
+	 * within the pages already allocated.  Each AllocatePages()
+	 * or FreePages() call may force the firmware to rewrite its
+	 * memory map (at O(N) cost on some implementations), and a
+	 * reallocation additionally recopies the entire data region;
+	 * both are wasted effort if the existing pages suffice.
+	 */
+	if ( old_ptr && ( old_ptr != UNOWHERE ) && new_size &&
+	     ( ( EFI_SIZE_TO_PAGES ( new_size ) + 1 ) <= header.pages ) ) {
+		header.size = new_size;
+		copy_to_user ( old_ptr, -EFI_PAGE_SIZE, &header,
+			       sizeof ( header ) );
+		return old_ptr;
+	}
+
 	/* Allocate new memory if necessary.  If allocation fails,
 	 * return without touching the old block.
 	 */
@@ -73,8 +108,10 @@ static userptr_t efi_urealloc ( userptr_t old_ptr, size_t new_size ) {
 		}
 		assert ( phys_addr != 0 );
 		new_ptr = phys_to_user ( phys_addr + EFI_PAGE_SIZE );
+		new_header.size = new_size;
+		new_header.pages = new_pages;
 		copy_to_user ( new_ptr, -EFI_PAGE_SIZE,
-			       &new_size, sizeof ( new_size ) );
+			       &new_header, sizeof ( new_header ) );
 		DBG ( "EFI allocated %d pages at %llx\n",
 		      new_pages, phys_addr );
 	}
@@ -85,21 +122,20 @@ static userptr_t efi_urealloc ( userptr_t old_ptr, size_t new_size ) {
 	 * valid.
 	 */
 	if ( old_ptr && ( old_ptr != UNOWHERE ) ) {
-		copy_from_user ( &old_size, old_ptr, -EFI_PAGE_SIZE,
-				 sizeof ( old_size ) );
 		memcpy_user ( new_ptr, 0, old_ptr, 0,
-			      ( (old_size < new_size) ? old_size : new_size ));
-		old_pages = ( EFI_SIZE_TO_PAGES ( old_size ) + 1 );
+			      ( ( header.size < new_size ) ?
+				header.size : new_size ) );
 		phys_addr = user_to_phys ( old_ptr, -EFI_PAGE_SIZE );
-		if ( ( efirc = bs->FreePages ( phys_addr, old_pages ) ) != 0 ){
+		if ( ( efirc = bs->FreePages ( phys_addr,
+					       header.pages ) ) != 0 ) {
 			rc = -EEFI ( efirc );
 			DBG ( "EFI could not free %d pages at %llx: %s\n",
-			      old_pages, phys_addr, strerror ( rc ) );
+			      header.pages, phys_addr, strerror ( rc ) );
 			/* Not fatal; we have leaked memory but successfully
 			 * allocated (if asked to do so).
 			 */
 		}
-		DBG ( "EFI freed %d pages at %llx\n", old_pages, phys_addr );
+		DBG ( "EFI freed %d pages at %llx\n", header.pages, phys_addr );
 	}
 
 	return new_ptr;
@@ -25,6 +25,7 @@ FILE_LICENCE(GPL2_OR_LATER);
  */
 
 #include <ipxe/console.h>
+#include <ipxe/linux.h>
 
 #include <ipxe/init.h>
 #include <ipxe/keys.h>
@@ -140,11 +141,16 @@ static void linux_console_startup(void)
 
 	if (linux_tcsetattr(0, TCSAFLUSH, &t))
 		DBG("linux_console tcsetattr failed (%s)", linux_strerror(linux_errno));
+
+	/* Wake any nap on console input */
+	linux_watch_fd(0);
 }
 
 /** Restores original terminal attributes on shutdown */
 static void linux_console_shutdown(int flags __unused)
 {
+	linux_unwatch_fd(0);
+
 	if (linux_tcsetattr(0, TCSAFLUSH, &saved_termios))
 		DBG("linux_console tcsetattr failed (%s)", linux_strerror(linux_errno));
 }
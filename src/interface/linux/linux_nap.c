@@ -20,6 +20,7 @@
 FILE_LICENCE(GPL2_OR_LATER);
 
 #include <ipxe/nap.h>
+#include <ipxe/linux.h>
 
 #include <linux_api.h>
 
@@ -29,13 +30,59 @@ FILE_LICENCE(GPL2_OR_LATER);
  *
  */
 
+/** Maximum time to sleep awaiting I/O (in milliseconds)
+ *
+ * The sleep is bounded so that currticks()-driven timers (e.g.
+ * retransmission timers) continue to fire while napping.  A hundred
+ * wakeups per second is a negligible load; the old usleep(0) nap
+ * returned immediately and so busy-spun a whole core per instance.
+ */
+#define LINUX_NAP_TIMEOUT_MS 10
+
+/** Maximum number of watched file descriptors */
+#define LINUX_NAP_MAX_FDS 8
+
+/** Watched file descriptors */
+static struct pollfd linux_nap_fds[LINUX_NAP_MAX_FDS];
+
+/** Number of watched file descriptors */
+static nfds_t linux_nap_count;
+
+/** Watch a file descriptor for wakeup events while napping */
+void linux_watch_fd(int fd)
+{
+	if (linux_nap_count >= LINUX_NAP_MAX_FDS) {
+		DBG("linux_nap cannot watch fd %d\n", fd);
+		return;
+	}
+	linux_nap_fds[linux_nap_count].fd = fd;
+	linux_nap_fds[linux_nap_count].events = POLLIN;
+	linux_nap_count++;
+}
+
+/** Stop watching a file descriptor */
+void linux_unwatch_fd(int fd)
+{
+	nfds_t i;
+
+	for (i = 0; i < linux_nap_count; i++) {
+		if (linux_nap_fds[i].fd == fd) {
+			linux_nap_fds[i] = linux_nap_fds[--linux_nap_count];
+			return;
+		}
+	}
+}
+
 /**
- * Sleep until next CPU interrupt
+ * Sleep until the next I/O or timer event
  *
+ * Blocks in poll() on the watched file descriptors, so an idle
+ * instance sleeps instead of spinning.  Only a handful of descriptors
+ * are ever watched, so poll() performs the same as epoll would.
  */
 static void linux_cpu_nap(void)
 {
-	linux_usleep(0);
+	linux_poll(linux_nap_fds, linux_nap_count, LINUX_NAP_TIMEOUT_MS);
 }
 
 PROVIDE_NAP(linux, cpu_nap, linux_cpu_nap);
@@ -41,6 +41,34 @@ static struct smbios smbios = {
 	.address = UNULL,
 };
 
+/** A cached SMBIOS structure location */
+struct smbios_cached_structure {
+	/** Structure type */
+	unsigned int type;
+	/** Instance of this type of structure */
+	unsigned int instance;
+	/** Structure descriptor */
+	struct smbios_structure structure;
+};
+
+/** Number of cached structure locations
+ *
+ * The SMBIOS tables are immutable, so locations may be cached
+ * indefinitely.  Settings expansion fetches the same handful of
+ * structures repeatedly; without the cache, each fetch rescans the
+ * tables from the start.
+ */
+#define SMBIOS_CACHE_COUNT 8
+
+/** Most recently located structures */
+static struct smbios_cached_structure smbios_cache[SMBIOS_CACHE_COUNT];
+
+/** Number of valid cached structure locations */
+static unsigned int smbios_cache_used;
+
+/** Next cached structure location to evict */
+static unsigned int smbios_cache_evict;
+
 /**
  * Scan for SMBIOS entry point structure
  *
@@ -117,7 +145,10 @@ static size_t find_strings_terminator ( size_t offset ) {
  */
 int find_smbios_structure ( unsigned int type, unsigned int instance,
 			    struct smbios_structure *structure ) {
+	struct smbios_cached_structure *cached;
+	unsigned int wanted = instance;
 	unsigned int count = 0;
+	unsigned int i;
 	size_t offset = 0;
 	size_t strings_offset;
 	size_t terminator_offset;
@@ -129,6 +160,17 @@ int find_smbios_structure ( unsigned int type, unsigned int instance,
 		return rc;
 	assert ( smbios.address != UNULL );
 
+	/* Return cached structure location, if any */
+	for ( i = 0 ; i < smbios_cache_used ; i++ ) {
+		cached = &smbios_cache[i];
+		if ( ( cached->type == type ) &&
+		     ( cached->instance == wanted ) ) {
+			memcpy ( structure, &cached->structure,
+				 sizeof ( *structure ) );
+			return 0;
+		}
+	}
+
 	/* Scan through list of structures */
 	while ( ( ( offset + sizeof ( structure->header ) ) < smbios.len )
 		&& ( count < smbios.count ) ) {
@@ -157,10 +199,21 @@ int find_smbios_structure ( unsigned int type, unsigned int instance,
 		      "strings length %zx\n", offset, structure->header.type,
 		      structure->header.len, structure->strings_len );
 
-		/* If this is the structure we want, return */
+		/* If this is the structure we want, cache its
+		 * location and return.
+		 */
 		if ( ( structure->header.type == type ) &&
 		     ( instance-- == 0 ) ) {
 			structure->offset = offset;
+			cached = &smbios_cache[smbios_cache_evict];
+			smbios_cache_evict = ( ( smbios_cache_evict + 1 ) %
+					       SMBIOS_CACHE_COUNT );
+			if ( smbios_cache_used < SMBIOS_CACHE_COUNT )
+				smbios_cache_used++;
+			cached->type = type;
+			cached->instance = wanted;
+			memcpy ( &cached->structure, structure,
+				 sizeof ( cached->structure ) );
 			return 0;
 		}
 
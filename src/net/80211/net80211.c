@@ -183,6 +183,17 @@ static void net80211_rx_frag ( struct net80211_device *dev,
 			       struct io_buffer *iob, int signal );
 /** @} */
 
+/**
+ * @defgroup net80211_blockack 802.11 block ACK handling functions
+ * @{
+ */
+static void net80211_handle_action ( struct net80211_device *dev,
+				     struct io_buffer *iob );
+static void net80211_block_ack_stop ( struct net80211_device *dev );
+static void net80211_rx_block_ack ( struct net80211_device *dev,
+				    struct io_buffer *iob );
+/** @} */
+
 /**
  * @defgroup net80211_settings 802.11 settings handlers
  * @{
@@ -287,6 +298,9 @@ static void net80211_netdev_close ( struct net_device *netdev )
 	if ( dev->state & NET80211_WORKING )
 		process_del ( &dev->proc_assoc );
 
+	/* Flush any block ACK reordering buffer */
+	net80211_block_ack_stop ( dev );
+
 	/* Send disassociation frame to AP, to be polite */
 	if ( dev->state & NET80211_ASSOCIATED )
 		net80211_send_disassoc ( dev, IEEE80211_REASON_LEAVING, 0 );
@@ -1244,6 +1258,21 @@ net80211_marshal_request_info ( struct net80211_device *dev,
 		ie = ieee80211_next_ie ( ie, NULL );
 	}
 
+	if ( dev->hw->flags & NET80211_HW_RX_HT ) {
+		/* Advertise HT support, so that the AP may use HT
+		   rates and frame aggregation towards us. We accept
+		   single-stream (MCS 0-7) rates at 20MHz only. */
+		struct ieee80211_ie_ht_capab *htcap = &ie->ht_capab;
+
+		memset ( htcap, 0, sizeof ( *htcap ) );
+		htcap->id = IEEE80211_IE_HT_CAPAB;
+		htcap->len = sizeof ( *htcap ) - 2;
+		htcap->capab_info = IEEE80211_HT_CAPAB_SGI_20MHZ;
+		htcap->mcs_set[0] = 0xFF; /* MCS 0-7 */
+
+		ie = ieee80211_next_ie ( ie, NULL );
+	}
+
 	if ( dev->rsn_ie && dev->rsn_ie->id == IEEE80211_IE_VENDOR ) {
 		memcpy ( ie, dev->rsn_ie, dev->rsn_ie->len + 2 );
 		ie = ieee80211_next_ie ( ie, NULL );
@@ -1308,7 +1337,7 @@ struct net80211_probe_ctx * net80211_probe_start ( struct net80211_device *dev,
 		struct ieee80211_probe_req *probe_req;
 		union ieee80211_ie *ie;
 
-		ctx->probe = alloc_iob ( 128 );
+		ctx->probe = alloc_iob ( 192 );
 		iob_reserve ( ctx->probe, IEEE80211_TYP_FRAME_HEADER_LEN );
 		probe_req = ctx->probe->data;
 
@@ -2287,7 +2316,7 @@ static void net80211_handle_auth ( struct net80211_device *dev,
 int net80211_send_assoc ( struct net80211_device *dev,
 			  struct net80211_wlan *wlan )
 {
-	struct io_buffer *iob = alloc_iob ( 128 );
+	struct io_buffer *iob = alloc_iob ( 192 );
 	struct ieee80211_assoc_req *assoc;
 	union ieee80211_ie *ie;
 
@@ -2461,6 +2490,9 @@ static void net80211_handle_mgmt ( struct net80211_device *dev,
 		       dev, is_deauth ? "deauthenticated" : "disassociated",
 		       disassoc->reason );
 
+		/* Any block ACK session died with the association. */
+		net80211_block_ack_stop ( dev );
+
 		/* Try to reassociate, in case it's transient. */
 		net80211_autoassociate ( dev );
 
@@ -2485,6 +2517,8 @@ static void net80211_handle_mgmt ( struct net80211_device *dev,
 		/* fall through */
 	case IEEE80211_STYPE_PROBE_RESP:
 	case IEEE80211_STYPE_ACTION:
+		if ( stype == IEEE80211_STYPE_ACTION )
+			net80211_handle_action ( dev, iob );
 		if ( dev->keep_mgmt ) {
 			struct net80211_rx_info *rxinf;
 			rxinf = zalloc ( sizeof ( *rxinf ) );
@@ -2676,6 +2710,190 @@ static void net80211_rx_frag ( struct net80211_device *dev,
 	}
 }
 
+/**
+ * Stop block ACK session and flush reordering buffer
+ *
+ * @v dev	802.11 device
+ *
+ * Any buffered frames are delivered in sequence order; it is better to
+ * pass a late frame up to the network stack than to drop it entirely.
+ */
+static void net80211_block_ack_stop ( struct net80211_device *dev )
+{
+	struct net80211_block_ack *ba = &dev->block_ack;
+	int i, slot;
+
+	if ( ! ba->in_use )
+		return;
+
+	for ( i = 0; i < NET80211_BLOCK_ACK_WINDOW; i++ ) {
+		slot = ( ba->start + i ) & ( NET80211_BLOCK_ACK_WINDOW - 1 );
+		if ( ba->iob[slot] ) {
+			netdev_rx ( dev->netdev, ba->iob[slot] );
+			ba->iob[slot] = NULL;
+		}
+	}
+
+	ba->in_use = 0;
+	ba->buffered = 0;
+	ba->hole_ticks = 0;
+}
+
+/**
+ * Handle receipt of 802.11 action frame
+ *
+ * @v dev	802.11 device
+ * @v iob	I/O buffer
+ *
+ * We handle only block ACK session management actions; all action
+ * frames are additionally left on the management frame queue for any
+ * interested user code. This function does not consume @a iob.
+ */
+static void net80211_handle_action ( struct net80211_device *dev,
+				     struct io_buffer *iob )
+{
+	struct ieee80211_frame *hdr = iob->data;
+	struct ieee80211_action *action = ( void * ) hdr->data;
+	struct net80211_block_ack *ba = &dev->block_ack;
+
+	if ( action->category != IEEE80211_ACTION_CATEG_BLOCK_ACK )
+		return;
+
+	switch ( action->action ) {
+	case IEEE80211_ACTION_ADDBA_REQ: {
+		struct ieee80211_addba_req *req = ( void * ) hdr->data;
+		struct ieee80211_addba_resp *resp;
+		struct io_buffer *riob;
+		u8 tid = ( ( req->params & IEEE80211_BA_PARAM_TID_MASK ) >>
+			   IEEE80211_BA_PARAM_TID_SHIFT );
+
+		/* We support one session at a time; a new request
+		   implicitly tears down any existing session. */
+		net80211_block_ack_stop ( dev );
+
+		ba->in_use = 1;
+		ba->tid = tid;
+		ba->start = IEEE80211_SEQNR ( req->start_seq );
+		ba->buffered = 0;
+		ba->hole_ticks = 0;
+
+		DBGC ( dev, "802.11 %p starting block ACK session for "
+		       "TID %d at seq %04x\n", dev, tid, ba->start );
+
+		riob = alloc_iob ( IEEE80211_TYP_FRAME_HEADER_LEN +
+				   sizeof ( *resp ) );
+		if ( ! riob )
+			break;
+
+		iob_reserve ( riob, IEEE80211_TYP_FRAME_HEADER_LEN );
+		resp = iob_put ( riob, sizeof ( *resp ) );
+		resp->category = IEEE80211_ACTION_CATEG_BLOCK_ACK;
+		resp->action = IEEE80211_ACTION_ADDBA_RESP;
+		resp->dialog_token = req->dialog_token;
+		resp->status = 0;
+		resp->params = ( IEEE80211_BA_PARAM_IMMED |
+				 ( tid << IEEE80211_BA_PARAM_TID_SHIFT ) |
+				 ( NET80211_BLOCK_ACK_WINDOW <<
+				   IEEE80211_BA_PARAM_BUFSZ_SHIFT ) );
+		resp->timeout = req->timeout;
+
+		net80211_tx_mgmt ( dev, IEEE80211_STYPE_ACTION, dev->bssid,
+				   riob );
+		break;
+	}
+
+	case IEEE80211_ACTION_DELBA:
+		DBGC ( dev, "802.11 %p stopping block ACK session\n", dev );
+		net80211_block_ack_stop ( dev );
+		break;
+	}
+}
+
+/**
+ * Handle receipt of data frame within a block ACK session
+ *
+ * @v dev	802.11 device
+ * @v iob	I/O buffer
+ *
+ * Frames received out of order within the reordering window are
+ * buffered, and delivered to the wrapping network device in sequence
+ * order once the gap before them is filled. If a hole persists at the
+ * head of the window for longer than @c NET80211_BLOCK_ACK_TIMEOUT,
+ * the missing frame is assumed lost and delivery continues past it.
+ */
+static void net80211_rx_block_ack ( struct net80211_device *dev,
+				    struct io_buffer *iob )
+{
+	struct ieee80211_frame *hdr = iob->data;
+	struct net80211_block_ack *ba = &dev->block_ack;
+	u16 seqnr = IEEE80211_SEQNR ( hdr->seq );
+	u16 offset = ( seqnr - ba->start ) & 0x0fff;
+	int slot;
+
+	/* Frames behind the window start are retransmissions of
+	   frames we have already delivered. */
+	if ( offset >= 2048 ) {
+		free_iob ( iob );
+		return;
+	}
+
+	/* Advance the window far enough to admit this frame,
+	   delivering or giving up on whatever falls off the back. */
+	while ( offset >= NET80211_BLOCK_ACK_WINDOW ) {
+		slot = ba->start & ( NET80211_BLOCK_ACK_WINDOW - 1 );
+		if ( ba->iob[slot] ) {
+			netdev_rx ( dev->netdev, ba->iob[slot] );
+			ba->iob[slot] = NULL;
+			ba->buffered--;
+		}
+		ba->start = ( ba->start + 1 ) & 0x0fff;
+		offset--;
+	}
+
+	slot = seqnr & ( NET80211_BLOCK_ACK_WINDOW - 1 );
+	if ( ba->iob[slot] ) {
+		/* Duplicate of a frame we already hold */
+		free_iob ( iob );
+	} else {
+		ba->iob[slot] = iob;
+		ba->buffered++;
+	}
+
+	/* Deliver any in-order run at the head of the window */
+	while ( ba->buffered ) {
+		slot = ba->start & ( NET80211_BLOCK_ACK_WINDOW - 1 );
+		if ( ! ba->iob[slot] )
+			break;
+		netdev_rx ( dev->netdev, ba->iob[slot] );
+		ba->iob[slot] = NULL;
+		ba->buffered--;
+		ba->start = ( ba->start + 1 ) & 0x0fff;
+		ba->hole_ticks = 0;
+	}
+
+	/* If a hole has blocked the head of the window for too long,
+	   assume the missing frame is lost and release what we have. */
+	if ( ba->buffered ) {
+		if ( ! ba->hole_ticks ) {
+			ba->hole_ticks = currticks();
+		} else if ( ( currticks() - ba->hole_ticks ) >
+			    NET80211_BLOCK_ACK_TIMEOUT ) {
+			while ( ba->buffered ) {
+				slot = ( ba->start &
+					 ( NET80211_BLOCK_ACK_WINDOW - 1 ) );
+				if ( ba->iob[slot] ) {
+					netdev_rx ( dev->netdev,
+						    ba->iob[slot] );
+					ba->iob[slot] = NULL;
+					ba->buffered--;
+				}
+				ba->start = ( ba->start + 1 ) & 0x0fff;
+			}
+			ba->hole_ticks = 0;
+		}
+	}
+}
+
 /**
  * Handle receipt of 802.11 frame
  *
@@ -2691,6 +2909,8 @@ void net80211_rx ( struct net80211_device *dev, struct io_buffer *iob,
 {
 	struct ieee80211_frame *hdr = iob->data;
 	u16 type = hdr->fc & IEEE80211_FC_TYPE;
+	int qos_tid = -1;
+
 	if ( ( hdr->fc & IEEE80211_FC_VERSION ) != IEEE80211_THIS_VERSION )
 		goto drop;	/* drop invalid-version packets */
 
@@ -2750,9 +2970,20 @@ void net80211_rx ( struct net80211_device *dev, struct io_buffer *iob,
 		return;
 	}
 
-	/* Data frames get dropped or sent to the net_device. */
-	if ( ( hdr->fc & IEEE80211_FC_SUBTYPE ) != IEEE80211_STYPE_DATA )
-		goto drop;	/* drop QoS, CFP, or null data packets */
+	/* Data frames get dropped or sent to the net_device. QoS data
+	   frames are accepted by stripping the QoS control field, since
+	   the rest of the stack expects the fixed-length header. */
+	if ( ( hdr->fc & IEEE80211_FC_SUBTYPE ) == IEEE80211_STYPE_QOS_DATA ) {
+		qos_tid = ( hdr->data[0] & 0x0F );
+		memmove ( iob->data + 2, iob->data,
+			  IEEE80211_TYP_FRAME_HEADER_LEN );
+		iob_pull ( iob, 2 );
+		hdr = iob->data;
+		hdr->fc &= ~IEEE80211_FC_SUBTYPE;
+	} else if ( ( hdr->fc & IEEE80211_FC_SUBTYPE ) !=
+		    IEEE80211_STYPE_DATA ) {
+		goto drop;	/* drop CFP or null data packets */
+	}
 
 	/* Update rate-control algorithm */
 	if ( dev->rctl )
@@ -2760,7 +2991,12 @@ void net80211_rx ( struct net80211_device *dev, struct io_buffer *iob,
 
 	/* Pass packet onward */
 	if ( dev->state & NET80211_ASSOCIATED ) {
-		netdev_rx ( dev->netdev, iob );
+		if ( dev->block_ack.in_use &&
+		     ( qos_tid == dev->block_ack.tid ) ) {
+			net80211_rx_block_ack ( dev, iob );
+		} else {
+			netdev_rx ( dev->netdev, iob );
+		}
 		return;
 	}
 
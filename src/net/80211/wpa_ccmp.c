@@ -170,6 +170,15 @@ static int ccmp_init ( struct net80211_crypto *crypto, const void *key,
 }
 
 
+/** Number of counter blocks generated per cipher call
+ *
+ * Feeding the cipher several counter blocks at once lets it use its
+ * multi-block code paths (interleaved round calculations, or the AES
+ * instruction set where available) instead of paying the full
+ * per-call overhead for every 16 bytes of keystream.
+ */
+#define CCMP_CTR_BATCH	8
+
 /**
  * Encrypt or decrypt data stream using AES in Counter mode
  *
@@ -188,38 +197,47 @@ static void ccmp_ctr_xor ( struct ccmp_ctx *ctx, const void *nonce,
 			   const void *srcv, void *destv, int len,
 			   const void *msrcv, void *mdestv )
 {
-	u8 A[16], S[16];
-	u16 ctr;
-	int i;
+	u8 A[CCMP_CTR_BATCH][16], S[CCMP_CTR_BATCH][16];
+	u16 ctr = 1;
+	int nblocks, blk, n, i;
 	const u8 *src = srcv, *msrc = msrcv;
 	u8 *dest = destv, *mdest = mdestv;
 
-	A[0] = 0x01;		/* flags, L' = L - 1 = 1, other bits rsvd */
-	memcpy ( A + 1, nonce, CCMP_NONCE_LEN );
-
 	if ( msrcv ) {
-		A[14] = A[15] = 0;
+		A[0][0] = 0x01;	/* flags, L' = L - 1 = 1, other bits rsvd */
+		memcpy ( &A[0][1], nonce, CCMP_NONCE_LEN );
+		A[0][14] = A[0][15] = 0;
 
-		cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, A, S, 16 );
+		cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, A[0], S[0], 16 );
 
 		for ( i = 0; i < 8; i++ ) {
-			*mdest++ = *msrc++ ^ S[i];
+			*mdest++ = *msrc++ ^ S[0][i];
 		}
 	}
 
-	for ( ctr = 1 ;; ctr++ ) {
-		A[14] = ctr >> 8;
-		A[15] = ctr & 0xFF;
-
-		cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, A, S, 16 );
-
-		for ( i = 0; i < len && i < 16; i++ )
-			*dest++ = *src++ ^ S[i];
+	while ( len > 0 ) {
+		/* Generate a batch of keystream blocks with a single
+		   cipher call */
+		nblocks = ( len + 15 ) / 16;
+		if ( nblocks > CCMP_CTR_BATCH )
+			nblocks = CCMP_CTR_BATCH;
+
+		for ( blk = 0; blk < nblocks; blk++, ctr++ ) {
+			A[blk][0] = 0x01;
+			memcpy ( &A[blk][1], nonce, CCMP_NONCE_LEN );
+			A[blk][14] = ctr >> 8;
+			A[blk][15] = ctr & 0xFF;
+		}
 
-		if ( len <= 16 )
-			break;	/* we're done */
+		cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, A, S,
+				 nblocks * 16 );
 
-		len -= 16;
+		for ( blk = 0; blk < nblocks; blk++ ) {
+			n = ( len < 16 ) ? len : 16;
+			for ( i = 0; i < n; i++ )
+				*dest++ = *src++ ^ S[blk][i];
+			len -= n;
+		}
 	}
 }
 
@@ -52,6 +52,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 FEATURE ( FEATURE_PROTOCOL, "AoE", DHCP_EB_FEATURE_AOE, 1 );
 
+/** Maximum number of outstanding AoE commands
+ *
+ * This is a policy decision.  The effective queue depth is the lesser
+ * of this limit and the target's advertised buffer count.
+ */
+#ifndef AOE_MAX_QUEUE_DEPTH
+#define AOE_MAX_QUEUE_DEPTH 8
+#endif
+
 struct net_protocol aoe_protocol __net_protocol;
 struct acpi_model abft_model __acpi_model;
 
@@ -88,6 +97,14 @@ struct aoe_device {
 	/** Saved timeout value */
 	unsigned long timeout;
 
+	/** Command queue depth
+	 *
+	 * Sized from the target's advertised buffer count.
+	 */
+	unsigned int depth;
+	/** Number of outstanding commands */
+	unsigned int outstanding;
+
 	/** Configuration command interface */
 	struct interface config;
 	/** Device is configued */
@@ -243,11 +260,16 @@ static void aoecmd_close ( struct aoe_command *aoecmd, int rc ) {
 	if ( ! list_empty ( &aoecmd->list ) ) {
 		list_del ( &aoecmd->list );
 		INIT_LIST_HEAD ( &aoecmd->list );
+		assert ( aoedev->outstanding > 0 );
+		aoedev->outstanding--;
 		aoecmd_put ( aoecmd );
 	}
 
 	/* Shut down interfaces */
 	intf_shutdown ( &aoecmd->ata, rc );
+
+	/* Notify of window change; a queue slot has become free */
+	xfer_window_changed ( &aoedev->ata );
 }
 
 /**
@@ -554,6 +576,17 @@ static int aoecmd_cfg_rsp ( struct aoe_command *aoecmd, const void *data,
 	       aoedev_name ( aoedev ), aoecmd->tag, ntohs ( aoecfg->bufcnt ),
 	       aoecfg->fwver, aoecfg->scnt );
 
+	/* Size command queue depth from the target's advertised
+	 * buffer count.
+	 */
+	aoedev->depth = ntohs ( aoecfg->bufcnt );
+	if ( aoedev->depth < 1 )
+		aoedev->depth = 1;
+	if ( aoedev->depth > AOE_MAX_QUEUE_DEPTH )
+		aoedev->depth = AOE_MAX_QUEUE_DEPTH;
+	DBGC ( aoedev, "AoE %s using queue depth %d\n",
+	       aoedev_name ( aoedev ), aoedev->depth );
+
 	/* Record target MAC address */
 	memcpy ( aoedev->target, ll_source, ll_protocol->ll_addr_len );
 	DBGC ( aoedev, "AoE %s has MAC address %s\n",
@@ -634,6 +667,7 @@ static struct aoe_command * aoecmd_create ( struct aoe_device *aoedev,
 		return NULL;
 	ref_init ( &aoecmd->refcnt, aoecmd_free );
 	list_add ( &aoecmd->list, &aoe_commands );
+	aoedev->outstanding++;
 	intf_init ( &aoecmd->ata, &aoecmd_ata_desc, &aoecmd->refcnt );
 	timer_init ( &aoecmd->timer, aoecmd_expired, &aoecmd->refcnt );
 	aoecmd->aoedev = aoedev_get ( aoedev );
@@ -668,6 +702,10 @@ static int aoedev_ata_command ( struct aoe_device *aoedev,
 		return -EWOULDBLOCK;
 	}
 
+	/* Refuse commands beyond the queue depth */
+	if ( aoedev->outstanding >= aoedev->depth )
+		return -EBUSY;
+
 	/* Create command */
 	aoecmd = aoecmd_create ( aoedev, &aoecmd_ata );
 	if ( ! aoecmd )
@@ -758,7 +796,15 @@ static void aoedev_close ( struct aoe_device *aoedev, int rc ) {
  * @ret len		Length of window
  */
 static size_t aoedev_window ( struct aoe_device *aoedev ) {
-	return ( aoedev->configured ? ~( ( size_t ) 0 ) : 0 );
+
+	/* Window is closed until configuration completes, and while
+	 * the queue depth is reached.
+	 */
+	if ( ! aoedev->configured )
+		return 0;
+	if ( aoedev->outstanding >= aoedev->depth )
+		return 0;
+	return ~( ( size_t ) 0 );
 }
 
 /**
@@ -852,6 +898,7 @@ static int aoedev_open ( struct interface *parent, struct net_device *netdev,
 	aoedev->netdev = netdev_get ( netdev );
 	aoedev->major = major;
 	aoedev->minor = minor;
+	aoedev->depth = 1;
 	memcpy ( aoedev->target, netdev->ll_broadcast,
 		 netdev->ll_protocol->ll_addr_len );
 	acpi_init ( &aoedev->desc, &abft_model, &aoedev->refcnt );
@@ -165,9 +165,21 @@ static int arp_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 		goto done;
 	}
 
-	/* Update neighbour cache entry for this sender, if any */
-	neighbour_update ( netdev, net_protocol, arp_sender_pa ( arphdr ),
-			   arp_sender_ha ( arphdr ) );
+	/* Update neighbour cache entry for this sender, if any.  A
+	 * gratuitous ARP (sender and target protocol addresses equal)
+	 * announces an address mapping, so additionally creates an
+	 * entry: the sender is likely to be a peer we will talk to.
+	 */
+	if ( memcmp ( arp_sender_pa ( arphdr ), arp_target_pa ( arphdr ),
+		      arphdr->ar_pln ) == 0 ) {
+		neighbour_snoop ( netdev, net_protocol,
+				  arp_sender_pa ( arphdr ),
+				  arp_sender_ha ( arphdr ) );
+	} else {
+		neighbour_update ( netdev, net_protocol,
+				   arp_sender_pa ( arphdr ),
+				   arp_sender_ha ( arphdr ) );
+	}
 
 	/* If it's not a request, there's nothing more to do */
 	if ( arphdr->ar_op != htons ( ARPOP_REQUEST ) ) {
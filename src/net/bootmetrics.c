@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Boot metrics collection
+ *
+ * A compact metrics record (boot timeline, interface error counters,
+ * TCP retransmission count, and heap high-water mark) is POSTed to a
+ * collector URL as each boot phase completes.  The collector URL is
+ * taken from the ${metrics} setting, and so will typically be
+ * configured via a DHCP option; no records are sent until the setting
+ * becomes available.
+ *
+ * Reports are fire-and-forget: each POST runs in the background with
+ * no job attached and no completion is awaited, so a failed or slow
+ * collector cannot perturb the boot being measured.  Records raced
+ * against network shutdown (e.g. the final pre-execution record) may
+ * consequently be lost; this is acceptable for fleet-wide sampling.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+#include <ipxe/http.h>
+#include <ipxe/uri.h>
+#include <ipxe/vsprintf.h>
+#include <ipxe/settings.h>
+#include <ipxe/dhcp.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/tcp.h>
+#include <ipxe/malloc.h>
+#include <ipxe/boottrace.h>
+#include <ipxe/bootmetrics.h>
+
+/** Metrics record content type */
+#define BOOTMETRICS_MIME_TYPE "text/plain"
+
+/** Boot metrics collector setting */
+const struct setting metrics_setting __setting ( SETTING_MISC, metrics ) = {
+	.name = "metrics",
+	.description = "Boot metrics collector",
+	.tag = DHCP_EB_METRICS,
+	.type = &setting_type_string,
+};
+
+/**
+ * Construct metrics record
+ *
+ * @v phase		Completed phase name
+ * @v timeline		Boot timeline, or NULL
+ * @v data		Data buffer to fill in
+ * @v len		Length of data buffer
+ * @ret len		Length of metrics record
+ *
+ * Returns the required buffer length when called with a zero-length
+ * data buffer.
+ */
+static size_t bootmetrics_record ( const char *phase, const char *timeline,
+				   char *data, size_t len ) {
+	struct net_device *netdev;
+	unsigned int rxerrs = 0;
+	unsigned int txerrs = 0;
+	size_t used = 0;
+
+	/* Sum error completions across all network devices */
+	for_each_netdev ( netdev ) {
+		rxerrs += netdev->rx_stats.bad;
+		txerrs += netdev->tx_stats.bad;
+	}
+
+	/* Construct record */
+	used += ssnprintf ( ( data + used ), ( len - used ),
+			    "phase=%s\n", phase );
+	if ( timeline ) {
+		used += ssnprintf ( ( data + used ), ( len - used ),
+				    "timeline=%s\n", timeline );
+	}
+	used += ssnprintf ( ( data + used ), ( len - used ),
+			    "rxerrs=%d\ntxerrs=%d\nretrans=%d\nheapmax=%zd\n",
+			    rxerrs, txerrs, tcp_stats.retransmits,
+			    maxusedmem );
+
+	return used;
+}
+
+/** A boot metrics report */
+struct bootmetrics_report {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+};
+
+/**
+ * Terminate report
+ *
+ * @v report		Boot metrics report
+ * @v rc		Reason for termination
+ */
+static void bootmetrics_report_close ( struct bootmetrics_report *report,
+				       int rc ) {
+
+	DBGC ( report, "METRICS %p closed: %s\n", report, strerror ( rc ) );
+	intf_shutdown ( &report->xfer, rc );
+}
+
+/**
+ * Handle received data (i.e. the HTTP response body)
+ *
+ * @v report		Boot metrics report
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int bootmetrics_report_deliver ( struct bootmetrics_report *report
+						__unused,
+					struct io_buffer *iobuf,
+					struct xfer_metadata *meta __unused ) {
+
+	/* Discard response body */
+	free_iob ( iobuf );
+	return 0;
+}
+
+/** Boot metrics report data transfer interface operations */
+static struct interface_operation bootmetrics_report_operations[] = {
+	INTF_OP ( xfer_deliver, struct bootmetrics_report *,
+		  bootmetrics_report_deliver ),
+	INTF_OP ( intf_close, struct bootmetrics_report *,
+		  bootmetrics_report_close ),
+};
+
+/** Boot metrics report data transfer interface descriptor */
+static struct interface_descriptor bootmetrics_report_desc =
+	INTF_DESC ( struct bootmetrics_report, xfer,
+		    bootmetrics_report_operations );
+
+/**
+ * POST metrics record to collector
+ *
+ * @v uri_string	Collector URI
+ * @v phase		Completed phase name
+ * @ret rc		Return status code
+ */
+static int bootmetrics_post ( const char *uri_string, const char *phase ) {
+	struct http_request_content content;
+	struct bootmetrics_report *report;
+	struct uri *uri;
+	char *timeline;
+	char *data;
+	size_t len;
+	int rc;
+
+	/* Parse collector URI */
+	uri = parse_uri ( uri_string );
+	if ( ! uri ) {
+		rc = -ENOMEM;
+		goto err_parse_uri;
+	}
+
+	/* Construct metrics record */
+	fetch_string_setting_copy ( NULL, &boottrace_setting, &timeline );
+	len = bootmetrics_record ( phase, timeline, NULL, 0 );
+	data = malloc ( len + 1 /* NUL */ );
+	if ( ! data ) {
+		rc = -ENOMEM;
+		goto err_alloc_data;
+	}
+	bootmetrics_record ( phase, timeline, data, ( len + 1 /* NUL */ ) );
+
+	/* Allocate and initialise structure */
+	report = zalloc ( sizeof ( *report ) );
+	if ( ! report ) {
+		rc = -ENOMEM;
+		goto err_alloc_report;
+	}
+	ref_init ( &report->refcnt, NULL );
+	intf_init ( &report->xfer, &bootmetrics_report_desc, &report->refcnt );
+
+	/* Open HTTP POST transaction (which copies the request body) */
+	content.type = BOOTMETRICS_MIME_TYPE;
+	content.data = data;
+	content.len = len;
+	if ( ( rc = http_open ( &report->xfer, &http_post, uri, NULL, NULL,
+				&content ) ) != 0 )
+		goto err_open;
+	DBGC ( report, "METRICS %p reporting \"%s\" to %s\n",
+	       report, phase, uri_string );
+
+	/* Mortalise self and return.  The report is deliberately not
+	 * attached to any job: it will free itself when the
+	 * transaction completes (or fails).
+	 */
+	ref_put ( &report->refcnt );
+	free ( data );
+	free ( timeline );
+	uri_put ( uri );
+	return 0;
+
+ err_open:
+	ref_put ( &report->refcnt );
+ err_alloc_report:
+	free ( data );
+ err_alloc_data:
+	free ( timeline );
+	uri_put ( uri );
+ err_parse_uri:
+	return rc;
+}
+
+/**
+ * Report completion of a boot phase
+ *
+ * @v phase		Completed phase name
+ *
+ * This overrides the weak no-op definition in boottrace.c.  Errors
+ * are deliberately swallowed: metrics collection must never be able
+ * to break the boot that it is observing.
+ */
+void bootmetrics_mark ( const char *phase ) {
+	char *uri_string;
+	int rc;
+
+	/* Do nothing unless a collector has been configured */
+	fetch_string_setting_copy ( NULL, &metrics_setting, &uri_string );
+	if ( ! uri_string )
+		return;
+
+	/* POST metrics record, ignoring errors */
+	if ( ( rc = bootmetrics_post ( uri_string, phase ) ) != 0 ) {
+		DBG ( "METRICS could not report \"%s\": %s\n",
+		      phase, strerror ( rc ) );
+	}
+
+	free ( uri_string );
+}
@@ -96,6 +96,45 @@ static unsigned int dhcp_option_len ( struct dhcp_option *option ) {
 	}
 }
 
+/**
+ * Build option offset index
+ *
+ * @v options		DHCP options block
+ *
+ * Records the offset of the first instance of each top-level option,
+ * so that subsequent lookups need not walk the entire options block.
+ * Blocks too long for offsets to be representable in the index are
+ * left unindexed (and will fall back to a linear search).
+ */
+static void dhcpopt_index ( struct dhcp_options *options ) {
+	struct dhcp_option *option;
+	unsigned int option_len;
+	int offset = 0;
+	ssize_t remaining = options->used_len;
+
+	/* Refuse to index blocks with unrepresentable offsets */
+	if ( options->used_len > 0xffff )
+		return;
+
+	/* Record offset of first instance of each option */
+	memset ( options->offsets, 0, sizeof ( options->offsets ) );
+	while ( remaining ) {
+		option = dhcp_option ( options, offset );
+		option_len = dhcp_option_len ( option );
+		remaining -= option_len;
+		if ( remaining < 0 )
+			break;
+		if ( ( option->tag != DHCP_PAD ) &&
+		     ( options->offsets[option->tag] == 0 ) ) {
+			options->offsets[option->tag] = ( offset + 1 );
+		}
+		if ( option->tag == DHCP_END )
+			break;
+		offset += option_len;
+	}
+	options->indexed = 1;
+}
+
 /**
  * Find DHCP option within DHCP options block, and its encapsulator (if any)
  *
@@ -121,6 +160,7 @@ static int find_dhcp_option_with_encap ( struct dhcp_options *options,
 					 int *encap_offset ) {
 	unsigned int original_tag __attribute__ (( unused )) = tag;
 	struct dhcp_option *option;
+	unsigned int search;
 	int offset = 0;
 	ssize_t remaining = options->used_len;
 	unsigned int option_len;
@@ -129,6 +169,30 @@ static int find_dhcp_option_with_encap ( struct dhcp_options *options,
 	if ( tag == DHCP_PAD )
 		return -ENOENT;
 
+	/* Consult option offset index, if available */
+	if ( ! options->indexed )
+		dhcpopt_index ( options );
+	if ( options->indexed ) {
+		search = ( DHCP_IS_ENCAP_OPT ( tag ) ?
+			   DHCP_ENCAPSULATOR ( tag ) : tag );
+		if ( ! options->offsets[search] )
+			return -ENOENT;
+		offset = ( options->offsets[search] - 1 );
+		option = dhcp_option ( options, offset );
+		if ( option->tag == tag ) {
+			DBGC ( options, "DHCPOPT %p found %s (length %d)\n",
+			       options, dhcp_tag_name ( original_tag ),
+			       dhcp_option_len ( option ) );
+			return offset;
+		}
+		/* Continue search within encapsulated option block */
+		if ( encap_offset )
+			*encap_offset = offset;
+		tag = DHCP_ENCAPSULATED ( tag );
+		remaining = dhcp_option_len ( option );
+		offset += DHCP_OPTION_HEADER_LEN;
+	}
+
 	/* Search for option */
 	while ( remaining ) {
 		/* Calculate length of this option.  Abort processing
@@ -208,6 +272,9 @@ static int resize_dhcp_option ( struct dhcp_options *options,
 	void *dest;
 	int rc;
 
+	/* Invalidate option offset index */
+	options->indexed = 0;
+
 	/* Check for sufficient space */
 	if ( new_len > DHCP_MAX_LEN ) {
 		DBGC ( options, "DHCPOPT %p overlength option\n", options );
@@ -423,6 +490,9 @@ void dhcpopt_update_used_len ( struct dhcp_options *options ) {
 	ssize_t remaining = options->alloc_len;
 	unsigned int option_len;
 
+	/* Invalidate option offset index */
+	options->indexed = 0;
+
 	/* Find last non-pad option */
 	options->used_len = 0;
 	while ( remaining ) {
@@ -274,6 +274,77 @@ struct net_device * alloc_etherdev ( size_t priv_size ) {
 	return netdev;
 }
 
+/** Ethernet bridge group address
+ *
+ * Spanning tree BPDUs are sent to this address.
+ */
+static const uint8_t eth_bridge_group[ETH_ALEN] =
+	{ 0x01, 0x80, 0xc2, 0x00, 0x00, 0x00 };
+
+/** Ethernet slow protocols address
+ *
+ * LACP packets are sent to this address.
+ */
+static const uint8_t eth_slow_group[ETH_ALEN] =
+	{ 0x01, 0x80, 0xc2, 0x00, 0x00, 0x02 };
+
+/**
+ * Join Ethernet control protocol multicast groups
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ *
+ * Spanning tree and slow protocols packets are snooped passively,
+ * and so must be requested explicitly from devices with a hardware
+ * multicast filter.
+ */
+static int eth_probe ( struct net_device *netdev ) {
+	int rc;
+
+	/* Do nothing unless this is an Ethernet device */
+	if ( netdev->ll_protocol != &ethernet_protocol )
+		return 0;
+
+	/* Join bridge group */
+	if ( ( rc = netdev_mcast_join ( netdev, eth_bridge_group ) ) != 0 )
+		goto err_bridge;
+
+	/* Join slow protocols group */
+	if ( ( rc = netdev_mcast_join ( netdev, eth_slow_group ) ) != 0 )
+		goto err_slow;
+
+	return 0;
+
+	netdev_mcast_leave ( netdev, eth_slow_group );
+ err_slow:
+	netdev_mcast_leave ( netdev, eth_bridge_group );
+ err_bridge:
+	return rc;
+}
+
+/**
+ * Leave Ethernet control protocol multicast groups
+ *
+ * @v netdev		Network device
+ */
+static void eth_remove ( struct net_device *netdev ) {
+
+	/* Do nothing unless this is an Ethernet device */
+	if ( netdev->ll_protocol != &ethernet_protocol )
+		return;
+
+	/* Leave control protocol groups */
+	netdev_mcast_leave ( netdev, eth_slow_group );
+	netdev_mcast_leave ( netdev, eth_bridge_group );
+}
+
+/** Ethernet network device driver */
+struct net_driver eth_driver __net_driver = {
+	.name = "Ethernet",
+	.probe = eth_probe,
+	.remove = eth_remove,
+};
+
 /* Drag in objects via ethernet_protocol */
 REQUIRING_SYMBOL ( ethernet_protocol );
 
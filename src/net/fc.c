@@ -289,8 +289,14 @@ struct fc_exchange {
 	struct refcnt refcnt;
 	/** Fibre Channel port */
 	struct fc_port *port;
-	/** List of active exchanges within this port */
+	/** Exchange hash bucket within this port
+	 *
+	 * The local exchange ID is kept adjacent so that a lookup
+	 * walking a bucket chain touches only this cache line.
+	 */
 	struct list_head list;
+	/** Local exchange ID */
+	uint16_t xchg_id;
 
 	/** Peer port ID */
 	struct fc_port_id peer_port_id;
@@ -298,8 +304,6 @@ struct fc_exchange {
 	unsigned int type;
 	/** Flags */
 	unsigned int flags;
-	/** Local exchange ID */
-	uint16_t xchg_id;
 	/** Peer exchange ID */
 	uint16_t peer_xchg_id;
 	/** Active sequence ID */
@@ -340,6 +344,22 @@ static unsigned int fc_new_xchg_id ( void ) {
 	return next_id;
 }
 
+/**
+ * Identify hash bucket for local exchange ID
+ *
+ * @v port		Fibre Channel port
+ * @v xchg_id		Local exchange ID
+ * @ret bucket		Exchange hash bucket
+ */
+static inline struct list_head * fc_xchg_bucket ( struct fc_port *port,
+						  unsigned int xchg_id ) {
+
+	/* Local exchange IDs are always even; discard the constant
+	 * low bit so that consecutive IDs use distinct buckets.
+	 */
+	return &port->xchgs[ ( xchg_id >> 1 ) % FC_XCHG_BUCKETS ];
+}
+
 /**
  * Create local Fibre Channel sequence identifier
  *
@@ -712,8 +732,8 @@ static struct fc_exchange * fc_xchg_create ( struct fc_port *port,
 	xchg->peer_xchg_id = FC_RX_ID_UNKNOWN;
 	xchg->seq_id = fc_new_seq_id();
 
-	/* Transfer reference to list of exchanges and return */
-	list_add ( &xchg->list, &port->xchgs );
+	/* Transfer reference to exchange hash table and return */
+	list_add ( &xchg->list, fc_xchg_bucket ( port, xchg->xchg_id ) );
 	return xchg;
 }
 
@@ -806,6 +826,7 @@ static struct fc_exchange * fc_xchg_respond ( struct fc_port *port,
 static void fc_port_close ( struct fc_port *port, int rc ) {
 	struct fc_exchange *xchg;
 	struct fc_exchange *tmp;
+	unsigned int i;
 
 	DBGC ( port, "FCPORT %s closed\n", port->name );
 
@@ -822,8 +843,10 @@ static void fc_port_close ( struct fc_port *port, int rc ) {
 	intf_shutdown ( &port->ns_plogi, rc );
 
 	/* Shut down any remaining exchanges */
-	list_for_each_entry_safe ( xchg, tmp, &port->xchgs, list )
-		fc_xchg_close ( xchg, rc );
+	for ( i = 0 ; i < FC_XCHG_BUCKETS ; i++ ) {
+		list_for_each_entry_safe ( xchg, tmp, &port->xchgs[i], list )
+			fc_xchg_close ( xchg, rc );
+	}
 
 	/* Remove from list of ports */
 	list_del ( &port->list );
@@ -841,7 +864,7 @@ static struct fc_exchange * fc_port_demux ( struct fc_port *port,
 					    unsigned int xchg_id ) {
 	struct fc_exchange *xchg;
 
-	list_for_each_entry ( xchg, &port->xchgs, list ) {
+	list_for_each_entry ( xchg, fc_xchg_bucket ( port, xchg_id ), list ) {
 		if ( xchg->xchg_id == xchg_id )
 			return xchg;
 	}
@@ -1189,6 +1212,7 @@ static struct interface_descriptor fc_port_ns_plogi_desc =
 int fc_port_open ( struct interface *transport, const struct fc_name *node_wwn,
 		   const struct fc_name *port_wwn, const char *name ) {
 	struct fc_port *port;
+	unsigned int i;
 
 	/* Allocate and initialise structure */
 	port = zalloc ( sizeof ( *port ) );
@@ -1200,7 +1224,8 @@ int fc_port_open ( struct interface *transport, const struct fc_name *node_wwn,
 	intf_init ( &port->flogi, &fc_port_flogi_desc, &port->refcnt );
 	intf_init ( &port->ns_plogi, &fc_port_ns_plogi_desc, &port->refcnt );
 	list_add_tail ( &port->list, &fc_ports );
-	INIT_LIST_HEAD ( &port->xchgs );
+	for ( i = 0 ; i < FC_XCHG_BUCKETS ; i++ )
+		INIT_LIST_HEAD ( &port->xchgs[i] );
 	memcpy ( &port->node_wwn, node_wwn, sizeof ( port->node_wwn ) );
 	memcpy ( &port->port_wwn, port_wwn, sizeof ( port->port_wwn ) );
 	snprintf ( port->name, sizeof ( port->name ), "%s", name );
@@ -186,7 +186,13 @@ struct fcp_command {
 	int ( * send ) ( struct fcp_command *fcpcmd );
 	/** SCSI command */
 	struct scsi_cmd command;
-	/** Data offset within command */
+	/** Data offset within command
+	 *
+	 * For writes, this is the offset of the next data IU to be
+	 * sent.  For reads, data IUs are placed directly at their own
+	 * offset and this records the high-water mark of received
+	 * data, used to detect locally-visible underruns.
+	 */
 	size_t offset;
 	/** Length of data remaining to be sent within this IU */
 	size_t remaining;
@@ -396,13 +402,6 @@ static int fcpcmd_recv_rddata ( struct fcp_command *fcpcmd,
 		rc = -ERANGE_READ_DATA_ORDERING;
 		goto done;
 	}
-	if ( offset != fcpcmd->offset ) {
-		DBGC ( fcpdev, "FCP %p xchg %04x read data out of order "
-		       "(expected %zd, received %zd)\n",
-		       fcpdev, fcpcmd->xchg_id, fcpcmd->offset, offset );
-		rc = -ERANGE_READ_DATA_ORDERING;
-		goto done;
-	}
 	if ( ( offset + len ) > command->data_in_len ) {
 		DBGC ( fcpdev, "FCP %p xchg %04x read data overrun (max %zd, "
 		       "received %zd)\n", fcpdev, fcpcmd->xchg_id,
@@ -413,9 +412,13 @@ static int fcpcmd_recv_rddata ( struct fcp_command *fcpcmd,
 	DBGC2 ( fcpdev, "FCP %p xchg %04x RDDATA [%08zx,%08zx)\n",
 		fcpdev, fcpcmd->xchg_id, offset, ( offset + len ) );
 
-	/* Copy to user buffer */
+	/* Place data directly at its own offset within the caller's
+	 * buffer.  Since placement is offset-addressed, data IUs may
+	 * be accepted in any order.
+	 */
 	copy_to_user ( command->data_in, offset, iobuf->data, len );
-	fcpcmd->offset += len;
+	if ( ( offset + len ) > fcpcmd->offset )
+		fcpcmd->offset = ( offset + len );
 	assert ( fcpcmd->offset <= command->data_in_len );
 
 	rc = 0;
@@ -26,6 +26,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <ipxe/retry.h>
 #include <ipxe/timer.h>
 #include <ipxe/ipstat.h>
@@ -37,6 +38,53 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/**
+ * Initialise fragment reassembler on first use
+ *
+ * @v fragments		Fragment reassembler
+ *
+ * Reassemblers are statically allocated; the list heads are
+ * initialised lazily upon receiving the first fragment.
+ */
+static void fragment_init ( struct fragment_reassembler *fragments ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < FRAGMENT_BUCKETS ; i++ )
+		INIT_LIST_HEAD ( &fragments->buckets[i] );
+	INIT_LIST_HEAD ( &fragments->lru );
+}
+
+/**
+ * Identify hash bucket for fragment
+ *
+ * @v fragments		Fragment reassembler
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret bucket		Hash bucket
+ */
+static struct list_head *
+fragment_bucket ( struct fragment_reassembler *fragments,
+		  struct io_buffer *iobuf, size_t hdrlen ) {
+	unsigned int hash = fragments->fragment_hash ( iobuf, hdrlen );
+
+	return &fragments->buckets[ hash % FRAGMENT_BUCKETS ];
+}
+
+/**
+ * Free fragment reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ */
+static void fragment_free ( struct fragment *fragment ) {
+
+	fragment->fragments->used -= fragment->used;
+	stop_timer ( &fragment->timer );
+	free_iob ( fragment->iobuf );
+	list_del ( &fragment->list );
+	list_del ( &fragment->lru );
+	free ( fragment );
+}
+
 /**
  * Expire fragment reassembly buffer
  *
@@ -48,10 +96,8 @@ static void fragment_expired ( struct retry_timer *timer, int fail __unused ) {
 		container_of ( timer, struct fragment, timer );
 
 	DBGC ( fragment, "FRAG %p expired\n", fragment );
-	free_iob ( fragment->iobuf );
-	list_del ( &fragment->list );
 	fragment->fragments->stats->reasm_fails++;
-	free ( fragment );
+	fragment_free ( fragment );
 }
 
 /**
@@ -67,13 +113,84 @@ static struct fragment * fragment_find ( struct fragment_reassembler *fragments,
 					 size_t hdrlen ) {
 	struct fragment *fragment;
 
-	list_for_each_entry ( fragment, &fragments->list, list ) {
+	list_for_each_entry ( fragment,
+			      fragment_bucket ( fragments, iobuf, hdrlen ),
+			      list ) {
 		if ( fragments->is_fragment ( fragment, iobuf, hdrlen ) )
 			return fragment;
 	}
 	return NULL;
 }
 
+/**
+ * Enforce per-source reassembly buffer limits
+ *
+ * @v fragments		Fragment reassembler
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ *
+ * Called before creating a new reassembly buffer.  If the fragment's
+ * source already holds too many buffers or too much memory, that
+ * source's least recently active buffer is discarded, so that a
+ * misbehaving sender starves only itself.
+ */
+static void fragment_limit_source ( struct fragment_reassembler *fragments,
+				    struct io_buffer *iobuf, size_t hdrlen ) {
+	struct fragment *fragment;
+	struct fragment *oldest;
+	unsigned int count;
+	size_t used;
+
+	while ( 1 ) {
+		oldest = NULL;
+		count = 0;
+		used = 0;
+		list_for_each_entry ( fragment, &fragments->lru, lru ) {
+			if ( ! fragments->is_same_source ( fragment, iobuf,
+							   hdrlen ) )
+				continue;
+			if ( ! oldest )
+				oldest = fragment;
+			count++;
+			used += fragment->used;
+		}
+		if ( ( count < FRAGMENT_MAX_PER_SOURCE ) &&
+		     ( used < FRAGMENT_MAX_SOURCE_MEM ) )
+			return;
+		DBGC ( oldest, "FRAG %p evicted (per-source limit)\n",
+		       oldest );
+		fragments->stats->reasm_fails++;
+		fragment_free ( oldest );
+	}
+}
+
+/**
+ * Enforce total reassembly memory budget
+ *
+ * @v fragments		Fragment reassembler
+ * @v keep		Fragment reassembly buffer to preserve, or NULL
+ * @v len		Additional length about to be accounted
+ * @ret rc		Return status code
+ */
+static int fragment_limit_total ( struct fragment_reassembler *fragments,
+				  struct fragment *keep, size_t len ) {
+	struct fragment *fragment;
+	struct fragment *tmp;
+
+	list_for_each_entry_safe ( fragment, tmp, &fragments->lru, lru ) {
+		if ( ( fragments->used + len ) <= FRAGMENT_MAX_MEM )
+			return 0;
+		if ( fragment == keep )
+			continue;
+		DBGC ( fragment, "FRAG %p evicted (memory budget)\n",
+		       fragment );
+		fragments->stats->reasm_fails++;
+		fragment_free ( fragment );
+	}
+	return ( ( ( fragments->used + len ) <= FRAGMENT_MAX_MEM ) ?
+		 0 : -ENOMEM );
+}
+
 /**
  * Reassemble packet
  *
@@ -95,6 +212,10 @@ struct io_buffer * fragment_reassemble ( struct fragment_reassembler *fragments,
 	size_t expected_offset;
 	int more_frags;
 
+	/* Initialise reassembler on first use */
+	if ( ! fragments->lru.next )
+		fragment_init ( fragments );
+
 	/* Update statistics */
 	fragments->stats->reasm_reqds++;
 
@@ -116,13 +237,23 @@ struct io_buffer * fragment_reassemble ( struct fragment_reassembler *fragments,
 	/* Create or extend fragment reassembly buffer as applicable */
 	if ( ! fragment ) {
 
+		/* Enforce per-source and total memory limits */
+		fragment_limit_source ( fragments, iobuf, *hdrlen );
+		if ( fragment_limit_total ( fragments, NULL,
+					    iob_len ( iobuf ) ) != 0 )
+			goto drop;
+
 		/* Create new fragment reassembly buffer */
 		fragment = zalloc ( sizeof ( *fragment ) );
 		if ( ! fragment )
 			goto drop;
-		list_add ( &fragment->list, &fragments->list );
+		list_add ( &fragment->list,
+			   fragment_bucket ( fragments, iobuf, *hdrlen ) );
+		list_add_tail ( &fragment->lru, &fragments->lru );
 		fragment->iobuf = iobuf;
 		fragment->hdrlen = *hdrlen;
+		fragment->used = iob_len ( iobuf );
+		fragments->used += fragment->used;
 		timer_init ( &fragment->timer, fragment_expired, NULL );
 		fragment->fragments = fragments;
 		DBGC ( fragment, "FRAG %p [0,%zd)\n", fragment,
@@ -136,11 +267,20 @@ struct io_buffer * fragment_reassemble ( struct fragment_reassembler *fragments,
 		       offset, ( offset + iob_len ( iobuf ) - *hdrlen ),
 		       ( more_frags ? "" : " complete" ) );
 
+		/* Enforce total memory limit, preserving this buffer */
+		iob_pull ( iobuf, *hdrlen );
+		if ( fragment_limit_total ( fragments, fragment,
+					    iob_len ( iobuf ) ) != 0 ) {
+			DBGC ( fragment, "FRAG %p evicted (memory budget)\n",
+			       fragment );
+			fragment_free ( fragment );
+			goto drop;
+		}
+
 		/* Extend fragment reassembly buffer.  Preserve I/O
 		 * buffer headroom to allow for code which modifies
 		 * and resends the buffer (e.g. ICMP echo responses).
 		 */
-		iob_pull ( iobuf, *hdrlen );
 		new_len = ( iob_headroom ( fragment->iobuf ) +
 			    iob_len ( fragment->iobuf ) + iob_len ( iobuf ) );
 		new_iobuf = alloc_iob ( new_len );
@@ -158,6 +298,13 @@ struct io_buffer * fragment_reassemble ( struct fragment_reassembler *fragments,
 		fragment->iobuf = new_iobuf;
 		free_iob ( iobuf );
 
+		/* Update memory accounting and activity ordering */
+		fragments->used += ( iob_len ( fragment->iobuf ) -
+				     fragment->used );
+		fragment->used = iob_len ( fragment->iobuf );
+		list_del ( &fragment->lru );
+		list_add_tail ( &fragment->lru, &fragments->lru );
+
 		/* Stop fragment reassembly timer */
 		stop_timer ( &fragment->timer );
 
@@ -165,7 +312,9 @@ struct io_buffer * fragment_reassemble ( struct fragment_reassembler *fragments,
 		if ( ! more_frags ) {
 			iobuf = fragment->iobuf;
 			*hdrlen = fragment->hdrlen;
+			fragments->used -= fragment->used;
 			list_del ( &fragment->list );
+			list_del ( &fragment->lru );
 			free ( fragment );
 			fragments->stats->reasm_oks++;
 			return iobuf;
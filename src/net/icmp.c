@@ -28,6 +28,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <errno.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/in.h>
+#include <ipxe/timer.h>
 #include <ipxe/tcpip.h>
 #include <ipxe/ping.h>
 #include <ipxe/crc32.h>
@@ -39,6 +40,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/** Maximum number of echo replies transmitted per second */
+#define ICMP_ECHO_RATE_LIMIT 32
+
 /**
  * Identify ICMP echo protocol
  *
@@ -140,15 +144,25 @@ static int icmp_tx_echo_reply ( struct io_buffer *iobuf,
 				struct sockaddr_tcpip *st_dest,
 				struct icmp_echo_protocol *echo_protocol ) {
 	struct icmp_echo *echo = iobuf->data;
+	uint16_t *word = ( ( uint16_t * ) &echo->icmp );
+	uint16_t old = *word;
 	int rc;
 
-	/* Set type */
+	/* Convert request to reply in place.  Only the type field
+	 * changes, so the checksum can be updated incrementally (RFC
+	 * 1624) rather than recomputed over the whole payload.  Where
+	 * the checksum includes a pseudo-header, its contribution is
+	 * unchanged by swapping the source and destination addresses.
+	 */
 	echo->icmp.type = echo_protocol->reply;
+	echo->icmp.chksum = tcpip_chksum_update ( echo->icmp.chksum, old,
+						  *word );
 
 	/* Transmit reply */
 	DBGC ( icmpcol ( st_dest ), "ICMP TX echo reply id %04x seq %04x\n",
 	       ntohs ( echo->ident ), ntohs ( echo->sequence ) );
-	if ( ( rc = icmp_tx_echo ( iobuf, st_dest, echo_protocol ) ) != 0 )
+	if ( ( rc = tcpip_tx ( iobuf, echo_protocol->tcpip_protocol, NULL,
+			       st_dest, NULL, NULL ) ) != 0 )
 		return rc;
 
 	return 0;
@@ -165,7 +179,10 @@ static int icmp_tx_echo_reply ( struct io_buffer *iobuf,
 int icmp_rx_echo_request ( struct io_buffer *iobuf,
 			   struct sockaddr_tcpip *st_src,
 			   struct icmp_echo_protocol *echo_protocol ) {
+	static unsigned long window;
+	static unsigned int count;
 	struct icmp_echo *echo = iobuf->data;
+	unsigned long now;
 	int rc;
 
 	/* Sanity check */
@@ -179,6 +196,21 @@ int icmp_rx_echo_request ( struct io_buffer *iobuf,
 	DBGC ( icmpcol ( st_src ), "ICMP RX echo request id %04x seq %04x\n",
 	       ntohs ( echo->ident ), ntohs ( echo->sequence ) );
 
+	/* Rate limit replies, so that continuous monitoring pings
+	 * cannot steal cycles from actual boot traffic.
+	 */
+	now = currticks();
+	if ( ( now - window ) >= TICKS_PER_SEC ) {
+		window = now;
+		count = 0;
+	}
+	if ( ++count > ICMP_ECHO_RATE_LIMIT ) {
+		DBGC2 ( icmpcol ( st_src ), "ICMP RX echo request discarded "
+			"(rate limit)\n" );
+		free_iob ( iobuf );
+		return 0;
+	}
+
 	/* Transmit echo reply */
 	if ( ( rc = icmp_tx_echo_reply ( iobuf, st_src, echo_protocol ) ) != 0 )
 		return rc;
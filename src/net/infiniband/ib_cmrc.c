@@ -49,21 +49,30 @@ FILE_LICENCE ( BSD2 );
 
 /** CMRC number of send WQEs
  *
- * This is a policy decision.
+ * This is a policy decision.  Must be large enough to cover the
+ * maximum queue depth of any upper-layer protocol (such as SRP) that
+ * issues multiple concurrent commands over the connection.
  */
-#define IB_CMRC_NUM_SEND_WQES 4
+#ifndef IB_CMRC_NUM_SEND_WQES
+#define IB_CMRC_NUM_SEND_WQES 16
+#endif
 
 /** CMRC number of receive WQEs
  *
- * This is a policy decision.
+ * This is a policy decision.  Must be large enough to cover a
+ * response to each concurrently outstanding upper-layer command.
  */
-#define IB_CMRC_NUM_RECV_WQES 2
+#ifndef IB_CMRC_NUM_RECV_WQES
+#define IB_CMRC_NUM_RECV_WQES 16
+#endif
 
 /** CMRC number of completion queue entries
  *
  * This is a policy decision
  */
-#define IB_CMRC_NUM_CQES 8
+#ifndef IB_CMRC_NUM_CQES
+#define IB_CMRC_NUM_CQES 32
+#endif
 
 /** An Infiniband Communication-Managed Reliable Connection */
 struct ib_cmrc_connection {
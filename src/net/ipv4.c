@@ -40,6 +40,7 @@
 #include <ipxe/settings.h>
 #include <ipxe/fragment.h>
 #include <ipxe/ipstat.h>
+#include <ipxe/neighbour.h>
 #include <ipxe/profile.h>
 
 /** @file
@@ -85,6 +86,7 @@ static int add_ipv4_miniroute ( struct net_device *netdev,
 				struct in_addr address, struct in_addr netmask,
 				struct in_addr gateway ) {
 	struct ipv4_miniroute *miniroute;
+	struct ipv4_miniroute *before;
 
 	DBGC ( netdev, "IPv4 add %s", inet_ntoa ( address ) );
 	DBGC ( netdev, "/%s ", inet_ntoa ( netmask ) );
@@ -104,14 +106,27 @@ static int add_ipv4_miniroute ( struct net_device *netdev,
 	miniroute->address = address;
 	miniroute->netmask = netmask;
 	miniroute->gateway = gateway;
-		
-	/* Add to end of list if we have a gateway, otherwise
-	 * to start of list.
+
+	/* Insert into list sorted by decreasing prefix length, so
+	 * that the first on-link match found by ipv4_route() is
+	 * always the longest-prefix match.  More recently added
+	 * entries sort before older entries of equal prefix length.
 	 */
-	if ( gateway.s_addr ) {
-		list_add_tail ( &miniroute->list, &ipv4_miniroutes );
-	} else {
-		list_add ( &miniroute->list, &ipv4_miniroutes );
+	list_for_each_entry ( before, &ipv4_miniroutes, list ) {
+		if ( ntohl ( before->netmask.s_addr ) <=
+		     ntohl ( netmask.s_addr ) )
+			break;
+	}
+	list_add_tail ( &miniroute->list, &before->list );
+
+	/* Prewarm the neighbour cache for the gateway, so that the
+	 * first packet routed through it does not stall behind an ARP
+	 * round trip.  Failures are ignored, since this is only an
+	 * optimisation.
+	 */
+	if ( gateway.s_addr && netdev_is_open ( netdev ) ) {
+		neighbour_probe ( netdev, &ipv4_protocol, &gateway,
+				  &arp_discovery, &address );
 	}
 
 	return 0;
@@ -150,8 +165,12 @@ static void del_ipv4_miniroute ( struct ipv4_miniroute *miniroute ) {
 static struct ipv4_miniroute * ipv4_route ( unsigned int scope_id,
 					    struct in_addr *dest ) {
 	struct ipv4_miniroute *miniroute;
+	struct ipv4_miniroute *gateway = NULL;
 
-	/* Find first usable route in routing table */
+	/* Find best usable route in routing table.  The table is
+	 * sorted by decreasing prefix length, so the first on-link
+	 * match is the longest-prefix match and terminates the scan.
+	 */
 	list_for_each_entry ( miniroute, &ipv4_miniroutes, list ) {
 
 		/* Skip closed network devices */
@@ -175,17 +194,21 @@ static struct ipv4_miniroute * ipv4_route ( unsigned int scope_id,
 			       & miniroute->netmask.s_addr ) == 0 )
 				return miniroute;
 
-			/* If destination is an off-link global
-			 * address, and we have a default gateway,
-			 * then use this route.
+			/* Record first gateway as a fallback for
+			 * off-link global addresses, but keep
+			 * scanning for a more specific on-link match.
 			 */
-			if ( miniroute->gateway.s_addr ) {
-				*dest = miniroute->gateway;
-				return miniroute;
-			}
+			if ( miniroute->gateway.s_addr && ( ! gateway ) )
+				gateway = miniroute;
 		}
 	}
 
+	/* Use gateway fallback route, if applicable */
+	if ( gateway ) {
+		*dest = gateway->gateway;
+		return gateway;
+	}
+
 	return NULL;
 }
 
@@ -226,6 +249,37 @@ static int ipv4_is_fragment ( struct fragment *fragment,
 		 ( iphdr->ident == frag_iphdr->ident ) );
 }
 
+/**
+ * Check if IPv4 fragment comes from the same source
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret is_same		Fragment comes from the same source
+ */
+static int ipv4_is_same_source ( struct fragment *fragment,
+				 struct io_buffer *iobuf,
+				 size_t hdrlen __unused ) {
+	struct iphdr *frag_iphdr = fragment->iobuf->data;
+	struct iphdr *iphdr = iobuf->data;
+
+	return ( iphdr->src.s_addr == frag_iphdr->src.s_addr );
+}
+
+/**
+ * Calculate IPv4 fragment hash
+ *
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret hash		Hash value
+ */
+static unsigned int ipv4_fragment_hash ( struct io_buffer *iobuf,
+					 size_t hdrlen __unused ) {
+	struct iphdr *iphdr = iobuf->data;
+
+	return ( iphdr->src.s_addr ^ iphdr->ident );
+}
+
 /**
  * Get IPv4 fragment offset
  *
@@ -256,8 +310,9 @@ static int ipv4_more_fragments ( struct io_buffer *iobuf,
 
 /** IPv4 fragment reassembler */
 static struct fragment_reassembler ipv4_reassembler = {
-	.list = LIST_HEAD_INIT ( ipv4_reassembler.list ),
 	.is_fragment = ipv4_is_fragment,
+	.is_same_source = ipv4_is_same_source,
+	.fragment_hash = ipv4_fragment_hash,
 	.fragment_offset = ipv4_fragment_offset,
 	.more_fragments = ipv4_more_fragments,
 	.stats = &ipv4_stats,
@@ -286,6 +341,48 @@ static uint16_t ipv4_pshdr_chksum ( struct io_buffer *iobuf, uint16_t csum ) {
 	return tcpip_continue_chksum ( csum, &pshdr, sizeof ( pshdr ) );
 }
 
+/** Most recently transmitted IPv4 header (including its checksum)
+ *
+ * Consecutive packets of a single flow differ only in their length
+ * and identification fields, so the header checksum can usually be
+ * derived from the previous one by two incremental updates (RFC 1624)
+ * rather than a scan over the whole header.
+ */
+static struct iphdr ipv4_last_hdr;
+
+/**
+ * Calculate IPv4 header checksum
+ *
+ * @v iphdr		IPv4 header (with zero checksum field)
+ * @ret chksum		Checksum, in network byte order
+ */
+static uint16_t ipv4_hdr_chksum ( struct iphdr *iphdr ) {
+	struct iphdr *last = &ipv4_last_hdr;
+	uint16_t chksum;
+
+	/* Update cached checksum incrementally, if applicable */
+	if ( ( iphdr->src.s_addr == last->src.s_addr ) &&
+	     ( iphdr->dest.s_addr == last->dest.s_addr ) &&
+	     ( iphdr->protocol == last->protocol ) &&
+	     ( iphdr->ttl == last->ttl ) &&
+	     ( iphdr->frags == last->frags ) &&
+	     ( iphdr->verhdrlen == last->verhdrlen ) &&
+	     ( iphdr->service == last->service ) ) {
+		chksum = tcpip_chksum_update ( last->chksum, last->len,
+					       iphdr->len );
+		chksum = tcpip_chksum_update ( chksum, last->ident,
+					       iphdr->ident );
+	} else {
+		chksum = tcpip_chksum ( iphdr, sizeof ( *iphdr ) );
+	}
+
+	/* Cache header along with its checksum */
+	memcpy ( last, iphdr, sizeof ( *last ) );
+	last->chksum = chksum;
+
+	return chksum;
+}
+
 /**
  * Transmit IP packet
  *
@@ -363,7 +460,7 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 		if ( ! *trans_csum )
 			*trans_csum = tcpip_protocol->zero_csum;
 	}
-	iphdr->chksum = tcpip_chksum ( iphdr, sizeof ( *iphdr ) );
+	iphdr->chksum = ipv4_hdr_chksum ( iphdr );
 
 	/* Print IP4 header for debugging */
 	DBGC2 ( sin_dest->sin_addr, "IPv4 TX %s->", inet_ntoa ( iphdr->src ) );
@@ -460,6 +557,36 @@ static int ipv4_has_addr ( struct net_device *netdev, struct in_addr addr ) {
 	return 0;
 }
 
+/**
+ * Snoop link-layer address of an on-link sender
+ *
+ * @v netdev		Network device
+ * @v src		Source IPv4 address
+ * @v ll_source		Source link-layer address
+ */
+static void ipv4_snoop ( struct net_device *netdev, struct in_addr src,
+			 const void *ll_source ) {
+	struct ipv4_miniroute *miniroute;
+
+	/* Ignore unroutable source addresses */
+	if ( ! src.s_addr )
+		return;
+
+	/* Learn address only if the sender lies within a directly
+	 * connected subnet of the receiving device.
+	 */
+	list_for_each_entry ( miniroute, &ipv4_miniroutes, list ) {
+		if ( ( miniroute->netdev == netdev ) &&
+		     miniroute->netmask.s_addr &&
+		     ( ( ( src.s_addr ^ miniroute->address.s_addr ) &
+			 miniroute->netmask.s_addr ) == 0 ) ) {
+			neighbour_snoop ( netdev, &ipv4_protocol, &src,
+					  ll_source );
+			return;
+		}
+	}
+}
+
 /**
  * Process incoming packets
  *
@@ -476,7 +603,7 @@ static int ipv4_has_addr ( struct net_device *netdev, struct in_addr addr ) {
 static int ipv4_rx ( struct io_buffer *iobuf,
 		     struct net_device *netdev,
 		     const void *ll_dest __unused,
-		     const void *ll_source __unused,
+		     const void *ll_source,
 		     unsigned int flags ) {
 	struct iphdr *iphdr = iobuf->data;
 	size_t hdrlen;
@@ -561,6 +688,13 @@ static int ipv4_rx ( struct io_buffer *iobuf,
 		goto err_other;
 	}
 
+	/* Opportunistically learn the sender's link-layer address, if
+	 * the sender is on a directly connected subnet, so that a
+	 * later transmission to it does not stall behind an ARP round
+	 * trip.
+	 */
+	ipv4_snoop ( netdev, iphdr->src, ll_source );
+
 	/* Perform fragment reassembly if applicable */
 	if ( iphdr->frags & htons ( IP_MASK_OFFSET | IP_MASK_MOREFRAGS ) ) {
 		/* Pass the fragment to fragment_reassemble() which returns
@@ -33,6 +33,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/crc32.h>
 #include <ipxe/fragment.h>
 #include <ipxe/ipstat.h>
+#include <ipxe/neighbour.h>
 #include <ipxe/ndp.h>
 #include <ipxe/ipv6.h>
 
@@ -205,6 +206,35 @@ static struct ipv6_miniroute * ipv6_miniroute ( struct net_device *netdev,
 	return NULL;
 }
 
+/**
+ * Join or leave link-layer group for an IPv6 multicast address
+ *
+ * @v netdev		Network device
+ * @v addr		IPv6 multicast address
+ * @v join		Join (rather than leave) the group
+ * @ret rc		Return status code
+ */
+static int ipv6_mcast ( struct net_device *netdev, struct in6_addr *addr,
+			int join ) {
+	struct ll_protocol *ll_protocol = netdev->ll_protocol;
+	uint8_t ll_addr[MAX_LL_ADDR_LEN];
+	int rc;
+
+	/* Do nothing if the link layer has no multicast mapping */
+	if ( ! ll_protocol->mc_hash )
+		return 0;
+
+	/* Construct link-layer multicast address */
+	if ( ( rc = ll_protocol->mc_hash ( AF_INET6, addr, ll_addr ) ) != 0 )
+		return rc;
+
+	/* Join or leave group */
+	if ( join )
+		return netdev_mcast_join ( netdev, ll_addr );
+	netdev_mcast_leave ( netdev, ll_addr );
+	return 0;
+}
+
 /**
  * Add IPv6 routing table entry
  *
@@ -217,6 +247,8 @@ static struct ipv6_miniroute * ipv6_miniroute ( struct net_device *netdev,
 int ipv6_add_miniroute ( struct net_device *netdev, struct in6_addr *address,
 			 unsigned int prefix_len, struct in6_addr *router ) {
 	struct ipv6_miniroute *miniroute;
+	struct ipv6_miniroute *before;
+	struct in6_addr solicited;
 	uint8_t *prefix_mask;
 	unsigned int remaining;
 	unsigned int i;
@@ -254,8 +286,17 @@ int ipv6_add_miniroute ( struct net_device *netdev, struct in6_addr *address,
 			*prefix_mask <<= ( 8 - remaining );
 	}
 
-	/* Add to start of routing table */
-	list_add ( &miniroute->list, &ipv6_miniroutes );
+	/* Insert into routing table sorted by decreasing prefix
+	 * length, so that the first on-link match found by
+	 * ipv6_route() is always the longest-prefix match.  More
+	 * recently added entries sort before older entries of equal
+	 * prefix length.
+	 */
+	list_for_each_entry ( before, &ipv6_miniroutes, list ) {
+		if ( before->prefix_len <= miniroute->prefix_len )
+			break;
+	}
+	list_add_tail ( &miniroute->list, &before->list );
 
 	/* Set or update address, if applicable */
 	for ( i = 0 ; i < ( sizeof ( address->s6_addr32 ) /
@@ -273,6 +314,19 @@ int ipv6_add_miniroute ( struct net_device *netdev, struct in6_addr *address,
 	/* Update scope */
 	miniroute->scope = ipv6_scope ( &miniroute->address );
 
+	/* Join solicited-node multicast group, used for neighbour
+	 * solicitations directed at our address.  Join failure is
+	 * nonfatal, since devices without a hardware multicast filter
+	 * receive the solicitations regardless.
+	 */
+	if ( ( miniroute->flags & IPV6_HAS_ADDRESS ) &&
+	     ( ! ( miniroute->flags & IPV6_HAS_GROUP ) ) ) {
+		memset ( &solicited, 0, sizeof ( solicited ) );
+		ipv6_solicited_node ( &solicited, &miniroute->address );
+		if ( ipv6_mcast ( netdev, &solicited, 1 ) == 0 )
+			miniroute->flags |= IPV6_HAS_GROUP;
+	}
+
 	/* Set or update router, if applicable */
 	if ( router ) {
 		memcpy ( &miniroute->router, router,
@@ -290,6 +344,14 @@ int ipv6_add_miniroute ( struct net_device *netdev, struct in6_addr *address,
  * @v miniroute		Routing table entry
  */
 void ipv6_del_miniroute ( struct ipv6_miniroute *miniroute ) {
+	struct in6_addr solicited;
+
+	/* Leave solicited-node multicast group, if joined */
+	if ( miniroute->flags & IPV6_HAS_GROUP ) {
+		memset ( &solicited, 0, sizeof ( solicited ) );
+		ipv6_solicited_node ( &solicited, &miniroute->address );
+		ipv6_mcast ( miniroute->netdev, &solicited, 0 );
+	}
 
 	netdev_put ( miniroute->netdev );
 	list_del ( &miniroute->list );
@@ -340,7 +402,10 @@ struct ipv6_miniroute * ipv6_route ( unsigned int scope_id,
 		/* Calculate match length */
 		match_len = ipv6_match_len ( miniroute, *dest );
 
-		/* If destination is on-link, then use this route */
+		/* If destination is on-link, then use this route.
+		 * The table is sorted by decreasing prefix length,
+		 * so this is the longest-prefix match.
+		 */
 		if ( match_len >= miniroute->prefix_len )
 			return miniroute;
 
@@ -447,6 +512,42 @@ static int ipv6_is_fragment ( struct fragment *fragment,
 		 ( fhdr->ident == frag_fhdr->ident ) );
 }
 
+/**
+ * Check if fragment comes from the same source
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret is_same		Fragment comes from the same source
+ */
+static int ipv6_is_same_source ( struct fragment *fragment,
+				 struct io_buffer *iobuf,
+				 size_t hdrlen __unused ) {
+	struct ipv6_header *frag_iphdr = fragment->iobuf->data;
+	struct ipv6_header *iphdr = iobuf->data;
+
+	return ( memcmp ( &iphdr->src, &frag_iphdr->src,
+			  sizeof ( iphdr->src ) ) == 0 );
+}
+
+/**
+ * Calculate fragment hash
+ *
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret hash		Hash value
+ */
+static unsigned int ipv6_fragment_hash ( struct io_buffer *iobuf,
+					 size_t hdrlen ) {
+	struct ipv6_header *iphdr = iobuf->data;
+	struct ipv6_fragment_header *fhdr =
+		( iobuf->data + hdrlen - sizeof ( *fhdr ) );
+
+	return ( iphdr->src.s6_addr32[0] ^ iphdr->src.s6_addr32[1] ^
+		 iphdr->src.s6_addr32[2] ^ iphdr->src.s6_addr32[3] ^
+		 fhdr->ident );
+}
+
 /**
  * Get fragment offset
  *
@@ -477,8 +578,9 @@ static int ipv6_more_fragments ( struct io_buffer *iobuf, size_t hdrlen ) {
 
 /** Fragment reassembler */
 static struct fragment_reassembler ipv6_reassembler = {
-	.list = LIST_HEAD_INIT ( ipv6_reassembler.list ),
 	.is_fragment = ipv6_is_fragment,
+	.is_same_source = ipv6_is_same_source,
+	.fragment_hash = ipv6_fragment_hash,
 	.fragment_offset = ipv6_fragment_offset,
 	.more_fragments = ipv6_more_fragments,
 	.stats = &ipv6_stats,
@@ -633,6 +735,35 @@ static int ipv6_tx ( struct io_buffer *iobuf,
 	return rc;
 }
 
+/**
+ * Snoop link-layer address of an on-link sender
+ *
+ * @v netdev		Network device
+ * @v src		Source IPv6 address
+ * @v ll_source		Source link-layer address
+ */
+static void ipv6_snoop ( struct net_device *netdev, struct in6_addr *src,
+			 const void *ll_source ) {
+	struct ipv6_miniroute *miniroute;
+
+	/* Ignore unspecified and multicast source addresses */
+	if ( IN6_IS_ADDR_UNSPECIFIED ( src ) || IN6_IS_ADDR_MULTICAST ( src ) )
+		return;
+
+	/* Learn address only if the sender lies within an on-link
+	 * prefix of the receiving device.
+	 */
+	list_for_each_entry ( miniroute, &ipv6_miniroutes, list ) {
+		if ( ( miniroute->netdev == netdev ) &&
+		     ( ipv6_match_len ( miniroute, src ) >=
+		       miniroute->prefix_len ) ) {
+			neighbour_snoop ( netdev, &ipv6_protocol, src,
+					  ll_source );
+			return;
+		}
+	}
+}
+
 /**
  * Process incoming IPv6 packets
  *
@@ -648,7 +779,7 @@ static int ipv6_tx ( struct io_buffer *iobuf,
  */
 static int ipv6_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 		     const void *ll_dest __unused,
-		     const void *ll_source __unused,
+		     const void *ll_source,
 		     unsigned int flags __unused ) {
 	struct ipv6_header *iphdr = iobuf->data;
 	union ipv6_extension_header *ext;
@@ -717,6 +848,12 @@ static int ipv6_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 		goto err_other;
 	}
 
+	/* Opportunistically learn the sender's link-layer address, if
+	 * the sender is on-link, so that a later transmission to it
+	 * does not stall behind a neighbour solicitation round trip.
+	 */
+	ipv6_snoop ( netdev, &iphdr->src, ll_source );
+
 	/* Process any extension headers */
 	next_header = iphdr->next_header;
 	while ( 1 ) {
@@ -1253,10 +1390,51 @@ static int ipv6_register_settings ( struct net_device *netdev ) {
 	return rc;
 }
 
+/**
+ * Probe IPv6 network device
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+static int ipv6_probe ( struct net_device *netdev ) {
+	struct in6_addr all;
+	int rc;
+
+	/* Register link-local address settings */
+	if ( ( rc = ipv6_register_settings ( netdev ) ) != 0 )
+		return rc;
+
+	/* Join all-nodes multicast group, to which router
+	 * advertisements are sent.  Join failure is nonfatal, since
+	 * devices without a hardware multicast filter receive the
+	 * advertisements regardless.
+	 */
+	memset ( &all, 0, sizeof ( all ) );
+	ipv6_all_nodes ( &all );
+	ipv6_mcast ( netdev, &all, 1 );
+
+	return 0;
+}
+
+/**
+ * Remove IPv6 network device
+ *
+ * @v netdev		Network device
+ */
+static void ipv6_remove ( struct net_device *netdev ) {
+	struct in6_addr all;
+
+	/* Leave all-nodes multicast group */
+	memset ( &all, 0, sizeof ( all ) );
+	ipv6_all_nodes ( &all );
+	ipv6_mcast ( netdev, &all, 0 );
+}
+
 /** IPv6 network device driver */
 struct net_driver ipv6_driver __net_driver = {
 	.name = "IPv6",
-	.probe = ipv6_register_settings,
+	.probe = ipv6_probe,
+	.remove = ipv6_remove,
 };
 
 /**
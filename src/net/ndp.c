@@ -1061,6 +1061,19 @@ struct ipv6conf {
 
 	/** Retransmission timer */
 	struct retry_timer timer;
+
+	/** A router advertisement has been processed */
+	int radv;
+	/** Router solicitation has timed out */
+	int rs_failed;
+	/** A DHCPv6 session is in progress */
+	int dhcp_running;
+	/** DHCPv6 session in progress is stateful */
+	int dhcp_stateful;
+	/** DHCPv6 has completed successfully */
+	int dhcp_done;
+	/** DHCPv6 is mandated by a router advertisement */
+	int dhcp_required;
 };
 
 /** List of IPv6 configurators */
@@ -1125,9 +1138,18 @@ static void ipv6conf_expired ( struct retry_timer *timer, int fail ) {
 	struct ipv6conf *ipv6conf =
 		container_of ( timer, struct ipv6conf, timer );
 
-	/* If we have failed, terminate autoconfiguration */
+	/* If router solicitation has failed, then complete
+	 * successfully if DHCPv6 has already provided an address,
+	 * defer to a still-running DHCPv6 session if one exists, and
+	 * otherwise terminate autoconfiguration.
+	 */
 	if ( fail ) {
-		ipv6conf_done ( ipv6conf, -ETIMEDOUT );
+		ipv6conf->rs_failed = 1;
+		if ( ipv6conf->dhcp_done ) {
+			ipv6conf_done ( ipv6conf, 0 );
+		} else if ( ! ipv6conf->dhcp_running ) {
+			ipv6conf_done ( ipv6conf, -ETIMEDOUT );
+		}
 		return;
 	}
 
@@ -1136,6 +1158,45 @@ static void ipv6conf_expired ( struct retry_timer *timer, int fail ) {
 	ndp_tx_router_solicitation ( ipv6conf->netdev );
 }
 
+/**
+ * Handle completion of DHCPv6 session
+ *
+ * @v ipv6conf		IPv6 configurator
+ * @v rc		DHCPv6 completion status code
+ */
+static void ipv6conf_dhcp_close ( struct ipv6conf *ipv6conf, int rc ) {
+
+	/* Mark DHCPv6 session as no longer running, and restart the
+	 * interface so that a further session may be started if a
+	 * subsequent router advertisement mandates one.
+	 */
+	ipv6conf->dhcp_running = 0;
+	intf_restart ( &ipv6conf->dhcp, rc );
+
+	/* If DHCPv6 has succeeded, then complete autoconfiguration
+	 * once router discovery is no longer pending: default routes
+	 * can be learned only from router advertisements.
+	 */
+	if ( rc == 0 ) {
+		if ( ipv6conf->radv || ipv6conf->rs_failed ) {
+			ipv6conf_done ( ipv6conf, 0 );
+		} else {
+			ipv6conf->dhcp_done = 1;
+		}
+		return;
+	}
+
+	/* If DHCPv6 has failed and was mandated by a router
+	 * advertisement (or was our last hope after router
+	 * solicitation timed out), then terminate autoconfiguration.
+	 * Otherwise, this was a speculative session started in
+	 * parallel with router solicitation; continue to wait for a
+	 * router advertisement.
+	 */
+	if ( ipv6conf->dhcp_required || ipv6conf->rs_failed )
+		ipv6conf_done ( ipv6conf, rc );
+}
+
 /**
  * Handle router advertisement during IPv6 autoconfiguration
  *
@@ -1178,10 +1239,31 @@ ipv6conf_rx_router_advertisement ( struct net_device *netdev,
 					    ntohl ( radv->lifetime ),
 					    radv->option, option_len ) ) != 0 )
 		return rc;
+	ipv6conf->radv = 1;
 
 	/* Start DHCPv6 if required */
 	if ( radv->flags & ( NDP_ROUTER_MANAGED | NDP_ROUTER_OTHER ) ) {
 		stateful = ( radv->flags & NDP_ROUTER_MANAGED );
+		ipv6conf->dhcp_required = 1;
+
+		/* If a speculative DHCPv6 session has already
+		 * completed, then autoconfiguration is finished.
+		 */
+		if ( ipv6conf->dhcp_done ) {
+			ipv6conf_done ( ipv6conf, 0 );
+			return 0;
+		}
+
+		/* If a DHCPv6 session of the mandated statefulness is
+		 * already in progress, then let it run to completion.
+		 */
+		if ( ipv6conf->dhcp_running &&
+		     ( ipv6conf->dhcp_stateful == ( !! stateful ) ) )
+			return 0;
+
+		/* Otherwise, (re)start DHCPv6 in the mandated mode */
+		if ( ipv6conf->dhcp_running )
+			intf_restart ( &ipv6conf->dhcp, -ECANCELED );
 		if ( ( rc = start_dhcpv6 ( &ipv6conf->dhcp, netdev,
 					   stateful ) ) != 0 ) {
 			DBGC ( netdev, "NDP %s could not start state%s DHCPv6: "
@@ -1190,6 +1272,8 @@ ipv6conf_rx_router_advertisement ( struct net_device *netdev,
 			ipv6conf_done ( ipv6conf, rc );
 			return rc;
 		}
+		ipv6conf->dhcp_running = 1;
+		ipv6conf->dhcp_stateful = ( !! stateful );
 		return 0;
 	}
 
@@ -1210,7 +1294,7 @@ static struct interface_descriptor ipv6conf_job_desc =
 
 /** IPv6 configurator DHCPv6 interface operations */
 static struct interface_operation ipv6conf_dhcp_op[] = {
-	INTF_OP ( intf_close, struct ipv6conf *, ipv6conf_done ),
+	INTF_OP ( intf_close, struct ipv6conf *, ipv6conf_dhcp_close ),
 };
 
 /** IPv6 configurator DHCPv6 interface descriptor */
@@ -1240,6 +1324,18 @@ int start_ipv6conf ( struct interface *job, struct net_device *netdev ) {
 	/* Start timer to initiate router solicitation */
 	start_timer_nodelay ( &ipv6conf->timer );
 
+	/* Speculatively start stateful DHCPv6 in parallel with router
+	 * solicitation, rather than serialising the two discovery
+	 * protocols.  If a router advertisement arrives mandating a
+	 * different mode (or no DHCPv6 at all), the session will be
+	 * restarted or cancelled accordingly; failure to start is
+	 * non-fatal since router discovery may yet succeed alone.
+	 */
+	if ( start_dhcpv6 ( &ipv6conf->dhcp, netdev, 1 ) == 0 ) {
+		ipv6conf->dhcp_running = 1;
+		ipv6conf->dhcp_stateful = 1;
+	}
+
 	/* Attach parent interface, transfer reference to list, and return */
 	intf_plug_plug ( &ipv6conf->job, job );
 	list_add ( &ipv6conf->list, &ipv6confs );
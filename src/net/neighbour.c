@@ -28,6 +28,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <string.h>
 #include <errno.h>
 #include <ipxe/iobuf.h>
+#include <ipxe/init.h>
 #include <ipxe/retry.h>
 #include <ipxe/timer.h>
 #include <ipxe/malloc.h>
@@ -48,11 +49,54 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Neighbour discovery maximum timeout */
 #define NEIGHBOUR_MAX_TIMEOUT ( TICKS_PER_SEC * 3 )
 
-/** The neighbour cache */
+/** Neighbour cache entry refresh interval
+ *
+ * Completed entries are revalidated in the background at this
+ * interval.  The cached link-layer address remains in use while
+ * revalidation is in progress, so a long-lived transfer never stalls
+ * behind a mid-transfer re-resolution; a peer whose address has
+ * changed (e.g. a failed-over gateway) is picked up via the reply.
+ */
+#ifndef NEIGHBOUR_REFRESH
+#define NEIGHBOUR_REFRESH ( 60 * TICKS_PER_SEC )
+#endif
+
+/** Number of neighbour cache hash buckets */
+#define NEIGHBOUR_BUCKETS 16
+
+/** The neighbour cache
+ *
+ * This list is maintained in most-recently-used order, for use by the
+ * cache discarder and by external code walking the cache; lookups on
+ * the transmit path use the hash buckets instead.
+ */
 struct list_head neighbours = LIST_HEAD_INIT ( neighbours );
 
+/** Neighbour cache hash buckets */
+static struct list_head neighbour_buckets[NEIGHBOUR_BUCKETS];
+
 static void neighbour_expired ( struct retry_timer *timer, int over );
 
+/**
+ * Identify hash bucket for neighbour cache entry
+ *
+ * @v netdev		Network device
+ * @v net_protocol	Network-layer protocol
+ * @v net_dest		Destination network-layer address
+ * @ret bucket		Hash bucket
+ */
+static struct list_head * neighbour_bucket ( struct net_device *netdev,
+					     struct net_protocol *net_protocol,
+					     const void *net_dest ) {
+	const uint8_t *bytes = net_dest;
+	unsigned int hash = ( ( intptr_t ) netdev );
+	unsigned int i;
+
+	for ( i = 0 ; i < net_protocol->net_addr_len ; i++ )
+		hash = ( ( hash * 31 ) + bytes[i] );
+	return &neighbour_buckets[ hash % NEIGHBOUR_BUCKETS ];
+}
+
 /**
  * Free neighbour cache entry
  *
@@ -101,6 +145,8 @@ static struct neighbour * neighbour_create ( struct net_device *netdev,
 
 	/* Transfer ownership to cache */
 	list_add ( &neighbour->list, &neighbours );
+	list_add ( &neighbour->hash,
+		   neighbour_bucket ( netdev, net_protocol, net_dest ) );
 
 	DBGC ( neighbour, "NEIGHBOUR %s %s %s created\n", netdev->name,
 	       net_protocol->name, net_protocol->ntoa ( net_dest ) );
@@ -118,9 +164,11 @@ static struct neighbour * neighbour_create ( struct net_device *netdev,
 static struct neighbour * neighbour_find ( struct net_device *netdev,
 					   struct net_protocol *net_protocol,
 					   const void *net_dest ) {
+	struct list_head *bucket;
 	struct neighbour *neighbour;
 
-	list_for_each_entry ( neighbour, &neighbours, list ) {
+	bucket = neighbour_bucket ( netdev, net_protocol, net_dest );
+	list_for_each_entry ( neighbour, bucket, hash ) {
 		if ( ( neighbour->netdev == netdev ) &&
 		     ( neighbour->net_protocol == net_protocol ) &&
 		     ( memcmp ( neighbour->net_dest, net_dest,
@@ -179,12 +227,18 @@ static void neighbour_discovered ( struct neighbour *neighbour,
 
 	/* Fill in link-layer address */
 	memcpy ( neighbour->ll_dest, ll_dest, ll_protocol->ll_addr_len );
+	neighbour->valid = 1;
 	DBGC ( neighbour, "NEIGHBOUR %s %s %s is %s %s\n", netdev->name,
 	       net_protocol->name, net_protocol->ntoa ( neighbour->net_dest ),
 	       ll_protocol->name, ll_protocol->ntoa ( neighbour->ll_dest ) );
 
-	/* Stop retransmission timer */
+	/* Stop retransmission timer, and schedule a background
+	 * refresh where a discovery protocol is available.
+	 */
 	stop_timer ( &neighbour->timer );
+	if ( neighbour->discovery ) {
+		start_timer_fixed ( &neighbour->timer, NEIGHBOUR_REFRESH );
+	}
 
 	/* Transmit any packets in queue.  Take out a temporary
 	 * reference on the entry to prevent it from going out of
@@ -223,6 +277,7 @@ static void neighbour_destroy ( struct neighbour *neighbour, int rc ) {
 
 	/* Take ownership from cache */
 	list_del ( &neighbour->list );
+	list_del ( &neighbour->hash );
 
 	/* Stop timer */
 	stop_timer ( &neighbour->timer );
@@ -263,6 +318,24 @@ static void neighbour_expired ( struct retry_timer *timer, int fail ) {
 	const void *net_source = neighbour->net_source;
 	int rc;
 
+	/* Revalidate a completed entry in the background, leaving the
+	 * cached link-layer address in use.  An unanswered refresh is
+	 * simply repeated at the next interval.
+	 */
+	if ( neighbour->valid ) {
+		start_timer_fixed ( &neighbour->timer, NEIGHBOUR_REFRESH );
+		if ( ( rc = discovery->tx_request ( netdev, net_protocol,
+						    net_dest,
+						    net_source ) ) != 0 ) {
+			DBGC ( neighbour, "NEIGHBOUR %s %s %s could not "
+			       "transmit %s refresh: %s\n", netdev->name,
+			       net_protocol->name,
+			       net_protocol->ntoa ( neighbour->net_dest ),
+			       neighbour->discovery->name, strerror ( rc ) );
+		}
+		return;
+	}
+
 	/* If we have failed, destroy the cache entry */
 	if ( fail ) {
 		neighbour_destroy ( neighbour, -ETIMEDOUT );
@@ -379,6 +452,82 @@ int neighbour_define ( struct net_device *netdev,
 	return 0;
 }
 
+/**
+ * Snoop neighbour cache entry from received traffic
+ *
+ * @v netdev		Network device
+ * @v net_protocol	Network-layer protocol
+ * @v net_dest		Destination network-layer address
+ * @v ll_dest		Destination link-layer address
+ * @ret rc		Return status code
+ *
+ * Opportunistically learn a link-layer address observed in received
+ * traffic (e.g. a gratuitous ARP, or the source addresses of an
+ * on-link packet), so that a later transmission to the sender does
+ * not stall behind a discovery round trip.  Unlike
+ * neighbour_define(), this is safe to call on every received packet:
+ * an entry that already holds the observed address is left untouched.
+ */
+int neighbour_snoop ( struct net_device *netdev,
+		      struct net_protocol *net_protocol,
+		      const void *net_dest, const void *ll_dest ) {
+	struct ll_protocol *ll_protocol = netdev->ll_protocol;
+	struct neighbour *neighbour;
+
+	/* Do nothing if an entry already holds this address */
+	neighbour = neighbour_find ( netdev, net_protocol, net_dest );
+	if ( neighbour && neighbour->valid &&
+	     ( memcmp ( neighbour->ll_dest, ll_dest,
+			ll_protocol->ll_addr_len ) == 0 ) )
+		return 0;
+
+	/* Create cache entry, if necessary */
+	if ( ! neighbour ) {
+		neighbour = neighbour_create ( netdev, net_protocol, net_dest );
+		if ( ! neighbour )
+			return -ENOMEM;
+	}
+
+	/* Record observed address */
+	neighbour_discovered ( neighbour, ll_dest );
+
+	return 0;
+}
+
+/**
+ * Prewarm neighbour cache entry
+ *
+ * @v netdev		Network device
+ * @v net_protocol	Network-layer protocol
+ * @v net_dest		Destination network-layer address
+ * @v discovery		Neighbour discovery protocol
+ * @v net_source	Source network-layer address
+ * @ret rc		Return status code
+ *
+ * Begin neighbour discovery for an address expected to be used
+ * shortly (e.g. a newly configured gateway), so that the first real
+ * packet does not stall behind a discovery round trip.
+ */
+int neighbour_probe ( struct net_device *netdev,
+		      struct net_protocol *net_protocol,
+		      const void *net_dest,
+		      struct neighbour_discovery *discovery,
+		      const void *net_source ) {
+	struct neighbour *neighbour;
+
+	/* Do nothing if an entry already exists */
+	if ( neighbour_find ( netdev, net_protocol, net_dest ) != NULL )
+		return 0;
+
+	/* Create cache entry and start discovery */
+	neighbour = neighbour_create ( netdev, net_protocol, net_dest );
+	if ( ! neighbour )
+		return -ENOMEM;
+	neighbour_discover ( neighbour, discovery, net_source );
+
+	return 0;
+}
+
 /**
  * Update neighbour cache on network device state change or removal
  *
@@ -430,3 +579,18 @@ static unsigned int neighbour_discard ( void ) {
 struct cache_discarder neighbour_discarder __cache_discarder (CACHE_EXPENSIVE)={
 	.discard = neighbour_discard,
 };
+
+/**
+ * Initialise neighbour cache hash buckets
+ */
+static void neighbour_init ( void ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < NEIGHBOUR_BUCKETS ; i++ )
+		INIT_LIST_HEAD ( &neighbour_buckets[i] );
+}
+
+/** Neighbour cache initialiser */
+struct init_fn neighbour_init_fn __init_fn ( INIT_NORMAL ) = {
+	.initialise = neighbour_init,
+};
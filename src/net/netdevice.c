@@ -30,6 +30,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <string.h>
 #include <errno.h>
 #include <config/general.h>
+#include <ipxe/io.h>
 #include <ipxe/if_ether.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/tables.h>
@@ -40,7 +41,10 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/errortab.h>
 #include <ipxe/profile.h>
 #include <ipxe/fault.h>
+#include <ipxe/boottrace.h>
+#include <ipxe/pktcap.h>
 #include <ipxe/vlan.h>
+#include <ipxe/nap.h>
 #include <ipxe/netdevice.h>
 
 /** @file
@@ -58,14 +62,26 @@ static struct list_head open_net_devices = LIST_HEAD_INIT ( open_net_devices );
 /** Network device index */
 static unsigned int netdev_index = 0;
 
+/** Number of packets processed by net_poll()
+ *
+ * Used solely to detect idle periods; may wrap freely.
+ */
+static unsigned long net_rx_count = 0;
+
+/** Number of consecutive packet-free polls required before idling the CPU */
+#define NET_IDLE_POLLS 256
+
+/** Maximum poll backoff (in polls skipped between polls of a quiet device) */
+#define NETDEV_POLL_BACKOFF_MAX 64
+
 /** Network polling profiler */
-static struct profiler net_poll_profiler __profiler = { .name = "net.poll" };
+static struct profiler net_poll_profiler __profiler_lite = { .name = "net.poll" };
 
 /** Network receive profiler */
-static struct profiler net_rx_profiler __profiler = { .name = "net.rx" };
+static struct profiler net_rx_profiler __profiler_lite = { .name = "net.rx" };
 
 /** Network transmit profiler */
-static struct profiler net_tx_profiler __profiler = { .name = "net.tx" };
+static struct profiler net_tx_profiler __profiler_lite = { .name = "net.tx" };
 
 /** Default unknown link status code */
 #define EUNKNOWN_LINK_STATUS __einfo_error ( EINFO_EUNKNOWN_LINK_STATUS )
@@ -217,10 +233,38 @@ void netdev_link_block ( struct net_device *netdev, unsigned long timeout ) {
  */
 void netdev_link_unblock ( struct net_device *netdev ) {
 
+	/* Do nothing unless link is currently blocked */
+	if ( ! netdev_link_blocked ( netdev ) )
+		return;
+
 	/* Stop link block timer */
-	if ( netdev_link_blocked ( netdev ) )
-		DBGC ( netdev, "NETDEV %s link unblocked\n", netdev->name );
+	DBGC ( netdev, "NETDEV %s link unblocked\n", netdev->name );
 	stop_timer ( &netdev->link_block );
+
+	/* Notify drivers of link state change */
+	netdev_notify ( netdev );
+}
+
+/**
+ * Get highest link speed of any open network device
+ *
+ * @ret speed		Link speed (in Mbps), or zero if unknown
+ *
+ * This provides transfer strategies (e.g. TCP window sizing) with a
+ * best-available estimate of the attainable line rate, where the
+ * device carrying a particular connection is not readily identifiable.
+ */
+unsigned int netdev_max_link_speed ( void ) {
+	struct net_device *netdev;
+	unsigned int speed = 0;
+
+	for_each_netdev ( netdev ) {
+		if ( netdev_is_open ( netdev ) && netdev_link_ok ( netdev ) &&
+		     ( netdev->link_speed > speed ) ) {
+			speed = netdev->link_speed;
+		}
+	}
+	return speed;
 }
 
 /**
@@ -236,6 +280,124 @@ static void netdev_link_block_expired ( struct retry_timer *timer,
 
 	/* Assume link is no longer blocked */
 	DBGC ( netdev, "NETDEV %s link block expired\n", netdev->name );
+
+	/* Notify drivers of link state change */
+	netdev_notify ( netdev );
+}
+
+/**
+ * Update hardware multicast receive filter
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+static int netdev_mcast_update ( struct net_device *netdev ) {
+	int rc;
+
+	/* Do nothing unless device is open and can filter multicast */
+	if ( ( ! netdev_is_open ( netdev ) ) || ( ! netdev->op->mcast ) )
+		return 0;
+
+	/* Update hardware filter */
+	if ( ( rc = netdev->op->mcast ( netdev ) ) != 0 ) {
+		DBGC ( netdev, "NETDEV %s could not update multicast filter: "
+		       "%s\n", netdev->name, strerror ( rc ) );
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Join link-layer multicast group
+ *
+ * @v netdev		Network device
+ * @v ll_addr		Link-layer multicast address
+ * @ret rc		Return status code
+ *
+ * Memberships are reference-counted: each successful join must
+ * eventually be balanced by a leave.  Devices without a multicast
+ * filter method receive all multicast packets regardless of
+ * membership.
+ */
+int netdev_mcast_join ( struct net_device *netdev, const void *ll_addr ) {
+	struct ll_protocol *ll_protocol = netdev->ll_protocol;
+	struct net_device_mcast *mcast;
+	int rc;
+
+	/* Update existing membership, if any */
+	list_for_each_entry ( mcast, &netdev->mcast, list ) {
+		if ( memcmp ( mcast->ll_addr, ll_addr,
+			      ll_protocol->ll_addr_len ) == 0 ) {
+			mcast->count++;
+			return 0;
+		}
+	}
+
+	/* Create new membership */
+	mcast = zalloc ( sizeof ( *mcast ) );
+	if ( ! mcast ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	memcpy ( mcast->ll_addr, ll_addr, ll_protocol->ll_addr_len );
+	mcast->count = 1;
+	list_add_tail ( &mcast->list, &netdev->mcast );
+	DBGC ( netdev, "NETDEV %s joined %s\n",
+	       netdev->name, ll_protocol->ntoa ( ll_addr ) );
+
+	/* Update hardware filter */
+	if ( ( rc = netdev_mcast_update ( netdev ) ) != 0 )
+		goto err_update;
+
+	return 0;
+
+ err_update:
+	list_del ( &mcast->list );
+	free ( mcast );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Leave link-layer multicast group
+ *
+ * @v netdev		Network device
+ * @v ll_addr		Link-layer multicast address
+ */
+void netdev_mcast_leave ( struct net_device *netdev, const void *ll_addr ) {
+	struct ll_protocol *ll_protocol = netdev->ll_protocol;
+	struct net_device_mcast *mcast;
+
+	/* Locate membership, ignoring addresses that were never joined */
+	list_for_each_entry ( mcast, &netdev->mcast, list ) {
+		if ( memcmp ( mcast->ll_addr, ll_addr,
+			      ll_protocol->ll_addr_len ) != 0 )
+			continue;
+		if ( --mcast->count )
+			return;
+		list_del ( &mcast->list );
+		free ( mcast );
+		DBGC ( netdev, "NETDEV %s left %s\n",
+		       netdev->name, ll_protocol->ntoa ( ll_addr ) );
+		netdev_mcast_update ( netdev );
+		return;
+	}
+}
+
+/**
+ * Discard all multicast memberships
+ *
+ * @v netdev		Network device
+ */
+static void netdev_mcast_flush ( struct net_device *netdev ) {
+	struct net_device_mcast *mcast;
+	struct net_device_mcast *tmp;
+
+	list_for_each_entry_safe ( mcast, tmp, &netdev->mcast, list ) {
+		list_del ( &mcast->list );
+		free ( mcast );
+	}
 }
 
 /**
@@ -277,6 +439,16 @@ static void netdev_record_stat ( struct net_device_stats *stats, int rc ) {
 	least_common_error->count = 1;
 }
 
+/** Maximum length of an expedited deferred transmission
+ *
+ * When the transmit descriptor ring is full, frames no longer than
+ * this are queued ahead of deferred bulk data frames, so that a
+ * stream of full-sized transmissions (e.g. a background upload)
+ * cannot starve the pure acknowledgements that keep a concurrent
+ * download moving.
+ */
+#define NETDEV_TX_EXPEDITE_LEN 128
+
 /**
  * Transmit raw packet via network device
  *
@@ -292,7 +464,16 @@ int netdev_tx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 
 	DBGC2 ( netdev, "NETDEV %s transmitting %p (%p+%zx)\n",
 		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
-	profile_start ( &net_tx_profiler );
+	profile_start_lite ( &net_tx_profiler );
+
+	/* Record packet for capture, if applicable */
+	pktcap_record ( netdev, iobuf );
+
+	/* Resume polling at full rate, since transmission completions
+	 * (and probably responses) are now expected.
+	 */
+	netdev->poll_backoff = 0;
+	netdev->poll_skip = 0;
 
 	/* Enqueue packet */
 	list_add_tail ( &iobuf->list, &netdev->tx_queue );
@@ -311,7 +492,7 @@ int netdev_tx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 	if ( ( rc = netdev->op->transmit ( netdev, iobuf ) ) != 0 )
 		goto err;
 
-	profile_stop ( &net_tx_profiler );
+	profile_stop_lite ( &net_tx_profiler );
 	return 0;
 
  err:
@@ -349,13 +530,38 @@ void netdev_tx_defer ( struct net_device *netdev, struct io_buffer *iobuf ) {
 	/* Remove from transmit queue */
 	list_del ( &iobuf->list );
 
-	/* Add to deferred transmit queue */
-	list_add_tail ( &iobuf->list, &netdev->tx_deferred );
+	/* Add to deferred transmit queue, expediting small frames */
+	if ( iob_len ( iobuf ) <= NETDEV_TX_EXPEDITE_LEN ) {
+		list_add_tail ( &iobuf->list, &netdev->tx_expedited );
+	} else {
+		list_add_tail ( &iobuf->list, &netdev->tx_deferred );
+	}
 
 	/* Record "out of space" statistic */
 	netdev_tx_err ( netdev, NULL, -ENOBUFS );
 }
 
+/**
+ * Get first deferred transmission
+ *
+ * @v netdev		Network device
+ * @ret iobuf		I/O buffer, or NULL
+ *
+ * Expedited frames are serviced ahead of bulk data frames; each
+ * queue is serviced in order.
+ */
+static struct io_buffer * netdev_tx_deferred ( struct net_device *netdev ) {
+	struct io_buffer *iobuf;
+
+	iobuf = list_first_entry ( &netdev->tx_expedited, struct io_buffer,
+				   list );
+	if ( ! iobuf ) {
+		iobuf = list_first_entry ( &netdev->tx_deferred,
+					   struct io_buffer, list );
+	}
+	return iobuf;
+}
+
 /**
  * Discard transmitted packet
  *
@@ -403,8 +609,7 @@ void netdev_tx_complete_err ( struct net_device *netdev,
 	netdev_tx_err ( netdev, iobuf, rc );
 
 	/* Handle pending transmit queue */
-	while ( ( iobuf = list_first_entry ( &netdev->tx_deferred,
-					     struct io_buffer, list ) ) ) {
+	while ( ( iobuf = netdev_tx_deferred ( netdev ) ) != NULL ) {
 
 		/* Remove from pending transmit queue */
 		list_del ( &iobuf->list );
@@ -456,6 +661,7 @@ static void netdev_tx_flush ( struct net_device *netdev ) {
 	}
 	assert ( list_empty ( &netdev->tx_queue ) );
 	assert ( list_empty ( &netdev->tx_deferred ) );
+	assert ( list_empty ( &netdev->tx_expedited ) );
 }
 
 /**
@@ -468,19 +674,43 @@ static void netdev_tx_flush ( struct net_device *netdev ) {
  * function takes ownership of the I/O buffer.
  */
 void netdev_rx ( struct net_device *netdev, struct io_buffer *iobuf ) {
+	unsigned int fill;
 	int rc;
 
 	DBGC2 ( netdev, "NETDEV %s received %p (%p+%zx)\n",
 		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
 
+	/* Record packet for capture, if applicable */
+	pktcap_record ( netdev, iobuf );
+
 	/* Discard packet (for test purposes) if applicable */
 	if ( ( rc = inject_fault ( NETDEV_DISCARD_RATE ) ) != 0 ) {
 		netdev_rx_err ( netdev, iobuf, rc );
 		return;
 	}
 
-	/* Enqueue packet */
-	list_add_tail ( &iobuf->list, &netdev->rx_queue );
+	/* Discard packet if the RX ring is full */
+	if ( ( netdev->rx_ring.prod - netdev->rx_ring.cons ) >=
+	     NETDEV_RX_RING_COUNT ) {
+		netdev->rx_ring.overruns++;
+		netdev_rx_err ( netdev, iobuf, -ENOBUFS );
+		return;
+	}
+
+	/* Enqueue packet.  The packet pointer must be visible before
+	 * the producer counter advances.  Producer and consumer both
+	 * run within the single iPXE execution context, so a compiler
+	 * barrier is sufficient.
+	 */
+	netdev->rx_ring.iob[ netdev->rx_ring.prod %
+			     NETDEV_RX_RING_COUNT ] = iobuf;
+	barrier();
+	netdev->rx_ring.prod++;
+
+	/* Update high-water mark */
+	fill = ( netdev->rx_ring.prod - netdev->rx_ring.cons );
+	if ( fill > netdev->rx_ring.max )
+		netdev->rx_ring.max = fill;
 
 	/* Update statistics counter */
 	netdev_record_stat ( &netdev->rx_stats, 0 );
@@ -538,11 +768,14 @@ void netdev_poll ( struct net_device *netdev ) {
 struct io_buffer * netdev_rx_dequeue ( struct net_device *netdev ) {
 	struct io_buffer *iobuf;
 
-	iobuf = list_first_entry ( &netdev->rx_queue, struct io_buffer, list );
-	if ( ! iobuf )
+	/* Check for a received packet */
+	if ( netdev->rx_ring.cons == netdev->rx_ring.prod )
 		return NULL;
 
-	list_del ( &iobuf->list );
+	/* Dequeue packet */
+	iobuf = netdev->rx_ring.iob[ netdev->rx_ring.cons %
+				     NETDEV_RX_RING_COUNT ];
+	netdev->rx_ring.cons++;
 	return iobuf;
 }
 
@@ -607,6 +840,7 @@ static void free_netdev ( struct refcnt *refcnt ) {
 	stop_timer ( &netdev->link_block );
 	netdev_tx_flush ( netdev );
 	netdev_rx_flush ( netdev );
+	netdev_mcast_flush ( netdev );
 	clear_settings ( netdev_settings ( netdev ) );
 	free ( netdev );
 }
@@ -638,7 +872,8 @@ struct net_device * alloc_netdev ( size_t priv_len ) {
 			     &netdev->refcnt );
 		INIT_LIST_HEAD ( &netdev->tx_queue );
 		INIT_LIST_HEAD ( &netdev->tx_deferred );
-		INIT_LIST_HEAD ( &netdev->rx_queue );
+		INIT_LIST_HEAD ( &netdev->tx_expedited );
+		INIT_LIST_HEAD ( &netdev->mcast );
 		netdev_settings_init ( netdev );
 		config = netdev->configs;
 		for_each_table_entry ( configurator, NET_DEVICE_CONFIGURATORS ){
@@ -723,6 +958,7 @@ int register_netdev ( struct net_device *netdev ) {
 	DBGC ( netdev, "NETDEV %s registered (phys %s hwaddr %s)\n",
 	       netdev->name, netdev->dev->name,
 	       netdev_addr ( netdev ) );
+	boottrace_mark ( "netdev/%s", netdev->name );
 
 	/* Register per-netdev configuration settings */
 	if ( ( rc = register_settings ( netdev_settings ( netdev ),
@@ -776,10 +1012,17 @@ int netdev_open ( struct net_device *netdev ) {
 	/* Mark as opened */
 	netdev->state |= NETDEV_OPEN;
 
+	/* Start polling at full rate */
+	netdev->poll_backoff = 0;
+	netdev->poll_skip = 0;
+
 	/* Open the device */
 	if ( ( rc = netdev->op->open ( netdev ) ) != 0 )
 		goto err;
 
+	/* Apply multicast receive filter */
+	netdev_mcast_update ( netdev );
+
 	/* Add to head of open devices list */
 	list_add ( &netdev->open_list, &open_net_devices );
 
@@ -1028,13 +1271,39 @@ int net_tx ( struct io_buffer *iobuf, struct net_device *netdev,
 int net_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 	     uint16_t net_proto, const void *ll_dest, const void *ll_source,
 	     unsigned int flags ) {
+	static struct net_protocol *net_protocol_mru;
 	struct net_protocol *net_protocol;
 
+	/* Update demultiplex counters */
+	if ( net_proto == htons ( ETH_P_ARP ) ) {
+		netdev->demux[NETDEV_DEMUX_ARP]++;
+	} else if ( net_proto == htons ( ETH_P_IP ) ) {
+		netdev->demux[NETDEV_DEMUX_IPV4]++;
+	} else if ( net_proto == htons ( ETH_P_IPV6 ) ) {
+		netdev->demux[NETDEV_DEMUX_IPV6]++;
+	} else {
+		netdev->demux[NETDEV_DEMUX_OTHER]++;
+	}
+
+	/* Consecutive packets within a receive burst almost always
+	 * share a network-layer protocol.  Check the most recently
+	 * used protocol first, so that bursts drained from the receive
+	 * queue in a single poll do not rewalk the protocol table (and
+	 * its cold cache lines) for every packet.
+	 */
+	net_protocol = net_protocol_mru;
+	if ( net_protocol && ( net_protocol->net_proto == net_proto ) ) {
+		return net_protocol->rx ( iobuf, netdev, ll_dest,
+					  ll_source, flags );
+	}
+
 	/* Hand off to network-layer protocol, if any */
 	for_each_table_entry ( net_protocol, NET_PROTOCOLS ) {
-		if ( net_protocol->net_proto == net_proto )
+		if ( net_protocol->net_proto == net_proto ) {
+			net_protocol_mru = net_protocol;
 			return net_protocol->rx ( iobuf, netdev, ll_dest,
 						  ll_source, flags );
+		}
 	}
 
 	DBGC ( netdev, "NETDEV %s unknown network protocol %04x\n",
@@ -1056,16 +1325,51 @@ void net_poll ( void ) {
 	const void *ll_dest;
 	const void *ll_source;
 	uint16_t net_proto;
+	unsigned int yield;
 	unsigned int flags;
 	int rc;
 
 	/* Poll and process each network device */
 	list_for_each_entry ( netdev, &net_devices, list ) {
 
-		/* Poll for new packets */
-		profile_start ( &net_poll_profiler );
-		netdev_poll ( netdev );
-		profile_stop ( &net_poll_profiler );
+		/* Poll quiet devices at a reduced rate, so that they do
+		 * not steal poll cycles from a busy device.  Their RX
+		 * queues are still drained below, since packets may be
+		 * delivered to a device (e.g. a VLAN device) without
+		 * its driver being polled.
+		 */
+		if ( netdev->poll_skip ) {
+			netdev->poll_skip--;
+		} else {
+
+			/* Poll for new packets */
+			yield = ( netdev->rx_stats.good +
+				  netdev->rx_stats.bad );
+			profile_start_lite ( &net_poll_profiler );
+			netdev_poll ( netdev );
+			profile_stop_lite ( &net_poll_profiler );
+			yield = ( netdev->rx_stats.good +
+				  netdev->rx_stats.bad - yield );
+
+			/* Adjust poll backoff.  A device yielding
+			 * packets (or with transmissions in flight) is
+			 * polled on every pass; a quiet device backs
+			 * off exponentially up to the maximum.
+			 */
+			if ( yield || ( ! list_empty ( &netdev->tx_queue ) ) ) {
+				netdev->poll_backoff = 0;
+			} else {
+				netdev->poll_backoff =
+					( netdev->poll_backoff ?
+					  ( netdev->poll_backoff * 2 ) : 1 );
+				if ( netdev->poll_backoff >
+				     NETDEV_POLL_BACKOFF_MAX ) {
+					netdev->poll_backoff =
+						NETDEV_POLL_BACKOFF_MAX;
+				}
+				netdev->poll_skip = netdev->poll_backoff;
+			}
+		}
 
 		/* Leave received packets on the queue if receive
 		 * queue processing is currently frozen.  This will
@@ -1082,7 +1386,8 @@ void net_poll ( void ) {
 			DBGC2 ( netdev, "NETDEV %s processing %p (%p+%zx)\n",
 				netdev->name, iobuf, iobuf->data,
 				iob_len ( iobuf ) );
-			profile_start ( &net_rx_profiler );
+			profile_start_lite ( &net_rx_profiler );
+			net_rx_count++;
 
 			/* Remove link-layer header */
 			ll_protocol = netdev->ll_protocol;
@@ -1101,7 +1406,7 @@ void net_poll ( void ) {
 				/* Record error for diagnosis */
 				netdev_rx_err ( netdev, NULL, rc );
 			}
-			profile_stop ( &net_rx_profiler );
+			profile_stop_lite ( &net_rx_profiler );
 		}
 	}
 }
@@ -1111,8 +1416,71 @@ void net_poll ( void ) {
  *
  * @v process		Network stack process
  */
-static void net_step ( struct process *process __unused ) {
+static void net_step ( struct process *process ) {
+	static unsigned long last_rx_count;
+	static unsigned int quiet;
+	struct net_device *netdev;
+
 	net_poll();
+
+	/* Restart the idle countdown whenever a packet is processed */
+	if ( net_rx_count != last_rx_count ) {
+		last_rx_count = net_rx_count;
+		quiet = 0;
+		return;
+	}
+
+	/* Idle the CPU if the network has been quiet for long enough.
+	 * Busy polling wastes power and starves hyperthread siblings,
+	 * so halt until the next interrupt once it is safe to do so:
+	 * this process must be the only runnable process (any other
+	 * process has useful work to do), and every open network
+	 * device must be able to generate a receive interrupt to wake
+	 * us.  The periodic timer interrupt also wakes the CPU, so
+	 * retry timers and keypress checks are delayed by at most one
+	 * timer tick.
+	 */
+	if ( ++quiet < NET_IDLE_POLLS )
+		return;
+	quiet = NET_IDLE_POLLS; /* Avoid counter wraparound */
+	if ( ! process_sole ( process ) )
+		return;
+	list_for_each_entry ( netdev, &net_devices, list ) {
+		if ( netdev_is_open ( netdev ) &&
+		     ! netdev_irq_supported ( netdev ) )
+			return;
+	}
+	list_for_each_entry ( netdev, &net_devices, list ) {
+		if ( netdev_is_open ( netdev ) &&
+		     ! netdev_rx_frozen ( netdev ) &&
+		     ! netdev_irq_enabled ( netdev ) )
+			netdev_irq ( netdev, 1 );
+	}
+	cpu_nap();
+
+	/* Return to polled operation immediately on waking.  No
+	 * interrupt handler is registered for these devices, so a
+	 * receive interrupt left enabled would continue to assert
+	 * once the PIC is re-enabled; the subsequent poll will
+	 * acknowledge the device.  Devices with a frozen receive
+	 * queue are being driven by an external interrupt consumer
+	 * (e.g. a PXE NBP) and keep their interrupt state.
+	 */
+	list_for_each_entry ( netdev, &net_devices, list ) {
+		if ( netdev_is_open ( netdev ) &&
+		     ! netdev_rx_frozen ( netdev ) &&
+		     netdev_irq_enabled ( netdev ) )
+			netdev_irq ( netdev, 0 );
+	}
+
+	/* An interrupt has woken the CPU, and may have been a receive
+	 * interrupt from any device: resume polling every device at
+	 * full rate immediately.
+	 */
+	list_for_each_entry ( netdev, &net_devices, list ) {
+		netdev->poll_backoff = 0;
+		netdev->poll_skip = 0;
+	}
 }
 
 /**
@@ -1157,6 +1525,18 @@ __weak void vlan_netdev_rx_err ( struct net_device *netdev,
 	netdev_rx_err ( netdev, iobuf, rc );
 }
 
+/**
+ * Record packet for capture (when packet capture is not present)
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ */
+__weak void pktcap_record ( struct net_device *netdev __unused,
+			    struct io_buffer *iobuf __unused ) {
+
+	/* Do nothing */
+}
+
 /** Networking stack process */
 PERMANENT_PROCESS ( net_process, net_step );
 
@@ -1172,9 +1552,15 @@ static unsigned int net_discard ( void ) {
 
 	/* Try to drop one deferred TX packet from each network device */
 	for_each_netdev ( netdev ) {
-		if ( ( iobuf = list_first_entry ( &netdev->tx_deferred,
-						  struct io_buffer,
-						  list ) ) != NULL ) {
+
+		/* Prefer to discard bulk data over expedited frames */
+		iobuf = list_first_entry ( &netdev->tx_deferred,
+					   struct io_buffer, list );
+		if ( ! iobuf ) {
+			iobuf = list_first_entry ( &netdev->tx_expedited,
+						   struct io_buffer, list );
+		}
+		if ( iobuf ) {
 
 			/* Discard first deferred packet */
 			list_del ( &iobuf->list );
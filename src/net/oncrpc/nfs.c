@@ -48,6 +48,8 @@
 #define NFS_READLINK    5
 /** NFS READ procedure */
 #define NFS_READ        6
+/** NFS FSINFO procedure */
+#define NFS_FSINFO      19
 
 /**
  * Extract a file handle from the beginning of an I/O buffer
@@ -144,6 +146,24 @@ int nfs_read ( struct interface *intf, struct oncrpc_session *session,
 	return oncrpc_call ( intf, session, NFS_READ, fields );
 }
 
+/**
+ * Send a FSINFO request
+ *
+ * @v intf              Interface to send the request on
+ * @v session           ONC RPC session
+ * @v fh                Any file handle within the filesystem
+ * @ret rc              Return status code
+ */
+int nfs_fsinfo ( struct interface *intf, struct oncrpc_session *session,
+                 const struct nfs_fh *fh ) {
+	struct oncrpc_field fields[] = {
+		ONCRPC_SUBFIELD ( array, fh->size, &fh->fh ),
+		ONCRPC_FIELD_END,
+	};
+
+	return oncrpc_call ( intf, session, NFS_FSINFO, fields );
+}
+
 /**
  * Parse a LOOKUP reply
  *
@@ -286,3 +306,38 @@ int nfs_get_read_reply ( struct nfs_read_reply *read_reply,
 	return 0;
 }
 
+/**
+ * Parse a FSINFO reply
+ *
+ * @v fsinfo_reply      A structure where the data will be saved
+ * @v reply             The ONC RPC reply to get data from
+ * @ret rc              Return status code
+ */
+int nfs_get_fsinfo_reply ( struct nfs_fsinfo_reply *fsinfo_reply,
+                           struct oncrpc_reply *reply ) {
+	if ( ! fsinfo_reply || ! reply )
+		return -EINVAL;
+
+	fsinfo_reply->status = oncrpc_iob_get_int ( reply->data );
+	switch ( fsinfo_reply->status )
+	{
+	case NFS3_OK:
+		 break;
+	case NFS3ERR_STALE:
+		return -ESTALE;
+	case NFS3ERR_BADHANDLE:
+	case NFS3ERR_SERVERFAULT:
+	default:
+		return -EPROTO;
+	}
+
+	if ( oncrpc_iob_get_int ( reply->data ) == 1 )
+		iob_pull ( reply->data, 5 * sizeof ( uint32_t ) +
+		                        8 * sizeof ( uint64_t ) );
+
+	fsinfo_reply->rtmax  = oncrpc_iob_get_int ( reply->data );
+	fsinfo_reply->rtpref = oncrpc_iob_get_int ( reply->data );
+
+	return 0;
+}
+
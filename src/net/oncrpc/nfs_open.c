@@ -50,7 +50,44 @@
 
 FEATURE ( FEATURE_PROTOCOL, "NFS", DHCP_EB_FEATURE_NFS, 1 );
 
+/** Fallback READ request size
+ *
+ * Used until (or unless) the server's FSINFO reply yields a usable
+ * preferred transfer size.
+ */
+#ifndef NFS_RSIZE
 #define NFS_RSIZE 100000
+#endif
+
+/** Maximum negotiated READ request size */
+#ifndef NFS_RSIZE_MAX
+#define NFS_RSIZE_MAX ( 1024 * 1024 )
+#endif
+
+/** Number of pipelined READ calls
+ *
+ * Keeping several READ calls in flight hides the per-call round trip
+ * to the server, which otherwise limits throughput on high-latency
+ * links regardless of the available bandwidth.
+ */
+#ifndef NFS_READ_PIPELINE
+#define NFS_READ_PIPELINE 4
+#endif
+
+/** Maximum length of an ONC RPC opaque verifier body (RFC 5531) */
+#define NFS_VERF_MAX 400
+
+/** Size of a wire-format NFS fattr3 structure */
+#define NFS_FATTR3_SIZE ( 5 * sizeof ( uint32_t ) + 8 * sizeof ( uint64_t ) )
+
+/** Maximum size of a READ reply header
+ *
+ * Calculated for a reply carrying a maximum-length verifier and a
+ * full set of post-operation file attributes.
+ */
+#define NFS_READ_HDR_MAX ( 6 * sizeof ( uint32_t ) + NFS_VERF_MAX +	\
+			   3 * sizeof ( uint32_t ) + NFS_FATTR3_SIZE +	\
+			   3 * sizeof ( uint32_t ) )
 
 enum nfs_pm_state {
 	NFS_PORTMAP_NONE = 0,
@@ -68,6 +105,8 @@ enum nfs_mount_state {
 
 enum nfs_state {
 	NFS_NONE = 0,
+	NFS_FSINFO,
+	NFS_FSINFO_SENT,
 	NFS_LOOKUP,
 	NFS_LOOKUP_SENT,
 	NFS_READLINK,
@@ -77,6 +116,21 @@ enum nfs_state {
 	NFS_CLOSED,
 };
 
+/**
+ * An in-flight NFS READ call
+ *
+ */
+struct nfs_read_call {
+	/** ONC RPC transaction identifier */
+	uint32_t                rpc_id;
+	/** File offset */
+	uint64_t                offset;
+	/** Requested byte count */
+	uint32_t                count;
+	/** Call is in flight */
+	int                     busy;
+};
+
 /**
  * A NFS request
  *
@@ -106,10 +160,20 @@ struct nfs_request {
 
 	struct nfs_fh           readlink_fh;
 	struct nfs_fh           current_fh;
-	uint64_t                file_offset;
+
+	uint32_t                rsize;
+	struct nfs_read_call    reads[NFS_READ_PIPELINE];
+	unsigned int            out_count;
+	uint64_t                sent_offset;
+	uint64_t                deliver_offset;
+	uint64_t                file_size;
+	int                     sized;
 
 	size_t                  remaining;
-	int                     eof;
+	/** XDR padding which follows the current payload */
+	size_t                  padding;
+	/** Reply header reassembly buffer */
+	struct io_buffer        *hdr;
 };
 
 static void nfs_step ( struct nfs_request *nfs );
@@ -127,6 +191,7 @@ static void nfs_free ( struct refcnt *refcnt ) {
 
 	nfs_uri_free ( &nfs->uri );
 
+	free_iob ( nfs->hdr );
 	free ( nfs->hostname );
 	free ( nfs->auth_sys.hostname );
 	free ( nfs );
@@ -214,7 +279,10 @@ static int nfs_pm_deliver ( struct nfs_request *nfs,
 	struct oncrpc_reply             reply;
 	struct portmap_getport_reply    getport_reply;
 
-	oncrpc_get_reply ( &nfs->pm_session, &reply, io_buf );
+	rc = oncrpc_get_reply ( &nfs->pm_session, &reply, io_buf );
+	if ( rc != 0 )
+		goto err;
+
 	if ( reply.accept_state != 0 )
 	{
 		rc = -EPROTO;
@@ -305,7 +373,10 @@ static int nfs_mount_deliver ( struct nfs_request *nfs,
 	struct oncrpc_reply     reply;
 	struct mount_mnt_reply  mnt_reply;
 
-	oncrpc_get_reply ( &nfs->mount_session, &reply, io_buf );
+	rc = oncrpc_get_reply ( &nfs->mount_session, &reply, io_buf );
+	if ( rc != 0 )
+		goto err;
+
 	if ( reply.accept_state != 0 )
 	{
 		rc = -EPROTO;
@@ -343,7 +414,7 @@ static int nfs_mount_deliver ( struct nfs_request *nfs,
 		}
 
 		nfs->current_fh = mnt_reply.fh;
-		nfs->nfs_state = NFS_LOOKUP;
+		nfs->nfs_state = NFS_FSINFO;
 		nfs_step ( nfs );
 
 		goto done;
@@ -364,6 +435,221 @@ done:
 	return 0;
 }
 
+/**
+ * Find the in-flight READ call matching a reply
+ *
+ * @v nfs		NFS request
+ * @v rpc_id		ONC RPC transaction identifier
+ * @ret call		READ call, or NULL if not found
+ */
+static struct nfs_read_call * nfs_read_find ( struct nfs_request *nfs,
+                                              uint32_t rpc_id ) {
+	unsigned int    i;
+
+	for ( i = 0; i < NFS_READ_PIPELINE; i++ ) {
+		if ( nfs->reads[i].busy && nfs->reads[i].rpc_id == rpc_id )
+			return &nfs->reads[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * Issue a single READ call
+ *
+ * @v nfs		NFS request
+ * @v offset		File offset
+ * @v count		Byte count
+ * @ret rc		Return status code
+ */
+static int nfs_read_issue ( struct nfs_request *nfs, uint64_t offset,
+                            uint32_t count ) {
+	struct nfs_read_call    *call = NULL;
+	unsigned int            i;
+	int                     rc;
+
+	for ( i = 0; i < NFS_READ_PIPELINE; i++ ) {
+		if ( ! nfs->reads[i].busy ) {
+			call = &nfs->reads[i];
+			break;
+		}
+	}
+	assert ( call != NULL );
+
+	DBGC2 ( nfs, "NFS_OPEN %p READ call (offset %llu, count %d)\n",
+	        nfs, offset, count );
+
+	rc = nfs_read ( &nfs->nfs_intf, &nfs->nfs_session, &nfs->current_fh,
+	                offset, count );
+	if ( rc != 0 )
+		return rc;
+
+	call->rpc_id = nfs->nfs_session.rpc_id;
+	call->offset = offset;
+	call->count  = count;
+	call->busy   = 1;
+	nfs->out_count++;
+
+	return 0;
+}
+
+/**
+ * Issue READ calls until the pipeline window is full
+ *
+ * @v nfs		NFS request
+ * @ret rc		Return status code
+ */
+static int nfs_read_window ( struct nfs_request *nfs ) {
+	int     rc;
+
+	while ( nfs->out_count < NFS_READ_PIPELINE ) {
+		if ( nfs->sized && nfs->sent_offset >= nfs->file_size )
+			break;
+
+		rc = nfs_read_issue ( nfs, nfs->sent_offset, nfs->rsize );
+		if ( rc != 0 )
+			return rc;
+
+		nfs->sent_offset += nfs->rsize;
+	}
+
+	return 0;
+}
+
+/**
+ * Calculate how much more of a READ reply header must be buffered
+ *
+ * @v nfs		NFS request
+ * @ret needed		Number of additional bytes required, or zero
+ *
+ * The reply header is variable-length: the verifier body and the
+ * optional post-operation attributes change the offset at which the
+ * opaque file data begins.  The required length is therefore
+ * recalculated as the buffered prefix grows; a return value of zero
+ * indicates that the header may now be parsed (possibly yielding an
+ * error for a malformed reply).
+ */
+static size_t nfs_read_hdr_needed ( struct nfs_request *nfs ) {
+	struct io_buffer        *hdr = nfs->hdr;
+	size_t                  len = iob_len ( hdr );
+	size_t                  needed;
+	uint32_t                word;
+
+	/* Record mark through verifier length */
+	needed = ( 6 * sizeof ( uint32_t ) );
+	if ( len < needed )
+		return ( needed - len );
+
+	/* A rejected reply carries no verifier; parse (and fail) now */
+	memcpy ( &word, ( hdr->data + 3 * sizeof ( uint32_t ) ),
+	         sizeof ( word ) );
+	if ( word != 0 )
+		return 0;
+
+	/* Verifier body, accept state, status and attributes
+	 * discriminant.  An over-length verifier is rejected during
+	 * parsing.
+	 */
+	memcpy ( &word, ( hdr->data + 5 * sizeof ( uint32_t ) ),
+	         sizeof ( word ) );
+	if ( ntohl ( word ) > NFS_VERF_MAX )
+		return 0;
+	needed += ( ntohl ( word ) + 3 * sizeof ( uint32_t ) );
+	if ( len < needed )
+		return ( needed - len );
+
+	/* Post-operation attributes (if present), count, eof and
+	 * opaque data length.
+	 */
+	memcpy ( &word, ( hdr->data + needed - sizeof ( uint32_t ) ),
+	         sizeof ( word ) );
+	if ( ntohl ( word ) == 1 )
+		needed += NFS_FATTR3_SIZE;
+	needed += ( 3 * sizeof ( uint32_t ) );
+	if ( len < needed )
+		return ( needed - len );
+
+	return 0;
+}
+
+/**
+ * Process a fully-buffered READ reply header
+ *
+ * @v nfs		NFS request
+ * @ret rc		Return status code
+ *
+ * Parses the reply header accumulated in the reassembly buffer and
+ * records the length of the payload which follows it on the wire.
+ */
+static int nfs_read_reply ( struct nfs_request *nfs ) {
+	int                     rc;
+	struct oncrpc_reply     reply;
+	struct nfs_read_reply   read_reply;
+	struct nfs_read_call    *call;
+
+	rc = oncrpc_get_reply ( &nfs->nfs_session, &reply, nfs->hdr );
+	if ( rc != 0 )
+		goto out;
+
+	if ( reply.accept_state != 0 ) {
+		rc = -EPROTO;
+		goto out;
+	}
+
+	rc = nfs_get_read_reply ( &read_reply, &reply );
+	if ( rc != 0 )
+		goto out;
+
+	call = nfs_read_find ( nfs, reply.rpc_id );
+	if ( ! call ) {
+		DBGC ( nfs, "NFS_OPEN %p got unexpected READ reply (id %d)\n",
+		       nfs, reply.rpc_id );
+		rc = -EPROTO;
+		goto out;
+	}
+
+	call->busy = 0;
+	nfs->out_count--;
+
+	DBGC ( nfs, "NFS_OPEN %p got READ reply (offset %llu, count %d%s)\n",
+	       nfs, call->offset, read_reply.count,
+	       read_reply.eof ? ", eof" : "" );
+
+	if ( call->offset == 0 ) {
+		DBGC2 ( nfs, "NFS_OPEN %p size: %llu bytes\n",
+		        nfs, read_reply.filesize );
+
+		xfer_seek ( &nfs->xfer, read_reply.filesize );
+		xfer_seek ( &nfs->xfer, 0 );
+	}
+
+	nfs->deliver_offset = call->offset;
+	nfs->remaining      = read_reply.count;
+	nfs->padding        = ( ( -read_reply.count ) & 0x3 );
+
+	if ( read_reply.eof ) {
+		/* This call reached the end of the file */
+		nfs->file_size = call->offset + read_reply.count;
+		nfs->sized     = 1;
+	} else if ( read_reply.count < call->count ) {
+		/* The server returned a short read; reissue the
+		 * remainder into the slot which has just been freed.
+		 */
+		rc = nfs_read_issue ( nfs, call->offset + read_reply.count,
+		                      call->count - read_reply.count );
+		if ( rc != 0 )
+			goto out;
+	}
+
+	rc = 0;
+out:
+	/* The reassembly buffer is consumed either way */
+	free_iob ( nfs->hdr );
+	nfs->hdr = NULL;
+
+	return rc;
+}
+
 static void nfs_step ( struct nfs_request *nfs ) {
 	int     rc;
 	char    *path_component;
@@ -371,6 +657,18 @@ static void nfs_step ( struct nfs_request *nfs ) {
 	if ( ! xfer_window ( &nfs->nfs_intf ) )
 		return;
 
+	if ( nfs->nfs_state == NFS_FSINFO ) {
+		DBGC ( nfs, "NFS_OPEN %p FSINFO call\n", nfs );
+
+		rc = nfs_fsinfo ( &nfs->nfs_intf, &nfs->nfs_session,
+		                  &nfs->current_fh );
+		if ( rc != 0 )
+			goto err;
+
+		nfs->nfs_state++;
+		return;
+	}
+
 	if ( nfs->nfs_state == NFS_LOOKUP ) {
 		path_component = nfs_uri_next_path_component ( &nfs->uri );
 
@@ -400,11 +698,7 @@ static void nfs_step ( struct nfs_request *nfs ) {
 	}
 
 	if ( nfs->nfs_state == NFS_READ ) {
-		DBGC ( nfs, "NFS_OPEN %p READ call\n", nfs );
-
-		rc = nfs_read ( &nfs->nfs_intf, &nfs->nfs_session,
-		                &nfs->current_fh, nfs->file_offset,
-		                NFS_RSIZE );
+		rc = nfs_read_window ( nfs );
 		if ( rc != 0 )
 			goto err;
 
@@ -423,14 +717,40 @@ static int nfs_deliver ( struct nfs_request *nfs,
 	int                     rc;
 	struct oncrpc_reply     reply;
 
-	if ( nfs->remaining == 0 ) {
-		oncrpc_get_reply ( &nfs->nfs_session, &reply, io_buf );
+	if ( nfs->nfs_state != NFS_READ_SENT ) {
+		rc = oncrpc_get_reply ( &nfs->nfs_session, &reply, io_buf );
+		if ( rc != 0 )
+			goto err;
+
 		if ( reply.accept_state != 0 ) {
 			rc = -EPROTO;
 			goto err;
 		}
 	}
 
+	if ( nfs->nfs_state == NFS_FSINFO_SENT ) {
+		struct nfs_fsinfo_reply fsinfo_reply;
+
+		DBGC ( nfs, "NFS_OPEN %p got FSINFO reply\n", nfs );
+
+		rc = nfs_get_fsinfo_reply ( &fsinfo_reply, &reply );
+		if ( rc != 0 ) {
+			DBGC ( nfs, "NFS_OPEN %p FSINFO failed (%s), using " \
+			       "default read size\n", nfs, strerror ( rc ) );
+		} else if ( fsinfo_reply.rtpref != 0 ) {
+			nfs->rsize = fsinfo_reply.rtpref;
+			if ( nfs->rsize > NFS_RSIZE_MAX )
+				nfs->rsize = NFS_RSIZE_MAX;
+
+			DBGC ( nfs, "NFS_OPEN %p negotiated read size: %d " \
+			       "bytes\n", nfs, nfs->rsize );
+		}
+
+		nfs->nfs_state = NFS_LOOKUP;
+		nfs_step ( nfs );
+		goto done;
+	}
+
 	if ( nfs->nfs_state == NFS_LOOKUP_SENT ) {
 		struct nfs_lookup_reply lookup_reply;
 
@@ -491,53 +811,112 @@ static int nfs_deliver ( struct nfs_request *nfs,
 	}
 
 	if ( nfs->nfs_state == NFS_READ_SENT ) {
-		if ( nfs->remaining == 0 ) {
-			DBGC ( nfs, "NFS_OPEN %p got READ reply\n", nfs );
-
-			struct nfs_read_reply read_reply;
-
-			rc = nfs_get_read_reply ( &read_reply, &reply );
-			if ( rc != 0 )
-				goto err;
-
-			if ( nfs->file_offset == 0 ) {
-				DBGC2 ( nfs, "NFS_OPEN %p size: %llu bytes\n",
-				        nfs, read_reply.filesize );
+		struct xfer_metadata    data_meta;
+		struct io_buffer        *head;
+		size_t                  len;
+		size_t                  needed;
+
+		while ( io_buf && iob_len ( io_buf ) != 0 ) {
+			/* Begin a new reply, unless in the middle of one */
+			if ( nfs->remaining == 0 ) {
+				/* Discard XDR padding which follows
+				 * the previous payload.
+				 */
+				len = iob_len ( io_buf );
+				if ( len > nfs->padding )
+					len = nfs->padding;
+				iob_pull ( io_buf, len );
+				nfs->padding -= len;
+
+				/* Accumulate the reply header, which
+				 * may straddle several deliveries,
+				 * before parsing it.
+				 */
+				if ( ! nfs->hdr &&
+				     ! ( nfs->hdr =
+				           alloc_iob ( NFS_READ_HDR_MAX ) ) ) {
+					rc = -ENOMEM;
+					goto err;
+				}
+
+				while ( ( needed =
+				            nfs_read_hdr_needed ( nfs ) ) ) {
+					len = iob_len ( io_buf );
+					if ( len > needed )
+						len = needed;
+					memcpy ( iob_put ( nfs->hdr, len ),
+					         io_buf->data, len );
+					iob_pull ( io_buf, len );
+					if ( len < needed )
+						break;
+				}
+
+				/* Await further deliveries if the
+				 * header is still incomplete.
+				 */
+				if ( needed != 0 )
+					break;
 
-				xfer_seek ( &nfs->xfer, read_reply.filesize );
-				xfer_seek ( &nfs->xfer, 0 );
+				if ( ( rc = nfs_read_reply ( nfs ) ) != 0 )
+					goto err;
 			}
 
-			nfs->file_offset += read_reply.count;
-			nfs->remaining    = read_reply.count;
-			nfs->eof          = read_reply.eof;
-		}
-
-		size_t len = iob_len ( io_buf );
-		if ( len > nfs->remaining )
-			iob_unput ( io_buf, len - nfs->remaining );
-
-		nfs->remaining -= iob_len ( io_buf );
-
-		DBGC ( nfs, "NFS_OPEN %p got %zd bytes\n", nfs,
-		       iob_len ( io_buf ) );
+			/* Deliver the payload, splitting the buffer if
+			 * it also contains the start of the next reply.
+			 */
+			len = iob_len ( io_buf );
+			if ( len > nfs->remaining )
+				len = nfs->remaining;
+
+			if ( len != 0 ) {
+				DBGC ( nfs, "NFS_OPEN %p got %zd bytes\n",
+				       nfs, len );
+
+				if ( len == iob_len ( io_buf ) ) {
+					head = iob_disown ( io_buf );
+				} else {
+					head = alloc_iob ( len );
+					if ( ! head ) {
+						rc = -ENOMEM;
+						goto err;
+					}
+					memcpy ( iob_put ( head, len ),
+					         io_buf->data, len );
+					iob_pull ( io_buf, len );
+				}
+
+				memset ( &data_meta, 0, sizeof ( data_meta ) );
+				data_meta.flags  = XFER_FL_ABS_OFFSET;
+				data_meta.offset = nfs->deliver_offset;
+
+				nfs->deliver_offset += len;
+				nfs->remaining      -= len;
+
+				rc = xfer_deliver ( &nfs->xfer,
+				                    iob_disown ( head ),
+				                    &data_meta );
+				if ( rc != 0 )
+					goto err;
+			}
 
-		rc = xfer_deliver_iob ( &nfs->xfer, iob_disown ( io_buf ) );
-		if ( rc != 0 )
-			goto err;
+			if ( nfs->remaining == 0 ) {
+				/* Refill the pipeline window */
+				if ( ( rc = nfs_read_window ( nfs ) ) != 0 )
+					goto err;
 
-		if ( nfs->remaining == 0 ) {
-			if ( ! nfs->eof ) {
-				nfs->nfs_state--;
-				nfs_step ( nfs );
-			} else {
-				intf_shutdown ( &nfs->nfs_intf, 0 );
-				nfs->nfs_state++;
-				nfs->mount_state++;
-				nfs_mount_step ( nfs );
+				if ( nfs->out_count == 0 ) {
+					intf_shutdown ( &nfs->nfs_intf, 0 );
+					nfs->nfs_state++;
+					nfs->mount_state++;
+					nfs_mount_step ( nfs );
+					break;
+				}
 			}
 		}
 
+		if ( io_buf )
+			free_iob ( io_buf );
+
 		return 0;
 	}
 
@@ -653,6 +1032,8 @@ static int nfs_open ( struct interface *xfer, struct uri *uri ) {
 	mount_init_session ( &nfs->mount_session, &nfs->auth_sys.credential );
 	nfs_init_session ( &nfs->nfs_session, &nfs->auth_sys.credential );
 
+	nfs->rsize = NFS_RSIZE;
+
 	DBGC ( nfs, "NFS_OPEN %p connecting to port mapper (%s:%d)...\n", nfs,
 	       nfs->hostname, PORTMAP_PORT );
 
@@ -584,12 +584,42 @@ static int peerdist_info_v2_segment ( struct peerdist_info_segment *segment ) {
 	size_t len;
 	int rc;
 
+	/* Most recently used cursor position
+	 *
+	 * Block scheduling iterates over segments in ascending order,
+	 * and each lookup would otherwise rescan every preceding
+	 * segment description from the start of the raw data.  A
+	 * cursor's validity depends only on the raw data itself, so
+	 * keying the cached position on the raw data is sufficient.
+	 */
+	static struct {
+		/** Raw data */
+		userptr_t data;
+		/** Raw data length */
+		size_t len;
+		/** Segment index at cursor position */
+		unsigned int index;
+		/** Cursor position */
+		struct peerdist_info_v2_cursor cursor;
+	} mru;
+
 	/* Sanity checks */
 	assert ( segment->index < info->segments );
 
+	/* Start from the most recently used cursor position, if it
+	 * refers to this raw data and does not lie beyond the target
+	 * segment.
+	 */
+	peerdist_info_v2_cursor_init ( &cursor );
+	index = 0;
+	if ( ( mru.data == info->raw.data ) && ( mru.len == info->raw.len ) &&
+	     ( mru.index <= segment->index ) ) {
+		memcpy ( &cursor, &mru.cursor, sizeof ( cursor ) );
+		index = mru.index;
+	}
+
 	/* Iterate over all segments before the target segment */
-	for ( peerdist_info_v2_cursor_init ( &cursor ), index = 0 ;
-	      index < segment->index ; index++ ) {
+	for ( ; index < segment->index ; index++ ) {
 
 		/* Update segment cursor */
 		if ( ( rc = peerdist_info_v2_cursor_next ( info,
@@ -601,6 +631,12 @@ static int peerdist_info_v2_segment ( struct peerdist_info_segment *segment ) {
 		}
 	}
 
+	/* Record cursor position for subsequent lookups */
+	mru.data = info->raw.data;
+	mru.len = info->raw.len;
+	mru.index = segment->index;
+	memcpy ( &mru.cursor, &cursor, sizeof ( mru.cursor ) );
+
 	/* Get raw description */
 	if ( ( rc = peerdist_info_get ( info, &raw, cursor.offset,
 					sizeof ( raw ) ) ) != 0 ) {
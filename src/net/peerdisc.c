@@ -73,6 +73,16 @@ static LIST_HEAD ( peerdisc_segments );
  */
 unsigned int peerdisc_timeout_secs = PEERDISC_DEFAULT_TIMEOUT_SECS;
 
+/** Peer throughput smoothing factor (as a power of two)
+ *
+ * Observed peer throughput is smoothed using an exponentially weighted
+ * moving average, so that a single anomalously fast or slow block
+ * download does not dominate the peer ranking.
+ */
+#ifndef PEERDISC_RATE_SMOOTHING
+#define PEERDISC_RATE_SMOOTHING 2
+#endif
+
 /** Hosted cache server */
 static char *peerhost;
 
@@ -410,6 +420,76 @@ static int peerdisc_discovered ( struct peerdisc_segment *segment,
 	return 0;
 }
 
+/**
+ * Update PeerDist peer ranking after a successful download
+ *
+ * @v segment		PeerDist discovery segment
+ * @v peer		PeerDist discovery peer
+ * @v len		Downloaded length
+ * @v ticks		Download duration
+ *
+ * Update the peer's smoothed throughput estimate and promote the peer
+ * ahead of any slower peers, so that subsequent block downloads will
+ * try the fastest known peers first.
+ */
+void peerdisc_rank ( struct peerdisc_segment *segment,
+		     struct peerdisc_peer *peer, size_t len,
+		     unsigned long ticks ) {
+	struct peerdisc_peer *prev;
+	unsigned long rate;
+
+	/* Calculate observed throughput, avoiding division by zero
+	 * and treating a zero rate as meaning "unmeasured".
+	 */
+	if ( ticks == 0 )
+		ticks = 1;
+	rate = ( len / ticks );
+	if ( rate == 0 )
+		rate = 1;
+
+	/* Update exponentially weighted moving average */
+	if ( peer->rate ) {
+		peer->rate += ( ( ( signed long ) ( rate - peer->rate ) ) >>
+				PEERDISC_RATE_SMOOTHING );
+	} else {
+		peer->rate = rate;
+	}
+	DBGC2 ( segment, "PEERDISC %p peer %s at %ld bytes/tick\n",
+		segment, peer->location, peer->rate );
+
+	/* Promote ahead of any slower (or unmeasured) peers.  Peers
+	 * are moved within the list but never removed from it, so
+	 * concurrent block downloads may safely retain a pointer to a
+	 * current position within the list.
+	 */
+	while ( ( prev = list_prev_entry ( peer, &segment->peers,
+					   list ) ) != NULL ) {
+		if ( prev->rate >= peer->rate )
+			break;
+		list_del ( &peer->list );
+		list_add_tail ( &peer->list, &prev->list );
+	}
+}
+
+/**
+ * Demote PeerDist peer after a failed download
+ *
+ * @v segment		PeerDist discovery segment
+ * @v peer		PeerDist discovery peer
+ *
+ * Halve the peer's smoothed throughput estimate, so that peers which
+ * stall or fail mid-transfer will be overtaken in the ranking by
+ * better-performing peers.
+ */
+void peerdisc_demote ( struct peerdisc_segment *segment,
+		       struct peerdisc_peer *peer ) {
+
+	/* Halve throughput estimate */
+	peer->rate >>= 1;
+	DBGC2 ( segment, "PEERDISC %p peer %s demoted to %ld bytes/tick\n",
+		segment, peer->location, peer->rate );
+}
+
 /**
  * Handle discovery timer expiry
  *
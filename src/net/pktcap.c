@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Packet capture
+ *
+ * Transmitted and received packets are recorded (truncated to
+ * PKTCAP_SNAP_LEN bytes) in a fixed-size ring, overwriting the oldest
+ * entries when full.  The ring can be uploaded as a pcap file via an
+ * HTTP POST request, allowing wire-level diagnosis of machines that
+ * cannot be reached with a mirror port.
+ *
+ * Capture timestamps are measured in ticks since startup rather than
+ * wall-clock time; pcap consumers see monotonically increasing
+ * timestamps starting shortly after the epoch, which is sufficient
+ * for relative timing analysis.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+#include <ipxe/http.h>
+#include <ipxe/timer.h>
+#include <ipxe/pktcap.h>
+
+/** Capture ring */
+static struct pktcap_packet pktcap_ring[PKTCAP_NUM_PACKETS];
+
+/** Capture ring producer counter */
+static unsigned int pktcap_prod;
+
+/** pcap file magic number */
+#define PCAP_MAGIC 0xa1b2c3d4UL
+
+/** pcap format version */
+#define PCAP_VERSION_MAJOR 2
+#define PCAP_VERSION_MINOR 4
+
+/** pcap link type for Ethernet */
+#define PCAP_NETWORK_ETHERNET 1
+
+/** pcap file header */
+struct pcap_header {
+	/** Magic number */
+	uint32_t magic;
+	/** Major version number */
+	uint16_t major;
+	/** Minor version number */
+	uint16_t minor;
+	/** Timezone correction */
+	int32_t thiszone;
+	/** Timestamp accuracy */
+	uint32_t sigfigs;
+	/** Snapshot length */
+	uint32_t snaplen;
+	/** Link type */
+	uint32_t network;
+} __attribute__ (( packed ));
+
+/** pcap per-packet record header */
+struct pcap_record_header {
+	/** Timestamp (seconds) */
+	uint32_t ts_sec;
+	/** Timestamp (microseconds) */
+	uint32_t ts_usec;
+	/** Number of bytes of packet data saved */
+	uint32_t incl_len;
+	/** Length of packet on the wire */
+	uint32_t orig_len;
+} __attribute__ (( packed ));
+
+/** pcap content type */
+#define PCAP_MIME_TYPE "application/vnd.tcpdump.pcap"
+
+/**
+ * Record packet in capture ring
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ *
+ * This overrides the weak no-op definition in netdevice.c.
+ */
+void pktcap_record ( struct net_device *netdev __unused,
+		     struct io_buffer *iobuf ) {
+	struct pktcap_packet *pkt;
+	size_t len = iob_len ( iobuf );
+
+	/* Record truncated packet, overwriting the oldest entry */
+	pkt = &pktcap_ring[ pktcap_prod++ % PKTCAP_NUM_PACKETS ];
+	pkt->ticks = currticks();
+	pkt->len = len;
+	pkt->caplen = ( ( len < PKTCAP_SNAP_LEN ) ? len : PKTCAP_SNAP_LEN );
+	memcpy ( pkt->data, iobuf->data, pkt->caplen );
+}
+
+/**
+ * Get total number of captured packets
+ *
+ * @ret count		Number of packets recorded since startup
+ */
+unsigned int pktcap_packets ( void ) {
+
+	return pktcap_prod;
+}
+
+/**
+ * Construct pcap file from capture ring
+ *
+ * @v data		Data buffer to fill in
+ * @ret len		Length of pcap file
+ *
+ * Returns the required buffer length when called with a NULL data
+ * buffer.
+ */
+static size_t pktcap_pcap ( void *data ) {
+	struct pcap_header *header;
+	struct pcap_record_header *record;
+	struct pktcap_packet *pkt;
+	unsigned int count;
+	unsigned int first;
+	unsigned int i;
+	size_t len;
+
+	/* Identify oldest retained packet */
+	count = pktcap_prod;
+	first = 0;
+	if ( count > PKTCAP_NUM_PACKETS ) {
+		first = ( count - PKTCAP_NUM_PACKETS );
+		count = PKTCAP_NUM_PACKETS;
+	}
+
+	/* Construct file header */
+	len = sizeof ( *header );
+	if ( data ) {
+		header = data;
+		memset ( header, 0, sizeof ( *header ) );
+		header->magic = PCAP_MAGIC;
+		header->major = PCAP_VERSION_MAJOR;
+		header->minor = PCAP_VERSION_MINOR;
+		header->snaplen = PKTCAP_SNAP_LEN;
+		header->network = PCAP_NETWORK_ETHERNET;
+	}
+
+	/* Construct packet records, oldest first */
+	for ( i = 0 ; i < count ; i++ ) {
+		pkt = &pktcap_ring[ ( first + i ) % PKTCAP_NUM_PACKETS ];
+		if ( data ) {
+			record = ( data + len );
+			record->ts_sec = ( pkt->ticks / TICKS_PER_SEC );
+			record->ts_usec = ( ( pkt->ticks % TICKS_PER_SEC ) *
+					    1000000UL / TICKS_PER_SEC );
+			record->incl_len = pkt->caplen;
+			record->orig_len = pkt->len;
+			memcpy ( ( ( ( void * ) record ) +
+				   sizeof ( *record ) ),
+				 pkt->data, pkt->caplen );
+		}
+		len += ( sizeof ( *record ) + pkt->caplen );
+	}
+
+	return len;
+}
+
+/** A packet capture upload */
+struct pktcap_upload {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Job control interface */
+	struct interface job;
+	/** Data transfer interface */
+	struct interface xfer;
+};
+
+/**
+ * Terminate upload
+ *
+ * @v upload		Packet capture upload
+ * @v rc		Reason for termination
+ */
+static void pktcap_upload_close ( struct pktcap_upload *upload, int rc ) {
+
+	/* Shut down interfaces */
+	intf_shutdown ( &upload->xfer, rc );
+	intf_shutdown ( &upload->job, rc );
+}
+
+/**
+ * Handle received data (i.e. the HTTP response body)
+ *
+ * @v upload		Packet capture upload
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int pktcap_upload_deliver ( struct pktcap_upload *upload __unused,
+				   struct io_buffer *iobuf,
+				   struct xfer_metadata *meta __unused ) {
+
+	/* Discard response body */
+	free_iob ( iobuf );
+	return 0;
+}
+
+/** Packet capture upload data transfer interface operations */
+static struct interface_operation pktcap_upload_xfer_operations[] = {
+	INTF_OP ( xfer_deliver, struct pktcap_upload *,
+		  pktcap_upload_deliver ),
+	INTF_OP ( intf_close, struct pktcap_upload *, pktcap_upload_close ),
+};
+
+/** Packet capture upload data transfer interface descriptor */
+static struct interface_descriptor pktcap_upload_xfer_desc =
+	INTF_DESC ( struct pktcap_upload, xfer,
+		    pktcap_upload_xfer_operations );
+
+/** Packet capture upload job control interface operations */
+static struct interface_operation pktcap_upload_job_operations[] = {
+	INTF_OP ( intf_close, struct pktcap_upload *, pktcap_upload_close ),
+};
+
+/** Packet capture upload job control interface descriptor */
+static struct interface_descriptor pktcap_upload_job_desc =
+	INTF_DESC ( struct pktcap_upload, job, pktcap_upload_job_operations );
+
+/**
+ * Upload capture ring as a pcap file
+ *
+ * @v job		Job control interface
+ * @v uri		URI to which the capture should be POSTed
+ * @ret rc		Return status code
+ */
+int create_pktcap_upload ( struct interface *job, struct uri *uri ) {
+	struct http_request_content content;
+	struct pktcap_upload *upload;
+	void *data;
+	size_t len;
+	int rc;
+
+	/* Construct pcap file */
+	len = pktcap_pcap ( NULL );
+	data = malloc ( len );
+	if ( ! data ) {
+		rc = -ENOMEM;
+		goto err_alloc_data;
+	}
+	pktcap_pcap ( data );
+
+	/* Allocate and initialise structure */
+	upload = zalloc ( sizeof ( *upload ) );
+	if ( ! upload ) {
+		rc = -ENOMEM;
+		goto err_alloc_upload;
+	}
+	ref_init ( &upload->refcnt, NULL );
+	intf_init ( &upload->job, &pktcap_upload_job_desc, &upload->refcnt );
+	intf_init ( &upload->xfer, &pktcap_upload_xfer_desc,
+		    &upload->refcnt );
+
+	/* Open HTTP POST transaction (which copies the request body) */
+	content.type = PCAP_MIME_TYPE;
+	content.data = data;
+	content.len = len;
+	if ( ( rc = http_open ( &upload->xfer, &http_post, uri, NULL, NULL,
+				&content ) ) != 0 )
+		goto err_open;
+
+	/* Attach to parent interface, mortalise self, and return */
+	intf_plug_plug ( &upload->job, job );
+	ref_put ( &upload->refcnt );
+	free ( data );
+	return 0;
+
+ err_open:
+	ref_put ( &upload->refcnt );
+ err_alloc_upload:
+	free ( data );
+ err_alloc_data:
+	return rc;
+}
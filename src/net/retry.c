@@ -48,8 +48,50 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 #define MIN_TIMEOUT 7
 
-/** List of running timers */
-static LIST_HEAD ( timers );
+/** Timer wheel slot width, as a power of two (in ticks)
+ *
+ * May be overridden at build time.
+ */
+#ifndef RETRY_WHEEL_SHIFT
+#define RETRY_WHEEL_SHIFT 4
+#endif
+
+/** Number of timer wheel buckets (must be a power of two)
+ *
+ * May be overridden at build time.
+ */
+#ifndef RETRY_WHEEL_BUCKETS
+#define RETRY_WHEEL_BUCKETS 64
+#endif
+
+/** Timer wheel bucket mask */
+#define RETRY_WHEEL_MASK ( RETRY_WHEEL_BUCKETS - 1 )
+
+/** Timer wheel of running timers, hashed by expiry time
+ *
+ * Keeping all running timers on a single list makes each poll scan
+ * cost proportional to the total number of running timers, which
+ * becomes noticeable with many concurrent TCP connections.  We
+ * therefore hash each timer into a wheel bucket based on its expiry
+ * time, and scan only the buckets covering the time elapsed since the
+ * previous poll.  Timers expiring more than one wheel revolution in
+ * the future simply remain in their bucket and are re-examined once
+ * per revolution.
+ */
+static struct list_head timers[RETRY_WHEEL_BUCKETS];
+
+/** Most recently scanned timer wheel slot */
+static unsigned long retry_slot;
+
+/**
+ * Identify timer wheel bucket for an expiry time
+ *
+ * @v expiry		Expiry time (in ticks)
+ * @ret bucket		Timer wheel bucket
+ */
+static inline struct list_head * retry_bucket ( unsigned long expiry ) {
+	return &timers[ ( expiry >> RETRY_WHEEL_SHIFT ) & RETRY_WHEEL_MASK ];
+}
 
 /**
  * Start timer with a specified timeout
@@ -63,9 +105,12 @@ static LIST_HEAD ( timers );
  */
 void start_timer_fixed ( struct retry_timer *timer, unsigned long timeout ) {
 
-	/* Add to list of running timers (if applicable) */
-	if ( ! timer->running ) {
-		list_add ( &timer->list, &timers );
+	/* Remove from timer wheel (if applicable), since the new
+	 * expiry time may hash to a different bucket
+	 */
+	if ( timer->running ) {
+		list_del ( &timer->list );
+	} else {
 		ref_get ( timer->refcnt );
 		timer->running = 1;
 	}
@@ -76,6 +121,10 @@ void start_timer_fixed ( struct retry_timer *timer, unsigned long timeout ) {
 	/* Record timeout */
 	timer->timeout = timeout;
 
+	/* Add to timer wheel bucket corresponding to the expiry time */
+	list_add ( &timer->list,
+		   retry_bucket ( timer->start + timer->timeout ) );
+
 	DBGC2 ( timer, "Timer %p started at time %ld (expires at %ld)\n",
 		timer, timer->start, ( timer->start + timer->timeout ) );
 }
@@ -191,30 +240,45 @@ static void timer_expired ( struct retry_timer *timer ) {
 }
 
 /**
- * Poll the retry timer list
+ * Poll the timer wheel
  *
  */
 void retry_poll ( void ) {
 	struct retry_timer *timer;
+	struct list_head *bucket;
 	unsigned long now = currticks();
+	unsigned long slot = ( now >> RETRY_WHEEL_SHIFT );
+	unsigned long behind = ( slot - retry_slot );
 	unsigned long used;
 
-	/* Process at most one timer expiry.  We cannot process
+	/* Never scan more than one complete wheel revolution */
+	if ( behind > RETRY_WHEEL_MASK )
+		behind = RETRY_WHEEL_MASK;
+
+	/* Scan every slot between the previously scanned slot and the
+	 * current time, including rescanning the current slot itself
+	 * (to catch timers started with very short timeouts).
+	 *
+	 * Process at most one timer expiry.  We cannot process
 	 * multiple expiries in one pass, because one timer expiring
 	 * may end up triggering another timer's deletion from the
-	 * list.
+	 * wheel.
 	 */
-	list_for_each_entry ( timer, &timers, list ) {
-		used = ( now - timer->start );
-		if ( used >= timer->timeout ) {
-			timer_expired ( timer );
-			break;
+	do {
+		retry_slot = ( slot - behind );
+		bucket = &timers[ retry_slot & RETRY_WHEEL_MASK ];
+		list_for_each_entry ( timer, bucket, list ) {
+			used = ( now - timer->start );
+			if ( used >= timer->timeout ) {
+				timer_expired ( timer );
+				return;
+			}
 		}
-	}
+	} while ( behind-- );
 }
 
 /**
- * Single-step the retry timer list
+ * Single-step the timer wheel
  *
  * @v process		Retry timer process
  */
@@ -223,4 +287,20 @@ static void retry_step ( struct process *process __unused ) {
 }
 
 /** Retry timer process */
-PERMANENT_PROCESS ( retry_process, retry_step );
+PERMANENT_PROCESS_SLOW ( retry_process, retry_step );
+
+/**
+ * Initialise the timer wheel
+ *
+ */
+static void init_timers ( void ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < RETRY_WHEEL_BUCKETS ; i++ )
+		INIT_LIST_HEAD ( &timers[i] );
+}
+
+/** Timer wheel initialiser */
+struct init_fn retry_init_fn __init_fn ( INIT_EARLY ) = {
+	.initialise = init_timers,
+};
@@ -829,25 +829,56 @@ static void rndis_rx_message ( struct rndis_device *rndis,
 void rndis_rx ( struct rndis_device *rndis, struct io_buffer *iobuf ) {
 	struct net_device *netdev = rndis->netdev;
 	struct rndis_header *header;
+	struct io_buffer *msg;
 	unsigned int type;
+	size_t len;
 	int rc;
 
-	/* Sanity check */
-	if ( iob_len ( iobuf ) < sizeof ( *header ) ) {
-		DBGC ( rndis, "RNDIS %s received underlength packet:\n",
-		       rndis->name );
-		DBGC_HDA ( rndis, 0, iobuf->data, iob_len ( iobuf ) );
-		rc = -EINVAL;
-		goto drop;
-	}
-	header = iobuf->data;
+	/* The device may aggregate multiple concatenated messages
+	 * into a single transfer; process each message in turn.
+	 */
+	while ( iobuf ) {
 
-	/* Parse and strip header */
-	type = le32_to_cpu ( header->type );
-	iob_pull ( iobuf, sizeof ( *header ) );
+		/* Sanity check */
+		if ( iob_len ( iobuf ) < sizeof ( *header ) ) {
+			DBGC ( rndis, "RNDIS %s received underlength packet:\n",
+			       rndis->name );
+			DBGC_HDA ( rndis, 0, iobuf->data, iob_len ( iobuf ) );
+			rc = -EINVAL;
+			goto drop;
+		}
+		header = iobuf->data;
+
+		/* Parse and check header */
+		type = le32_to_cpu ( header->type );
+		len = le32_to_cpu ( header->len );
+		if ( ( len < sizeof ( *header ) ) ||
+		     ( len > iob_len ( iobuf ) ) ) {
+			DBGC ( rndis, "RNDIS %s received malformed message "
+			       "length:\n", rndis->name );
+			DBGC_HDA ( rndis, 0, iobuf->data, iob_len ( iobuf ) );
+			rc = -EINVAL;
+			goto drop;
+		}
 
-	/* Handle message */
-	rndis_rx_message ( rndis, iob_disown ( iobuf ), type );
+		/* Split off this message, if it is not the last (or
+		 * only) message in the buffer.  The split buffers
+		 * share the underlying payload, so no data is copied.
+		 */
+		if ( len < iob_len ( iobuf ) ) {
+			msg = iob_split ( iobuf, len );
+			if ( ! msg ) {
+				rc = -ENOMEM;
+				goto drop;
+			}
+		} else {
+			msg = iob_disown ( iobuf );
+		}
+
+		/* Strip header and handle message */
+		iob_pull ( msg, sizeof ( *header ) );
+		rndis_rx_message ( rndis, iob_disown ( msg ), type );
+	}
 
 	return;
 
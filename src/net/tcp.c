@@ -7,6 +7,7 @@
 #include <ipxe/timer.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/malloc.h>
+#include <ipxe/objpool.h>
 #include <ipxe/init.h>
 #include <ipxe/retry.h>
 #include <ipxe/refcnt.h>
@@ -16,6 +17,7 @@
 #include <ipxe/uri.h>
 #include <ipxe/netdevice.h>
 #include <ipxe/profile.h>
+#include <ipxe/leakstat.h>
 #include <ipxe/process.h>
 #include <ipxe/job.h>
 #include <ipxe/tcpip.h>
@@ -102,22 +104,34 @@ struct tcp_connection {
 	 * Equivalent to Rcv.Wind.Scale in RFC 1323 terminology
 	 */
 	uint8_t rcv_win_scale;
+	/** Window scale advertised in our SYN */
+	uint8_t adv_win_scale;
 
 	/** Selective acknowledgement list (in host-endian order) */
 	struct tcp_sack_block sack[TCP_SACK_MAX];
 
 	/** Transmit queue */
 	struct list_head tx_queue;
+	/** Total length of transmit queue contents */
+	size_t tx_len;
 	/** Receive queue */
 	struct list_head rx_queue;
 	/** Transmission process */
 	struct process process;
 	/** Retransmission timer */
 	struct retry_timer timer;
+	/** Transmit pacing timer */
+	struct retry_timer pace;
+	/** Delayed acknowledgement timer */
+	struct retry_timer delack;
+	/** Number of segments received since last acknowledgement */
+	unsigned int ack_defer;
 	/** Keepalive timer */
 	struct retry_timer keepalive;
 	/** Shutdown (TIME_WAIT) timer */
 	struct retry_timer wait;
+	/** Number of retransmissions */
+	unsigned int retransmits;
 
 	/** Pending operations for SYN and FIN */
 	struct pending_operation pending_flags;
@@ -167,19 +181,54 @@ struct tcp_rx_queued_header {
  */
 static LIST_HEAD ( tcp_conns );
 
+/** Pool of freed TCP connections awaiting reuse */
+static struct objpool tcp_pool = OBJPOOL_INIT ( tcp_pool, 8 );
+
+/** A cached per-destination retransmission timeout */
+struct tcp_rtt_cache_entry {
+	/** Destination address (with port zeroed) */
+	struct sockaddr_tcpip peer;
+	/** Learned retransmission timeout (in ticks), or zero if unused */
+	unsigned long timeout;
+};
+
+/** Number of cached per-destination retransmission timeouts */
+#define TCP_RTT_CACHE_SIZE 4
+
+/** Per-destination retransmission timeout cache
+ *
+ * A new connection normally starts from the default retransmission
+ * timeout and has to relearn the path's round-trip time from scratch.
+ * Remember the smoothed timeout from previous connections, keyed by
+ * destination host, so that subsequent connections to the same server
+ * (e.g. successive HTTP requests) start from a realistic estimate.
+ */
+static struct tcp_rtt_cache_entry tcp_rtt_cache[TCP_RTT_CACHE_SIZE];
+
+/** Next per-destination cache entry to evict */
+static unsigned int tcp_rtt_cache_evict;
+
+/** Activity statistics */
+struct tcp_stats tcp_stats;
+
+/** Connection leak tracker */
+static struct leak_tracker tcp_leaks __leak_tracker = { .name = "tcp" };
+
 /** Transmit profiler */
-static struct profiler tcp_tx_profiler __profiler = { .name = "tcp.tx" };
+static struct profiler tcp_tx_profiler __profiler_lite = { .name = "tcp.tx" };
 
 /** Receive profiler */
-static struct profiler tcp_rx_profiler __profiler = { .name = "tcp.rx" };
+static struct profiler tcp_rx_profiler __profiler_lite = { .name = "tcp.rx" };
 
 /** Data transfer profiler */
-static struct profiler tcp_xfer_profiler __profiler = { .name = "tcp.xfer" };
+static struct profiler tcp_xfer_profiler __profiler_lite = { .name = "tcp.xfer" };
 
 /* Forward declarations */
 static struct process_descriptor tcp_process_desc;
 static struct interface_descriptor tcp_xfer_desc;
 static void tcp_expired ( struct retry_timer *timer, int over );
+static void tcp_pace_expired ( struct retry_timer *timer, int over );
+static void tcp_delack_expired ( struct retry_timer *timer, int over );
 static void tcp_keepalive_expired ( struct retry_timer *timer, int over );
 static void tcp_wait_expired ( struct retry_timer *timer, int over );
 static struct tcp_connection * tcp_demux ( unsigned int local_port );
@@ -262,6 +311,101 @@ static int tcp_port_available ( int port ) {
 	return ( tcp_demux ( port ) ? -EADDRINUSE : port );
 }
 
+/**
+ * Find per-destination retransmission timeout cache entry
+ *
+ * @v peer		Destination address
+ * @v create		Create a new entry if none exists
+ * @ret entry		Cache entry, or NULL
+ */
+static struct tcp_rtt_cache_entry *
+tcp_rtt_cache_find ( struct sockaddr_tcpip *peer, int create ) {
+	struct tcp_rtt_cache_entry *entry;
+	struct sockaddr_tcpip key;
+	unsigned int i;
+
+	/* Construct key with port number zeroed */
+	memcpy ( &key, peer, sizeof ( key ) );
+	key.st_port = 0;
+
+	/* Find existing entry */
+	for ( i = 0 ; i < TCP_RTT_CACHE_SIZE ; i++ ) {
+		entry = &tcp_rtt_cache[i];
+		if ( entry->timeout &&
+		     ( memcmp ( &entry->peer, &key, sizeof ( key ) ) == 0 ) )
+			return entry;
+	}
+
+	/* Create new entry, if applicable */
+	if ( create ) {
+		entry = &tcp_rtt_cache[tcp_rtt_cache_evict];
+		tcp_rtt_cache_evict = ( ( tcp_rtt_cache_evict + 1 ) %
+					TCP_RTT_CACHE_SIZE );
+		memcpy ( &entry->peer, &key, sizeof ( entry->peer ) );
+		entry->timeout = 0;
+		return entry;
+	}
+
+	return NULL;
+}
+
+/**
+ * Calculate receive window scale to advertise
+ *
+ * @ret scale		Window scale
+ *
+ * The window scale is fixed at connection setup, before any
+ * bandwidth-delay product can be measured.  The best available
+ * estimate of a useful bound is the largest window that we could ever
+ * advertise, which is limited by the free memory available for
+ * buffering (as used when expanding the receive window) and by the
+ * bandwidth-delay product implied by the negotiated link speed (where
+ * known).  Advertising the smallest scale that can represent this
+ * limit keeps window advertisements fine-grained on
+ * memory-constrained machines and on management-speed links.
+ */
+static unsigned int tcp_adv_win_scale ( void ) {
+	unsigned int speed;
+	size_t limit;
+	size_t bdp;
+	unsigned int scale;
+
+	/* Limit by free memory */
+	limit = ( freemem >> TCP_RX_WINDOW_MEM_SHIFT );
+
+	/* Limit by the link's bandwidth-delay product, if the link
+	 * speed is known: a 100Mbps management port gains nothing
+	 * from a multi-megabyte window.
+	 */
+	speed = netdev_max_link_speed();
+	if ( speed ) {
+		bdp = ( ( ( size_t ) speed ) * TCP_RX_WINDOW_SPEED_FACTOR );
+		if ( limit > bdp )
+			limit = bdp;
+	}
+
+	if ( limit < TCP_MAX_WINDOW_SIZE )
+		limit = TCP_MAX_WINDOW_SIZE;
+	for ( scale = 0 ; scale < TCP_RX_WINDOW_SCALE ; scale++ ) {
+		if ( ( ( ( size_t ) 0xffff ) << scale ) >= limit )
+			break;
+	}
+	return scale;
+}
+
+/**
+ * Free TCP connection
+ *
+ * @v refcnt		Reference count
+ */
+static void tcp_free ( struct refcnt *refcnt ) {
+	struct tcp_connection *tcp =
+		container_of ( refcnt, struct tcp_connection, refcnt );
+
+	leak_free ( &tcp_leaks );
+	objpool_free ( &tcp_pool, tcp, sizeof ( *tcp ) );
+}
+
 /**
  * Open a TCP connection
  *
@@ -275,29 +419,42 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 	struct sockaddr_tcpip *st_peer = ( struct sockaddr_tcpip * ) peer;
 	struct sockaddr_tcpip *st_local = ( struct sockaddr_tcpip * ) local;
 	struct tcp_connection *tcp;
+	struct tcp_rtt_cache_entry *entry;
 	size_t mtu;
 	int port;
 	int rc;
 
 	/* Allocate and initialise structure */
-	tcp = zalloc ( sizeof ( *tcp ) );
+	tcp = objpool_alloc ( &tcp_pool, sizeof ( *tcp ) );
 	if ( ! tcp )
 		return -ENOMEM;
+	leak_alloc ( &tcp_leaks );
 	DBGC ( tcp, "TCP %p allocated\n", tcp );
-	ref_init ( &tcp->refcnt, NULL );
+	ref_init ( &tcp->refcnt, tcp_free );
 	intf_init ( &tcp->xfer, &tcp_xfer_desc, &tcp->refcnt );
 	process_init_stopped ( &tcp->process, &tcp_process_desc, &tcp->refcnt );
 	timer_init ( &tcp->timer, tcp_expired, &tcp->refcnt );
+	timer_init ( &tcp->pace, tcp_pace_expired, &tcp->refcnt );
+	timer_init ( &tcp->delack, tcp_delack_expired, &tcp->refcnt );
 	timer_init ( &tcp->keepalive, tcp_keepalive_expired, &tcp->refcnt );
 	timer_init ( &tcp->wait, tcp_wait_expired, &tcp->refcnt );
 	tcp->prev_tcp_state = TCP_CLOSED;
 	tcp->tcp_state = TCP_STATE_SENT ( TCP_SYN );
 	tcp_dump_state ( tcp );
 	tcp->snd_seq = random();
+	tcp->adv_win_scale = tcp_adv_win_scale();
 	INIT_LIST_HEAD ( &tcp->tx_queue );
 	INIT_LIST_HEAD ( &tcp->rx_queue );
 	memcpy ( &tcp->peer, st_peer, sizeof ( tcp->peer ) );
 
+	/* Start from any previously learned retransmission timeout */
+	entry = tcp_rtt_cache_find ( &tcp->peer, 0 );
+	if ( entry ) {
+		tcp->timer.timeout = entry->timeout;
+		DBGC ( tcp, "TCP %p reusing cached timeout %ld\n",
+		       tcp, entry->timeout );
+	}
+
 	/* Calculate MSS */
 	mtu = tcpip_mtu ( &tcp->peer );
 	if ( ! mtu ) {
@@ -349,6 +506,7 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 	struct io_buffer *iobuf;
 	struct io_buffer *tmp;
+	struct tcp_rtt_cache_entry *entry;
 
 	/* Close data transfer interface */
 	intf_shutdown ( &tcp->xfer, rc );
@@ -376,15 +534,26 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 			free_iob ( iobuf );
 			pending_put ( &tcp->pending_data );
 		}
+		tcp->tx_len = 0;
 		assert ( ! is_pending ( &tcp->pending_data ) );
 
 		/* Remove pending operations for SYN and FIN, if applicable */
 		pending_put ( &tcp->pending_flags );
 		pending_put ( &tcp->pending_flags );
 
+		/* Cache any learned retransmission timeout for reuse
+		 * by future connections to the same peer.
+		 */
+		if ( tcp->timer.timeout ) {
+			entry = tcp_rtt_cache_find ( &tcp->peer, 1 );
+			entry->timeout = tcp->timer.timeout;
+		}
+
 		/* Remove from list and drop reference */
 		process_del ( &tcp->process );
 		stop_timer ( &tcp->timer );
+		stop_timer ( &tcp->pace );
+		stop_timer ( &tcp->delack );
 		stop_timer ( &tcp->keepalive );
 		stop_timer ( &tcp->wait );
 		list_del ( &tcp->list );
@@ -427,7 +596,7 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
  * Calculate transmission window
  *
  * @v tcp		TCP connection
- * @ret len		Maximum length that can be sent in a single packet
+ * @ret len		Maximum amount of data that may be in flight
  */
 static size_t tcp_xmit_win ( struct tcp_connection *tcp ) {
 	size_t len;
@@ -436,10 +605,12 @@ static size_t tcp_xmit_win ( struct tcp_connection *tcp ) {
 	if ( ! TCP_CAN_SEND_DATA ( tcp->tcp_state ) )
 		return 0;
 
-	/* Length is the minimum of the receiver's window and the path MTU */
+	/* Length is the minimum of the receiver's window and our
+	 * self-imposed limit on in-flight data.
+	 */
 	len = tcp->snd_win;
-	if ( len > TCP_PATH_MTU )
-		len = TCP_PATH_MTU;
+	if ( len > TCP_MAX_FLIGHT )
+		len = TCP_MAX_FLIGHT;
 
 	return len;
 }
@@ -555,33 +726,46 @@ static unsigned int tcp_sack ( struct tcp_connection *tcp, uint32_t seq ) {
  * Process TCP transmit queue
  *
  * @v tcp		TCP connection
+ * @v offset		Offset within queue at which to start
  * @v max_len		Maximum length to process
  * @v dest		I/O buffer to fill with data, or NULL
  * @v remove		Remove data from queue
  * @ret len		Length of data processed
  *
  * This processes at most @c max_len bytes from the TCP connection's
- * transmit queue.  Data will be copied into the @c dest I/O buffer
- * (if provided) and, if @c remove is true, removed from the transmit
- * queue.
+ * transmit queue, starting @c offset bytes into the queue.  Data will
+ * be copied into the @c dest I/O buffer (if provided) and, if @c
+ * remove is true, removed from the transmit queue.
  */
-static size_t tcp_process_tx_queue ( struct tcp_connection *tcp, size_t max_len,
-				     struct io_buffer *dest, int remove ) {
+static size_t tcp_process_tx_queue ( struct tcp_connection *tcp, size_t offset,
+				     size_t max_len, struct io_buffer *dest,
+				     int remove ) {
 	struct io_buffer *iobuf;
 	struct io_buffer *tmp;
+	void *data;
 	size_t frag_len;
 	size_t len = 0;
 
+	/* Removal is always performed from the start of the queue */
+	assert ( ( offset == 0 ) || ( ! remove ) );
+
 	list_for_each_entry_safe ( iobuf, tmp, &tcp->tx_queue, list ) {
+		data = iobuf->data;
 		frag_len = iob_len ( iobuf );
+		if ( offset >= frag_len ) {
+			offset -= frag_len;
+			continue;
+		}
+		data += offset;
+		frag_len -= offset;
+		offset = 0;
 		if ( frag_len > max_len )
 			frag_len = max_len;
-		if ( dest ) {
-			memcpy ( iob_put ( dest, frag_len ), iobuf->data,
-				 frag_len );
-		}
+		if ( dest )
+			memcpy ( iob_put ( dest, frag_len ), data, frag_len );
 		if ( remove ) {
 			iob_pull ( iobuf, frag_len );
+			tcp->tx_len -= frag_len;
 			if ( ! iob_len ( iobuf ) ) {
 				list_del ( &iobuf->list );
 				free_iob ( iobuf );
@@ -620,25 +804,34 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 	unsigned int sack_count;
 	unsigned int i;
 	size_t len = 0;
+	size_t win = 0;
 	size_t sack_len;
+	uint32_t seq;
 	uint32_t seq_len;
 	uint32_t max_rcv_win;
+	uint32_t max_heap_win;
 	uint32_t max_representable_win;
+	unsigned long interval;
 	int rc;
 
 	/* Start profiling */
-	profile_start ( &tcp_tx_profiler );
-
-	/* If retransmission timer is already running, do nothing */
-	if ( timer_running ( &tcp->timer ) )
-		return;
+	profile_start_lite ( &tcp_tx_profiler );
 
 	/* Calculate both the actual (payload) and sequence space
-	 * lengths that we wish to transmit.
+	 * lengths that we wish to transmit.  Data is transmitted one
+	 * path-MTU-sized segment at a time, starting after any data
+	 * already in flight.
 	 */
 	if ( TCP_CAN_SEND_DATA ( tcp->tcp_state ) ) {
-		len = tcp_process_tx_queue ( tcp, tcp_xmit_win ( tcp ),
-					     NULL, 0 );
+		win = tcp_xmit_win ( tcp );
+		if ( ( tcp->tx_len > tcp->snd_sent ) &&
+		     ( win > tcp->snd_sent ) ) {
+			len = ( tcp->tx_len - tcp->snd_sent );
+			if ( len > ( win - tcp->snd_sent ) )
+				len = ( win - tcp->snd_sent );
+			if ( len > TCP_PATH_MTU )
+				len = TCP_PATH_MTU;
+		}
 	}
 	seq_len = len;
 	flags = TCP_FLAGS_SENDING ( tcp->tcp_state );
@@ -647,37 +840,58 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 		assert ( ! ( ( flags & TCP_SYN ) && ( flags & TCP_FIN ) ) );
 		seq_len++;
 	}
-	tcp->snd_sent = seq_len;
+
+	/* If the retransmission timer is already running, transmit
+	 * only a further data segment within the window, and only
+	 * once the pacing interval has elapsed.
+	 */
+	if ( timer_running ( &tcp->timer ) &&
+	     ( ( len == 0 ) || timer_running ( &tcp->pace ) ||
+	       ( flags & ( TCP_SYN | TCP_FIN ) ) ) )
+		return;
+
+	/* Record starting sequence number and consumed sequence space */
+	seq = ( tcp->snd_seq + tcp->snd_sent );
+	tcp->snd_sent += seq_len;
 
 	/* If we have nothing to transmit, stop now */
 	if ( ( seq_len == 0 ) && ! ( tcp->flags & TCP_ACK_PENDING ) )
 		return;
 
-	/* If we are transmitting anything that requires
-	 * acknowledgement (i.e. consumes sequence space), start the
-	 * retransmission timer.  Do this before attempting to
-	 * allocate the I/O buffer, in case allocation itself fails.
+	/* If anything requiring acknowledgement (i.e. consuming
+	 * sequence space) is in flight, (re)start the retransmission
+	 * timer.  Do this before attempting to allocate the I/O
+	 * buffer, in case allocation itself fails.
 	 */
-	if ( seq_len )
+	if ( tcp->snd_sent )
 		start_timer ( &tcp->timer );
 
 	/* Allocate I/O buffer */
-	iobuf = alloc_iob ( len + TCP_MAX_HEADER_LEN );
+	iobuf = alloc_iob_headroom ( len, TCP_MAX_HEADER_LEN );
 	if ( ! iobuf ) {
 		DBGC ( tcp, "TCP %p could not allocate iobuf for %08x..%08x "
-		       "%08x\n", tcp, tcp->snd_seq, ( tcp->snd_seq + seq_len ),
-		       tcp->rcv_ack );
+		       "%08x\n", tcp, seq, ( seq + seq_len ), tcp->rcv_ack );
 		return;
 	}
-	iob_reserve ( iobuf, TCP_MAX_HEADER_LEN );
 
-	/* Fill data payload from transmit queue */
-	tcp_process_tx_queue ( tcp, len, iobuf, 0 );
-
-	/* Expand receive window if possible */
+	/* Fill data payload from transmit queue, skipping any data
+	 * already in flight.
+	 */
+	tcp_process_tx_queue ( tcp, ( seq - tcp->snd_seq ), len, iobuf, 0 );
+
+	/* Expand receive window if possible.  The base limit of
+	 * TCP_MAX_WINDOW_SIZE applies only when heap memory is scarce;
+	 * when free memory allows us to buffer a larger worst-case
+	 * retransmission, advertise a correspondingly larger window so
+	 * that high bandwidth-delay-product paths are not throttled by
+	 * the advertisement.
+	 */
 	max_rcv_win = xfer_window ( &tcp->xfer );
-	if ( max_rcv_win > TCP_MAX_WINDOW_SIZE )
-		max_rcv_win = TCP_MAX_WINDOW_SIZE;
+	max_heap_win = ( freemem >> TCP_RX_WINDOW_MEM_SHIFT );
+	if ( max_heap_win < TCP_MAX_WINDOW_SIZE )
+		max_heap_win = TCP_MAX_WINDOW_SIZE;
+	if ( max_rcv_win > max_heap_win )
+		max_rcv_win = max_heap_win;
 	max_representable_win = ( 0xffff << tcp->rcv_win_scale );
 	if ( max_rcv_win > max_representable_win )
 		max_rcv_win = max_representable_win;
@@ -696,7 +910,7 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 		wsopt->nop = TCP_OPTION_NOP;
 		wsopt->wsopt.kind = TCP_OPTION_WS;
 		wsopt->wsopt.length = sizeof ( wsopt->wsopt );
-		wsopt->wsopt.scale = TCP_RX_WINDOW_SCALE;
+		wsopt->wsopt.scale = tcp->adv_win_scale;
 		spopt = iob_push ( iobuf, sizeof ( *spopt ) );
 		memset ( spopt->nop, TCP_OPTION_NOP, sizeof ( spopt->nop ) );
 		spopt->spopt.kind = TCP_OPTION_SACK_PERMITTED;
@@ -713,6 +927,7 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 	if ( ( tcp->flags & TCP_SACK_ENABLED ) &&
 	     ( ! list_empty ( &tcp->rx_queue ) ) &&
 	     ( ( sack_count = tcp_sack ( tcp, sack_seq ) ) != 0 ) ) {
+		tcp_stats.sacks += sack_count;
 		sack_len = ( sack_count * sizeof ( *sack ) );
 		sackopt = iob_push ( iobuf, ( sizeof ( *sackopt ) + sack_len ));
 		memset ( sackopt->nop, TCP_OPTION_NOP, sizeof ( sackopt->nop ));
@@ -731,7 +946,7 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 	memset ( tcphdr, 0, sizeof ( *tcphdr ) );
 	tcphdr->src = htons ( tcp->local_port );
 	tcphdr->dest = tcp->peer.st_port;
-	tcphdr->seq = htonl ( tcp->snd_seq );
+	tcphdr->seq = htonl ( seq );
 	tcphdr->ack = htonl ( tcp->rcv_ack );
 	tcphdr->hlen = ( ( payload - iobuf->data ) << 2 );
 	tcphdr->flags = flags;
@@ -750,15 +965,30 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 	if ( ( rc = tcpip_tx ( iobuf, &tcp_protocol, NULL, &tcp->peer, NULL,
 			       &tcphdr->csum ) ) != 0 ) {
 		DBGC ( tcp, "TCP %p could not transmit %08x..%08x %08x: %s\n",
-		       tcp, tcp->snd_seq, ( tcp->snd_seq + tcp->snd_sent ),
-		       tcp->rcv_ack, strerror ( rc ) );
+		       tcp, seq, ( seq + seq_len ), tcp->rcv_ack,
+		       strerror ( rc ) );
 		return;
 	}
 
-	/* Clear ACK-pending flag */
+	/* Clear ACK-pending flag and reset acknowledgement coalescing */
 	tcp->flags &= ~TCP_ACK_PENDING;
+	tcp->ack_defer = 0;
+	stop_timer ( &tcp->delack );
+
+	/* Pace out any further segments permitted by the window,
+	 * rather than dumping the entire window onto the wire in a
+	 * single back-to-back burst.  The smoothed retransmission
+	 * timeout is our closest available estimate of the round-trip
+	 * time over which the window should be spread.
+	 */
+	if ( len && ( tcp->tx_len > tcp->snd_sent ) &&
+	     ( win > tcp->snd_sent ) ) {
+		interval = ( tcp->timer.timeout /
+			     ( ( win / TCP_PATH_MTU ) + 1 ) );
+		start_timer_fixed ( &tcp->pace, interval );
+	}
 
-	profile_stop ( &tcp_tx_profiler );
+	profile_stop_lite ( &tcp_tx_profiler );
 }
 
 /**
@@ -805,11 +1035,51 @@ static void tcp_expired ( struct retry_timer *timer, int over ) {
 		tcp_dump_state ( tcp );
 		tcp_close ( tcp, -ETIMEDOUT );
 	} else {
-		/* Otherwise, retransmit the packet */
+		/* Otherwise, retransmit the packet.  We do not retain
+		 * copies of individual transmitted segments, so
+		 * retransmission restarts from the first
+		 * unacknowledged sequence number (i.e. go-back-N).
+		 */
+		tcp_stats.retransmits++;
+		tcp->retransmits++;
+		tcp->snd_sent = 0;
 		tcp_xmit ( tcp );
 	}
 }
 
+/**
+ * Transmit pacing timer expired
+ *
+ * @v timer		Transmit pacing timer
+ * @v over		Failure indicator
+ */
+static void tcp_pace_expired ( struct retry_timer *timer,
+			       int over __unused ) {
+	struct tcp_connection *tcp =
+		container_of ( timer, struct tcp_connection, pace );
+
+	/* Transmit the next paced segment, if applicable */
+	tcp_xmit ( tcp );
+}
+
+/**
+ * Delayed acknowledgement timer expired
+ *
+ * @v timer		Delayed acknowledgement timer
+ * @v over		Failure indicator
+ */
+static void tcp_delack_expired ( struct retry_timer *timer,
+				 int over __unused ) {
+	struct tcp_connection *tcp =
+		container_of ( timer, struct tcp_connection, delack );
+
+	/* Transmit the deferred acknowledgement (the ACK-pending flag
+	 * is still set, since nothing has been transmitted since the
+	 * acknowledgement was deferred).
+	 */
+	tcp_xmit ( tcp );
+}
+
 /**
  * Keepalive timer expired
  *
@@ -871,14 +1141,13 @@ static int tcp_xmit_reset ( struct tcp_connection *tcp,
 	int rc;
 
 	/* Allocate space for dataless TX buffer */
-	iobuf = alloc_iob ( TCP_MAX_HEADER_LEN );
+	iobuf = alloc_iob_headroom ( 0, TCP_MAX_HEADER_LEN );
 	if ( ! iobuf ) {
 		DBGC ( tcp, "TCP %p could not allocate iobuf for RST "
 		       "%08x..%08x %08x\n", tcp, ntohl ( in_tcphdr->ack ),
 		       ntohl ( in_tcphdr->ack ), ntohl ( in_tcphdr->seq ) );
 		return -ENOMEM;
 	}
-	iob_reserve ( iobuf, TCP_MAX_HEADER_LEN );
 
 	/* Construct RST response */
 	tcphdr = iob_push ( iobuf, sizeof ( *tcphdr ) );
@@ -1080,7 +1349,7 @@ static int tcp_rx_syn ( struct tcp_connection *tcp, uint32_t seq,
 			tcp->flags |= TCP_SACK_ENABLED;
 		if ( options->wsopt ) {
 			tcp->snd_win_scale = options->wsopt->scale;
-			tcp->rcv_win_scale = TCP_RX_WINDOW_SCALE;
+			tcp->rcv_win_scale = tcp->adv_win_scale;
 		}
 		DBGC ( tcp, "TCP %p using %stimestamps, %sSACK, TX window "
 		       "x%d, RX window x%d\n", tcp,
@@ -1167,11 +1436,15 @@ static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 
 	/* Update SEQ and sent counters */
 	tcp->snd_seq = ack;
-	tcp->snd_sent = 0;
+	tcp->snd_sent -= ack_len;
 
 	/* Remove any acknowledged data from transmit queue */
-	tcp_process_tx_queue ( tcp, len, NULL, 1 );
-		
+	tcp_process_tx_queue ( tcp, 0, len, NULL, 1 );
+
+	/* Restart the retransmission timer if data remains in flight */
+	if ( tcp->snd_sent )
+		start_timer ( &tcp->timer );
+
 	/* Mark SYN/FIN as acknowledged if applicable. */
 	if ( acked_flags )
 		tcp->tcp_state |= TCP_STATE_ACKED ( acked_flags );
@@ -1217,13 +1490,13 @@ static int tcp_rx_data ( struct tcp_connection *tcp, uint32_t seq,
 	tcp_rx_seq ( tcp, len );
 
 	/* Deliver data to application */
-	profile_start ( &tcp_xfer_profiler );
+	profile_start_lite ( &tcp_xfer_profiler );
 	if ( ( rc = xfer_deliver_iob ( &tcp->xfer, iobuf ) ) != 0 ) {
 		DBGC ( tcp, "TCP %p could not deliver %08x..%08x: %s\n",
 		       tcp, seq, ( seq + len ), strerror ( rc ) );
 		return rc;
 	}
-	profile_stop ( &tcp_xfer_profiler );
+	profile_stop_lite ( &tcp_xfer_profiler );
 
 	return 0;
 }
@@ -1329,13 +1602,19 @@ static void tcp_rx_enqueue ( struct tcp_connection *tcp, uint32_t seq,
 	tcpqhdr->nxt = nxt;
 	tcpqhdr->flags = flags;
 
-	/* Add to RX queue */
-	list_for_each_entry ( queued, &tcp->rx_queue, list ) {
+	/* Add to RX queue, keeping the queue sorted by SEQ.  Segments
+	 * generally continue to arrive in ascending sequence order
+	 * even after a loss has opened a hole, so search backwards
+	 * from the tail of the queue: the common case then terminates
+	 * on the first comparison, rather than walking a potentially
+	 * long reorder queue from the head for every arrival.
+	 */
+	list_for_each_entry_reverse ( queued, &tcp->rx_queue, list ) {
 		tcpqhdr = queued->data;
-		if ( tcp_cmp ( seq, tcpqhdr->seq ) < 0 )
+		if ( tcp_cmp ( seq, tcpqhdr->seq ) >= 0 )
 			break;
 	}
-	list_add_tail ( &iobuf->list, &queued->list );
+	list_add ( &iobuf->list, &queued->list );
 }
 
 /**
@@ -1413,7 +1692,7 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	int rc;
 
 	/* Start profiling */
-	profile_start ( &tcp_rx_profiler );
+	profile_start_lite ( &tcp_rx_profiler );
 
 	/* Sanity check packet */
 	if ( iob_len ( iobuf ) < sizeof ( *tcphdr ) ) {
@@ -1435,13 +1714,15 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		rc = -EINVAL;
 		goto discard;
 	}
-	csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data,
-				       iob_len ( iobuf ) );
-	if ( csum != 0 ) {
-		DBG ( "TCP checksum incorrect (is %04x including checksum "
-		      "field, should be 0000)\n", csum );
-		rc = -EINVAL;
-		goto discard;
+	if ( ! ( iobuf->flags & IOB_FL_HW_CSUM ) ) {
+		csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data,
+					       iob_len ( iobuf ) );
+		if ( csum != 0 ) {
+			DBG ( "TCP checksum incorrect (is %04x including "
+			      "checksum field, should be 0000)\n", csum );
+			rc = -EINVAL;
+			goto discard;
+		}
 	}
 	
 	/* Parse parameters from header and strip header */
@@ -1515,12 +1796,23 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	/* Schedule transmission of ACK (and any pending data).  If we
 	 * have received any out-of-order packets (i.e. if the receive
 	 * queue remains non-empty after processing) then send the ACK
-	 * immediately in order to trigger Fast Retransmission.
+	 * immediately in order to trigger Fast Retransmission.  A
+	 * pure acknowledgement for in-order data on an established
+	 * connection is coalesced: it is deferred until either
+	 * TCP_ACK_COALESCE_COUNT further segments have arrived or the
+	 * delayed acknowledgement timer fires.
 	 */
-	if ( list_empty ( &tcp->rx_queue ) ) {
-		process_add ( &tcp->process );
-	} else {
+	if ( ! list_empty ( &tcp->rx_queue ) ) {
 		tcp_xmit_sack ( tcp, seq );
+	} else if ( ( tcp->tcp_state == TCP_ESTABLISHED ) &&
+		    ( tcp->flags & TCP_ACK_PENDING ) &&
+		    list_empty ( &tcp->tx_queue ) &&
+		    ( ! TCP_FLAGS_SENDING ( tcp->tcp_state ) ) &&
+		    ( ++tcp->ack_defer < TCP_ACK_COALESCE_COUNT ) ) {
+		if ( ! timer_running ( &tcp->delack ) )
+			start_timer_fixed ( &tcp->delack, TCP_DELACK_DELAY );
+	} else {
+		process_add ( &tcp->process );
 	}
 
 	/* If this packet was the last we expect to receive, set up
@@ -1535,7 +1827,7 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	if ( tcp_xfer_window ( tcp ) != old_xfer_window )
 		xfer_window_changed ( &tcp->xfer );
 
-	profile_stop ( &tcp_rx_profiler );
+	profile_stop_lite ( &tcp_rx_profiler );
 	return 0;
 
  discard:
@@ -1695,6 +1987,7 @@ static int tcp_xfer_deliver ( struct tcp_connection *tcp,
 
 	/* Enqueue packet */
 	list_add_tail ( &iobuf->list, &tcp->tx_queue );
+	tcp->tx_len += iob_len ( iobuf );
 
 	/* Each enqueued packet is a pending operation */
 	pending_get ( &tcp->pending_data );
@@ -1757,6 +2050,55 @@ struct socket_opener tcp_ipv6_socket_opener __socket_opener = {
 	.open		= tcp_open,
 };
 
+/**
+ * Display state of a single TCP connection
+ *
+ * @v tcp		TCP connection
+ */
+static void tcp_conn_stat ( struct tcp_connection *tcp ) {
+	struct tcp_sack_block *sack;
+	unsigned int sacks = 0;
+	unsigned int i;
+
+	/* Count outstanding SACK blocks */
+	for ( i = 0 ; i < TCP_SACK_MAX ; i++ ) {
+		sack = &tcp->sack[i];
+		if ( sack->left != sack->right )
+			sacks++;
+	}
+
+	/* Display connection state */
+	printf ( "TCP %d->%s:%d %s\n", tcp->local_port,
+		 sock_ntoa ( ( struct sockaddr * ) &tcp->peer ),
+		 ntohs ( tcp->peer.st_port ), tcp_state ( tcp->tcp_state ) );
+	printf ( "  [SND: seq %08x, unacked %d, win %d (scale %d), "
+		 "queued %zd]\n", tcp->snd_seq, tcp->snd_sent, tcp->snd_win,
+		 tcp->snd_win_scale, tcp->tx_len );
+	printf ( "  [RCV: ack %08x, win %d (scale %d), SACK blocks %d]\n",
+		 tcp->rcv_ack, tcp->rcv_win, tcp->rcv_win_scale, sacks );
+	printf ( "  [RTO: %ld.%03lds%s, retries %d, retransmits %d]\n",
+		 ( tcp->timer.timeout / TICKS_PER_SEC ),
+		 ( ( tcp->timer.timeout % TICKS_PER_SEC ) * 1000 /
+		   TICKS_PER_SEC ),
+		 ( tcp->timer.running ? " (running)" : "" ),
+		 tcp->timer.count, tcp->retransmits );
+}
+
+/**
+ * Display state of all TCP connections
+ *
+ * The retransmission timer's current timeout provides the closest
+ * available equivalent to an RTT estimate, since it adapts towards
+ * the observed round-trip time while the connection is making
+ * progress.
+ */
+void tcpstat ( void ) {
+	struct tcp_connection *tcp;
+
+	list_for_each_entry ( tcp, &tcp_conns, list )
+		tcp_conn_stat ( tcp );
+}
+
 /** Linkage hack */
 int tcp_sock_stream = TCP_SOCK_STREAM;
 
@@ -56,6 +56,7 @@ enum ftp_state {
 	FTP_TYPE,
 	FTP_SIZE,
 	FTP_PASV,
+	FTP_REST,
 	FTP_RETR,
 	FTP_WAIT,
 	FTP_QUIT,
@@ -81,6 +82,14 @@ struct ftp_request {
 
 	/** Current state */
 	enum ftp_state state;
+	/** Start offset of requested content range */
+	size_t start;
+	/** Length of requested content range (or zero for "to EOF") */
+	size_t len;
+	/** Amount of range data received so far */
+	size_t pos;
+	/** Probe file size only, without transferring data */
+	int probe;
 	/** Buffer to be filled with data received via the control channel */
 	char *recvbuf;
 	/** Remaining size of recvbuf */
@@ -91,6 +100,8 @@ struct ftp_request {
 	char passive_text[24]; /* "aaa,bbb,ccc,ddd,eee,fff" */
 	/** File size, as text */
 	char filesize[20];
+	/** Restart offset, as text */
+	char rest_text[20];
 };
 
 /**
@@ -174,6 +185,16 @@ static const char * ftp_password ( struct ftp_request *ftp ) {
 	return ftp->uri->password ? ftp->uri->password : ftp_default_password;
 }
 
+/**
+ * Retrieve FTP restart offset
+ *
+ * @v ftp		FTP request
+ * @ret offset		FTP restart offset, as text
+ */
+static const char * ftp_rest_offset ( struct ftp_request *ftp ) {
+	return ftp->rest_text;
+}
+
 /** FTP control channel strings */
 static struct ftp_control_string ftp_strings[] = {
 	[FTP_CONNECT]	= { NULL, NULL },
@@ -182,6 +203,7 @@ static struct ftp_control_string ftp_strings[] = {
 	[FTP_TYPE]	= { "TYPE I", NULL },
 	[FTP_SIZE]	= { "SIZE ", ftp_uri_path },
 	[FTP_PASV]	= { "PASV", NULL },
+	[FTP_REST]	= { "REST ", ftp_rest_offset },
 	[FTP_RETR]	= { "RETR ", ftp_uri_path },
 	[FTP_WAIT]	= { NULL, NULL },
 	[FTP_QUIT]	= { "QUIT", NULL },
@@ -222,9 +244,15 @@ static void ftp_next_state ( struct ftp_request *ftp ) {
 	const char *literal;
 	const char *variable;
 
-	/* Move to next state */
+	/* Move to next state, skipping states which do not apply */
 	if ( ftp->state < FTP_DONE )
 		ftp->state++;
+	if ( ( ftp->state == FTP_SIZE ) && ( ftp->start || ftp->len ) ) {
+		/* Ranged fetch: the caller already knows the size */
+		ftp->state++;
+	}
+	if ( ( ftp->state == FTP_REST ) && ( ftp->start == 0 ) )
+		ftp->state++;
 
 	/* Send control string if needed */
 	ftp_string = &ftp_strings[ftp->state];
@@ -262,16 +290,22 @@ static void ftp_reply ( struct ftp_request *ftp ) {
 	 * the next step.
 	 */
 	if ( ( status_major == '5' ) && ( ftp->state == FTP_SIZE ) ) {
+		if ( ftp->probe ) {
+			/* File size is unobtainable; finish the probe */
+			ftp->state = FTP_WAIT;
+		}
 		ftp_next_state ( ftp );
 		return;
 	}
 
 	/* Anything other than success (2xx) or, in the case of a
-	 * repsonse to a "USER" command, a password prompt (3xx), is a
-	 * fatal error.
+	 * repsonse to a "USER" or "REST" command, an intermediate
+	 * reply (3xx), is a fatal error.
 	 */
 	if ( ! ( ( status_major == '2' ) ||
-		 ( ( status_major == '3' ) && ( ftp->state == FTP_USER ) ) ) ){
+		 ( ( status_major == '3' ) &&
+		   ( ( ftp->state == FTP_USER ) ||
+		     ( ftp->state == FTP_REST ) ) ) ) ) {
 		/* Flag protocol error and close connections */
 		ftp_done ( ftp, -EPROTO );
 		return;
@@ -295,6 +329,10 @@ static void ftp_reply ( struct ftp_request *ftp ) {
 		DBGC ( ftp, "FTP %p file size is %zd bytes\n", ftp, filesize );
 		xfer_seek ( &ftp->xfer, filesize );
 		xfer_seek ( &ftp->xfer, 0 );
+
+		/* A probe-only request is now complete */
+		if ( ftp->probe )
+			ftp->state = FTP_WAIT;
 	}
 
 	/* Open passive connection when we get "PASV" response */
@@ -428,8 +466,61 @@ static void ftp_data_closed ( struct ftp_request *ftp, int rc ) {
 	}
 }
 
+/**
+ * Handle data arriving on FTP data channel
+ *
+ * @v ftp		FTP request
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ *
+ * Data is delivered at its absolute position within the overall file,
+ * trimmed to the requested content range (if any).  Once a requested
+ * range has been received in full, the transfer is terminated rather
+ * than waiting for the server to send the remainder of the file.
+ */
+static int ftp_data_deliver ( struct ftp_request *ftp,
+			      struct io_buffer *iobuf,
+			      struct xfer_metadata *meta __unused ) {
+	struct xfer_metadata data_meta;
+	size_t len = iob_len ( iobuf );
+	size_t remaining;
+	int rc;
+
+	/* Trim to requested range, if applicable */
+	if ( ftp->len ) {
+		remaining = ( ftp->len - ftp->pos );
+		if ( len > remaining ) {
+			iob_unput ( iobuf, ( len - remaining ) );
+			len = remaining;
+		}
+	}
+
+	/* Deliver at absolute position within the overall file */
+	if ( len ) {
+		memset ( &data_meta, 0, sizeof ( data_meta ) );
+		data_meta.flags = XFER_FL_ABS_OFFSET;
+		data_meta.offset = ( ftp->start + ftp->pos );
+		ftp->pos += len;
+		if ( ( rc = xfer_deliver ( &ftp->xfer, iob_disown ( iobuf ),
+					   &data_meta ) ) != 0 ) {
+			ftp_done ( ftp, rc );
+			return rc;
+		}
+	} else {
+		free_iob ( iobuf );
+	}
+
+	/* Terminate once the requested range is complete */
+	if ( ftp->len && ( ftp->pos == ftp->len ) )
+		ftp_done ( ftp, 0 );
+
+	return 0;
+}
+
 /** FTP data channel interface operations */
 static struct interface_operation ftp_data_operations[] = {
+	INTF_OP ( xfer_deliver, struct ftp_request *, ftp_data_deliver ),
 	INTF_OP ( intf_close, struct ftp_request *, ftp_data_closed ),
 };
 
@@ -484,9 +575,12 @@ static int ftp_check_string ( const char *string ) {
  *
  * @v xfer		Data transfer interface
  * @v uri		Uniform Resource Identifier
+ * @v range		Content range (or NULL for the whole file)
+ * @v probe		Probe file size only, without transferring data
  * @ret rc		Return status code
  */
-static int ftp_open ( struct interface *xfer, struct uri *uri ) {
+static int ftp_open_common ( struct interface *xfer, struct uri *uri,
+			     struct ftp_request_range *range, int probe ) {
 	struct ftp_request *ftp;
 	struct sockaddr_tcpip server;
 	int rc;
@@ -513,6 +607,13 @@ static int ftp_open ( struct interface *xfer, struct uri *uri ) {
 	intf_init ( &ftp->control, &ftp_control_desc, &ftp->refcnt );
 	intf_init ( &ftp->data, &ftp_data_desc, &ftp->refcnt );
 	ftp->uri = uri_get ( uri );
+	if ( range ) {
+		ftp->start = range->start;
+		ftp->len = range->len;
+	}
+	ftp->probe = probe;
+	snprintf ( ftp->rest_text, sizeof ( ftp->rest_text ), "%zd",
+		   ftp->start );
 	ftp->recvbuf = ftp->status_text;
 	ftp->recvsize = sizeof ( ftp->status_text ) - 1;
 
@@ -539,8 +640,46 @@ static int ftp_open ( struct interface *xfer, struct uri *uri ) {
 	return rc;
 }
 
+/**
+ * Initiate an FTP download
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Uniform Resource Identifier
+ * @v range		Content range (or NULL for the whole file)
+ * @ret rc		Return status code
+ */
+int ftp_open ( struct interface *xfer, struct uri *uri,
+	       struct ftp_request_range *range ) {
+	return ftp_open_common ( xfer, uri, range, 0 );
+}
+
+/**
+ * Initiate an FTP file size probe
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Uniform Resource Identifier
+ * @ret rc		Return status code
+ *
+ * The file size is announced via xfer_seek(), after which the
+ * connection is closed without transferring any data.
+ */
+int ftp_size ( struct interface *xfer, struct uri *uri ) {
+	return ftp_open_common ( xfer, uri, NULL, 1 );
+}
+
+/**
+ * Initiate an FTP URI download
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Uniform Resource Identifier
+ * @ret rc		Return status code
+ */
+static int ftp_open_uri ( struct interface *xfer, struct uri *uri ) {
+	return ftp_open_common ( xfer, uri, NULL, 0 );
+}
+
 /** FTP URI opener */
 struct uri_opener ftp_uri_opener __uri_opener = {
 	.scheme	= "ftp",
-	.open	= ftp_open,
+	.open	= ftp_open_uri,
 };
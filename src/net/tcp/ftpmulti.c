@@ -0,0 +1,459 @@
+/*
+ * Copyright (C) 2015 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/**
+ * @file
+ *
+ * Multi-connection File Transfer Protocol (FTP) download
+ *
+ * The "mftp" URI scheme downloads the same file as a plain ftp://
+ * URI, but stripes the content across several concurrent control and
+ * data connection pairs: an initial SIZE probe discovers the file
+ * size, and the file is then fetched as fixed-size ranges (using the
+ * REST command) handed out to a pool of connections, with each
+ * connection delivering its data at the appropriate absolute offset
+ * and terminating once its assigned range is complete.  Servers which
+ * do not support SIZE are downloaded via a single connection as
+ * usual.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/uri.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/interface.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/xfer.h>
+#include <ipxe/job.h>
+#include <ipxe/open.h>
+#include <ipxe/process.h>
+#include <ipxe/ftp.h>
+
+/** Number of concurrent stripe connections */
+#define FTPMUX_STRIPES 4
+
+/** Length of each requested content range
+ *
+ * Each range costs a complete FTP login and passive-mode handshake,
+ * so ranges are kept substantially larger than the HTTP equivalent.
+ */
+#define FTPMUX_STRIPE_LEN ( 4 * 1024 * 1024 )
+
+struct ftp_multiplexer;
+
+/** A multi-connection FTP download stripe */
+struct ftp_multiplexed_stripe {
+	/** FTP download multiplexer */
+	struct ftp_multiplexer *ftpmux;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** List of stripes */
+	struct list_head list;
+	/** Starting offset of assigned content range */
+	size_t start;
+	/** Length of assigned content range (or zero for "to EOF") */
+	size_t len;
+	/** Amount of range data received so far */
+	size_t pos;
+};
+
+/** A multi-connection FTP download multiplexer */
+struct ftp_multiplexer {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** File size probe interface */
+	struct interface probe;
+	/** Underlying URI (with plain FTP scheme) */
+	struct uri *uri;
+	/** Total file size (zero if unknown) */
+	size_t total;
+	/** Next unassigned content offset */
+	size_t offset;
+	/** Stripe assignment process */
+	struct process process;
+	/** List of busy stripes */
+	struct list_head busy;
+	/** List of idle stripes */
+	struct list_head idle;
+	/** Stripes */
+	struct ftp_multiplexed_stripe stripe[FTPMUX_STRIPES];
+};
+
+/**
+ * Free FTP download multiplexer
+ *
+ * @v refcnt		Reference count
+ */
+static void ftpmux_free ( struct refcnt *refcnt ) {
+	struct ftp_multiplexer *ftpmux =
+		container_of ( refcnt, struct ftp_multiplexer, refcnt );
+
+	uri_put ( ftpmux->uri );
+	free ( ftpmux );
+}
+
+/**
+ * Close FTP download multiplexer
+ *
+ * @v ftpmux		FTP download multiplexer
+ * @v rc		Reason for close
+ */
+static void ftpmux_close ( struct ftp_multiplexer *ftpmux, int rc ) {
+	unsigned int i;
+
+	/* Stop stripe assignment process */
+	process_del ( &ftpmux->process );
+
+	/* Shut down all stripe downloads */
+	for ( i = 0 ; i < FTPMUX_STRIPES ; i++ )
+		intf_shutdown ( &ftpmux->stripe[i].xfer, rc );
+
+	/* Shut down all other interfaces */
+	intf_shutdown ( &ftpmux->probe, rc );
+	intf_shutdown ( &ftpmux->xfer, rc );
+}
+
+/**
+ * Report progress of FTP download
+ *
+ * @v ftpmux		FTP download multiplexer
+ * @v progress		Progress report to fill in
+ * @ret ongoing_rc	Ongoing job status code (if known)
+ */
+static int ftpmux_progress ( struct ftp_multiplexer *ftpmux,
+			     struct job_progress *progress ) {
+	struct ftp_multiplexed_stripe *stripe;
+	size_t completed = ftpmux->offset;
+
+	/* Subtract not-yet-received portions of assigned stripes */
+	list_for_each_entry ( stripe, &ftpmux->busy, list ) {
+		completed -= ( stripe->len - stripe->pos );
+	}
+
+	progress->completed = completed;
+	progress->total = ftpmux->total;
+	return 0;
+}
+
+/**
+ * Receive file size probe data
+ *
+ * @v ftpmux		FTP download multiplexer
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int ftpmux_probe_deliver ( struct ftp_multiplexer *ftpmux,
+				  struct io_buffer *iobuf,
+				  struct xfer_metadata *meta ) {
+
+	/* The SIZE probe announces the file size by seeking to the
+	 * end of the (empty) transfer.  Record the highest announced
+	 * position as the total file size.
+	 */
+	if ( ( meta->flags & XFER_FL_ABS_OFFSET ) &&
+	     ( ( ( size_t ) meta->offset ) > ftpmux->total ) ) {
+		ftpmux->total = meta->offset;
+	}
+
+	free_iob ( iobuf );
+	return 0;
+}
+
+/**
+ * Close file size probe interface
+ *
+ * @v ftpmux		FTP download multiplexer
+ * @v rc		Reason for close
+ */
+static void ftpmux_probe_close ( struct ftp_multiplexer *ftpmux, int rc ) {
+
+	/* Terminate download on error */
+	if ( rc != 0 ) {
+		ftpmux_close ( ftpmux, rc );
+		return;
+	}
+
+	/* Shut down probe interface */
+	intf_shutdown ( &ftpmux->probe, rc );
+
+	DBGC ( ftpmux, "FTPMUX %p file size %zd\n", ftpmux, ftpmux->total );
+
+	/* Notify recipient of total download size, if known */
+	if ( ftpmux->total ) {
+		xfer_seek ( &ftpmux->xfer, ftpmux->total );
+		xfer_seek ( &ftpmux->xfer, 0 );
+	}
+
+	/* Start assigning stripes */
+	process_add ( &ftpmux->process );
+}
+
+/**
+ * Assign next content range to an idle stripe
+ *
+ * @v ftpmux		FTP download multiplexer
+ */
+static void ftpmux_step ( struct ftp_multiplexer *ftpmux ) {
+	struct ftp_multiplexed_stripe *stripe;
+	struct ftp_request_range range;
+	struct ftp_request_range *rangep;
+	int rc;
+
+	/* Stop assignment process if all content has been assigned */
+	if ( ftpmux->total && ( ftpmux->offset >= ftpmux->total ) ) {
+		process_del ( &ftpmux->process );
+		if ( list_empty ( &ftpmux->busy ) )
+			ftpmux_close ( ftpmux, 0 );
+		return;
+	}
+
+	/* Stop assignment process if all stripes are busy */
+	stripe = list_first_entry ( &ftpmux->idle,
+				    struct ftp_multiplexed_stripe, list );
+	if ( ! stripe ) {
+		process_del ( &ftpmux->process );
+		return;
+	}
+
+	/* Assign next content range.  If the file size is unknown
+	 * (i.e. the server does not support SIZE), fall back to a
+	 * single unranged transfer of the whole file.
+	 */
+	stripe->start = ftpmux->offset;
+	stripe->pos = 0;
+	if ( ftpmux->total ) {
+		stripe->len = ( ftpmux->total - ftpmux->offset );
+		if ( stripe->len > FTPMUX_STRIPE_LEN )
+			stripe->len = FTPMUX_STRIPE_LEN;
+		range.start = stripe->start;
+		range.len = stripe->len;
+		rangep = &range;
+		ftpmux->offset += stripe->len;
+	} else {
+		stripe->len = 0;
+		rangep = NULL;
+		ftpmux->offset = ~( ( size_t ) 0 );
+	}
+
+	/* Start downloading this range */
+	if ( ( rc = ftp_open ( &stripe->xfer, ftpmux->uri, rangep ) ) != 0 ) {
+		DBGC ( ftpmux, "FTPMUX %p could not start stripe at "
+		       "[%zx,%zx): %s\n", ftpmux, stripe->start,
+		       ( stripe->start + stripe->len ), strerror ( rc ) );
+		ftpmux_close ( ftpmux, rc );
+		return;
+	}
+	DBGC2 ( ftpmux, "FTPMUX %p stripe %p downloading [%zx,%zx)\n",
+		ftpmux, stripe, stripe->start,
+		( stripe->start + stripe->len ) );
+
+	/* Move to list of busy stripes */
+	list_del ( &stripe->list );
+	list_add_tail ( &stripe->list, &ftpmux->busy );
+}
+
+/**
+ * Receive data from a stripe download
+ *
+ * @v stripe		FTP multiplexed download stripe
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ *
+ * Ranged FTP transfers deliver data at its absolute position within
+ * the overall file, so the metadata is passed through unmodified; the
+ * amount received is tracked to detect incomplete ranges.
+ */
+static int ftpmux_stripe_deliver ( struct ftp_multiplexed_stripe *stripe,
+				   struct io_buffer *iobuf,
+				   struct xfer_metadata *meta ) {
+	struct ftp_multiplexer *ftpmux = stripe->ftpmux;
+	size_t len = iob_len ( iobuf );
+	int rc;
+
+	/* Deliver to recipient.  We can't use a simple passthrough
+	 * interface descriptor, since multiple stripes deliver
+	 * concurrently into the same recipient.
+	 */
+	if ( ( rc = xfer_deliver ( &ftpmux->xfer, iob_disown ( iobuf ),
+				   meta ) ) != 0 ) {
+		ftpmux_close ( ftpmux, rc );
+		return rc;
+	}
+
+	/* Update position */
+	stripe->pos += len;
+	return 0;
+}
+
+/**
+ * Close a stripe download
+ *
+ * @v stripe		FTP multiplexed download stripe
+ * @v rc		Reason for close
+ */
+static void ftpmux_stripe_close ( struct ftp_multiplexed_stripe *stripe,
+				  int rc ) {
+	struct ftp_multiplexer *ftpmux = stripe->ftpmux;
+
+	/* Move to list of idle stripes */
+	list_del ( &stripe->list );
+	list_add_tail ( &stripe->list, &ftpmux->idle );
+
+	/* If any error occurred, terminate the whole download */
+	if ( rc != 0 ) {
+		ftpmux_close ( ftpmux, rc );
+		return;
+	}
+
+	/* Check that the complete assigned range was received */
+	if ( stripe->len && ( stripe->pos != stripe->len ) ) {
+		DBGC ( ftpmux, "FTPMUX %p stripe %p received %zx of [%zx,"
+		       "%zx)\n", ftpmux, stripe, stripe->pos, stripe->start,
+		       ( stripe->start + stripe->len ) );
+		ftpmux_close ( ftpmux, -EIO );
+		return;
+	}
+
+	/* Restart data transfer interface */
+	intf_restart ( &stripe->xfer, rc );
+
+	/* Restart stripe assignment process (which will also detect
+	 * overall completion).
+	 */
+	process_add ( &ftpmux->process );
+}
+
+/** Data transfer interface operations */
+static struct interface_operation ftpmux_xfer_operations[] = {
+	INTF_OP ( job_progress, struct ftp_multiplexer *, ftpmux_progress ),
+	INTF_OP ( intf_close, struct ftp_multiplexer *, ftpmux_close ),
+};
+
+/** Data transfer interface descriptor */
+static struct interface_descriptor ftpmux_xfer_desc =
+	INTF_DESC ( struct ftp_multiplexer, xfer, ftpmux_xfer_operations );
+
+/** File size probe interface operations */
+static struct interface_operation ftpmux_probe_operations[] = {
+	INTF_OP ( xfer_deliver, struct ftp_multiplexer *,
+		  ftpmux_probe_deliver ),
+	INTF_OP ( intf_close, struct ftp_multiplexer *, ftpmux_probe_close ),
+};
+
+/** File size probe interface descriptor */
+static struct interface_descriptor ftpmux_probe_desc =
+	INTF_DESC ( struct ftp_multiplexer, probe, ftpmux_probe_operations );
+
+/** Stripe download data transfer interface operations */
+static struct interface_operation ftpmux_stripe_operations[] = {
+	INTF_OP ( xfer_deliver, struct ftp_multiplexed_stripe *,
+		  ftpmux_stripe_deliver ),
+	INTF_OP ( intf_close, struct ftp_multiplexed_stripe *,
+		  ftpmux_stripe_close ),
+};
+
+/** Stripe download data transfer interface descriptor */
+static struct interface_descriptor ftpmux_stripe_desc =
+	INTF_DESC ( struct ftp_multiplexed_stripe, xfer,
+		    ftpmux_stripe_operations );
+
+/** Stripe assignment process descriptor */
+static struct process_descriptor ftpmux_process_desc =
+	PROC_DESC ( struct ftp_multiplexer, process, ftpmux_step );
+
+/**
+ * Open multi-connection "mftp" URI
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Request URI
+ * @ret rc		Return status code
+ */
+static int ftpmux_open_uri ( struct interface *xfer, struct uri *uri ) {
+	struct ftp_multiplexer *ftpmux;
+	struct ftp_multiplexed_stripe *stripe;
+	struct uri stripped;
+	unsigned int i;
+	int rc;
+
+	/* Construct underlying URI with plain scheme */
+	memcpy ( &stripped, uri, sizeof ( stripped ) );
+	stripped.scheme = "ftp";
+
+	/* Allocate and initialise structure */
+	ftpmux = zalloc ( sizeof ( *ftpmux ) );
+	if ( ! ftpmux ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ref_init ( &ftpmux->refcnt, ftpmux_free );
+	intf_init ( &ftpmux->xfer, &ftpmux_xfer_desc, &ftpmux->refcnt );
+	intf_init ( &ftpmux->probe, &ftpmux_probe_desc, &ftpmux->refcnt );
+	process_init_stopped ( &ftpmux->process, &ftpmux_process_desc,
+			       &ftpmux->refcnt );
+	INIT_LIST_HEAD ( &ftpmux->busy );
+	INIT_LIST_HEAD ( &ftpmux->idle );
+	for ( i = 0 ; i < FTPMUX_STRIPES ; i++ ) {
+		stripe = &ftpmux->stripe[i];
+		stripe->ftpmux = ftpmux;
+		list_add_tail ( &stripe->list, &ftpmux->idle );
+		intf_init ( &stripe->xfer, &ftpmux_stripe_desc,
+			    &ftpmux->refcnt );
+	}
+	ftpmux->uri = uri_dup ( &stripped );
+	if ( ! ftpmux->uri ) {
+		rc = -ENOMEM;
+		goto err_uri;
+	}
+
+	/* Start file size probe */
+	if ( ( rc = ftp_size ( &ftpmux->probe, ftpmux->uri ) ) != 0 ) {
+		DBGC ( ftpmux, "FTPMUX %p could not start probe: %s\n",
+		       ftpmux, strerror ( rc ) );
+		goto err_probe;
+	}
+
+	/* Attach parent interface, mortalise self, and return */
+	intf_plug_plug ( &ftpmux->xfer, xfer );
+	ref_put ( &ftpmux->refcnt );
+	return 0;
+
+ err_probe:
+ err_uri:
+	ftpmux_close ( ftpmux, rc );
+	ref_put ( &ftpmux->refcnt );
+ err_alloc:
+	return rc;
+}
+
+/** Multi-connection FTP URI opener */
+struct uri_opener ftpmux_uri_opener __uri_opener = {
+	.scheme	= "mftp",
+	.open	= ftpmux_open_uri,
+};
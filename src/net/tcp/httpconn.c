@@ -264,10 +264,12 @@ int http_connect ( struct interface *xfer, struct uri *uri ) {
 		assert ( conn->uri != NULL );
 		assert ( conn->uri->host != NULL );
 
-		/* Reuse connection, if possible */
+		/* Reuse connection, if possible.  Compare the cheap
+		 * fields before the host name string.
+		 */
 		if ( ( scheme == conn->scheme ) &&
-		     ( strcmp ( uri->host, conn->uri->host ) == 0 ) &&
-		     ( port == uri_port ( conn->uri, scheme->port ) ) ) {
+		     ( port == uri_port ( conn->uri, scheme->port ) ) &&
+		     ( strcmp ( uri->host, conn->uri->host ) == 0 ) ) {
 
 			/* Remove from connection pool, stop timer,
 			 * attach to parent interface, and return.
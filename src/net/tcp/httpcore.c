@@ -54,6 +54,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/version.h>
 #include <ipxe/params.h>
 #include <ipxe/profile.h>
+#include <ipxe/leakstat.h>
 #include <ipxe/vsprintf.h>
 #include <ipxe/errortab.h>
 #include <ipxe/http.h>
@@ -74,6 +75,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define EINVAL_CHUNK_LENGTH __einfo_error ( EINFO_EINVAL_CHUNK_LENGTH )
 #define EINFO_EINVAL_CHUNK_LENGTH \
 	__einfo_uniqify ( EINFO_EINVAL, 0x04, "Invalid chunk length" )
+#define EINVAL_CONTENT_RANGE __einfo_error ( EINFO_EINVAL_CONTENT_RANGE )
+#define EINFO_EINVAL_CONTENT_RANGE \
+	__einfo_uniqify ( EINFO_EINVAL, 0x05, "Invalid content range" )
 #define EIO_OTHER __einfo_error ( EINFO_EIO_OTHER )
 #define EINFO_EIO_OTHER \
 	__einfo_uniqify ( EINFO_EIO, 0x01, "Unrecognised HTTP response code" )
@@ -101,6 +105,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define EPROTO_UNSOLICITED __einfo_error ( EINFO_EPROTO_UNSOLICITED )
 #define EINFO_EPROTO_UNSOLICITED \
 	__einfo_uniqify ( EINFO_EPROTO, 0x01, "Unsolicited data" )
+#define EXDEV_NOT_MODIFIED __einfo_error ( EINFO_EXDEV_NOT_MODIFIED )
+#define EINFO_EXDEV_NOT_MODIFIED \
+	__einfo_uniqify ( EINFO_EXDEV, 0x01, "HTTP 304 Not Modified" )
 
 /** Retry delay used when we cannot understand the Retry-After header */
 #define HTTP_RETRY_SECONDS 5
@@ -253,6 +260,9 @@ char * http_token ( char **line, char **value ) {
  ******************************************************************************
  */
 
+/** Transaction leak tracker */
+static struct leak_tracker http_leaks __leak_tracker = { .name = "http" };
+
 /**
  * Free HTTP transaction
  *
@@ -266,6 +276,7 @@ static void http_free ( struct refcnt *refcnt ) {
 	empty_line_buffer ( &http->linebuf );
 	uri_put ( http->uri );
 	free ( http );
+	leak_free ( &http_leaks );
 }
 
 /**
@@ -580,20 +591,28 @@ static struct process_descriptor http_process_desc =
  * @v method		Request method
  * @v uri		Request URI
  * @v range		Content range (if any)
+ * @v etag		Entity tag to validate against (if any)
  * @v content		Request content (if any)
  * @ret rc		Return status code
+ *
+ * If an entity tag is specified then the request will be made
+ * conditional, and will fail with an error indicating "not modified"
+ * if the server reports that the entity tag still matches.
  */
 int http_open ( struct interface *xfer, struct http_method *method,
 		struct uri *uri, struct http_request_range *range,
-		struct http_request_content *content ) {
+		const char *etag, struct http_request_content *content ) {
 	struct http_transaction *http;
+	struct http_authentication *auth;
 	struct uri request_uri;
 	struct uri request_host;
 	size_t request_uri_len;
 	size_t request_host_len;
+	size_t etag_len;
 	size_t content_len;
 	char *request_uri_string;
 	char *request_host_string;
+	char *etag_string;
 	void *content_data;
 	int rc;
 
@@ -611,19 +630,24 @@ int http_open ( struct interface *xfer, struct http_method *method,
 	request_host_len =
 		( format_uri ( &request_host, NULL, 0 ) + 1 /* NUL */ );
 
+	/* Calculate entity tag length */
+	etag_len = ( etag ? ( strlen ( etag ) + 1 /* NUL */ ) : 0 );
+
 	/* Calculate request content length */
 	content_len = ( content ? content->len : 0 );
 
 	/* Allocate and initialise structure */
 	http = zalloc ( sizeof ( *http ) + request_uri_len + request_host_len +
-			content_len );
+			etag_len + content_len );
 	if ( ! http ) {
 		rc = -ENOMEM;
 		goto err_alloc;
 	}
+	leak_alloc ( &http_leaks );
 	request_uri_string = ( ( ( void * ) http ) + sizeof ( *http ) );
 	request_host_string = ( request_uri_string + request_uri_len );
-	content_data = ( request_host_string + request_host_len );
+	etag_string = ( request_host_string + request_host_len );
+	content_data = ( etag_string + etag_len );
 	format_uri ( &request_uri, request_uri_string, request_uri_len );
 	format_uri ( &request_host, request_host_string, request_host_len );
 	ref_init ( &http->refcnt, http_free );
@@ -642,6 +666,10 @@ int http_open ( struct interface *xfer, struct http_method *method,
 		memcpy ( &http->request.range, range,
 			 sizeof ( http->request.range ) );
 	}
+	if ( etag ) {
+		memcpy ( etag_string, etag, etag_len );
+		http->request.etag = etag_string;
+	}
 	if ( content ) {
 		http->request.content.type = content->type;
 		http->request.content.data = content_data;
@@ -652,6 +680,14 @@ int http_open ( struct interface *xfer, struct http_method *method,
 	DBGC2 ( http, "HTTP %p %s://%s%s\n", http, http->uri->scheme,
 		http->request.host, http->request.uri );
 
+	/* Authenticate preemptively from a cached session, if
+	 * possible, to avoid an unauthorised-response round trip.
+	 */
+	for_each_table_entry ( auth, HTTP_AUTHENTICATIONS ) {
+		if ( auth->preempt && ( auth->preempt ( http ) == 0 ) )
+			break;
+	}
+
 	/* Open connection */
 	if ( ( rc = http_connect ( &http->conn, uri ) ) != 0 ) {
 		DBGC ( http, "HTTP %p could not connect: %s\n",
@@ -951,6 +987,31 @@ struct http_request_header http_request_range __http_request_header = {
 	.format = http_format_range,
 };
 
+/**
+ * Construct HTTP "If-None-Match" header
+ *
+ * @v http		HTTP transaction
+ * @v buf		Buffer
+ * @v len		Length of buffer
+ * @ret len		Length of header value, or negative error
+ */
+static int http_format_if_none_match ( struct http_transaction *http,
+				       char *buf, size_t len ) {
+
+	/* Construct entity tag, if applicable */
+	if ( http->request.etag ) {
+		return snprintf ( buf, len, "%s", http->request.etag );
+	} else {
+		return 0;
+	}
+}
+
+/** HTTP "If-None-Match" header */
+struct http_request_header http_request_if_none_match __http_request_header = {
+	.name = "If-None-Match",
+	.format = http_format_if_none_match,
+};
+
 /**
  * Construct HTTP "Content-Type" header
  *
@@ -1152,6 +1213,12 @@ static int http_parse_status ( struct http_transaction *http, char *line ) {
 	if ( status[0] == '2' ) {
 		/* 2xx Success */
 		response_rc = 0;
+	} else if ( http->response.status == 304 ) {
+		/* 304 Not Modified (in response to a conditional
+		 * request): the caller's existing copy remains valid.
+		 */
+		http->response.flags |= HTTP_RESPONSE_NOT_MODIFIED;
+		response_rc = -EXDEV_NOT_MODIFIED;
 	} else if ( status[0] == '3' ) {
 		/* 3xx Redirection */
 		response_rc = -EXDEV;
@@ -1192,6 +1259,7 @@ static int http_parse_header ( struct http_transaction *http, char *line ) {
 	struct http_response_header *header;
 	char *name = line;
 	char *sep;
+	int first;
 
 	DBGC2 ( http, "HTTP %p RX %s\n", http, line );
 
@@ -1208,8 +1276,15 @@ static int http_parse_header ( struct http_transaction *http, char *line ) {
 	while ( isspace ( *line ) )
 		line++;
 
-	/* Process header, if recognised */
+	/* Process header, if recognised.  Responses commonly contain
+	 * tens of headers, most of which match no registered handler,
+	 * so filter on the first character before performing the full
+	 * case-insensitive comparison.
+	 */
+	first = tolower ( name[0] );
 	for_each_table_entry ( header, HTTP_RESPONSE_HEADERS ) {
+		if ( tolower ( header->name[0] ) != first )
+			continue;
 		if ( strcasecmp ( name, header->name ) == 0 )
 			return header->parse ( http, line );
 	}
@@ -1275,6 +1350,26 @@ struct http_response_header http_response_location __http_response_header = {
 	.parse = http_parse_location,
 };
 
+/**
+ * Parse HTTP "ETag" header
+ *
+ * @v http		HTTP transaction
+ * @v line		Remaining header line
+ * @ret rc		Return status code
+ */
+static int http_parse_etag ( struct http_transaction *http, char *line ) {
+
+	/* Store entity tag */
+	http->response.etag = line;
+	return 0;
+}
+
+/** HTTP "ETag" header */
+struct http_response_header http_response_etag __http_response_header = {
+	.name = "ETag",
+	.parse = http_parse_etag,
+};
+
 /**
  * Parse HTTP "Transfer-Encoding" header
  *
@@ -1365,6 +1460,54 @@ http_response_content_length __http_response_header = {
 	.parse = http_parse_content_length,
 };
 
+/**
+ * Parse HTTP "Content-Range" header
+ *
+ * @v http		HTTP transaction
+ * @v line		Remaining header line
+ * @ret rc		Return status code
+ */
+static int http_parse_content_range ( struct http_transaction *http,
+				      char *line ) {
+	char *total;
+	char *endp;
+
+	/* Locate complete entity length (e.g. "bytes 0-1023/4096") */
+	total = strchr ( line, '/' );
+	if ( ! total ) {
+		DBGC ( http, "HTTP %p invalid Content-Range \"%s\"\n",
+		       http, line );
+		return -EINVAL_CONTENT_RANGE;
+	}
+	total++;
+
+	/* Ignore responses in which the complete length is unknown */
+	if ( *total == '*' )
+		return 0;
+
+	/* Parse complete entity length */
+	http->response.content.total = strtoul ( total, &endp, 10 );
+	if ( *endp != '\0' ) {
+		DBGC ( http, "HTTP %p invalid Content-Range \"%s\"\n",
+		       http, line );
+		return -EINVAL_CONTENT_RANGE;
+	}
+
+	/* Record that we have a total entity length (since the
+	 * content length of this response covers only the range)
+	 */
+	http->response.flags |= HTTP_RESPONSE_CONTENT_RANGE;
+
+	return 0;
+}
+
+/** HTTP "Content-Range" header */
+struct http_response_header
+http_response_content_range __http_response_header = {
+	.name = "Content-Range",
+	.parse = http_parse_content_range,
+};
+
 /**
  * Parse HTTP "Content-Encoding" header
  *
@@ -1478,14 +1621,30 @@ static int http_rx_headers ( struct http_transaction *http,
 		return rc;
 	}
 
+	/* Describe overall transfer, if we know the total entity
+	 * length.  A response to a range request additionally reveals
+	 * that the server honours range requests.
+	 */
+	if ( http->response.flags & HTTP_RESPONSE_CONTENT_RANGE ) {
+		xfer_describe ( &http->transfer, XFER_FL_RANGES,
+				http->response.content.total );
+	} else if ( http->response.flags & HTTP_RESPONSE_CONTENT_LEN ) {
+		xfer_describe ( &http->transfer, 0,
+				http->response.content.len );
+	}
+
 	/* Presize receive buffer, if we have a content length */
 	if ( http->response.content.len ) {
 		xfer_seek ( &http->transfer, http->response.content.len );
 		xfer_seek ( &http->transfer, 0 );
 	}
 
-	/* Complete transfer if this is a HEAD request */
-	if ( http->request.method == &http_head ) {
+	/* Complete transfer if no response body is expected (i.e. for
+	 * a response to a HEAD request, or for a 304 Not Modified
+	 * response to a conditional request)
+	 */
+	if ( ( http->request.method == &http_head ) ||
+	     ( http->response.flags & HTTP_RESPONSE_NOT_MODIFIED ) ) {
 		if ( ( rc = http_transfer_complete ( http ) ) != 0 )
 			return rc;
 		return 0;
@@ -1656,15 +1815,44 @@ static int http_rx_chunk_len ( struct http_transaction *http,
 			       struct io_buffer **iobuf ) {
 	char *line;
 	char *endp;
+	char *eol;
+	size_t consume;
 	size_t len;
 	int rc;
 
-	/* Receive into temporary line buffer */
-	if ( ( rc = http_rx_linebuf ( http, *iobuf, &http->linebuf ) ) != 0 )
-		return rc;
+	/* In the common case of a chunk length line contained
+	 * entirely within the I/O buffer, parse the line in place and
+	 * so avoid copying it via the temporary line buffer.
+	 */
+	line = (*iobuf)->data;
+	if ( ( http->linebuf.len == 0 ) &&
+	     ( ( eol = memchr ( line, '\n', iob_len ( *iobuf ) ) ) != NULL ) ) {
+
+		/* Consume line */
+		consume = ( eol + 1 - line );
+		iob_pull ( *iobuf, consume );
+
+		/* Reject embedded NULs, as would the line buffer */
+		if ( memchr ( line, '\0', consume ) )
+			return -EINVAL_CHUNK_LENGTH;
+
+		/* Strip trailing CR (if present) and terminate line */
+		if ( ( eol > line ) && ( eol[-1] == '\r' ) )
+			eol--;
+		*eol = '\0';
+
+	} else {
+
+		/* Line may span I/O buffers: receive into temporary
+		 * line buffer.
+		 */
+		if ( ( rc = http_rx_linebuf ( http, *iobuf,
+					      &http->linebuf ) ) != 0 )
+			return rc;
+		line = buffered_line ( &http->linebuf );
+	}
 
 	/* Wait until we receive a non-empty line */
-	line = buffered_line ( &http->linebuf );
 	if ( ( line == NULL ) || ( line[0] == '\0' ) )
 		return 0;
 
@@ -1729,16 +1917,17 @@ static int http_rx_chunk_data ( struct http_transaction *http,
 
 	} else {
 
-		/* Partial buffer is to be consumed: copy data to a
-		 * temporary I/O buffer.
+		/* Partial buffer is to be consumed: clone the buffer,
+		 * truncate the clone at the chunk boundary, and use
+		 * the clone as payload.  Both views share the
+		 * underlying payload, so no data is copied.
 		 */
-		payload = alloc_iob ( http->remaining );
+		payload = iob_clone ( *iobuf );
 		if ( ! payload ) {
 			rc = -ENOMEM;
 			goto err;
 		}
-		memcpy ( iob_put ( payload, http->remaining ), (*iobuf)->data,
-			 http->remaining );
+		iob_unput ( payload, ( len - http->remaining ) );
 		iob_pull ( *iobuf, http->remaining );
 		http->len += http->remaining;
 		http->remaining = 0;
@@ -1897,7 +2086,7 @@ static size_t http_params ( struct parameters *params, char *buf, size_t len ) {
  */
 static int http_open_get_uri ( struct interface *xfer, struct uri *uri ) {
 
-	return http_open ( xfer, &http_get, uri, NULL, NULL );
+	return http_open ( xfer, &http_get, uri, NULL, NULL, NULL );
 }
 
 /**
@@ -1935,7 +2124,8 @@ static int http_open_post_uri ( struct interface *xfer, struct uri *uri ) {
 	content.len = len;
 
 	/* Open HTTP transaction */
-	if ( ( rc = http_open ( xfer, &http_post, uri, NULL, &content ) ) != 0 )
+	if ( ( rc = http_open ( xfer, &http_post, uri, NULL, NULL,
+				&content ) ) != 0 )
 		goto err_open;
 
  err_open:
@@ -31,6 +31,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <strings.h>
 #include <ipxe/uri.h>
@@ -45,6 +47,36 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 	__einfo_uniqify ( EINFO_EACCES, 0x01,				\
 			  "No username available for Digest authentication" )
 
+struct http_authentication http_digest_auth __http_authentication;
+
+/** A cached Digest authentication session */
+struct http_digest_session {
+	/** Server URI */
+	struct uri *uri;
+	/** Realm */
+	char *realm;
+	/** Nonce */
+	char *nonce;
+	/** Opaque (if any) */
+	char *opaque;
+	/** Algorithm (if any) */
+	char *algorithm;
+	/** Quality of protection (if any) */
+	char *qop;
+	/** Number of times the nonce has been used */
+	unsigned int count;
+};
+
+/** Most recently negotiated Digest authentication session
+ *
+ * Boot flows commonly fetch many files in succession from a single
+ * server.  Cache the parameters negotiated with the most recently
+ * used server, so that subsequent requests to the same server can
+ * include a valid "Authorization" header with the initial request
+ * rather than paying an unauthorised-response round trip per request.
+ */
+static struct http_digest_session http_digest_session;
+
 /** An HTTP Digest "WWW-Authenticate" response field */
 struct http_digest_field {
 	/** Name */
@@ -110,14 +142,100 @@ static int http_parse_digest_auth ( struct http_transaction *http,
 	}
 
 	/* Allow HTTP request to be retried if the request had not
-	 * already tried authentication.
+	 * already tried authentication, or had preemptively reused a
+	 * cached nonce which the server may have rejected as stale.
 	 */
-	if ( ! http->request.auth.auth )
+	if ( ( http->request.auth.auth == NULL ) ||
+	     ( ( http->request.auth.auth == &http_digest_auth ) &&
+	       http->request.auth.digest.preempted ) ) {
 		http->response.flags |= HTTP_RESPONSE_RETRY;
+	}
 
 	return 0;
 }
 
+/**
+ * Check for a cached session matching a request URI's server
+ *
+ * @v uri		Request URI
+ * @ret matches		Cached session matches the URI's server
+ */
+static int http_digest_session_matches ( struct uri *uri ) {
+	struct uri *suri = http_digest_session.uri;
+
+	/* Compare scheme, port, and host, as for pooled connections */
+	if ( ! suri )
+		return 0;
+	if ( ( uri->scheme == NULL ) || ( suri->scheme == NULL ) ||
+	     ( strcmp ( uri->scheme, suri->scheme ) != 0 ) )
+		return 0;
+	if ( uri_port ( uri, 0 ) != uri_port ( suri, 0 ) )
+		return 0;
+	if ( ( uri->host == NULL ) || ( suri->host == NULL ) )
+		return 0;
+	return ( strcmp ( uri->host, suri->host ) == 0 );
+}
+
+/**
+ * Record negotiated session for preemptive authentication
+ *
+ * @v http		HTTP transaction
+ *
+ * Caching is optimistic: the session is recorded once the response
+ * digest has been calculated, without waiting to learn whether or not
+ * the server accepts it.  A cached stale nonce costs only the
+ * unauthorised-response round trip that would have been paid anyway.
+ */
+static void http_digest_session_record ( struct http_transaction *http ) {
+	struct http_response_auth_digest *rsp = &http->response.auth.digest;
+	struct http_digest_session *session = &http_digest_session;
+
+	/* Do nothing if this nonce is already cached for this server
+	 * (e.g. if this authentication was itself preempted from the
+	 * cached session): the nonce count must continue to increase.
+	 */
+	if ( session->nonce && rsp->nonce &&
+	     ( strcmp ( session->nonce, rsp->nonce ) == 0 ) &&
+	     http_digest_session_matches ( http->uri ) ) {
+		return;
+	}
+
+	/* Discard any previously cached session */
+	uri_put ( session->uri );
+	free ( session->realm );
+	free ( session->nonce );
+	free ( session->opaque );
+	free ( session->algorithm );
+	free ( session->qop );
+	memset ( session, 0, sizeof ( *session ) );
+
+	/* Record new session */
+	session->uri = uri_get ( http->uri );
+	session->realm = strdup ( rsp->realm );
+	session->nonce = strdup ( rsp->nonce );
+	session->opaque = ( rsp->opaque ? strdup ( rsp->opaque ) : NULL );
+	session->algorithm =
+		( rsp->algorithm ? strdup ( rsp->algorithm ) : NULL );
+	session->qop = ( rsp->qop ? strdup ( rsp->qop ) : NULL );
+	session->count = 1;
+
+	/* If any allocation failed, then leave the cache empty:
+	 * preemptive authentication is only an optimisation.
+	 */
+	if ( ( session->realm == NULL ) || ( session->nonce == NULL ) ||
+	     ( rsp->opaque && ( session->opaque == NULL ) ) ||
+	     ( rsp->algorithm && ( session->algorithm == NULL ) ) ||
+	     ( rsp->qop && ( session->qop == NULL ) ) ) {
+		uri_put ( session->uri );
+		free ( session->realm );
+		free ( session->nonce );
+		free ( session->opaque );
+		free ( session->algorithm );
+		free ( session->qop );
+		memset ( session, 0, sizeof ( *session ) );
+	}
+}
+
 /**
  * Initialise HTTP Digest
  *
@@ -177,6 +295,14 @@ static int http_digest_authenticate ( struct http_transaction *http ) {
 	struct md5_context ctx;
 	const char *password;
 
+	/* Clear any preemption state from a previous attempt, so
+	 * that a fresh handshake uses the initial nonce count.
+	 */
+	if ( req->preempted ) {
+		req->preempted = 0;
+		req->nc[0] = '\0';
+	}
+
 	/* Check for required response parameters */
 	if ( ! rsp->realm ) {
 		DBGC ( http, "HTTP %p has no realm for Digest authentication\n",
@@ -204,6 +330,14 @@ static int http_digest_authenticate ( struct http_transaction *http ) {
 		/* Use "auth" in subsequent request */
 		req->qop = "auth";
 
+		/* Use the initial nonce count, unless a cached nonce
+		 * is being reused.
+		 */
+		if ( ! req->nc[0] ) {
+			memcpy ( req->nc, HTTP_DIGEST_NC,
+				 sizeof ( req->nc ) );
+		}
+
 		/* Generate a client nonce */
 		snprintf ( req->cnonce, sizeof ( req->cnonce ),
 			   "%08lx", random() );
@@ -241,14 +375,111 @@ static int http_digest_authenticate ( struct http_transaction *http ) {
 	http_digest_update ( &ctx, ha1 );
 	http_digest_update ( &ctx, rsp->nonce );
 	if ( req->qop ) {
-		http_digest_update ( &ctx, HTTP_DIGEST_NC );
+		http_digest_update ( &ctx, req->nc );
 		http_digest_update ( &ctx, req->cnonce );
 		http_digest_update ( &ctx, req->qop );
 	}
 	http_digest_update ( &ctx, ha2 );
 	http_digest_final ( &ctx, req->response, sizeof ( req->response ) );
 
+	/* Cache session for preemptive authentication of subsequent
+	 * requests to the same server.
+	 */
+	http_digest_session_record ( http );
+
+	return 0;
+}
+
+/**
+ * Copy session parameter into transaction-owned storage
+ *
+ * @v buf		Storage buffer position
+ * @v remaining		Remaining storage space
+ * @v string		Parameter to copy, or NULL
+ * @ret copy		Copied parameter, or NULL if absent or too large
+ */
+static const char * http_digest_copy ( char **buf, size_t *remaining,
+				       const char *string ) {
+	const char *copy = *buf;
+	size_t len;
+
+	/* Do nothing if parameter is absent */
+	if ( ! string )
+		return NULL;
+
+	/* Fail if insufficient space remains */
+	len = ( strlen ( string ) + 1 /* NUL */ );
+	if ( len > *remaining ) {
+		*remaining = 0;
+		return NULL;
+	}
+
+	/* Copy parameter */
+	memcpy ( *buf, string, len );
+	*buf += len;
+	*remaining -= len;
+	return copy;
+}
+
+/**
+ * Preempt authentication from a cached session
+ *
+ * @v http		HTTP transaction
+ * @ret rc		Return status code
+ */
+static int http_digest_preempt ( struct http_transaction *http ) {
+	struct http_request_auth_digest *req = &http->request.auth.digest;
+	struct http_response_auth_digest *rsp = &http->response.auth.digest;
+	struct http_digest_session *session = &http_digest_session;
+	char *buf = req->session;
+	size_t remaining = sizeof ( req->session );
+	int rc;
+
+	/* Do nothing unless we have a cached session for this server */
+	if ( ! http_digest_session_matches ( http->uri ) )
+		return -ENOENT;
+
+	/* Do nothing unless we have a username */
+	if ( ! http->uri->user )
+		return -EACCES_USERNAME;
+
+	/* Copy session parameters into the transaction, which may
+	 * outlive the cached session.
+	 */
+	rsp->realm = http_digest_copy ( &buf, &remaining, session->realm );
+	rsp->nonce = http_digest_copy ( &buf, &remaining, session->nonce );
+	rsp->opaque = http_digest_copy ( &buf, &remaining, session->opaque );
+	rsp->algorithm =
+		http_digest_copy ( &buf, &remaining, session->algorithm );
+	rsp->qop = http_digest_copy ( &buf, &remaining, session->qop );
+	if ( ( rsp->realm == NULL ) || ( rsp->nonce == NULL ) ||
+	     ( session->opaque && ( rsp->opaque == NULL ) ) ||
+	     ( session->algorithm && ( rsp->algorithm == NULL ) ) ||
+	     ( session->qop && ( rsp->qop == NULL ) ) ) {
+		rc = -ENOSPC;
+		goto err;
+	}
+
+	/* Use the next nonce count for the cached nonce */
+	snprintf ( req->nc, sizeof ( req->nc ), "%08x", ++session->count );
+
+	/* Calculate response digest */
+	if ( ( rc = http_digest_authenticate ( http ) ) != 0 )
+		goto err;
+
+	/* Mark request as preemptively authenticated, so that a
+	 * stale-nonce rejection triggers a fresh handshake.
+	 */
+	req->preempted = 1;
+	http->request.auth.auth = &http_digest_auth;
+	DBGC2 ( http, "HTTP %p preempting Digest authentication\n", http );
+
 	return 0;
+
+ err:
+	memset ( rsp, 0, sizeof ( *rsp ) );
+	memset ( req, 0, sizeof ( *req ) );
+	return rc;
 }
 
 /**
@@ -287,8 +518,8 @@ static int http_format_digest_auth ( struct http_transaction *http,
 	if ( req->qop ) {
 		used += ssnprintf ( ( buf + used ), ( len - used ),
 				    ", qop=%s, algorithm=%s, cnonce=\"%s\", "
-				    "nc=" HTTP_DIGEST_NC, req->qop,
-				    req->algorithm, req->cnonce );
+				    "nc=%s", req->qop, req->algorithm,
+				    req->cnonce, req->nc );
 	}
 	used += ssnprintf ( ( buf + used ), ( len - used ),
 			    ", response=\"%s\"", req->response );
@@ -302,6 +533,7 @@ struct http_authentication http_digest_auth __http_authentication = {
 	.parse = http_parse_digest_auth,
 	.authenticate = http_digest_authenticate,
 	.format = http_format_digest_auth,
+	.preempt = http_digest_preempt,
 };
 
 /* Drag in HTTP authentication support */
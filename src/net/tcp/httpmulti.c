@@ -0,0 +1,542 @@
+/*
+ * Copyright (C) 2015 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/**
+ * @file
+ *
+ * Multi-connection Hyper Text Transfer Protocol (HTTP) download
+ *
+ * A single TCP connection on a high bandwidth-delay-product path is
+ * frequently limited by the receive window or by congestion recovery
+ * rather than by link bandwidth.  The "mhttp" and "mhttps" URI
+ * schemes download the same object as the corresponding plain scheme,
+ * but stripe the content range across several concurrent range
+ * requests: the first range request doubles as the content length
+ * probe (via the total entity length reported in the response), and
+ * the remaining content is then fetched as fixed-size ranges handed
+ * out to a pool of connections, with each connection delivering its
+ * data at the appropriate absolute offset.  Servers which do not
+ * honour range requests are downloaded via a single connection as
+ * usual.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/uri.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+#include <ipxe/job.h>
+#include <ipxe/open.h>
+#include <ipxe/process.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/http.h>
+
+/** Maximum number of concurrent stripe connections */
+#define HTTPMUX_STRIPES 4
+
+/** Link speed (in Mbps) at which to employ full striping */
+#define HTTPMUX_SPEED_FULL 10000
+
+/** Link speed (in Mbps) below which to use a single connection */
+#define HTTPMUX_SPEED_SINGLE 1000
+
+/** Length of each requested content range */
+#define HTTPMUX_STRIPE_LEN ( 1024 * 1024 )
+
+struct http_multiplexer;
+
+/** A multi-connection HTTP download stripe */
+struct http_multiplexed_stripe {
+	/** HTTP download multiplexer */
+	struct http_multiplexer *httpmux;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** List of stripes */
+	struct list_head list;
+	/** Starting offset of assigned content range */
+	size_t start;
+	/** Length of assigned content range (or zero for "to EOF") */
+	size_t len;
+	/** Current position within assigned content range */
+	size_t pos;
+};
+
+/** A multi-connection HTTP download multiplexer */
+struct http_multiplexer {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Underlying URI (with plain HTTP scheme) */
+	struct uri *uri;
+	/** Overall transfer has been described
+	 *
+	 * Set once the response to the first (speculative) range
+	 * request has revealed the total content length and whether
+	 * or not the server honours range requests.
+	 */
+	int described;
+	/** Number of stripes to employ */
+	unsigned int stripes;
+	/** Total content length (zero if unknown) */
+	size_t total;
+	/** Next unassigned content offset */
+	size_t offset;
+	/** Stripe assignment process */
+	struct process process;
+	/** List of busy stripes */
+	struct list_head busy;
+	/** List of idle stripes */
+	struct list_head idle;
+	/** Stripes */
+	struct http_multiplexed_stripe stripe[HTTPMUX_STRIPES];
+};
+
+/**
+ * Free HTTP download multiplexer
+ *
+ * @v refcnt		Reference count
+ */
+static void httpmux_free ( struct refcnt *refcnt ) {
+	struct http_multiplexer *httpmux =
+		container_of ( refcnt, struct http_multiplexer, refcnt );
+
+	uri_put ( httpmux->uri );
+	free ( httpmux );
+}
+
+/**
+ * Close HTTP download multiplexer
+ *
+ * @v httpmux		HTTP download multiplexer
+ * @v rc		Reason for close
+ */
+static void httpmux_close ( struct http_multiplexer *httpmux, int rc ) {
+	unsigned int i;
+
+	/* Stop stripe assignment process */
+	process_del ( &httpmux->process );
+
+	/* Shut down all stripe downloads */
+	for ( i = 0 ; i < HTTPMUX_STRIPES ; i++ )
+		intf_shutdown ( &httpmux->stripe[i].xfer, rc );
+
+	/* Shut down all other interfaces */
+	intf_shutdown ( &httpmux->xfer, rc );
+}
+
+/**
+ * Report progress of HTTP download
+ *
+ * @v httpmux		HTTP download multiplexer
+ * @v progress		Progress report to fill in
+ * @ret ongoing_rc	Ongoing job status code (if known)
+ */
+static int httpmux_progress ( struct http_multiplexer *httpmux,
+			      struct job_progress *progress ) {
+	struct http_multiplexed_stripe *stripe;
+	size_t completed = httpmux->offset;
+
+	/* Subtract not-yet-received portions of assigned stripes */
+	list_for_each_entry ( stripe, &httpmux->busy, list ) {
+		completed -= ( stripe->len - stripe->pos );
+	}
+
+	progress->completed = completed;
+	progress->total = httpmux->total;
+	return 0;
+}
+
+/**
+ * Record overall transfer description
+ *
+ * @v stripe		HTTP multiplexed download stripe
+ * @v meta		Describing data transfer metadata (or NULL if absent)
+ *
+ * The first (speculative) range request doubles as the content
+ * length probe: its response reveals the total entity length and
+ * whether or not the server honours range requests.
+ */
+static void httpmux_describe ( struct http_multiplexed_stripe *stripe,
+			       struct xfer_metadata *meta ) {
+	struct http_multiplexer *httpmux = stripe->httpmux;
+
+	/* Ignore duplicate descriptions from subsequent responses */
+	if ( httpmux->described )
+		return;
+	httpmux->described = 1;
+
+	if ( meta && ( meta->flags & XFER_FL_RANGES ) ) {
+		/* Server honours range requests: record the total
+		 * length and clamp the speculative first range (and
+		 * next unassigned offset) to the end of the content.
+		 */
+		httpmux->total = meta->offset;
+		if ( ( stripe->start + stripe->len ) > httpmux->total )
+			stripe->len = ( httpmux->total - stripe->start );
+		if ( httpmux->offset > httpmux->total )
+			httpmux->offset = httpmux->total;
+	} else if ( meta ) {
+		/* Server ignored the range request but reported a
+		 * total length: the whole content will arrive via
+		 * this single stripe.
+		 */
+		httpmux->total = meta->offset;
+		stripe->len = httpmux->total;
+		httpmux->offset = httpmux->total;
+	} else {
+		/* No description received before data: the whole
+		 * content (of unknown length) will arrive via this
+		 * single stripe.
+		 */
+		stripe->len = 0;
+		httpmux->offset = 0;
+	}
+
+	DBGC ( httpmux, "HTTPMUX %p content length %zd\n",
+	       httpmux, httpmux->total );
+
+	/* Notify recipient of total download size, if known */
+	if ( httpmux->total ) {
+		xfer_seek ( &httpmux->xfer, httpmux->total );
+		xfer_seek ( &httpmux->xfer, 0 );
+	}
+
+	/* Resume stripe assignment (which will also detect
+	 * completion, if no further ranges remain).
+	 */
+	process_add ( &httpmux->process );
+}
+
+/**
+ * Assign next content range to an idle stripe
+ *
+ * @v httpmux		HTTP download multiplexer
+ */
+static void httpmux_step ( struct http_multiplexer *httpmux ) {
+	struct http_multiplexed_stripe *stripe;
+	struct http_request_range range;
+	int rc;
+
+	/* Wait for the response to the first (speculative) range
+	 * request before assigning further ranges, since it reveals
+	 * the total content length and whether or not the server
+	 * honours range requests.
+	 */
+	if ( ( ! httpmux->described ) && ( ! list_empty ( &httpmux->busy ) ) ) {
+		process_del ( &httpmux->process );
+		return;
+	}
+
+	/* Stop assignment process if all content has been assigned */
+	if ( httpmux->described && ( httpmux->offset >= httpmux->total ) ) {
+		process_del ( &httpmux->process );
+		if ( list_empty ( &httpmux->busy ) )
+			httpmux_close ( httpmux, 0 );
+		return;
+	}
+
+	/* Stop assignment process if all stripes are busy */
+	stripe = list_first_entry ( &httpmux->idle,
+				    struct http_multiplexed_stripe, list );
+	if ( ! stripe ) {
+		process_del ( &httpmux->process );
+		return;
+	}
+
+	/* Assign next content range.  The first range is speculative:
+	 * the content length is not yet known, and the range will be
+	 * clamped (or the request downgraded to a single whole-object
+	 * transfer) when the response arrives.
+	 */
+	stripe->start = httpmux->offset;
+	stripe->pos = 0;
+	if ( httpmux->described ) {
+		stripe->len = ( httpmux->total - httpmux->offset );
+		if ( stripe->len > HTTPMUX_STRIPE_LEN )
+			stripe->len = HTTPMUX_STRIPE_LEN;
+	} else {
+		stripe->len = HTTPMUX_STRIPE_LEN;
+	}
+	range.start = stripe->start;
+	range.len = stripe->len;
+	httpmux->offset += stripe->len;
+
+	/* Start downloading this range */
+	if ( ( rc = http_open ( &stripe->xfer, &http_get, httpmux->uri,
+				&range, NULL, NULL ) ) != 0 ) {
+		DBGC ( httpmux, "HTTPMUX %p could not start stripe at "
+		       "[%zx,%zx): %s\n", httpmux, stripe->start,
+		       ( stripe->start + stripe->len ), strerror ( rc ) );
+		httpmux_close ( httpmux, rc );
+		return;
+	}
+	DBGC2 ( httpmux, "HTTPMUX %p stripe %p downloading [%zx,%zx)\n",
+		httpmux, stripe, stripe->start,
+		( stripe->start + stripe->len ) );
+
+	/* Move to list of busy stripes */
+	list_del ( &stripe->list );
+	list_add_tail ( &stripe->list, &httpmux->busy );
+}
+
+/**
+ * Receive data from a stripe download
+ *
+ * @v stripe		HTTP multiplexed download stripe
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int httpmux_stripe_deliver ( struct http_multiplexed_stripe *stripe,
+				    struct io_buffer *iobuf,
+				    struct xfer_metadata *meta ) {
+	struct http_multiplexer *httpmux = stripe->httpmux;
+	struct xfer_metadata rebased;
+	size_t pos;
+	size_t len = iob_len ( iobuf );
+	int rc;
+
+	/* Consume (and do not forward) overall transfer descriptions */
+	if ( meta->flags & XFER_FL_TOTAL ) {
+		httpmux_describe ( stripe, meta );
+		free_iob ( iobuf );
+		return 0;
+	}
+
+	/* If data arrives before any description, then the server
+	 * reported neither a total length nor a content range
+	 */
+	if ( ( ! httpmux->described ) && len )
+		httpmux_describe ( stripe, NULL );
+
+	/* Calculate position within assigned range */
+	pos = stripe->pos;
+	if ( meta->flags & XFER_FL_ABS_OFFSET )
+		pos = 0;
+	pos += meta->offset;
+
+	/* Rebase position into overall content space.  We can't use a
+	 * simple passthrough interface descriptor, since multiple
+	 * stripes deliver concurrently into the same recipient.
+	 */
+	memcpy ( &rebased, meta, sizeof ( rebased ) );
+	rebased.flags = ( meta->flags | XFER_FL_ABS_OFFSET );
+	rebased.offset = ( stripe->start + pos );
+	if ( ( rc = xfer_deliver ( &httpmux->xfer, iob_disown ( iobuf ),
+				   &rebased ) ) != 0 ) {
+		httpmux_close ( httpmux, rc );
+		return rc;
+	}
+
+	/* Update position */
+	stripe->pos = ( pos + len );
+	return 0;
+}
+
+/**
+ * Close a stripe download
+ *
+ * @v stripe		HTTP multiplexed download stripe
+ * @v rc		Reason for close
+ */
+static void httpmux_stripe_close ( struct http_multiplexed_stripe *stripe,
+				   int rc ) {
+	struct http_multiplexer *httpmux = stripe->httpmux;
+
+	/* Move to list of idle stripes */
+	list_del ( &stripe->list );
+	list_add_tail ( &stripe->list, &httpmux->idle );
+
+	/* If any error occurred, terminate the whole download */
+	if ( rc != 0 ) {
+		httpmux_close ( httpmux, rc );
+		return;
+	}
+
+	/* Check that the complete assigned range was received */
+	if ( stripe->len && ( stripe->pos != stripe->len ) ) {
+		DBGC ( httpmux, "HTTPMUX %p stripe %p received %zx of [%zx,"
+		       "%zx)\n", httpmux, stripe, stripe->pos, stripe->start,
+		       ( stripe->start + stripe->len ) );
+		httpmux_close ( httpmux, -EIO );
+		return;
+	}
+
+	/* Restart data transfer interface */
+	intf_restart ( &stripe->xfer, rc );
+
+	/* Restart stripe assignment process (which will also detect
+	 * overall completion).
+	 */
+	process_add ( &httpmux->process );
+}
+
+/** Data transfer interface operations */
+static struct interface_operation httpmux_xfer_operations[] = {
+	INTF_OP ( job_progress, struct http_multiplexer *, httpmux_progress ),
+	INTF_OP ( intf_close, struct http_multiplexer *, httpmux_close ),
+};
+
+/** Data transfer interface descriptor */
+static struct interface_descriptor httpmux_xfer_desc =
+	INTF_DESC ( struct http_multiplexer, xfer, httpmux_xfer_operations );
+
+/** Stripe download data transfer interface operations */
+static struct interface_operation httpmux_stripe_operations[] = {
+	INTF_OP ( xfer_deliver, struct http_multiplexed_stripe *,
+		  httpmux_stripe_deliver ),
+	INTF_OP ( intf_close, struct http_multiplexed_stripe *,
+		  httpmux_stripe_close ),
+};
+
+/** Stripe download data transfer interface descriptor */
+static struct interface_descriptor httpmux_stripe_desc =
+	INTF_DESC ( struct http_multiplexed_stripe, xfer,
+		    httpmux_stripe_operations );
+
+/** Stripe assignment process descriptor */
+static struct process_descriptor httpmux_process_desc =
+	PROC_DESC ( struct http_multiplexer, process, httpmux_step );
+
+/**
+ * Open multi-connection HTTP download
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Request URI (with "mhttp" or "mhttps" scheme)
+ * @v scheme		Underlying plain URI scheme name
+ * @ret rc		Return status code
+ */
+static int httpmux_open ( struct interface *xfer, struct uri *uri,
+			  const char *scheme ) {
+	struct http_multiplexer *httpmux;
+	struct http_multiplexed_stripe *stripe;
+	struct uri stripped;
+	unsigned int speed;
+	unsigned int i;
+	int rc;
+
+	/* Construct underlying URI with plain scheme */
+	memcpy ( &stripped, uri, sizeof ( stripped ) );
+	stripped.scheme = scheme;
+
+	/* Allocate and initialise structure */
+	httpmux = zalloc ( sizeof ( *httpmux ) );
+	if ( ! httpmux ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ref_init ( &httpmux->refcnt, httpmux_free );
+	intf_init ( &httpmux->xfer, &httpmux_xfer_desc, &httpmux->refcnt );
+	process_init ( &httpmux->process, &httpmux_process_desc,
+		       &httpmux->refcnt );
+	INIT_LIST_HEAD ( &httpmux->busy );
+	INIT_LIST_HEAD ( &httpmux->idle );
+
+	/* Choose the number of stripes to employ from the negotiated
+	 * link speed, if known.  Striping exists to overcome
+	 * per-connection receive window and congestion recovery
+	 * limits on high bandwidth-delay-product paths; a
+	 * management-speed port is better served by a single
+	 * connection.
+	 */
+	speed = netdev_max_link_speed();
+	if ( ( speed == 0 ) || ( speed >= HTTPMUX_SPEED_FULL ) ) {
+		httpmux->stripes = HTTPMUX_STRIPES;
+	} else if ( speed >= HTTPMUX_SPEED_SINGLE ) {
+		httpmux->stripes = ( HTTPMUX_STRIPES / 2 );
+	} else {
+		httpmux->stripes = 1;
+	}
+	DBGC ( httpmux, "HTTPMUX %p using %d stripe(s) at %dMbps\n",
+	       httpmux, httpmux->stripes, speed );
+
+	for ( i = 0 ; i < HTTPMUX_STRIPES ; i++ ) {
+		stripe = &httpmux->stripe[i];
+		stripe->httpmux = httpmux;
+		intf_init ( &stripe->xfer, &httpmux_stripe_desc,
+			    &httpmux->refcnt );
+		if ( i < httpmux->stripes )
+			list_add_tail ( &stripe->list, &httpmux->idle );
+	}
+	httpmux->uri = uri_dup ( &stripped );
+	if ( ! httpmux->uri ) {
+		rc = -ENOMEM;
+		goto err_uri;
+	}
+
+	/* Attach parent interface, mortalise self, and return.  The
+	 * (already running) stripe assignment process will issue the
+	 * first speculative range request, whose response doubles as
+	 * the content length probe.
+	 */
+	intf_plug_plug ( &httpmux->xfer, xfer );
+	ref_put ( &httpmux->refcnt );
+	return 0;
+
+ err_uri:
+	httpmux_close ( httpmux, rc );
+	ref_put ( &httpmux->refcnt );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Open multi-connection "mhttp" URI
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Request URI
+ * @ret rc		Return status code
+ */
+static int httpmux_open_uri ( struct interface *xfer, struct uri *uri ) {
+
+	return httpmux_open ( xfer, uri, "http" );
+}
+
+/**
+ * Open multi-connection "mhttps" URI
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Request URI
+ * @ret rc		Return status code
+ */
+static int httpsmux_open_uri ( struct interface *xfer, struct uri *uri ) {
+
+	return httpmux_open ( xfer, uri, "https" );
+}
+
+/** Multi-connection HTTP URI opener */
+struct uri_opener httpmux_uri_opener __uri_opener = {
+	.scheme	= "mhttp",
+	.open	= httpmux_open_uri,
+};
+
+/** Multi-connection HTTPS URI opener */
+struct uri_opener httpsmux_uri_opener __uri_opener = {
+	.scheme	= "mhttps",
+	.open	= httpsmux_open_uri,
+};
@@ -142,10 +142,119 @@ FEATURE ( FEATURE_PROTOCOL, "iSCSI", DHCP_EB_FEATURE_ISCSI, 1 );
 #define EINFO_EPROTO_VALUE_REJECTED					\
 	__einfo_uniqify ( EINFO_EPROTO, 0x06, "Parameter rejected" )
 
+/** Maximum number of outstanding SCSI tasks
+ *
+ * This is an upper bound on the number of commands that we will
+ * accept from the SCSI layer at any one time.  The target's own
+ * command window (advertised via the MaxCmdSN field) is respected
+ * separately by the TX scheduler.
+ */
+#ifndef ISCSI_MAX_TASKS
+#define ISCSI_MAX_TASKS 32
+#endif
+
+/** An iSCSI task
+ *
+ * This represents a single outstanding SCSI command.
+ */
+struct iscsi_task {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** iSCSI session */
+	struct iscsi_session *iscsi;
+	/** List of outstanding tasks */
+	struct list_head list;
+	/** SCSI command interface */
+	struct interface data;
+	/** SCSI command */
+	struct scsi_cmd command;
+	/** Initiator task tag */
+	uint32_t itt;
+	/** Pending transmissions
+	 *
+	 * This is the bitwise-OR of zero or more ISCSI_TASK_TX_XXX
+	 * constants.
+	 */
+	unsigned int pending;
+	/** Task has been completed (or the session is being closed) */
+	int completed;
+	/** Target transfer tag
+	 *
+	 * This is the tag attached to a sequence of data-out PDUs in
+	 * response to an R2T.
+	 */
+	uint32_t ttt;
+	/** Transfer offset
+	 *
+	 * This is the offset for an in-progress sequence of data-out
+	 * PDUs in response to an R2T.
+	 */
+	uint32_t transfer_offset;
+	/** Transfer length
+	 *
+	 * This is the length for an in-progress sequence of data-out
+	 * PDUs in response to an R2T.
+	 */
+	uint32_t transfer_len;
+	/** Data sequence number within the current data-out sequence */
+	unsigned int datasn;
+};
+
+/** Task needs to send a SCSI command PDU */
+#define ISCSI_TASK_TX_CMD 0x0001
+
+/** Task needs to send a data-out PDU */
+#define ISCSI_TASK_TX_DATA_OUT 0x0002
+
 static void iscsi_start_tx ( struct iscsi_session *iscsi );
+static void iscsi_tx_resume ( struct iscsi_session *iscsi );
 static void iscsi_start_login ( struct iscsi_session *iscsi );
 static void iscsi_start_data_out ( struct iscsi_session *iscsi,
-				   unsigned int datasn );
+				   struct iscsi_task *task );
+
+/**
+ * Check if one iSCSI sequence number is after another
+ *
+ * @v sn1		Sequence number
+ * @v sn2		Sequence number
+ * @ret after		Sequence number 1 is after sequence number 2
+ *
+ * Sequence numbers use serial number arithmetic (as per RFC 1982).
+ */
+static inline int iscsi_sn_after ( uint32_t sn1, uint32_t sn2 ) {
+	return ( ( ( int32_t ) ( sn1 - sn2 ) ) > 0 );
+}
+
+/**
+ * Free iSCSI task
+ *
+ * @v refcnt		Reference counter
+ */
+static void iscsi_task_free ( struct refcnt *refcnt ) {
+	struct iscsi_task *task =
+		container_of ( refcnt, struct iscsi_task, refcnt );
+
+	ref_put ( &task->iscsi->refcnt );
+	free ( task );
+}
+
+/**
+ * Identify outstanding iSCSI task by initiator task tag
+ *
+ * @v iscsi		iSCSI session
+ * @v itt		Initiator task tag
+ * @ret task		Task, or NULL if not found
+ */
+static struct iscsi_task * iscsi_find_task ( struct iscsi_session *iscsi,
+					     uint32_t itt ) {
+	struct iscsi_task *task;
+
+	list_for_each_entry ( task, &iscsi->tasks, list ) {
+		if ( task->itt == itt )
+			return task;
+	}
+	return NULL;
+}
 
 /**
  * Finish receiving PDU data into buffer
@@ -205,7 +314,6 @@ static void iscsi_free ( struct refcnt *refcnt ) {
 	free ( iscsi->target_password );
 	chap_finish ( &iscsi->chap );
 	iscsi_rx_buffered_data_done ( iscsi );
-	free ( iscsi->command );
 	free ( iscsi );
 }
 
@@ -216,6 +324,8 @@ static void iscsi_free ( struct refcnt *refcnt ) {
  * @v rc		Reason for close
  */
 static void iscsi_close ( struct iscsi_session *iscsi, int rc ) {
+	struct iscsi_task *task;
+	struct iscsi_task *tmp;
 
 	/* A TCP graceful close is still an error from our point of view */
 	if ( rc == 0 )
@@ -226,20 +336,27 @@ static void iscsi_close ( struct iscsi_session *iscsi, int rc ) {
 	/* Stop transmission process */
 	process_del ( &iscsi->process );
 
+	/* Shut down all outstanding tasks */
+	list_for_each_entry_safe ( task, tmp, &iscsi->tasks, list ) {
+		list_del ( &task->list );
+		task->completed = 1;
+		intf_shutdown ( &task->data, rc );
+		ref_put ( &task->refcnt );
+	}
+
 	/* Shut down interfaces */
-	intfs_shutdown ( rc, &iscsi->socket, &iscsi->control, &iscsi->data,
-			 NULL );
+	intfs_shutdown ( rc, &iscsi->socket, &iscsi->control, NULL );
 }
 
 /**
  * Assign new iSCSI initiator task tag
  *
- * @v iscsi		iSCSI session
+ * @ret itt		New initiator task tag
  */
-static void iscsi_new_itt ( struct iscsi_session *iscsi ) {
+static uint32_t iscsi_new_itt ( void ) {
 	static uint16_t itt_idx;
 
-	iscsi->itt = ( ISCSI_TAG_MAGIC | (++itt_idx) );
+	return ( ISCSI_TAG_MAGIC | (++itt_idx) );
 }
 
 /**
@@ -274,11 +391,21 @@ static int iscsi_open_connection ( struct iscsi_session *iscsi ) {
 	if ( iscsi->target_username )
 		iscsi->status |= ISCSI_STATUS_AUTH_REVERSE_REQUIRED;
 
+	/* Assume the most conservative data transfer parameters (all
+	 * data solicited by R2T) until operational negotiation
+	 * completes.
+	 */
+	iscsi->status |= ( ISCSI_STATUS_INITIAL_R2T |
+			   ISCSI_STATUS_NO_IMMEDIATE_DATA );
+	iscsi->first_burst_len = ISCSI_FIRST_BURST_LEN;
+	iscsi->max_burst_len = 262144; /* RFC 3720 default */
+	iscsi->max_tx_len = ISCSI_DEFAULT_MAX_TX_LEN;
+
 	/* Assign new ISID */
 	iscsi->isid_iana_qual = ( random() & 0xffff );
 
 	/* Assign fresh initiator task tag */
-	iscsi_new_itt ( iscsi );
+	iscsi->itt = iscsi_new_itt();
 
 	/* Initiate login */
 	iscsi_start_login ( iscsi );
@@ -314,39 +441,40 @@ static void iscsi_close_connection ( struct iscsi_session *iscsi, int rc ) {
 }
 
 /**
- * Mark iSCSI SCSI operation as complete
+ * Mark iSCSI task as complete
  *
- * @v iscsi		iSCSI session
+ * @v task		iSCSI task
  * @v rc		Return status code
  * @v rsp		SCSI response, if any
  *
- * Note that iscsi_scsi_done() will not close the connection, and must
- * therefore be called only when the internal state machines are in an
- * appropriate state, otherwise bad things may happen on the next call
- * to iscsi_scsi_command().  The general rule is to call
- * iscsi_scsi_done() only at the end of receiving a PDU; at this point
- * the TX and RX engines should both be idle.
+ * Note that iscsi_task_done() will not close the connection, and must
+ * therefore be called only at the end of receiving a PDU, when the
+ * task has no data-out PDUs left to send.
  */
-static void iscsi_scsi_done ( struct iscsi_session *iscsi, int rc,
+static void iscsi_task_done ( struct iscsi_task *task, int rc,
 			      struct scsi_rsp *rsp ) {
-	uint32_t itt = iscsi->itt;
+	struct iscsi_session *iscsi = task->iscsi;
 
-	assert ( iscsi->tx_state == ISCSI_TX_IDLE );
-
-	/* Clear command */
-	free ( iscsi->command );
-	iscsi->command = NULL;
+	/* Remove from list of outstanding tasks */
+	list_del ( &task->list );
+	task->pending = 0;
+	task->completed = 1;
 
 	/* Send SCSI response, if any */
 	if ( rsp )
-		scsi_response ( &iscsi->data, rsp );
+		scsi_response ( &task->data, rsp );
 
-	/* Close SCSI command, if this is still the same command.  (It
-	 * is possible that the command interface has already been
-	 * closed as a result of the SCSI response we sent.)
+	/* Shut down the command interface.  (It is possible that the
+	 * interface has already been closed as a result of the SCSI
+	 * response we sent.)
 	 */
-	if ( iscsi->itt == itt )
-		intf_restart ( &iscsi->data, rc );
+	intf_shutdown ( &task->data, rc );
+
+	/* A task slot has become available */
+	xfer_window_changed ( &iscsi->control );
+
+	/* Drop list's reference */
+	ref_put ( &task->refcnt );
 }
 
 /****************************************************************************
@@ -359,41 +487,98 @@ static void iscsi_scsi_done ( struct iscsi_session *iscsi, int rc,
  * Build iSCSI SCSI command BHS
  *
  * @v iscsi		iSCSI session
+ * @v task		iSCSI task
  *
  * We don't currently support bidirectional commands (i.e. with both
  * Data-In and Data-Out segments); these would require providing code
  * to generate an AHS, and there doesn't seem to be any need for it at
  * the moment.
  */
-static void iscsi_start_command ( struct iscsi_session *iscsi ) {
+static void iscsi_start_command ( struct iscsi_session *iscsi,
+				  struct iscsi_task *task ) {
 	struct iscsi_bhs_scsi_command *command = &iscsi->tx_bhs.scsi_command;
+	size_t burst_len = 0;
+	size_t imm_len = 0;
+
+	assert ( ! ( task->command.data_in && task->command.data_out ) );
+
+	/* Calculate unsolicited data burst, if permitted.  Whatever
+	 * fits within a single PDU is sent as immediate data within
+	 * the command PDU itself; the remainder of the first burst
+	 * follows as unsolicited data-out PDUs.  This avoids waiting
+	 * for an R2T round trip before sending any data.
+	 */
+	if ( task->command.data_out &&
+	     ( ! ( iscsi->status & ISCSI_STATUS_INITIAL_R2T ) ) ) {
+		burst_len = task->command.data_out_len;
+		if ( burst_len > iscsi->first_burst_len )
+			burst_len = iscsi->first_burst_len;
+		if ( ! ( iscsi->status & ISCSI_STATUS_NO_IMMEDIATE_DATA ) ) {
+			imm_len = burst_len;
+			if ( imm_len > iscsi->max_tx_len )
+				imm_len = iscsi->max_tx_len;
+		}
+	}
 
-	assert ( ! ( iscsi->command->data_in && iscsi->command->data_out ) );
+	/* Record unsolicited data-out sequence parameters */
+	task->ttt = ISCSI_TAG_RESERVED;
+	task->transfer_offset = imm_len;
+	task->transfer_len = ( burst_len - imm_len );
+	task->datasn = 0;
 
 	/* Construct BHS and initiate transmission */
 	iscsi_start_tx ( iscsi );
 	command->opcode = ISCSI_OPCODE_SCSI_COMMAND;
-	command->flags = ( ISCSI_FLAG_FINAL |
-			   ISCSI_COMMAND_ATTR_SIMPLE );
-	if ( iscsi->command->data_in )
+	command->flags = ISCSI_COMMAND_ATTR_SIMPLE;
+	if ( burst_len == imm_len ) {
+		/* No unsolicited data-out PDUs will follow */
+		command->flags |= ISCSI_FLAG_FINAL;
+	}
+	if ( task->command.data_in )
 		command->flags |= ISCSI_COMMAND_FLAG_READ;
-	if ( iscsi->command->data_out )
+	if ( task->command.data_out )
 		command->flags |= ISCSI_COMMAND_FLAG_WRITE;
-	/* lengths left as zero */
-	memcpy ( &command->lun, &iscsi->command->lun,
+	ISCSI_SET_LENGTHS ( command->lengths, 0, imm_len );
+	memcpy ( &command->lun, &task->command.lun,
 		 sizeof ( command->lun ) );
-	command->itt = htonl ( iscsi->itt );
-	command->exp_len = htonl ( iscsi->command->data_in_len |
-				   iscsi->command->data_out_len );
+	command->itt = htonl ( task->itt );
+	command->exp_len = htonl ( task->command.data_in_len |
+				   task->command.data_out_len );
 	command->cmdsn = htonl ( iscsi->cmdsn );
 	command->expstatsn = htonl ( iscsi->statsn + 1 );
-	memcpy ( &command->cdb, &iscsi->command->cdb, sizeof ( command->cdb ));
+	memcpy ( &command->cdb, &task->command.cdb, sizeof ( command->cdb ) );
 	DBGC2 ( iscsi, "iSCSI %p start " SCSI_CDB_FORMAT " %s %#zx\n",
 		iscsi, SCSI_CDB_DATA ( command->cdb ),
-		( iscsi->command->data_in ? "in" : "out" ),
-		( iscsi->command->data_in ?
-		  iscsi->command->data_in_len :
-		  iscsi->command->data_out_len ) );
+		( task->command.data_in ? "in" : "out" ),
+		( task->command.data_in ?
+		  task->command.data_in_len :
+		  task->command.data_out_len ) );
+
+	/* Consume a command sequence number */
+	iscsi->cmdsn++;
+}
+
+/**
+ * Complete iSCSI SCSI command PDU transmission
+ *
+ * @v iscsi		iSCSI session
+ *
+ */
+static void iscsi_command_done ( struct iscsi_session *iscsi ) {
+	struct iscsi_bhs_scsi_command *command = &iscsi->tx_bhs.scsi_command;
+	struct iscsi_task *task;
+
+	/* Identify task; it may have been completed or cancelled
+	 * while the PDU was in transit.
+	 */
+	task = iscsi_find_task ( iscsi, ntohl ( command->itt ) );
+	if ( ! task )
+		return;
+
+	/* Schedule the remainder of the unsolicited burst, if any */
+	if ( task->command.data_out && task->transfer_len ) {
+		task->pending |= ISCSI_TASK_TX_DATA_OUT;
+	}
 }
 
 /**
@@ -410,6 +595,7 @@ static int iscsi_rx_scsi_response ( struct iscsi_session *iscsi,
 				    size_t remaining ) {
 	struct iscsi_bhs_scsi_response *response
 		= &iscsi->rx_bhs.scsi_response;
+	struct iscsi_task *task;
 	struct scsi_rsp rsp;
 	uint32_t residual_count;
 	size_t data_len;
@@ -444,8 +630,16 @@ static int iscsi_rx_scsi_response ( struct iscsi_session *iscsi,
 	if ( response->response != ISCSI_RESPONSE_COMMAND_COMPLETE )
 		return -EIO;
 
+	/* Identify task */
+	task = iscsi_find_task ( iscsi, ntohl ( response->itt ) );
+	if ( ! task ) {
+		DBGC ( iscsi, "iSCSI %p unexpected response ITT %08x\n",
+		       iscsi, ntohl ( response->itt ) );
+		return -EPROTO;
+	}
+
 	/* Mark as completed */
-	iscsi_scsi_done ( iscsi, 0, &rsp );
+	iscsi_task_done ( task, 0, &rsp );
 	return 0;
 }
 
@@ -462,14 +656,22 @@ static int iscsi_rx_data_in ( struct iscsi_session *iscsi,
 			      const void *data, size_t len,
 			      size_t remaining ) {
 	struct iscsi_bhs_data_in *data_in = &iscsi->rx_bhs.data_in;
+	struct iscsi_task *task;
 	unsigned long offset;
 
+	/* Identify task */
+	task = iscsi_find_task ( iscsi, ntohl ( data_in->itt ) );
+	if ( ! task ) {
+		DBGC ( iscsi, "iSCSI %p unexpected data-in ITT %08x\n",
+		       iscsi, ntohl ( data_in->itt ) );
+		return -EPROTO;
+	}
+
 	/* Copy data to data-in buffer */
 	offset = ntohl ( data_in->offset ) + iscsi->rx_offset;
-	assert ( iscsi->command != NULL );
-	assert ( iscsi->command->data_in );
-	assert ( ( offset + len ) <= iscsi->command->data_in_len );
-	copy_to_user ( iscsi->command->data_in, offset, data, len );
+	assert ( task->command.data_in );
+	assert ( ( offset + len ) <= task->command.data_in_len );
+	copy_to_user ( task->command.data_in, offset, data, len );
 
 	/* Wait for whole SCSI response to arrive */
 	if ( remaining )
@@ -477,10 +679,10 @@ static int iscsi_rx_data_in ( struct iscsi_session *iscsi,
 
 	/* Mark as completed if status is present */
 	if ( data_in->flags & ISCSI_DATA_FLAG_STATUS ) {
-		assert ( ( offset + len ) == iscsi->command->data_in_len );
+		assert ( ( offset + len ) == task->command.data_in_len );
 		assert ( data_in->flags & ISCSI_FLAG_FINAL );
 		/* iSCSI cannot return an error status via a data-in */
-		iscsi_scsi_done ( iscsi, 0, NULL );
+		iscsi_task_done ( task, 0, NULL );
 	}
 
 	return 0;
@@ -499,12 +701,23 @@ static int iscsi_rx_r2t ( struct iscsi_session *iscsi,
 			  const void *data __unused, size_t len __unused,
 			  size_t remaining __unused ) {
 	struct iscsi_bhs_r2t *r2t = &iscsi->rx_bhs.r2t;
+	struct iscsi_task *task;
+
+	/* Identify task */
+	task = iscsi_find_task ( iscsi, ntohl ( r2t->itt ) );
+	if ( ! task ) {
+		DBGC ( iscsi, "iSCSI %p unexpected R2T ITT %08x\n",
+		       iscsi, ntohl ( r2t->itt ) );
+		return -EPROTO;
+	}
 
-	/* Record transfer parameters and trigger first data-out */
-	iscsi->ttt = ntohl ( r2t->ttt );
-	iscsi->transfer_offset = ntohl ( r2t->offset );
-	iscsi->transfer_len = ntohl ( r2t->len );
-	iscsi_start_data_out ( iscsi, 0 );
+	/* Record transfer parameters and schedule first data-out */
+	task->ttt = ntohl ( r2t->ttt );
+	task->transfer_offset = ntohl ( r2t->offset );
+	task->transfer_len = ntohl ( r2t->len );
+	task->datasn = 0;
+	task->pending |= ISCSI_TASK_TX_DATA_OUT;
+	iscsi_tx_resume ( iscsi );
 
 	return 0;
 }
@@ -513,24 +726,24 @@ static int iscsi_rx_r2t ( struct iscsi_session *iscsi,
  * Build iSCSI data-out BHS
  *
  * @v iscsi		iSCSI session
- * @v datasn		Data sequence number within the transfer
+ * @v task		iSCSI task
  *
  */
 static void iscsi_start_data_out ( struct iscsi_session *iscsi,
-				   unsigned int datasn ) {
+				   struct iscsi_task *task ) {
 	struct iscsi_bhs_data_out *data_out = &iscsi->tx_bhs.data_out;
 	unsigned long offset;
 	unsigned long remaining;
 	unsigned long len;
 
-	/* We always send 512-byte Data-Out PDUs; this removes the
-	 * need to worry about the target's MaxRecvDataSegmentLength.
+	/* Send data-out PDUs of the largest data segment length that
+	 * the target has declared itself willing to receive.
 	 */
-	offset = datasn * 512;
-	remaining = iscsi->transfer_len - offset;
+	offset = ( task->datasn * iscsi->max_tx_len );
+	remaining = ( task->transfer_len - offset );
 	len = remaining;
-	if ( len > 512 )
-		len = 512;
+	if ( len > iscsi->max_tx_len )
+		len = iscsi->max_tx_len;
 
 	/* Construct BHS and initiate transmission */
 	iscsi_start_tx ( iscsi );
@@ -538,14 +751,14 @@ static void iscsi_start_data_out ( struct iscsi_session *iscsi,
 	if ( len == remaining )
 		data_out->flags = ( ISCSI_FLAG_FINAL );
 	ISCSI_SET_LENGTHS ( data_out->lengths, 0, len );
-	data_out->lun = iscsi->command->lun;
-	data_out->itt = htonl ( iscsi->itt );
-	data_out->ttt = htonl ( iscsi->ttt );
+	data_out->lun = task->command.lun;
+	data_out->itt = htonl ( task->itt );
+	data_out->ttt = htonl ( task->ttt );
 	data_out->expstatsn = htonl ( iscsi->statsn + 1 );
-	data_out->datasn = htonl ( datasn );
-	data_out->offset = htonl ( iscsi->transfer_offset + offset );
-	DBGC ( iscsi, "iSCSI %p start data out DataSN %#x len %#lx\n",
-	       iscsi, datasn, len );
+	data_out->datasn = htonl ( task->datasn );
+	data_out->offset = htonl ( task->transfer_offset + offset );
+	DBGC ( iscsi, "iSCSI %p start data out ITT %08x DataSN %#x len "
+	       "%#lx\n", iscsi, task->itt, task->datasn, len );
 }
 
 /**
@@ -556,12 +769,22 @@ static void iscsi_start_data_out ( struct iscsi_session *iscsi,
  */
 static void iscsi_data_out_done ( struct iscsi_session *iscsi ) {
 	struct iscsi_bhs_data_out *data_out = &iscsi->tx_bhs.data_out;
+	struct iscsi_task *task;
+
+	/* Identify task; it may have been completed or cancelled
+	 * while the PDU was in transit.
+	 */
+	task = iscsi_find_task ( iscsi, ntohl ( data_out->itt ) );
+	if ( ! task )
+		return;
 
-	/* If we haven't reached the end of the sequence, start
-	 * sending the next data-out PDU.
+	/* If we haven't reached the end of the sequence, schedule the
+	 * next data-out PDU.
 	 */
-	if ( ! ( data_out->flags & ISCSI_FLAG_FINAL ) )
-		iscsi_start_data_out ( iscsi, ntohl ( data_out->datasn ) + 1 );
+	if ( ! ( data_out->flags & ISCSI_FLAG_FINAL ) ) {
+		task->datasn++;
+		task->pending |= ISCSI_TASK_TX_DATA_OUT;
+	}
 }
 
 /**
@@ -569,28 +792,43 @@ static void iscsi_data_out_done ( struct iscsi_session *iscsi ) {
  *
  * @v iscsi		iSCSI session
  * @ret rc		Return status code
+ *
+ * This is used both for data-out PDUs and for immediate data carried
+ * within a SCSI command PDU.
  */
 static int iscsi_tx_data_out ( struct iscsi_session *iscsi ) {
 	struct iscsi_bhs_data_out *data_out = &iscsi->tx_bhs.data_out;
+	struct iscsi_task *task;
 	struct io_buffer *iobuf;
 	unsigned long offset;
 	size_t len;
 	size_t pad_len;
 
-	offset = ntohl ( data_out->offset );
+	/* Immediate data within a command PDU always starts at the
+	 * beginning of the data-out buffer; data-out PDUs carry an
+	 * explicit buffer offset.
+	 */
+	if ( ( data_out->opcode & ISCSI_OPCODE_MASK ) == ISCSI_OPCODE_DATA_OUT ) {
+		offset = ntohl ( data_out->offset );
+	} else {
+		offset = 0;
+	}
 	len = ISCSI_DATA_LEN ( data_out->lengths );
 	pad_len = ISCSI_DATA_PAD_LEN ( data_out->lengths );
 
-	assert ( iscsi->command != NULL );
-	assert ( iscsi->command->data_out );
-	assert ( ( offset + len ) <= iscsi->command->data_out_len );
+	/* Identify task */
+	task = iscsi_find_task ( iscsi, ntohl ( data_out->itt ) );
+	if ( ! task )
+		return -EPROTO;
+	assert ( task->command.data_out );
+	assert ( ( offset + len ) <= task->command.data_out_len );
 
 	iobuf = xfer_alloc_iob ( &iscsi->socket, ( len + pad_len ) );
 	if ( ! iobuf )
 		return -ENOMEM;
-	
+
 	copy_from_user ( iob_put ( iobuf, len ),
-			 iscsi->command->data_out, offset, len );
+			 task->command.data_out, offset, len );
 	memset ( iob_put ( iobuf, pad_len ), 0, pad_len );
 
 	return xfer_deliver_iob ( &iscsi->socket, iobuf );
@@ -645,11 +883,11 @@ static int iscsi_rx_nop_in ( struct iscsi_session *iscsi,
  *     HeaderDigest=None
  *     DataDigest=None
  *     MaxConnections=1 (irrelevant; we make only one connection anyway) [4]
- *     InitialR2T=Yes [1]
- *     ImmediateData=No (irrelevant; we never send immediate data) [4]
+ *     InitialR2T=No [1]
+ *     ImmediateData=Yes [1]
  *     MaxRecvDataSegmentLength=8192 (default; we don't care) [3]
- *     MaxBurstLength=262144 (default; we don't care) [3]
- *     FirstBurstLength=65536 (irrelevant due to other settings) [5]
+ *     MaxBurstLength=16777215 [5]
+ *     FirstBurstLength=65536 (default) [5]
  *     DefaultTime2Wait=0 [2]
  *     DefaultTime2Retain=0 [2]
  *     MaxOutstandingR2T=1
@@ -657,9 +895,10 @@ static int iscsi_rx_nop_in ( struct iscsi_session *iscsi,
  *     DataSequenceInOrder=Yes
  *     ErrorRecoveryLevel=0
  *
- * [1] InitialR2T has an OR resolution function, so the target may
- * force us to use it.  We therefore simplify our logic by always
- * using it.
+ * [1] InitialR2T has an OR resolution function and ImmediateData an
+ * AND resolution function, so the target may still force us to wait
+ * for an R2T before sending any data.  We record the negotiation
+ * results and fall back to fully solicited transfers if required.
  *
  * [2] These ensure that we can safely start a new task once we have
  * reconnected after a failure, without having to manually tidy up
@@ -675,10 +914,11 @@ static int iscsi_rx_nop_in ( struct iscsi_session *iscsi,
  * unless they are supplied, so we explicitly specify the default
  * values.
  *
- * [5] FirstBurstLength is defined to be irrelevant since we already
- * force InitialR2T=Yes and ImmediateData=No, but some targets
- * (notably LIO as of kernel 4.11) fail unless it is specified, so we
- * explicitly specify the default value.
+ * [5] FirstBurstLength bounds the unsolicited data (immediate data
+ * plus unsolicited data-out PDUs) that we may send for a single
+ * command, and MaxBurstLength bounds each solicited data-out
+ * sequence.  We offer the protocol maximum for MaxBurstLength and
+ * accept whatever the target selects.
  */
 static int iscsi_build_login_request_strings ( struct iscsi_session *iscsi,
 					       void *data, size_t len ) {
@@ -733,18 +973,20 @@ static int iscsi_build_login_request_strings ( struct iscsi_session *iscsi,
 				    "HeaderDigest=None%c"
 				    "DataDigest=None%c"
 				    "MaxConnections=1%c"
-				    "InitialR2T=Yes%c"
-				    "ImmediateData=No%c"
+				    "InitialR2T=No%c"
+				    "ImmediateData=Yes%c"
 				    "MaxRecvDataSegmentLength=8192%c"
-				    "MaxBurstLength=262144%c"
-				    "FirstBurstLength=65536%c"
+				    "MaxBurstLength=%d%c"
+				    "FirstBurstLength=%d%c"
 				    "DefaultTime2Wait=0%c"
 				    "DefaultTime2Retain=0%c"
 				    "MaxOutstandingR2T=1%c"
 				    "DataPDUInOrder=Yes%c"
 				    "DataSequenceInOrder=Yes%c"
 				    "ErrorRecoveryLevel=0%c",
-				    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 );
+				    0, 0, 0, 0, 0, 0, ISCSI_MAX_BURST_LEN, 0,
+				    ISCSI_FIRST_BURST_LEN, 0, 0, 0, 0, 0, 0,
+				    0 );
 	}
 
 	return used;
@@ -1127,6 +1369,109 @@ static int iscsi_handle_chap_r_value ( struct iscsi_session *iscsi,
 	return rc;
 }
 
+/**
+ * Handle iSCSI InitialR2T text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		InitialR2T value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_initialr2t_value ( struct iscsi_session *iscsi,
+					   const char *value ) {
+
+	/* InitialR2T has an OR resolution function, so the target may
+	 * force us to wait for an R2T before sending any data.
+	 */
+	if ( strcmp ( value, "No" ) == 0 ) {
+		iscsi->status &= ~ISCSI_STATUS_INITIAL_R2T;
+	} else {
+		iscsi->status |= ISCSI_STATUS_INITIAL_R2T;
+	}
+	return 0;
+}
+
+/**
+ * Handle iSCSI ImmediateData text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		ImmediateData value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_immediatedata_value ( struct iscsi_session *iscsi,
+					      const char *value ) {
+
+	/* ImmediateData has an AND resolution function, so the target
+	 * may decline to accept data within the command PDU itself.
+	 */
+	if ( strcmp ( value, "Yes" ) == 0 ) {
+		iscsi->status &= ~ISCSI_STATUS_NO_IMMEDIATE_DATA;
+	} else {
+		iscsi->status |= ISCSI_STATUS_NO_IMMEDIATE_DATA;
+	}
+	return 0;
+}
+
+/**
+ * Handle iSCSI MaxRecvDataSegmentLength text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		MaxRecvDataSegmentLength value
+ * @ret rc		Return status code
+ */
+static int
+iscsi_handle_maxrecvdatasegmentlength_value ( struct iscsi_session *iscsi,
+					      const char *value ) {
+	char *endp;
+	unsigned long len;
+
+	/* This is the length declared by the target, which limits the
+	 * data segment of each PDU that we transmit.
+	 */
+	len = strtoul ( value, &endp, 10 );
+	if ( ( *endp != '\0' ) || ( len == 0 ) )
+		return -EPROTO_INVALID_KEY_VALUE_PAIR;
+	iscsi->max_tx_len = len;
+	return 0;
+}
+
+/**
+ * Handle iSCSI MaxBurstLength text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		MaxBurstLength value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_maxburstlength_value ( struct iscsi_session *iscsi,
+					       const char *value ) {
+	char *endp;
+	unsigned long len;
+
+	len = strtoul ( value, &endp, 10 );
+	if ( ( *endp != '\0' ) || ( len == 0 ) )
+		return -EPROTO_INVALID_KEY_VALUE_PAIR;
+	iscsi->max_burst_len = len;
+	return 0;
+}
+
+/**
+ * Handle iSCSI FirstBurstLength text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		FirstBurstLength value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_firstburstlength_value ( struct iscsi_session *iscsi,
+						 const char *value ) {
+	char *endp;
+	unsigned long len;
+
+	len = strtoul ( value, &endp, 10 );
+	if ( ( *endp != '\0' ) || ( len == 0 ) )
+		return -EPROTO_INVALID_KEY_VALUE_PAIR;
+	iscsi->first_burst_len = len;
+	return 0;
+}
+
 /** An iSCSI text string that we want to handle */
 struct iscsi_string_type {
 	/** String key
@@ -1153,6 +1498,12 @@ static struct iscsi_string_type iscsi_string_types[] = {
 	{ "CHAP_C", iscsi_handle_chap_c_value },
 	{ "CHAP_N", iscsi_handle_chap_n_value },
 	{ "CHAP_R", iscsi_handle_chap_r_value },
+	{ "InitialR2T", iscsi_handle_initialr2t_value },
+	{ "ImmediateData", iscsi_handle_immediatedata_value },
+	{ "MaxRecvDataSegmentLength",
+	  iscsi_handle_maxrecvdatasegmentlength_value },
+	{ "MaxBurstLength", iscsi_handle_maxburstlength_value },
+	{ "FirstBurstLength", iscsi_handle_firstburstlength_value },
 	{ NULL, NULL }
 };
 
@@ -1445,6 +1796,9 @@ static int iscsi_tx_data ( struct iscsi_session *iscsi ) {
 	struct iscsi_bhs_common *common = &iscsi->tx_bhs.common;
 
 	switch ( common->opcode & ISCSI_OPCODE_MASK ) {
+	case ISCSI_OPCODE_SCSI_COMMAND:
+		/* Immediate data */
+		return iscsi_tx_data_out ( iscsi );
 	case ISCSI_OPCODE_DATA_OUT:
 		return iscsi_tx_data_out ( iscsi );
 	case ISCSI_OPCODE_LOGIN_REQUEST:
@@ -1471,6 +1825,9 @@ static void iscsi_tx_done ( struct iscsi_session *iscsi ) {
 	iscsi_tx_pause ( iscsi );
 
 	switch ( common->opcode & ISCSI_OPCODE_MASK ) {
+	case ISCSI_OPCODE_SCSI_COMMAND:
+		iscsi_command_done ( iscsi );
+		break;
 	case ISCSI_OPCODE_DATA_OUT:
 		iscsi_data_out_done ( iscsi );
 		break;
@@ -1483,13 +1840,48 @@ static void iscsi_tx_done ( struct iscsi_session *iscsi ) {
 	}
 }
 
+/**
+ * Start transmission of next pending PDU, if any
+ *
+ * @v iscsi		iSCSI session
+ * @ret started		A PDU transmission has been started
+ *
+ * Data-out PDUs take priority over new command PDUs, since the target
+ * is actively waiting for them.  Command PDUs are sent only while
+ * CmdSN lies within the target's advertised command window.
+ */
+static int iscsi_tx_next ( struct iscsi_session *iscsi ) {
+	struct iscsi_task *task;
+
+	/* Send any pending data-out PDUs */
+	list_for_each_entry ( task, &iscsi->tasks, list ) {
+		if ( task->pending & ISCSI_TASK_TX_DATA_OUT ) {
+			task->pending &= ~ISCSI_TASK_TX_DATA_OUT;
+			iscsi_start_data_out ( iscsi, task );
+			return 1;
+		}
+	}
+
+	/* Send any pending command PDUs, if the command window allows */
+	list_for_each_entry ( task, &iscsi->tasks, list ) {
+		if ( ( task->pending & ISCSI_TASK_TX_CMD ) &&
+		     ( ! iscsi_sn_after ( iscsi->cmdsn, iscsi->maxcmdsn ) ) ) {
+			task->pending &= ~ISCSI_TASK_TX_CMD;
+			iscsi_start_command ( iscsi, task );
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
 /**
  * Transmit iSCSI PDU
  *
  * @v iscsi		iSCSI session
  * @v buf		Temporary data buffer
  * @v len		Length of temporary data buffer
- * 
+ *
  * Constructs data to be sent for the current TX state
  */
 static void iscsi_tx_step ( struct iscsi_session *iscsi ) {
@@ -1518,6 +1910,9 @@ static void iscsi_tx_step ( struct iscsi_session *iscsi ) {
 			next_state = ISCSI_TX_IDLE;
 			break;
 		case ISCSI_TX_IDLE:
+			/* Start the next pending PDU, if any */
+			if ( iscsi_tx_next ( iscsi ) )
+				continue;
 			/* Nothing to do; pause processing */
 			iscsi_tx_pause ( iscsi );
 			return;
@@ -1617,10 +2012,17 @@ static int iscsi_rx_data ( struct iscsi_session *iscsi, const void *data,
 	struct iscsi_bhs_common_response *response
 		= &iscsi->rx_bhs.common_response;
 
-	/* Update cmdsn and statsn */
-	iscsi->cmdsn = ntohl ( response->expcmdsn );
+	/* Update cmdsn (using serial number arithmetic), maxcmdsn and
+	 * statsn
+	 */
+	if ( iscsi_sn_after ( ntohl ( response->expcmdsn ), iscsi->cmdsn ) )
+		iscsi->cmdsn = ntohl ( response->expcmdsn );
+	iscsi->maxcmdsn = ntohl ( response->maxcmdsn );
 	iscsi->statsn = ntohl ( response->statsn );
 
+	/* The command window may have reopened; restart transmission */
+	iscsi_tx_resume ( iscsi );
+
 	switch ( response->opcode & ISCSI_OPCODE_MASK ) {
 	case ISCSI_OPCODE_LOGIN_RESPONSE:
 		return iscsi_rx_login_response ( iscsi, data, len, remaining );
@@ -1797,17 +2199,46 @@ static struct interface_descriptor iscsi_socket_desc =
  * @ret len		Length of window
  */
 static size_t iscsi_scsi_window ( struct iscsi_session *iscsi ) {
+	struct iscsi_task *task;
+	size_t window = ISCSI_MAX_TASKS;
 
-	if ( ( ( iscsi->status & ISCSI_STATUS_PHASE_MASK ) ==
-	       ISCSI_STATUS_FULL_FEATURE_PHASE ) &&
-	     ( iscsi->command == NULL ) ) {
-		/* We cannot handle concurrent commands */
-		return 1;
-	} else {
+	/* Commands cannot be issued before login is complete */
+	if ( ( iscsi->status & ISCSI_STATUS_PHASE_MASK ) !=
+	     ISCSI_STATUS_FULL_FEATURE_PHASE )
 		return 0;
+
+	/* Count remaining free task slots */
+	list_for_each_entry ( task, &iscsi->tasks, list ) {
+		if ( window )
+			window--;
 	}
+	return window;
 }
 
+/**
+ * Close iSCSI task
+ *
+ * @v task		iSCSI task
+ * @v rc		Reason for close
+ */
+static void iscsi_task_close ( struct iscsi_task *task, int rc ) {
+
+	/* Treat unsolicited closures of outstanding tasks as fatal,
+	 * because we have no code to handle partially-completed PDUs.
+	 */
+	if ( ! task->completed )
+		iscsi_close ( task->iscsi, ( ( rc == 0 ) ? -ECANCELED : rc ) );
+}
+
+/** iSCSI task interface operations */
+static struct interface_operation iscsi_task_op[] = {
+	INTF_OP ( intf_close, struct iscsi_task *, iscsi_task_close ),
+};
+
+/** iSCSI task interface descriptor */
+static struct interface_descriptor iscsi_task_desc =
+	INTF_DESC ( struct iscsi_task, data, iscsi_task_op );
+
 /**
  * Issue iSCSI SCSI command
  *
@@ -1819,31 +2250,35 @@ static size_t iscsi_scsi_window ( struct iscsi_session *iscsi ) {
 static int iscsi_scsi_command ( struct iscsi_session *iscsi,
 				struct interface *parent,
 				struct scsi_cmd *command ) {
+	struct iscsi_task *task;
 
-	/* This iSCSI implementation cannot handle multiple concurrent
-	 * commands or commands arriving before login is complete.
+	/* Refuse commands arriving before login is complete or
+	 * beyond our concurrency limit.
 	 */
 	if ( iscsi_scsi_window ( iscsi ) == 0 ) {
-		DBGC ( iscsi, "iSCSI %p cannot handle concurrent commands\n",
-		       iscsi );
+		DBGC ( iscsi, "iSCSI %p cannot accept new commands\n", iscsi );
 		return -EOPNOTSUPP;
 	}
 
-	/* Store command */
-	iscsi->command = malloc ( sizeof ( *command ) );
-	if ( ! iscsi->command )
+	/* Allocate and initialise task */
+	task = zalloc ( sizeof ( *task ) );
+	if ( ! task )
 		return -ENOMEM;
-	memcpy ( iscsi->command, command, sizeof ( *command ) );
-
-	/* Assign new ITT */
-	iscsi_new_itt ( iscsi );
-
-	/* Start sending command */
-	iscsi_start_command ( iscsi );
+	ref_init ( &task->refcnt, iscsi_task_free );
+	intf_init ( &task->data, &iscsi_task_desc, &task->refcnt );
+	task->iscsi = iscsi;
+	ref_get ( &iscsi->refcnt );
+	memcpy ( &task->command, command, sizeof ( task->command ) );
+	task->itt = iscsi_new_itt();
+	task->pending = ISCSI_TASK_TX_CMD;
+
+	/* Add to list of outstanding tasks and schedule transmission */
+	list_add_tail ( &task->list, &iscsi->tasks );
+	iscsi_tx_resume ( iscsi );
 
 	/* Attach to parent interface and return */
-	intf_plug_plug ( &iscsi->data, parent );
-	return iscsi->itt;
+	intf_plug_plug ( &task->data, parent );
+	return task->itt;
 }
 
 /**
@@ -1869,33 +2304,6 @@ static struct interface_operation iscsi_control_op[] = {
 static struct interface_descriptor iscsi_control_desc =
 	INTF_DESC ( struct iscsi_session, control, iscsi_control_op );
 
-/**
- * Close iSCSI command
- *
- * @v iscsi		iSCSI session
- * @v rc		Reason for close
- */
-static void iscsi_command_close ( struct iscsi_session *iscsi, int rc ) {
-
-	/* Restart interface */
-	intf_restart ( &iscsi->data, rc );
-
-	/* Treat unsolicited command closures mid-command as fatal,
-	 * because we have no code to handle partially-completed PDUs.
-	 */
-	if ( iscsi->command != NULL )
-		iscsi_close ( iscsi, ( ( rc == 0 ) ? -ECANCELED : rc ) );
-}
-
-/** iSCSI SCSI command interface operations */
-static struct interface_operation iscsi_data_op[] = {
-	INTF_OP ( intf_close, struct iscsi_session *, iscsi_command_close ),
-};
-
-/** iSCSI SCSI command interface descriptor */
-static struct interface_descriptor iscsi_data_desc =
-	INTF_DESC ( struct iscsi_session, data, iscsi_data_op );
-
 /****************************************************************************
  *
  * Instantiator
@@ -2130,8 +2538,8 @@ static int iscsi_open ( struct interface *parent, struct uri *uri ) {
 	}
 	ref_init ( &iscsi->refcnt, iscsi_free );
 	intf_init ( &iscsi->control, &iscsi_control_desc, &iscsi->refcnt );
-	intf_init ( &iscsi->data, &iscsi_data_desc, &iscsi->refcnt );
 	intf_init ( &iscsi->socket, &iscsi_socket_desc, &iscsi->refcnt );
+	INIT_LIST_HEAD ( &iscsi->tasks );
 	process_init_stopped ( &iscsi->process, &iscsi_process_desc,
 			       &iscsi->refcnt );
 	acpi_init ( &iscsi->desc, &ibft_model, &iscsi->refcnt );
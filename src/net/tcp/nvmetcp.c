@@ -0,0 +1,1521 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/socket.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/uri.h>
+#include <ipxe/xfer.h>
+#include <ipxe/open.h>
+#include <ipxe/uaccess.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/settings.h>
+#include <ipxe/blockdev.h>
+#include <ipxe/nvmetcp.h>
+
+/** @file
+ *
+ * NVMe over TCP protocol
+ *
+ * This file implements an NVMe/TCP initiator offering the block
+ * device interface expected by the SAN boot code.  Each NVMe queue
+ * pair maps to its own TCP connection: one admin queue used to enable
+ * the controller and identify the boot namespace, and one or more I/O
+ * queues over which block commands are issued round-robin.  The
+ * protocol's lack of doorbell registers fits iPXE's polling model
+ * directly: command capsules and data are simply written to the
+ * socket, and completions arrive as response capsules.
+ */
+
+/* Disambiguate the various error causes */
+#define EINVAL_NO_SUBSYSTEM_NQN \
+	__einfo_error ( EINFO_EINVAL_NO_SUBSYSTEM_NQN )
+#define EINFO_EINVAL_NO_SUBSYSTEM_NQN \
+	__einfo_uniqify ( EINFO_EINVAL, 0x01, "No subsystem NQN" )
+#define EPROTO_ICRESP \
+	__einfo_error ( EINFO_EPROTO_ICRESP )
+#define EINFO_EPROTO_ICRESP \
+	__einfo_uniqify ( EINFO_EPROTO, 0x01, "Invalid connection response" )
+#define EPROTO_INVALID_PDU \
+	__einfo_error ( EINFO_EPROTO_INVALID_PDU )
+#define EINFO_EPROTO_INVALID_PDU \
+	__einfo_uniqify ( EINFO_EPROTO, 0x02, "Invalid PDU" )
+#define EPROTO_INVALID_DATA \
+	__einfo_error ( EINFO_EPROTO_INVALID_DATA )
+#define EINFO_EPROTO_INVALID_DATA \
+	__einfo_uniqify ( EINFO_EPROTO, 0x03, "Invalid data transfer" )
+#define EPROTO_TERMINATED \
+	__einfo_error ( EINFO_EPROTO_TERMINATED )
+#define EINFO_EPROTO_TERMINATED \
+	__einfo_uniqify ( EINFO_EPROTO, 0x04, "Connection terminated" )
+#define EIO_CQE_STATUS \
+	__einfo_error ( EINFO_EIO_CQE_STATUS )
+#define EINFO_EIO_CQE_STATUS \
+	__einfo_uniqify ( EINFO_EIO, 0x01, "Command failed" )
+
+/** Maximum number of I/O queues */
+#define NVMETCP_MAX_IO_QUEUES 2
+
+/** I/O queue depth (requested via the Connect command's SQSIZE) */
+#define NVMETCP_QUEUE_DEPTH 64
+
+/** Admin queue depth */
+#define NVMETCP_ADMIN_QUEUE_DEPTH 32
+
+/** Maximum data transfer per block command
+ *
+ * Used to derive the maximum block count reported to the SAN boot
+ * code.
+ */
+#define NVMETCP_MAX_XFER_LEN 131072
+
+/** Host NQN used when no hostname is available */
+#define NVMETCP_HOSTNQN_BASE "nqn.2010-04.org.ipxe"
+
+struct nvmetcp_session;
+
+/** NVMe/TCP queue state */
+enum nvmetcp_queue_state {
+	/** Waiting for the TCP connection to be established */
+	NVMETCP_QUEUE_IDLE = 0,
+	/** ICReq sent; waiting for ICResp */
+	NVMETCP_QUEUE_ICREQ,
+	/** Connect command sent; waiting for completion */
+	NVMETCP_QUEUE_CONNECT,
+	/** Queue is usable */
+	NVMETCP_QUEUE_READY,
+};
+
+/** An NVMe/TCP queue pair (one TCP connection) */
+struct nvmetcp_queue {
+	/** Containing session */
+	struct nvmetcp_session *nvmetcp;
+	/** Transport socket */
+	struct interface socket;
+	/** Queue ID */
+	uint16_t qid;
+	/** Queue state */
+	enum nvmetcp_queue_state state;
+	/** Command identifier counter */
+	uint16_t cid_idx;
+	/** Maximum data per H2CData PDU (from ICResp) */
+	size_t maxh2cdata;
+	/** List of outstanding block commands */
+	struct list_head commands;
+	/** Byte offset within the PDU currently being received */
+	size_t rx_offset;
+	/** Buffered portion of the current PDU's header
+	 *
+	 * Sized for the largest defined PDU header (ICResp).
+	 */
+	uint8_t rx_header[ sizeof ( struct nvmetcp_icresp ) ];
+};
+
+/** NVMe/TCP session state
+ *
+ * These states track the admin command sequence used to bring the
+ * controller to the point where I/O commands may be issued.
+ */
+enum nvmetcp_session_state {
+	/** Admin queue is being established */
+	NVMETCP_ADMIN_CONNECT = 0,
+	/** Property Set enabling the controller is outstanding */
+	NVMETCP_ENABLE,
+	/** Property Get polling controller readiness is outstanding */
+	NVMETCP_WAIT_READY,
+	/** Set Features requesting I/O queues is outstanding */
+	NVMETCP_SET_QUEUES,
+	/** Identify Namespace is outstanding */
+	NVMETCP_IDENTIFY,
+	/** I/O queues are being established */
+	NVMETCP_CONNECT_IO,
+	/** Session is ready for block commands */
+	NVMETCP_READY,
+};
+
+/** An NVMe/TCP session */
+struct nvmetcp_session {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Block device interface */
+	struct interface block;
+	/** Session state */
+	enum nvmetcp_session_state state;
+
+	/** Target address */
+	char *target;
+	/** Target port */
+	unsigned int port;
+	/** Subsystem NQN */
+	char *subnqn;
+	/** Namespace ID */
+	uint32_t nsid;
+	/** Host NQN */
+	char hostnqn[256];
+	/** Host identifier */
+	uint8_t hostid[16];
+
+	/** Controller ID (from the admin Connect response) */
+	uint16_t cntlid;
+	/** Command ID of the outstanding internal admin command */
+	uint16_t admin_cid;
+	/** Number of I/O queues in use */
+	unsigned int nr_io_queues;
+	/** Round-robin counter for I/O queue selection */
+	unsigned int io_rr;
+
+	/** Admin queue */
+	struct nvmetcp_queue admin;
+	/** I/O queues */
+	struct nvmetcp_queue io[NVMETCP_MAX_IO_QUEUES];
+
+	/** Namespace capacity */
+	struct block_device_capacity capacity;
+	/** Identify data buffer */
+	uint8_t ident[NVME_IDENTIFY_LEN];
+};
+
+/** An NVMe/TCP block command */
+struct nvmetcp_command {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Containing session */
+	struct nvmetcp_session *nvmetcp;
+	/** Queue on which this command was issued */
+	struct nvmetcp_queue *queue;
+	/** List of outstanding commands on the queue */
+	struct list_head list;
+	/** Block data interface */
+	struct interface block;
+	/** Command identifier */
+	uint16_t cid;
+	/** Data buffer */
+	userptr_t buffer;
+	/** Data buffer length */
+	size_t len;
+};
+
+static void nvmetcp_close ( struct nvmetcp_session *nvmetcp, int rc );
+
+/**
+ * Get reference to session
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @ret nvmetcp		NVMe/TCP session
+ */
+static inline struct nvmetcp_session *
+nvmetcp_get ( struct nvmetcp_session *nvmetcp ) {
+	ref_get ( &nvmetcp->refcnt );
+	return nvmetcp;
+}
+
+/**
+ * Drop reference to session
+ *
+ * @v nvmetcp		NVMe/TCP session
+ */
+static inline void nvmetcp_put ( struct nvmetcp_session *nvmetcp ) {
+	ref_put ( &nvmetcp->refcnt );
+}
+
+/******************************************************************************
+ *
+ * Block commands
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Free NVMe/TCP command
+ *
+ * @v refcnt		Reference count
+ */
+static void nvmetcp_command_free ( struct refcnt *refcnt ) {
+	struct nvmetcp_command *cmd =
+		container_of ( refcnt, struct nvmetcp_command, refcnt );
+
+	nvmetcp_put ( cmd->nvmetcp );
+	free ( cmd );
+}
+
+/**
+ * Complete NVMe/TCP command
+ *
+ * @v cmd		NVMe/TCP command
+ * @v rc		Reason for completion
+ */
+static void nvmetcp_command_done ( struct nvmetcp_command *cmd, int rc ) {
+	struct nvmetcp_session *nvmetcp = cmd->nvmetcp;
+
+	if ( rc != 0 ) {
+		DBGC ( nvmetcp, "NVMeTCP %p/%d cid %04x failed: %s\n", nvmetcp,
+		       cmd->queue->qid, cmd->cid, strerror ( rc ) );
+	}
+
+	/* Remove from list of outstanding commands, if applicable */
+	if ( ! list_empty ( &cmd->list ) ) {
+		list_del ( &cmd->list );
+		INIT_LIST_HEAD ( &cmd->list );
+		ref_put ( &cmd->refcnt );
+	}
+
+	/* Shut down interfaces */
+	intf_shutdown ( &cmd->block, rc );
+}
+
+/**
+ * Identify outstanding command by command identifier
+ *
+ * @v queue		NVMe/TCP queue
+ * @v cid		Command identifier
+ * @ret cmd		NVMe/TCP command, or NULL
+ */
+static struct nvmetcp_command *
+nvmetcp_find_command ( struct nvmetcp_queue *queue, unsigned int cid ) {
+	struct nvmetcp_command *cmd;
+
+	list_for_each_entry ( cmd, &queue->commands, list ) {
+		if ( cmd->cid == cid )
+			return cmd;
+	}
+	return NULL;
+}
+
+/** NVMe/TCP command block interface operations */
+static struct interface_operation nvmetcp_command_block_op[] = {
+	INTF_OP ( intf_close, struct nvmetcp_command *, nvmetcp_command_done ),
+};
+
+/** NVMe/TCP command block interface descriptor */
+static struct interface_descriptor nvmetcp_command_block_desc =
+	INTF_DESC ( struct nvmetcp_command, block, nvmetcp_command_block_op );
+
+/**
+ * Create NVMe/TCP command
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @v queue		NVMe/TCP queue
+ * @v buffer		Data buffer
+ * @v len		Length of data buffer
+ * @ret cmd		NVMe/TCP command, or NULL
+ */
+static struct nvmetcp_command *
+nvmetcp_command_create ( struct nvmetcp_session *nvmetcp,
+			 struct nvmetcp_queue *queue,
+			 userptr_t buffer, size_t len ) {
+	struct nvmetcp_command *cmd;
+
+	cmd = zalloc ( sizeof ( *cmd ) );
+	if ( ! cmd )
+		return NULL;
+	ref_init ( &cmd->refcnt, nvmetcp_command_free );
+	intf_init ( &cmd->block, &nvmetcp_command_block_desc, &cmd->refcnt );
+	INIT_LIST_HEAD ( &cmd->list );
+	cmd->nvmetcp = nvmetcp_get ( nvmetcp );
+	cmd->queue = queue;
+	cmd->cid = queue->cid_idx++;
+	cmd->buffer = buffer;
+	cmd->len = len;
+
+	return cmd;
+}
+
+/******************************************************************************
+ *
+ * PDU transmission
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Transmit Initialize Connection Request PDU
+ *
+ * @v queue		NVMe/TCP queue
+ * @ret rc		Return status code
+ */
+static int nvmetcp_tx_icreq ( struct nvmetcp_queue *queue ) {
+	struct io_buffer *iobuf;
+	struct nvmetcp_icreq *icreq;
+
+	iobuf = xfer_alloc_iob ( &queue->socket, sizeof ( *icreq ) );
+	if ( ! iobuf )
+		return -ENOMEM;
+
+	icreq = iob_put ( iobuf, sizeof ( *icreq ) );
+	memset ( icreq, 0, sizeof ( *icreq ) );
+	icreq->hdr.type = NVMETCP_ICREQ;
+	icreq->hdr.hlen = sizeof ( *icreq );
+	icreq->hdr.plen = cpu_to_le32 ( sizeof ( *icreq ) );
+	/* PFV 0, no data alignment, no digests, one outstanding R2T */
+
+	return xfer_deliver_iob ( &queue->socket, iobuf );
+}
+
+/**
+ * Transmit fabrics Connect command capsule
+ *
+ * @v queue		NVMe/TCP queue
+ * @ret rc		Return status code
+ *
+ * The Connect command's data is always transferred within the
+ * capsule.
+ */
+static int nvmetcp_tx_connect ( struct nvmetcp_queue *queue ) {
+	struct nvmetcp_session *nvmetcp = queue->nvmetcp;
+	struct io_buffer *iobuf;
+	struct nvmetcp_pdu_header *hdr;
+	struct nvme_connect_sqe *connect;
+	struct nvme_connect_data *data;
+	size_t len = ( sizeof ( *hdr ) + sizeof ( *connect ) +
+		       sizeof ( *data ) );
+	unsigned int depth;
+	uint16_t cid;
+
+	iobuf = xfer_alloc_iob ( &queue->socket, len );
+	if ( ! iobuf )
+		return -ENOMEM;
+
+	cid = queue->cid_idx++;
+	if ( queue->qid == 0 )
+		nvmetcp->admin_cid = cid;
+	depth = ( ( queue->qid == 0 ) ?
+		  NVMETCP_ADMIN_QUEUE_DEPTH : NVMETCP_QUEUE_DEPTH );
+
+	hdr = iob_put ( iobuf, sizeof ( *hdr ) );
+	memset ( hdr, 0, sizeof ( *hdr ) );
+	hdr->type = NVMETCP_CMD;
+	hdr->hlen = ( sizeof ( *hdr ) + sizeof ( *connect ) );
+	hdr->pdo = hdr->hlen;
+	hdr->plen = cpu_to_le32 ( len );
+
+	connect = iob_put ( iobuf, sizeof ( *connect ) );
+	memset ( connect, 0, sizeof ( *connect ) );
+	connect->opcode = NVME_OPCODE_FABRICS;
+	connect->flags = NVME_SQE_FLAG_SGL;
+	connect->cid = cpu_to_le16 ( cid );
+	connect->fctype = NVME_FCTYPE_CONNECT;
+	connect->sgl.length = cpu_to_le32 ( sizeof ( *data ) );
+	connect->sgl.type = NVME_SGL_TRANSPORT_DATA_BLOCK;
+	connect->qid = cpu_to_le16 ( queue->qid );
+	connect->sqsize = cpu_to_le16 ( depth - 1 );
+	/* Keep-alive is left disabled; SAN boot sessions poll the
+	 * connection continuously and are torn down on any error.
+	 */
+
+	data = iob_put ( iobuf, sizeof ( *data ) );
+	memset ( data, 0, sizeof ( *data ) );
+	memcpy ( data->hostid, nvmetcp->hostid, sizeof ( data->hostid ) );
+	data->cntlid = cpu_to_le16 ( ( queue->qid == 0 ) ?
+				     NVME_CNTLID_ANY : nvmetcp->cntlid );
+	snprintf ( data->subnqn, sizeof ( data->subnqn ), "%s",
+		   nvmetcp->subnqn );
+	snprintf ( data->hostnqn, sizeof ( data->hostnqn ), "%s",
+		   nvmetcp->hostnqn );
+
+	return xfer_deliver_iob ( &queue->socket, iobuf );
+}
+
+/**
+ * Transmit command capsule containing a plain SQE
+ *
+ * @v queue		NVMe/TCP queue
+ * @v sqe		Submission queue entry
+ * @ret rc		Return status code
+ */
+static int nvmetcp_tx_sqe ( struct nvmetcp_queue *queue,
+			    const struct nvme_sqe *sqe ) {
+	struct io_buffer *iobuf;
+	struct nvmetcp_pdu_header *hdr;
+	size_t len = ( sizeof ( *hdr ) + sizeof ( *sqe ) );
+
+	iobuf = xfer_alloc_iob ( &queue->socket, len );
+	if ( ! iobuf )
+		return -ENOMEM;
+
+	hdr = iob_put ( iobuf, sizeof ( *hdr ) );
+	memset ( hdr, 0, sizeof ( *hdr ) );
+	hdr->type = NVMETCP_CMD;
+	hdr->hlen = len;
+	hdr->plen = cpu_to_le32 ( len );
+	memcpy ( iob_put ( iobuf, sizeof ( *sqe ) ), sqe, sizeof ( *sqe ) );
+
+	return xfer_deliver_iob ( &queue->socket, iobuf );
+}
+
+/**
+ * Transmit fabrics Property Get/Set command capsule on the admin queue
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @v fctype		Fabrics command type
+ * @v ofst		Property offset
+ * @v value		Value (for Property Set)
+ * @ret rc		Return status code
+ */
+static int nvmetcp_tx_property ( struct nvmetcp_session *nvmetcp,
+				 unsigned int fctype, unsigned int ofst,
+				 uint64_t value ) {
+	struct nvmetcp_queue *queue = &nvmetcp->admin;
+	union {
+		struct nvme_property_sqe property;
+		struct nvme_sqe sqe;
+	} u;
+	uint16_t cid;
+
+	cid = queue->cid_idx++;
+	nvmetcp->admin_cid = cid;
+
+	memset ( &u, 0, sizeof ( u ) );
+	u.property.opcode = NVME_OPCODE_FABRICS;
+	u.property.cid = cpu_to_le16 ( cid );
+	u.property.fctype = fctype;
+	u.property.attrib = NVME_PROPERTY_4_BYTES;
+	u.property.ofst = cpu_to_le32 ( ofst );
+	u.property.value = cpu_to_le64 ( value );
+
+	return nvmetcp_tx_sqe ( queue, &u.sqe );
+}
+
+/**
+ * Transmit Set Features (Number of Queues) command capsule
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @ret rc		Return status code
+ */
+static int nvmetcp_tx_set_queues ( struct nvmetcp_session *nvmetcp ) {
+	struct nvmetcp_queue *queue = &nvmetcp->admin;
+	struct nvme_sqe sqe;
+	unsigned int nr = ( NVMETCP_MAX_IO_QUEUES - 1 );
+	uint16_t cid;
+
+	cid = queue->cid_idx++;
+	nvmetcp->admin_cid = cid;
+
+	memset ( &sqe, 0, sizeof ( sqe ) );
+	sqe.opcode = NVME_OPCODE_SET_FEATURES;
+	sqe.flags = NVME_SQE_FLAG_SGL;
+	sqe.cid = cpu_to_le16 ( cid );
+	sqe.cdw10 = cpu_to_le32 ( NVME_FEATURE_NUM_QUEUES );
+	sqe.cdw11 = cpu_to_le32 ( ( nr << 16 ) | nr );
+
+	return nvmetcp_tx_sqe ( queue, &sqe );
+}
+
+/**
+ * Transmit Identify Namespace command capsule
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @ret rc		Return status code
+ */
+static int nvmetcp_tx_identify ( struct nvmetcp_session *nvmetcp ) {
+	struct nvmetcp_queue *queue = &nvmetcp->admin;
+	struct nvme_sqe sqe;
+	uint16_t cid;
+
+	cid = queue->cid_idx++;
+	nvmetcp->admin_cid = cid;
+
+	memset ( &sqe, 0, sizeof ( sqe ) );
+	sqe.opcode = NVME_OPCODE_IDENTIFY;
+	sqe.flags = NVME_SQE_FLAG_SGL;
+	sqe.cid = cpu_to_le16 ( cid );
+	sqe.nsid = cpu_to_le32 ( nvmetcp->nsid );
+	sqe.sgl.length = cpu_to_le32 ( NVME_IDENTIFY_LEN );
+	sqe.sgl.type = NVME_SGL_TRANSPORT_DATA_BLOCK;
+	sqe.cdw10 = cpu_to_le32 ( NVME_IDENTIFY_NS );
+
+	return nvmetcp_tx_sqe ( queue, &sqe );
+}
+
+/**
+ * Transmit Read/Write I/O command capsule
+ *
+ * @v queue		NVMe/TCP queue
+ * @v cmd		NVMe/TCP command
+ * @v opcode		I/O command opcode
+ * @v lba		Starting logical block address
+ * @v count		Number of logical blocks
+ * @ret rc		Return status code
+ */
+static int nvmetcp_tx_io ( struct nvmetcp_queue *queue,
+			   struct nvmetcp_command *cmd, unsigned int opcode,
+			   uint64_t lba, unsigned int count ) {
+	struct nvmetcp_session *nvmetcp = queue->nvmetcp;
+	struct nvme_sqe sqe;
+
+	memset ( &sqe, 0, sizeof ( sqe ) );
+	sqe.opcode = opcode;
+	sqe.flags = NVME_SQE_FLAG_SGL;
+	sqe.cid = cpu_to_le16 ( cmd->cid );
+	sqe.nsid = cpu_to_le32 ( nvmetcp->nsid );
+	sqe.sgl.length = cpu_to_le32 ( cmd->len );
+	sqe.sgl.type = NVME_SGL_TRANSPORT_DATA_BLOCK;
+	sqe.cdw10 = cpu_to_le32 ( lba & 0xffffffffUL );
+	sqe.cdw11 = cpu_to_le32 ( lba >> 32 );
+	sqe.cdw12 = cpu_to_le32 ( count - 1 );
+
+	return nvmetcp_tx_sqe ( queue, &sqe );
+}
+
+/**
+ * Transmit H2CData PDUs satisfying a Ready to Transfer PDU
+ *
+ * @v queue		NVMe/TCP queue
+ * @v cmd		NVMe/TCP command
+ * @v ttag		Transfer tag
+ * @v offset		Requested data offset
+ * @v len		Requested data length
+ * @ret rc		Return status code
+ */
+static int nvmetcp_tx_h2c_data ( struct nvmetcp_queue *queue,
+				 struct nvmetcp_command *cmd,
+				 unsigned int ttag, size_t offset,
+				 size_t len ) {
+	struct io_buffer *iobuf;
+	struct nvmetcp_h2c_data *h2c;
+	size_t frag_len;
+	int rc;
+
+	while ( len ) {
+		frag_len = len;
+		if ( frag_len > queue->maxh2cdata )
+			frag_len = queue->maxh2cdata;
+
+		iobuf = xfer_alloc_iob ( &queue->socket,
+					 ( sizeof ( *h2c ) + frag_len ) );
+		if ( ! iobuf )
+			return -ENOMEM;
+
+		h2c = iob_put ( iobuf, sizeof ( *h2c ) );
+		memset ( h2c, 0, sizeof ( *h2c ) );
+		h2c->hdr.type = NVMETCP_H2C_DATA;
+		h2c->hdr.hlen = sizeof ( *h2c );
+		h2c->hdr.pdo = sizeof ( *h2c );
+		h2c->hdr.plen = cpu_to_le32 ( sizeof ( *h2c ) + frag_len );
+		if ( frag_len == len )
+			h2c->hdr.flags = NVMETCP_FLAG_LAST_PDU;
+		h2c->cccid = cpu_to_le16 ( cmd->cid );
+		h2c->ttag = cpu_to_le16 ( ttag );
+		h2c->datao = cpu_to_le32 ( offset );
+		h2c->datal = cpu_to_le32 ( frag_len );
+		copy_from_user ( iob_put ( iobuf, frag_len ), cmd->buffer,
+				 offset, frag_len );
+
+		if ( ( rc = xfer_deliver_iob ( &queue->socket,
+					       iobuf ) ) != 0 )
+			return rc;
+
+		offset += frag_len;
+		len -= frag_len;
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+ *
+ * Admin command sequence
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Open NVMe/TCP queue transport connection
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @v queue		NVMe/TCP queue
+ * @ret rc		Return status code
+ */
+static int nvmetcp_open_queue ( struct nvmetcp_session *nvmetcp,
+				struct nvmetcp_queue *queue ) {
+	struct sockaddr_tcpip target;
+	int rc;
+
+	memset ( &target, 0, sizeof ( target ) );
+	target.st_port = htons ( nvmetcp->port );
+	if ( ( rc = xfer_open_named_socket ( &queue->socket, SOCK_STREAM,
+					     ( struct sockaddr * ) &target,
+					     nvmetcp->target, NULL ) ) != 0 ) {
+		DBGC ( nvmetcp, "NVMeTCP %p could not open socket for queue "
+		       "%d: %s\n", nvmetcp, queue->qid, strerror ( rc ) );
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Parse Identify Namespace data and record capacity
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @ret rc		Return status code
+ */
+static int nvmetcp_parse_identify ( struct nvmetcp_session *nvmetcp ) {
+	struct nvme_identify_ns *id = ( void * ) nvmetcp->ident;
+	unsigned int lbaf = ( id->flbas & 0x0f );
+	unsigned int lbads = id->lbaf[lbaf].lbads;
+
+	if ( ( lbads < 9 ) || ( lbads > 24 ) ) {
+		DBGC ( nvmetcp, "NVMeTCP %p namespace %d has invalid block "
+		       "size (2^%d)\n", nvmetcp, nvmetcp->nsid, lbads );
+		return -EPROTO_INVALID_DATA;
+	}
+
+	nvmetcp->capacity.blocks = le64_to_cpu ( id->nsze );
+	nvmetcp->capacity.blksize = ( 1UL << lbads );
+	nvmetcp->capacity.max_count = ( NVMETCP_MAX_XFER_LEN >> lbads );
+
+	DBGC ( nvmetcp, "NVMeTCP %p namespace %d has %lld blocks of %zd "
+	       "bytes\n", nvmetcp, nvmetcp->nsid,
+	       ( ( unsigned long long ) nvmetcp->capacity.blocks ),
+	       nvmetcp->capacity.blksize );
+
+	return 0;
+}
+
+/**
+ * Handle admin queue completion and advance the session state machine
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @v cqe		Completion queue entry
+ * @ret rc		Return status code
+ */
+static int nvmetcp_admin_cqe ( struct nvmetcp_session *nvmetcp,
+			       struct nvme_cqe *cqe ) {
+	unsigned int status = NVME_CQE_STATUS ( le16_to_cpu ( cqe->status ) );
+	unsigned int nsqa;
+	unsigned int ncqa;
+	unsigned int nr;
+	unsigned int i;
+	int rc;
+
+	/* Sanity checks */
+	if ( le16_to_cpu ( cqe->cid ) != nvmetcp->admin_cid ) {
+		DBGC ( nvmetcp, "NVMeTCP %p unexpected admin cid %04x\n",
+		       nvmetcp, le16_to_cpu ( cqe->cid ) );
+		return -EPROTO_INVALID_PDU;
+	}
+	if ( status != 0 ) {
+		DBGC ( nvmetcp, "NVMeTCP %p admin command failed in state "
+		       "%d (status %04x)\n", nvmetcp, nvmetcp->state, status );
+		return -EIO_CQE_STATUS;
+	}
+
+	switch ( nvmetcp->state ) {
+
+	case NVMETCP_ADMIN_CONNECT:
+		/* Record controller ID and enable the controller */
+		nvmetcp->cntlid = ( le32_to_cpu ( cqe->dw0 ) & 0xffff );
+		nvmetcp->admin.state = NVMETCP_QUEUE_READY;
+		DBGC ( nvmetcp, "NVMeTCP %p connected to controller %04x\n",
+		       nvmetcp, nvmetcp->cntlid );
+		nvmetcp->state = NVMETCP_ENABLE;
+		return nvmetcp_tx_property ( nvmetcp,
+					     NVME_FCTYPE_PROPERTY_SET,
+					     NVME_PROPERTY_CC,
+					     NVME_CC_ENABLE );
+
+	case NVMETCP_ENABLE:
+		/* Poll for controller readiness */
+		nvmetcp->state = NVMETCP_WAIT_READY;
+		return nvmetcp_tx_property ( nvmetcp,
+					     NVME_FCTYPE_PROPERTY_GET,
+					     NVME_PROPERTY_CSTS, 0 );
+
+	case NVMETCP_WAIT_READY:
+		if ( ! ( le32_to_cpu ( cqe->dw0 ) & NVME_CSTS_RDY ) ) {
+			/* Each poll is paced by a round trip to the
+			 * target, so simply reissue immediately.
+			 */
+			return nvmetcp_tx_property ( nvmetcp,
+						     NVME_FCTYPE_PROPERTY_GET,
+						     NVME_PROPERTY_CSTS, 0 );
+		}
+		DBGC ( nvmetcp, "NVMeTCP %p controller ready\n", nvmetcp );
+		nvmetcp->state = NVMETCP_SET_QUEUES;
+		return nvmetcp_tx_set_queues ( nvmetcp );
+
+	case NVMETCP_SET_QUEUES:
+		/* Use as many queues as granted, up to our own limit */
+		nsqa = ( le32_to_cpu ( cqe->dw0 ) & 0xffff );
+		ncqa = ( le32_to_cpu ( cqe->dw0 ) >> 16 );
+		nr = ( ( ( nsqa < ncqa ) ? nsqa : ncqa ) + 1 );
+		if ( nr > NVMETCP_MAX_IO_QUEUES )
+			nr = NVMETCP_MAX_IO_QUEUES;
+		nvmetcp->nr_io_queues = nr;
+		DBGC ( nvmetcp, "NVMeTCP %p using %d I/O queue(s)\n",
+		       nvmetcp, nr );
+		nvmetcp->state = NVMETCP_IDENTIFY;
+		return nvmetcp_tx_identify ( nvmetcp );
+
+	case NVMETCP_IDENTIFY:
+		/* Record capacity and establish the I/O queues */
+		if ( ( rc = nvmetcp_parse_identify ( nvmetcp ) ) != 0 )
+			return rc;
+		nvmetcp->state = NVMETCP_CONNECT_IO;
+		for ( i = 0 ; i < nvmetcp->nr_io_queues ; i++ ) {
+			if ( ( rc = nvmetcp_open_queue ( nvmetcp,
+							 &nvmetcp->io[i] ) )
+			     != 0 )
+				return rc;
+		}
+		return 0;
+
+	default:
+		DBGC ( nvmetcp, "NVMeTCP %p unexpected admin completion in "
+		       "state %d\n", nvmetcp, nvmetcp->state );
+		return -EPROTO_INVALID_PDU;
+	}
+}
+
+/******************************************************************************
+ *
+ * PDU reception
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Handle received Initialize Connection Response PDU
+ *
+ * @v queue		NVMe/TCP queue
+ * @ret rc		Return status code
+ */
+static int nvmetcp_rx_icresp ( struct nvmetcp_queue *queue ) {
+	struct nvmetcp_session *nvmetcp = queue->nvmetcp;
+	struct nvmetcp_icresp *icresp = ( void * ) queue->rx_header;
+
+	if ( queue->state != NVMETCP_QUEUE_ICREQ ) {
+		DBGC ( nvmetcp, "NVMeTCP %p/%d unexpected ICResp\n",
+		       nvmetcp, queue->qid );
+		return -EPROTO_ICRESP;
+	}
+	if ( ( le16_to_cpu ( icresp->pfv ) != 0 ) || ( icresp->digest != 0 ) ){
+		DBGC ( nvmetcp, "NVMeTCP %p/%d unsupported connection "
+		       "parameters (pfv %d digest %02x)\n", nvmetcp,
+		       queue->qid, le16_to_cpu ( icresp->pfv ),
+		       icresp->digest );
+		return -EPROTO_ICRESP;
+	}
+	queue->maxh2cdata = le32_to_cpu ( icresp->maxh2cdata );
+	if ( queue->maxh2cdata < 512 ) {
+		DBGC ( nvmetcp, "NVMeTCP %p/%d invalid MAXH2CDATA %zd\n",
+		       nvmetcp, queue->qid, queue->maxh2cdata );
+		return -EPROTO_ICRESP;
+	}
+
+	/* Connect this queue to the controller */
+	queue->state = NVMETCP_QUEUE_CONNECT;
+	return nvmetcp_tx_connect ( queue );
+}
+
+/**
+ * Handle received Response Capsule PDU
+ *
+ * @v queue		NVMe/TCP queue
+ * @ret rc		Return status code
+ */
+static int nvmetcp_rx_resp ( struct nvmetcp_queue *queue ) {
+	struct nvmetcp_session *nvmetcp = queue->nvmetcp;
+	struct nvme_cqe *cqe =
+		( void * ) &queue->rx_header[ sizeof ( struct
+						       nvmetcp_pdu_header ) ];
+	struct nvmetcp_command *cmd;
+	unsigned int status;
+
+	/* Admin queue completions feed the session state machine */
+	if ( queue->qid == 0 )
+		return nvmetcp_admin_cqe ( nvmetcp, cqe );
+
+	/* I/O queue Connect completions */
+	if ( queue->state == NVMETCP_QUEUE_CONNECT ) {
+		status = NVME_CQE_STATUS ( le16_to_cpu ( cqe->status ) );
+		if ( status != 0 ) {
+			DBGC ( nvmetcp, "NVMeTCP %p/%d connect failed "
+			       "(status %04x)\n", nvmetcp, queue->qid,
+			       status );
+			return -EIO_CQE_STATUS;
+		}
+		queue->state = NVMETCP_QUEUE_READY;
+		DBGC2 ( nvmetcp, "NVMeTCP %p/%d queue ready\n", nvmetcp,
+			queue->qid );
+
+		/* Declare the session ready once all I/O queues are up */
+		if ( nvmetcp->state == NVMETCP_CONNECT_IO ) {
+			unsigned int i;
+			for ( i = 0 ; i < nvmetcp->nr_io_queues ; i++ ) {
+				if ( nvmetcp->io[i].state !=
+				     NVMETCP_QUEUE_READY )
+					return 0;
+			}
+			nvmetcp->state = NVMETCP_READY;
+			DBGC ( nvmetcp, "NVMeTCP %p session ready\n",
+			       nvmetcp );
+			xfer_window_changed ( &nvmetcp->block );
+		}
+		return 0;
+	}
+
+	/* Block command completions */
+	cmd = nvmetcp_find_command ( queue, le16_to_cpu ( cqe->cid ) );
+	if ( ! cmd ) {
+		DBGC ( nvmetcp, "NVMeTCP %p/%d completion for unknown cid "
+		       "%04x\n", nvmetcp, queue->qid,
+		       le16_to_cpu ( cqe->cid ) );
+		return 0;
+	}
+	status = NVME_CQE_STATUS ( le16_to_cpu ( cqe->status ) );
+	if ( status != 0 ) {
+		DBGC ( nvmetcp, "NVMeTCP %p/%d cid %04x status %04x\n",
+		       nvmetcp, queue->qid, cmd->cid, status );
+	}
+	nvmetcp_command_done ( cmd, ( status ? -EIO_CQE_STATUS : 0 ) );
+	return 0;
+}
+
+/**
+ * Handle received Ready to Transfer PDU
+ *
+ * @v queue		NVMe/TCP queue
+ * @ret rc		Return status code
+ */
+static int nvmetcp_rx_r2t ( struct nvmetcp_queue *queue ) {
+	struct nvmetcp_session *nvmetcp = queue->nvmetcp;
+	struct nvmetcp_r2t *r2t = ( void * ) queue->rx_header;
+	struct nvmetcp_command *cmd;
+	size_t offset = le32_to_cpu ( r2t->r2to );
+	size_t len = le32_to_cpu ( r2t->r2tl );
+
+	cmd = nvmetcp_find_command ( queue, le16_to_cpu ( r2t->cccid ) );
+	if ( ! cmd ) {
+		DBGC ( nvmetcp, "NVMeTCP %p/%d R2T for unknown cid %04x\n",
+		       nvmetcp, queue->qid, le16_to_cpu ( r2t->cccid ) );
+		return -EPROTO_INVALID_DATA;
+	}
+	if ( ( offset > cmd->len ) || ( len > ( cmd->len - offset ) ) ) {
+		DBGC ( nvmetcp, "NVMeTCP %p/%d R2T out of range "
+		       "(%zd+%zd/%zd)\n", nvmetcp, queue->qid, offset, len,
+		       cmd->len );
+		return -EPROTO_INVALID_DATA;
+	}
+
+	return nvmetcp_tx_h2c_data ( queue, cmd, le16_to_cpu ( r2t->ttag ),
+				     offset, len );
+}
+
+/**
+ * Handle a fragment of received C2HData PDU payload
+ *
+ * @v queue		NVMe/TCP queue
+ * @v data		Data fragment
+ * @v offset		Offset of fragment within the PDU's data
+ * @v len		Length of data fragment
+ * @ret rc		Return status code
+ */
+static int nvmetcp_rx_c2h_data ( struct nvmetcp_queue *queue,
+				 const void *data, size_t offset,
+				 size_t len ) {
+	struct nvmetcp_session *nvmetcp = queue->nvmetcp;
+	struct nvmetcp_c2h_data *c2h = ( void * ) queue->rx_header;
+	struct nvmetcp_command *cmd;
+	size_t datao = ( le32_to_cpu ( c2h->datao ) + offset );
+
+	/* Identify data is directed at the session's buffer */
+	if ( ( queue->qid == 0 ) &&
+	     ( nvmetcp->state == NVMETCP_IDENTIFY ) ) {
+		if ( ( datao + len ) > sizeof ( nvmetcp->ident ) ) {
+			DBGC ( nvmetcp, "NVMeTCP %p overlength identify "
+			       "data\n", nvmetcp );
+			return -EPROTO_INVALID_DATA;
+		}
+		memcpy ( &nvmetcp->ident[datao], data, len );
+		return 0;
+	}
+
+	/* All other data transfers belong to block commands */
+	cmd = nvmetcp_find_command ( queue, le16_to_cpu ( c2h->cccid ) );
+	if ( ! cmd ) {
+		DBGC ( nvmetcp, "NVMeTCP %p/%d data for unknown cid %04x\n",
+		       nvmetcp, queue->qid, le16_to_cpu ( c2h->cccid ) );
+		return -EPROTO_INVALID_DATA;
+	}
+	if ( ( datao + len ) > cmd->len ) {
+		DBGC ( nvmetcp, "NVMeTCP %p/%d data out of range "
+		       "(%zd+%zd/%zd)\n", nvmetcp, queue->qid, datao, len,
+		       cmd->len );
+		return -EPROTO_INVALID_DATA;
+	}
+	copy_to_user ( cmd->buffer, datao, data, len );
+	return 0;
+}
+
+/**
+ * Handle a fully received PDU
+ *
+ * @v queue		NVMe/TCP queue
+ * @ret rc		Return status code
+ */
+static int nvmetcp_rx_pdu ( struct nvmetcp_queue *queue ) {
+	struct nvmetcp_session *nvmetcp = queue->nvmetcp;
+	struct nvmetcp_pdu_header *hdr = ( void * ) queue->rx_header;
+	struct nvmetcp_c2h_data *c2h = ( void * ) queue->rx_header;
+	struct nvmetcp_command *cmd;
+
+	switch ( hdr->type ) {
+	case NVMETCP_ICRESP:
+		return nvmetcp_rx_icresp ( queue );
+	case NVMETCP_RESP:
+		return nvmetcp_rx_resp ( queue );
+	case NVMETCP_R2T:
+		return nvmetcp_rx_r2t ( queue );
+	case NVMETCP_C2H_DATA:
+		/* Payload has already been routed; a PDU flagged as
+		 * successful will not be followed by a response
+		 * capsule.
+		 */
+		if ( hdr->flags & NVMETCP_FLAG_SUCCESS ) {
+			cmd = nvmetcp_find_command ( queue,
+					le16_to_cpu ( c2h->cccid ) );
+			if ( cmd )
+				nvmetcp_command_done ( cmd, 0 );
+		}
+		return 0;
+	case NVMETCP_C2H_TERM:
+		DBGC ( nvmetcp, "NVMeTCP %p/%d connection terminated by "
+		       "target\n", nvmetcp, queue->qid );
+		return -EPROTO_TERMINATED;
+	default:
+		DBGC ( nvmetcp, "NVMeTCP %p/%d unknown PDU type %02x\n",
+		       nvmetcp, queue->qid, hdr->type );
+		return -EPROTO_INVALID_PDU;
+	}
+}
+
+/**
+ * Receive new data
+ *
+ * @v queue		NVMe/TCP queue
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ *
+ * The receive strategy is to buffer the PDU header portion (which is
+ * at most 128 bytes) in nvmetcp_queue::rx_header, and to route data
+ * payload fragments directly to their destination buffer as they
+ * arrive.
+ */
+static int nvmetcp_socket_deliver ( struct nvmetcp_queue *queue,
+				    struct io_buffer *iobuf,
+				    struct xfer_metadata *meta __unused ) {
+	struct nvmetcp_session *nvmetcp = queue->nvmetcp;
+	struct nvmetcp_pdu_header *hdr = ( void * ) queue->rx_header;
+	size_t len;
+	size_t plen;
+	size_t boundary;
+	int rc = 0;
+
+	while ( iob_len ( iobuf ) ) {
+
+		/* Accumulate the fixed portion of the common header */
+		if ( queue->rx_offset < sizeof ( *hdr ) ) {
+			len = ( sizeof ( *hdr ) - queue->rx_offset );
+			if ( len > iob_len ( iobuf ) )
+				len = iob_len ( iobuf );
+			memcpy ( &queue->rx_header[queue->rx_offset],
+				 iobuf->data, len );
+			queue->rx_offset += len;
+			iob_pull ( iobuf, len );
+			continue;
+		}
+
+		/* Sanity check the header lengths */
+		plen = le32_to_cpu ( hdr->plen );
+		if ( ( hdr->hlen < sizeof ( *hdr ) ) ||
+		     ( hdr->hlen > sizeof ( queue->rx_header ) ) ||
+		     ( plen < hdr->hlen ) ||
+		     ( ( hdr->pdo != 0 ) && ( hdr->pdo < hdr->hlen ) ) ) {
+			DBGC ( nvmetcp, "NVMeTCP %p/%d malformed PDU header "
+			       "(type %02x hlen %d pdo %d plen %zd)\n",
+			       nvmetcp, queue->qid, hdr->type, hdr->hlen,
+			       hdr->pdo, plen );
+			rc = -EPROTO_INVALID_PDU;
+			goto done;
+		}
+
+		/* Accumulate the type-specific portion of the header */
+		if ( queue->rx_offset < hdr->hlen ) {
+			len = ( hdr->hlen - queue->rx_offset );
+			if ( len > iob_len ( iobuf ) )
+				len = iob_len ( iobuf );
+			memcpy ( &queue->rx_header[queue->rx_offset],
+				 iobuf->data, len );
+			queue->rx_offset += len;
+			iob_pull ( iobuf, len );
+		}
+
+		/* Discard any padding, then route data payload */
+		if ( queue->rx_offset >= hdr->hlen &&
+		     queue->rx_offset < plen ) {
+			boundary = ( hdr->pdo ? hdr->pdo : plen );
+			if ( queue->rx_offset < boundary ) {
+				/* Padding (or digests, which we never
+				 * negotiate): discard.
+				 */
+				len = ( boundary - queue->rx_offset );
+			} else {
+				len = ( plen - queue->rx_offset );
+			}
+			if ( len > iob_len ( iobuf ) )
+				len = iob_len ( iobuf );
+			if ( queue->rx_offset >= boundary &&
+			     hdr->type == NVMETCP_C2H_DATA ) {
+				if ( ( rc = nvmetcp_rx_c2h_data ( queue,
+						iobuf->data,
+						( queue->rx_offset -
+						  boundary ), len ) ) != 0 )
+					goto done;
+			}
+			queue->rx_offset += len;
+			iob_pull ( iobuf, len );
+		}
+
+		/* Process the PDU once fully received */
+		if ( queue->rx_offset >= plen ) {
+			queue->rx_offset = 0;
+			if ( ( rc = nvmetcp_rx_pdu ( queue ) ) != 0 )
+				goto done;
+		}
+	}
+
+ done:
+	if ( rc != 0 )
+		nvmetcp_close ( nvmetcp, rc );
+	free_iob ( iobuf );
+	return rc;
+}
+
+/**
+ * Handle transport window change
+ *
+ * @v queue		NVMe/TCP queue
+ *
+ * The connection handshake begins as soon as the TCP connection is
+ * established.
+ */
+static void nvmetcp_socket_window_changed ( struct nvmetcp_queue *queue ) {
+	struct nvmetcp_session *nvmetcp = queue->nvmetcp;
+	int rc;
+
+	if ( ( queue->state == NVMETCP_QUEUE_IDLE ) &&
+	     ( xfer_window ( &queue->socket ) > 0 ) ) {
+		queue->state = NVMETCP_QUEUE_ICREQ;
+		if ( ( rc = nvmetcp_tx_icreq ( queue ) ) != 0 )
+			nvmetcp_close ( nvmetcp, rc );
+	}
+}
+
+/**
+ * Handle transport connection close
+ *
+ * @v queue		NVMe/TCP queue
+ * @v rc		Reason for close
+ */
+static void nvmetcp_socket_close ( struct nvmetcp_queue *queue, int rc ) {
+	nvmetcp_close ( queue->nvmetcp, rc );
+}
+
+/** NVMe/TCP socket interface operations */
+static struct interface_operation nvmetcp_socket_operations[] = {
+	INTF_OP ( xfer_deliver, struct nvmetcp_queue *,
+		  nvmetcp_socket_deliver ),
+	INTF_OP ( xfer_window_changed, struct nvmetcp_queue *,
+		  nvmetcp_socket_window_changed ),
+	INTF_OP ( intf_close, struct nvmetcp_queue *, nvmetcp_socket_close ),
+};
+
+/** NVMe/TCP socket interface descriptor */
+static struct interface_descriptor nvmetcp_socket_desc =
+	INTF_DESC ( struct nvmetcp_queue, socket, nvmetcp_socket_operations );
+
+/******************************************************************************
+ *
+ * Block device interface
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Close NVMe/TCP session
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @v rc		Reason for close
+ */
+static void nvmetcp_close ( struct nvmetcp_session *nvmetcp, int rc ) {
+	struct nvmetcp_command *cmd;
+	struct nvmetcp_command *tmp;
+	unsigned int i;
+
+	/* Block any further commands */
+	nvmetcp->state = NVMETCP_ADMIN_CONNECT;
+
+	/* Fail all outstanding commands */
+	for ( i = 0 ; i < NVMETCP_MAX_IO_QUEUES ; i++ ) {
+		list_for_each_entry_safe ( cmd, tmp,
+					   &nvmetcp->io[i].commands, list )
+			nvmetcp_command_done ( cmd, rc );
+	}
+
+	/* Shut down interfaces */
+	intf_shutdown ( &nvmetcp->admin.socket, rc );
+	for ( i = 0 ; i < NVMETCP_MAX_IO_QUEUES ; i++ )
+		intf_shutdown ( &nvmetcp->io[i].socket, rc );
+	intf_shutdown ( &nvmetcp->block, rc );
+}
+
+/**
+ * Check NVMe/TCP flow-control window
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @ret len		Length of window
+ */
+static size_t nvmetcp_block_window ( struct nvmetcp_session *nvmetcp ) {
+
+	/* Commands may be issued only once the controller is enabled,
+	 * the namespace identified, and all I/O queues connected.
+	 */
+	return ( ( nvmetcp->state == NVMETCP_READY ) ?
+		 ~( ( size_t ) 0 ) : 0 );
+}
+
+/**
+ * Issue NVMe/TCP block read/write command
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @v block		Block data interface
+ * @v opcode		I/O command opcode
+ * @v lba		Starting logical block address
+ * @v count		Number of logical blocks
+ * @v buffer		Data buffer
+ * @v len		Length of data buffer
+ * @ret rc		Return status code
+ */
+static int nvmetcp_block_rw ( struct nvmetcp_session *nvmetcp,
+			      struct interface *block, unsigned int opcode,
+			      uint64_t lba, unsigned int count,
+			      userptr_t buffer, size_t len ) {
+	struct nvmetcp_queue *queue;
+	struct nvmetcp_command *cmd;
+	int rc;
+
+	/* Refuse commands before the session is ready */
+	if ( nvmetcp->state != NVMETCP_READY )
+		return -ENOTCONN;
+
+	/* Distribute commands round-robin across the I/O queues */
+	queue = &nvmetcp->io[ nvmetcp->io_rr++ % nvmetcp->nr_io_queues ];
+
+	/* Create command */
+	cmd = nvmetcp_command_create ( nvmetcp, queue, buffer, len );
+	if ( ! cmd )
+		return -ENOMEM;
+
+	/* Issue command capsule */
+	if ( ( rc = nvmetcp_tx_io ( queue, cmd, opcode, lba, count ) ) != 0 ){
+		ref_put ( &cmd->refcnt );
+		return rc;
+	}
+
+	/* Attach to parent interface, transfer reference to list,
+	 * and return
+	 */
+	intf_plug_plug ( &cmd->block, block );
+	list_add ( &cmd->list, &queue->commands );
+	return 0;
+}
+
+/**
+ * Issue NVMe/TCP block read command
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @v block		Block data interface
+ * @v lba		Starting logical block address
+ * @v count		Number of logical blocks
+ * @v buffer		Data buffer
+ * @v len		Length of data buffer
+ * @ret rc		Return status code
+ */
+static int nvmetcp_block_read ( struct nvmetcp_session *nvmetcp,
+				struct interface *block, uint64_t lba,
+				unsigned int count, userptr_t buffer,
+				size_t len ) {
+	return nvmetcp_block_rw ( nvmetcp, block, NVME_OPCODE_READ, lba,
+				  count, buffer, len );
+}
+
+/**
+ * Issue NVMe/TCP block write command
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @v block		Block data interface
+ * @v lba		Starting logical block address
+ * @v count		Number of logical blocks
+ * @v buffer		Data buffer
+ * @v len		Length of data buffer
+ * @ret rc		Return status code
+ */
+static int nvmetcp_block_write ( struct nvmetcp_session *nvmetcp,
+				 struct interface *block, uint64_t lba,
+				 unsigned int count, userptr_t buffer,
+				 size_t len ) {
+	return nvmetcp_block_rw ( nvmetcp, block, NVME_OPCODE_WRITE, lba,
+				  count, buffer, len );
+}
+
+/**
+ * Read NVMe/TCP device capacity
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @v block		Block data interface
+ * @ret rc		Return status code
+ *
+ * The capacity was cached from the Identify Namespace data during
+ * session establishment, so this can complete immediately.
+ */
+static int nvmetcp_block_read_capacity ( struct nvmetcp_session *nvmetcp,
+					 struct interface *block ) {
+	struct nvmetcp_command *cmd;
+
+	/* Refuse commands before the session is ready */
+	if ( nvmetcp->state != NVMETCP_READY )
+		return -ENOTCONN;
+
+	/* Create command purely to own an interface end */
+	cmd = nvmetcp_command_create ( nvmetcp, &nvmetcp->io[0], UNULL, 0 );
+	if ( ! cmd )
+		return -ENOMEM;
+
+	/* Report cached capacity and complete immediately */
+	intf_plug_plug ( &cmd->block, block );
+	block_capacity ( &cmd->block, &nvmetcp->capacity );
+	nvmetcp_command_done ( cmd, 0 );
+	ref_put ( &cmd->refcnt );
+	return 0;
+}
+
+/**
+ * Handle block interface close
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @v rc		Reason for close
+ */
+static void nvmetcp_block_close ( struct nvmetcp_session *nvmetcp, int rc ) {
+	nvmetcp_close ( nvmetcp, rc );
+}
+
+/** NVMe/TCP block interface operations */
+static struct interface_operation nvmetcp_block_operations[] = {
+	INTF_OP ( xfer_window, struct nvmetcp_session *,
+		  nvmetcp_block_window ),
+	INTF_OP ( block_read, struct nvmetcp_session *, nvmetcp_block_read ),
+	INTF_OP ( block_write, struct nvmetcp_session *,
+		  nvmetcp_block_write ),
+	INTF_OP ( block_read_capacity, struct nvmetcp_session *,
+		  nvmetcp_block_read_capacity ),
+	INTF_OP ( intf_close, struct nvmetcp_session *, nvmetcp_block_close ),
+};
+
+/** NVMe/TCP block interface descriptor */
+static struct interface_descriptor nvmetcp_block_desc =
+	INTF_DESC ( struct nvmetcp_session, block, nvmetcp_block_operations );
+
+/******************************************************************************
+ *
+ * Session instantiation
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Free NVMe/TCP session
+ *
+ * @v refcnt		Reference count
+ */
+static void nvmetcp_free ( struct refcnt *refcnt ) {
+	struct nvmetcp_session *nvmetcp =
+		container_of ( refcnt, struct nvmetcp_session, refcnt );
+
+	free ( nvmetcp->target );
+	free ( nvmetcp->subnqn );
+	free ( nvmetcp );
+}
+
+/**
+ * Parse NVMe/TCP URI
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @v uri		URI
+ * @ret rc		Return status code
+ *
+ * The URI takes the form
+ * nvme+tcp://<target>[:<port>]/<subsystem-nqn>[/<namespace-id>]
+ */
+static int nvmetcp_parse_uri ( struct nvmetcp_session *nvmetcp,
+			       struct uri *uri ) {
+	char *sep;
+	char *end;
+	unsigned long nsid;
+
+	if ( ( ! uri->host ) || ( ! uri->path ) ||
+	     ( uri->path[0] != '/' ) || ( uri->path[1] == '\0' ) )
+		return -EINVAL_NO_SUBSYSTEM_NQN;
+
+	nvmetcp->target = strdup ( uri->host );
+	nvmetcp->subnqn = strdup ( &uri->path[1] );
+	if ( ( ! nvmetcp->target ) || ( ! nvmetcp->subnqn ) )
+		return -ENOMEM;
+	nvmetcp->port = uri_port ( uri, NVMETCP_PORT );
+	nvmetcp->nsid = 1;
+
+	/* Allow a numeric trailing path component to select the
+	 * namespace; NQNs themselves never contain a slash.
+	 */
+	sep = strrchr ( nvmetcp->subnqn, '/' );
+	if ( sep ) {
+		nsid = strtoul ( ( sep + 1 ), &end, 10 );
+		if ( ( end != ( sep + 1 ) ) && ( *end == '\0' ) &&
+		     ( nsid != 0 ) ) {
+			nvmetcp->nsid = nsid;
+			*sep = '\0';
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Construct host NQN and host identifier
+ *
+ * @v nvmetcp		NVMe/TCP session
+ */
+static void nvmetcp_host_identity ( struct nvmetcp_session *nvmetcp ) {
+	char hostname[64];
+	unsigned int i;
+	int len;
+
+	len = fetch_string_setting ( NULL, &hostname_setting, hostname,
+				     sizeof ( hostname ) );
+	if ( len > 0 ) {
+		snprintf ( nvmetcp->hostnqn, sizeof ( nvmetcp->hostnqn ),
+			   NVMETCP_HOSTNQN_BASE ":%s", hostname );
+	} else {
+		snprintf ( nvmetcp->hostnqn, sizeof ( nvmetcp->hostnqn ),
+			   NVMETCP_HOSTNQN_BASE );
+	}
+
+	for ( i = 0 ; i < sizeof ( nvmetcp->hostid ) ; i++ )
+		nvmetcp->hostid[i] = random();
+}
+
+/**
+ * Initialise NVMe/TCP queue
+ *
+ * @v nvmetcp		NVMe/TCP session
+ * @v queue		NVMe/TCP queue
+ * @v qid		Queue ID
+ */
+static void nvmetcp_init_queue ( struct nvmetcp_session *nvmetcp,
+				 struct nvmetcp_queue *queue,
+				 unsigned int qid ) {
+	queue->nvmetcp = nvmetcp;
+	queue->qid = qid;
+	intf_init ( &queue->socket, &nvmetcp_socket_desc, &nvmetcp->refcnt );
+	INIT_LIST_HEAD ( &queue->commands );
+}
+
+/**
+ * Open NVMe/TCP URI
+ *
+ * @v parent		Parent interface
+ * @v uri		URI
+ * @ret rc		Return status code
+ */
+static int nvmetcp_open ( struct interface *parent, struct uri *uri ) {
+	struct nvmetcp_session *nvmetcp;
+	unsigned int i;
+	int rc;
+
+	/* Allocate and initialise structure */
+	nvmetcp = zalloc ( sizeof ( *nvmetcp ) );
+	if ( ! nvmetcp ) {
+		rc = -ENOMEM;
+		goto err_zalloc;
+	}
+	ref_init ( &nvmetcp->refcnt, nvmetcp_free );
+	intf_init ( &nvmetcp->block, &nvmetcp_block_desc, &nvmetcp->refcnt );
+	nvmetcp_init_queue ( nvmetcp, &nvmetcp->admin, 0 );
+	for ( i = 0 ; i < NVMETCP_MAX_IO_QUEUES ; i++ )
+		nvmetcp_init_queue ( nvmetcp, &nvmetcp->io[i], ( i + 1 ) );
+
+	/* Parse URI and construct host identity */
+	if ( ( rc = nvmetcp_parse_uri ( nvmetcp, uri ) ) != 0 ) {
+		DBGC ( nvmetcp, "NVMeTCP %p could not parse URI: %s\n",
+		       nvmetcp, strerror ( rc ) );
+		goto err_parse_uri;
+	}
+	nvmetcp_host_identity ( nvmetcp );
+	DBGC ( nvmetcp, "NVMeTCP %p target %s:%d subsystem %s namespace "
+	       "%d\n", nvmetcp, nvmetcp->target, nvmetcp->port,
+	       nvmetcp->subnqn, nvmetcp->nsid );
+
+	/* Open admin queue connection; the handshake proceeds from
+	 * the connection's window opening.
+	 */
+	if ( ( rc = nvmetcp_open_queue ( nvmetcp, &nvmetcp->admin ) ) != 0 )
+		goto err_open_queue;
+
+	/* Attach to parent interface, mortalise self, and return */
+	intf_plug_plug ( &nvmetcp->block, parent );
+	ref_put ( &nvmetcp->refcnt );
+	return 0;
+
+ err_open_queue:
+ err_parse_uri:
+	nvmetcp_close ( nvmetcp, rc );
+	ref_put ( &nvmetcp->refcnt );
+ err_zalloc:
+	return rc;
+}
+
+/** NVMe/TCP URI opener */
+struct uri_opener nvmetcp_uri_opener __uri_opener = {
+	.scheme = "nvme+tcp",
+	.open = nvmetcp_open,
+};
@@ -214,9 +214,15 @@ size_t oncrpc_compute_size ( const struct oncrpc_field fields[] ) {
  */
 int oncrpc_get_reply ( struct oncrpc_session *session __unused,
                        struct oncrpc_reply *reply, struct io_buffer *io_buf ) {
+	size_t length;
+
 	if ( ! reply || ! io_buf )
 		return -EINVAL;
 
+	/* Avoid pulling beyond the end of a truncated reply */
+	if ( iob_len ( io_buf ) < 4 * sizeof ( uint32_t ) )
+		return -EPROTO;
+
 	reply->frame_size = GET_FRAME_SIZE ( oncrpc_iob_get_int ( io_buf ) );
 	reply->rpc_id     = oncrpc_iob_get_int ( io_buf );
 
@@ -228,16 +234,25 @@ int oncrpc_get_reply ( struct oncrpc_session *session __unused,
 
 	if ( reply->reply_state == 0 )
 	{
+		if ( iob_len ( io_buf ) < 2 * sizeof ( uint32_t ) )
+			return -EPROTO;
+
 		/* verifier.flavor */
 		oncrpc_iob_get_int ( io_buf );
 		/* verifier.length */
-		iob_pull ( io_buf, oncrpc_iob_get_int ( io_buf ));
+		length = oncrpc_iob_get_int ( io_buf );
+		if ( length > iob_len ( io_buf ) )
+			return -EPROTO;
+		iob_pull ( io_buf, length );
 
 		/* We don't use the verifier in iPXE, let it be an empty
 		   verifier. */
 		reply->verifier = &oncrpc_auth_none;
 	}
 
+	if ( iob_len ( io_buf ) < sizeof ( uint32_t ) )
+		return -EPROTO;
+
 	reply->accept_state = oncrpc_iob_get_int ( io_buf );
 	reply->data         = io_buf;
 
@@ -41,12 +41,27 @@ int tcpip_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 	       uint8_t tcpip_proto, struct sockaddr_tcpip *st_src,
 	       struct sockaddr_tcpip *st_dest, uint16_t pshdr_csum,
 	       struct ip_statistics *stats ) {
+	static struct tcpip_protocol *tcpip_mru;
 	struct tcpip_protocol *tcpip;
 
+	/* Nearly all traffic within a download belongs to a single
+	 * transport-layer protocol, so try the most recently used
+	 * protocol first.  This reduces the per-packet dispatch to a
+	 * single (correctly predicted) comparison on the hot path.
+	 */
+	tcpip = tcpip_mru;
+	if ( tcpip && ( tcpip->tcpip_proto == tcpip_proto ) ) {
+		DBG ( "TCP/IP received %s packet\n", tcpip->name );
+		stats->in_delivers++;
+		return tcpip->rx ( iobuf, netdev, st_src, st_dest,
+				   pshdr_csum );
+	}
+
 	/* Hand off packet to the appropriate transport-layer protocol */
 	for_each_table_entry ( tcpip, TCPIP_PROTOCOLS ) {
 		if ( tcpip->tcpip_proto == tcpip_proto ) {
 			DBG ( "TCP/IP received %s packet\n", tcpip->name );
+			tcpip_mru = tcpip;
 			stats->in_delivers++;
 			return tcpip->rx ( iobuf, netdev, st_src, st_dest,
 					   pshdr_csum );
@@ -204,6 +219,29 @@ uint16_t tcpip_chksum ( const void *data, size_t len ) {
 	return tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, data, len );
 }
 
+/**
+ * Update TCP/IP checksum for a modified 16-bit word
+ *
+ * @v chksum		Checksum, in network byte order
+ * @v old		Old 16-bit word, in network byte order
+ * @v new		New 16-bit word, in network byte order
+ * @ret chksum		Updated checksum, in network byte order
+ *
+ * Incrementally updates an existing checksum to reflect a change to a
+ * single aligned 16-bit word of the covered data, as per RFC 1624
+ * (HC' = ~(~HC + ~m + m')).  This avoids recomputing the checksum
+ * over the whole data block when only a few header bytes have
+ * changed.
+ */
+uint16_t tcpip_chksum_update ( uint16_t chksum, uint16_t old, uint16_t new ) {
+	uint32_t cksum;
+
+	cksum = ( ( ( ~chksum ) & 0xffff ) + ( ( ~old ) & 0xffff ) + new );
+	cksum = ( ( cksum & 0xffff ) + ( cksum >> 16 ) );
+	cksum = ( ( cksum & 0xffff ) + ( cksum >> 16 ) );
+	return ( ( ~cksum ) & 0xffff );
+}
+
 /**
  * Bind to local TCP/IP port
  *
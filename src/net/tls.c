@@ -48,8 +48,15 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/rbg.h>
 #include <ipxe/validator.h>
 #include <ipxe/job.h>
+#include <ipxe/profile.h>
 #include <ipxe/tls.h>
 
+/** Record encryption profiler */
+static struct profiler tls_tx_profiler __profiler_lite = { .name = "tls.tx" };
+
+/** Record decryption profiler */
+static struct profiler tls_rx_profiler __profiler_lite = { .name = "tls.rx" };
+
 /* Disambiguate the various error causes */
 #define EINVAL_CHANGE_CIPHER __einfo_error ( EINFO_EINVAL_CHANGE_CIPHER )
 #define EINFO_EINVAL_CHANGE_CIPHER					\
@@ -107,6 +114,14 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define EINFO_EINVAL_TICKET						\
 	__einfo_uniqify ( EINFO_EINVAL, 0x0e,				\
 			  "Invalid New Session Ticket record")
+#define EINVAL_KEY_EXCHANGE __einfo_error ( EINFO_EINVAL_KEY_EXCHANGE )
+#define EINFO_EINVAL_KEY_EXCHANGE					\
+	__einfo_uniqify ( EINFO_EINVAL, 0x0f,				\
+			  "Invalid Server Key Exchange record" )
+#define EINVAL_STATUS __einfo_error ( EINFO_EINVAL_STATUS )
+#define EINFO_EINVAL_STATUS						\
+	__einfo_uniqify ( EINFO_EINVAL, 0x10,				\
+			  "Invalid Certificate Status record" )
 #define EIO_ALERT __einfo_error ( EINFO_EIO_ALERT )
 #define EINFO_EIO_ALERT							\
 	__einfo_uniqify ( EINFO_EIO, 0x01,				\
@@ -155,6 +170,10 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define EINFO_ENOTSUP_VERSION						\
 	__einfo_uniqify ( EINFO_ENOTSUP, 0x04,				\
 			  "Unsupported protocol version" )
+#define ENOTSUP_CURVE __einfo_error ( EINFO_ENOTSUP_CURVE )
+#define EINFO_ENOTSUP_CURVE						\
+	__einfo_uniqify ( EINFO_ENOTSUP, 0x05,				\
+			  "Unsupported elliptic curve" )
 #define EPERM_ALERT __einfo_error ( EINFO_EPERM_ALERT )
 #define EINFO_EPERM_ALERT						\
 	__einfo_uniqify ( EINFO_EPERM, 0x01,				\
@@ -175,11 +194,18 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define EINFO_EPERM_RENEG_VERIFY					\
 	__einfo_uniqify ( EINFO_EPERM, 0x05,				\
 			  "Secure renegotiation verification failed" )
+#define EPERM_KEY_EXCHANGE __einfo_error ( EINFO_EPERM_KEY_EXCHANGE )
+#define EINFO_EPERM_KEY_EXCHANGE					\
+	__einfo_uniqify ( EINFO_EPERM, 0x06,				\
+			  "Key exchange signature verification failed" )
 #define EPROTO_VERSION __einfo_error ( EINFO_EPROTO_VERSION )
 #define EINFO_EPROTO_VERSION						\
 	__einfo_uniqify ( EINFO_EPROTO, 0x01,				\
 			  "Illegal protocol version upgrade" )
 
+/** Maximum number of idle sessions to retain for later resumption */
+#define TLS_NUM_SESSIONS 8
+
 /** List of TLS session */
 static LIST_HEAD ( tls_sessions );
 
@@ -244,6 +270,33 @@ static int tls_ready ( struct tls_connection *tls ) {
 		 ( ! is_pending ( &tls->server_negotiation ) ) );
 }
 
+/**
+ * Determine if TLS connection is ready to transmit application data
+ *
+ * @v tls		TLS connection
+ * @ret is_ready	TLS connection is ready
+ *
+ * A connection using a forward-secret key exchange may "false start"
+ * (RFC 7918) and transmit application data as soon as its own
+ * Finished message has been sent, without waiting a further round
+ * trip for the server's Finished.  The server's Finished is still
+ * verified as normal when it eventually arrives.
+ */
+static int tls_ready_tx ( struct tls_connection *tls ) {
+
+	/* Not ready until our own Finished has been sent */
+	if ( is_pending ( &tls->client_negotiation ) )
+		return 0;
+
+	/* Ready once the server has also finished */
+	if ( ! is_pending ( &tls->server_negotiation ) )
+		return 1;
+
+	/* False start only with a forward-secret key exchange */
+	return ( tls->tx_cipherspec.suite->exchange ==
+		 &tls_ecdhe_exchange_algorithm );
+}
+
 /******************************************************************************
  *
  * Hybrid MD5+SHA1 hash as used by TLSv1.1 and earlier
@@ -325,12 +378,14 @@ static void free_tls_session ( struct refcnt *refcnt ) {
 	struct tls_session *session =
 		container_of ( refcnt, struct tls_session, refcnt );
 
-	/* Sanity check */
+	/* Sanity check
+	 *
+	 * The session cache holds its own reference while the session
+	 * remains listed, so the session has already been removed
+	 * from the list of sessions by this point.
+	 */
 	assert ( list_empty ( &session->conn ) );
 
-	/* Remove from list of sessions */
-	list_del ( &session->list );
-
 	/* Free session ticket */
 	free ( session->ticket );
 
@@ -352,6 +407,8 @@ static void free_tls ( struct refcnt *refcnt ) {
 
 	/* Free dynamically-allocated resources */
 	free ( tls->new_session_ticket );
+	free ( tls->staple );
+	free ( tls->server_key );
 	tls_clear_cipher ( tls, &tls->tx_cipherspec );
 	tls_clear_cipher ( tls, &tls->tx_cipherspec_pending );
 	tls_clear_cipher ( tls, &tls->rx_cipherspec );
@@ -462,7 +519,7 @@ static void tls_hmac_update_va ( struct digest_algorithm *digest,
  */
 static void tls_p_hash_va ( struct tls_connection *tls,
 			    struct digest_algorithm *digest,
-			    void *secret, size_t secret_len,
+			    const void *secret, size_t secret_len,
 			    void *out, size_t out_len,
 			    va_list seeds ) {
 	uint8_t secret_copy[secret_len];
@@ -475,30 +532,29 @@ static void tls_p_hash_va ( struct tls_connection *tls,
 
 	/* Copy the secret, in case HMAC modifies it */
 	memcpy ( secret_copy, secret, secret_len );
-	secret = secret_copy;
 	DBGC2 ( tls, "TLS %p %s secret:\n", tls, digest->name );
-	DBGC2_HD ( tls, secret, secret_len );
+	DBGC2_HD ( tls, secret_copy, secret_len );
 
 	/* Calculate A(1) */
-	hmac_init ( digest, digest_ctx, secret, &secret_len );
+	hmac_init ( digest, digest_ctx, secret_copy, &secret_len );
 	va_copy ( tmp, seeds );
 	tls_hmac_update_va ( digest, digest_ctx, tmp );
 	va_end ( tmp );
-	hmac_final ( digest, digest_ctx, secret, &secret_len, a );
+	hmac_final ( digest, digest_ctx, secret_copy, &secret_len, a );
 	DBGC2 ( tls, "TLS %p %s A(1):\n", tls, digest->name );
 	DBGC2_HD ( tls, &a, sizeof ( a ) );
 
 	/* Generate as much data as required */
 	while ( out_len ) {
 		/* Calculate output portion */
-		hmac_init ( digest, digest_ctx, secret, &secret_len );
+		hmac_init ( digest, digest_ctx, secret_copy, &secret_len );
 		hmac_update ( digest, digest_ctx, a, sizeof ( a ) );
 		memcpy ( digest_ctx_partial, digest_ctx, digest->ctxsize );
 		va_copy ( tmp, seeds );
 		tls_hmac_update_va ( digest, digest_ctx, tmp );
 		va_end ( tmp );
 		hmac_final ( digest, digest_ctx,
-			     secret, &secret_len, out_tmp );
+			     secret_copy, &secret_len, out_tmp );
 
 		/* Copy output */
 		if ( frag_len > out_len )
@@ -509,7 +565,7 @@ static void tls_p_hash_va ( struct tls_connection *tls,
 
 		/* Calculate A(i) */
 		hmac_final ( digest, digest_ctx_partial,
-			     secret, &secret_len, a );
+			     secret_copy, &secret_len, a );
 		DBGC2 ( tls, "TLS %p %s A(n):\n", tls, digest->name );
 		DBGC2_HD ( tls, &a, sizeof ( a ) );
 
@@ -528,13 +584,13 @@ static void tls_p_hash_va ( struct tls_connection *tls,
  * @v out_len		Length of output buffer
  * @v ...		( data, len ) pairs of seed data, terminated by NULL
  */
-static void tls_prf ( struct tls_connection *tls, void *secret,
+static void tls_prf ( struct tls_connection *tls, const void *secret,
 		      size_t secret_len, void *out, size_t out_len, ... ) {
 	va_list seeds;
 	va_list tmp;
 	size_t subsecret_len;
-	void *md5_secret;
-	void *sha1_secret;
+	const void *md5_secret;
+	const void *sha1_secret;
 	uint8_t buf[out_len];
 	unsigned int i;
 
@@ -599,21 +655,22 @@ static void tls_prf ( struct tls_connection *tls, void *secret,
  * Generate master secret
  *
  * @v tls		TLS connection
+ * @v pre_master_secret	Pre-master secret
+ * @v pre_master_secret_len Length of pre-master secret
  *
- * The pre-master secret and the client and server random values must
- * already be known.
+ * The client and server random values must already be known.
  */
-static void tls_generate_master_secret ( struct tls_connection *tls ) {
+static void tls_generate_master_secret ( struct tls_connection *tls,
+					 const void *pre_master_secret,
+					 size_t pre_master_secret_len ) {
 	DBGC ( tls, "TLS %p pre-master-secret:\n", tls );
-	DBGC_HD ( tls, &tls->pre_master_secret,
-		  sizeof ( tls->pre_master_secret ) );
+	DBGC_HD ( tls, pre_master_secret, pre_master_secret_len );
 	DBGC ( tls, "TLS %p client random bytes:\n", tls );
 	DBGC_HD ( tls, &tls->client_random, sizeof ( tls->client_random ) );
 	DBGC ( tls, "TLS %p server random bytes:\n", tls );
 	DBGC_HD ( tls, &tls->server_random, sizeof ( tls->server_random ) );
 
-	tls_prf_label ( tls, &tls->pre_master_secret,
-			sizeof ( tls->pre_master_secret ),
+	tls_prf_label ( tls, pre_master_secret, pre_master_secret_len,
 			&tls->master_secret, sizeof ( tls->master_secret ),
 			"master secret",
 			&tls->client_random, sizeof ( tls->client_random ),
@@ -714,6 +771,7 @@ static int tls_generate_keys ( struct tls_connection *tls ) {
 
 /** Null cipher suite */
 struct tls_cipher_suite tls_cipher_suite_null = {
+	.exchange = &tls_pubkey_exchange_algorithm,
 	.pubkey = &pubkey_null,
 	.cipher = &cipher_null,
 	.digest = &digest_null,
@@ -722,6 +780,9 @@ struct tls_cipher_suite tls_cipher_suite_null = {
 /** Number of supported cipher suites */
 #define TLS_NUM_CIPHER_SUITES table_num_entries ( TLS_CIPHER_SUITES )
 
+/** Number of supported named curves */
+#define TLS_NUM_NAMED_CURVES table_num_entries ( TLS_NAMED_CURVES )
+
 /**
  * Identify cipher suite
  *
@@ -741,6 +802,25 @@ tls_find_cipher_suite ( unsigned int cipher_suite ) {
 	return NULL;
 }
 
+/**
+ * Identify named curve
+ *
+ * @v named_curve	Named curve specification
+ * @ret curve		Named curve, or NULL
+ */
+static struct tls_named_curve *
+tls_find_named_curve ( unsigned int named_curve ) {
+	struct tls_named_curve *curve;
+
+	/* Identify named curve */
+	for_each_table_entry ( curve, TLS_NAMED_CURVES ) {
+		if ( curve->code == named_curve )
+			return curve;
+	}
+
+	return NULL;
+}
+
 /**
  * Clear cipher suite
  *
@@ -829,7 +909,8 @@ static int tls_select_cipher ( struct tls_connection *tls,
 				     suite ) ) != 0 )
 		return rc;
 
-	DBGC ( tls, "TLS %p selected %s-%s-%d-%s\n", tls, suite->pubkey->name,
+	DBGC ( tls, "TLS %p selected %s-%s-%s-%d-%s\n", tls,
+	       suite->exchange->name, suite->pubkey->name,
 	       suite->cipher->name, ( suite->key_len * 8 ),
 	       suite->digest->name );
 
@@ -893,6 +974,27 @@ tls_signature_hash_algorithm ( struct pubkey_algorithm *pubkey,
 	return NULL;
 }
 
+/**
+ * Find TLS signature and hash algorithm by numeric code
+ *
+ * @v code		Numeric code
+ * @ret sig_hash	Signature and hash algorithm, or NULL
+ */
+static struct tls_signature_hash_algorithm *
+tls_signature_hash_algorithm_code ( struct tls_signature_hash_id code ) {
+	struct tls_signature_hash_algorithm *sig_hash;
+
+	/* Identify signature and hash algorithm */
+	for_each_table_entry ( sig_hash, TLS_SIG_HASH_ALGORITHMS ) {
+		if ( memcmp ( &sig_hash->code, &code,
+			      sizeof ( sig_hash->code ) ) == 0 ) {
+			return sig_hash;
+		}
+	}
+
+	return NULL;
+}
+
 /******************************************************************************
  *
  * Handshake verification
@@ -1041,6 +1143,19 @@ static int tls_send_client_hello ( struct tls_connection *tls ) {
 			struct {
 				uint8_t max;
 			} __attribute__ (( packed )) max_fragment_length;
+			uint16_t status_request_type;
+			uint16_t status_request_len;
+			struct {
+				uint8_t type;
+				uint16_t responder_id_list_len;
+				uint16_t request_extensions_len;
+			} __attribute__ (( packed )) status_request;
+			uint16_t named_curve_type;
+			uint16_t named_curve_len;
+			struct {
+				uint16_t len;
+				uint16_t code[TLS_NUM_NAMED_CURVES];
+			} __attribute__ (( packed )) named_curve;
 			uint16_t signature_algorithms_type;
 			uint16_t signature_algorithms_len;
 			struct {
@@ -1063,6 +1178,7 @@ static int tls_send_client_hello ( struct tls_connection *tls ) {
 		} __attribute__ (( packed )) extensions;
 	} __attribute__ (( packed )) hello;
 	struct tls_cipher_suite *suite;
+	struct tls_named_curve *curve;
 	struct tls_signature_hash_algorithm *sighash;
 	unsigned int i;
 
@@ -1097,6 +1213,17 @@ static int tls_send_client_hello ( struct tls_connection *tls ) {
 		= htons ( sizeof ( hello.extensions.max_fragment_length ) );
 	hello.extensions.max_fragment_length.max
 		= TLS_MAX_FRAGMENT_LENGTH_4096;
+	hello.extensions.status_request_type = htons ( TLS_STATUS_REQUEST );
+	hello.extensions.status_request_len
+		= htons ( sizeof ( hello.extensions.status_request ) );
+	hello.extensions.status_request.type = TLS_STATUS_TYPE_OCSP;
+	hello.extensions.named_curve_type = htons ( TLS_NAMED_CURVE );
+	hello.extensions.named_curve_len
+		= htons ( sizeof ( hello.extensions.named_curve ) );
+	hello.extensions.named_curve.len
+		= htons ( sizeof ( hello.extensions.named_curve.code ) );
+	i = 0 ; for_each_table_entry ( curve, TLS_NAMED_CURVES )
+		hello.extensions.named_curve.code[i++] = curve->code;
 	hello.extensions.signature_algorithms_type
 		= htons ( TLS_SIGNATURE_ALGORITHMS );
 	hello.extensions.signature_algorithms_len
@@ -1169,12 +1296,12 @@ static int tls_send_certificate ( struct tls_connection *tls ) {
 }
 
 /**
- * Transmit Client Key Exchange record
+ * Transmit Client Key Exchange record using public key exchange
  *
  * @v tls		TLS connection
  * @ret rc		Return status code
  */
-static int tls_send_client_key_exchange ( struct tls_connection *tls ) {
+static int tls_send_client_key_exchange_pubkey ( struct tls_connection *tls ) {
 	struct tls_cipherspec *cipherspec = &tls->tx_cipherspec_pending;
 	struct pubkey_algorithm *pubkey = cipherspec->suite->pubkey;
 	size_t max_len = pubkey_max_len ( pubkey, cipherspec->pubkey_ctx );
@@ -1187,6 +1314,10 @@ static int tls_send_client_key_exchange ( struct tls_connection *tls ) {
 	int len;
 	int rc;
 
+	/* Generate master secret */
+	tls_generate_master_secret ( tls, &tls->pre_master_secret,
+				     sizeof ( tls->pre_master_secret ) );
+
 	/* Encrypt pre-master secret using server's public key */
 	memset ( &key_xchg, 0, sizeof ( key_xchg ) );
 	len = pubkey_encrypt ( pubkey, cipherspec->pubkey_ctx,
@@ -1212,6 +1343,241 @@ static int tls_send_client_key_exchange ( struct tls_connection *tls ) {
 				    ( sizeof ( key_xchg ) - unused ) );
 }
 
+/** Public key exchange algorithm */
+struct tls_key_exchange_algorithm tls_pubkey_exchange_algorithm = {
+	.name = "pubkey",
+	.exchange = tls_send_client_key_exchange_pubkey,
+};
+
+/**
+ * Verify Server Key Exchange parameter signature
+ *
+ * @v tls		TLS connection
+ * @v param_len		Length of Diffie-Hellman parameters
+ * @ret rc		Return status code
+ *
+ * The signature covers the client and server random values along
+ * with the Diffie-Hellman parameters, and is generated using the key
+ * from the (already validated) server certificate.
+ */
+static int tls_verify_dh_params ( struct tls_connection *tls,
+				  size_t param_len ) {
+	struct tls_cipherspec *cipherspec = &tls->tx_cipherspec_pending;
+	struct pubkey_algorithm *pubkey = cipherspec->suite->pubkey;
+	struct tls_signature_hash_algorithm *sig_hash;
+	struct digest_algorithm *digest;
+	const struct {
+		struct tls_signature_hash_id sig_hash;
+		uint16_t signature_len;
+		uint8_t signature[0];
+	} __attribute__ (( packed )) *sig;
+	size_t signature_len;
+	size_t remaining;
+	int rc;
+
+	/* Sanity check */
+	assert ( param_len <= tls->server_key_len );
+
+	/* TLSv1.1 and earlier use a hybrid MD5+SHA1 digest with no
+	 * explicit algorithm identifier, which our RSA implementation
+	 * cannot verify.  Any server offering ECDHE will also speak
+	 * TLSv1.2, so this is not a practical limitation.
+	 */
+	if ( tls->version < TLS_VERSION_TLS_1_2 ) {
+		DBGC ( tls, "TLS %p cannot verify key exchange signature "
+		       "for protocol version %d.%d\n", tls,
+		       ( tls->version >> 8 ), ( tls->version & 0xff ) );
+		return -ENOTSUP_SIG_HASH;
+	}
+
+	/* Parse signature */
+	sig = ( tls->server_key + param_len );
+	remaining = ( tls->server_key_len - param_len );
+	if ( ( sizeof ( *sig ) > remaining ) ||
+	     ( ( signature_len = ntohs ( sig->signature_len ) ) >
+	       ( remaining - sizeof ( *sig ) ) ) ) {
+		DBGC ( tls, "TLS %p received underlength key exchange "
+		       "signature\n", tls );
+		DBGC_HD ( tls, tls->server_key, tls->server_key_len );
+		return -EINVAL_KEY_EXCHANGE;
+	}
+
+	/* Identify signature and hash algorithm */
+	sig_hash = tls_signature_hash_algorithm_code ( sig->sig_hash );
+	if ( ( ! sig_hash ) || ( sig_hash->pubkey != pubkey ) ) {
+		DBGC ( tls, "TLS %p unsupported key exchange signature "
+		       "algorithm (%d,%d)\n", tls, sig->sig_hash.hash,
+		       sig->sig_hash.signature );
+		return -ENOTSUP_SIG_HASH;
+	}
+	digest = sig_hash->digest;
+
+	/* Verify signature */
+	{
+		uint8_t ctx[ digest->ctxsize ];
+		uint8_t hash[ digest->digestsize ];
+
+		/* Calculate digest over client random, server
+		 * random, and Diffie-Hellman parameters.
+		 */
+		digest_init ( digest, ctx );
+		digest_update ( digest, ctx, &tls->client_random,
+				sizeof ( tls->client_random ) );
+		digest_update ( digest, ctx, tls->server_random,
+				sizeof ( tls->server_random ) );
+		digest_update ( digest, ctx, tls->server_key, param_len );
+		digest_final ( digest, ctx, hash );
+
+		/* Verify signature using the server certificate's
+		 * public key, which has already been initialised by
+		 * the certificate validator.
+		 */
+		if ( ( rc = pubkey_verify ( pubkey, cipherspec->pubkey_ctx,
+					    digest, hash, sig->signature,
+					    signature_len ) ) != 0 ) {
+			DBGC ( tls, "TLS %p invalid key exchange signature: "
+			       "%s\n", tls, strerror ( rc ) );
+			return -EPERM_KEY_EXCHANGE;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Transmit Client Key Exchange record using ECDHE key exchange
+ *
+ * @v tls		TLS connection
+ * @ret rc		Return status code
+ */
+static int tls_send_client_key_exchange_ecdhe ( struct tls_connection *tls ) {
+	const struct {
+		uint8_t curve_type;
+		uint16_t named_curve;
+		uint8_t public_len;
+		uint8_t public[0];
+	} __attribute__ (( packed )) *ecdh = tls->server_key;
+	struct tls_named_curve *curve;
+	size_t param_len;
+	int rc;
+
+	/* Parse ephemeral Diffie-Hellman parameters */
+	if ( ( sizeof ( *ecdh ) > tls->server_key_len ) ||
+	     ( ecdh->public_len >
+	       ( tls->server_key_len - sizeof ( *ecdh ) ) ) ) {
+		DBGC ( tls, "TLS %p received underlength Server Key "
+		       "Exchange\n", tls );
+		DBGC_HD ( tls, tls->server_key, tls->server_key_len );
+		return -EINVAL_KEY_EXCHANGE;
+	}
+	param_len = ( sizeof ( *ecdh ) + ecdh->public_len );
+
+	/* Identify named curve */
+	if ( ecdh->curve_type != TLS_NAMED_CURVE_TYPE ) {
+		DBGC ( tls, "TLS %p unsupported curve type %d\n",
+		       tls, ecdh->curve_type );
+		return -ENOTSUP_CURVE;
+	}
+	curve = tls_find_named_curve ( ecdh->named_curve );
+	if ( ! curve ) {
+		DBGC ( tls, "TLS %p unsupported named curve %d\n",
+		       tls, ntohs ( ecdh->named_curve ) );
+		return -ENOTSUP_CURVE;
+	}
+	if ( ecdh->public_len != curve->curve->keysize ) {
+		DBGC ( tls, "TLS %p invalid %s server public key\n",
+		       tls, curve->curve->name );
+		DBGC_HD ( tls, tls->server_key, tls->server_key_len );
+		return -EINVAL_KEY_EXCHANGE;
+	}
+
+	/* Verify parameter signature */
+	if ( ( rc = tls_verify_dh_params ( tls, param_len ) ) != 0 )
+		return rc;
+
+	/* Generate ephemeral key pair, calculate shared secret, and
+	 * transmit Client Key Exchange record.
+	 */
+	{
+		size_t keysize = curve->curve->keysize;
+		uint8_t private[keysize];
+		uint8_t shared[keysize];
+		struct {
+			uint32_t type_length;
+			uint8_t public_len;
+			uint8_t public[keysize];
+		} __attribute__ (( packed )) key_xchg;
+
+		/* Generate ephemeral private key */
+		if ( ( rc = tls_generate_random ( tls, private,
+						  sizeof ( private ) ) ) != 0 )
+			return rc;
+
+		/* Calculate shared secret */
+		if ( ( rc = elliptic_multiply ( curve->curve, ecdh->public,
+						private, shared ) ) != 0 ) {
+			DBGC ( tls, "TLS %p could not calculate %s shared "
+			       "secret: %s\n", tls, curve->curve->name,
+			       strerror ( rc ) );
+			return rc;
+		}
+
+		/* Generate master secret from shared secret */
+		tls_generate_master_secret ( tls, shared, sizeof ( shared ) );
+
+		/* Generate and transmit ephemeral public key */
+		memset ( &key_xchg, 0, sizeof ( key_xchg ) );
+		if ( ( rc = elliptic_multiply ( curve->curve, NULL, private,
+						key_xchg.public ) ) != 0 ) {
+			DBGC ( tls, "TLS %p could not generate %s public "
+			       "key: %s\n", tls, curve->curve->name,
+			       strerror ( rc ) );
+			return rc;
+		}
+		key_xchg.type_length =
+			( cpu_to_le32 ( TLS_CLIENT_KEY_EXCHANGE ) |
+			  htonl ( sizeof ( key_xchg ) -
+				  sizeof ( key_xchg.type_length ) ) );
+		key_xchg.public_len = sizeof ( key_xchg.public );
+
+		return tls_send_handshake ( tls, &key_xchg,
+					    sizeof ( key_xchg ) );
+	}
+}
+
+/** Ephemeral Elliptic Curve Diffie-Hellman key exchange algorithm */
+struct tls_key_exchange_algorithm tls_ecdhe_exchange_algorithm = {
+	.name = "ecdhe",
+	.exchange = tls_send_client_key_exchange_ecdhe,
+};
+
+/**
+ * Transmit Client Key Exchange record
+ *
+ * @v tls		TLS connection
+ * @ret rc		Return status code
+ */
+static int tls_send_client_key_exchange ( struct tls_connection *tls ) {
+	struct tls_cipherspec *cipherspec = &tls->tx_cipherspec_pending;
+	struct tls_cipher_suite *suite = cipherspec->suite;
+	int rc;
+
+	/* Transmit Client Key Exchange record via key exchange mechanism */
+	if ( ( rc = suite->exchange->exchange ( tls ) ) != 0 )
+		return rc;
+
+	/* Free any recorded Server Key Exchange record */
+	free ( tls->server_key );
+	tls->server_key = NULL;
+	tls->server_key_len = 0;
+
+	/* Generate keys from master secret */
+	if ( ( rc = tls_generate_keys ( tls ) ) != 0 )
+		return rc;
+
+	return 0;
+}
+
 /**
  * Transmit Certificate Verify record
  *
@@ -1589,7 +1955,7 @@ static int tls_new_server_hello ( struct tls_connection *tls,
 	if ( ( rc = tls_select_cipher ( tls, hello_b->cipher_suite ) ) != 0 )
 		return rc;
 
-	/* Reuse or generate master secret */
+	/* Reuse master secret, if possible */
 	if ( hello_a->session_id_len &&
 	     ( hello_a->session_id_len == tls->session_id_len ) &&
 	     ( memcmp ( session_id, tls->session_id,
@@ -1599,12 +1965,19 @@ static int tls_new_server_hello ( struct tls_connection *tls,
 		DBGC ( tls, "TLS %p resuming session ID:\n", tls );
 		DBGC_HDA ( tls, 0, tls->session_id, tls->session_id_len );
 
-	} else {
+		/* Generate keys immediately, since no Client Key
+		 * Exchange will be sent.
+		 */
+		if ( ( rc = tls_generate_keys ( tls ) ) != 0 )
+			return rc;
 
-		/* Generate new master secret */
-		tls_generate_master_secret ( tls );
+	} else {
 
-		/* Record new session ID, if present */
+		/* Record new session ID, if present.  The master
+		 * secret (and hence the keys) cannot yet be
+		 * generated, since the pre-master secret is not
+		 * determined until the Client Key Exchange is sent.
+		 */
 		if ( hello_a->session_id_len &&
 		     ( hello_a->session_id_len <= sizeof ( tls->session_id ))){
 			tls->session_id_len = hello_a->session_id_len;
@@ -1616,10 +1989,6 @@ static int tls_new_server_hello ( struct tls_connection *tls,
 		}
 	}
 
-	/* Generate keys */
-	if ( ( rc = tls_generate_keys ( tls ) ) != 0 )
-		return rc;
-
 	/* Handle secure renegotiation */
 	if ( tls->secure_renegotiation ) {
 
@@ -1816,6 +2185,92 @@ static int tls_new_certificate ( struct tls_connection *tls,
 	return 0;
 }
 
+/**
+ * Receive new Certificate Status handshake record
+ *
+ * @v tls		TLS connection
+ * @v data		Plaintext handshake record
+ * @v len		Length of plaintext handshake record
+ * @ret rc		Return status code
+ */
+static int tls_new_certificate_status ( struct tls_connection *tls,
+					const void *data, size_t len ) {
+	const struct {
+		uint8_t status_type;
+		tls24_t length;
+		uint8_t response[0];
+	} __attribute__ (( packed )) *status = data;
+	size_t response_len;
+
+	/* Parse header */
+	if ( sizeof ( *status ) > len ) {
+		DBGC ( tls, "TLS %p received underlength Certificate Status\n",
+		       tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_STATUS;
+	}
+	response_len = tls_uint24 ( &status->length );
+	if ( response_len > ( len - sizeof ( *status ) ) ) {
+		DBGC ( tls, "TLS %p received overlength Certificate Status\n",
+		       tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_STATUS;
+	}
+
+	/* Ignore unsupported status types */
+	if ( status->status_type != TLS_STATUS_TYPE_OCSP ) {
+		DBGC ( tls, "TLS %p ignoring status type %d\n",
+		       tls, status->status_type );
+		return 0;
+	}
+
+	/* Free any existing stapled OCSP response */
+	free ( tls->staple );
+	tls->staple = NULL;
+	tls->staple_len = 0;
+
+	/* Record stapled OCSP response for use during certificate
+	 * validation.
+	 */
+	tls->staple = malloc ( response_len );
+	if ( ! tls->staple )
+		return -ENOMEM;
+	memcpy ( tls->staple, status->response, response_len );
+	tls->staple_len = response_len;
+	DBGC ( tls, "TLS %p received stapled OCSP response\n", tls );
+	DBGC2_HDA ( tls, 0, tls->staple, tls->staple_len );
+
+	return 0;
+}
+
+/**
+ * Receive new Server Key Exchange handshake record
+ *
+ * @v tls		TLS connection
+ * @v data		Plaintext handshake record
+ * @v len		Length of plaintext handshake record
+ * @ret rc		Return status code
+ */
+static int tls_new_server_key_exchange ( struct tls_connection *tls,
+					 const void *data, size_t len ) {
+
+	/* Free any existing Server Key Exchange record */
+	free ( tls->server_key );
+	tls->server_key_len = 0;
+
+	/* Record Server Key Exchange record.  It cannot be processed
+	 * immediately, since the signature cannot be verified until
+	 * the server certificate has been validated.
+	 */
+	tls->server_key = malloc ( len );
+	if ( ! tls->server_key )
+		return -ENOMEM;
+	memcpy ( tls->server_key, data, len );
+	tls->server_key_len = len;
+
+	return 0;
+}
+
 /**
  * Receive new Certificate Request handshake record
  *
@@ -1873,7 +2328,8 @@ static int tls_new_server_hello_done ( struct tls_connection *tls,
 	}
 
 	/* Begin certificate validation */
-	if ( ( rc = create_validator ( &tls->validator, tls->chain ) ) != 0 ) {
+	if ( ( rc = create_validator ( &tls->validator, tls->chain,
+				       tls->staple, tls->staple_len ) ) != 0 ) {
 		DBGC ( tls, "TLS %p could not start certificate validation: "
 		       "%s\n", tls, strerror ( rc ) );
 		return rc;
@@ -2017,6 +2473,14 @@ static int tls_new_handshake ( struct tls_connection *tls,
 		case TLS_CERTIFICATE:
 			rc = tls_new_certificate ( tls, payload, payload_len );
 			break;
+		case TLS_CERTIFICATE_STATUS:
+			rc = tls_new_certificate_status ( tls, payload,
+							  payload_len );
+			break;
+		case TLS_SERVER_KEY_EXCHANGE:
+			rc = tls_new_server_key_exchange ( tls, payload,
+							   payload_len );
+			break;
 		case TLS_CERTIFICATE_REQUEST:
 			rc = tls_new_certificate_request ( tls, payload,
 							   payload_len );
@@ -2348,8 +2812,10 @@ static int tls_send_plaintext ( struct tls_connection *tls, unsigned int type,
 	tlshdr->length = htons ( plaintext_len );
 	memcpy ( cipherspec->cipher_next_ctx, cipherspec->cipher_ctx,
 		 cipher->ctxsize );
+	profile_start_lite ( &tls_tx_profiler );
 	cipher_encrypt ( cipher, cipherspec->cipher_next_ctx, plaintext,
 			 iob_put ( ciphertext, plaintext_len ), plaintext_len );
+	profile_stop_lite ( &tls_tx_profiler );
 
 	/* Free plaintext as soon as possible to conserve memory */
 	free ( plaintext );
@@ -2482,10 +2948,12 @@ static int tls_new_ciphertext ( struct tls_connection *tls,
 	int rc;
 
 	/* Decrypt the received data */
+	profile_start_lite ( &tls_rx_profiler );
 	list_for_each_entry ( iobuf, &tls->rx_data, list ) {
 		cipher_decrypt ( cipher, cipherspec->cipher_ctx,
 				 iobuf->data, iobuf->data, iob_len ( iobuf ) );
 	}
+	profile_stop_lite ( &tls_rx_profiler );
 
 	/* Split record into content and MAC */
 	if ( is_stream_cipher ( cipher ) ) {
@@ -2540,8 +3008,8 @@ static int tls_new_ciphertext ( struct tls_connection *tls,
  */
 static size_t tls_plainstream_window ( struct tls_connection *tls ) {
 
-	/* Block window unless we are ready to accept data */
-	if ( ! tls_ready ( tls ) )
+	/* Block window unless we are ready to transmit data */
+	if ( ! tls_ready_tx ( tls ) )
 		return 0;
 
 	return xfer_window ( &tls->cipherstream );
@@ -2560,8 +3028,8 @@ static int tls_plainstream_deliver ( struct tls_connection *tls,
 				     struct xfer_metadata *meta __unused ) {
 	int rc;
 	
-	/* Refuse unless we are ready to accept data */
-	if ( ! tls_ready ( tls ) ) {
+	/* Refuse unless we are ready to transmit data */
+	if ( ! tls_ready_tx ( tls ) ) {
 		rc = -ENOTCONN;
 		goto done;
 	}
@@ -2631,6 +3099,7 @@ static int tls_newdata_process_header ( struct tls_connection *tls ) {
 
 	/* Allocate data buffers now that we know the length */
 	assert ( list_empty ( &tls->rx_data ) );
+	assert ( tls->rx_frags == 0 );
 	while ( remaining ) {
 
 		/* Calculate fragment length.  Ensure that no block is
@@ -2665,6 +3134,7 @@ static int tls_newdata_process_header ( struct tls_connection *tls ) {
 
 		/* Add I/O buffer to list */
 		list_add_tail ( &iobuf->list, &tls->rx_data );
+		tls->rx_frags++;
 	}
 
 	/* Move to data state */
@@ -2677,6 +3147,7 @@ static int tls_newdata_process_header ( struct tls_connection *tls ) {
 		list_del ( &iobuf->list );
 		free_iob ( iobuf );
 	}
+	tls->rx_frags = 0;
 	return rc;
 }
 
@@ -2695,9 +3166,13 @@ static int tls_newdata_process_data ( struct tls_connection *tls ) {
 	list_del ( &iobuf->list );
 	list_add_tail ( &iobuf->list, &tls->rx_data );
 
-	/* Continue receiving data if any space remains */
-	iobuf = list_first_entry ( &tls->rx_data, struct io_buffer, list );
-	if ( iob_tailroom ( iobuf ) )
+	/* Continue receiving data if any buffers remain unfilled.
+	 * The unfilled count (rather than the remaining tailroom) must
+	 * be used, since a buffer claimed directly from the
+	 * ciphertext stream may have residual tailroom of its own.
+	 */
+	assert ( tls->rx_frags > 0 );
+	if ( --tls->rx_frags )
 		return 0;
 
 	/* Process record */
@@ -2747,7 +3222,7 @@ static int tls_cipherstream_deliver ( struct tls_connection *tls,
 	struct io_buffer *dest;
 	int rc;
 
-	while ( iob_len ( iobuf ) ) {
+	while ( iobuf && iob_len ( iobuf ) ) {
 
 		/* Select buffer according to current state */
 		switch ( tls->rx_state ) {
@@ -2767,19 +3242,44 @@ static int tls_cipherstream_deliver ( struct tls_connection *tls,
 			goto done;
 		}
 
-		/* Copy data portion to buffer */
-		frag_len = iob_len ( iobuf );
-		if ( frag_len > iob_tailroom ( dest ) )
-			frag_len = iob_tailroom ( dest );
-		memcpy ( iob_put ( dest, frag_len ), iobuf->data, frag_len );
-		iob_pull ( iobuf, frag_len );
-
-		/* Process data if buffer is now full */
-		if ( iob_tailroom ( dest ) == 0 ) {
-			if ( ( rc = process ( tls ) ) != 0 ) {
-				tls_close ( tls, rc );
-				goto done;
-			}
+		/* If the received buffer exactly matches an empty
+		 * record fragment (and meets the fragment alignment
+		 * requirement), then claim it in place of the fragment
+		 * and so avoid copying the record contents.  This
+		 * applies whenever a record arrives within a single
+		 * received buffer.
+		 */
+		if ( ( dest != &tls->rx_header_iobuf ) &&
+		     ( iob_len ( dest ) == 0 ) &&
+		     ( iob_len ( iobuf ) == iob_tailroom ( dest ) ) &&
+		     ( ( ( ( intptr_t ) iobuf->data ) &
+			 ( TLS_RX_ALIGN - 1 ) ) == 0 ) ) {
+
+			/* Replace fragment with received buffer */
+			list_add ( &iobuf->list, &dest->list );
+			list_del ( &dest->list );
+			free_iob ( dest );
+			iobuf = NULL;
+
+		} else {
+
+			/* Copy data portion to buffer */
+			frag_len = iob_len ( iobuf );
+			if ( frag_len > iob_tailroom ( dest ) )
+				frag_len = iob_tailroom ( dest );
+			memcpy ( iob_put ( dest, frag_len ), iobuf->data,
+				 frag_len );
+			iob_pull ( iobuf, frag_len );
+
+			/* Wait for more data if buffer is not yet full */
+			if ( iob_tailroom ( dest ) != 0 )
+				continue;
+		}
+
+		/* Process now-complete buffer */
+		if ( ( rc = process ( tls ) ) != 0 ) {
+			tls_close ( tls, rc );
+			goto done;
 		}
 	}
 	rc = 0;
@@ -3016,6 +3516,39 @@ static struct process_descriptor tls_process_desc =
  ******************************************************************************
  */
 
+/**
+ * Prune least recently used idle sessions from session cache
+ *
+ */
+static void tls_session_prune ( void ) {
+	struct tls_session *session;
+	struct tls_session *evictee;
+	unsigned int count = 0;
+
+	/* Count cached sessions */
+	list_for_each_entry ( session, &tls_sessions, list )
+		count++;
+
+	/* Evict least recently used sessions with no remaining
+	 * connections, until within the cache size limit.
+	 */
+	while ( count > TLS_NUM_SESSIONS ) {
+		evictee = NULL;
+		list_for_each_entry_reverse ( session, &tls_sessions, list ) {
+			if ( list_empty ( &session->conn ) ) {
+				evictee = session;
+				break;
+			}
+		}
+		if ( ! evictee )
+			break;
+		DBGC ( evictee, "TLS session %s evicted\n", evictee->name );
+		list_del ( &evictee->list );
+		ref_put ( &evictee->refcnt );
+		count--;
+	}
+}
+
 /**
  * Find or create session for TLS connection
  *
@@ -3031,6 +3564,9 @@ static int tls_session ( struct tls_connection *tls, const char *name ) {
 	/* Find existing matching session, if any */
 	list_for_each_entry ( session, &tls_sessions, list ) {
 		if ( strcmp ( name, session->name ) == 0 ) {
+			/* Mark session as most recently used */
+			list_del ( &session->list );
+			list_add ( &session->list, &tls_sessions );
 			ref_get ( &session->refcnt );
 			tls->session = session;
 			DBGC ( tls, "TLS %p joining session %s\n", tls, name );
@@ -3050,7 +3586,15 @@ static int tls_session ( struct tls_connection *tls, const char *name ) {
 	strcpy ( name_copy, name );
 	session->name = name_copy;
 	INIT_LIST_HEAD ( &session->conn );
+
+	/* Add to session cache, which holds its own reference so
+	 * that the session (and hence its master secret, session ID,
+	 * and ticket) remains available for resumption by later
+	 * connections after the last current connection closes.
+	 */
 	list_add ( &session->list, &tls_sessions );
+	ref_get ( &session->refcnt );
+	tls_session_prune();
 
 	/* Record session */
 	tls->session = session;
@@ -63,6 +63,56 @@ static int udp_port_available ( int port ) {
 	return port;
 }
 
+/**
+ * Join or leave multicast group for a UDP connection
+ *
+ * @v udp		UDP connection
+ * @v join		Join (rather than leave) the group
+ *
+ * A connection listening on a multicast address (such as a SLAM
+ * client) joins the corresponding link-layer group on all network
+ * devices, so that devices with a hardware multicast filter will
+ * accept the traffic.
+ */
+static void udp_mcast ( struct udp_connection *udp, int join ) {
+	struct sockaddr_in *sin = ( struct sockaddr_in * ) &udp->local;
+	struct sockaddr_in6 *sin6 = ( struct sockaddr_in6 * ) &udp->local;
+	struct net_device *netdev;
+	struct ll_protocol *ll_protocol;
+	uint8_t ll_addr[MAX_LL_ADDR_LEN];
+	const void *net_addr;
+
+	/* Identify local multicast address, if any */
+	switch ( udp->local.st_family ) {
+	case AF_INET:
+		if ( ! IN_IS_MULTICAST ( sin->sin_addr.s_addr ) )
+			return;
+		net_addr = &sin->sin_addr;
+		break;
+	case AF_INET6:
+		if ( ! IN6_IS_ADDR_MULTICAST ( &sin6->sin6_addr ) )
+			return;
+		net_addr = &sin6->sin6_addr;
+		break;
+	default:
+		return;
+	}
+
+	/* Join or leave group on all network devices */
+	for_each_netdev ( netdev ) {
+		ll_protocol = netdev->ll_protocol;
+		if ( ( ! ll_protocol->mc_hash ) ||
+		     ( ll_protocol->mc_hash ( udp->local.st_family, net_addr,
+					      ll_addr ) != 0 ) )
+			continue;
+		if ( join ) {
+			netdev_mcast_join ( netdev, ll_addr );
+		} else {
+			netdev_mcast_leave ( netdev, ll_addr );
+		}
+	}
+}
+
 /**
  * Open a UDP connection
  *
@@ -107,6 +157,9 @@ static int udp_open_common ( struct interface *xfer,
 		       udp, ntohs ( udp->local.st_port ) );
 	}
 
+	/* Join multicast group, if applicable */
+	udp_mcast ( udp, 1 );
+
 	/* Attach parent interface, transfer reference to connection
 	 * list and return
 	 */
@@ -153,6 +206,9 @@ int udp_open_promisc ( struct interface *xfer ) {
  */
 static void udp_close ( struct udp_connection *udp, int rc ) {
 
+	/* Leave multicast group, if applicable */
+	udp_mcast ( udp, 0 );
+
 	/* Close data transfer interface */
 	intf_shutdown ( &udp->xfer, rc );
 
@@ -285,7 +341,7 @@ static int udp_rx ( struct io_buffer *iobuf,
 		rc = -EINVAL;
 		goto done;
 	}
-	if ( udphdr->chksum ) {
+	if ( udphdr->chksum && ( ! ( iobuf->flags & IOB_FL_HW_CSUM ) ) ) {
 		csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data, ulen );
 		if ( csum != 0 ) {
 			DBG ( "UDP checksum incorrect (is %04x including "
@@ -350,13 +406,12 @@ static struct io_buffer * udp_xfer_alloc_iob ( struct udp_connection *udp,
 					       size_t len ) {
 	struct io_buffer *iobuf;
 
-	iobuf = alloc_iob ( MAX_LL_NET_HEADER_LEN + len );
+	iobuf = alloc_iob_headroom ( len, MAX_LL_NET_HEADER_LEN );
 	if ( ! iobuf ) {
 		DBGC ( udp, "UDP %p cannot allocate buffer of length %zd\n",
 		       udp, len );
 		return NULL;
 	}
-	iob_reserve ( iobuf, MAX_LL_NET_HEADER_LEN );
 	return iobuf;
 }
 
@@ -48,6 +48,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/dhcppkt.h>
 #include <ipxe/dhcp_arch.h>
 #include <ipxe/features.h>
+#include <ipxe/boottrace.h>
 #include <config/dhcp.h>
 
 /** @file
@@ -191,6 +192,7 @@ struct dhcp_session_state {
 };
 
 static struct dhcp_session_state dhcp_state_discover;
+static struct dhcp_session_state dhcp_state_reboot;
 static struct dhcp_session_state dhcp_state_request;
 static struct dhcp_session_state dhcp_state_proxy;
 static struct dhcp_session_state dhcp_state_pxebs;
@@ -199,6 +201,8 @@ static struct dhcp_session_state dhcp_state_pxebs;
 struct dhcp_session {
 	/** Reference counter */
 	struct refcnt refcnt;
+	/** List of DHCP sessions */
+	struct list_head list;
 	/** Job control interface */
 	struct interface job;
 	/** Data transfer interface */
@@ -242,8 +246,13 @@ struct dhcp_session {
 	unsigned int count;
 	/** Start time of the current state (in ticks) */
 	unsigned long start;
+	/** Discovery is deferred pending link unblock */
+	int defer;
 };
 
+/** List of DHCP sessions */
+static LIST_HEAD ( dhcp_sessions );
+
 /**
  * Free DHCP session
  *
@@ -266,6 +275,9 @@ static void dhcp_free ( struct refcnt *refcnt ) {
  */
 static void dhcp_finished ( struct dhcp_session *dhcp, int rc ) {
 
+	/* Remove from list of sessions */
+	list_del ( &dhcp->list );
+
 	/* Stop retry timer */
 	stop_timer ( &dhcp->timer );
 
@@ -284,6 +296,7 @@ static void dhcp_set_state ( struct dhcp_session *dhcp,
 			     struct dhcp_session_state *state ) {
 
 	DBGC ( dhcp, "DHCP %p entering %s state\n", dhcp, state->name );
+	boottrace_mark ( "dhcp/%s", state->name );
 	dhcp->state = state;
 	dhcp->start = currticks();
 	stop_timer ( &dhcp->timer );
@@ -316,6 +329,124 @@ static int dhcp_has_pxeopts ( struct dhcp_packet *dhcppkt ) {
 	return 0;
 }
 
+/****************************************************************************
+ *
+ * DHCP lease cache
+ *
+ */
+
+/** Maximum period for which a cached lease may be reused (in seconds)
+ *
+ * Reuse is additionally limited to half of the advertised lease time,
+ * i.e. to the period within which a client that had remained powered
+ * on would not yet even have attempted to renew its lease.
+ */
+#ifndef DHCP_LEASE_REUSE_MAX_SEC
+#define DHCP_LEASE_REUSE_MAX_SEC 3600
+#endif
+
+/** A cached DHCP lease */
+struct dhcp_lease {
+	/** List of cached leases */
+	struct list_head list;
+	/** Link-layer address */
+	uint8_t ll_addr[MAX_LL_ADDR_LEN];
+	/** Leased IP address */
+	struct in_addr address;
+	/** DHCP server */
+	struct in_addr server;
+	/** Expiry time of reuse period (in ticks) */
+	unsigned long expiry;
+};
+
+/** List of cached DHCP leases */
+static LIST_HEAD ( dhcp_leases );
+
+/**
+ * Find cached lease for network device
+ *
+ * @v netdev		Network device
+ * @ret lease		Cached lease, or NULL if not found
+ *
+ * Expired leases encountered during the lookup are evicted.
+ */
+static struct dhcp_lease * dhcp_lease_find ( struct net_device *netdev ) {
+	struct dhcp_lease *lease;
+	struct dhcp_lease *tmp;
+	unsigned long now = currticks();
+
+	list_for_each_entry_safe ( lease, tmp, &dhcp_leases, list ) {
+
+		/* Evict expired leases */
+		if ( ( ( signed long ) ( now - lease->expiry ) ) >= 0 ) {
+			list_del ( &lease->list );
+			free ( lease );
+			continue;
+		}
+
+		/* Check for matching link-layer address */
+		if ( memcmp ( lease->ll_addr, netdev->ll_addr,
+			      netdev->ll_protocol->ll_addr_len ) == 0 )
+			return lease;
+	}
+
+	return NULL;
+}
+
+/**
+ * Discard cached lease for network device (if any)
+ *
+ * @v netdev		Network device
+ */
+static void dhcp_lease_del ( struct net_device *netdev ) {
+	struct dhcp_lease *lease;
+
+	if ( ( lease = dhcp_lease_find ( netdev ) ) != NULL ) {
+		list_del ( &lease->list );
+		free ( lease );
+	}
+}
+
+/**
+ * Cache lease for network device
+ *
+ * @v netdev		Network device
+ * @v address		Leased IP address
+ * @v server		DHCP server
+ * @v lease_sec		Advertised lease time (in seconds)
+ *
+ * Failures are ignored, since the cache is only an optimisation.
+ */
+static void dhcp_lease_add ( struct net_device *netdev,
+			     struct in_addr address, struct in_addr server,
+			     uint32_t lease_sec ) {
+	struct dhcp_lease *lease;
+	uint32_t reuse_sec;
+
+	/* Replace any existing lease for this device */
+	dhcp_lease_del ( netdev );
+
+	/* Limit reuse period to half of the lease time, capped at a
+	 * maximum; do not cache zero-lifetime leases.
+	 */
+	reuse_sec = ( lease_sec / 2 );
+	if ( reuse_sec > DHCP_LEASE_REUSE_MAX_SEC )
+		reuse_sec = DHCP_LEASE_REUSE_MAX_SEC;
+	if ( reuse_sec == 0 )
+		return;
+
+	/* Allocate and initialise lease */
+	lease = zalloc ( sizeof ( *lease ) );
+	if ( ! lease )
+		return;
+	memcpy ( lease->ll_addr, netdev->ll_addr,
+		 netdev->ll_protocol->ll_addr_len );
+	lease->address = address;
+	lease->server = server;
+	lease->expiry = ( currticks() + ( reuse_sec * TICKS_PER_SEC ) );
+	list_add ( &lease->list, &dhcp_leases );
+}
+
 /****************************************************************************
  *
  * DHCP state machine
@@ -455,12 +586,14 @@ static void dhcp_discovery_expired ( struct dhcp_session *dhcp ) {
 	if ( netdev_link_blocked ( dhcp->netdev ) &&
 	     ( dhcp->count <= DHCP_DISC_MAX_DEFERRALS ) ) {
 		DBGC ( dhcp, "DHCP %p deferring discovery\n", dhcp );
+		dhcp->defer = 1;
 		dhcp->start = currticks();
 		start_timer_fixed ( &dhcp->timer,
 				    ( DHCP_DISC_START_TIMEOUT_SEC *
 				      TICKS_PER_SEC ) );
 		return;
 	}
+	dhcp->defer = 0;
 
 	/* Give up waiting for ProxyDHCP before we reach the failure point */
 	if ( dhcp->offer.s_addr &&
@@ -484,6 +617,41 @@ static struct dhcp_session_state dhcp_state_discover = {
 	.max_timeout_sec	= DHCP_DISC_END_TIMEOUT_SEC,
 };
 
+/**
+ * Handle network device or link state change
+ *
+ * @v netdev		Network device
+ */
+static void dhcp_notify ( struct net_device *netdev ) {
+	struct dhcp_session *dhcp;
+
+	/* Do nothing unless link is up and no longer blocked */
+	if ( ( ! netdev_link_ok ( netdev ) ) ||
+	     netdev_link_blocked ( netdev ) )
+		return;
+
+	/* Resume any discovery deferred pending link unblock.  The
+	 * spanning tree port's transition to forwarding is signalled
+	 * by an observed BPDU rather than by our own timer, so
+	 * waiting out the current deferral interval would add up to
+	 * one full re-check period of needless delay.
+	 */
+	list_for_each_entry ( dhcp, &dhcp_sessions, list ) {
+		if ( ( dhcp->netdev == netdev ) && dhcp->defer &&
+		     ( dhcp->state == &dhcp_state_discover ) ) {
+			DBGC ( dhcp, "DHCP %p resuming deferred discovery\n",
+			       dhcp );
+			start_timer_nodelay ( &dhcp->timer );
+		}
+	}
+}
+
+/** DHCP network device driver */
+struct net_driver dhcp_driver __net_driver = {
+	.name = "DHCP",
+	.notify = dhcp_notify,
+};
+
 /**
  * Construct transmitted packet for DHCP request
  *
@@ -537,6 +705,7 @@ static void dhcp_request_rx ( struct dhcp_session *dhcp,
 	struct in_addr ip;
 	struct settings *parent;
 	struct settings *settings;
+	uint32_t lease_sec;
 	int rc;
 
 	DBGC ( dhcp, "DHCP %p %s from %s:%d", dhcp,
@@ -567,6 +736,19 @@ static void dhcp_request_rx ( struct dhcp_session *dhcp,
 	/* Record assigned address */
 	dhcp->local.sin_addr = ip;
 
+	/* Cache lease for later reuse via INIT-REBOOT.  Do not cache
+	 * leases from sessions involving a ProxyDHCP offer, since an
+	 * INIT-REBOOT request would bypass discovery and so lose the
+	 * PXE options provided by the proxy.
+	 */
+	if ( ( dhcp->no_pxedhcp || ( ! dhcp->proxy_offer ) ) &&
+	     ( dhcppkt_fetch ( dhcppkt, DHCP_LEASE_TIME, &lease_sec,
+			       sizeof ( lease_sec ) ) ==
+	       ( ( int ) sizeof ( lease_sec ) ) ) ) {
+		dhcp_lease_add ( dhcp->netdev, ip, server_id,
+				 ntohl ( lease_sec ) );
+	}
+
 	/* Register settings */
 	parent = netdev_settings ( dhcp->netdev );
 	settings = &dhcppkt->settings;
@@ -627,6 +809,91 @@ static struct dhcp_session_state dhcp_state_request = {
 	.max_timeout_sec	= DHCP_REQ_END_TIMEOUT_SEC,
 };
 
+/**
+ * Construct transmitted packet for DHCP INIT-REBOOT request
+ *
+ * @v dhcp		DHCP session
+ * @v dhcppkt		DHCP packet
+ * @v peer		Destination address
+ */
+static int dhcp_reboot_tx ( struct dhcp_session *dhcp,
+			    struct dhcp_packet *dhcppkt,
+			    struct sockaddr_in *peer ) {
+	int rc;
+
+	DBGC ( dhcp, "DHCP %p INIT-REBOOT DHCPREQUEST for %s\n",
+	       dhcp, inet_ntoa ( dhcp->offer ) );
+
+	/* Set requested IP address.  The server identifier must not
+	 * be set in an INIT-REBOOT request.
+	 */
+	if ( ( rc = dhcppkt_store ( dhcppkt, DHCP_REQUESTED_ADDRESS,
+				    &dhcp->offer,
+				    sizeof ( dhcp->offer ) ) ) != 0 )
+		return rc;
+
+	/* Set server address */
+	peer->sin_addr.s_addr = INADDR_BROADCAST;
+	peer->sin_port = htons ( BOOTPS_PORT );
+
+	return 0;
+}
+
+/**
+ * Handle received packet during DHCP INIT-REBOOT
+ *
+ * @v dhcp		DHCP session
+ * @v dhcppkt		DHCP packet
+ * @v peer		DHCP server address
+ * @v msgtype		DHCP message type
+ * @v server_id		DHCP server ID
+ * @v pseudo_id		DHCP server pseudo-ID
+ */
+static void dhcp_reboot_rx ( struct dhcp_session *dhcp,
+			     struct dhcp_packet *dhcppkt,
+			     struct sockaddr_in *peer, uint8_t msgtype,
+			     struct in_addr server_id,
+			     struct in_addr pseudo_id ) {
+
+	/* Fall back to discovery if the cached address is refused */
+	if ( msgtype == DHCPNAK ) {
+		DBGC ( dhcp, "DHCP %p cached lease for %s refused\n",
+		       dhcp, inet_ntoa ( dhcp->offer ) );
+		dhcp_lease_del ( dhcp->netdev );
+		dhcp_set_state ( dhcp, &dhcp_state_discover );
+		return;
+	}
+
+	/* An INIT-REBOOT request carries no server identifier, so
+	 * the acknowledgement may come from any server; record it and
+	 * process the response as for a normal request.
+	 */
+	dhcp->server = server_id;
+	dhcp_request_rx ( dhcp, dhcppkt, peer, msgtype, server_id, pseudo_id );
+}
+
+/**
+ * Handle timer expiry during DHCP INIT-REBOOT
+ *
+ * @v dhcp		DHCP session
+ */
+static void dhcp_reboot_expired ( struct dhcp_session *dhcp ) {
+
+	/* Retransmit current packet */
+	dhcp_tx ( dhcp );
+}
+
+/** DHCP INIT-REBOOT state operations */
+static struct dhcp_session_state dhcp_state_reboot = {
+	.name			= "reboot",
+	.tx			= dhcp_reboot_tx,
+	.rx			= dhcp_reboot_rx,
+	.expired		= dhcp_reboot_expired,
+	.tx_msgtype		= DHCPREQUEST,
+	.min_timeout_sec	= DHCP_REBOOT_START_TIMEOUT_SEC,
+	.max_timeout_sec	= DHCP_REBOOT_END_TIMEOUT_SEC,
+};
+
 /**
  * Construct transmitted packet for ProxyDHCP request
  *
@@ -1185,13 +1452,46 @@ static int dhcp_deliver ( struct dhcp_session *dhcp,
 		goto err_no_src;
 	}
 	peer = ( struct sockaddr_in * ) meta->src;
+	data_len = iob_len ( iobuf );
+	if ( data_len < sizeof ( *dhcphdr ) ) {
+		DBGC ( dhcp, "DHCP %p received underlength packet from "
+		       "%s:%d\n", dhcp, inet_ntoa ( peer->sin_addr ),
+		       ntohs ( peer->sin_port ) );
+		rc = -EINVAL;
+		goto err_underlength;
+	}
+	dhcphdr = iobuf->data;
+
+	/* Check for matching transaction ID.  On a busy subnet most
+	 * received packets belong to other clients' transactions
+	 * (e.g. broadcast offers during a ProxyDHCP storm), so filter
+	 * them out before going to the expense of constructing and
+	 * parsing a DHCP packet.
+	 */
+	if ( dhcphdr->xid != dhcp->xid ) {
+		DBGC ( dhcp, "DHCP %p packet from %s:%d has bad transaction "
+		       "ID\n", dhcp, inet_ntoa ( peer->sin_addr ),
+		       ntohs ( peer->sin_port ) );
+		rc = -EINVAL;
+		goto err_xid;
+	};
+
+	/* Check for matching client hardware address */
+	if ( memcmp ( dhcphdr->chaddr, netdev->ll_addr,
+		      ll_protocol->ll_addr_len ) != 0 ) {
+		DBGC ( dhcp, "DHCP %p packet from %s:%d has bad chaddr %s\n",
+		       dhcp, inet_ntoa ( peer->sin_addr ),
+		       ntohs ( peer->sin_port ),
+		       ll_protocol->ntoa ( dhcphdr->chaddr ) );
+		rc = -EINVAL;
+		goto err_chaddr;
+	}
 
 	/* Create a DHCP packet containing the I/O buffer contents.
 	 * Whilst we could just use the original buffer in situ, that
 	 * would waste the unused space in the packet buffer, and also
 	 * waste a relatively scarce fully-aligned I/O buffer.
 	 */
-	data_len = iob_len ( iobuf );
 	dhcppkt = zalloc ( sizeof ( *dhcppkt ) + data_len );
 	if ( ! dhcppkt ) {
 		rc = -ENOMEM;
@@ -1216,34 +1516,14 @@ static int dhcp_deliver ( struct dhcp_session *dhcp,
 	if ( ! pseudo_id.s_addr )
 		pseudo_id = peer->sin_addr;
 
-	/* Check for matching transaction ID */
-	if ( dhcphdr->xid != dhcp->xid ) {
-		DBGC ( dhcp, "DHCP %p %s from %s:%d has bad transaction "
-		       "ID\n", dhcp, dhcp_msgtype_name ( msgtype ),
-		       inet_ntoa ( peer->sin_addr ),
-		       ntohs ( peer->sin_port ) );
-		rc = -EINVAL;
-		goto err_xid;
-	};
-
-	/* Check for matching client hardware address */
-	if ( memcmp ( dhcphdr->chaddr, netdev->ll_addr,
-		      ll_protocol->ll_addr_len ) != 0 ) {
-		DBGC ( dhcp, "DHCP %p %s from %s:%d has bad chaddr %s\n",
-		       dhcp, dhcp_msgtype_name ( msgtype ),
-		       inet_ntoa ( peer->sin_addr ), ntohs ( peer->sin_port ),
-		       ll_protocol->ntoa ( dhcphdr->chaddr ) );
-		rc = -EINVAL;
-		goto err_chaddr;
-	}
-
 	/* Handle packet based on current state */
 	dhcp->state->rx ( dhcp, dhcppkt, peer, msgtype, server_id, pseudo_id );
 
- err_chaddr:
- err_xid:
 	dhcppkt_put ( dhcppkt );
  err_alloc_dhcppkt:
+ err_chaddr:
+ err_xid:
+ err_underlength:
  err_no_src:
 	free_iob ( iobuf );
 	return rc;
@@ -1268,9 +1548,17 @@ static void dhcp_timer_expired ( struct retry_timer *timer, int fail ) {
 	struct dhcp_session *dhcp =
 		container_of ( timer, struct dhcp_session, timer );
 
-	/* If we have failed, terminate DHCP */
+	/* If we have failed, fall back to discovery (if we were
+	 * attempting to reuse a cached lease) or terminate DHCP.
+	 */
 	if ( fail ) {
-		dhcp_finished ( dhcp, -ETIMEDOUT );
+		if ( dhcp->state == &dhcp_state_reboot ) {
+			DBGC ( dhcp, "DHCP %p cached lease timed out\n", dhcp );
+			dhcp_lease_del ( dhcp->netdev );
+			dhcp_set_state ( dhcp, &dhcp_state_discover );
+		} else {
+			dhcp_finished ( dhcp, -ETIMEDOUT );
+		}
 		return;
 	}
 
@@ -1326,6 +1614,7 @@ static struct sockaddr dhcp_peer = {
  */
 int start_dhcp ( struct interface *job, struct net_device *netdev ) {
 	struct dhcp_session *dhcp;
+	struct dhcp_lease *lease;
 	int rc;
 
 	/* Allocate and initialise structure */
@@ -1340,6 +1629,7 @@ int start_dhcp ( struct interface *job, struct net_device *netdev ) {
 	dhcp->local.sin_family = AF_INET;
 	dhcp->local.sin_port = htons ( BOOTPC_PORT );
 	dhcp->xid = random();
+	list_add ( &dhcp->list, &dhcp_sessions );
 
 	/* Store DHCP transaction ID for fakedhcp code */
 	dhcp_last_xid = dhcp->xid;
@@ -1349,8 +1639,18 @@ int start_dhcp ( struct interface *job, struct net_device *netdev ) {
 				  ( struct sockaddr * ) &dhcp->local ) ) != 0 )
 		goto err;
 
-	/* Enter DHCPDISCOVER state */
-	dhcp_set_state ( dhcp, &dhcp_state_discover );
+	/* Attempt to reuse a cached lease via an INIT-REBOOT request,
+	 * falling back to the DHCPDISCOVER state.
+	 */
+	if ( ( lease = dhcp_lease_find ( netdev ) ) != NULL ) {
+		DBGC ( dhcp, "DHCP %p attempting reuse of cached lease for "
+		       "%s\n", dhcp, inet_ntoa ( lease->address ) );
+		dhcp->offer = lease->address;
+		dhcp->server = lease->server;
+		dhcp_set_state ( dhcp, &dhcp_state_reboot );
+	} else {
+		dhcp_set_state ( dhcp, &dhcp_state_discover );
+	}
 
 	/* Attach parent interface, mortalise self, and return */
 	intf_plug_plug ( &dhcp->job, job );
@@ -1450,6 +1750,7 @@ int start_pxebs ( struct interface *job, struct net_device *netdev,
 			     &dhcp->local.sin_addr );
 	dhcp->local.sin_port = htons ( BOOTPC_PORT );
 	dhcp->pxe_type = cpu_to_le16 ( pxe_type );
+	list_add ( &dhcp->list, &dhcp_sessions );
 
 	/* Construct PXE boot server IP address lists */
 	pxe_discovery_control =
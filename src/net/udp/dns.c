@@ -29,11 +29,13 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 #include <ctype.h>
 #include <errno.h>
 #include <byteswap.h>
 #include <ipxe/refcnt.h>
+#include <ipxe/objpool.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
@@ -41,6 +43,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/retry.h>
 #include <ipxe/tcpip.h>
 #include <ipxe/settings.h>
+#include <ipxe/timer.h>
 #include <ipxe/features.h>
 #include <ipxe/job.h>
 #include <ipxe/dhcp.h>
@@ -78,6 +81,9 @@ static union {
 /** The DNS search list */
 static struct dns_name dns_search;
 
+/** Pool of freed DNS requests awaiting reuse */
+static struct objpool dns_pool = OBJPOOL_INIT ( dns_pool, 8 );
+
 /**
  * Encode a DNS name using RFC1035 encoding
  *
@@ -436,6 +442,165 @@ static const char * dns_type ( uint16_t type ) {
 	}
 }
 
+/******************************************************************************
+ *
+ * DNS cache
+ *
+ ******************************************************************************
+ */
+
+/** Maximum number of DNS cache entries
+ *
+ * Each entry caches a single resolved address (at most one per
+ * address family per name), so that repeated lookups of the same name
+ * within a boot script do not pay a fresh resolution round trip.
+ */
+#ifndef DNS_CACHE_ENTRIES
+#define DNS_CACHE_ENTRIES 8
+#endif
+
+/** Maximum time for which a DNS cache entry may be used (in seconds)
+ *
+ * Cached answers expire according to their advertised time-to-live,
+ * capped at this value.
+ */
+#ifndef DNS_CACHE_MAX_TTL
+#define DNS_CACHE_MAX_TTL 3600
+#endif
+
+/** A DNS cache entry */
+struct dns_cache_entry {
+	/** List of cache entries */
+	struct list_head list;
+	/** Expiry time (in ticks) */
+	unsigned long expiry;
+	/** Resolved socket address */
+	struct sockaddr sa;
+	/** Name (unqualified, as passed to the resolver) */
+	char name[0];
+};
+
+/** The DNS cache */
+static LIST_HEAD ( dns_cache );
+
+/** Number of entries in the DNS cache */
+static unsigned int dns_cache_count;
+
+/**
+ * Remove entry from DNS cache
+ *
+ * @v entry		Cache entry
+ */
+static void dns_cache_del ( struct dns_cache_entry *entry ) {
+
+	list_del ( &entry->list );
+	free ( entry );
+	dns_cache_count--;
+}
+
+/**
+ * Look up name in DNS cache
+ *
+ * @v name		Name to resolve
+ * @v family		Address family
+ * @ret entry		Cache entry, or NULL if not found
+ *
+ * Expired entries encountered during the lookup are evicted.
+ */
+static struct dns_cache_entry * dns_cache_find ( const char *name,
+						 int family ) {
+	struct dns_cache_entry *entry;
+	struct dns_cache_entry *tmp;
+	unsigned long now = currticks();
+
+	list_for_each_entry_safe ( entry, tmp, &dns_cache, list ) {
+
+		/* Evict expired entries */
+		if ( ( ( signed long ) ( now - entry->expiry ) ) >= 0 ) {
+			DBG2 ( "DNS cache expired \"%s\"\n", entry->name );
+			dns_cache_del ( entry );
+			continue;
+		}
+
+		/* Check for a matching name and address family */
+		if ( ( strcasecmp ( entry->name, name ) == 0 ) &&
+		     ( entry->sa.sa_family == family ) )
+			return entry;
+	}
+
+	return NULL;
+}
+
+/**
+ * Add answer to DNS cache
+ *
+ * @v name		Name (unqualified, as passed to the resolver)
+ * @v sa		Resolved socket address
+ * @v ttl		Time-to-live (in seconds)
+ *
+ * Failures are ignored, since the cache is only an optimisation.
+ */
+static void dns_cache_add ( const char *name, struct sockaddr *sa,
+			    uint32_t ttl ) {
+	struct dns_cache_entry *entry;
+
+	/* Replace any existing entry for this name and family */
+	if ( ( entry = dns_cache_find ( name, sa->sa_family ) ) != NULL )
+		dns_cache_del ( entry );
+
+	/* Do not cache zero-lifetime answers, and cap the lifetime */
+	if ( ttl == 0 )
+		return;
+	if ( ttl > DNS_CACHE_MAX_TTL )
+		ttl = DNS_CACHE_MAX_TTL;
+
+	/* Evict the oldest entry if the cache is full */
+	if ( dns_cache_count >= DNS_CACHE_ENTRIES ) {
+		entry = list_last_entry ( &dns_cache, struct dns_cache_entry,
+					  list );
+		dns_cache_del ( entry );
+	}
+
+	/* Allocate and initialise entry */
+	entry = zalloc ( sizeof ( *entry ) + strlen ( name ) + 1 /* NUL */ );
+	if ( ! entry )
+		return;
+	memcpy ( &entry->sa, sa, sizeof ( entry->sa ) );
+	entry->expiry = ( currticks() + ( ttl * TICKS_PER_SEC ) );
+	strcpy ( entry->name, name );
+
+	/* Add to cache */
+	list_add ( &entry->list, &dns_cache );
+	dns_cache_count++;
+	DBG2 ( "DNS cached \"%s\" => %s (TTL %d)\n",
+	       name, sock_ntoa ( sa ), ttl );
+}
+
+/******************************************************************************
+ *
+ * DNS requests
+ *
+ ******************************************************************************
+ */
+
+/** An AAAA query is outstanding */
+#define DNS_PENDING_AAAA 0x01
+
+/** An A query is outstanding */
+#define DNS_PENDING_A 0x02
+
+/** Additional time to wait for the remaining address family's answer
+ * once the first answer has arrived (in ticks)
+ *
+ * Both address families' answers are returned where possible, so that
+ * the consumer may race connection attempts across families, but a
+ * lookup should not be delayed indefinitely by an unresponsive query
+ * for the other family (RFC 8305 "Resolution Delay").
+ */
+#ifndef DNS_RESOLUTION_DELAY
+#define DNS_RESOLUTION_DELAY ( TICKS_PER_SEC / 20 )
+#endif
+
 /** A DNS request */
 struct dns_request {
 	/** Reference counter */
@@ -455,6 +620,16 @@ struct dns_request {
 	} address;
 	/** Initial query type */
 	uint16_t qtype;
+	/** Outstanding concurrent initial query types */
+	unsigned int pending;
+	/** Resolved addresses, in order of preference (IPv6 first) */
+	struct sockaddr resolved[2];
+	/** Resolved address validity flags (as per @c pending) */
+	unsigned int have;
+	/** Answer was taken from the DNS cache */
+	int cached;
+	/** Original (unqualified) name being resolved */
+	char *hostname;
 	/** Buffer for current query */
 	struct {
 		/** Query header */
@@ -501,17 +676,56 @@ static void dns_done ( struct dns_request *dns, int rc ) {
  * @v rc		Return status code
  */
 static void dns_resolved ( struct dns_request *dns ) {
+	unsigned int i;
 
-	DBGC ( dns, "DNS %p found address %s\n",
-	       dns, sock_ntoa ( &dns->address.sa ) );
-
-	/* Return resolved address */
-	resolv_done ( &dns->resolv, &dns->address.sa );
+	/* Return all resolved addresses, most preferred first, so
+	 * that the consumer may race connection attempts across
+	 * address families.
+	 */
+	for ( i = 0 ; i < ( sizeof ( dns->resolved ) /
+			    sizeof ( dns->resolved[0] ) ) ; i++ ) {
+		if ( ! ( dns->have & ( 1 << i ) ) )
+			continue;
+		DBGC ( dns, "DNS %p found address %s\n",
+		       dns, sock_ntoa ( &dns->resolved[i] ) );
+		resolv_done ( &dns->resolv, &dns->resolved[i] );
+	}
 
 	/* Mark operation as complete */
 	dns_done ( dns, 0 );
 }
 
+/**
+ * Record a resolved address
+ *
+ * @v dns		DNS request
+ * @v flag		Corresponding outstanding query flag
+ *
+ * Completes the request if no other address query remains
+ * outstanding; otherwise allows the remaining address family's query
+ * a short grace period before completing with the answers already in
+ * hand.
+ */
+static void dns_record ( struct dns_request *dns, unsigned int flag ) {
+	unsigned int i = ( ( flag == DNS_PENDING_AAAA ) ? 0 : 1 );
+
+	/* Record resolved address in preference order */
+	memcpy ( &dns->resolved[i], &dns->address.sa,
+		 sizeof ( dns->resolved[i] ) );
+	dns->have |= flag;
+	dns->pending &= ~flag;
+
+	/* Complete immediately if no other query remains outstanding */
+	if ( ! dns->pending ) {
+		dns_resolved ( dns );
+		return;
+	}
+
+	/* Wait (briefly) for the remaining query to be answered */
+	stop_timer ( &dns->timer );
+	start_timer_fixed ( &dns->timer, DNS_RESOLUTION_DELAY );
+}
+
 /**
  * Construct DNS question
  *
@@ -552,6 +766,14 @@ static int dns_question ( struct dns_request *dns ) {
 	/* Store length */
 	dns->len = ( offset + sizeof ( *(dns->question) ) );
 
+	/* Issue initial A and AAAA queries concurrently where IPv6
+	 * is applicable; the first usable answer will complete the
+	 * resolution.
+	 */
+	dns->pending = ( ( dns->qtype == htons ( DNS_TYPE_AAAA ) ) ?
+			 ( DNS_PENDING_AAAA | DNS_PENDING_A ) :
+			 DNS_PENDING_A );
+
 	/* Restore name */
 	dns->name.offset = offsetof ( typeof ( dns->buf ), name );
 
@@ -562,13 +784,34 @@ static int dns_question ( struct dns_request *dns ) {
 }
 
 /**
- * Send DNS query
+ * Send a single DNS query
+ *
+ * @v dns		DNS request
+ * @v qtype		Question type
+ * @ret rc		Return status code
+ */
+static int dns_send_question ( struct dns_request *dns, uint16_t qtype ) {
+	struct dns_header *query = &dns->buf.query;
+
+	/* Set question type */
+	dns->question->qtype = qtype;
+
+	/* Send query */
+	DBGC ( dns, "DNS %p sending query ID %#04x for %s type %s\n", dns,
+	       ntohs ( query->id ), dns_name ( &dns->name ),
+	       dns_type ( qtype ) );
+	return xfer_deliver_raw ( &dns->socket, query, dns->len );
+}
+
+/**
+ * Send DNS query (or queries)
  *
  * @v dns		DNS request
  * @ret rc		Return status code
  */
 static int dns_send_packet ( struct dns_request *dns ) {
 	struct dns_header *query = &dns->buf.query;
+	int rc;
 
 	/* Start retransmission timer */
 	start_timer ( &dns->timer );
@@ -576,13 +819,28 @@ static int dns_send_packet ( struct dns_request *dns ) {
 	/* Generate query identifier */
 	query->id = random();
 
-	/* Send query */
-	DBGC ( dns, "DNS %p sending query ID %#04x for %s type %s\n", dns,
-	       ntohs ( query->id ), dns_name ( &dns->name ),
-	       dns_type ( dns->question->qtype ) );
+	/* Send any outstanding concurrent initial queries, reusing
+	 * the single query buffer; responses are matched by the
+	 * echoed question type.
+	 */
+	if ( dns->pending ) {
+		if ( ( dns->pending & DNS_PENDING_AAAA ) &&
+		     ( ( rc = dns_send_question ( dns,
+						  htons ( DNS_TYPE_AAAA )
+						  ) ) != 0 ) ) {
+			return rc;
+		}
+		if ( ( dns->pending & DNS_PENDING_A ) &&
+		     ( ( rc = dns_send_question ( dns,
+						  htons ( DNS_TYPE_A )
+						  ) ) != 0 ) ) {
+			return rc;
+		}
+		return 0;
+	}
 
-	/* Send the data */
-	return xfer_deliver_raw ( &dns->socket, query, dns->len );
+	/* Send single query */
+	return dns_send_question ( dns, dns->question->qtype );
 }
 
 /**
@@ -595,7 +853,9 @@ static void dns_timer_expired ( struct retry_timer *timer, int fail ) {
 	struct dns_request *dns =
 		container_of ( timer, struct dns_request, timer );
 
-	if ( fail ) {
+	if ( dns->cached || dns->have ) {
+		dns_resolved ( dns );
+	} else if ( fail ) {
 		dns_done ( dns, -ETIMEDOUT );
 	} else {
 		dns_send_packet ( dns );
@@ -615,7 +875,9 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 			      struct xfer_metadata *meta __unused ) {
 	struct dns_header *response = iobuf->data;
 	struct dns_header *query = &dns->buf.query;
-	unsigned int qtype = dns->question->qtype;
+	struct dns_question *question;
+	unsigned int qtype;
+	unsigned int restarted = 0;
 	struct dns_name buf;
 	union dns_rr *rr;
 	int offset;
@@ -664,6 +926,19 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 		goto done;
 	}
 	answer_offset = ( offset + sizeof ( struct dns_question ) );
+	if ( answer_offset > buf.len ) {
+		DBGC ( dns, "DNS %p received response with underlength "
+		       "question\n", dns );
+		rc = -EINVAL;
+		goto done;
+	}
+
+	/* Identify the question type to which this response
+	 * corresponds, since multiple queries (sharing a single query
+	 * identifier) may be outstanding concurrently.
+	 */
+	question = ( ( ( void * ) buf.data ) + offset );
+	qtype = question->qtype;
 
 	/* Search through response for useful answers.  Do this
 	 * multiple times, to take advantage of useful nameservers
@@ -723,7 +998,9 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 			memcpy ( &dns->address.sin6.sin6_addr,
 				 &rr->aaaa.in6_addr,
 				 sizeof ( dns->address.sin6.sin6_addr ) );
-			dns_resolved ( dns );
+			dns_cache_add ( dns->hostname, &dns->address.sa,
+					ntohl ( rr->common.ttl ) );
+			dns_record ( dns, DNS_PENDING_AAAA );
 			rc = 0;
 			goto done;
 
@@ -738,7 +1015,9 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 			}
 			dns->address.sin.sin_family = AF_INET;
 			dns->address.sin.sin_addr = rr->a.in_addr;
-			dns_resolved ( dns );
+			dns_cache_add ( dns->hostname, &dns->address.sa,
+					ntohl ( rr->common.ttl ) );
+			dns_record ( dns, DNS_PENDING_A );
 			rc = 0;
 			goto done;
 
@@ -765,6 +1044,7 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 				dns_done ( dns, rc );
 				goto done;
 			}
+			restarted = 1;
 			next_offset = answer_offset;
 			break;
 
@@ -775,50 +1055,37 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 		}
 	}
 
-	/* Stop the retry timer.  After this point, each code path
-	 * must either restart the timer by calling dns_send_packet(),
-	 * or mark the DNS operation as complete by calling
-	 * dns_done()
+	/* If a CNAME was found (and the pointed-to name was not
+	 * itself resolved by this response), then restart the
+	 * (possibly concurrent) query for the new name.
 	 */
-	stop_timer ( &dns->timer );
+	if ( restarted ) {
+		stop_timer ( &dns->timer );
+		dns_send_packet ( dns );
+		rc = 0;
+		goto done;
+	}
 
-	/* Determine what to do next based on the type of query we
-	 * issued and the response we received
+	/* Determine what to do next based on the type of query to
+	 * which this response corresponds
 	 */
 	switch ( qtype ) {
 
 	case htons ( DNS_TYPE_AAAA ):
-		/* We asked for an AAAA record and got nothing; try
-		 * the A.
-		 */
-		DBGC ( dns, "DNS %p found no AAAA record; trying A\n", dns );
-		dns->question->qtype = htons ( DNS_TYPE_A );
-		dns_send_packet ( dns );
-		rc = 0;
-		goto done;
+		/* We asked for an AAAA record and got nothing */
+		DBGC ( dns, "DNS %p found no AAAA record\n", dns );
+		dns->pending &= ~DNS_PENDING_AAAA;
+		break;
 
 	case htons ( DNS_TYPE_A ):
-		/* We asked for an A record and got nothing;
-		 * try the CNAME.
-		 */
-		DBGC ( dns, "DNS %p found no A record; trying CNAME\n", dns );
-		dns->question->qtype = htons ( DNS_TYPE_CNAME );
-		dns_send_packet ( dns );
-		rc = 0;
-		goto done;
+		/* We asked for an A record and got nothing */
+		DBGC ( dns, "DNS %p found no A record\n", dns );
+		dns->pending &= ~DNS_PENDING_A;
+		break;
 
 	case htons ( DNS_TYPE_CNAME ):
-		/* We asked for a CNAME record.  If we got a response
-		 * (i.e. if the next AAAA/A query is already set up),
-		 * then issue it.
-		 */
-		if ( qtype == dns->qtype ) {
-			dns_send_packet ( dns );
-			rc = 0;
-			goto done;
-		}
-
-		/* If we have already reached the end of the search list,
+		/* We asked for a CNAME record and got nothing.  If we
+		 * have already reached the end of the search list,
 		 * then terminate lookup.
 		 */
 		if ( dns->search.offset == dns->search.len ) {
@@ -838,16 +1105,41 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 			dns_done ( dns, rc );
 			goto done;
 		}
+		stop_timer ( &dns->timer );
 		dns_send_packet ( dns );
+		rc = 0;
 		goto done;
 
 	default:
-		assert ( 0 );
+		DBGC ( dns, "DNS %p got unexpected question type %d\n",
+		       dns, ntohs ( qtype ) );
 		rc = -EINVAL;
-		dns_done ( dns, rc );
 		goto done;
 	}
 
+	/* Wait for any remaining concurrent query to be answered,
+	 * leaving the retry timer running.
+	 */
+	if ( dns->pending ) {
+		rc = 0;
+		goto done;
+	}
+
+	/* Complete now if any address has already been resolved */
+	if ( dns->have ) {
+		dns_resolved ( dns );
+		rc = 0;
+		goto done;
+	}
+
+	/* All address queries have failed; try the CNAME */
+	DBGC ( dns, "DNS %p trying CNAME\n", dns );
+	stop_timer ( &dns->timer );
+	dns->question->qtype = htons ( DNS_TYPE_CNAME );
+	dns_send_packet ( dns );
+	rc = 0;
+	goto done;
+
  done:
 	/* Free I/O buffer */
 	free_iob ( iobuf );
@@ -910,6 +1202,20 @@ static struct interface_operation dns_resolv_op[] = {
 static struct interface_descriptor dns_resolv_desc =
 	INTF_DESC ( struct dns_request, resolv, dns_resolv_op );
 
+/**
+ * Free DNS request
+ *
+ * @v refcnt		Reference count
+ */
+static void dns_free ( struct refcnt *refcnt ) {
+	struct dns_request *dns =
+		container_of ( refcnt, struct dns_request, refcnt );
+
+	objpool_free ( &dns_pool, dns,
+		       ( sizeof ( *dns ) + dns->search.len +
+			 strlen ( dns->hostname ) + 1 /* NUL */ ) );
+}
+
 /**
  * Resolve name using DNS
  *
@@ -920,9 +1226,13 @@ static struct interface_descriptor dns_resolv_desc =
  */
 static int dns_resolv ( struct interface *resolv,
 			const char *name, struct sockaddr *sa ) {
+	static const int families[] = { AF_INET6, AF_INET };
 	struct dns_request *dns;
+	struct dns_cache_entry *entry;
 	struct dns_header *query;
+	struct sockaddr_tcpip *st;
 	size_t search_len;
+	unsigned int i;
 	int name_len;
 	int rc;
 
@@ -938,12 +1248,13 @@ static int dns_resolv ( struct interface *resolv,
 	search_len = ( strchr ( name, '.' ) ? 0 : dns_search.len );
 
 	/* Allocate DNS structure */
-	dns = zalloc ( sizeof ( *dns ) + search_len );
+	dns = objpool_alloc ( &dns_pool, ( sizeof ( *dns ) + search_len +
+					   strlen ( name ) + 1 /* NUL */ ) );
 	if ( ! dns ) {
 		rc = -ENOMEM;
 		goto err_alloc_dns;
 	}
-	ref_init ( &dns->refcnt, NULL );
+	ref_init ( &dns->refcnt, dns_free );
 	intf_init ( &dns->resolv, &dns_resolv_desc, &dns->refcnt );
 	intf_init ( &dns->socket, &dns_socket_desc, &dns->refcnt );
 	timer_init ( &dns->timer, dns_timer_expired, &dns->refcnt );
@@ -951,6 +1262,32 @@ static int dns_resolv ( struct interface *resolv,
 	dns->search.data = ( ( ( void * ) dns ) + sizeof ( *dns ) );
 	dns->search.len = search_len;
 	memcpy ( dns->search.data, dns_search.data, search_len );
+	dns->hostname = ( ( ( void * ) dns ) + sizeof ( *dns ) + search_len );
+	strcpy ( dns->hostname, name );
+
+	/* Use any unexpired cached answers, avoiding the network
+	 * round trip entirely.  The port is taken from the address
+	 * template, since cached answers may have been resolved for a
+	 * different service.  Completion is deferred to the timer in
+	 * order to avoid returning via a not-yet-attached interface.
+	 */
+	for ( i = 0 ; i < ( sizeof ( families ) /
+			    sizeof ( families[0] ) ) ; i++ ) {
+		if ( ( entry = dns_cache_find ( name, families[i] ) ) == NULL )
+			continue;
+		DBG ( "DNS resolving \"%s\" => %s (cached)\n",
+		      name, sock_ntoa ( &entry->sa ) );
+		memcpy ( &dns->resolved[i], &entry->sa,
+			 sizeof ( dns->resolved[i] ) );
+		st = ( ( struct sockaddr_tcpip * ) &dns->resolved[i] );
+		st->st_port = ( ( struct sockaddr_tcpip * ) sa )->st_port;
+		dns->have |= ( 1 << i );
+	}
+	if ( dns->have ) {
+		dns->cached = 1;
+		start_timer_nodelay ( &dns->timer );
+		goto attach;
+	}
 
 	/* Determine initial query type */
 	switch ( nameserver.sa.sa_family ) {
@@ -993,6 +1330,8 @@ static int dns_resolv ( struct interface *resolv,
 	/* Start timer to trigger first packet */
 	start_timer_nodelay ( &dns->timer );
 
+ attach:
+
 	/* Attach parent interface, mortalise self, and return */
 	intf_plug_plug ( &dns->resolv, resolv );
 	ref_put ( &dns->refcnt );
@@ -39,6 +39,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/tcpip.h>
 #include <ipxe/timer.h>
 #include <ipxe/retry.h>
+#include <ipxe/profile.h>
 
 /** @file
  *
@@ -106,18 +107,47 @@ FEATURE ( FEATURE_PROTOCOL, "SLAM", DHCP_EB_FEATURE_SLAM, 1 );
  * This is a policy decision equivalent to selecting a TCP window
  * size.
  */
+#ifndef SLAM_MAX_BLOCKS_PER_NACK
 #define SLAM_MAX_BLOCKS_PER_NACK 4
+#endif
 
 /** Maximum SLAM NACK length
  *
- * We only ever send a NACK for a single range of up to @c
- * SLAM_MAX_BLOCKS_PER_NACK blocks.
+ * A NACK may describe multiple missing ranges, but can never request
+ * more than @c SLAM_MAX_BLOCKS_PER_NACK blocks in total, and so can
+ * never contain more than this many run-length values.
  */
-#define SLAM_MAX_NACK_LEN ( 7 /* block */ + 7 /* #blocks */ + 1 /* NUL */ )
+#define SLAM_MAX_NACK_LEN					\
+	( 7 /* leading #received */ +				\
+	  ( SLAM_MAX_BLOCKS_PER_NACK *				\
+	    ( 7 /* #missing */ + 7 /* #received */ ) ) +	\
+	  1 /* NUL */ )
+
+/** SLAM NACK aggregation holdoff window
+ *
+ * A NACK triggered by a unicast status packet is delayed by a random
+ * holdoff within this window.  When several hundred receivers share
+ * a single multicast stream, this staggers the replies and allows
+ * receipt of a data packet (provoked by the first NACK to reach the
+ * server) to cancel the remainder, avoiding a NACK implosion at the
+ * server.
+ */
+#ifndef SLAM_NACK_HOLDOFF
+#define SLAM_NACK_HOLDOFF ( TICKS_PER_SEC / 4 )
+#endif
 
-/** SLAM slave timeout */
+/** SLAM slave timeout
+ *
+ * The restarted slave timer is additionally jittered by a random
+ * fraction of the NACK aggregation holdoff window, so that receivers
+ * which all saw the stream stall at the same instant do not all
+ * attempt to become master client simultaneously.
+ */
 #define SLAM_SLAVE_TIMEOUT ( 1 * TICKS_PER_SEC )
 
+/** Data packet profiler */
+static struct profiler slam_rx_profiler __profiler = { .name = "slam.rx" };
+
 /** A SLAM request */
 struct slam_request {
 	/** Reference counter */
@@ -149,6 +179,11 @@ struct slam_request {
 	struct bitmap bitmap;
 	/** NACK sent flag */
 	int nack_sent;
+
+	/** Time at which first data packet was received */
+	unsigned long started;
+	/** Number of payload bytes received */
+	unsigned long received;
 };
 
 /**
@@ -172,10 +207,20 @@ static void slam_free ( struct refcnt *refcnt ) {
  */
 static void slam_finished ( struct slam_request *slam, int rc ) {
 	static const uint8_t slam_disconnect[] = { 0 };
+	unsigned long elapsed;
 
 	DBGC ( slam, "SLAM %p finished with status code %d (%s)\n",
 	       slam, rc, strerror ( rc ) );
 
+	/* Report overall receive rate */
+	elapsed = ( currticks() - slam->started );
+	if ( slam->started && elapsed ) {
+		DBGC ( slam, "SLAM %p received %ld bytes in %ld ticks "
+		       "(%ld kB/s)\n", slam, slam->received, elapsed,
+		       ( ( ( slam->received / 1024 ) * TICKS_PER_SEC ) /
+			 elapsed ) );
+	}
+
 	/* Send a disconnect message if we ever sent anything to the
 	 * server.
 	 */
@@ -254,7 +299,10 @@ static int slam_put_value ( struct slam_request *slam,
 static int slam_tx_nack ( struct slam_request *slam ) {
 	struct io_buffer *iobuf;
 	unsigned long first_block;
-	unsigned long num_blocks;
+	unsigned long block;
+	unsigned long run;
+	unsigned long budget;
+	unsigned long requested;
 	uint8_t *nul;
 	int rc;
 
@@ -270,34 +318,59 @@ static int slam_tx_nack ( struct slam_request *slam ) {
 		goto err_alloc;
 	}
 
-	/* Construct NACK.  We always request only a single packet;
-	 * this allows us to force multicast-TFTP-style flow control
-	 * on the SLAM server, which will otherwise just blast the
-	 * data out as fast as it can.  On a gigabit network, without
-	 * RX checksumming, this would inevitably cause packet drops.
+	/* Construct NACK as a run-length-encoded representation of
+	 * the received-blocks bitmap, starting with the number of
+	 * blocks received before the first gap.  We request at most
+	 * SLAM_MAX_BLOCKS_PER_NACK blocks in total; this allows us to
+	 * force multicast-TFTP-style flow control on the SLAM server,
+	 * which will otherwise just blast the data out as fast as it
+	 * can.  On a gigabit network, without RX checksumming, this
+	 * would inevitably cause packet drops.  Within that budget we
+	 * describe as many missing ranges as exist, which avoids one
+	 * NACK round trip per range when losses are scattered.
 	 */
 	first_block = bitmap_first_gap ( &slam->bitmap );
-	for ( num_blocks = 1 ; ; num_blocks++ ) {
-		if ( num_blocks >= SLAM_MAX_BLOCKS_PER_NACK )
-			break;
-		if ( ( first_block + num_blocks ) >= slam->num_blocks )
+	if ( ( rc = slam_put_value ( slam, iobuf, first_block ) ) != 0 )
+		goto err_put_value;
+	block = first_block;
+	budget = SLAM_MAX_BLOCKS_PER_NACK;
+	requested = 0;
+	while ( budget && ( block < slam->num_blocks ) ) {
+
+		/* Add run of missing blocks */
+		run = 0;
+		while ( ( run < budget ) &&
+			( ( block + run ) < slam->num_blocks ) &&
+			( ! bitmap_test ( &slam->bitmap, ( block + run ) ) ) )
+			run++;
+		if ( ( rc = slam_put_value ( slam, iobuf, run ) ) != 0 )
+			goto err_put_value;
+		block += run;
+		budget -= run;
+		requested += run;
+		if ( ( ! budget ) || ( block >= slam->num_blocks ) )
 			break;
-		if ( bitmap_test ( &slam->bitmap,
-				   ( first_block + num_blocks ) ) )
+
+		/* Add run of received blocks, unless it extends to the
+		 * end of the transfer.
+		 */
+		run = 0;
+		while ( ( ( block + run ) < slam->num_blocks ) &&
+			bitmap_test ( &slam->bitmap, ( block + run ) ) )
+			run++;
+		if ( ( block + run ) >= slam->num_blocks )
 			break;
+		if ( ( rc = slam_put_value ( slam, iobuf, run ) ) != 0 )
+			goto err_put_value;
+		block += run;
 	}
 	if ( first_block ) {
-		DBGCP ( slam, "SLAM %p transmitting NACK for blocks "
-			"%ld-%ld\n", slam, first_block,
-			( first_block + num_blocks - 1 ) );
+		DBGCP ( slam, "SLAM %p transmitting NACK for %ld blocks "
+			"from %ld\n", slam, requested, first_block );
 	} else {
-		DBGC ( slam, "SLAM %p transmitting initial NACK for blocks "
-		       "0-%ld\n", slam, ( num_blocks - 1 ) );
+		DBGC ( slam, "SLAM %p transmitting initial NACK for %ld "
+		       "blocks\n", slam, requested );
 	}
-	if ( ( rc = slam_put_value ( slam, iobuf, first_block ) ) != 0 )
-		goto err_put_value;
-	if ( ( rc = slam_put_value ( slam, iobuf, num_blocks ) ) != 0 )
-		goto err_put_value;
 	nul = iob_put ( iobuf, 1 );
 	*nul = 0;
 
@@ -503,10 +576,15 @@ static int slam_mc_socket_deliver ( struct slam_request *slam,
 	size_t len;
 	int rc;
 
-	/* Stop the master client timer.  Restart the slave client timer. */
+	/* Stop the master client timer.  Restart the slave client
+	 * timer, with jitter.
+	 */
+	profile_start ( &slam_rx_profiler );
 	stop_timer ( &slam->master_timer );
 	stop_timer ( &slam->slave_timer );
-	start_timer_fixed ( &slam->slave_timer, SLAM_SLAVE_TIMEOUT );
+	start_timer_fixed ( &slam->slave_timer,
+			    ( SLAM_SLAVE_TIMEOUT +
+			      ( random() % SLAM_NACK_HOLDOFF ) ) );
 
 	/* Read and strip packet header */
 	if ( ( rc = slam_pull_header ( slam, iobuf ) ) != 0 )
@@ -555,6 +633,12 @@ static int slam_mc_socket_deliver ( struct slam_request *slam,
 	/* Mark block as received */
 	bitmap_set ( &slam->bitmap, packet );
 
+	/* Update receive statistics */
+	if ( ! slam->started )
+		slam->started = currticks();
+	slam->received += len;
+	profile_stop ( &slam_rx_profiler );
+
 	/* If we have received all blocks, terminate */
 	if ( bitmap_full ( &slam->bitmap ) )
 		slam_finished ( slam, 0 );
@@ -580,10 +664,6 @@ static int slam_socket_deliver ( struct slam_request *slam,
 				 struct xfer_metadata *rx_meta __unused ) {
 	int rc;
 
-	/* Restart the master client timer */
-	stop_timer ( &slam->master_timer );
-	start_timer ( &slam->master_timer );
-
 	/* Read and strip packet header */
 	if ( ( rc = slam_pull_header ( slam, iobuf ) ) != 0 )
 		goto discard;
@@ -599,8 +679,14 @@ static int slam_socket_deliver ( struct slam_request *slam,
 	/* Discard packet */
 	free_iob ( iobuf );
 
-	/* Send NACK in reply */
-	slam_tx_nack ( slam );
+	/* Schedule a NACK in reply, after a random holdoff within the
+	 * aggregation window.  If another client's NACK restarts the
+	 * data stream in the meantime, then receipt of a data packet
+	 * will stop the master client timer and so cancel ours.
+	 */
+	stop_timer ( &slam->master_timer );
+	start_timer_fixed ( &slam->master_timer,
+			    ( random() % SLAM_NACK_HOLDOFF ) );
 
 	return 0;
 
@@ -75,6 +75,9 @@ FEATURE ( FEATURE_PROTOCOL, "TFTP", DHCP_EB_FEATURE_TFTP, 1 );
 #define EINVAL_MC_INVALID_PORT __einfo_error ( EINFO_EINVAL_MC_INVALID_PORT )
 #define EINFO_EINVAL_MC_INVALID_PORT __einfo_uniqify \
 	( EINFO_EINVAL, 0x07, "Invalid multicast port" )
+#define EINVAL_WINDOWSIZE __einfo_error ( EINFO_EINVAL_WINDOWSIZE )
+#define EINFO_EINVAL_WINDOWSIZE __einfo_uniqify \
+	( EINFO_EINVAL, 0x08, "Invalid windowsize" )
 
 /**
  * A TFTP request
@@ -101,6 +104,14 @@ struct tftp_request {
 	 * this will default to 512).
 	 */
 	unsigned int blksize;
+	/** Window size
+	 *
+	 * This is the "windowsize" option (as per RFC 7440)
+	 * negotiated with the TFTP server.  If the TFTP server does
+	 * not support the option, this will default to 1, i.e. every
+	 * data block is acknowledged individually.
+	 */
+	unsigned int windowsize;
 	/** File size
 	 *
 	 * This is the value returned in the "tsize" option from the
@@ -158,6 +169,19 @@ enum {
 /** Maximum number of MTFTP open requests before falling back to TFTP */
 #define MTFTP_MAX_TIMEOUTS 3
 
+/** Requested window size (in data blocks)
+ *
+ * Requesting a window larger than one data block (as per RFC 7440)
+ * avoids serialising the transfer on a full round trip per block.
+ * Lost or out-of-order blocks within a window are handled by the
+ * block bitmap: each ACK reports the first missing block, and the
+ * retransmission timer recovers a window whose final blocks are
+ * lost.
+ */
+#ifndef TFTP_REQUEST_WINDOWSIZE
+#define TFTP_REQUEST_WINDOWSIZE 16
+#endif
+
 /**
  * Free TFTP request
  *
@@ -339,7 +363,8 @@ static int tftp_send_rrq ( struct tftp_request *tftp ) {
 	len = ( sizeof ( *rrq ) + strlen ( path ) + 1 /* NUL */
 		+ 5 + 1 /* "octet" + NUL */
 		+ 7 + 1 + 5 + 1 /* "blksize" + NUL + ddddd + NUL */
-		+ 5 + 1 + 1 + 1 /* "tsize" + NUL + "0" + NUL */ 
+		+ 5 + 1 + 1 + 1 /* "tsize" + NUL + "0" + NUL */
+		+ 10 + 1 + 5 + 1 /* "windowsize" + NUL + ddddd + NUL */
 		+ 9 + 1 + 1 /* "multicast" + NUL + NUL */ );
 	iobuf = xfer_alloc_iob ( &tftp->socket, len );
 	if ( ! iobuf )
@@ -358,8 +383,10 @@ static int tftp_send_rrq ( struct tftp_request *tftp ) {
 	if ( tftp->flags & TFTP_FL_RRQ_SIZES ) {
 		iob_put ( iobuf, snprintf ( iobuf->tail,
 					    iob_tailroom ( iobuf ),
-					    "blksize%c%zd%ctsize%c0",
-					    0, blksize, 0, 0 ) + 1 );
+					    "blksize%c%zd%ctsize%c0%c"
+					    "windowsize%c%d", 0, blksize,
+					    0, 0, 0, 0,
+					    TFTP_REQUEST_WINDOWSIZE ) + 1 );
 	}
 	if ( tftp->flags & TFTP_FL_RRQ_MULTICAST ) {
 		iob_put ( iobuf, snprintf ( iobuf->tail,
@@ -580,6 +607,27 @@ static int tftp_process_tsize ( struct tftp_request *tftp, char *value ) {
 	return 0;
 }
 
+/**
+ * Process TFTP "windowsize" option
+ *
+ * @v tftp		TFTP connection
+ * @v value		Option value
+ * @ret rc		Return status code
+ */
+static int tftp_process_windowsize ( struct tftp_request *tftp, char *value ) {
+	char *end;
+
+	tftp->windowsize = strtoul ( value, &end, 10 );
+	if ( *end || ( tftp->windowsize == 0 ) ) {
+		DBGC ( tftp, "TFTP %p got invalid windowsize \"%s\"\n",
+		       tftp, value );
+		return -EINVAL_WINDOWSIZE;
+	}
+	DBGC ( tftp, "TFTP %p windowsize=%d\n", tftp, tftp->windowsize );
+
+	return 0;
+}
+
 /**
  * Process TFTP "multicast" option
  *
@@ -664,6 +712,7 @@ struct tftp_option {
 static struct tftp_option tftp_options[] = {
 	{ "blksize", tftp_process_blksize },
 	{ "tsize", tftp_process_tsize },
+	{ "windowsize", tftp_process_windowsize },
 	{ "multicast", tftp_process_multicast },
 	{ NULL, NULL }
 };
@@ -831,8 +880,18 @@ static int tftp_rx_data ( struct tftp_request *tftp,
 	/* Mark block as received */
 	bitmap_set ( &tftp->bitmap, block );
 
-	/* Acknowledge block */
-	tftp_send_packet ( tftp );
+	/* Acknowledge block if it is the last block in the current
+	 * window, the final (short) block, or the block completing
+	 * the transfer.  The ACK carries the first missing block, so
+	 * a window containing lost or reordered blocks is rewound
+	 * automatically; a window whose trailing blocks are lost is
+	 * recovered by the retransmission timer.
+	 */
+	if ( ( ( ( block + 1 ) % tftp->windowsize ) == 0 ) ||
+	     ( data_len < tftp->blksize ) ||
+	     bitmap_full ( &tftp->bitmap ) ) {
+		tftp_send_packet ( tftp );
+	}
 
 	/* If all blocks have been received, finish. */
 	if ( bitmap_full ( &tftp->bitmap ) )
@@ -1078,6 +1137,7 @@ static int tftp_core_open ( struct interface *xfer, struct uri *uri,
 	timer_init ( &tftp->timer, tftp_timer_expired, &tftp->refcnt );
 	tftp->uri = uri_get ( uri );
 	tftp->blksize = TFTP_DEFAULT_BLKSIZE;
+	tftp->windowsize = 1;
 	tftp->flags = flags;
 
 	/* Open socket */
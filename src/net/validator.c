@@ -75,6 +75,10 @@ struct validator {
 
 	/** X.509 certificate chain */
 	struct x509_chain *chain;
+	/** Stapled OCSP response (if any) */
+	void *staple;
+	/** Length of stapled OCSP response */
+	size_t staple_len;
 	/** OCSP check */
 	struct ocsp_check *ocsp;
 	/** Data buffer */
@@ -115,6 +119,7 @@ static void validator_free ( struct refcnt *refcnt ) {
 	DBGC2 ( validator, "VALIDATOR %p \"%s\" freed\n",
 		validator, validator_name ( validator ) );
 	x509_chain_put ( validator->chain );
+	free ( validator->staple );
 	ocsp_put ( validator->ocsp );
 	xferbuf_free ( &validator->buffer );
 	free ( validator );
@@ -397,6 +402,65 @@ static int validator_ocsp_validate ( struct validator *validator,
 	return 0;
 }
 
+/**
+ * Use stapled OCSP response
+ *
+ * @v validator		Certificate validator
+ * @v cert		Certificate to check
+ * @v issuer		Issuing certificate
+ * @ret rc		Return status code
+ *
+ * The stapled response is consumed by this attempt: if it does not
+ * validate the certificate, then the validator will fall back to
+ * fetching a response from the OCSP responder directly.
+ */
+static int validator_staple_ocsp ( struct validator *validator,
+				   struct x509_certificate *cert,
+				   struct x509_certificate *issuer ) {
+	struct ocsp_check *ocsp;
+	time_t now;
+	int rc;
+
+	/* Create OCSP check */
+	if ( ( rc = ocsp_check ( cert, issuer, &ocsp ) ) != 0 ) {
+		DBGC ( validator, "VALIDATOR %p \"%s\" could not create OCSP "
+		       "check: %s\n", validator, validator_name ( validator ),
+		       strerror ( rc ) );
+		goto err_check;
+	}
+
+	/* Record stapled OCSP response */
+	if ( ( rc = ocsp_response ( ocsp, validator->staple,
+				    validator->staple_len ) ) != 0 ) {
+		DBGC ( validator, "VALIDATOR %p \"%s\" could not record "
+		       "stapled OCSP response: %s\n", validator,
+		       validator_name ( validator ), strerror ( rc ) );
+		goto err_response;
+	}
+
+	/* Validate stapled OCSP response */
+	now = time ( NULL );
+	if ( ( rc = ocsp_validate ( ocsp, now ) ) != 0 ) {
+		DBGC ( validator, "VALIDATOR %p \"%s\" could not validate "
+		       "stapled OCSP response: %s\n", validator,
+		       validator_name ( validator ), strerror ( rc ) );
+		goto err_validate;
+	}
+	DBGC ( validator, "VALIDATOR %p \"%s\" used stapled OCSP response ",
+	       validator, validator_name ( validator ) );
+	DBGC ( validator, "for \"%s\"\n", x509_name ( cert ) );
+
+ err_validate:
+ err_response:
+	ocsp_put ( ocsp );
+ err_check:
+	/* Consume stapled response */
+	free ( validator->staple );
+	validator->staple = NULL;
+	validator->staple_len = 0;
+	return rc;
+}
+
 /** OCSP validator action */
 static const struct validator_action validator_ocsp = {
 	.name = "OCSP",
@@ -575,6 +639,14 @@ static void validator_step ( struct validator *validator ) {
 		 * yet valid.  If OCSP is applicable, start it.
 		 */
 		if ( ocsp_required ( cert ) ) {
+			/* Try stapled OCSP response, if present */
+			if ( validator->staple &&
+			     ( validator_staple_ocsp ( validator, cert,
+						       issuer ) == 0 ) ) {
+				/* Resume validation */
+				process_add ( &validator->process );
+				return;
+			}
 			/* Start OCSP */
 			if ( ( rc = validator_start_ocsp ( validator, cert,
 							   issuer ) ) != 0 ) {
@@ -621,9 +693,12 @@ static struct process_descriptor validator_process_desc =
  *
  * @v job		Job control interface
  * @v chain		X.509 certificate chain
+ * @v staple		Stapled OCSP response (if any)
+ * @v staple_len	Length of stapled OCSP response
  * @ret rc		Return status code
  */
-int create_validator ( struct interface *job, struct x509_chain *chain ) {
+int create_validator ( struct interface *job, struct x509_chain *chain,
+		       const void *staple, size_t staple_len ) {
 	struct validator *validator;
 	int rc;
 
@@ -649,6 +724,17 @@ int create_validator ( struct interface *job, struct x509_chain *chain ) {
 	validator->chain = x509_chain_get ( chain );
 	xferbuf_malloc_init ( &validator->buffer );
 
+	/* Record stapled OCSP response, if any */
+	if ( staple_len ) {
+		validator->staple = malloc ( staple_len );
+		if ( ! validator->staple ) {
+			rc = -ENOMEM;
+			goto err_staple;
+		}
+		memcpy ( validator->staple, staple, staple_len );
+		validator->staple_len = staple_len;
+	}
+
 	/* Attach parent interface, mortalise self, and return */
 	intf_plug_plug ( &validator->job, job );
 	ref_put ( &validator->refcnt );
@@ -656,6 +742,7 @@ int create_validator ( struct interface *job, struct x509_chain *chain ) {
 		validator, validator_name ( validator ), validator->chain );
 	return 0;
 
+ err_staple:
 	validator_finished ( validator, rc );
 	ref_put ( &validator->refcnt );
  err_alloc:
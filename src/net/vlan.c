@@ -24,9 +24,11 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
+#include <assert.h>
 #include <byteswap.h>
 #include <ipxe/features.h>
 #include <ipxe/if_ether.h>
@@ -55,6 +57,46 @@ struct vlan_device {
 	unsigned int priority;
 };
 
+/** Number of possible VLAN tags */
+#define VLAN_N_TAGS 4096
+
+/** A VLAN trunk demultiplexer
+ *
+ * Each trunk device carrying at least one VLAN has a tag-indexed
+ * table of VLAN devices, so that received tagged frames can be
+ * demultiplexed in constant time regardless of the number of VLANs on
+ * the trunk.
+ */
+struct vlan_trunk {
+	/** List of VLAN trunk demultiplexers */
+	struct list_head list;
+	/** Trunk network device */
+	struct net_device *trunk;
+	/** Number of VLAN devices on this trunk */
+	unsigned int count;
+	/** VLAN devices, indexed by tag */
+	struct net_device *netdevs[VLAN_N_TAGS];
+};
+
+/** List of VLAN trunk demultiplexers */
+static LIST_HEAD ( vlan_trunks );
+
+/**
+ * Find VLAN trunk demultiplexer
+ *
+ * @v trunk		Trunk network device
+ * @ret vtrunk		VLAN trunk demultiplexer, or NULL if not found
+ */
+static struct vlan_trunk * vlan_trunk_find ( struct net_device *trunk ) {
+	struct vlan_trunk *vtrunk;
+
+	list_for_each_entry ( vtrunk, &vlan_trunks, list ) {
+		if ( vtrunk->trunk == trunk )
+			return vtrunk;
+	}
+	return NULL;
+}
+
 /**
  * Open VLAN device
  *
@@ -201,17 +243,62 @@ static void vlan_sync ( struct net_device *netdev ) {
  */
 static struct net_device * vlan_find ( struct net_device *trunk,
 				       unsigned int tag ) {
-	struct net_device *netdev;
-	struct vlan_device *vlan;
+	struct vlan_trunk *vtrunk;
 
-	for_each_netdev ( netdev ) {
-		if ( netdev->op != &vlan_operations )
-			continue;
-		vlan = netdev->priv;
-		if ( ( vlan->trunk == trunk ) && ( vlan->tag == tag ) )
-			return netdev;
+	/* Look up tag in trunk's demultiplexer table, if any */
+	vtrunk = vlan_trunk_find ( trunk );
+	if ( ( ! vtrunk ) || ( tag >= VLAN_N_TAGS ) )
+		return NULL;
+	return vtrunk->netdevs[tag];
+}
+
+/**
+ * Add VLAN device to trunk demultiplexer
+ *
+ * @v netdev		VLAN network device
+ * @ret rc		Return status code
+ */
+static int vlan_trunk_add ( struct net_device *netdev ) {
+	struct vlan_device *vlan = netdev->priv;
+	struct vlan_trunk *vtrunk;
+
+	/* Create demultiplexer for this trunk, if necessary */
+	vtrunk = vlan_trunk_find ( vlan->trunk );
+	if ( ! vtrunk ) {
+		vtrunk = zalloc ( sizeof ( *vtrunk ) );
+		if ( ! vtrunk )
+			return -ENOMEM;
+		vtrunk->trunk = vlan->trunk;
+		list_add ( &vtrunk->list, &vlan_trunks );
+	}
+
+	/* Record VLAN device */
+	assert ( vtrunk->netdevs[vlan->tag] == NULL );
+	vtrunk->netdevs[vlan->tag] = netdev;
+	vtrunk->count++;
+	return 0;
+}
+
+/**
+ * Remove VLAN device from trunk demultiplexer
+ *
+ * @v netdev		VLAN network device
+ */
+static void vlan_trunk_del ( struct net_device *netdev ) {
+	struct vlan_device *vlan = netdev->priv;
+	struct vlan_trunk *vtrunk;
+
+	/* Remove VLAN device, if recorded */
+	vtrunk = vlan_trunk_find ( vlan->trunk );
+	if ( ( ! vtrunk ) || ( vtrunk->netdevs[vlan->tag] != netdev ) )
+		return;
+	vtrunk->netdevs[vlan->tag] = NULL;
+
+	/* Free demultiplexer when last VLAN device is removed */
+	if ( --vtrunk->count == 0 ) {
+		list_del ( &vtrunk->list );
+		free ( vtrunk );
 	}
-	return NULL;
 }
 
 /**
@@ -401,6 +488,13 @@ int vlan_create ( struct net_device *trunk, unsigned int tag,
 		goto err_register;
 	}
 
+	/* Add to trunk demultiplexer */
+	if ( ( rc = vlan_trunk_add ( netdev ) ) != 0 ) {
+		DBGC ( netdev, "VLAN %s could not add to trunk demultiplexer: "
+		       "%s\n", netdev->name, strerror ( rc ) );
+		goto err_trunk_add;
+	}
+
 	/* Synchronise with trunk device */
 	vlan_sync ( netdev );
 
@@ -409,6 +503,7 @@ int vlan_create ( struct net_device *trunk, unsigned int tag,
 
 	return 0;
 
+ err_trunk_add:
 	unregister_netdev ( netdev );
  err_register:
 	netdev_nullify ( netdev );
@@ -438,6 +533,9 @@ int vlan_destroy ( struct net_device *netdev ) {
 
 	DBGC ( netdev, "VLAN %s destroyed\n", netdev->name );
 
+	/* Remove from trunk demultiplexer */
+	vlan_trunk_del ( netdev );
+
 	/* Remove VLAN device */
 	unregister_netdev ( netdev );
 	trunk = vlan->trunk;
@@ -40,6 +40,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #undef NDEBUG
 
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 #include <ipxe/aes.h>
 #include <ipxe/test.h>
@@ -186,8 +187,25 @@ static void aes_test_exec ( void ) {
 	}
 }
 
+/**
+ * Perform AES benchmarks
+ *
+ */
+static void aes_bench_exec ( void ) {
+	struct cipher_algorithm *cbc = &aes_cbc_algorithm;
+	unsigned int keylen;
+
+	for ( keylen = 128 ; keylen <= 256 ; keylen += 64 ) {
+		printf ( "BENCH aes-%d-cbc: encrypt %ld, decrypt %ld "
+			 "cycles/byte\n", keylen,
+			 cipher_cost_encrypt ( cbc, ( keylen / 8 ) ),
+			 cipher_cost_decrypt ( cbc, ( keylen / 8 ) ) );
+	}
+}
+
 /** AES self-test */
 struct self_test aes_test __self_test = {
 	.name = "aes",
 	.exec = aes_test_exec,
+	.bench = aes_bench_exec,
 };
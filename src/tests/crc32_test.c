@@ -40,9 +40,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #undef NDEBUG
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <ipxe/crc32.h>
+#include <ipxe/profile.h>
 #include <ipxe/test.h>
 
+/** Number of sample iterations for speed test */
+#define PROFILE_COUNT 16
+
 /** Define inline data */
 #define DATA(...) { __VA_ARGS__ }
 
@@ -101,16 +107,81 @@ CRC32_TEST ( hw_split_part2_test,
 	     DATA ( ' ', 'w', 'o', 'r', 'l', 'd' ),
 	     0xc9ef5979UL, 0xf2b5ee7aUL );
 
+/* Tests long enough to exercise any wide processing of aligned data,
+ * split at a boundary chosen to leave both parts misaligned.
+ */
+CRC32_TEST ( count_test,
+	     DATA ( 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+		    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+		    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+		    0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+		    0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27,
+		    0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f,
+		    0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37,
+		    0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f ),
+	     0xffffffffUL, 0xeff13173UL );
+CRC32_TEST ( count_split_part1_test,
+	     DATA ( 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+		    0x08, 0x09, 0x0a, 0x0b, 0x0c ),
+	     0xffffffffUL, 0x1901b947UL );
+CRC32_TEST ( count_split_part2_test,
+	     DATA ( 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14,
+		    0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c,
+		    0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24,
+		    0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c,
+		    0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0x34,
+		    0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c,
+		    0x3d, 0x3e, 0x3f ),
+	     0x1901b947UL, 0xeff13173UL );
+
+/**
+ * Calculate CRC32 cost
+ *
+ * @ret cost		Cost (in cycles per byte)
+ */
+static unsigned long crc32_cost ( void ) {
+	static uint8_t random[8192]; /* Too large for stack */
+	struct profiler profiler;
+	unsigned long cost;
+	unsigned int i;
+
+	/* Fill buffer with pseudo-random data */
+	srand ( 0x1234568 );
+	for ( i = 0 ; i < sizeof ( random ) ; i++ )
+		random[i] = rand();
+
+	/* Profile checksum calculation */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		crc32_le ( 0xffffffffUL, random, sizeof ( random ) );
+		profile_stop ( &profiler );
+	}
+
+	/* Round to nearest whole number of cycles per byte */
+	cost = ( ( profile_mean ( &profiler ) + ( sizeof ( random ) / 2 ) ) /
+		 sizeof ( random ) );
+
+	return cost;
+}
+
 /**
  * Perform CRC32 self-tests
  *
  */
 static void crc32_test_exec ( void ) {
 
+	/* Correctness tests */
 	crc32_ok ( &empty_test );
 	crc32_ok ( &hw_test );
 	crc32_ok ( &hw_split_part1_test );
 	crc32_ok ( &hw_split_part2_test );
+	crc32_ok ( &count_test );
+	crc32_ok ( &count_split_part1_test );
+	crc32_ok ( &count_split_part2_test );
+
+	/* Speed tests */
+	DBG ( "CRC32 required %ld cycles per byte\n", crc32_cost() );
 }
 
 /** CRC32 self-test */
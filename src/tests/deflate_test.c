@@ -36,8 +36,12 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdlib.h>
 #include <string.h>
 #include <ipxe/deflate.h>
+#include <ipxe/profile.h>
 #include <ipxe/test.h>
 
+/** Number of sample iterations for profiling */
+#define PROFILE_COUNT 16
+
 /** A DEFLATE test */
 struct deflate_test {
 	/** Compression format */
@@ -207,6 +211,55 @@ static void deflate_okx ( struct deflate *deflate,
 #define deflate_ok( deflate, test, frags ) \
 	deflate_okx ( deflate, test, frags, __FILE__, __LINE__ )
 
+/**
+ * Report DEFLATE compression round-trip test result
+ *
+ * @v deflate		Decompressor
+ * @v test		Deflate test
+ * @v format		Compression format
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * Compresses the test's uncompressed data, decompresses the result
+ * with the existing decompressor, and checks that the original data
+ * is recovered.
+ */
+static void deflate_compress_okx ( struct deflate *deflate,
+				   struct deflate_test *test,
+				   enum deflate_format format,
+				   const char *file, unsigned int line ) {
+	uint8_t compressed[ deflate_compress_bound ( test->expected_len ) ];
+	uint8_t data[ test->expected_len ];
+	struct deflate_compress defcom;
+	struct deflate_chunk in;
+	struct deflate_chunk out;
+
+	/* Compress data */
+	deflate_compress_init ( &defcom, format );
+	deflate_chunk_init ( &in, virt_to_user ( test->expected ), 0,
+			     test->expected_len );
+	deflate_chunk_init ( &out, virt_to_user ( compressed ), 0,
+			     sizeof ( compressed ) );
+	okx ( deflate_compress ( &defcom, &in, &out ) == 0, file, line );
+	okx ( deflate_compress_finish ( &defcom, &out ) == 0, file, line );
+	okx ( in.offset == test->expected_len, file, line );
+	okx ( out.offset <= sizeof ( compressed ), file, line );
+
+	/* Decompress data */
+	deflate_init ( deflate, format );
+	deflate_chunk_init ( &in, virt_to_user ( compressed ), 0,
+			     out.offset );
+	deflate_chunk_init ( &out, virt_to_user ( data ), 0,
+			     sizeof ( data ) );
+	okx ( deflate_inflate ( deflate, &in, &out ) == 0, file, line );
+	okx ( deflate_finished ( deflate ), file, line );
+	okx ( out.offset == test->expected_len, file, line );
+	okx ( memcmp ( data, test->expected, test->expected_len ) == 0,
+	      file, line );
+}
+#define deflate_compress_ok( deflate, test, format ) \
+	deflate_compress_okx ( deflate, test, format, __FILE__, __LINE__ )
+
 /**
  * Perform DEFLATE self-test
  *
@@ -237,14 +290,53 @@ static void deflate_test_exec ( void ) {
 				    sizeof ( zlib_fragments[0] ) ) ; i++ ) {
 			deflate_ok ( deflate, &zlib, &zlib_fragments[i] );
 		}
+
+		/* Test compression round trips */
+		deflate_compress_ok ( deflate, &empty, DEFLATE_RAW );
+		deflate_compress_ok ( deflate, &hello_world, DEFLATE_RAW );
+		deflate_compress_ok ( deflate, &hello_hello_world,
+				      DEFLATE_RAW );
+		deflate_compress_ok ( deflate, &rfc_sentence, DEFLATE_RAW );
+		deflate_compress_ok ( deflate, &zlib, DEFLATE_ZLIB );
 	}
 
 	/* Free shared structure */
 	free ( deflate );
 }
 
+/**
+ * Perform DEFLATE benchmarks
+ *
+ */
+static void deflate_bench_exec ( void ) {
+	struct deflate_test *test = &zlib;
+	uint8_t data[ test->expected_len ];
+	struct profiler profiler;
+	struct deflate deflate;
+	struct deflate_chunk in;
+	struct deflate_chunk out;
+	unsigned int i;
+
+	/* Profile decompression */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		deflate_init ( &deflate, test->format );
+		deflate_chunk_init ( &in, virt_to_user ( test->compressed ),
+				     0, test->compressed_len );
+		deflate_chunk_init ( &out, virt_to_user ( data ), 0,
+				     sizeof ( data ) );
+		profile_start ( &profiler );
+		deflate_inflate ( &deflate, &in, &out );
+		profile_stop ( &profiler );
+	}
+
+	/* Report result (normalised to uncompressed length) */
+	test_bench ( "inflate-zlib", test->expected_len, &profiler );
+}
+
 /** DEFLATE self-test */
 struct self_test deflate_test __self_test = {
 	.name = "deflate",
 	.exec = deflate_test_exec,
+	.bench = deflate_bench_exec,
 };
@@ -35,6 +35,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <string.h>
 #include <byteswap.h>
+#include <ipxe/ethernet.h>
 #include <ipxe/ipv6.h>
 #include <ipxe/test.h>
 
@@ -112,6 +113,9 @@ static const struct in6_addr sample_multicast = {
 /** Dummy network device used for routing tests */
 static struct net_device ipv6_test_netdev = {
 	.refcnt = REF_INIT ( ref_no_free ),
+	.op = &null_netdev_operations,
+	.ll_protocol = &ethernet_protocol,
+	.mcast = LIST_HEAD_INIT ( ipv6_test_netdev.mcast ),
 	.index = 42,
 	.state = NETDEV_OPEN,
 };
@@ -33,6 +33,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #undef NDEBUG
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ipxe/test.h>
@@ -266,8 +267,59 @@ static void memcpy_test_exec ( void ) {
 	}
 }
 
+/**
+ * Benchmark memcpy() for a single block length
+ *
+ * @v len		Length of data to copy
+ */
+static void memcpy_bench ( size_t len ) {
+	struct profiler profiler;
+	char name[16];
+	uint8_t *dest;
+	uint8_t *src;
+	unsigned int i;
+
+	/* Allocate blocks */
+	dest = malloc ( len );
+	assert ( dest != NULL );
+	src = malloc ( len );
+	assert ( src != NULL );
+
+	/* Generate random source data */
+	for ( i = 0 ; i < len ; i++ )
+		src[i] = random();
+
+	/* Profile memcpy() */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		memcpy ( dest, src, len );
+		profile_stop ( &profiler );
+	}
+
+	/* Report result */
+	snprintf ( name, sizeof ( name ), "memcpy-%zd", len );
+	test_bench ( name, len, &profiler );
+
+	/* Free blocks */
+	free ( dest );
+	free ( src );
+}
+
+/**
+ * Perform memcpy() benchmarks
+ *
+ */
+static void memcpy_bench_exec ( void ) {
+
+	memcpy_bench ( 64 );
+	memcpy_bench ( 1500 );
+	memcpy_bench ( 4096 );
+}
+
 /** memcpy() self-test */
 struct self_test memcpy_test __self_test = {
 	.name = "memcpy",
 	.exec = memcpy_test_exec,
+	.bench = memcpy_bench_exec,
 };
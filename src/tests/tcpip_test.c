@@ -33,6 +33,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #undef NDEBUG
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -253,8 +254,49 @@ static void tcpip_test_exec ( void ) {
 	tcpip_random_ok ( &partial );
 }
 
+/**
+ * Benchmark tcpip_chksum() for a single block length
+ *
+ * @v len		Length of data to checksum
+ */
+static void tcpip_bench ( size_t len ) {
+	struct profiler profiler;
+	char name[24];
+	unsigned int i;
+
+	/* Sanity check */
+	assert ( len <= sizeof ( tcpip_data ) );
+
+	/* Generate random data */
+	for ( i = 0 ; i < len ; i++ )
+		tcpip_data[i] = random();
+
+	/* Profile optimised calculation */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, tcpip_data, len );
+		profile_stop ( &profiler );
+	}
+
+	/* Report result */
+	snprintf ( name, sizeof ( name ), "tcpip_chksum-%zd", len );
+	test_bench ( name, len, &profiler );
+}
+
+/**
+ * Perform TCP/IP benchmarks
+ *
+ */
+static void tcpip_bench_exec ( void ) {
+
+	tcpip_bench ( 1500 );
+	tcpip_bench ( 4096 );
+}
+
 /** TCP/IP self-test */
 struct self_test tcpip_test __self_test = {
 	.name = "tcpip",
 	.exec = tcpip_test_exec,
+	.bench = tcpip_bench_exec,
 };
@@ -34,9 +34,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <assert.h>
 #include <ipxe/test.h>
+#include <ipxe/profile.h>
 #include <ipxe/init.h>
 #include <ipxe/image.h>
 #include <usr/profstat.h>
@@ -69,6 +71,23 @@ void test_ok ( int success, const char *file, unsigned int line,
 	}
 }
 
+/**
+ * Report benchmark result
+ *
+ * @v name		Benchmark name
+ * @v len		Number of bytes processed per iteration
+ * @v profiler		Profiler containing accumulated samples
+ */
+void test_bench ( const char *name, size_t len, struct profiler *profiler ) {
+	unsigned long mean = profile_mean ( profiler );
+	unsigned long centicost = ( mean * 100 / len );
+
+	printf ( "BENCH %s: %zd bytes in %ld +/- %ld ticks "
+		 "(%ld.%02ld cycles/byte)\n", name, len, mean,
+		 profile_stddev ( profiler ), ( centicost / 100 ),
+		 ( centicost % 100 ) );
+}
+
 /**
  * Run self-test set
  *
@@ -144,12 +163,37 @@ static int run_all_tests ( void ) {
 	}
 }
 
+/**
+ * Run all benchmarks
+ *
+ */
+static void run_all_benchmarks ( void ) {
+	struct self_test *tests;
+
+	/* Run all compiled-in benchmarks */
+	printf ( "Starting benchmarks\n" );
+	for_each_table_entry ( tests, SELF_TESTS ) {
+		if ( tests->bench )
+			tests->bench();
+	}
+}
+
 static int test_image_probe ( struct image *image __unused ) {
 	return -ENOTTY;
 }
 
-static int test_image_exec ( struct image *image __unused ) {
-	return run_all_tests();
+static int test_image_exec ( struct image *image ) {
+	int rc;
+
+	/* Run self-tests */
+	if ( ( rc = run_all_tests() ) != 0 )
+		return rc;
+
+	/* Run benchmarks, if requested via the image command line */
+	if ( image->cmdline && strstr ( image->cmdline, "bench" ) )
+		run_all_benchmarks();
+
+	return 0;
 }
 
 static struct image_type test_image_type = {
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Data transfer buffer self-tests
+ *
+ * These tests exercise the extent-based data transfer buffer
+ * backend, whose contents are accessible only via xferbuf_read() and
+ * xferbuf_write(), with particular attention to accesses which
+ * scatter and gather across extent boundaries.
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <assert.h>
+#include <string.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/xfer.h>
+#include <ipxe/xferbuf.h>
+#include <ipxe/test.h>
+
+/** Length of the test data chunks */
+#define XFERBUF_TEST_LEN 4096
+
+/**
+ * Fill a chunk with a reproducible test pattern
+ *
+ * @v data		Data to fill
+ * @v len		Length of data
+ * @v seed		Pattern seed
+ */
+static void xferbuf_test_fill ( void *data, size_t len, unsigned int seed ) {
+	uint8_t *bytes = data;
+	size_t i;
+
+	for ( i = 0 ; i < len ; i++ )
+		bytes[i] = ( seed + ( 89 * i ) );
+}
+
+/**
+ * Report a data transfer buffer read test result
+ *
+ * @v xferbuf		Data transfer buffer
+ * @v offset		Starting offset
+ * @v expected		Expected data
+ * @v len		Length of expected data
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void xferbuf_okx ( struct xfer_buffer *xferbuf, size_t offset,
+			  const void *expected, size_t len,
+			  const char *file, unsigned int line ) {
+	static uint8_t data[XFERBUF_TEST_LEN];
+
+	assert ( len <= sizeof ( data ) );
+	okx ( xferbuf_read ( xferbuf, offset, data, len ) == 0, file, line );
+	okx ( memcmp ( data, expected, len ) == 0, file, line );
+}
+#define xferbuf_ok( xferbuf, offset, expected, len ) \
+	xferbuf_okx ( xferbuf, offset, expected, len, __FILE__, __LINE__ )
+
+/**
+ * Perform data transfer buffer self-tests
+ *
+ */
+static void xferbuf_test_exec ( void ) {
+	static struct xfer_buffer_extents extents;
+	static struct xfer_buffer xferbuf;
+	struct xfer_metadata meta;
+	struct io_buffer *iobuf;
+	uint8_t chunk[XFERBUF_TEST_LEN];
+	uint8_t byte;
+
+	/* Initialise extent-based buffer */
+	memset ( &extents, 0, sizeof ( extents ) );
+	memset ( &xferbuf, 0, sizeof ( xferbuf ) );
+	xferbuf_extent_init ( &xferbuf, &extents );
+
+	/* Write and read back a chunk within the first extent */
+	xferbuf_test_fill ( chunk, sizeof ( chunk ), 1 );
+	ok ( xferbuf_write ( &xferbuf, 0, chunk, sizeof ( chunk ) ) == 0 );
+	ok ( xferbuf.len == sizeof ( chunk ) );
+	ok ( extents.count == 1 );
+	xferbuf_ok ( &xferbuf, 0, chunk, sizeof ( chunk ) );
+
+	/* Write a chunk straddling the first extent boundary, and
+	 * read it back both in whole and in fragments crossing the
+	 * boundary.
+	 */
+	xferbuf_test_fill ( chunk, sizeof ( chunk ), 2 );
+	ok ( xferbuf_write ( &xferbuf, ( XFERBUF_EXTENT_LEN - 2000 ),
+			     chunk, sizeof ( chunk ) ) == 0 );
+	ok ( xferbuf.len == ( XFERBUF_EXTENT_LEN - 2000 + sizeof ( chunk ) ) );
+	ok ( extents.count == 2 );
+	xferbuf_ok ( &xferbuf, ( XFERBUF_EXTENT_LEN - 2000 ),
+		     chunk, sizeof ( chunk ) );
+	xferbuf_ok ( &xferbuf, ( XFERBUF_EXTENT_LEN - 1 ), &chunk[1999], 2 );
+	xferbuf_ok ( &xferbuf, ( XFERBUF_EXTENT_LEN - 100 ), &chunk[1900],
+		     200 );
+
+	/* Grow by writing into a third extent, and check that the
+	 * chunk straddling the earlier boundary is undisturbed (since
+	 * growth must never recopy existing data).
+	 */
+	xferbuf_test_fill ( chunk, sizeof ( chunk ), 3 );
+	ok ( xferbuf_write ( &xferbuf, ( 2 * XFERBUF_EXTENT_LEN + 5000 ),
+			     chunk, sizeof ( chunk ) ) == 0 );
+	ok ( extents.count == 3 );
+	xferbuf_ok ( &xferbuf, ( 2 * XFERBUF_EXTENT_LEN + 5000 ),
+		     chunk, sizeof ( chunk ) );
+	xferbuf_test_fill ( chunk, sizeof ( chunk ), 2 );
+	xferbuf_ok ( &xferbuf, ( XFERBUF_EXTENT_LEN - 2000 ),
+		     chunk, sizeof ( chunk ) );
+
+	/* Reject reads beyond the end of the buffer */
+	ok ( xferbuf_read ( &xferbuf, xferbuf.len, &byte, 1 ) != 0 );
+
+	/* Deliver an I/O buffer at an absolute offset */
+	iobuf = alloc_iob ( XFERBUF_TEST_LEN );
+	ok ( iobuf != NULL );
+	xferbuf_test_fill ( iob_put ( iobuf, XFERBUF_TEST_LEN ),
+			    XFERBUF_TEST_LEN, 4 );
+	memset ( &meta, 0, sizeof ( meta ) );
+	meta.flags = XFER_FL_ABS_OFFSET;
+	meta.offset = ( XFERBUF_EXTENT_LEN + 100 );
+	ok ( xferbuf_deliver ( &xferbuf, iob_disown ( iobuf ), &meta ) == 0 );
+	xferbuf_test_fill ( chunk, sizeof ( chunk ), 4 );
+	xferbuf_ok ( &xferbuf, ( XFERBUF_EXTENT_LEN + 100 ),
+		     chunk, sizeof ( chunk ) );
+
+	/* Deliver a follow-on I/O buffer at the current position */
+	iobuf = alloc_iob ( 2000 );
+	ok ( iobuf != NULL );
+	xferbuf_test_fill ( iob_put ( iobuf, 2000 ), 2000, 5 );
+	memset ( &meta, 0, sizeof ( meta ) );
+	ok ( xferbuf_deliver ( &xferbuf, iob_disown ( iobuf ), &meta ) == 0 );
+	xferbuf_test_fill ( chunk, 2000, 5 );
+	xferbuf_ok ( &xferbuf, ( XFERBUF_EXTENT_LEN + 100 + XFERBUF_TEST_LEN ),
+		     chunk, 2000 );
+
+	/* Free the buffer and check that all extents are released */
+	xferbuf_free ( &xferbuf );
+	ok ( xferbuf.len == 0 );
+	ok ( extents.count == 0 );
+	ok ( extents.extent == NULL );
+}
+
+/** Data transfer buffer self-test */
+struct self_test xferbuf_test __self_test = {
+	.name = "xferbuf",
+	.exec = xferbuf_test_exec,
+};
@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Zstandard tests
+ *
+ * Known-good frames were generated using the reference zstd(1)
+ * command-line tool (and verified to decompress with it, where
+ * hand-constructed).
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/uaccess.h>
+#include <ipxe/umalloc.h>
+#include <ipxe/zstd.h>
+#include <ipxe/test.h>
+
+/** Maximum decompressed length of any test vector */
+#define ZSTD_TEST_MAX_LEN 512
+
+/** Define inline data */
+#define DATA(...) { __VA_ARGS__ }
+
+/** A Zstandard test */
+struct zstd_test {
+	/** Compressed data */
+	const void *compressed;
+	/** Length of compressed data */
+	size_t compressed_len;
+	/** Expected decompressed data */
+	const void *expected;
+	/** Length of expected decompressed data */
+	size_t expected_len;
+	/** Frame headers declare the content size */
+	int has_len;
+};
+
+/**
+ * Define a Zstandard test
+ *
+ * @v name		Test name
+ * @v HAS_LEN		Frame headers declare the content size
+ * @v COMPRESSED	Compressed data
+ * @v EXPECTED		Expected decompressed data
+ * @ret test		Zstandard test
+ */
+#define ZSTD_TEST( name, HAS_LEN, COMPRESSED, EXPECTED )		\
+	static const uint8_t name ## _compressed[] = COMPRESSED;	\
+	static const uint8_t name ## _expected[] = EXPECTED;		\
+	static struct zstd_test name = {				\
+		.compressed = name ## _compressed,			\
+		.compressed_len = sizeof ( name ## _compressed ),	\
+		.expected = name ## _expected,				\
+		.expected_len = sizeof ( name ## _expected ),		\
+		.has_len = HAS_LEN,					\
+	};
+
+/* "Hello world" (a single raw block) */
+ZSTD_TEST ( hello, 1,
+	    DATA ( 0x28, 0xb5, 0x2f, 0xfd, 0x20, 0x0b, 0x59, 0x00,
+		   0x00, 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x77,
+		   0x6f, 0x72, 0x6c, 0x64 ),
+	    DATA ( 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x77, 0x6f,
+		   0x72, 0x6c, 0x64 ) );
+
+/* "Hello world" with a content checksum (which is skipped, not verified) */
+ZSTD_TEST ( hello_checksum, 1,
+	    DATA ( 0x28, 0xb5, 0x2f, 0xfd, 0x24, 0x0b, 0x59, 0x00,
+		   0x00, 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x77,
+		   0x6f, 0x72, 0x6c, 0x64, 0xd8, 0x76, 0xb3, 0x12 ),
+	    DATA ( 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x77, 0x6f,
+		   0x72, 0x6c, 0x64 ) );
+
+/* 64 x "a" (a single RLE block, hand-constructed) */
+ZSTD_TEST ( rle, 1,
+	    DATA ( 0x28, 0xb5, 0x2f, 0xfd, 0x20, 0x40, 0x03, 0x02,
+		   0x00, 0x61 ),
+	    DATA ( 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61 ) );
+
+/* "The Zstandard compressed data format specification. " repeated
+ * four times, compressed at level 19 (a compressed block using
+ * Huffman-coded literals, FSE-coded sequences, and repeat offsets).
+ */
+#define COMP_COMPRESSED							\
+	DATA ( 0x28, 0xb5, 0x2f, 0xfd, 0x20, 0xd0, 0xb5, 0x01,		\
+	       0x00, 0x52, 0x03, 0x0b, 0x10, 0xc0, 0xb7, 0x01,		\
+	       0xc2, 0xbd, 0x46, 0x5b, 0x48, 0x36, 0x03, 0x52,		\
+	       0x15, 0x02, 0x84, 0x73, 0x02, 0xc1, 0xc0, 0xe0,		\
+	       0xed, 0xe9, 0xc6, 0x91, 0x1d, 0xf5, 0xbe, 0x24,		\
+	       0x0e, 0x7f, 0x5f, 0x2e, 0x53, 0xb5, 0x3c, 0x05,		\
+	       0xc9, 0x95, 0x2f, 0xf3, 0x55, 0x61, 0x23, 0x21,		\
+	       0x01, 0x00, 0x85, 0xb9, 0x94, 0x82, 0x02 )
+#define COMP_EXPECTED							\
+	DATA ( 0x54, 0x68, 0x65, 0x20, 0x5a, 0x73, 0x74, 0x61,		\
+	       0x6e, 0x64, 0x61, 0x72, 0x64, 0x20, 0x63, 0x6f,		\
+	       0x6d, 0x70, 0x72, 0x65, 0x73, 0x73, 0x65, 0x64,		\
+	       0x20, 0x64, 0x61, 0x74, 0x61, 0x20, 0x66, 0x6f,		\
+	       0x72, 0x6d, 0x61, 0x74, 0x20, 0x73, 0x70, 0x65,		\
+	       0x63, 0x69, 0x66, 0x69, 0x63, 0x61, 0x74, 0x69,		\
+	       0x6f, 0x6e, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20,		\
+	       0x5a, 0x73, 0x74, 0x61, 0x6e, 0x64, 0x61, 0x72,		\
+	       0x64, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x72, 0x65,		\
+	       0x73, 0x73, 0x65, 0x64, 0x20, 0x64, 0x61, 0x74,		\
+	       0x61, 0x20, 0x66, 0x6f, 0x72, 0x6d, 0x61, 0x74,		\
+	       0x20, 0x73, 0x70, 0x65, 0x63, 0x69, 0x66, 0x69,		\
+	       0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x2e, 0x20,		\
+	       0x54, 0x68, 0x65, 0x20, 0x5a, 0x73, 0x74, 0x61,		\
+	       0x6e, 0x64, 0x61, 0x72, 0x64, 0x20, 0x63, 0x6f,		\
+	       0x6d, 0x70, 0x72, 0x65, 0x73, 0x73, 0x65, 0x64,		\
+	       0x20, 0x64, 0x61, 0x74, 0x61, 0x20, 0x66, 0x6f,		\
+	       0x72, 0x6d, 0x61, 0x74, 0x20, 0x73, 0x70, 0x65,		\
+	       0x63, 0x69, 0x66, 0x69, 0x63, 0x61, 0x74, 0x69,		\
+	       0x6f, 0x6e, 0x2e, 0x20, 0x54, 0x68, 0x65, 0x20,		\
+	       0x5a, 0x73, 0x74, 0x61, 0x6e, 0x64, 0x61, 0x72,		\
+	       0x64, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x72, 0x65,		\
+	       0x73, 0x73, 0x65, 0x64, 0x20, 0x64, 0x61, 0x74,		\
+	       0x61, 0x20, 0x66, 0x6f, 0x72, 0x6d, 0x61, 0x74,		\
+	       0x20, 0x73, 0x70, 0x65, 0x63, 0x69, 0x66, 0x69,		\
+	       0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x2e, 0x20 )
+ZSTD_TEST ( comp, 1, COMP_COMPRESSED, COMP_EXPECTED );
+
+/* The same data compressed via a pipe, producing a frame header with
+ * a window descriptor but no declared content size.
+ */
+ZSTD_TEST ( comp_nosize, 0,
+	    DATA ( 0x28, 0xb5, 0x2f, 0xfd, 0x00, 0x68, 0xb5, 0x01,
+		   0x00, 0x52, 0x03, 0x0b, 0x10, 0xc0, 0xb7, 0x01,
+		   0xc2, 0xbd, 0x46, 0x5b, 0x48, 0x36, 0x03, 0x52,
+		   0x15, 0x02, 0x84, 0x73, 0x02, 0xc1, 0xc0, 0xe0,
+		   0xed, 0xe9, 0xc6, 0x91, 0x1d, 0xf5, 0xbe, 0x24,
+		   0x0e, 0x7f, 0x5f, 0x2e, 0x53, 0xb5, 0x3c, 0x05,
+		   0xc9, 0x95, 0x2f, 0xf3, 0x55, 0x61, 0x23, 0x21,
+		   0x01, 0x00, 0x85, 0xb9, 0x94, 0x82, 0x02 ),
+	    COMP_EXPECTED );
+
+/* A skippable frame followed by "Hello world" */
+ZSTD_TEST ( skippable, 1,
+	    DATA ( 0x50, 0x2a, 0x4d, 0x18, 0x04, 0x00, 0x00, 0x00,
+		   0xde, 0xad, 0xbe, 0xef, 0x28, 0xb5, 0x2f, 0xfd,
+		   0x20, 0x0b, 0x59, 0x00, 0x00, 0x48, 0x65, 0x6c,
+		   0x6c, 0x6f, 0x20, 0x77, 0x6f, 0x72, 0x6c, 0x64 ),
+	    DATA ( 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x77, 0x6f,
+		   0x72, 0x6c, 0x64 ) );
+
+/* Two concatenated frames */
+ZSTD_TEST ( multiframe, 1,
+	    DATA ( 0x28, 0xb5, 0x2f, 0xfd, 0x20, 0x0b, 0x59, 0x00,
+		   0x00, 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x77,
+		   0x6f, 0x72, 0x6c, 0x64, 0x28, 0xb5, 0x2f, 0xfd,
+		   0x20, 0x40, 0x03, 0x02, 0x00, 0x61 ),
+	    DATA ( 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x77, 0x6f,
+		   0x72, 0x6c, 0x64, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61,
+		   0x61, 0x61, 0x61 ) );
+
+/* A frame using a reserved block type */
+static const uint8_t reserved_block[] =
+	DATA ( 0x28, 0xb5, 0x2f, 0xfd, 0x20, 0x00, 0x07, 0x00, 0x00 );
+
+/* A frame requiring a dictionary (which is not supported) */
+static const uint8_t dictionary[] =
+	DATA ( 0x28, 0xb5, 0x2f, 0xfd, 0x21, 0x2a, 0x00, 0x00 );
+
+/* A compressed block declaring an FSE accuracy log beyond the
+ * permitted maximum for the literal lengths table.
+ */
+static const uint8_t excess_log[] =
+	DATA ( 0x28, 0xb5, 0x2f, 0xfd, 0x20, 0x00, 0x25, 0x00,
+	       0x00, 0x00, 0x01, 0x80, 0x0f );
+
+/**
+ * Report a Zstandard decompression test result
+ *
+ * @v zstd		Decompressor workspace
+ * @v test		Zstandard test
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void zstd_okx ( struct zstd *zstd, struct zstd_test *test,
+		       const char *file, unsigned int line ) {
+	uint8_t out[ZSTD_TEST_MAX_LEN];
+	size_t out_len;
+	size_t len;
+	int rc;
+
+	/* Check walked decompressed length (which requires all
+	 * frames to declare their content size).
+	 */
+	rc = zstd_decompressed_len ( test->compressed, test->compressed_len,
+				     &len );
+	if ( test->has_len ) {
+		okx ( rc == 0, file, line );
+		okx ( len == test->expected_len, file, line );
+	} else {
+		okx ( rc != 0, file, line );
+	}
+
+	/* Decompress data and compare against expected output */
+	rc = zstd_decompress ( zstd, test->compressed, test->compressed_len,
+			       out, test->expected_len, &out_len );
+	okx ( rc == 0, file, line );
+	okx ( out_len == test->expected_len, file, line );
+	okx ( memcmp ( out, test->expected, out_len ) == 0, file, line );
+}
+
+/**
+ * Report a Zstandard rejection test result
+ *
+ * @v zstd		Decompressor workspace
+ * @v data		Malformed compressed data
+ * @v len		Length of malformed compressed data
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void zstd_fail_okx ( struct zstd *zstd, const void *data, size_t len,
+			    const char *file, unsigned int line ) {
+	uint8_t out[ZSTD_TEST_MAX_LEN];
+	size_t out_len;
+	int rc;
+
+	rc = zstd_decompress ( zstd, data, len, out, sizeof ( out ),
+			       &out_len );
+	okx ( rc != 0, file, line );
+}
+
+#define zstd_ok( zstd, test )						\
+	zstd_okx ( zstd, test, __FILE__, __LINE__ )
+#define zstd_fail_ok( zstd, data, len )					\
+	zstd_fail_okx ( zstd, data, len, __FILE__, __LINE__ )
+
+/**
+ * Perform Zstandard self-tests
+ *
+ */
+static void zstd_test_exec ( void ) {
+	uint8_t corrupt[ sizeof ( hello_compressed ) ];
+	uint8_t out[ZSTD_TEST_MAX_LEN];
+	userptr_t workspace;
+	struct zstd *zstd;
+	size_t out_len;
+	int rc;
+
+	/* Allocate decompressor workspace (too large for the stack) */
+	workspace = umalloc ( sizeof ( *zstd ) );
+	ok ( workspace != UNULL );
+	if ( workspace == UNULL )
+		return;
+	zstd = user_to_virt ( workspace, 0 );
+
+	/* Known-good frames */
+	zstd_ok ( zstd, &hello );
+	zstd_ok ( zstd, &hello_checksum );
+	zstd_ok ( zstd, &rle );
+	zstd_ok ( zstd, &comp );
+	zstd_ok ( zstd, &comp_nosize );
+	zstd_ok ( zstd, &skippable );
+	zstd_ok ( zstd, &multiframe );
+
+	/* Bad magic number */
+	memcpy ( corrupt, hello_compressed, sizeof ( corrupt ) );
+	corrupt[0] ^= 0xff;
+	zstd_fail_ok ( zstd, corrupt, sizeof ( corrupt ) );
+
+	/* Truncated within the magic number and within a block */
+	zstd_fail_ok ( zstd, hello_compressed, 3 );
+	zstd_fail_ok ( zstd, comp_compressed,
+		       ( sizeof ( comp_compressed ) - 1 ) );
+
+	/* Declared content size not matching the regenerated data */
+	memcpy ( corrupt, hello_compressed, sizeof ( corrupt ) );
+	corrupt[5] += 1;
+	zstd_fail_ok ( zstd, corrupt, sizeof ( corrupt ) );
+
+	/* Structurally invalid frames */
+	zstd_fail_ok ( zstd, reserved_block, sizeof ( reserved_block ) );
+	zstd_fail_ok ( zstd, dictionary, sizeof ( dictionary ) );
+	zstd_fail_ok ( zstd, excess_log, sizeof ( excess_log ) );
+
+	/* Output buffer too small */
+	rc = zstd_decompress ( zstd, comp.compressed, comp.compressed_len,
+			       out, ( comp.expected_len - 1 ), &out_len );
+	ok ( rc != 0 );
+
+	ufree ( workspace );
+}
+
+/** Zstandard self-test */
+struct self_test zstd_test __self_test = {
+	.name = "zstd",
+	.exec = zstd_test_exec,
+};
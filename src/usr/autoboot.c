@@ -210,18 +210,22 @@ int uriboot ( struct uri *filename, struct uri **root_paths,
 }
 
 /**
- * Close all open net devices
+ * Close all other open net devices
+ *
+ * @v netdev		Network device to be used for booting
  *
  * Called before a fresh boot attempt in order to free up memory.  We
  * don't just close the device immediately after the boot fails,
  * because there may still be TCP connections in the process of
- * closing.
+ * closing.  The device to be used for booting is left open, so that
+ * an already-established link is not lost.
  */
-static void close_all_netdevs ( void ) {
-	struct net_device *netdev;
+static void close_other_netdevs ( struct net_device *netdev ) {
+	struct net_device *other;
 
-	for_each_netdev ( netdev ) {
-		ifclose ( netdev );
+	for_each_netdev ( other ) {
+		if ( other != netdev )
+			ifclose ( other );
 	}
 }
 
@@ -388,7 +392,7 @@ int netboot ( struct net_device *netdev ) {
 	int rc;
 
 	/* Close all other network devices */
-	close_all_netdevs();
+	close_other_netdevs ( netdev );
 
 	/* Open device and display device status */
 	if ( ( rc = ifopen ( netdev ) ) != 0 )
@@ -519,10 +523,37 @@ void set_autoboot_ll_addr ( const void *ll_addr, size_t len ) {
  */
 static int autoboot ( void ) {
 	struct net_device *netdev;
+	struct net_device *first = NULL;
 	int rc = -ENODEV;
 
-	/* Try booting from each network device.  If we have a
-	 * specified autoboot device location, then use only devices
+	/* Open all autoboot devices, so that link detection and
+	 * autonegotiation can proceed on all devices concurrently, and
+	 * wait for the first device (if any) to reach link-up.  This
+	 * avoids incurring a separate link-up timeout for each
+	 * disconnected port on a multi-port machine.
+	 */
+	for_each_netdev ( netdev ) {
+		if ( is_autoboot_device && ( ! is_autoboot_device ( netdev ) ) )
+			continue;
+		ifopen ( netdev );
+	}
+	iflinkwait_any ( LINK_WAIT_TIMEOUT );
+
+	/* Identify first device to reach link-up, if any, and attempt
+	 * booting from it before trying any other devices.
+	 */
+	for_each_netdev ( netdev ) {
+		if ( is_autoboot_device && ( ! is_autoboot_device ( netdev ) ) )
+			continue;
+		if ( netdev_link_ok ( netdev ) ) {
+			first = netdev;
+			rc = netboot ( netdev );
+			break;
+		}
+	}
+
+	/* Try booting from each remaining network device.  If we have
+	 * a specified autoboot device location, then use only devices
 	 * matching that location.
 	 */
 	for_each_netdev ( netdev ) {
@@ -531,6 +562,10 @@ static int autoboot ( void ) {
 		if ( is_autoboot_device && ( ! is_autoboot_device ( netdev ) ) )
 			continue;
 
+		/* Skip already-attempted device, if applicable */
+		if ( netdev == first )
+			continue;
+
 		/* Attempt booting from this device */
 		rc = netboot ( netdev );
 	}
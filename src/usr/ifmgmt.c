@@ -34,6 +34,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/monojob.h>
 #include <ipxe/timer.h>
 #include <ipxe/errortab.h>
+#include <ipxe/tcp.h>
 #include <usr/ifmgmt.h>
 
 /** @file
@@ -42,9 +43,6 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
-/** Default time to wait for link-up */
-#define LINK_WAIT_TIMEOUT ( 15 * TICKS_PER_SEC )
-
 /** Default unsuccessful configuration status code */
 #define EADDRNOTAVAIL_CONFIG __einfo_error ( EINFO_EADDRNOTAVAIL_CONFIG )
 #define EINFO_EADDRNOTAVAIL_CONFIG					\
@@ -121,10 +119,47 @@ void ifstat ( struct net_device *netdev ) {
 		printf ( "  [Link status: %s]\n",
 			 strerror ( netdev->link_rc ) );
 	}
+	if ( netdev->rx_ring.max || netdev->rx_ring.overruns ) {
+		printf ( "  [RXQ: %d/%d max fill, %d overruns]\n",
+			 netdev->rx_ring.max, NETDEV_RX_RING_COUNT,
+			 netdev->rx_ring.overruns );
+	}
+	if ( netdev->demux[NETDEV_DEMUX_ARP] ||
+	     netdev->demux[NETDEV_DEMUX_IPV4] ||
+	     netdev->demux[NETDEV_DEMUX_IPV6] ||
+	     netdev->demux[NETDEV_DEMUX_OTHER] ) {
+		printf ( "  [RX demux: ARP %d, IPv4 %d, IPv6 %d, other %d]\n",
+			 netdev->demux[NETDEV_DEMUX_ARP],
+			 netdev->demux[NETDEV_DEMUX_IPV4],
+			 netdev->demux[NETDEV_DEMUX_IPV6],
+			 netdev->demux[NETDEV_DEMUX_OTHER] );
+	}
 	ifstat_errors ( &netdev->tx_stats, "TXE" );
 	ifstat_errors ( &netdev->rx_stats, "RXE" );
 }
 
+/** TCP activity statistics
+ *
+ * This weak definition allows ifstat_tcp() to be used in builds that
+ * do not include TCP, in which case the counters simply remain zero.
+ */
+struct tcp_stats tcp_stats __attribute__ (( weak ));
+
+/**
+ * Print global TCP statistics
+ *
+ * TCP retransmission and selective acknowledgement counters are
+ * global rather than per-device, and so are reported once rather than
+ * per network device.
+ */
+void ifstat_tcp ( void ) {
+
+	if ( tcp_stats.retransmits || tcp_stats.sacks ) {
+		printf ( "TCP: %d retransmissions, %d SACK blocks sent\n",
+			 tcp_stats.retransmits, tcp_stats.sacks );
+	}
+}
+
 /** Network device poller */
 struct ifpoller {
 	/** Job control interface */
@@ -230,6 +265,59 @@ int iflinkwait ( struct net_device *netdev, unsigned long timeout ) {
 	return ifpoller_wait ( netdev, NULL, timeout, iflinkwait_progress );
 }
 
+/**
+ * Check any-device link-up progress
+ *
+ * @v ifpoller		Network device poller
+ * @ret ongoing_rc	Ongoing job status code (if known)
+ */
+static int iflinkwait_any_progress ( struct ifpoller *ifpoller ) {
+	struct net_device *netdev;
+	int ongoing_rc = -ENODEV;
+
+	/* Terminate successfully as soon as any open device has link up */
+	for_each_netdev ( netdev ) {
+		if ( ! netdev_is_open ( netdev ) )
+			continue;
+		ongoing_rc = netdev->link_rc;
+		if ( ongoing_rc == 0 ) {
+			intf_close ( &ifpoller->job, 0 );
+			break;
+		}
+	}
+
+	/* Otherwise, report link status as ongoing job status */
+	return ongoing_rc;
+}
+
+/**
+ * Wait for link-up on any open network device, with status indication
+ *
+ * @v timeout		Timeout period, in ticks
+ * @ret rc		Return status code
+ *
+ * Link detection and autonegotiation proceed concurrently on all open
+ * devices, and so waiting for whichever device first reaches link-up
+ * is substantially faster than waiting for each device in turn on a
+ * machine with multiple (mostly disconnected) ports.
+ */
+int iflinkwait_any ( unsigned long timeout ) {
+	struct net_device *netdev;
+
+	/* Return immediately if any open device already has link up */
+	for_each_netdev ( netdev ) {
+		if ( ! netdev_is_open ( netdev ) )
+			continue;
+		netdev_poll ( netdev );
+		if ( netdev_link_ok ( netdev ) )
+			return 0;
+	}
+
+	/* Wait for link-up */
+	printf ( "Waiting for link-up on any device" );
+	return ifpoller_wait ( NULL, NULL, timeout, iflinkwait_any_progress );
+}
+
 /**
  * Check configuration progress
  *
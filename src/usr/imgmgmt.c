@@ -26,12 +26,21 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <ipxe/image.h>
 #include <ipxe/downloader.h>
 #include <ipxe/monojob.h>
+#include <ipxe/job.h>
 #include <ipxe/open.h>
 #include <ipxe/uri.h>
+#include <ipxe/list.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/interface.h>
+#include <ipxe/process.h>
+#include <ipxe/console.h>
+#include <ipxe/keys.h>
+#include <ipxe/timer.h>
 #include <usr/imgmgmt.h>
 
 /** @file
@@ -40,6 +49,348 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/** An asynchronous image download */
+struct imgasync {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** List of asynchronous downloads */
+	struct list_head list;
+	/** Job control interface */
+	struct interface job;
+	/** Image being downloaded */
+	struct image *image;
+	/** Redacted URI string (for progress messages) */
+	char *uri_string;
+	/** Progress rate estimator */
+	struct job_rate rate;
+	/** Overall status code */
+	int rc;
+};
+
+/** List of asynchronous downloads */
+static LIST_HEAD ( imgasyncs );
+
+/**
+ * Construct redacted URI string
+ *
+ * @v uri		URI
+ * @ret uri_string	Redacted URI string, or NULL on allocation failure
+ *
+ * The caller is responsible for eventually calling free() on the
+ * allocated URI string.
+ */
+static char * imgmgmt_uri_string ( struct uri *uri ) {
+	struct uri uri_redacted;
+
+	memcpy ( &uri_redacted, uri, sizeof ( uri_redacted ) );
+	uri_redacted.user = NULL;
+	uri_redacted.password = NULL;
+	uri_redacted.query = NULL;
+	uri_redacted.fragment = NULL;
+	return format_uri_alloc ( &uri_redacted );
+}
+
+/**
+ * Free asynchronous image download
+ *
+ * @v refcnt		Reference count
+ */
+static void imgasync_free ( struct refcnt *refcnt ) {
+	struct imgasync *async =
+		container_of ( refcnt, struct imgasync, refcnt );
+
+	image_put ( async->image );
+	free ( async->uri_string );
+	free ( async );
+}
+
+/**
+ * Handle completion of asynchronous image download
+ *
+ * @v async		Asynchronous image download
+ * @v rc		Reason for completion
+ */
+static void imgasync_close ( struct imgasync *async, int rc ) {
+
+	/* Register image, if download succeeded */
+	if ( rc == 0 )
+		rc = register_image ( async->image );
+
+	/* Record final status (for collection by imgwait()) */
+	async->rc = rc;
+
+	/* Shut down interfaces */
+	intf_shutdown ( &async->job, rc );
+}
+
+/** Asynchronous image download job control interface operations */
+static struct interface_operation imgasync_job_op[] = {
+	INTF_OP ( intf_close, struct imgasync *, imgasync_close ),
+};
+
+/** Asynchronous image download job control interface descriptor */
+static struct interface_descriptor imgasync_job_desc =
+	INTF_DESC ( struct imgasync, job, imgasync_job_op );
+
+/**
+ * Start downloading a new image in the background
+ *
+ * @v uri		URI
+ * @v image		Image to fill in
+ * @ret rc		Return status code
+ *
+ * The download proceeds while other foreground jobs (including
+ * further downloads) run, and the image is registered automatically
+ * upon completion.  Call imgwait() to wait for all background
+ * downloads to complete.
+ */
+int imgdownload_async ( struct uri *uri, struct image **image ) {
+	struct imgasync *async;
+	int rc;
+
+	/* Allocate and initialise structure */
+	async = zalloc ( sizeof ( *async ) );
+	if ( ! async ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ref_init ( &async->refcnt, imgasync_free );
+	intf_init ( &async->job, &imgasync_job_desc, &async->refcnt );
+	async->rc = -EINPROGRESS;
+
+	/* Construct redacted URI string */
+	async->uri_string = imgmgmt_uri_string ( uri );
+	if ( ! async->uri_string ) {
+		rc = -ENOMEM;
+		goto err_uri_string;
+	}
+
+	/* Resolve URI */
+	uri = resolve_uri ( cwuri, uri );
+	if ( ! uri ) {
+		rc = -ENOMEM;
+		goto err_resolve_uri;
+	}
+
+	/* Allocate image */
+	async->image = alloc_image ( uri );
+	if ( ! async->image ) {
+		rc = -ENOMEM;
+		goto err_alloc_image;
+	}
+
+	/* Create downloader */
+	if ( ( rc = create_downloader ( &async->job, async->image ) ) != 0 ) {
+		printf ( "Could not start download: %s\n", strerror ( rc ) );
+		goto err_create_downloader;
+	}
+
+	/* Add to list of asynchronous downloads.  The list holds the
+	 * original reference; imgwait() will drop it.
+	 */
+	list_add_tail ( &async->list, &imgasyncs );
+	*image = async->image;
+	uri_put ( uri );
+	return 0;
+
+ err_create_downloader:
+ err_alloc_image:
+	uri_put ( uri );
+ err_resolve_uri:
+ err_uri_string:
+	ref_put ( &async->refcnt );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Start downloading a new image in the background
+ *
+ * @v uri_string	URI string
+ * @v image		Image to fill in
+ * @ret rc		Return status code
+ */
+int imgdownload_string_async ( const char *uri_string,
+			       struct image **image ) {
+	struct uri *uri;
+	int rc;
+
+	if ( ! ( uri = parse_uri ( uri_string ) ) )
+		return -ENOMEM;
+
+	rc = imgdownload_async ( uri, image );
+
+	uri_put ( uri );
+	return rc;
+}
+
+/**
+ * Display progress of all asynchronous downloads
+ *
+ * Background downloads continue to progress whenever the current
+ * foreground activity steps the process queue (which includes sitting
+ * at the shell prompt), so this can be used to inspect a running
+ * transfer without interrupting it.
+ */
+void imgjobs ( void ) {
+	struct imgasync *async;
+	struct job_progress progress;
+	unsigned long scaled_completed;
+	unsigned long scaled_total;
+	unsigned long per_sec;
+	unsigned long eta;
+	unsigned int percentage;
+
+	list_for_each_entry ( async, &imgasyncs, list ) {
+
+		/* Display identity and final status, if completed */
+		printf ( "%s : ", async->uri_string );
+		if ( async->rc != -EINPROGRESS ) {
+			printf ( "%s\n", ( async->rc ?
+					   strerror ( async->rc ) : "ok" ) );
+			continue;
+		}
+
+		/* Display progress; normalise figures to avoid overflow */
+		job_progress ( &async->job, &progress );
+		job_rate_sample ( &async->rate, progress.completed );
+		scaled_completed = ( progress.completed / 128 );
+		scaled_total = ( progress.total / 128 );
+		if ( scaled_total ) {
+			percentage = ( ( 100 * scaled_completed ) /
+				       scaled_total );
+			printf ( "%3d%% (%ld / %ld bytes)", percentage,
+				 progress.completed, progress.total );
+		} else {
+			printf ( "%ld bytes", progress.completed );
+		}
+		per_sec = job_rate_per_sec ( &async->rate );
+		if ( async->rate.count >= 2 )
+			printf ( ", %ldkB/s", ( per_sec / 1024 ) );
+		eta = job_rate_eta ( &async->rate, progress.total );
+		if ( eta )
+			printf ( ", %ld:%02ld remaining", ( eta / 60 ),
+				 ( eta % 60 ) );
+		if ( progress.message[0] )
+			printf ( " [%s]", progress.message );
+		printf ( "\n" );
+	}
+}
+
+/**
+ * Wait for all asynchronous downloads to complete
+ *
+ * @ret rc		Return status code
+ *
+ * Acts as a barrier: returns only once every download started via
+ * imgdownload_async() has completed (or been cancelled via Ctrl-C).
+ * Returns the first error encountered, if any.
+ */
+int imgwait ( void ) {
+	struct imgasync *async;
+	struct imgasync *tmp;
+	unsigned long last_check;
+	unsigned long now;
+	int key;
+	int rc = 0;
+
+	last_check = currticks();
+	while ( ! list_empty ( &imgasyncs ) ) {
+
+		/* Allow downloads to progress */
+		step();
+
+		/* Reap completed downloads */
+		list_for_each_entry_safe ( async, tmp, &imgasyncs, list ) {
+			if ( async->rc == -EINPROGRESS )
+				continue;
+			printf ( "%s... %s\n", async->uri_string,
+				 ( async->rc ?
+				   strerror ( async->rc ) : "ok" ) );
+			if ( ( async->rc != 0 ) && ( rc == 0 ) )
+				rc = async->rc;
+			list_del ( &async->list );
+			ref_put ( &async->refcnt );
+		}
+
+		/* Check for cancellation no more than once per timer
+		 * tick (to minimise time wasted checking for
+		 * keypresses).
+		 */
+		now = currticks();
+		if ( now == last_check )
+			continue;
+		last_check = now;
+		if ( iskey() && ( ( key = getchar() ) == CTRL_C ) ) {
+			list_for_each_entry ( async, &imgasyncs, list ) {
+				async->rc = -ECANCELED;
+				intf_shutdown ( &async->job, -ECANCELED );
+			}
+		}
+	}
+
+	return rc;
+}
+
+/**
+ * Wait for a single asynchronous download to complete
+ *
+ * @v image		Image being downloaded
+ * @ret rc		Return status code
+ *
+ * Waits only for the download producing the specified image, leaving
+ * any other background downloads to continue.  Returns success
+ * immediately if the image is not (or is no longer) being downloaded.
+ */
+int imgwait_image ( struct image *image ) {
+	struct imgasync *async;
+	struct imgasync *found = NULL;
+	unsigned long last_check;
+	unsigned long now;
+	int key;
+	int rc;
+
+	/* Identify the relevant download, if any */
+	list_for_each_entry ( async, &imgasyncs, list ) {
+		if ( async->image == image ) {
+			found = async;
+			break;
+		}
+	}
+	if ( ! found )
+		return 0;
+
+	/* Wait for this download (only) to complete */
+	last_check = currticks();
+	while ( found->rc == -EINPROGRESS ) {
+
+		/* Allow downloads to progress */
+		step();
+
+		/* Check for cancellation no more than once per timer
+		 * tick (to minimise time wasted checking for
+		 * keypresses).
+		 */
+		now = currticks();
+		if ( now == last_check )
+			continue;
+		last_check = now;
+		if ( iskey() && ( ( key = getchar() ) == CTRL_C ) ) {
+			found->rc = -ECANCELED;
+			intf_shutdown ( &found->job, -ECANCELED );
+		}
+	}
+
+	/* Reap completed download */
+	printf ( "%s... %s\n", found->uri_string,
+		 ( found->rc ? strerror ( found->rc ) : "ok" ) );
+	rc = found->rc;
+	list_del ( &found->list );
+	ref_put ( &found->refcnt );
+
+	return rc;
+}
+
 /**
  * Download a new image
  *
@@ -50,17 +401,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 int imgdownload ( struct uri *uri, unsigned long timeout,
 		  struct image **image ) {
-	struct uri uri_redacted;
 	char *uri_string_redacted;
 	int rc;
 
-	/* Construct redacted URI */
-	memcpy ( &uri_redacted, uri, sizeof ( uri_redacted ) );
-	uri_redacted.user = NULL;
-	uri_redacted.password = NULL;
-	uri_redacted.query = NULL;
-	uri_redacted.fragment = NULL;
-	uri_string_redacted = format_uri_alloc ( &uri_redacted );
+	/* Construct redacted URI string */
+	uri_string_redacted = imgmgmt_uri_string ( uri );
 	if ( ! uri_string_redacted ) {
 		rc = -ENOMEM;
 		goto err_uri_string;
@@ -23,6 +23,7 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <time.h>
@@ -30,8 +31,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/uaccess.h>
 #include <ipxe/image.h>
 #include <ipxe/cms.h>
+#include <ipxe/sha256.h>
 #include <ipxe/validator.h>
 #include <ipxe/monojob.h>
+#include <ipxe/process.h>
+#include <usr/imgmgmt.h>
 #include <usr/imgtrust.h>
 
 /** @file
@@ -40,19 +44,35 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/** Incremental digest chunk size
+ *
+ * Signed images are digested in chunks of this size, with the
+ * network stack allowed to advance between chunks, so that hashing a
+ * large image overlaps the round trips involved in certificate chain
+ * validation (e.g. cross-signed certificate and OCSP fetches) rather
+ * than adding a full pass over the image afterwards.
+ */
+#define IMGTRUST_DIGEST_CHUNK ( 128 * 1024 )
+
 /**
  * Verify image using downloaded signature
  *
  * @v image		Image to verify
  * @v signature		Image containing signature
  * @v name		Required common name, or NULL to allow any name
+ * @v predigest		Digest algorithm used for precomputation, or NULL
+ * @v prectx		Precomputed digest context over the image data
  * @ret rc		Return status code
  */
-int imgverify ( struct image *image, struct image *signature,
-		const char *name ) {
+static int imgverify_common ( struct image *image, struct image *signature,
+			      const char *name,
+			      struct digest_algorithm *predigest,
+			      const void *prectx ) {
 	struct asn1_cursor *data;
 	struct cms_signature *sig;
 	struct cms_signer_info *info;
+	size_t offset = 0;
+	size_t frag_len;
 	time_t now;
 	int next;
 	int rc;
@@ -75,10 +95,34 @@ int imgverify ( struct image *image, struct image *signature,
 	free ( data );
 	data = NULL;
 
-	/* Complete all certificate chains */
+	/* Initialise incremental digests */
+	if ( ( rc = cms_digest_init ( sig ) ) != 0 )
+		goto err_digest_init;
+
+	/* Adopt a precomputed digest of the image data, if one is
+	 * available and matches the algorithm demanded by the
+	 * signature.
+	 */
+	if ( predigest &&
+	     ( cms_digest_resume ( sig, predigest, prectx ) == 0 ) )
+		offset = image->len;
+
+	/* Complete all certificate chains, digesting the image while
+	 * each validation waits on its network round trips.
+	 */
 	list_for_each_entry ( info, &sig->info, list ) {
-		if ( ( rc = create_validator ( &monojob, info->chain ) ) != 0 )
+		if ( ( rc = create_validator ( &monojob, info->chain,
+					       NULL, 0 ) ) != 0 )
 			goto err_create_validator;
+		while ( offset < image->len ) {
+			frag_len = ( image->len - offset );
+			if ( frag_len > IMGTRUST_DIGEST_CHUNK )
+				frag_len = IMGTRUST_DIGEST_CHUNK;
+			cms_digest_update ( sig, image->data, offset,
+					    frag_len );
+			offset += frag_len;
+			step();
+		}
 		if ( ( rc = monojob_wait ( NULL, 0 ) ) != 0 )
 			goto err_validator_wait;
 	}
@@ -102,6 +146,7 @@ int imgverify ( struct image *image, struct image *signature,
  err_verify:
  err_validator_wait:
  err_create_validator:
+ err_digest_init:
 	cms_put ( sig );
  err_parse:
 	free ( data );
@@ -110,3 +155,86 @@ int imgverify ( struct image *image, struct image *signature,
 		 image->name, strerror ( rc ) );
 	return rc;
 }
+
+/**
+ * Verify image using downloaded signature
+ *
+ * @v image		Image to verify
+ * @v signature		Image containing signature
+ * @v name		Required common name, or NULL to allow any name
+ * @ret rc		Return status code
+ */
+int imgverify ( struct image *image, struct image *signature,
+		const char *name ) {
+
+	return imgverify_common ( image, signature, name, NULL, NULL );
+}
+
+/**
+ * Verify image, downloading the signature as required
+ *
+ * @v image		Image to verify
+ * @v name_uri		Signature name or URI string
+ * @v timeout		Download timeout
+ * @v name		Required common name, or NULL to allow any name
+ * @ret signature	Image containing signature (if acquired)
+ * @ret rc		Return status code
+ */
+int imgverify_download ( struct image *image, const char *name_uri,
+			 unsigned long timeout, const char *name,
+			 struct image **signature ) {
+	struct digest_algorithm *digest = &sha256_algorithm;
+	uint8_t ctx[digest->ctxsize];
+	uint8_t block[digest->blocksize];
+	size_t offset = 0;
+	size_t frag_len;
+	int rc;
+
+	/* Use an existing signature image directly, and fall back to
+	 * a foreground download if a timeout applies (since
+	 * background downloads have no timeout support).
+	 */
+	*signature = find_image ( name_uri );
+	if ( ( ! *signature ) && timeout ) {
+		if ( ( rc = imgdownload_string ( name_uri, timeout,
+						 signature ) ) != 0 ) {
+			*signature = NULL;
+			return rc;
+		}
+	}
+	if ( *signature )
+		return imgverify ( image, *signature, name );
+
+	/* Start downloading the signature in the background */
+	if ( ( rc = imgdownload_string_async ( name_uri, signature ) ) != 0 ) {
+		*signature = NULL;
+		return rc;
+	}
+
+	/* Digest the image while the signature downloads.  The digest
+	 * algorithm is recorded only within the signature itself, so
+	 * we guess SHA-256 (which is overwhelmingly the algorithm
+	 * used in practice for CMS signatures); a wrong guess merely
+	 * wastes the precomputation.
+	 */
+	digest_init ( digest, ctx );
+	while ( offset < image->len ) {
+		frag_len = ( image->len - offset );
+		if ( frag_len > sizeof ( block ) )
+			frag_len = sizeof ( block );
+		copy_from_user ( block, image->data, offset, frag_len );
+		digest_update ( digest, ctx, block, frag_len );
+		offset += frag_len;
+		if ( ( offset % IMGTRUST_DIGEST_CHUNK ) == 0 )
+			step();
+	}
+
+	/* Wait for signature download to complete */
+	if ( ( rc = imgwait_image ( *signature ) ) != 0 ) {
+		*signature = NULL;
+		return rc;
+	}
+
+	/* Verify image, adopting the precomputed digest if possible */
+	return imgverify_common ( image, *signature, name, digest, ctx );
+}
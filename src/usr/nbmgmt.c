@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <ipxe/netbench.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/monojob.h>
+#include <ipxe/timer.h>
+#include <usr/nbmgmt.h>
+
+/** @file
+ *
+ * Network benchmark management
+ *
+ */
+
+/** Benchmark results (filled in by callback) */
+static struct {
+	/** Number of packets transferred */
+	unsigned long packets;
+	/** Number of bytes transferred */
+	unsigned long long bytes;
+	/** Elapsed time (in ticks) */
+	unsigned long ticks;
+} netbench_result;
+
+/** Maximum number of network devices to track */
+#define NETBENCH_MAX_NETDEVS 8
+
+/** Network device statistics snapshots (taken before the benchmark) */
+static struct {
+	/** Transmit completion count */
+	unsigned int tx_good;
+	/** Transmit error count */
+	unsigned int tx_bad;
+	/** Receive completion count */
+	unsigned int rx_good;
+	/** Receive error count */
+	unsigned int rx_bad;
+} netbench_snapshot[NETBENCH_MAX_NETDEVS];
+
+/**
+ * Record benchmark results
+ *
+ * @v packets		Number of packets transferred
+ * @v bytes		Number of bytes transferred
+ * @v ticks		Elapsed time (in ticks)
+ */
+static void netbench_callback ( unsigned long packets,
+				unsigned long long bytes,
+				unsigned long ticks ) {
+
+	netbench_result.packets = packets;
+	netbench_result.bytes = bytes;
+	netbench_result.ticks = ticks;
+}
+
+/**
+ * Run a network throughput benchmark
+ *
+ * @v hostname		Hostname (ignored in receiver mode)
+ * @v port		Port number
+ * @v semantics		Communication semantics (e.g. SOCK_DGRAM)
+ * @v rx		Operate as receiver
+ * @v len		Payload length
+ * @v duration		Test duration (in ticks)
+ * @ret rc		Return status code
+ */
+int netbench ( const char *hostname, unsigned int port, int semantics,
+	       int rx, size_t len, unsigned long duration ) {
+	struct net_device *netdev;
+	unsigned int i;
+	unsigned long ms;
+	unsigned long pps;
+	unsigned long long per_sec;
+	int rc;
+
+	/* Snapshot network device statistics */
+	i = 0;
+	for_each_netdev ( netdev ) {
+		if ( i >= NETBENCH_MAX_NETDEVS )
+			break;
+		netbench_snapshot[i].tx_good = netdev->tx_stats.good;
+		netbench_snapshot[i].tx_bad = netdev->tx_stats.bad;
+		netbench_snapshot[i].rx_good = netdev->rx_stats.good;
+		netbench_snapshot[i].rx_bad = netdev->rx_stats.bad;
+		i++;
+	}
+
+	/* Create benchmark */
+	memset ( &netbench_result, 0, sizeof ( netbench_result ) );
+	if ( ( rc = create_netbench ( &monojob, semantics, hostname, port,
+				      len, duration, rx,
+				      netbench_callback ) ) != 0 ) {
+		printf ( "Could not start benchmark: %s\n", strerror ( rc ) );
+		return rc;
+	}
+
+	/* Wait for benchmark to complete */
+	if ( ( rc = monojob_wait ( ( rx ? "Receiving" : "Sending" ),
+				   0 ) ) != 0 )
+		return rc;
+
+	/* Display throughput results, normalising elapsed time to
+	 * milliseconds (and avoiding division by zero).
+	 */
+	ms = ( netbench_result.ticks * 1000 / TICKS_PER_SEC );
+	if ( ! ms )
+		ms = 1;
+	pps = ( netbench_result.packets * 1000 / ms );
+	per_sec = ( netbench_result.bytes * 1000 / ms );
+	printf ( "%ld packets (%lld bytes) in %ld.%03lds: %ld pkt/s, "
+		 "%lld kB/s\n", netbench_result.packets,
+		 netbench_result.bytes, ( ms / 1000 ), ( ms % 1000 ),
+		 pps, ( per_sec / 1024 ) );
+
+	/* Display network device statistics deltas, to expose packets
+	 * dropped or errored below the protocol stack.
+	 */
+	i = 0;
+	for_each_netdev ( netdev ) {
+		if ( i >= NETBENCH_MAX_NETDEVS )
+			break;
+		printf ( "%s: TX %d ok %d err, RX %d ok %d err\n",
+			 netdev->name,
+			 ( netdev->tx_stats.good -
+			   netbench_snapshot[i].tx_good ),
+			 ( netdev->tx_stats.bad -
+			   netbench_snapshot[i].tx_bad ),
+			 ( netdev->rx_stats.good -
+			   netbench_snapshot[i].rx_good ),
+			 ( netdev->rx_stats.bad -
+			   netbench_snapshot[i].rx_bad ) );
+		i++;
+	}
+
+	return 0;
+}
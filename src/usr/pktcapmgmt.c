@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdio.h>
+#include <errno.h>
+#include <ipxe/uri.h>
+#include <ipxe/monojob.h>
+#include <ipxe/pktcap.h>
+#include <usr/pktcapmgmt.h>
+
+/** @file
+ *
+ * Packet capture management
+ *
+ */
+
+/**
+ * Upload packet capture ring as a pcap file
+ *
+ * @v uri_string	URI to which the capture should be POSTed
+ * @ret rc		Return status code
+ */
+int pktcap ( const char *uri_string ) {
+	unsigned int packets = pktcap_packets();
+	struct uri *uri;
+	int rc;
+
+	/* Parse URI */
+	uri = parse_uri ( uri_string );
+	if ( ! uri ) {
+		rc = -ENOMEM;
+		goto err_parse_uri;
+	}
+
+	/* Create upload */
+	if ( ( rc = create_pktcap_upload ( &monojob, uri ) ) != 0 ) {
+		printf ( "Could not upload capture: %s\n", strerror ( rc ) );
+		goto err_create;
+	}
+
+	/* Wait for upload to complete */
+	if ( ( rc = monojob_wait ( "Uploading capture", 0 ) ) != 0 )
+		goto err_monojob_wait;
+
+	/* Display summary */
+	printf ( "Uploaded %d packets (of %d captured)\n",
+		 ( ( packets < PKTCAP_NUM_PACKETS ) ?
+		   packets : PKTCAP_NUM_PACKETS ), packets );
+
+ err_monojob_wait:
+ err_create:
+	uri_put ( uri );
+ err_parse_uri:
+	return rc;
+}
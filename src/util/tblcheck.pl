@@ -0,0 +1,108 @@
+#!/usr/bin/env perl
+#
+# Report linker table usage for a built image, based on the linker map
+# produced by "make bin/%.tmp".  Each linker table is listed along with
+# the objects contributing entries to it and the space consumed by each
+# entry, so that embedded-script production builds can identify (and
+# exclude via config/local/*.h) commands and other backends that the
+# image will never reach.
+#
+# When given an embedded script via --script, the "commands" table is
+# additionally cross-referenced against the words used by the script,
+# and command table entries never invoked by the script are flagged as
+# candidates for removal.
+
+use strict;
+use warnings;
+
+use File::Basename qw(basename);
+use Getopt::Long qw(GetOptions);
+
+my $help = 0;
+my @scripts;
+my @tables;
+GetOptions(
+    'help'     => \$help,
+    'script=s' => \@scripts,
+    'table=s'  => \@tables,
+) or die "Could not parse command-line options\n";
+
+if ( $help || ! @ARGV ) {
+  die "Usage: $0 [--script <script>] [--table <table>] <mapfile>\n";
+}
+
+# Parse linker map(s): collect the size, object and symbol of each
+# linker table entry.  Table sections are named ".tbl.<table>.<idx>";
+# the zero-length entries at indices 00 and 99 are the table start and
+# end markers and are not of interest.
+my %entries;
+my $section;
+while ( <> ) {
+  if ( /^\s*\.tbl\.(\S+)\.\d+\s*$/ ) {
+    $section = $1;
+  } elsif ( defined $section &&
+	    /^\s+0x[0-9a-fA-F]+\s+(0x[0-9a-fA-F]+)\s+\S+?\(?([^\s\/(]+\.o)\)?\s*$/ ) {
+    my ( $size, $object ) = ( hex ( $1 ), $2 );
+    push @{ $entries{$section} },
+	{ object => $object, size => $size, symbols => [] }
+	if $size;
+  } elsif ( defined $section && /^\s+0x[0-9a-fA-F]+\s+(\S+)\s*$/ ) {
+    push @{ $entries{$section}->[-1]->{symbols} }, $1
+	if @{ $entries{$section} || [] };
+  } else {
+    undef $section;
+  }
+}
+
+# Collect the set of words used by any embedded scripts
+my %words;
+foreach my $script ( @scripts ) {
+  open my $fh, '<', $script or die "Could not open $script: $!\n";
+  while ( my $line = <$fh> ) {
+    $line =~ s/#.*//;
+    $words{$_} = 1 foreach ( $line =~ /([\w.-]+)/g );
+  }
+  close $fh;
+}
+
+# Determine the command names provided by a command object, by
+# locating its source file and extracting the .name initialisers
+sub command_names {
+  my $object = shift;
+  my $stem = basename ( $object, '.o' );
+  my @names;
+  foreach my $src ( glob ( "hci/commands/" . $stem . ".c" ),
+		    glob ( "*/" . $stem . ".c" ) ) {
+    open my $fh, '<', $src or next;
+    while ( my $line = <$fh> ) {
+      push @names, $1 if ( $line =~ /\.name\s*=\s*"([^"]+)"/ );
+    }
+    close $fh;
+    last if @names;
+  }
+  return @names;
+}
+
+# Print the report
+my %wanted = map { $_ => 1 } @tables;
+foreach my $table ( sort keys %entries ) {
+  next if ( @tables && ! $wanted{$table} );
+  my $total = 0;
+  $total += $_->{size} foreach @{ $entries{$table} };
+  printf "%s (%d entries, %d bytes):\n",
+      $table, scalar @{ $entries{$table} }, $total;
+  foreach my $entry ( @{ $entries{$table} } ) {
+    my $note = '';
+    if ( %words && $table eq 'commands' ) {
+      my @names = command_names ( $entry->{object} );
+      my @unused = grep { ! $words{$_} } @names;
+      if ( @names && @unused == @names ) {
+	$note = ' [unused by script]';
+      } elsif ( @unused ) {
+	$note = ' [' . join ( ', ', @unused ) . ' unused by script]';
+      }
+    }
+    printf "  %5d %-24s %s%s\n", $entry->{size}, $entry->{object},
+	join ( ', ', @{ $entry->{symbols} } ), $note;
+  }
+}
@@ -16,6 +16,25 @@
 /* LZMA preset choice.  This is a policy decision */
 #define LZMA_PRESET ( LZMA_PRESET_DEFAULT | LZMA_PRESET_EXTREME )
 
+/* LZ4 hash table size (log2).  This is a policy decision */
+#define LZ4_HASH_BITS 16
+
+/* LZ4 maximum match offset.  Fixed by the LZ4 block format */
+#define LZ4_MAX_OFFSET 65535
+
+/* LZ4 minimum match length.  Fixed by the LZ4 block format */
+#define LZ4_MIN_MATCH 4
+
+/* Compression formats.  Must match the decompressor selected via
+ * ZFORMAT (unlzma.S or unlz4.S)
+ */
+enum format {
+	FORMAT_LZMA = 0,
+	FORMAT_LZ4,
+};
+
+static enum format format = FORMAT_LZMA;
+
 struct input_file {
 	void *buf;
 	size_t len;
@@ -260,6 +279,117 @@ static uint32_t crc32_le ( uint32_t crc, const void *data, size_t len ) {
 	return crc;
 }
 
+static uint32_t lz4_hash ( const uint8_t *data ) {
+	uint32_t seq;
+
+	memcpy ( &seq, data, sizeof ( seq ) );
+	return ( ( ( uint32_t ) ( seq * 2654435761U ) ) >>
+		 ( 32 - LZ4_HASH_BITS ) );
+}
+
+static int lz4_compress ( const uint8_t *data, size_t len, uint8_t *out,
+			  size_t *out_len, size_t max_len ) {
+	static uint32_t hashtab[ 1 << LZ4_HASH_BITS ];
+	uint8_t *dst = out;
+	uint8_t *end = ( out + max_len );
+	uint8_t *token;
+	size_t anchor = 0;
+	size_t pos = 0;
+	size_t match;
+	size_t match_len;
+	size_t lit_len;
+	size_t offset;
+	size_t extra;
+	uint32_t hash;
+
+	/* Clear hash table (in which zero means "no previous position"
+	 * and all other values are (position + 1))
+	 */
+	memset ( hashtab, 0, sizeof ( hashtab ) );
+
+	/* Produce sequences of literals and matches.  As per the LZ4
+	 * block format, matches may neither start within the last 12
+	 * bytes nor extend into the last 5 bytes, and the block always
+	 * ends with a literals-only sequence.
+	 */
+	while ( ( pos + 12 ) <= len ) {
+
+		/* Look up (and update) most recent potential match */
+		hash = lz4_hash ( &data[pos] );
+		match = hashtab[hash];
+		hashtab[hash] = ( pos + 1 );
+		if ( ! match-- )
+			goto no_match;
+		offset = ( pos - match );
+		if ( ( offset == 0 ) || ( offset > LZ4_MAX_OFFSET ) )
+			goto no_match;
+		if ( memcmp ( &data[match], &data[pos], LZ4_MIN_MATCH ) != 0 )
+			goto no_match;
+
+		/* Extend match as far as possible */
+		match_len = LZ4_MIN_MATCH;
+		while ( ( ( pos + match_len ) < ( len - 5 ) ) &&
+			( data[match + match_len] ==
+			  data[pos + match_len] ) ) {
+			match_len++;
+		}
+
+		/* Emit sequence */
+		lit_len = ( pos - anchor );
+		if ( ( dst + 1 /* token */ + ( lit_len / 255 ) + 1 + lit_len +
+		       2 /* offset */ + ( match_len / 255 ) + 1 ) > end )
+			return -1;
+		token = dst++;
+		*token = ( ( ( lit_len < 15 ) ? lit_len : 15 ) << 4 );
+		if ( lit_len >= 15 ) {
+			for ( extra = ( lit_len - 15 ) ; extra >= 255 ;
+			      extra -= 255 ) {
+				*(dst++) = 255;
+			}
+			*(dst++) = extra;
+		}
+		memcpy ( dst, &data[anchor], lit_len );
+		dst += lit_len;
+		*(dst++) = ( offset & 0xff );
+		*(dst++) = ( offset >> 8 );
+		if ( ( match_len - LZ4_MIN_MATCH ) < 15 ) {
+			*token |= ( match_len - LZ4_MIN_MATCH );
+		} else {
+			*token |= 15;
+			for ( extra = ( match_len - LZ4_MIN_MATCH - 15 ) ;
+			      extra >= 255 ; extra -= 255 ) {
+				*(dst++) = 255;
+			}
+			*(dst++) = extra;
+		}
+
+		/* Continue after match */
+		pos += match_len;
+		anchor = pos;
+		continue;
+
+	no_match:
+		pos++;
+	}
+
+	/* Emit terminal literals-only sequence */
+	lit_len = ( len - anchor );
+	if ( ( dst + 1 /* token */ + ( lit_len / 255 ) + 1 + lit_len ) > end )
+		return -1;
+	token = dst++;
+	*token = ( ( ( lit_len < 15 ) ? lit_len : 15 ) << 4 );
+	if ( lit_len >= 15 ) {
+		for ( extra = ( lit_len - 15 ) ; extra >= 255 ; extra -= 255 )
+			*(dst++) = 255;
+		*(dst++) = extra;
+	}
+	memcpy ( dst, &data[anchor], lit_len );
+	dst += lit_len;
+
+	*out_len = ( dst - out );
+	return 0;
+}
+
 static int process_zinfo_pack ( struct input_file *input,
 				struct output_file *output,
 				union zinfo_record *zinfo ) {
@@ -296,15 +426,24 @@ static int process_zinfo_pack ( struct input_file *input,
 
 	packed = ( output->buf + output->len );
 	remaining = ( output->max_len - output->len );
-	lzma_lzma_preset ( &options, LZMA_PRESET );
-	options.lc = LZMA_LC;
-	options.lp = LZMA_LP;
-	options.pb = LZMA_PB;
-	if ( lzma_raw_buffer_encode ( filters, NULL, ( input->buf + offset ),
-				      len, packed, &packed_len,
-				      remaining ) != LZMA_OK ) {
-		fprintf ( stderr, "Compression failure\n" );
-		return -1;
+	if ( format == FORMAT_LZ4 ) {
+		if ( lz4_compress ( ( input->buf + offset ), len, packed,
+				    &packed_len, remaining ) != 0 ) {
+			fprintf ( stderr, "Compression failure\n" );
+			return -1;
+		}
+	} else {
+		lzma_lzma_preset ( &options, LZMA_PRESET );
+		options.lc = LZMA_LC;
+		options.lp = LZMA_LP;
+		options.pb = LZMA_PB;
+		if ( lzma_raw_buffer_encode ( filters, NULL,
+					      ( input->buf + offset ),
+					      len, packed, &packed_len,
+					      remaining ) != LZMA_OK ) {
+			fprintf ( stderr, "Compression failure\n" );
+			return -1;
+		}
 	}
 	output->len += packed_len;
 
@@ -571,11 +710,25 @@ int main ( int argc, char **argv ) {
 	struct input_file input;
 	struct output_file output;
 	struct zinfo_file zinfo;
+	const char *progname = argv[0];
 	unsigned int i;
 
+	while ( ( argc > 1 ) && ( strncmp ( argv[1], "--", 2 ) == 0 ) ) {
+		if ( strcmp ( argv[1], "--format=lzma" ) == 0 ) {
+			format = FORMAT_LZMA;
+		} else if ( strcmp ( argv[1], "--format=lz4" ) == 0 ) {
+			format = FORMAT_LZ4;
+		} else {
+			fprintf ( stderr, "Unknown option %s\n", argv[1] );
+			exit ( 1 );
+		}
+		argv++;
+		argc--;
+	}
+
 	if ( argc != 3 ) {
-		fprintf ( stderr, "Syntax: %s file.bin file.zinfo "
-			  "> file.zbin\n", argv[0] );
+		fprintf ( stderr, "Syntax: %s [--format=lzma|lz4] file.bin "
+			  "file.zinfo > file.zbin\n", progname );
 		exit ( 1 );
 	}
 